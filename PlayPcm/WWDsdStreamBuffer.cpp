@@ -0,0 +1,234 @@
+#include "WWDsdStreamBuffer.h"
+#include "WWUtil.h"
+#include <assert.h>
+#include <stdio.h>
+
+/// reader thread wakes up when this fraction of the ring is free
+#define REFILL_THRESHOLD_DIVISOR (4)
+
+static int64_t
+AtomicLoad64(volatile LONG64 *p)
+{
+    return InterlockedCompareExchange64(p, 0, 0);
+}
+
+WWDsdStreamBuffer::WWDsdStreamBuffer(void)
+{
+    m_reader              = nullptr;
+    m_outputType          = WWDSOT_Dop;
+    m_bitsPerSampleType   = WWBpsNone;
+    m_ring                = nullptr;
+    m_ringFrames          = 0;
+    m_bytesPerFrame       = 0;
+    m_totalFrames         = 0;
+    m_writtenFrames       = 0;
+    m_takenFrames         = 0;
+    m_readerEnd           = 0;
+    m_underrunCount       = 0;
+    m_readerThread        = nullptr;
+    m_shutdownEvent       = nullptr;
+    m_spaceAvailableEvent = nullptr;
+}
+
+WWDsdStreamBuffer::~WWDsdStreamBuffer(void)
+{
+    assert(!m_readerThread);
+    assert(!m_ring);
+}
+
+HRESULT
+WWDsdStreamBuffer::Start(WWDsdStreamReader *reader, WWDsdStreamOutputType ot, WWBitsPerSampleType t, int ringFrames)
+{
+    assert(reader);
+    assert(0 < ringFrames);
+    assert(!m_ring);
+
+    m_reader            = reader;
+    m_outputType        = ot;
+    m_bitsPerSampleType = t;
+    m_ringFrames        = ringFrames;
+    m_bytesPerFrame     = reader->NumChannels() * WWDsdStreamBytesPerSample(ot, t);
+    m_totalFrames       = reader->TotalFrames() - reader->PosFrame();
+    m_writtenFrames     = 0;
+    m_takenFrames       = 0;
+    m_readerEnd         = 0;
+    m_underrunCount     = 0;
+
+    if (m_bytesPerFrame <= 0) {
+        return E_INVALIDARG;
+    }
+
+    m_ring = new BYTE[(int64_t)m_ringFrames * m_bytesPerFrame];
+    if (nullptr == m_ring) {
+        return E_OUTOFMEMORY;
+    }
+
+    // prefill to avoid underrun at the start of playback
+    if (!Fill()) {
+        InterlockedExchange(&m_readerEnd, 1);
+        return S_OK;
+    }
+
+    m_shutdownEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    CHK(m_shutdownEvent);
+    m_spaceAvailableEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    CHK(m_spaceAvailableEvent);
+
+    m_readerThread = CreateThread(nullptr, 0, ReaderEntry, this, 0, nullptr);
+    CHK(m_readerThread);
+
+    return S_OK;
+}
+
+void
+WWDsdStreamBuffer::Stop(void)
+{
+    if (m_shutdownEvent) {
+        SetEvent(m_shutdownEvent);
+    }
+
+    if (m_readerThread) {
+        WaitForSingleObject(m_readerThread, INFINITE);
+        CloseHandle(m_readerThread);
+        m_readerThread = nullptr;
+    }
+
+    if (m_shutdownEvent) {
+        CloseHandle(m_shutdownEvent);
+        m_shutdownEvent = nullptr;
+    }
+
+    if (m_spaceAvailableEvent) {
+        CloseHandle(m_spaceAvailableEvent);
+        m_spaceAvailableEvent = nullptr;
+    }
+
+    delete [] m_ring;
+    m_ring = nullptr;
+
+    m_reader = nullptr;
+}
+
+bool
+WWDsdStreamBuffer::Fill(void)
+{
+    const int64_t written = m_writtenFrames;
+    int64_t freeFrames = m_ringFrames - (written - AtomicLoad64(&m_takenFrames));
+
+    int64_t pos = written % m_ringFrames;
+    while (0 < freeFrames) {
+        // contiguous region up to the end of the ring
+        int n = (int)(m_ringFrames - pos);
+        if (freeFrames < n) {
+            n = (int)freeFrames;
+        }
+
+        int rv = m_reader->ReadFrames(m_outputType, m_bitsPerSampleType,
+                &m_ring[pos * m_bytesPerFrame], n);
+        if (rv <= 0) {
+            if (rv < 0) {
+                printf("E: %s read error\n", __FUNCTION__);
+            }
+            return false;
+        }
+
+        // publish after the frames are written
+        InterlockedExchangeAdd64(&m_writtenFrames, rv);
+
+        freeFrames -= rv;
+        pos = (pos + rv) % m_ringFrames;
+    }
+
+    return true;
+}
+
+DWORD
+WWDsdStreamBuffer::ReaderEntry(LPVOID lpThreadParameter)
+{
+    WWDsdStreamBuffer *self = (WWDsdStreamBuffer*)lpThreadParameter;
+    return self->ReaderMain();
+}
+
+DWORD
+WWDsdStreamBuffer::ReaderMain(void)
+{
+    HANDLE waitArray[2] = {m_shutdownEvent, m_spaceAvailableEvent};
+    bool running = true;
+
+    while (running) {
+        int64_t freeFrames = m_ringFrames - (m_writtenFrames - AtomicLoad64(&m_takenFrames));
+        if (freeFrames < m_ringFrames / REFILL_THRESHOLD_DIVISOR) {
+            DWORD waitResult = WaitForMultipleObjects(2, waitArray, FALSE, INFINITE);
+            switch (waitResult) {
+            case WAIT_OBJECT_0 + 0:     // m_shutdownEvent
+                running = false;
+                break;
+            case WAIT_OBJECT_0 + 1:     // m_spaceAvailableEvent
+                break;
+            default:
+                running = false;
+                break;
+            }
+            continue;
+        }
+
+        if (!Fill()) {
+            running = false;
+        }
+    }
+
+    InterlockedExchange(&m_readerEnd, 1);
+    return 0;
+}
+
+int
+WWDsdStreamBuffer::GetFrames(BYTE *to, int wantFrames)
+{
+    const int64_t taken = m_takenFrames;
+    int64_t availableFrames = AtomicLoad64(&m_writtenFrames) - taken;
+
+    int copyFrames = wantFrames;
+    if (availableFrames < copyFrames) {
+        copyFrames = (int)availableFrames;
+        if (taken + copyFrames < m_totalFrames) {
+            ++m_underrunCount;
+        }
+    }
+
+    int64_t pos = taken % m_ringFrames;
+    int firstFrames = copyFrames;
+    if (m_ringFrames - pos < firstFrames) {
+        firstFrames = (int)(m_ringFrames - pos);
+    }
+
+    if (0 < firstFrames) {
+        CopyMemory(to, &m_ring[pos * m_bytesPerFrame], firstFrames * m_bytesPerFrame);
+    }
+    if (0 < copyFrames - firstFrames) {
+        CopyMemory(&to[firstFrames * m_bytesPerFrame], m_ring, (copyFrames - firstFrames) * m_bytesPerFrame);
+    }
+
+    InterlockedExchangeAdd64(&m_takenFrames, copyFrames);
+
+    if (m_spaceAvailableEvent && 0 < copyFrames) {
+        SetEvent(m_spaceAvailableEvent);
+    }
+
+    return copyFrames;
+}
+
+bool
+WWDsdStreamBuffer::IsEnd(void)
+{
+    if (!m_readerEnd) {
+        return false;
+    }
+
+    return AtomicLoad64(&m_writtenFrames) <= AtomicLoad64(&m_takenFrames);
+}
+
+int64_t
+WWDsdStreamBuffer::PosFrame(void)
+{
+    return AtomicLoad64(&m_takenFrames);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Windows.h>
+#include "WWDsdStreamReader.h"
+
+/// Bounded ring buffer filled by a reader thread.
+/// Render thread takes frames from the ring without waiting for the file read.
+/// One reader thread (producer) and one render thread (consumer) only.
+class WWDsdStreamBuffer {
+public:
+    WWDsdStreamBuffer(void);
+    ~WWDsdStreamBuffer(void);
+
+    /// fills the ring and starts the reader thread.
+    /// @param reader     opened stream reader. owned by the caller and must outlive Stop()
+    /// @param ringFrames capacity of the ring in frames
+    HRESULT Start(WWDsdStreamReader *reader, WWDsdStreamOutputType ot, WWBitsPerSampleType t, int ringFrames);
+
+    void Stop(void);
+
+    /// copies frames from the ring. does not block.
+    /// @return copied frames. smaller than wantFrames on underrun or at the end of the stream
+    int GetFrames(BYTE *to, int wantFrames);
+
+    /// @return true when every frame of the stream is taken by GetFrames()
+    bool IsEnd(void);
+
+    /// @return frames taken by GetFrames()
+    int64_t PosFrame(void);
+
+    int64_t TotalFrames(void) const { return m_totalFrames; }
+    int BytesPerFrame(void) const { return m_bytesPerFrame; }
+
+    /// @return number of GetFrames() calls that could not fill the request before the end of the stream
+    int UnderrunCount(void) const { return m_underrunCount; }
+
+private:
+    WWDsdStreamReader     *m_reader;
+    WWDsdStreamOutputType m_outputType;
+    WWBitsPerSampleType   m_bitsPerSampleType;
+
+    BYTE    *m_ring;
+    int     m_ringFrames;
+    int     m_bytesPerFrame;
+    int64_t m_totalFrames;
+
+    /// frames written by the reader thread / taken by the render thread since Start().
+    /// ring position is (count % m_ringFrames)
+    volatile LONG64 m_writtenFrames;
+    volatile LONG64 m_takenFrames;
+
+    /// the reader reached the end of the stream or stopped on read error
+    volatile LONG m_readerEnd;
+
+    int     m_underrunCount;
+
+    HANDLE  m_readerThread;
+    HANDLE  m_shutdownEvent;
+    HANDLE  m_spaceAvailableEvent;
+
+    static DWORD WINAPI ReaderEntry(LPVOID lpThreadParameter);
+    DWORD ReaderMain(void);
+
+    /// reads frames into the free space of the ring.
+    /// @return false when the stream ends or read error
+    bool Fill(void);
+};
@@ -0,0 +1,65 @@
+#include "WWDsdStreamReader.h"
+#include "WWDsfReader.h"
+#include "WWDsdiffReader.h"
+#include "WWDsdToDop.h"
+#include <assert.h>
+
+int
+WWDsdStreamBytesPerSample(WWDsdStreamOutputType ot, WWBitsPerSampleType t)
+{
+    switch (ot) {
+    case WWDSOT_Dop:
+        return WWDopBytesPerSample(t);
+    case WWDSOT_Native:
+        return 2;
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+WWDsdStreamReader::WWDsdStreamReader(void)
+    : m_fp(nullptr), m_numChannels(0), m_dsdSampleRate(0), m_totalFrames(0), m_posFrame(0)
+{
+}
+
+WWDsdStreamReader::~WWDsdStreamReader(void)
+{
+    assert(nullptr == m_fp);
+}
+
+void
+WWDsdStreamReader::Close(void)
+{
+    if (m_fp) {
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+}
+
+bool
+WWDsdIsSupportedSampleRate(uint32_t sampleRate)
+{
+    return sampleRate == WW_DSD_SAMPLE_RATE_BASE
+        || sampleRate == WW_DSD_SAMPLE_RATE_BASE*2
+        || sampleRate == WW_DSD_SAMPLE_RATE_BASE*4
+        || sampleRate == WW_DSD_SAMPLE_RATE_BASE*8;
+}
+
+WWDsdStreamReader *
+WWDsdStreamReaderOpen(const char *path)
+{
+    WWDsdStreamReader *reader = new WWDsfStreamReader();
+    if (0 <= reader->Open(path)) {
+        return reader;
+    }
+    delete reader;
+
+    reader = new WWDsdiffStreamReader();
+    if (0 <= reader->Open(path)) {
+        return reader;
+    }
+    delete reader;
+
+    return nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "WWPcmData.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/// DSD64 sampling frequency
+#define WW_DSD_SAMPLE_RATE_BASE (2822400)
+
+/// 5.1ch
+#define WW_DSD_CHANNEL_MAX (6)
+
+enum WWDsdStreamOutputType {
+    /// DoP frames. 24bit or 32bit (valid 24bit) depending on WWBitsPerSampleType
+    WWDSOT_Dop,
+
+    /// 16 DSD bits per channel in DSDIFF byte order:
+    /// channel interleaved bytes, most significant bit is the oldest bit in time.
+    WWDSOT_Native,
+};
+
+/// @return bytes of one frame of one channel
+int WWDsdStreamBytesPerSample(WWDsdStreamOutputType ot, WWBitsPerSampleType t);
+
+/// Reads DSD sound data chunk by chunk.
+/// Memory usage does not depend on the file size.
+/// 1 frame == 16 DSD bits per channel == 1 DoP frame
+class WWDsdStreamReader {
+public:
+    WWDsdStreamReader(void);
+    virtual ~WWDsdStreamReader(void);
+
+    /// @return 0: success. negative: not supported or read error
+    virtual int Open(const char *path) = 0;
+    virtual void Close(void);
+
+    /// reads frames from the current position.
+    /// @param to frames * NumChannels() * WWDsdStreamBytesPerSample(ot, t) bytes
+    /// @return frames read. 0: end of stream. negative: read error
+    virtual int ReadFrames(WWDsdStreamOutputType ot, WWBitsPerSampleType t, unsigned char *to, int frames) = 0;
+
+    int NumChannels(void) const { return m_numChannels; }
+
+    /// @return DSD sampling frequency. 2822400 for DSD64
+    int DsdSampleRate(void) const { return m_dsdSampleRate; }
+
+    /// @return sample rate of DoP frames
+    int DopSampleRate(void) const { return m_dsdSampleRate/16; }
+
+    int64_t TotalFrames(void) const { return m_totalFrames; }
+    int64_t PosFrame(void) const { return m_posFrame; }
+
+protected:
+    FILE    *m_fp;
+    int     m_numChannels;
+    int     m_dsdSampleRate;
+    int64_t m_totalFrames;
+    int64_t m_posFrame;
+};
+
+/// @return true if DSD64, DSD128, DSD256 or DSD512
+bool WWDsdIsSupportedSampleRate(uint32_t sampleRate);
+
+/// opens DSF or DSDIFF file.
+/// @return nullptr if the file is not a supported DSD file. delete the returned reader after use
+WWDsdStreamReader *WWDsdStreamReaderOpen(const char *path);
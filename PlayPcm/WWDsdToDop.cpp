@@ -0,0 +1,258 @@
+#include "WWDsdToDop.h"
+#include <string.h>
+#include <assert.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_DOP_USE_SSE2
+#endif
+
+static const unsigned char gBitReverse[256] =
+{
+#   define R2(n)    n,     n + 2*64,     n + 1*64,     n + 3*64
+#   define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#   define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
+    R6(0), R6(2), R6(1), R6(3)
+};
+#undef R6
+#undef R4
+#undef R2
+
+int
+WWDopBytesPerSample(WWBitsPerSampleType t)
+{
+    switch (t) {
+    case WWBps24:
+        return 3;
+    case WWBps32v24:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/// scalar conversion of DoP frame [fromFrame, toFrame) of one DSF block.
+static void
+DsfBlockToDopScalar(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int fromFrame, int toFrame, int bytesPerSample, unsigned char *to)
+{
+    int64_t writePos = 0;
+
+    for (int i=fromFrame; i<toFrame; ++i) {
+        unsigned char marker = (i & 1) ? WW_DOP_MARKER1 : WW_DOP_MARKER0;
+        for (int ch=0; ch<numChannels; ++ch) {
+            const unsigned char *p = &block[i*2 + ch*blockSizePerChannel];
+            if (bytesPerSample == 4) {
+                to[writePos++] = 0;
+            }
+            to[writePos++] = gBitReverse[p[1]];
+            to[writePos++] = gBitReverse[p[0]];
+            to[writePos++] = marker;
+        }
+    }
+}
+
+#ifdef WW_DOP_USE_SSE2
+
+/// reverses bit order of each of 16 bytes.
+static inline __m128i
+BitReverse16Bytes(__m128i v)
+{
+    const __m128i m0f = _mm_set1_epi8(0x0f);
+    const __m128i m33 = _mm_set1_epi8(0x33);
+    const __m128i m55 = _mm_set1_epi8(0x55);
+
+    v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), m0f), _mm_slli_epi16(_mm_and_si128(v, m0f), 4));
+    v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 2), m33), _mm_slli_epi16(_mm_and_si128(v, m33), 2));
+    v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 1), m55), _mm_slli_epi16(_mm_and_si128(v, m55), 1));
+    return v;
+}
+
+/// loads 16 DSF bytes (8 DoP frames of one channel) and returns 8 16bit DoP payloads.
+/// older byte goes to upper byte.
+static inline __m128i
+LoadDsfPayload(const unsigned char *p)
+{
+    __m128i v = BitReverse16Bytes(_mm_loadu_si128((const __m128i*)p));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/// packs 4 dwords whose upper byte is 0 into 12 bytes.
+/// writes 14 bytes: the last 2 bytes are garbage and should be overwritten by the next store.
+static inline void
+Store4x24(__m128i v, unsigned char *to)
+{
+    const __m128i maskLo = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+    const __m128i maskHi = _mm_set_epi32(0x0000ffff, 0xff000000, 0x0000ffff, 0xff000000);
+
+    __m128i p = _mm_or_si128(_mm_and_si128(v, maskLo), _mm_and_si128(_mm_srli_epi64(v, 8), maskHi));
+    _mm_storel_epi64((__m128i*)to,       p);
+    _mm_storel_epi64((__m128i*)(to + 6), _mm_srli_si128(p, 8));
+}
+
+/// stereo. converts 8 DoP frames per iteration.
+/// @param numFrames multiple of 8
+static void
+DsfBlockToDopStereoSse2(const unsigned char *block, int blockSizePerChannel,
+        int numFrames, int bytesPerSample, unsigned char *to)
+{
+    assert((numFrames & 7) == 0);
+
+    const unsigned char *fromL = block;
+    const unsigned char *fromR = block + blockSizePerChannel;
+
+    // dword = payload | marker<<16. L0 R0 L1 R1 ...
+    const __m128i markers = _mm_set_epi16(
+            WW_DOP_MARKER1, WW_DOP_MARKER1, WW_DOP_MARKER0, WW_DOP_MARKER0,
+            WW_DOP_MARKER1, WW_DOP_MARKER1, WW_DOP_MARKER0, WW_DOP_MARKER0);
+
+    for (int i=0; i<numFrames; i += 8) {
+        __m128i l = LoadDsfPayload(&fromL[i*2]);
+        __m128i r = LoadDsfPayload(&fromR[i*2]);
+
+        __m128i lr0 = _mm_unpacklo_epi16(l, r);
+        __m128i lr1 = _mm_unpackhi_epi16(l, r);
+
+        __m128i d0 = _mm_unpacklo_epi16(lr0, markers);
+        __m128i d1 = _mm_unpackhi_epi16(lr0, markers);
+        __m128i d2 = _mm_unpacklo_epi16(lr1, markers);
+        __m128i d3 = _mm_unpackhi_epi16(lr1, markers);
+
+        if (bytesPerSample == 4) {
+            // 0 payloadLo payloadHi marker
+            _mm_storeu_si128((__m128i*)(to +  0), _mm_slli_epi32(d0, 8));
+            _mm_storeu_si128((__m128i*)(to + 16), _mm_slli_epi32(d1, 8));
+            _mm_storeu_si128((__m128i*)(to + 32), _mm_slli_epi32(d2, 8));
+            _mm_storeu_si128((__m128i*)(to + 48), _mm_slli_epi32(d3, 8));
+            to += 64;
+        } else {
+            // payloadLo payloadHi marker
+            Store4x24(d0, to +  0);
+            Store4x24(d1, to + 12);
+            Store4x24(d2, to + 24);
+            Store4x24(d3, to + 36);
+            to += 48;
+        }
+    }
+}
+
+/// any number of channels. payload is computed with SSE2 and scattered to the frame.
+/// @param numFrames multiple of 8
+static void
+DsfBlockToDopMultiChannelSse2(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int numFrames, int bytesPerSample, unsigned char *to)
+{
+    assert((numFrames & 7) == 0);
+
+    const int bytesPerFrame = bytesPerSample * numChannels;
+    const __m128i markers = _mm_set_epi16(
+            WW_DOP_MARKER1, WW_DOP_MARKER0, WW_DOP_MARKER1, WW_DOP_MARKER0,
+            WW_DOP_MARKER1, WW_DOP_MARKER0, WW_DOP_MARKER1, WW_DOP_MARKER0);
+    const int offs = bytesPerSample - 3;
+
+    for (int i=0; i<numFrames; i += 8) {
+        for (int ch=0; ch<numChannels; ++ch) {
+            __m128i v = LoadDsfPayload(&block[i*2 + ch*blockSizePerChannel]);
+
+            uint32_t d[8];
+            _mm_storeu_si128((__m128i*)&d[0], _mm_unpacklo_epi16(v, markers));
+            _mm_storeu_si128((__m128i*)&d[4], _mm_unpackhi_epi16(v, markers));
+
+            unsigned char *w = to + (int64_t)i * bytesPerFrame + ch * bytesPerSample;
+            for (int j=0; j<8; ++j) {
+                if (offs) {
+                    w[0] = 0;
+                }
+                w[offs+0] = (unsigned char)(d[j]);
+                w[offs+1] = (unsigned char)(d[j] >> 8);
+                w[offs+2] = (unsigned char)(d[j] >> 16);
+                w += bytesPerFrame;
+            }
+        }
+    }
+}
+
+#endif /* WW_DOP_USE_SSE2 */
+
+int64_t
+WWDsfBlockToDop(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int fromFrame, int numFrames, WWBitsPerSampleType t, unsigned char *to)
+{
+    const int bytesPerSample = WWDopBytesPerSample(t);
+    assert(0 < bytesPerSample);
+    assert(0 <= fromFrame && fromFrame + numFrames <= blockSizePerChannel/2);
+
+    const int64_t bytesPerFrame = bytesPerSample * numChannels;
+
+    // SIMD code assumes that the first frame has marker 0x05.
+    int headFrames = fromFrame & 1;
+    if (numFrames < headFrames) {
+        headFrames = numFrames;
+    }
+    DsfBlockToDopScalar(block, blockSizePerChannel, numChannels,
+            fromFrame, fromFrame + headFrames, bytesPerSample, to);
+
+    const int pos    = fromFrame + headFrames;
+    const int remain = numFrames - headFrames;
+    unsigned char *w = to + headFrames * bytesPerFrame;
+    int simdFrames = 0;
+
+#ifdef WW_DOP_USE_SSE2
+    if (numChannels == 2) {
+        // 24bit store writes 2 bytes past the end. leave at least 1 frame to the scalar code.
+        simdFrames = (bytesPerSample == 4) ? (remain & ~7) : (((remain-1)/8)*8);
+        if (0 < simdFrames) {
+            DsfBlockToDopStereoSse2(&block[pos*2], blockSizePerChannel, simdFrames, bytesPerSample, w);
+        }
+    } else {
+        simdFrames = remain & ~7;
+        DsfBlockToDopMultiChannelSse2(&block[pos*2], blockSizePerChannel, numChannels, simdFrames, bytesPerSample, w);
+    }
+#endif /* WW_DOP_USE_SSE2 */
+
+    DsfBlockToDopScalar(block, blockSizePerChannel, numChannels,
+            pos + simdFrames, pos + remain, bytesPerSample, w + simdFrames * bytesPerFrame);
+
+    return numFrames * bytesPerFrame;
+}
+
+int64_t
+WWDsfBlockToNative(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int fromFrame, int numFrames, unsigned char *to)
+{
+    assert(0 <= fromFrame && fromFrame + numFrames <= blockSizePerChannel/2);
+
+    int64_t writePos = 0;
+    for (int i=fromFrame; i<fromFrame + numFrames; ++i) {
+        for (int b=0; b<2; ++b) {
+            for (int ch=0; ch<numChannels; ++ch) {
+                to[writePos++] = gBitReverse[block[i*2 + b + ch*blockSizePerChannel]];
+            }
+        }
+    }
+    return writePos;
+}
+
+int64_t
+WWDsdiffToDop(const unsigned char *from, int numChannels, int64_t fromFrame,
+        int numFrames, WWBitsPerSampleType t, unsigned char *to)
+{
+    const int bytesPerSample = WWDopBytesPerSample(t);
+    assert(0 < bytesPerSample);
+
+    int64_t writePos = 0;
+    for (int i=0; i<numFrames; ++i) {
+        const unsigned char *p = &from[i*2*numChannels];
+        unsigned char marker = ((fromFrame + i) & 1) ? WW_DOP_MARKER1 : WW_DOP_MARKER0;
+
+        for (int ch=0; ch<numChannels; ++ch) {
+            if (bytesPerSample == 4) {
+                to[writePos++] = 0;
+            }
+            to[writePos++] = p[ch+numChannels];
+            to[writePos++] = p[ch];
+            to[writePos++] = marker;
+        }
+    }
+    return writePos;
+}
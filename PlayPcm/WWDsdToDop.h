@@ -0,0 +1,36 @@
+#pragma once
+
+#include "WWPcmData.h"
+#include <stdint.h>
+
+#define WW_DOP_MARKER0 (0x05)
+#define WW_DOP_MARKER1 (0xfa)
+
+/// @return bytes of one DoP sample (one channel of one frame). 0 if the type is not DoP capable.
+int WWDopBytesPerSample(WWBitsPerSampleType t);
+
+/// Converts DSF block data to DoP frames.
+/// DSF block consists of blockSizePerChannel bytes of L channel, followed by blockSizePerChannel bytes of R channel, ...
+/// Least significant bit of each byte is the oldest bit in time.
+/// @param block       DSF block. blockSizePerChannel * numChannels bytes
+/// @param fromFrame   first DoP frame in the block to convert. DoP marker is chosen by the parity of the frame index
+/// @param numFrames   DoP frames to convert. fromFrame + numFrames must be smaller than or equal to blockSizePerChannel/2
+/// @param to          DoP frames are written here. numFrames * numChannels * WWDopBytesPerSample(t) bytes
+/// @return written bytes
+int64_t WWDsfBlockToDop(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int fromFrame, int numFrames, WWBitsPerSampleType t, unsigned char *to);
+
+/// Converts DSF block data to native DSD frames.
+/// Native DSD frame is 16 bits per channel stored in DSDIFF byte order:
+/// channel interleaved bytes, most significant bit is the oldest bit in time.
+/// @param to numFrames * numChannels * 2 bytes
+/// @return written bytes
+int64_t WWDsfBlockToNative(const unsigned char *block, int blockSizePerChannel, int numChannels,
+        int fromFrame, int numFrames, unsigned char *to);
+
+/// Converts DSDIFF sound data (native DSD frames) to DoP frames.
+/// @param from      numFrames * numChannels * 2 bytes
+/// @param fromFrame frame index of from[0] in the stream. used to choose DoP marker
+/// @return written bytes
+int64_t WWDsdiffToDop(const unsigned char *from, int numChannels, int64_t fromFrame,
+        int numFrames, WWBitsPerSampleType t, unsigned char *to);
@@ -1,7 +1,9 @@
 #include "WWDsdiffReader.h"
+#include "WWDsdToDop.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <assert.h>
 
 #define FORM_DSD_FORM_TYPE           "DSD "
 #define PROPERTY_CHUNK_PROPERTY_TYPE "SND "
@@ -18,6 +20,9 @@
 #define FOURCC_CMPR 0x52504d43 //< "CMPR"
 #define FOURCC_DSD  0x20445344 //< "DSD "
 
+/// frames converted to DoP at once
+#define DSDIFF_READ_FRAMES (4096)
+
 // assumed target platform is little endian...
 #define FREAD(toPtr, bytes, fp)               \
     if (fread(toPtr, 1, bytes, fp) < bytes) { \
@@ -83,11 +88,6 @@ struct DsdiffFormDsdChunk {
         READ_BIG8(ckDataSize, fp);
         FREAD(formType, 4, fp);
 
-        if (0x7fffffff < ckDataSize) {
-            printf("file too large %llu\n", ckDataSize);
-            return -1;
-        }
-
         if (0 != memcmp(formType, FORM_DSD_FORM_TYPE, 4)) {
             printf("DSDIFF formType != DSD %c%c%c%c\n",
                     formType[0], formType[1], formType[2], formType[3]);
@@ -168,8 +168,9 @@ struct DsdiffSampleRateChunk {
             return -1;
         }
 
-        if (2822400 != sampleRate) {
-            printf("DSDIFF SampleRateChunk sampleRate != 2822400 %u\n",
+        // DSD64, DSD128, DSD256 and DSD512
+        if (!WWDsdIsSupportedSampleRate(sampleRate)) {
+            printf("DSDIFF SampleRateChunk sampleRate is not supported %u\n",
                     sampleRate);
             return -1;
         }
@@ -190,18 +191,18 @@ struct DsdiffChannelsChunk {
         READ_BIG8(ckDataSize, fp);
         READ_BIG2(numChannels, fp);
 
-        if (ckDataSize < 6) {
-            printf("DSDIFF ChannelsChunk ckDataSize<6 %llu\n", ckDataSize);
+        if (ckDataSize < 2) {
+            printf("DSDIFF ChannelsChunk ckDataSize<2 %llu\n", ckDataSize);
             return -1;
         }
 
-        if (numChannels != 2) {
-            printf("DSDIFF ChannelsChunk numChannels!=2 %u\n", numChannels);
+        if (numChannels < 1 || WW_DSD_CHANNEL_MAX < numChannels) {
+            printf("DSDIFF ChannelsChunk numChannels=%u is not supported\n", numChannels);
             return -1;
         }
 
         // skip channel ID's
-        if (0 != fseek(fp, (long)(ckDataSize-2), SEEK_CUR)) {
+        if (0 != _fseeki64(fp, (int64_t)(ckDataSize-2), SEEK_CUR)) {
             printf("DSDIFF ChannelsChunk error in skipping channels chunk\n");
             return -1;
         }
@@ -234,7 +235,7 @@ struct DsdiffCompressionTypeChunk {
         }
 
         // skip compressionName
-        if (0 != fseek(fp, (ckDataSize-4+1)&(~1), SEEK_CUR)) {
+        if (0 != _fseeki64(fp, (int64_t)((ckDataSize-4+1)&(~1)), SEEK_CUR)) {
             printf("DSDIFF compressionName skip failed\n");
             return -1;
         }
@@ -253,8 +254,8 @@ struct DsdiffSoundDataChunk {
     int ReadHeaderFromFile(FILE *fp) {
         READ_BIG8(ckDataSize, fp);
 
-        if (ckDataSize == 0 || 0x7fffffff < ckDataSize) {
-            printf("DSDIFF SoundDataChunk ckDataSize too large %llu\n", ckDataSize);
+        if (ckDataSize == 0) {
+            printf("DSDIFF SoundDataChunk ckDataSize == 0\n");
             return -1;
         }
 
@@ -274,13 +275,13 @@ struct DsdiffUnknownChunk {
     int ReadFromFile(FILE *fp) {
         READ_BIG8(ckDataSize, fp);
 
-        if (ckDataSize == 0 || 0x7fffffff < ckDataSize) {
-            printf("DSDIFF UnknownChunk ckDataSize too large %llu\n", ckDataSize);
+        if (ckDataSize == 0) {
+            printf("DSDIFF UnknownChunk ckDataSize == 0\n");
             return -1;
         }
 
         // skip unknown chunk
-        if (0 != fseek(fp, (ckDataSize+1)&(~1), SEEK_CUR)) {
+        if (0 != _fseeki64(fp, (int64_t)((ckDataSize+1)&(~1)), SEEK_CUR)) {
             printf("DSDIFF UnknownChunk skip failed\n");
             return -1;
         }
@@ -289,10 +290,22 @@ struct DsdiffUnknownChunk {
     }
 };
 
-WWPcmData *
-WWReadDsdiffFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmDataStreamAllocType allocType)
+///////////////////////////////////////////////////////////////////////
+// WWDsdiffStreamReader
+
+WWDsdiffStreamReader::WWDsdiffStreamReader(void)
+    : m_readBuff(nullptr)
+{
+}
+
+WWDsdiffStreamReader::~WWDsdiffStreamReader(void)
+{
+    Close();
+}
+
+int
+WWDsdiffStreamReader::Open(const char *path)
 {
-    WWPcmData *pcmData = nullptr;
     uint32_t fourCC;
     DsdiffFormDsdChunk         formDsdChunk;
     DsdiffFormVersionChunk     formVersionChunk;
@@ -302,70 +315,60 @@ WWReadDsdiffFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmD
     DsdiffCompressionTypeChunk cmprChunk;
     DsdiffSoundDataChunk       dataChunk;
     DsdiffUnknownChunk         unkChunk;
-    int64_t streamBytes;
-    int64_t writePos;
-    unsigned char *dsdData = nullptr;
-    unsigned char *stream = nullptr;
-    int result = -1;
     bool done = false;
 
-    if (bitsPerSampleType == WWBpsNone) {
-        printf("E: device does not support DoP\n");
-        return nullptr;
-    }
+    assert(nullptr == m_fp);
 
-    FILE *fp = nullptr;
-    fopen_s(&fp, path, "rb");
-    if (nullptr == fp) {
-        printf("file open error %s\n", path);
-        return nullptr;
+    fopen_s(&m_fp, path, "rb");
+    if (nullptr == m_fp) {
+        return -1;
     }
 
     while (!done) {
-        if (fread(&fourCC, 1, 4, fp) < 4) {
+        if (fread(&fourCC, 1, 4, m_fp) < 4) {
             break;
         }
 
         switch(fourCC) {
         case FOURCC_FRM8:
-            if (formDsdChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (formDsdChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_FVER:
-            if (formVersionChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (formVersionChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_PROP:
-            if (propChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (propChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_FS:
-            if (sampleRateChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (sampleRateChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_CHNL:
-            if (channelsChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (channelsChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_CMPR:
-            if (cmprChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (cmprChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         case FOURCC_DSD:
-            if (dataChunk.ReadHeaderFromFile(fp) < 0) {
-                goto end;
+            if (dataChunk.ReadHeaderFromFile(m_fp) < 0) {
+                goto fail;
             }
             done = true;
             break;
         default:
-            if (unkChunk.ReadFromFile(fp) < 0) {
-                goto end;
+            if (unkChunk.ReadFromFile(m_fp) < 0) {
+                goto fail;
             }
             break;
         }
@@ -379,90 +382,141 @@ WWReadDsdiffFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmD
             cmprChunk.ckDataSize == 0 ||
             dataChunk.ckDataSize == 0 ||
             !done) {
-        printf("read error or not supported format\n");
-        goto end;
+        goto fail;
     }
 
-    pcmData = new WWPcmData();
-    if (nullptr == pcmData) {
-        printf("no memory\n");
-        goto end;
-    }
-    pcmData->Init(allocType);
+    // the file position is at the start of the sound data.
+    // data is stored in following order:
+    // L channel byte, R channel byte, L channel byte ...
+    // Most significant bit is the oldest bit in time.
 
-    pcmData->bitsPerSample      = bitsPerSampleType == WWBps32v24 ? 32 : 24;
-    pcmData->validBitsPerSample = 24;
-    pcmData->nChannels          = channelsChunk.numChannels;
+    m_numChannels   = channelsChunk.numChannels;
+    m_dsdSampleRate = sampleRateChunk.sampleRate;
 
     // DSD 16bit == 1 frame
-    pcmData->nFrames        = dataChunk.ckDataSize/2/channelsChunk.numChannels;
-    pcmData->nSamplesPerSec = 176400;
-    pcmData->posFrame       = 0;
+    m_totalFrames   = (int64_t)(dataChunk.ckDataSize/2/channelsChunk.numChannels);
+    m_posFrame      = 0;
 
-    streamBytes = pcmData->bitsPerSample/8 * pcmData->nFrames * pcmData->nChannels;
-    stream = new unsigned char[streamBytes];
-    if (nullptr == stream) {
-        printf("no memory\n");
-        goto end;
-    }
-    memset(stream, 0, streamBytes);
+    m_readBuff = new unsigned char[DSDIFF_READ_FRAMES * 2 * m_numChannels];
+    return 0;
 
-    // data is stored in following order:
-    // L channel byte, R channel byte, L channel byte ...
-    // Most significant bit is the oldest bit in time.
+fail:
+    Close();
+    return -1;
+}
 
-    dsdData = new unsigned char[pcmData->nChannels * 2];
-    if (nullptr == dsdData) {
-        printf("no memory\n");
-        goto end;
+void
+WWDsdiffStreamReader::Close(void)
+{
+    delete [] m_readBuff;
+    m_readBuff = nullptr;
+
+    WWDsdStreamReader::Close();
+}
+
+int
+WWDsdiffStreamReader::ReadFrames(WWDsdStreamOutputType ot, WWBitsPerSampleType t, unsigned char *to, int frames)
+{
+    const int nativeBytesPerFrame = 2 * m_numChannels;
+    const int bytesPerFrame       = m_numChannels * WWDsdStreamBytesPerSample(ot, t);
+    int pos = 0;
+
+    assert(m_fp);
+    assert(0 < bytesPerFrame);
+
+    if (m_totalFrames - m_posFrame < frames) {
+        frames = (int)(m_totalFrames - m_posFrame);
     }
 
-    writePos = 0;
-    switch (bitsPerSampleType) {
-    case WWBps32v24:
-        for (int i=0; i<pcmData->nFrames; ++i) {
-            if (1 != fread(dsdData, pcmData->nChannels * 2, 1, fp)) {
-                goto end;
-            }
+    while (pos < frames) {
+        int n = frames - pos;
+        unsigned char *w = &to[(int64_t)pos * bytesPerFrame];
 
-            for (int ch=0; ch<pcmData->nChannels; ++ch) {
-                stream[writePos+0] = 0;
-                stream[writePos+1] = dsdData[ch+pcmData->nChannels];
-                stream[writePos+2] = dsdData[ch];
-                stream[writePos+3] = i & 1 ? 0xfa : 0x05;
-                writePos += 4;
+        switch (ot) {
+        case WWDSOT_Native:
+            // same byte order as the file
+            if (fread(w, nativeBytesPerFrame, n, m_fp) < (size_t)n) {
+                printf("DSDIFF sound data read error\n");
+                return -1;
             }
-        }
-        break;
-    case WWBps24:
-        for (int i=0; i<pcmData->nFrames; ++i) {
-            if (1 != fread(dsdData, pcmData->nChannels * 2, 1, fp)) {
-                goto end;
+            break;
+        case WWDSOT_Dop:
+            if (DSDIFF_READ_FRAMES < n) {
+                n = DSDIFF_READ_FRAMES;
             }
-
-            for (int ch=0; ch<pcmData->nChannels; ++ch) {
-                stream[writePos+0] = dsdData[ch+pcmData->nChannels];
-                stream[writePos+1] = dsdData[ch];
-                stream[writePos+2] = i & 1 ? 0xfa : 0x05;
-                writePos += 3;
+            if (fread(m_readBuff, nativeBytesPerFrame, n, m_fp) < (size_t)n) {
+                printf("DSDIFF sound data read error\n");
+                return -1;
             }
+            WWDsdiffToDop(m_readBuff, m_numChannels, m_posFrame, n, t, w);
+            break;
+        default:
+            assert(0);
+            return -1;
         }
-        break;
+
+        m_posFrame += n;
+        pos        += n;
     }
 
-    if (!pcmData->StoreStream(stream, streamBytes)) {
+    return pos;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+WWPcmData *
+WWReadDsdiffFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmDataStreamAllocType allocType)
+{
+    WWPcmData *pcmData = nullptr;
+    WWDsdiffStreamReader reader;
+    int64_t streamBytes;
+    int64_t writePos;
+    int64_t bytesPerFrame;
+    int result = -1;
+
+    if (bitsPerSampleType == WWBpsNone) {
+        printf("E: device does not support DoP\n");
+        return nullptr;
+    }
+
+    if (reader.Open(path) < 0) {
+        printf("read error or not supported format %s\n", path);
+        return nullptr;
+    }
+
+    pcmData = new WWPcmData();
+    if (nullptr == pcmData) {
+        printf("no memory\n");
+        goto end;
+    }
+    pcmData->Init(allocType);
+
+    pcmData->bitsPerSample      = bitsPerSampleType == WWBps32v24 ? 32 : 24;
+    pcmData->validBitsPerSample = 24;
+    pcmData->nChannels          = reader.NumChannels();
+    pcmData->nFrames            = reader.TotalFrames();
+    pcmData->nSamplesPerSec     = reader.DopSampleRate();
+    pcmData->posFrame           = 0;
+
+    bytesPerFrame = pcmData->bitsPerSample/8 * pcmData->nChannels;
+    streamBytes   = bytesPerFrame * pcmData->nFrames;
+    if (!pcmData->AllocStream(streamBytes)) {
         printf("memory allocation failed\n");
         goto end;
     }
 
+    // DoP frames are written to the stream directly
+    writePos = 0;
+    while (writePos < streamBytes) {
+        int n = reader.ReadFrames(WWDSOT_Dop, bitsPerSampleType, &pcmData->stream[writePos], 1024 * 1024);
+        if (n <= 0) {
+            goto end;
+        }
+        writePos += n * bytesPerFrame;
+    }
+
     result = 0;
 end:
-    delete [] dsdData;
-    dsdData = nullptr;
-
-    delete [] stream;
-    stream = nullptr;
-
     if (result < 0) {
         if (pcmData) {
             pcmData->Term();
@@ -471,7 +525,6 @@ end:
         }
     }
 
-    fclose(fp);
+    reader.Close();
     return pcmData;
 }
-
@@ -1,5 +1,21 @@
 #pragma once
 
 #include "WWPcmData.h"
+#include "WWDsdStreamReader.h"
 
 WWPcmData * WWReadDsdiffFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmDataStreamAllocType t = WWPDSA_Normal);
+
+/// reads uncompressed DSDIFF sound data chunk sequentially
+class WWDsdiffStreamReader : public WWDsdStreamReader {
+public:
+    WWDsdiffStreamReader(void);
+    virtual ~WWDsdiffStreamReader(void);
+
+    virtual int Open(const char *path);
+    virtual void Close(void);
+    virtual int ReadFrames(WWDsdStreamOutputType ot, WWBitsPerSampleType t, unsigned char *to, int frames);
+
+private:
+    /// native frames read from the file before DoP conversion
+    unsigned char *m_readBuff;
+};
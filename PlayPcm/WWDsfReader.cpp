@@ -1,24 +1,41 @@
 #include "WWDsfReader.h"
+#include "WWDsdToDop.h"
+#include <Windows.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <assert.h>
 
 #define DSD_CHUNK_FOURCC  "DSD "
 #define FMT_CHUNK_FOURCC  "fmt "
 #define DATA_CHUNK_FOURCC "data"
 
+/// DSD chunk (28 bytes) + fmt chunk (52 bytes) + data chunk header (12 bytes)
+#define DSF_HEADER_BYTES (28+52+12)
+
 // assumed target platform is little endian...
-#define FREAD(to, bytes, fp)               \
-    if (fread(to, 1, bytes, fp) < bytes) { \
-        return -1;                         \
+#define MREAD(to, bytes, mr)      \
+    if (!mr.Read(to, bytes)) {    \
+        return -1;                \
     }
 
-static const unsigned char gBitReverse[256] = 
-{
-#   define R2(n)    n,     n + 2*64,     n + 1*64,     n + 3*64
-#   define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
-#   define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
-    R6(0), R6(2), R6(1), R6(3)
+/// reads header fields from the memory mapped file
+struct DsfMemoryReader {
+    const unsigned char *p;
+    int64_t bytes;
+    int64_t pos;
+
+    DsfMemoryReader(const unsigned char *aP, int64_t aBytes) : p(aP), bytes(aBytes), pos(0) {
+    }
+
+    bool Read(void *to, int64_t readBytes) {
+        if (bytes < pos + readBytes) {
+            return false;
+        }
+        memcpy(to, &p[pos], (size_t)readBytes);
+        pos += readBytes;
+        return true;
+    }
 };
 
 struct DsfDsdChunk {
@@ -26,21 +43,16 @@ struct DsfDsdChunk {
     uint64_t totalFileBytes;
     uint64_t medadataOffset;
 
-    int ReadFromFile(FILE *fp) {
-        FREAD(&chunkBytes,     8, fp);
-        FREAD(&totalFileBytes, 8, fp);
-        FREAD(&medadataOffset, 8, fp);
+    int ReadFromMemory(DsfMemoryReader &mr) {
+        MREAD(&chunkBytes,     8, mr);
+        MREAD(&totalFileBytes, 8, mr);
+        MREAD(&medadataOffset, 8, mr);
 
         if (chunkBytes != 28) {
             printf("DSF DSD chunkBytes!=28 %llu\n", chunkBytes);
             return -1;
         }
 
-        if (0x7fffffff < totalFileBytes) {
-            printf("file too large %llu\n", totalFileBytes);
-            return -1;
-        }
-
         return 0;
     }
 };
@@ -58,18 +70,18 @@ struct DsfFmtChunk {
     uint32_t blockSizePerChannel;
     uint32_t reserved;
 
-    int ReadFromFile(FILE *fp) {
-        FREAD(&chunkBytes,     8, fp);
-        FREAD(&formatVersion,  4, fp);
-        FREAD(&formatId,       4, fp);
-        FREAD(&channelType,    4, fp);
-        FREAD(&channelNum,     4, fp);
+    int ReadFromMemory(DsfMemoryReader &mr) {
+        MREAD(&chunkBytes,     8, mr);
+        MREAD(&formatVersion,  4, mr);
+        MREAD(&formatId,       4, mr);
+        MREAD(&channelType,    4, mr);
+        MREAD(&channelNum,     4, mr);
 
-        FREAD(&samplingFrequency,   4, fp);
-        FREAD(&bitsPerSample,       4, fp);
-        FREAD(&sampleCount,         8, fp);
-        FREAD(&blockSizePerChannel, 4, fp);
-        FREAD(&reserved,            4, fp);
+        MREAD(&samplingFrequency,   4, mr);
+        MREAD(&bitsPerSample,       4, mr);
+        MREAD(&sampleCount,         8, mr);
+        MREAD(&blockSizePerChannel, 4, mr);
+        MREAD(&reserved,            4, mr);
 
         if (chunkBytes != 52) {
             printf("DSF fmt chunkBytes!=52 %llu\n", chunkBytes);
@@ -86,18 +98,16 @@ struct DsfFmtChunk {
             return -1;
         }
 
-        if (channelType != 2) {
-            printf("DSF fmt channelType!=2 %u\n", channelType);
+        // channelType 1:mono 2:stereo 3:3ch 4:quad 5:4ch 6:5ch 7:5.1ch
+        static const uint32_t channelNumOfType[] = { 0, 1, 2, 3, 4, 4, 5, 6 };
+        if (channelType < 1 || 7 < channelType || channelNum != channelNumOfType[channelType]) {
+            printf("DSF fmt channelType=%u channelNum=%u is not supported\n", channelType, channelNum);
             return -1;
         }
+        assert(channelNum <= WW_DSD_CHANNEL_MAX);
 
-        if (channelNum != 2) {
-            printf("DSF fmt channelNum!=2 %u\n", channelNum);
-            return -1;
-        }
-
-        if (samplingFrequency != 2822400) {
-            printf("samplingFrequency!=2822400 %u\n", samplingFrequency);
+        if (!WWDsdIsSupportedSampleRate(samplingFrequency)) {
+            printf("DSF fmt samplingFrequency is not supported %u\n", samplingFrequency);
             return -1;
         }
 
@@ -118,11 +128,11 @@ struct DsfFmtChunk {
 struct DsfDataChunk {
     uint64_t chunkBytes;
 
-    int ReadFromFile(FILE *fp) {
-        FREAD(&chunkBytes,     8, fp);
+    int ReadFromMemory(DsfMemoryReader &mr) {
+        MREAD(&chunkBytes,     8, mr);
 
-        if (0x7fffffff < chunkBytes) {
-            printf("DsfDataChunk too large %llu\n", chunkBytes);
+        if (chunkBytes < 12 || mr.bytes < (int64_t)(mr.pos + chunkBytes - 12)) {
+            printf("DsfDataChunk size exceeds the file size %llu\n", chunkBytes);
             return -1;
         }
 
@@ -130,6 +140,64 @@ struct DsfDataChunk {
     }
 };
 
+/// read only memory mapped view of a whole file
+struct DsfMappedFile {
+    HANDLE hFile;
+    HANDLE hMap;
+    const unsigned char *p;
+    int64_t bytes;
+
+    DsfMappedFile(void) : hFile(INVALID_HANDLE_VALUE), hMap(nullptr), p(nullptr), bytes(0) {
+    }
+
+    ~DsfMappedFile(void) {
+        Unmap();
+    }
+
+    bool Map(const char *path) {
+        LARGE_INTEGER fileSize;
+
+        hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (INVALID_HANDLE_VALUE == hFile) {
+            return false;
+        }
+
+        if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+            return false;
+        }
+        bytes = fileSize.QuadPart;
+
+        hMap = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (nullptr == hMap) {
+            printf("CreateFileMapping failed %u\n", GetLastError());
+            return false;
+        }
+
+        p = (const unsigned char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+        if (nullptr == p) {
+            printf("MapViewOfFile failed %u\n", GetLastError());
+            return false;
+        }
+        return true;
+    }
+
+    void Unmap(void) {
+        if (p) {
+            UnmapViewOfFile(p);
+            p = nullptr;
+        }
+        if (hMap) {
+            CloseHandle(hMap);
+            hMap = nullptr;
+        }
+        if (INVALID_HANDLE_VALUE != hFile) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+};
+
 WWPcmData *
 WWReadDsfFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmDataStreamAllocType allocType)
 {
@@ -138,11 +206,13 @@ WWReadDsfFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmData
     DsfDsdChunk  dsdChunk;
     DsfFmtChunk  fmtChunk;
     DsfDataChunk dataChunk;
+    DsfMappedFile mf;
     int64_t streamBytes;
     int64_t writePos;
-    uint32_t blockNum;
-    unsigned char *blockData = nullptr;
-    unsigned char *stream = nullptr;
+    int64_t blockNum;
+    int64_t blockBytes;
+    int64_t remainFrames;
+    const unsigned char *dsdData = nullptr;
     int result = -1;
 
     if (bitsPerSampleType == WWBpsNone) {
@@ -150,30 +220,33 @@ WWReadDsfFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmData
         return nullptr;
     }
 
-    FILE *fp = nullptr;
-    fopen_s(&fp, path, "rb");
-    if (nullptr == fp) {
+    if (!mf.Map(path)) {
         return nullptr;
     }
 
-    if (fread(fourCC, 1, 4, fp) < 4 ||
+    DsfMemoryReader mr(mf.p, mf.bytes);
+
+    if (!mr.Read(fourCC, 4) ||
         0 != memcmp(fourCC, DSD_CHUNK_FOURCC, 4) ||
-        dsdChunk.ReadFromFile(fp) < 0) {
+        dsdChunk.ReadFromMemory(mr) < 0) {
         goto end;
     }
 
-    if (fread(fourCC, 1, 4, fp) < 4 ||
+    if (!mr.Read(fourCC, 4) ||
         0 != memcmp(fourCC, FMT_CHUNK_FOURCC, 4) ||
-        fmtChunk.ReadFromFile(fp) < 0) {
+        fmtChunk.ReadFromMemory(mr) < 0) {
         goto end;
     }
 
-    if (fread(fourCC, 1, 4, fp) < 4 ||
+    if (!mr.Read(fourCC, 4) ||
         0 != memcmp(fourCC, DATA_CHUNK_FOURCC, 4) ||
-        dataChunk.ReadFromFile(fp) < 0) {
+        dataChunk.ReadFromMemory(mr) < 0) {
         goto end;
     }
 
+    // DSD data is read directly from the mapped view
+    dsdData = &mf.p[mr.pos];
+
     pcmData = new WWPcmData();
     if (nullptr == pcmData) {
         goto end;
@@ -186,84 +259,42 @@ WWReadDsfFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmData
 
     // DSD 16bit == 1 frame
     pcmData->nFrames        = fmtChunk.sampleCount/16;
-    pcmData->nSamplesPerSec = 176400;
+    pcmData->nSamplesPerSec = fmtChunk.samplingFrequency/16;
     pcmData->posFrame       = 0;
 
-    streamBytes = (pcmData->bitsPerSample/8) * pcmData->nFrames * pcmData->nChannels;
-    stream = new unsigned char[streamBytes];
-    if (nullptr == stream) {
+    blockBytes = (int64_t)fmtChunk.blockSizePerChannel * fmtChunk.channelNum;
+    blockNum   = (int64_t)(dataChunk.chunkBytes-12)/blockBytes;
+    if (blockNum * (fmtChunk.blockSizePerChannel/2) < pcmData->nFrames) {
+        printf("DSF data chunk is too small. sampleCount=%llu\n", fmtChunk.sampleCount);
         goto end;
     }
-    memset(stream, 0, streamBytes);
 
-    blockNum = (uint32_t)((dataChunk.chunkBytes-12)/fmtChunk.blockSizePerChannel);
-    blockData = new unsigned char[fmtChunk.blockSizePerChannel * fmtChunk.channelNum];
-    if (nullptr == blockData) {
+    // DoP frames are written to the stream directly
+    streamBytes = (pcmData->bitsPerSample/8) * pcmData->nFrames * pcmData->nChannels;
+    if (!pcmData->AllocStream(streamBytes)) {
+        printf("pcmData->AllocStream() failed\n");
         goto end;
     }
 
     writePos = 0;
-    for (uint32_t block = 0; block < blockNum; ++block) {
+    remainFrames = pcmData->nFrames;
+    for (int64_t block = 0; block < blockNum && 0 < remainFrames; ++block) {
         // data is stored in following order:
         // L channel 4096bytes consecutive data, R channel 4096bytes consecutive data, L channel 4096bytes consecutive data, ...
         //
-        // read 4096 x numChannels bytes.
-        if (fread(blockData, fmtChunk.blockSizePerChannel * fmtChunk.channelNum, 1, fp) < 1) {
-            goto end;
+        // recorded sample may end on part of the way of the last block
+        int frames = (int)fmtChunk.blockSizePerChannel/2;
+        if (remainFrames < frames) {
+            frames = (int)remainFrames;
         }
 
-        switch (bitsPerSampleType) {
-        case WWBps32v24:
-            for (uint32_t i=0; i<fmtChunk.blockSizePerChannel/2; ++i) {
-                for (uint32_t ch=0; ch<fmtChunk.channelNum; ++ch) {
-                    stream[writePos+0] = 0;
-                    stream[writePos+1] = gBitReverse[blockData[i*2+1 + ch*fmtChunk.blockSizePerChannel]];
-                    stream[writePos+2] = gBitReverse[blockData[i*2+0 + ch*fmtChunk.blockSizePerChannel]];
-                    stream[writePos+3] = i & 1 ? 0xfa : 0x05;
-                    writePos += 4;
-                    if (streamBytes <= writePos) {
-                        // recorded sample is ended on part of the way of the block
-                        result = 0;
-                        goto end;
-                    }
-                }
-            }
-            break;
-        case WWBps24:
-            for (uint32_t i=0; i<fmtChunk.blockSizePerChannel/2; ++i) {
-                for (uint32_t ch=0; ch<fmtChunk.channelNum; ++ch) {
-                    stream[writePos+0] = gBitReverse[blockData[i*2+1 + ch*fmtChunk.blockSizePerChannel]];
-                    stream[writePos+1] = gBitReverse[blockData[i*2+0 + ch*fmtChunk.blockSizePerChannel]];
-                    stream[writePos+2] = i & 1 ? 0xfa : 0x05;
-                    writePos += 3;
-                    if (streamBytes <= writePos) {
-                        // recorded sample is ended on part of the way of the block
-                        result = 0;
-                        goto end;
-                    }
-                }
-            }
-            break;
-        }
+        writePos += WWDsfBlockToDop(&dsdData[block * blockBytes], fmtChunk.blockSizePerChannel,
+                fmtChunk.channelNum, 0, frames, bitsPerSampleType, &pcmData->stream[writePos]);
+        remainFrames -= frames;
     }
 
-    // coincidentally block size == recorded sample size
     result = 0;
 end:
-    if (result == 0) {
-        // succeeded
-        if (!pcmData->StoreStream(stream, streamBytes)) {
-            printf("pcmData->StoreStream() failed\n");
-            result = -1;
-        }
-    }
-
-    delete [] blockData;
-    blockData = nullptr;
-
-    delete [] stream;
-    stream = nullptr;
-
     if (result < 0) {
         if (pcmData) {
             pcmData->Term();
@@ -272,7 +303,160 @@ end:
         }
     }
 
-    fclose(fp);
+    mf.Unmap();
     return pcmData;
 }
 
+
+///////////////////////////////////////////////////////////////////////
+// WWDsfStreamReader
+
+WWDsfStreamReader::WWDsfStreamReader(void)
+    : m_block(nullptr), m_blockSizePerChannel(0), m_blockPosFrame(0)
+{
+}
+
+WWDsfStreamReader::~WWDsfStreamReader(void)
+{
+    Close();
+}
+
+int
+WWDsfStreamReader::Open(const char *path)
+{
+    unsigned char header[DSF_HEADER_BYTES];
+    char fourCC[4];
+    DsfDsdChunk  dsdChunk;
+    DsfFmtChunk  fmtChunk;
+    DsfDataChunk dataChunk;
+    int64_t fileBytes;
+
+    assert(nullptr == m_fp);
+
+    fopen_s(&m_fp, path, "rb");
+    if (nullptr == m_fp) {
+        return -1;
+    }
+
+    _fseeki64(m_fp, 0, SEEK_END);
+    fileBytes = _ftelli64(m_fp);
+    _fseeki64(m_fp, 0, SEEK_SET);
+
+    if (fread(header, 1, sizeof header, m_fp) < sizeof header) {
+        goto fail;
+    }
+
+    {
+        DsfMemoryReader mr(header, fileBytes);
+
+        if (!mr.Read(fourCC, 4) ||
+            0 != memcmp(fourCC, DSD_CHUNK_FOURCC, 4) ||
+            dsdChunk.ReadFromMemory(mr) < 0) {
+            goto fail;
+        }
+
+        if (!mr.Read(fourCC, 4) ||
+            0 != memcmp(fourCC, FMT_CHUNK_FOURCC, 4) ||
+            fmtChunk.ReadFromMemory(mr) < 0) {
+            goto fail;
+        }
+
+        if (!mr.Read(fourCC, 4) ||
+            0 != memcmp(fourCC, DATA_CHUNK_FOURCC, 4) ||
+            dataChunk.ReadFromMemory(mr) < 0) {
+            goto fail;
+        }
+        assert(mr.pos == DSF_HEADER_BYTES);
+    }
+
+    m_numChannels         = fmtChunk.channelNum;
+    m_dsdSampleRate       = fmtChunk.samplingFrequency;
+    m_blockSizePerChannel = fmtChunk.blockSizePerChannel;
+    m_totalFrames         = fmtChunk.sampleCount/16;
+    m_posFrame            = 0;
+
+    m_block = new unsigned char[m_blockSizePerChannel * m_numChannels];
+
+    // m_block is empty
+    m_blockPosFrame = m_blockSizePerChannel/2;
+    return 0;
+
+fail:
+    Close();
+    return -1;
+}
+
+void
+WWDsfStreamReader::Close(void)
+{
+    delete [] m_block;
+    m_block = nullptr;
+
+    WWDsdStreamReader::Close();
+}
+
+bool
+WWDsfStreamReader::ReadNextBlock(void)
+{
+    size_t blockBytes = (size_t)m_blockSizePerChannel * m_numChannels;
+
+    size_t readBytes = fread(m_block, 1, blockBytes, m_fp);
+    if (readBytes == 0) {
+        printf("DSF data ended before sampleCount\n");
+        return false;
+    }
+    if (readBytes < blockBytes) {
+        // the last block is truncated
+        memset(&m_block[readBytes], 0, blockBytes - readBytes);
+    }
+
+    m_blockPosFrame = 0;
+    return true;
+}
+
+int
+WWDsfStreamReader::ReadFrames(WWDsdStreamOutputType ot, WWBitsPerSampleType t, unsigned char *to, int frames)
+{
+    const int framesPerBlock = m_blockSizePerChannel/2;
+    const int bytesPerFrame  = m_numChannels * WWDsdStreamBytesPerSample(ot, t);
+    int pos = 0;
+
+    assert(m_fp);
+    assert(0 < bytesPerFrame);
+
+    while (pos < frames && m_posFrame < m_totalFrames) {
+        if (framesPerBlock <= m_blockPosFrame) {
+            if (!ReadNextBlock()) {
+                return -1;
+            }
+        }
+
+        int n = framesPerBlock - m_blockPosFrame;
+        if (frames - pos < n) {
+            n = frames - pos;
+        }
+        if (m_totalFrames - m_posFrame < n) {
+            n = (int)(m_totalFrames - m_posFrame);
+        }
+
+        unsigned char *w = &to[(int64_t)pos * bytesPerFrame];
+        switch (ot) {
+        case WWDSOT_Dop:
+            WWDsfBlockToDop(m_block, m_blockSizePerChannel, m_numChannels, m_blockPosFrame, n, t, w);
+            break;
+        case WWDSOT_Native:
+            WWDsfBlockToNative(m_block, m_blockSizePerChannel, m_numChannels, m_blockPosFrame, n, w);
+            break;
+        default:
+            assert(0);
+            return -1;
+        }
+
+        m_blockPosFrame += n;
+        m_posFrame      += n;
+        pos             += n;
+    }
+
+    return pos;
+}
+
@@ -1,5 +1,26 @@
 #pragma once
 
 #include "WWPcmData.h"
+#include "WWDsdStreamReader.h"
 
 WWPcmData * WWReadDsfFile(const char *path, WWBitsPerSampleType bitsPerSampleType, WWPcmDataStreamAllocType t = WWPDSA_Normal);
+
+/// reads DSF file one block (blockSizePerChannel * numChannels bytes) at a time
+class WWDsfStreamReader : public WWDsdStreamReader {
+public:
+    WWDsfStreamReader(void);
+    virtual ~WWDsfStreamReader(void);
+
+    virtual int Open(const char *path);
+    virtual void Close(void);
+    virtual int ReadFrames(WWDsdStreamOutputType ot, WWBitsPerSampleType t, unsigned char *to, int frames);
+
+private:
+    unsigned char *m_block;
+    int m_blockSizePerChannel;
+
+    /// read position in m_block in frames
+    int m_blockPosFrame;
+
+    bool ReadNextBlock(void);
+};
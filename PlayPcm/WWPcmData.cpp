@@ -70,10 +70,18 @@ AllocStreamMemory(WWPcmDataStreamAllocType t, int64_t bytes)
 }
 
 bool
-WWPcmData::StoreStream(const unsigned char *aStream, int64_t bytes)
+WWPcmData::AllocStream(int64_t bytes)
 {
+    assert(nullptr == stream);
+
     stream = AllocStreamMemory(allocType, bytes);
-    if (nullptr == stream) {
+    return nullptr != stream;
+}
+
+bool
+WWPcmData::StoreStream(const unsigned char *aStream, int64_t bytes)
+{
+    if (!AllocStream(bytes)) {
         return false;
     }
     memcpy(stream, aStream, bytes);
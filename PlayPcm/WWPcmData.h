@@ -27,6 +27,10 @@ struct WWPcmData {
     void Init(WWPcmDataStreamAllocType t = WWPDSA_Normal);
     void Term(void);
 
+    /// allocates stream of specified bytes. contents are not initialized.
+    /// use this when writing the sample data directly into the stream.
+    bool AllocStream(int64_t bytes);
+
     bool StoreStream(const unsigned char *aStream, int64_t bytes);
 
     WWPcmData(void) {
@@ -69,6 +69,7 @@ WasapiWrap::WasapiWrap(void)
     m_renderClient     = nullptr;
     m_renderThread     = nullptr;
     m_pcmData          = nullptr;
+    m_stream           = nullptr;
     m_mutex            = nullptr;
     m_footerCount      = 0;
     m_coInitializeSuccess = false;
@@ -418,6 +419,14 @@ void
 WasapiWrap::SetOutputData(WWPcmData &pcmData)
 {
     m_pcmData = &pcmData;
+    m_stream  = nullptr;
+}
+
+void
+WasapiWrap::SetOutputStream(WWDsdStreamBuffer &stream)
+{
+    m_pcmData = nullptr;
+    m_stream  = &stream;
 }
 
 HRESULT
@@ -426,7 +435,7 @@ WasapiWrap::Start(void)
     BYTE *pData = nullptr;
     HRESULT hr = 0;
 
-    assert(m_pcmData);
+    assert(m_pcmData || m_stream);
 
     assert(!m_shutdownEvent);
     m_shutdownEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
@@ -508,6 +517,10 @@ WasapiWrap::RenderEntry(LPVOID lpThreadParameter)
 int64_t
 WasapiWrap::GetTotalFrameNum(void)
 {
+    if (m_stream) {
+        return m_stream->TotalFrames();
+    }
+
     if (!m_pcmData) {
         return 0;
     }
@@ -515,10 +528,10 @@ WasapiWrap::GetTotalFrameNum(void)
     return m_pcmData->nFrames;
 }
 
-int
+int64_t
 WasapiWrap::GetPosFrame(void)
 {
-    int result = 0;
+    int64_t result = 0;
 
     assert(m_mutex);
 
@@ -526,6 +539,9 @@ WasapiWrap::GetPosFrame(void)
     if (m_pcmData) {
         result = m_pcmData->posFrame;
     }
+    if (m_stream) {
+        result = m_stream->PosFrame();
+    }
     ReleaseMutex(m_mutex);
 
     return result;
@@ -534,6 +550,11 @@ WasapiWrap::GetPosFrame(void)
 bool
 WasapiWrap::SetPosFrame(int v)
 {
+    if (m_stream) {
+        // stream buffer is read sequentially
+        return false;
+    }
+
     if (v < 0 || GetTotalFrameNum() <= v) {
         return false;
     }
@@ -560,6 +581,11 @@ WasapiWrap::AudioSamplesReadyProc(void)
 
     WaitForSingleObject(m_mutex, INFINITE);
 
+    if (m_stream) {
+        result = AudioSamplesReadyFromStream();
+        goto end;
+    }
+
     copyFrames = m_bufferFrameNum;
     if (m_pcmData->nFrames < m_pcmData->posFrame + copyFrames) {
         copyFrames = (int)(m_pcmData->nFrames - m_pcmData->posFrame);
@@ -606,6 +632,42 @@ end:
     return result;
 }
 
+/// called with m_mutex held
+bool
+WasapiWrap::AudioSamplesReadyFromStream(void)
+{
+    BYTE    *pData     = nullptr;
+    HRESULT hr         = 0;
+    int     copyFrames = 0;
+
+    assert(m_renderClient);
+    hr = m_renderClient->GetBuffer(m_bufferFrameNum, &pData);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    // frames are copied from the ring buffer. file read is done on the reader thread
+    copyFrames = m_stream->GetFrames(pData, m_bufferFrameNum);
+    if (0 < m_bufferFrameNum - copyFrames) {
+        memset(&pData[copyFrames*m_frameBytes], 0,
+            (m_bufferFrameNum - copyFrames)*m_frameBytes);
+    }
+
+    hr = m_renderClient->ReleaseBuffer(m_bufferFrameNum, 0);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    if (m_stream->IsEnd()) {
+        ++m_footerCount;
+        if (FOOTER_SEND_PACKET_NUM < m_footerCount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 DWORD
 WasapiWrap::RenderMain(void)
 {
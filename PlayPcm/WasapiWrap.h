@@ -6,6 +6,7 @@
 #include <AudioPolicy.h>
 #include <vector>
 #include "WWPcmData.h"
+#include "WWDsdStreamBuffer.h"
 
 #define WW_DEVICE_NAME_COUNT (256)
 
@@ -72,6 +73,10 @@ public:
 
     void SetOutputData(WWPcmData &pcmData);
 
+    /// plays frames from the stream buffer instead of WWPcmData.
+    /// the stream buffer should be started before Start()
+    void SetOutputStream(WWDsdStreamBuffer &stream);
+
     HRESULT Start(void);
 
     bool Run(int millisec);
@@ -81,7 +86,7 @@ public:
     void PrintMixFormat(void);
     int Inspect(const WWInspectArg & arg);
 
-    int GetPosFrame(void);
+    int64_t GetPosFrame(void);
     int64_t GetTotalFrameNum(void);
     bool SetPosFrame(int v);
 
@@ -103,6 +108,7 @@ private:
     IAudioRenderClient *m_renderClient;
     HANDLE       m_renderThread;
     WWPcmData    *m_pcmData;
+    WWDsdStreamBuffer *m_stream;
     HANDLE       m_mutex;
     int          m_footerCount;
     bool         m_coInitializeSuccess;
@@ -112,5 +118,6 @@ private:
     DWORD RenderMain(void);
 
     bool AudioSamplesReadyProc(void);
+    bool AudioSamplesReadyFromStream(void);
 };
 
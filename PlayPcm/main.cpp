@@ -3,6 +3,10 @@
 #include "WWWavReader.h"
 #include "WWDsfReader.h"
 #include "WWDsdiffReader.h"
+#include "WWDsdStreamReader.h"
+#include "WWDsdStreamBuffer.h"
+#include "WWDsdDecimator.h"
+#include "WWDsdModulator.h"
 #include "WWPrivilegeControl.h"
 
 #include <stdio.h>
@@ -13,6 +17,22 @@
 
 #define LATENCY_MILLISEC_DEFAULT (100)
 #define READ_LINE_BYTES          (256)
+#define BENCHMARK_REPEAT_COUNT   (5)
+
+/// DSD to PCM benchmark reads this duration from the start of the file
+#define BENCHMARK_DECIMATION_SEC (60)
+
+/// DSD to PCM benchmark passes this number of DSD bytes per channel to WWDsdDecimator::Process()
+#define BENCHMARK_DECIMATION_BYTES (65536)
+
+/// PCM to DSD benchmark reads this duration from the start of the file
+#define BENCHMARK_MODULATION_SEC (10)
+
+/// PCM to DSD benchmark passes this number of PCM frames to WWDsdModulator::Process()
+#define BENCHMARK_MODULATION_FRAMES (4096)
+
+/// DSD files are played from the ring buffer of this duration
+#define STREAM_BUFFER_SEC        (2)
 
 static void
 PrintUsage(void)
@@ -32,6 +52,11 @@ PrintUsage(void)
         "            PlayPcm -d 1 C:\\audio\\music.wav\n"
         "            PlayPcm -d 1 C:\\audio\\music.dsf\n"
         "            PlayPcm -d 1 C:\\audio\\music.dff\n"
+        "        DSF and DSDIFF files (DSD64 to DSD512, up to 6 channels) are streamed from the disk as DoP\n"
+        "\n"
+        "    PlayPcm -benchmark [-uselargememory] input_file_name\n"
+        "        DSF file: Measure DSF to DoP read throughput and DSD to PCM conversion speed\n"
+        "        WAV file: Measure PCM to DSD64, DSD128 and DSD256 conversion speed\n"
         );
 }
 
@@ -97,8 +122,9 @@ struct Settings {
     int latencyMillisec;
     const char *path;
     WWPcmDataStreamAllocType allocType;
+    bool benchmark;
 
-    Settings(void) : deviceId(-1), latencyMillisec(LATENCY_MILLISEC_DEFAULT), path(nullptr), allocType(WWPDSA_Normal) {
+    Settings(void) : deviceId(-1), latencyMillisec(LATENCY_MILLISEC_DEFAULT), path(nullptr), allocType(WWPDSA_Normal), benchmark(false) {
     }
 };
 
@@ -119,7 +145,7 @@ Run(const Settings &settings, WWPcmData &pcm)
     ww.Start();
 
     while (!ww.Run(1000)) {
-        printf("%d / %d\n", ww.GetPosFrame(), ww.GetTotalFrameNum());
+        printf("%lld / %lld\n", ww.GetPosFrame(), ww.GetTotalFrameNum());
     }
     hr = S_OK;
 
@@ -130,6 +156,40 @@ end:
     return hr;
 }
 
+/// plays DSD stream as DoP. memory usage is bounded by the ring buffer size.
+static HRESULT
+RunStream(const Settings &settings, WWDsdStreamReader &reader, WWBitsPerSampleType bitsPerSampleType)
+{
+    HRESULT hr;
+    WasapiWrap ww;
+    WWDsdStreamBuffer stream;
+    int bitsPerSample = bitsPerSampleType == WWBps32v24 ? 32 : 24;
+
+    HRR(ww.Init());
+    HRG(ww.DoDeviceEnumeration());
+    HRG(ww.ChooseDevice(settings.deviceId));
+
+    WWSetupArg setupArg;
+    setupArg.Set(bitsPerSample, 24, reader.DopSampleRate(), reader.NumChannels(), settings.latencyMillisec);
+    HRG(ww.Setup(setupArg));
+
+    HRG(stream.Start(&reader, WWDSOT_Dop, bitsPerSampleType, reader.DopSampleRate() * STREAM_BUFFER_SEC));
+    ww.SetOutputStream(stream);
+    ww.Start();
+
+    while (!ww.Run(1000)) {
+        printf("%lld / %lld underrun=%d\n", ww.GetPosFrame(), ww.GetTotalFrameNum(), stream.UnderrunCount());
+    }
+    hr = S_OK;
+
+end:
+    ww.Stop();
+    stream.Stop();
+    ww.Unsetup();
+    ww.Term();
+    return hr;
+}
+
 static HRESULT
 Test(int deviceId)
 {
@@ -161,8 +221,226 @@ end:
     return hr;
 }
 
+/// reads the DSF file several times and prints the throughput of each DoP format.
+static void
+Benchmark(const Settings &settings)
+{
+    static const WWBitsPerSampleType bpsTypes[] = { WWBps32v24, WWBps24 };
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    for (int t=0; t<(int)(sizeof bpsTypes/sizeof bpsTypes[0]); ++t) {
+        double bestSec = 0;
+        int64_t dsdBytes = 0;
+        double playSec = 0;
+
+        for (int i=0; i<BENCHMARK_REPEAT_COUNT; ++i) {
+            LARGE_INTEGER before, after;
+
+            QueryPerformanceCounter(&before);
+            WWPcmData *pcmData = WWReadDsfFile(settings.path, bpsTypes[t], settings.allocType);
+            QueryPerformanceCounter(&after);
+
+            if (nullptr == pcmData) {
+                printf("E: read file failed %s\n", settings.path);
+                return;
+            }
+
+            double sec = (double)(after.QuadPart - before.QuadPart) / freq.QuadPart;
+            if (i == 0 || sec < bestSec) {
+                bestSec = sec;
+            }
+
+            // 1 frame == 16 DSD bits per channel
+            dsdBytes = pcmData->nFrames * 2 * pcmData->nChannels;
+            playSec  = (double)pcmData->nFrames / pcmData->nSamplesPerSec;
+
+            pcmData->Term();
+            delete pcmData;
+            pcmData = nullptr;
+        }
+
+        printf("%s: DSD %lld Mbytes, best of %d: %.3f sec, %.1f Mbytes/sec, %.1fx realtime\n",
+                bpsTypes[t] == WWBps32v24 ? "DoP 32v24" : "DoP 24",
+                dsdBytes / 1024 / 1024, BENCHMARK_REPEAT_COUNT, bestSec,
+                dsdBytes / bestSec / 1024 / 1024, playSec / bestSec);
+    }
+}
+
+/// converts DSD to 88.2kHz, 176.4kHz and 352.8kHz PCM and prints the speed.
+static void
+BenchmarkDecimation(const Settings &settings)
+{
+    static const int pcmSampleRates[] = { 88200, 176400, 352800 };
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    WWDsdStreamReader *reader = WWDsdStreamReaderOpen(settings.path);
+    if (nullptr == reader) {
+        printf("E: read file failed %s\n", settings.path);
+        return;
+    }
+
+    const int numChannels = reader->NumChannels();
+    int64_t frames = (int64_t)reader->DopSampleRate() * BENCHMARK_DECIMATION_SEC;
+    if (reader->TotalFrames() < frames) {
+        frames = reader->TotalFrames();
+    }
+
+    // native DSD is read on memory before the measurement
+    unsigned char *dsd = new unsigned char[frames * 2 * numChannels];
+    int64_t readFrames = 0;
+    while (readFrames < frames) {
+        int want = (int)(frames - readFrames < 1024 * 1024 ? frames - readFrames : 1024 * 1024);
+        int n = reader->ReadFrames(WWDSOT_Native, WWBpsNone, &dsd[readFrames * 2 * numChannels], want);
+        if (n <= 0) {
+            break;
+        }
+        readFrames += n;
+    }
+
+    const int64_t dsdBytesPerChannel = readFrames * 2;
+    const double playSec = (double)readFrames / reader->DopSampleRate();
+
+    for (int r=0; r<(int)(sizeof pcmSampleRates/sizeof pcmSampleRates[0]); ++r) {
+        int decimation = WWDsdDecimationRatio(reader->DsdSampleRate(), pcmSampleRates[r]);
+        if (0 == decimation) {
+            continue;
+        }
+
+        WWDsdDecimator decimator;
+        decimator.Init(decimation, numChannels);
+        float *pcm = new float[decimator.MaxOutputFrames(BENCHMARK_DECIMATION_BYTES) * numChannels];
+        double bestSec = 0;
+
+        for (int i=0; i<BENCHMARK_REPEAT_COUNT; ++i) {
+            LARGE_INTEGER before, after;
+
+            decimator.Reset();
+            QueryPerformanceCounter(&before);
+            for (int64_t pos=0; pos<dsdBytesPerChannel; pos += BENCHMARK_DECIMATION_BYTES) {
+                int n = BENCHMARK_DECIMATION_BYTES;
+                if (dsdBytesPerChannel - pos < n) {
+                    n = (int)(dsdBytesPerChannel - pos);
+                }
+                decimator.Process(&dsd[pos * numChannels], n, pcm);
+            }
+            QueryPerformanceCounter(&after);
+
+            double sec = (double)(after.QuadPart - before.QuadPart) / freq.QuadPart;
+            if (i == 0 || sec < bestSec) {
+                bestSec = sec;
+            }
+        }
+
+        printf("DSD%d to PCM %dHz %dch: %.1f sec of DSD, best of %d: %.3f sec, %.1fx realtime\n",
+                reader->DsdSampleRate() / 44100, pcmSampleRates[r], numChannels,
+                playSec, BENCHMARK_REPEAT_COUNT, bestSec, playSec / bestSec);
+
+        delete [] pcm;
+        pcm = nullptr;
+        decimator.Term();
+    }
+
+    delete [] dsd;
+    dsd = nullptr;
+
+    reader->Close();
+    delete reader;
+    reader = nullptr;
+}
+
+/// @return sample value of the WAV file. full scale is 1.0f
+static float
+PcmSampleValue(const WWPcmData &pcm, int64_t frame, int ch)
+{
+    const int bytesPerSample = pcm.bitsPerSample / 8;
+    const unsigned char *p = &pcm.stream[(frame * pcm.nChannels + ch) * bytesPerSample];
+
+    switch (pcm.bitsPerSample) {
+    case 16:
+        return (short)(p[0] + (p[1] << 8)) * (1.0f / 32768.0f);
+    case 24:
+        return (int)((p[0] << 8) + (p[1] << 16) + ((unsigned int)p[2] << 24)) * (1.0f / 2147483648.0f);
+    case 32:
+        return (int)(p[0] + (p[1] << 8) + (p[2] << 16) + ((unsigned int)p[3] << 24)) * (1.0f / 2147483648.0f);
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+/// converts PCM to DSD64, DSD128 and DSD256 with 5th and 7th order modulator and prints the speed.
+/// stereo is modulated on one thread.
+static void
+BenchmarkModulation(const WWPcmData &pcmData)
+{
+    static const int orders[] = { 5, 7 };
+    static const int dsdSampleRates[] = { 2822400, 5644800, 11289600 };
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    const int numChannels = pcmData.nChannels;
+    int64_t frames = (int64_t)pcmData.nSamplesPerSec * BENCHMARK_MODULATION_SEC;
+    if (pcmData.nFrames < frames) {
+        frames = pcmData.nFrames;
+    }
+    const double playSec = (double)frames / pcmData.nSamplesPerSec;
+
+    float *pcm = new float[frames * numChannels];
+    for (int64_t i=0; i<frames; ++i) {
+        for (int ch=0; ch<numChannels; ++ch) {
+            pcm[i * numChannels + ch] = PcmSampleValue(pcmData, i, ch);
+        }
+    }
+
+    for (int d=0; d<(int)(sizeof dsdSampleRates/sizeof dsdSampleRates[0]); ++d) {
+        for (int o=0; o<(int)(sizeof orders/sizeof orders[0]); ++o) {
+            WWDsdModulator modulator;
+            if (modulator.Init(orders[o], pcmData.nSamplesPerSec, dsdSampleRates[d], numChannels) < 0) {
+                printf("E: PCM %dHz to DSD%d is not supported\n", pcmData.nSamplesPerSec, dsdSampleRates[d] / 44100);
+                continue;
+            }
+
+            unsigned char *dsd = new unsigned char[BENCHMARK_MODULATION_FRAMES * modulator.Upsample() / 8 * numChannels];
+            double bestSec = 0;
+
+            for (int i=0; i<BENCHMARK_REPEAT_COUNT; ++i) {
+                LARGE_INTEGER before, after;
+
+                modulator.Reset();
+                QueryPerformanceCounter(&before);
+                for (int64_t pos=0; pos<frames; pos += BENCHMARK_MODULATION_FRAMES) {
+                    int n = BENCHMARK_MODULATION_FRAMES;
+                    if (frames - pos < n) {
+                        n = (int)(frames - pos);
+                    }
+                    modulator.Process(&pcm[pos * numChannels], n, dsd);
+                }
+                QueryPerformanceCounter(&after);
+
+                double sec = (double)(after.QuadPart - before.QuadPart) / freq.QuadPart;
+                if (i == 0 || sec < bestSec) {
+                    bestSec = sec;
+                }
+            }
+
+            printf("PCM %dHz to DSD%d %dch order %d: %.1f sec of PCM, best of %d: %.3f sec, %.1fx realtime, unstable %lld\n",
+                    pcmData.nSamplesPerSec, dsdSampleRates[d] / 44100, numChannels, orders[o],
+                    playSec, BENCHMARK_REPEAT_COUNT, bestSec, playSec / bestSec, (long long)modulator.UnstableCount());
+
+            delete [] dsd;
+            dsd = nullptr;
+            modulator.Term();
+        }
+    }
+
+    delete [] pcm;
+    pcm = nullptr;
+}
+
 static WWBitsPerSampleType
-InspectDeviceBitsPerSample(int deviceId)
+InspectDeviceBitsPerSample(int deviceId, int sampleRate, int numChannels)
 {
     HRESULT hr;
     WWBitsPerSampleType deviceBitsPerSample = WWBpsNone;
@@ -174,12 +452,12 @@ InspectDeviceBitsPerSample(int deviceId)
 
     WWInspectArg inspectArg;
 
-    inspectArg.Set(32, 24, 176400, 2);
+    inspectArg.Set(32, 24, sampleRate, numChannels);
     if (SUCCEEDED(ww.Inspect(inspectArg))) {
         deviceBitsPerSample = WWBps32v24;
     }
 
-    inspectArg.Set(24, 24, 176400, 2);
+    inspectArg.Set(24, 24, sampleRate, numChannels);
     if (SUCCEEDED(ww.Inspect(inspectArg))) {
         deviceBitsPerSample = WWBps24;
     }
@@ -195,6 +473,7 @@ enum CommandlineOptionType {
     COT_DEVICE,
     COT_LATENCY,
     COT_LARGEMEM,
+    COT_BENCHMARK,
 
     COT_NUM
 };
@@ -203,6 +482,7 @@ const char *gCommandLineStrArray[] = {
     "-d",
     "-l",
     "-uselargememory",
+    "-benchmark",
 };
 
 static CommandlineOptionType
@@ -224,7 +504,7 @@ ParseCommandline(int argc, char *argv[], Settings &settings_return)
         CommandlineOptionType cot = StringToCommandlineOptionType(argv[i]);
         switch (cot) {
         case COT_OTHER:
-            if (i != argc-1 || settings_return.deviceId < 0) {
+            if (i != argc-1 || (settings_return.deviceId < 0 && !settings_return.benchmark)) {
                 // filepath must be the last argument
                 PrintUsage();
                 PrintDeviceList();
@@ -243,6 +523,9 @@ ParseCommandline(int argc, char *argv[], Settings &settings_return)
         case COT_LARGEMEM:
             settings_return.allocType = WWPDSA_LargeMemory;
             break;
+        case COT_BENCHMARK:
+            settings_return.benchmark = true;
+            break;
         default:
             assert(false);
             break;
@@ -264,6 +547,7 @@ int
 main(int argc, char *argv[])
 {
     WWPcmData *pcmData = nullptr;
+    WWDsdStreamReader *dsdReader = nullptr;
     Settings settings;
     WWBitsPerSampleType bitsPerSampleType = WWBpsNone;
     WWPrivilegeControl pc;
@@ -284,19 +568,39 @@ main(int argc, char *argv[])
         printf("use MEM_LARGE_PAGES. page size = %d bytes\n", (int)GetLargePageMinimum());
     }
 
-    bitsPerSampleType = InspectDeviceBitsPerSample(settings.deviceId);
+    if (settings.benchmark) {
+        // WAV: PCM to DSD. DSF: DSD read and DSD to PCM
+        pcmData = WWReadWavFile(settings.path, settings.allocType);
+        if (nullptr != pcmData) {
+            BenchmarkModulation(*pcmData);
+        } else {
+            Benchmark(settings);
+            BenchmarkDecimation(settings);
+        }
+        goto end;
+    }
 
     settings.path = argv[argc-1];
     pcmData = WWReadWavFile(settings.path, settings.allocType);
     if (nullptr == pcmData) {
-        pcmData = WWReadDsfFile(settings.path, bitsPerSampleType, settings.allocType);
-        if (nullptr == pcmData) {
-            pcmData = WWReadDsdiffFile(settings.path, bitsPerSampleType, settings.allocType);
-            if (nullptr == pcmData) {
-                printf("E: read file failed %s\n", settings.path);
-                goto end;
-            }
+        // DSF or DSDIFF is not loaded on memory. it is read while playing
+        dsdReader = WWDsdStreamReaderOpen(settings.path);
+        if (nullptr == dsdReader) {
+            printf("E: read file failed %s\n", settings.path);
+            goto end;
+        }
+
+        bitsPerSampleType = InspectDeviceBitsPerSample(settings.deviceId, dsdReader->DopSampleRate(), dsdReader->NumChannels());
+        if (bitsPerSampleType == WWBpsNone) {
+            printf("E: device does not support DoP %dHz %dch\n", dsdReader->DopSampleRate(), dsdReader->NumChannels());
+            goto end;
+        }
+
+        HRESULT hr = RunStream(settings, *dsdReader, bitsPerSampleType);
+        if (FAILED(hr)) {
+            printf("E: RunStream failed (%08x)\n", hr);
         }
+        goto end;
     }
 
     switch (settings.allocType) {
@@ -316,13 +620,19 @@ main(int argc, char *argv[])
         printf("E: Run failed (%08x)\n", hr);
     }
 
+end:
     if (nullptr != pcmData) {
         pcmData->Term();
         delete pcmData;
         pcmData = nullptr;
     }
 
-end:
+    if (nullptr != dsdReader) {
+        dsdReader->Close();
+        delete dsdReader;
+        dsdReader = nullptr;
+    }
+
     pc.Term();
 
 #ifdef _DEBUG
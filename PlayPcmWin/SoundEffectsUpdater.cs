@@ -5,15 +5,22 @@ using System.Text;
 
 namespace PlayPcmWin {
     class SoundEffectsUpdater {
+        /// <summary>
+        /// 再生中にフィルター列を切り替えるときのクロスフェード時間(ミリ秒)。
+        /// </summary>
+        private const int CROSSFADE_MS = 20;
+
         public SoundEffectsUpdater() {
         }
 
         public void Update(Wasapi.WasapiCS wasapi, List<PreferenceAudioFilter> audioFilterList) {
+            wasapi.BeginAudioFilterChain();
             wasapi.ClearAudioFilter();
 
             foreach (var f in audioFilterList) {
                 wasapi.AppendAudioFilter((Wasapi.WasapiCS.WWAudioFilterType)f.FilterType, f.ToSaveText());
             }
+            wasapi.CommitAudioFilterChain(CROSSFADE_MS);
         }
     }
 }
@@ -0,0 +1,695 @@
+#include "WWAFEngine.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// a segment is this number of output samples of the segmented filters or longer
+#define SEGMENT_MIN_SAMPLES (65536)
+
+/// waits until all threads arrive. reusable
+class WWAFEngine::Barrier {
+public:
+    Barrier(int count) : m_count(count), m_arrived(0), m_generation(0) { }
+
+    void SignalAndWait(void) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const int64_t generation = m_generation;
+        if (++m_arrived == m_count) {
+            m_arrived = 0;
+            ++m_generation;
+            m_cv.notify_all();
+            return;
+        }
+        m_cv.wait(lock, [this, generation] { return generation != m_generation; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_count;
+    int m_arrived;
+    int64_t m_generation;
+};
+
+/// runs the tasks on the worker threads. the thread waiting for its tasks runs the queued tasks too
+class WWAFEngine::TaskPool {
+public:
+    TaskPool(int numWorkers) : m_quit(false) {
+        for (int i=0; i<numWorkers; ++i) {
+            m_workers.push_back(std::thread(&TaskPool::Worker, this));
+        }
+    }
+
+    ~TaskPool(void) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        for (size_t i=0; i<m_workers.size(); ++i) {
+            m_workers[i].join();
+        }
+    }
+
+    /// returns when all tasks are done
+    void RunAll(const std::vector<std::function<void()> > &tasks) {
+        int remaining = (int)tasks.size();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (size_t i=0; i<tasks.size(); ++i) {
+            Task t = { &tasks[i], &remaining };
+            m_queue.push_back(t);
+        }
+        m_cv.notify_all();
+
+        while (0 < remaining) {
+            if (m_queue.empty()) {
+                m_cv.wait(lock);
+                continue;
+            }
+            RunFront(lock);
+        }
+    }
+
+private:
+    struct Task {
+        const std::function<void()> *f;
+
+        /// tasks of the RunAll() not yet done
+        int *remaining;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Task> m_queue;
+    std::vector<std::thread> m_workers;
+    bool m_quit;
+
+    /// runs the first task of the queue. the lock is held on the call and on the return
+    void RunFront(std::unique_lock<std::mutex> &lock) {
+        const Task t = m_queue.front();
+        m_queue.pop_front();
+
+        lock.unlock();
+        (*t.f)();
+        lock.lock();
+
+        if (0 == --*t.remaining) {
+            m_cv.notify_all();
+        }
+    }
+
+    void Worker(void) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_cv.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+            if (m_quit) {
+                break;
+            }
+            RunFront(lock);
+        }
+    }
+};
+
+/// copies of the filters run in series on a thread and the samples between them
+struct WWAFEngine::Chain {
+    int channelId;
+    std::vector<WWAFFilterBase *> filters;
+
+    /// input of the first filter from readPos. the samples after the end of the input are 0
+    const float *in;
+    int64_t readPos;
+
+    /// not null: the first filter reads the output of the segmented filters of the channel instead of in
+    Channel *source;
+
+    /// output of the previous filter not yet given to the filter of each stage and its read position
+    std::vector<std::vector<double> > pending;
+    std::vector<size_t> pendingPos;
+
+    /// input of the filter of each stage and the output of the previous stage
+    std::vector<std::vector<double> > inPcm;
+    std::vector<std::vector<double> > prevOut;
+
+    Chain(void) : channelId(0), in(nullptr), readPos(0), source(nullptr) { }
+    ~Chain(void) {
+        for (size_t i=0; i<filters.size(); ++i) {
+            delete filters[i];
+        }
+    }
+
+    void FilterStart(int64_t inPos) {
+        pending.resize(filters.size());
+        pendingPos.resize(filters.size());
+        inPcm.resize(filters.size());
+        prevOut.resize(filters.size());
+
+        for (size_t i=0; i<filters.size(); ++i) {
+            filters[i]->FilterStart();
+            pending[i].clear();
+            pendingPos[i] = 0;
+        }
+        readPos = inPos;
+    }
+
+    void FilterEnd(void) {
+        for (size_t i=0; i<filters.size(); ++i) {
+            filters[i]->FilterEnd();
+        }
+    }
+};
+
+struct WWAFEngine::Channel {
+    int channelId;
+
+    /// the filters after the segmented filters
+    Chain chain;
+
+    /// output of the segmented filters from the sample waveBegin. chain reads it from wavePos
+    std::vector<double> wave;
+    int64_t waveBegin;
+    size_t wavePos;
+
+    /// set-up copies of the segmented filters not in use. reused by the segments of the channel
+    std::vector<Chain *> idleChains;
+    std::mutex idleChainsMutex;
+
+    int32_t *out;
+    bool overflow;
+    double maxMagnitude;
+
+    Channel(void) : channelId(0), waveBegin(0), wavePos(0), out(nullptr), overflow(false), maxMagnitude(0.0) { }
+    ~Channel(void) {
+        DeleteIdleChains();
+    }
+
+    void DeleteIdleChains(void) {
+        for (size_t i=0; i<idleChains.size(); ++i) {
+            delete idleChains[i];
+        }
+        idleChains.clear();
+    }
+};
+
+/// output samples [begin, end) of the segmented filters of a channel
+struct WWAFEngine::Segment {
+    int channelId;
+    int64_t begin;
+    int64_t end;
+
+    /// either of them is the destination of the sample begin
+    double *toD;
+    int32_t *toI;
+
+    bool overflow;
+    double maxMagnitude;
+
+    Segment(void) : channelId(0), begin(0), end(0), toD(nullptr), toI(nullptr), overflow(false), maxMagnitude(0.0) { }
+};
+
+/// converts to 24bit as AudioDataPerChannel.SetPcmInDouble()
+static void
+StorePcm24(const double *pcm, int64_t count, int32_t *to, bool &overflow_inout, double &maxMagnitude_inout)
+{
+    for (int64_t i=0; i<count; ++i) {
+        const double vD = pcm[i];
+        int32_t vI;
+        if (vD < -1.0 || 1.0 <= vD) {
+            vI = (vD < -1.0) ? INT32_MIN : 0x7fffff00;
+
+            overflow_inout = true;
+            if (maxMagnitude_inout < fabs(vD)) {
+                maxMagnitude_inout = fabs(vD);
+            }
+        } else {
+            vI = (int32_t)(2147483648.0 * vD);
+        }
+        to[i] = vI >> 8;
+    }
+}
+
+static int64_t
+Gcd(int64_t a, int64_t b)
+{
+    while (b != 0) {
+        const int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+WWAFEngine::WWAFEngine(void)
+    : m_numThreads(1), m_numSegmented(0), m_segAlign(1), m_segOutStep(1), m_segWarmUp(0), m_segLength(0),
+      m_waveLength(0), m_segNumSamples(0), m_barrierReady(nullptr), m_barrierSet(nullptr), m_barrierDone(nullptr), m_pool(nullptr)
+{
+}
+
+WWAFEngine::~WWAFEngine(void)
+{
+    Term();
+}
+
+int
+WWAFEngine::Init(const std::vector<WWAFFilterBase *> &filters, int numChannels, int sampleRate, int64_t numSamples,
+        int numThreads)
+{
+    Term();
+
+    if (filters.empty() || numChannels < 1 || sampleRate < 1 || numSamples < 0 || numThreads < 0) {
+        return -1;
+    }
+
+    m_inFormat.numChannels = numChannels;
+    m_inFormat.sampleRate  = sampleRate;
+    m_inFormat.numSamples  = numSamples;
+
+    m_numThreads = numThreads;
+    if (0 == m_numThreads) {
+        m_numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    for (size_t i=0; i<filters.size(); ++i) {
+        m_filters.push_back(filters[i]->CreateCopy());
+    }
+
+    // the leading filters of finite memory are segmented
+    m_numSegmented = 0;
+    if (1 < m_numThreads) {
+        while (m_numSegmented < (int)m_filters.size() && 0 < m_filters[m_numSegmented]->SegmentAlignment()) {
+            ++m_numSegmented;
+        }
+    }
+
+    for (int ch=0; ch<numChannels; ++ch) {
+        Channel *c = new Channel();
+        c->channelId = ch;
+        c->chain.channelId = ch;
+        m_channels.push_back(c);
+
+        WWAFPcmFormat fmt = m_inFormat;
+        fmt.channelId = ch;
+        for (int i=0; i<(int)m_filters.size(); ++i) {
+            WWAFFilterBase *f = m_filters[i]->CreateCopy();
+            const int rv = f->Setup(fmt);
+
+            // the segmented filters are copied for each segment. this one is for the format only
+            if (i < m_numSegmented) {
+                delete f;
+            } else {
+                c->chain.filters.push_back(f);
+            }
+            if (rv < 0) {
+                Term();
+                return -1;
+            }
+            if (i + 1 == m_numSegmented) {
+                m_segNumSamples = fmt.numSamples;
+            }
+        }
+        if (0 == ch) {
+            m_outFormat = fmt;
+        }
+    }
+    m_outFormat.channelId = 0;
+
+    if (0 < m_numSegmented) {
+        PlanSegments();
+    }
+
+    m_barrierReady = new Barrier(numChannels);
+    m_barrierSet   = new Barrier(numChannels);
+    m_barrierDone  = new Barrier(numChannels);
+    m_inPcmArray.assign(numChannels, nullptr);
+    return 0;
+}
+
+void
+WWAFEngine::Term(void)
+{
+    for (size_t i=0; i<m_channels.size(); ++i) {
+        delete m_channels[i];
+    }
+    m_channels.clear();
+
+    for (size_t i=0; i<m_filters.size(); ++i) {
+        delete m_filters[i];
+    }
+    m_filters.clear();
+    m_numSegmented = 0;
+
+    delete m_barrierReady;
+    m_barrierReady = nullptr;
+    delete m_barrierSet;
+    m_barrierSet = nullptr;
+    delete m_barrierDone;
+    m_barrierDone = nullptr;
+
+    m_inPcmArray.clear();
+    m_inFormat = WWAFPcmFormat();
+    m_outFormat = WWAFPcmFormat();
+}
+
+void
+WWAFEngine::PlanSegments(void)
+{
+    // input alignment which puts the segment start of each filter on a multiple of its SegmentAlignment()
+    m_segAlign = 1;
+    for (int i=0; i<m_numSegmented; ++i) {
+        int64_t pos = m_segAlign;
+        for (int j=0; j<i; ++j) {
+            pos = m_filters[j]->OutputPosition(pos);
+        }
+        const int64_t a = m_filters[i]->SegmentAlignment();
+        m_segAlign *= a / Gcd(pos, a);
+    }
+
+    // fresh copies of the filters see 0 before the segment start
+    m_segOutStep = m_segAlign;
+    m_segWarmUp = 0;
+    for (int i=0; i<m_numSegmented; ++i) {
+        m_segOutStep = m_filters[i]->OutputPosition(m_segOutStep);
+        m_segWarmUp = m_filters[i]->SegmentWrongOutput(m_segWarmUp);
+    }
+
+    // the warm-up and the alignment are at most a quarter of a segment
+    const int numChannels = (int)m_channels.size();
+    const int64_t minLength = std::max((int64_t)SEGMENT_MIN_SAMPLES, 4 * (m_segWarmUp + m_segOutStep));
+
+    if (m_numSegmented == (int)m_filters.size()) {
+        // 2 segments per thread to balance the load
+        const int64_t perChannel = (2 * m_numThreads + numChannels - 1) / numChannels;
+        m_segLength = std::max(minLength, (m_outFormat.numSamples + perChannel - 1) / perChannel);
+        m_waveLength = 0;
+    } else {
+        const int64_t perChannel = (m_numThreads + numChannels - 1) / numChannels;
+        m_segLength = minLength;
+        m_waveLength = m_segLength * perChannel;
+    }
+}
+
+/// output of the segmented filters of the segment, by a fresh copy of them started before the segment
+void
+WWAFEngine::ProcessSegment(Segment *s)
+{
+    // the last aligned position where the warm-up ends before the segment. the filters run from the start
+    // of the file are the serial run itself
+    const int64_t m = (m_segWarmUp < s->begin) ? (s->begin - m_segWarmUp) / m_segOutStep : 0;
+
+    Channel *ch = m_channels[s->channelId];
+    Chain *c = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(ch->idleChainsMutex);
+        if (!ch->idleChains.empty()) {
+            c = ch->idleChains.back();
+            ch->idleChains.pop_back();
+        }
+    }
+    if (nullptr == c) {
+        c = new Chain();
+        c->channelId = s->channelId;
+
+        WWAFPcmFormat fmt = m_inFormat;
+        fmt.channelId = s->channelId;
+        for (int i=0; i<m_numSegmented; ++i) {
+            WWAFFilterBase *f = m_filters[i]->CreateCopy();
+            c->filters.push_back(f);
+
+            // succeeded in Init()
+            const int rv = f->Setup(fmt);
+            assert(0 <= rv);
+            (void)rv;
+        }
+    }
+    c->in = m_in[s->channelId];
+    c->FilterStart(m * m_segAlign);
+
+    std::vector<double> pcm;
+    int64_t pos = m * m_segOutStep;
+    while (pos < s->end) {
+        FilterNth(c, m_numSegmented - 1, pcm);
+
+        const int64_t from = std::max(pos, s->begin);
+        const int64_t to   = std::min(pos + (int64_t)pcm.size(), s->end);
+        if (from < to) {
+            const double *p = &pcm[(size_t)(from - pos)];
+            if (s->toI) {
+                StorePcm24(p, to - from, &s->toI[from - s->begin], s->overflow, s->maxMagnitude);
+            } else {
+                std::copy(p, p + (to - from), &s->toD[from - s->begin]);
+            }
+        }
+        pos += (int64_t)pcm.size();
+    }
+
+    c->FilterEnd();
+
+    std::lock_guard<std::mutex> lock(ch->idleChainsMutex);
+    ch->idleChains.push_back(c);
+}
+
+/// computes the next m_waveLength output samples of the segmented filters of the channel on the thread pool
+void
+WWAFEngine::FillWave(Channel *c)
+{
+    const int64_t begin = c->waveBegin + (int64_t)c->wave.size();
+
+    // after the end of the file, the rest of the filters read a few blocks of the tail
+    int64_t length = m_segLength;
+    if (begin < m_segNumSamples) {
+        length = std::min(m_waveLength, (m_segNumSamples - begin + m_segLength - 1) / m_segLength * m_segLength);
+    }
+    const int numSegments = (int)(length / m_segLength);
+
+    c->wave.resize((size_t)length);
+
+    std::vector<Segment> segments(numSegments);
+    std::vector<std::function<void()> > tasks;
+    for (int i=0; i<numSegments; ++i) {
+        Segment *s = &segments[i];
+        s->channelId = c->channelId;
+        s->begin = begin + i * m_segLength;
+        s->end   = s->begin + m_segLength;
+        s->toD   = &c->wave[(size_t)(i * m_segLength)];
+        tasks.push_back([this, s] { ProcessSegment(s); });
+    }
+    m_pool->RunAll(tasks);
+
+    c->waveBegin = begin;
+    c->wavePos = 0;
+}
+
+void
+WWAFEngine::ReadWave(Channel *c, int64_t count, std::vector<double> &outPcm_return)
+{
+    outPcm_return.resize((size_t)count);
+
+    size_t pos = 0;
+    while (pos < (size_t)count) {
+        if (c->wavePos == c->wave.size()) {
+            FillWave(c);
+        }
+
+        const size_t n = std::min((size_t)count - pos, c->wave.size() - c->wavePos);
+        std::copy(&c->wave[c->wavePos], &c->wave[c->wavePos] + n, &outPcm_return[pos]);
+        c->wavePos += n;
+        pos += n;
+    }
+}
+
+/// output of the filter nth. nth == -1 is the input samples
+void
+WWAFEngine::FilterNth(Chain *c, int nth, std::vector<double> &outPcm_return)
+{
+    if (nth == -1) {
+        const int64_t count = c->filters[0]->NumOfSamplesNeeded();
+        if (c->source) {
+            ReadWave(c->source, count, outPcm_return);
+            return;
+        }
+
+        // samples after the end of the input are 0
+        const int64_t copyCount = std::max((int64_t)0, std::min(count, m_inFormat.numSamples - c->readPos));
+
+        outPcm_return.resize((size_t)count);
+        for (int64_t i=0; i<copyCount; ++i) {
+            outPcm_return[(size_t)i] = c->in[c->readPos + i];
+        }
+        std::fill(outPcm_return.begin() + (size_t)copyCount, outPcm_return.end(), 0.0);
+        c->readPos += copyCount;
+        return;
+    }
+
+    WWAFFilterBase *f = c->filters[nth];
+    const size_t needed = (size_t)f->NumOfSamplesNeeded();
+
+    // output of the previous filter is accumulated until enough samples are available.
+    // the samples left over are used by the next call, as GetPreviousProcessRemains() of WWAudioFilter,
+    // but they are consumed by the read position instead of being copied to a new array on each call
+    std::vector<double> &pending = c->pending[nth];
+    size_t &pendingPos = c->pendingPos[nth];
+    std::vector<double> &prevOut = c->prevOut[nth];
+    while (pending.size() - pendingPos < needed) {
+        if (0 < pendingPos) {
+            pending.erase(pending.begin(), pending.begin() + pendingPos);
+            pendingPos = 0;
+        }
+        FilterNth(c, nth - 1, prevOut);
+        pending.insert(pending.end(), prevOut.begin(), prevOut.end());
+    }
+
+    std::vector<double> &inPcm = c->inPcm[nth];
+    inPcm.assign(pending.begin() + pendingPos, pending.begin() + pendingPos + needed);
+    pendingPos += needed;
+
+    if (f->WaitUntilAllChannelDataAvailable()) {
+        m_inPcmArray[c->channelId] = &inPcm;
+
+        // waits until m_inPcmArray has the input of all channels
+        m_barrierReady->SignalAndWait();
+
+        for (size_t ch=0; ch<m_inPcmArray.size(); ++ch) {
+            f->SetChannelPcm((int)ch, *m_inPcmArray[ch]);
+        }
+
+        // waits until SetChannelPcm() of all threads are done
+        m_barrierSet->SignalAndWait();
+
+        f->FilterDo(inPcm, outPcm_return);
+
+        // inPcm of this thread is used by the other threads until their FilterDo() are done
+        m_barrierDone->SignalAndWait();
+        return;
+    }
+
+    f->FilterDo(inPcm, outPcm_return);
+}
+
+void
+WWAFEngine::ProcessChannel(Channel *c)
+{
+    Chain &chain = c->chain;
+    chain.in = m_in[c->channelId];
+    chain.source = (0 < m_numSegmented) ? c : nullptr;
+    chain.FilterStart(0);
+
+    c->wave.clear();
+    c->waveBegin = 0;
+    c->wavePos = 0;
+    c->overflow = false;
+    c->maxMagnitude = 0.0;
+
+    const int64_t total = m_outFormat.numSamples;
+    std::vector<double> pcm;
+    int64_t pos = 0;
+    while (pos < total) {
+        FilterNth(&chain, (int)chain.filters.size() - 1, pcm);
+
+        const int64_t count = std::min((int64_t)pcm.size(), total - pos);
+        StorePcm24(pcm.data(), count, &c->out[pos], c->overflow, c->maxMagnitude);
+        pos += count;
+    }
+
+    chain.FilterEnd();
+
+    std::vector<double>().swap(c->wave);
+}
+
+void
+WWAFEngine::Run(const float * const *in, int32_t * const *out_return)
+{
+    const int numChannels = (int)m_channels.size();
+    const bool allSegmented = (m_numSegmented == (int)m_filters.size());
+
+    m_in.assign(in, in + numChannels);
+    for (int ch=0; ch<numChannels; ++ch) {
+        m_channels[ch]->out = out_return[ch];
+    }
+
+    // the threads of the channels run the segments too while they wait for them
+    int numWorkers = 0;
+    if (allSegmented) {
+        numWorkers = m_numThreads - 1;
+    } else if (0 < m_numSegmented) {
+        numWorkers = std::max(0, m_numThreads - numChannels);
+    }
+    TaskPool pool(numWorkers);
+    m_pool = &pool;
+
+    if (allSegmented) {
+        // the segments of all channels are independent
+        std::vector<Segment> segments;
+        for (int ch=0; ch<numChannels; ++ch) {
+            for (int64_t begin=0; begin<m_outFormat.numSamples; begin += m_segLength) {
+                Segment s;
+                s.channelId = ch;
+                s.begin = begin;
+                s.end   = std::min(begin + m_segLength, m_outFormat.numSamples);
+                s.toI   = &out_return[ch][begin];
+                segments.push_back(s);
+            }
+        }
+
+        std::vector<std::function<void()> > tasks;
+        for (size_t i=0; i<segments.size(); ++i) {
+            Segment *s = &segments[i];
+            tasks.push_back([this, s] { ProcessSegment(s); });
+        }
+        pool.RunAll(tasks);
+
+        for (int ch=0; ch<numChannels; ++ch) {
+            m_channels[ch]->overflow = false;
+            m_channels[ch]->maxMagnitude = 0.0;
+        }
+        for (size_t i=0; i<segments.size(); ++i) {
+            Channel *c = m_channels[segments[i].channelId];
+            c->overflow = c->overflow || segments[i].overflow;
+            c->maxMagnitude = std::max(c->maxMagnitude, segments[i].maxMagnitude);
+        }
+    } else {
+        std::vector<std::thread> threads;
+        for (int ch=1; ch<numChannels; ++ch) {
+            threads.push_back(std::thread(&WWAFEngine::ProcessChannel, this, m_channels[ch]));
+        }
+
+        // channel 0 is processed on the caller thread
+        ProcessChannel(m_channels[0]);
+
+        for (size_t i=0; i<threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+
+    m_pool = nullptr;
+    m_in.clear();
+
+    for (int ch=0; ch<numChannels; ++ch) {
+        m_channels[ch]->DeleteIdleChains();
+    }
+}
+
+bool
+WWAFEngine::Overflow(void) const
+{
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        if (m_channels[ch]->overflow) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double
+WWAFEngine::MaxMagnitude(void) const
+{
+    double v = 0.0;
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        v = std::max(v, m_channels[ch]->maxMagnitude);
+    }
+    return v;
+}
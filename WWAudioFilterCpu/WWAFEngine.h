@@ -0,0 +1,101 @@
+#pragma once
+
+#include "WWAFFilter.h"
+#include <stdint.h>
+#include <vector>
+
+/// Runs the filter graph of WWAudioFilter on the whole file, as WWAudioFilterCore.Run() of WWAudioFilter.
+///
+///   Each channel is processed on its own thread with its own copy of the filters. A filter pulls the output of
+///   the previous filter until NumOfSamplesNeeded() samples are available, so the block boundaries and
+///   the output samples are the same as the C# filter graph. Filters which need all channels (Crossfeed)
+///   exchange the input of the channels at a barrier.
+///
+///   The leading filters of finite memory (SegmentAlignment() of WWAFFilterBase) are also split in time:
+///   the signal is cut into segments which are processed on a thread pool by fresh copies of the filters.
+///   A segment starts earlier at an aligned input position and the samples of the warm-up are discarded,
+///   so the segments are stitched to the same samples as the serial run, bit for bit.
+///   When all filters are segmentable, the segments of all channels are processed at once. Otherwise the
+///   segmented filters produce the output of the channel wave by wave and the rest of the filters read it
+///   on the thread of the channel.
+class WWAFEngine {
+public:
+    WWAFEngine(void);
+    ~WWAFEngine(void);
+
+    /// copies the filters for each channel and sets them up for the input format.
+    /// @param numThreads 0: the number of the hardware threads. 1: the filters are not segmented
+    /// @return 0: success. negative: a filter can not process the format
+    int Init(const std::vector<WWAFFilterBase *> &filters, int numChannels, int sampleRate, int64_t numSamples,
+            int numThreads = 0);
+    void Term(void);
+
+    /// format of the output of the last filter
+    const WWAFPcmFormat &OutputFormat(void) const { return m_outFormat; }
+
+    /// @return number of the leading filters processed in segments
+    int NumSegmentedFilters(void) const { return m_numSegmented; }
+
+    /// processes all channels.
+    /// @param in  in[ch] is the input of the channel. numSamples floats. full scale is 1.0
+    /// @param out_return out_return[ch] is OutputFormat().numSamples 24bit samples (-8388608 .. 8388607)
+    ///        converted as AudioDataPerChannel.SetPcmInDouble() of WWAudioFilter
+    void Run(const float * const *in, int32_t * const *out_return);
+
+    /// @return true: the output of the last Run() is clipped
+    bool Overflow(void) const;
+
+    /// @return the largest magnitude of the clipped samples of the last Run()
+    double MaxMagnitude(void) const;
+
+private:
+    class Barrier;
+    class TaskPool;
+    struct Chain;
+    struct Channel;
+    struct Segment;
+
+    std::vector<Channel *> m_channels;
+    WWAFPcmFormat m_inFormat;
+    WWAFPcmFormat m_outFormat;
+    int m_numThreads;
+
+    /// copies of the filters given to Init()
+    std::vector<WWAFFilterBase *> m_filters;
+
+    /// the first m_numSegmented filters are processed in segments
+    int m_numSegmented;
+
+    /// segment start is a multiple of m_segAlign input samples. m_segAlign input samples are m_segOutStep samples
+    /// of the output of the segmented filters. the first m_segWarmUp output samples of a segment are discarded
+    int64_t m_segAlign;
+    int64_t m_segOutStep;
+    int64_t m_segWarmUp;
+
+    /// output samples of the segmented filters per segment
+    int64_t m_segLength;
+
+    /// output samples of the segmented filters computed at once per channel, when the other filters follow
+    int64_t m_waveLength;
+
+    /// number of the output samples of the segmented filters of the file
+    int64_t m_segNumSamples;
+
+    Barrier *m_barrierReady;
+    Barrier *m_barrierSet;
+    Barrier *m_barrierDone;
+
+    /// valid during Run()
+    TaskPool *m_pool;
+    std::vector<const float *> m_in;
+
+    /// input of the channels for the filter of WaitUntilAllChannelDataAvailable()
+    std::vector<const std::vector<double> *> m_inPcmArray;
+
+    void PlanSegments(void);
+    void ProcessSegment(Segment *s);
+    void FillWave(Channel *c);
+    void ReadWave(Channel *c, int64_t count, std::vector<double> &outPcm_return);
+    void ProcessChannel(Channel *c);
+    void FilterNth(Chain *c, int nth, std::vector<double> &outPcm_return);
+};
@@ -0,0 +1,380 @@
+#include "WWAFFftFilter.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WWAF_USE_SSE
+#endif
+
+/// (re, im) *= (hRe, hIm) * scale
+static void
+MulSpectrum(double *re, double *im, const double *hRe, const double *hIm, int n, double scale)
+{
+    int i = 0;
+#ifdef WWAF_USE_SSE
+    const __m128d s = _mm_set1_pd(scale);
+    for (; i + 2 <= n; i += 2) {
+        const __m128d xr = _mm_loadu_pd(&re[i]);
+        const __m128d xi = _mm_loadu_pd(&im[i]);
+        const __m128d hr = _mm_mul_pd(_mm_loadu_pd(&hRe[i]), s);
+        const __m128d hi = _mm_mul_pd(_mm_loadu_pd(&hIm[i]), s);
+        _mm_storeu_pd(&re[i], _mm_sub_pd(_mm_mul_pd(xr, hr), _mm_mul_pd(xi, hi)));
+        _mm_storeu_pd(&im[i], _mm_add_pd(_mm_mul_pd(xr, hi), _mm_mul_pd(xi, hr)));
+    }
+#endif
+    for (; i<n; ++i) {
+        const double hr = hRe[i] * scale;
+        const double hi = hIm[i] * scale;
+        const double xr = re[i];
+        const double xi = im[i];
+        re[i] = xr * hr - xi * hi;
+        im[i] = xr * hi + xi * hr;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFFftUpsampler::Setup(WWAFPcmFormat &fmt_inout)
+{
+    if (m_fft.Init(m_fftLength) < 0 || m_ifft.Init(m_fftLength * m_factor) < 0) {
+        return -1;
+    }
+
+    fmt_inout.sampleRate *= m_factor;
+    fmt_inout.numSamples *= m_factor;
+    return 0;
+}
+
+void
+WWAFFftUpsampler::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    m_overlap.clear();
+    m_first = true;
+}
+
+int64_t
+WWAFFftUpsampler::NumOfSamplesNeeded(void)
+{
+    if (m_first) {
+        return m_fftLength - OverlapLength();
+    }
+    return m_fftLength - OverlapLength() * 2;
+}
+
+void
+WWAFFftUpsampler::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const int N = m_fftLength;
+    const int O = OverlapLength();
+    const int UP = N * m_factor;
+    assert((int64_t)inPcm.size() == NumOfSamplesNeeded());
+
+    m_time.assign(N, 0.0);
+    if (m_first) {
+        std::copy(inPcm.begin(), inPcm.end(), m_time.begin() + O);
+        m_first = false;
+    } else {
+        assert((int)m_overlap.size() == O * 2);
+        std::copy(m_overlap.begin(), m_overlap.end(), m_time.begin());
+        std::copy(inPcm.begin(), inPcm.end(), m_time.begin() + O * 2);
+    }
+
+    m_re.resize(N / 2 + 1);
+    m_im.resize(N / 2 + 1);
+    m_fft.Forward(m_time.data(), m_re.data(), m_im.data());
+
+    // the spectrum is zero padded. the Nyquist bin of the input is split into the positive and the negative frequencies
+    m_upRe.assign(UP / 2 + 1, 0.0);
+    m_upIm.assign(UP / 2 + 1, 0.0);
+    std::copy(m_re.begin(), m_re.end(), m_upRe.begin());
+    std::copy(m_im.begin(), m_im.end(), m_upIm.begin());
+    m_upRe[N / 2] *= 0.5;
+    m_upIm[N / 2] *= 0.5;
+
+    m_upTime.resize(UP);
+    m_ifft.Inverse(m_upRe.data(), m_upIm.data(), m_upTime.data());
+
+    const double scale = 1.0 / N;
+    outPcm_return.resize((size_t)m_factor * (N - O * 2));
+    for (size_t i=0; i<outPcm_return.size(); ++i) {
+        outPcm_return[i] = m_upTime[i + (size_t)m_factor * O] * scale;
+    }
+
+    m_overlap.assign(inPcm.end() - O * 2, inPcm.end());
+}
+
+int64_t
+WWAFFftUpsampler::SegmentWrongOutput(int64_t wrongIn) const
+{
+    // the window of block b of the segment starts at the input position b*H-O
+    const int64_t H = SegmentAlignment();
+    const int64_t wrongBlocks = (wrongIn + OverlapLength() - 1) / H + 1;
+    return wrongBlocks * H * m_factor;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFLowpassFilter::Setup(WWAFPcmFormat &fmt_inout)
+{
+    if (m_fft.Init(FftLength()) < 0) {
+        return -1;
+    }
+
+    DesignCutoffFilter(fmt_inout.sampleRate);
+    m_addBuffer.clear();
+    m_first = true;
+    return 0;
+}
+
+void
+WWAFLowpassFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    m_addBuffer.clear();
+    m_first = true;
+}
+
+/// the same design as LowpassFilter.DesignCutoffFilter() of WWAudioFilter
+void
+WWAFLowpassFilter::DesignCutoffFilter(int sampleRate)
+{
+    const int LP1 = LengthP1();
+    const double orderX2 = 2.0 * (m_filterSlopeDbOct / 6.0);
+    const double cutoffRatio = m_cutoffFrequency / (sampleRate / 2);
+
+    // magnitude response of the Butterworth filter. real and even
+    std::vector<double> fromF(LP1, 0.0);
+    fromF[0] = 1.0;
+    for (int i=1; i<=LP1 / 2; ++i) {
+        const double omegaRatio = i * (1.0 / (LP1 / 2));
+        double v = sqrt(1.0 / (1.0 + pow(omegaRatio / cutoffRatio, orderX2)));
+        if (fabs(v) < pow(0.5, 24)) {
+            v = 0.0;
+        }
+        fromF[i] = v;
+    }
+    for (int i=1; i<LP1 / 2; ++i) {
+        fromF[LP1 - i] = fromF[i];
+    }
+
+    // the transform of the real even sequence is real and even
+    std::vector<double> fromT(LP1);
+    {
+        WWRealFftD fft;
+        fft.Init(LP1);
+        std::vector<double> re(LP1 / 2 + 1);
+        std::vector<double> im(LP1 / 2 + 1);
+        fft.Forward(fromF.data(), re.data(), im.data());
+
+        const double compensation = 1.0 / (LP1 * cutoffRatio);
+        for (int i=0; i<LP1; ++i) {
+            fromT[i] = re[(i <= LP1 / 2) ? i : (LP1 - i)] * compensation;
+        }
+    }
+
+    // the center of the impulse response is moved to LP1/2
+    std::vector<double> delayT(FftLength(), 0.0);
+    for (int i=1; i<LP1 / 2; ++i) {
+        delayT[i] = fromT[i + LP1 / 2];
+    }
+    for (int i=0; i<LP1 / 2; ++i) {
+        delayT[i + LP1 / 2] = fromT[i];
+    }
+
+    std::vector<double> w;
+    WWAFKaiserWindow(LP1 + 1, 9.0, w);
+    for (int i=0; i<LP1; ++i) {
+        delayT[i] *= w[i];
+    }
+
+    m_hRe.resize(FftLength() / 2 + 1);
+    m_hIm.resize(FftLength() / 2 + 1);
+    m_fft.Forward(delayT.data(), m_hRe.data(), m_hIm.data());
+    for (size_t i=0; i<m_hRe.size(); ++i) {
+        m_hRe[i] *= cutoffRatio;
+        m_hIm[i] *= cutoffRatio;
+    }
+}
+
+void
+WWAFLowpassFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const int N = FftLength();
+    const int LP1 = LengthP1();
+    const int delay = LP1 / 2;
+    const int needed = (int)NumOfSamplesNeeded();
+    assert((int)inPcm.size() <= needed);
+
+    m_time.assign(N, 0.0);
+    std::copy(inPcm.begin(), inPcm.end(), m_time.begin());
+
+    m_re.resize(N / 2 + 1);
+    m_im.resize(N / 2 + 1);
+    m_fft.Forward(m_time.data(), m_re.data(), m_im.data());
+    MulSpectrum(m_re.data(), m_im.data(), m_hRe.data(), m_hIm.data(), N / 2 + 1, 1.0 / N);
+    m_fft.Inverse(m_re.data(), m_im.data(), m_time.data());
+
+    // the first block is advanced by the delay of the filter
+    const int from = m_first ? delay : 0;
+    m_first = false;
+    outPcm_return.assign(m_time.begin() + from, m_time.begin() + needed);
+
+    for (size_t i=0; i<m_addBuffer.size(); ++i) {
+        outPcm_return[i] += m_addBuffer[i];
+    }
+    m_addBuffer.assign(m_time.end() - LP1, m_time.end());
+}
+
+int64_t
+WWAFLowpassFilter::SegmentWrongOutput(int64_t wrongIn) const
+{
+    // a block of a wrong sample is wrong and its tail is added to the first LP1 samples of the next block.
+    // output sample of block b is b*B+t-delay
+    const int64_t B = SegmentAlignment();
+    const int64_t wrongBlocks = (wrongIn + B - 1) / B;
+    return wrongBlocks * B + LengthP1() - LengthP1() / 2;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool
+ReadLine(FILE *fp, std::string &line_return)
+{
+    char buff[1024];
+    if (nullptr == fgets(buff, sizeof buff, fp)) {
+        return false;
+    }
+    line_return = buff;
+    while (!line_return.empty() && (line_return.back() == '\n' || line_return.back() == '\r')) {
+        line_return.pop_back();
+    }
+    return true;
+}
+
+WWAFCrossfeedFilter *
+WWAFCrossfeedFilter::Create(const std::string &path)
+{
+    FILE *fp = nullptr;
+#ifdef _MSC_VER
+    if (0 != fopen_s(&fp, path.c_str(), "rb")) {
+        fp = nullptr;
+    }
+#else
+    fp = fopen(path.c_str(), "rb");
+#endif
+    if (nullptr == fp) {
+        printf("Error: could not open %s\n", path.c_str());
+        return nullptr;
+    }
+
+    WWAFCrossfeedFilter *self = new WWAFCrossfeedFilter();
+    self->m_path = path;
+
+    std::string line;
+    int count = 0;
+    if (!ReadLine(fp, line) || line != "CFD1"
+            || !ReadLine(fp, line) || (self->m_coeffSampleRate = atoi(line.c_str())) <= 0
+            || !ReadLine(fp, line) || (count = atoi(line.c_str())) <= 0) {
+        printf("Error: %s is not a CFD1 file\n", path.c_str());
+        goto error;
+    }
+
+    for (int ch=0; ch<NUM; ++ch) {
+        self->m_coeffs[ch].resize(count);
+    }
+    for (int i=0; i<count; ++i) {
+        double v[NUM];
+        if (!ReadLine(fp, line) || NUM != sscanf(line.c_str(), "%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3])) {
+            printf("Error: could not read 4 coefficients on line %d of %s\n", i + 4, path.c_str());
+            goto error;
+        }
+        for (int ch=0; ch<NUM; ++ch) {
+            self->m_coeffs[ch][i] = v[ch];
+        }
+    }
+
+    fclose(fp);
+    return self;
+
+error:
+    fclose(fp);
+    delete self;
+    return nullptr;
+}
+
+int
+WWAFCrossfeedFilter::Setup(WWAFPcmFormat &fmt_inout)
+{
+    if (fmt_inout.numChannels != 2) {
+        printf("Error: Crossfeed NumChannels Mismatch!\n");
+        return -1;
+    }
+    if (fmt_inout.sampleRate != m_coeffSampleRate) {
+        printf("Error: Crossfeed SampleRate Mismatch! (among crossfeed coefficient file and input pcm file)\n");
+        return -1;
+    }
+
+    m_numSamples = fmt_inout.numSamples;
+    m_channelId  = fmt_inout.channelId;
+    return 0;
+}
+
+/// output of the ear m_channelId: circular convolution of the FFT size of the whole file, as CrossfeedFilter.FilterDo()
+void
+WWAFCrossfeedFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const int64_t len = std::max(m_numSamples, (int64_t)m_coeffs[0].size());
+    int fftLength = 4;
+    while (fftLength < len) {
+        fftLength *= 2;
+    }
+    const int bins = fftLength / 2 + 1;
+
+    WWRealFftD fft;
+    fft.Init(fftLength);
+
+    std::vector<double> time(fftLength);
+    std::vector<double> yRe(bins, 0.0);
+    std::vector<double> yIm(bins, 0.0);
+    std::vector<double> xRe(bins);
+    std::vector<double> xIm(bins);
+    std::vector<double> hRe(bins);
+    std::vector<double> hIm(bins);
+
+    // Y = X_left H_left-speaker-to-ear + X_right H_right-speaker-to-ear
+    for (int speaker=0; speaker<2; ++speaker) {
+        const std::vector<double> &x = *m_pcmAllChannels[speaker];
+        const std::vector<double> &h = m_coeffs[speaker * 2 + m_channelId];
+
+        std::fill(time.begin(), time.end(), 0.0);
+        std::copy(x.begin(), x.begin() + (size_t)std::min((int64_t)x.size(), m_numSamples), time.begin());
+        fft.Forward(time.data(), xRe.data(), xIm.data());
+
+        std::fill(time.begin(), time.end(), 0.0);
+        std::copy(h.begin(), h.end(), time.begin());
+        fft.Forward(time.data(), hRe.data(), hIm.data());
+
+        MulSpectrum(xRe.data(), xIm.data(), hRe.data(), hIm.data(), bins, 1.0);
+        for (int i=0; i<bins; ++i) {
+            yRe[i] += xRe[i];
+            yIm[i] += xIm[i];
+        }
+    }
+
+    fft.Inverse(yRe.data(), yIm.data(), time.data());
+
+    outPcm_return.resize(inPcm.size());
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        outPcm_return[i] = time[i] * (1.0 / fftLength);
+    }
+}
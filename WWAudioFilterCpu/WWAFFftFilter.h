@@ -0,0 +1,126 @@
+#pragma once
+
+#include "WWAFFilter.h"
+#include "WWFft.h"
+#include <string>
+#include <vector>
+
+/// upsampler of zero padding the spectrum of overlapped FFT blocks
+class WWAFFftUpsampler : public WWAFFilterBase {
+public:
+    WWAFFftUpsampler(int factor, int fftLength)
+        : WWAFFilterBase(WWAFFT_FftUpsampler), m_factor(factor), m_fftLength(fftLength), m_first(true) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFFftUpsampler(m_factor, m_fftLength); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual void FilterStart(void);
+    virtual int64_t NumOfSamplesNeeded(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+    /// the blocks start at the multiples of fftLength/2 input samples. the output of a block is wrong
+    /// when its FFT window has a wrong sample, including the zeros before the start of the segment
+    virtual int64_t SegmentAlignment(void) const { return m_fftLength - OverlapLength() * 2; }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const;
+    virtual int64_t OutputPosition(int64_t inPos) const { return inPos * m_factor; }
+
+private:
+    int m_factor;
+    int m_fftLength;
+    bool m_first;
+
+    WWRealFftD m_fft;
+    WWRealFftD m_ifft;
+
+    /// the last OverlapLength()*2 input samples
+    std::vector<double> m_overlap;
+
+    std::vector<double> m_time;
+    std::vector<double> m_re;
+    std::vector<double> m_im;
+    std::vector<double> m_upTime;
+    std::vector<double> m_upRe;
+    std::vector<double> m_upIm;
+
+    int OverlapLength(void) const { return m_fftLength / 4; }
+};
+
+/// Butterworth magnitude response FIR lowpass of filterLength taps. overlap-add FFT convolution
+class WWAFLowpassFilter : public WWAFFilterBase {
+public:
+    WWAFLowpassFilter(double cutoffFrequency, int filterLength, int filterSlopeDbOct)
+        : WWAFFilterBase(WWAFFT_LowPassFilter), m_cutoffFrequency(cutoffFrequency),
+          m_filterLength(filterLength), m_filterSlopeDbOct(filterSlopeDbOct), m_first(true) { }
+    virtual WWAFFilterBase *CreateCopy(void) const {
+        return new WWAFLowpassFilter(m_cutoffFrequency, m_filterLength, m_filterSlopeDbOct);
+    }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual void FilterStart(void);
+    virtual int64_t NumOfSamplesNeeded(void) { return FftLength() - LengthP1(); }
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+    /// the blocks start at the multiples of NumOfSamplesNeeded() input samples. the first block of a segment
+    /// lacks the tail of the previous block
+    virtual int64_t SegmentAlignment(void) const { return FftLength() - LengthP1(); }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const;
+
+private:
+    double m_cutoffFrequency;
+    int m_filterLength;
+    int m_filterSlopeDbOct;
+    bool m_first;
+
+    WWRealFftD m_fft;
+
+    /// spectrum of the filter
+    std::vector<double> m_hRe;
+    std::vector<double> m_hIm;
+
+    /// tail of the previous block added to the next block
+    std::vector<double> m_addBuffer;
+
+    std::vector<double> m_time;
+    std::vector<double> m_re;
+    std::vector<double> m_im;
+
+    int LengthP1(void) const { return m_filterLength + 1; }
+    int FftLength(void) const { return LengthP1() * 4; }
+    void DesignCutoffFilter(int sampleRate);
+};
+
+/// stereo crossfeed of the CFD1 file of WWCrossFeed. the whole file is convolved at once
+class WWAFCrossfeedFilter : public WWAFFilterBase {
+public:
+    /// reads the CFD1 file
+    /// @return nullptr: the file could not be read
+    static WWAFCrossfeedFilter *Create(const std::string &path);
+
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFCrossfeedFilter(*this); }
+    virtual bool WaitUntilAllChannelDataAvailable(void) const { return true; }
+    virtual void SetChannelPcm(int ch, const std::vector<double> &inPcm) { m_pcmAllChannels[ch] = &inPcm; }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual int64_t NumOfSamplesNeeded(void) { return m_numSamples; }
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+private:
+    enum Channels {
+        LeftSpeakerToLeftEar,
+        LeftSpeakerToRightEar,
+        RightSpeakerToLeftEar,
+        RightSpeakerToRightEar,
+        NUM
+    };
+
+    std::string m_path;
+    int m_coeffSampleRate;
+    std::vector<double> m_coeffs[NUM];
+
+    int64_t m_numSamples;
+    int m_channelId;
+
+    /// input of the channels given by SetChannelPcm(). valid until FilterDo() returns
+    const std::vector<double> *m_pcmAllChannels[2];
+
+    WWAFCrossfeedFilter(void) : WWAFFilterBase(WWAFFT_Crossfeed), m_coeffSampleRate(0), m_numSamples(0), m_channelId(0) {
+        m_pcmAllChannels[0] = nullptr;
+        m_pcmAllChannels[1] = nullptr;
+    }
+};
@@ -0,0 +1,429 @@
+#include "WWAFFilter.h"
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WWAF_USE_SSE
+#endif
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+static double
+ModifiedBesselI0(double alpha)
+{
+    static const int L = 15;
+
+    double i0 = 1.0;
+    double factorial = 1.0;
+    for (int l=1; l<L; ++l) {
+        factorial *= l;
+        const double t = pow(alpha * 0.5, l) / factorial;
+        i0 += t * t;
+    }
+    return i0;
+}
+
+void
+WWAFKaiserWindow(int length, double alpha, std::vector<double> &w_return)
+{
+    assert(length & 1);
+
+    const double i0d = ModifiedBesselI0(alpha);
+    const int m = length - 1;
+
+    w_return.resize(length);
+    for (int i=0; i<length; ++i) {
+        const double t2 = (1.0 - 2.0 * i / m);
+        const double a = alpha * sqrt(1.0 - t2 * t2);
+        w_return[i] = ModifiedBesselI0(a) / i0d;
+    }
+}
+
+/// the same as the conversion of NoiseShapingFilter.FilterDo()
+static int
+DoubleToInt24(double v)
+{
+    if (1.0 <= v) {
+        return 8388607;
+    }
+    if (v < -1.0) {
+        return -8388608;
+    }
+    return (int)(8388608 * v);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+WWAFGainFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const size_t n = inPcm.size();
+    outPcm_return.resize(n);
+
+    const double *x = inPcm.data();
+    double *y = outPcm_return.data();
+    size_t i = 0;
+#ifdef WWAF_USE_SSE
+    const __m128d a = _mm_set1_pd(m_amplitude);
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(&y[i], _mm_mul_pd(_mm_loadu_pd(&x[i]), a));
+    }
+#endif
+    for (; i<n; ++i) {
+        y[i] = x[i] * m_amplitude;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFZohUpsampler::Setup(WWAFPcmFormat &fmt_inout)
+{
+    fmt_inout.sampleRate *= m_factor;
+    fmt_inout.numSamples *= m_factor;
+    return 0;
+}
+
+void
+WWAFZohUpsampler::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    outPcm_return.resize(inPcm.size() * m_factor);
+    size_t pos = 0;
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        for (int r=0; r<m_factor; ++r) {
+            outPcm_return[pos++] = inPcm[i];
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFInsertZeroesUpsampler::Setup(WWAFPcmFormat &fmt_inout)
+{
+    fmt_inout.sampleRate *= m_factor;
+    fmt_inout.numSamples *= m_factor;
+    return 0;
+}
+
+void
+WWAFInsertZeroesUpsampler::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    outPcm_return.assign(inPcm.size() * m_factor, 0.0);
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        outPcm_return[i * m_factor] = inPcm[i];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFDownsampler::Setup(WWAFPcmFormat &fmt_inout)
+{
+    fmt_inout.sampleRate /= m_factor;
+    fmt_inout.numSamples /= m_factor;
+    return 0;
+}
+
+/// WWAudioFilter takes Factor samples at a time. any multiple of Factor gives the same output
+int64_t
+WWAFDownsampler::NumOfSamplesNeeded(void)
+{
+    return (int64_t)m_factor * (4096 / m_factor + 1);
+}
+
+void
+WWAFDownsampler::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const size_t n = inPcm.size() / m_factor;
+    outPcm_return.resize(n);
+    for (size_t i=0; i<n; ++i) {
+        outPcm_return[i] = inPcm[i * m_factor + m_pickSampleIndex];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+WWAFCicFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    m_comb.assign(m_delay, 0.0);
+    m_combCount = 0;
+    m_integratorZ = 0.0;
+}
+
+void
+WWAFCicFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    outPcm_return.resize(inPcm.size());
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        double v = inPcm[i];
+
+        const size_t pos = (size_t)(m_combCount % m_delay);
+        const double old = m_comb[pos];
+        m_comb[pos] = v;
+        if (m_delay <= m_combCount) {
+            v -= old;
+        }
+        ++m_combCount;
+
+        v += m_integratorZ;
+        m_integratorZ = v;
+
+        outPcm_return[i] = v;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFHalfbandFilter::Setup(WWAFPcmFormat &fmt_inout)
+{
+    (void)fmt_inout;
+
+    const int L = m_filterLength;
+    const int delay = (L + 1) / 2;
+    static const double sine90Table[] = { 0.0, 1.0, 0.0, -1.0 };
+
+    m_coeffs.assign(L, 0.0);
+    for (int i=0; i<delay; ++i) {
+        if (i != 0 && 0 == (i & 1)) {
+            continue;
+        }
+        const double theta = M_PI * (i * 90.0) / 180.0f;
+        double v = 1.0;
+        if (0.0 < fabs(theta)) {
+            v = sine90Table[i & 3] / theta;
+        }
+        m_coeffs[delay - 1 - i] = v;
+        m_coeffs[delay - 1 + i] = v;
+    }
+
+    std::vector<double> w;
+    WWAFKaiserWindow(L, 9.0, w);
+    for (int i=0; i<L; ++i) {
+        m_coeffs[i] *= w[i] * 0.5;
+    }
+    return 0;
+}
+
+void
+WWAFHalfbandFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    // output starts when the input reaches the center tap
+    const int delay = (m_filterLength + 1) / 2;
+    m_history.assign(m_filterLength - delay, 0.0);
+}
+
+void
+WWAFHalfbandFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    const int L = m_filterLength;
+    const int center = (L + 1) / 2 - 1;
+
+    m_work.resize(m_history.size() + inPcm.size());
+    std::copy(m_history.begin(), m_history.end(), m_work.begin());
+    std::copy(inPcm.begin(), inPcm.end(), m_work.begin() + m_history.size());
+
+    const int64_t numOut = (int64_t)m_work.size() - L + 1;
+    outPcm_return.resize((size_t)std::max(numOut, (int64_t)0));
+
+    // y[n] = c[center] x[n+center] + sum of odd i: c[center-i] (x[n+center-i] + x[n+center+i])
+    const double *x = m_work.data();
+    const double *c = m_coeffs.data();
+    double *y = outPcm_return.data();
+    int64_t n = 0;
+#ifdef WWAF_USE_SSE
+    for (; n + 2 <= numOut; n += 2) {
+        const double *xc = &x[n + center];
+        __m128d acc = _mm_mul_pd(_mm_set1_pd(c[center]), _mm_loadu_pd(xc));
+        for (int i=1; i<=center; i += 2) {
+            const __m128d s = _mm_add_pd(_mm_loadu_pd(xc - i), _mm_loadu_pd(xc + i));
+            acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(c[center - i]), s));
+        }
+        _mm_storeu_pd(&y[n], acc);
+    }
+#endif
+    for (; n<numOut; ++n) {
+        const double *xc = &x[n + center];
+        double acc = c[center] * xc[0];
+        for (int i=1; i<=center; i += 2) {
+            acc += c[center - i] * (xc[-i] + xc[i]);
+        }
+        y[n] = acc;
+    }
+
+    const size_t keep = std::min(m_work.size(), (size_t)(L - 1));
+    m_history.assign(m_work.end() - keep, m_work.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+WWAFNoiseShapingFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    m_mask = 0xffffff00U << (24 - m_targetBitsPerSample);
+    m_delay[0] = 0;
+    m_delay[1] = 0;
+}
+
+/// NoiseShaper2.Filter24() of NoiseShapingFilter.cs with the coefficients 1, -2, 1
+void
+WWAFNoiseShapingFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    static const double c[3] = { 1, -2, 1 };
+
+    // the state is kept in the locals. the store to outPcm_return may alias the members
+    double delay0 = m_delay[0];
+    double delay1 = m_delay[1];
+
+    outPcm_return.resize(inPcm.size());
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        const int sampleFrom = (int)((uint32_t)DoubleToInt24(inPcm[i]) << 8);
+
+        double v = c[0] * sampleFrom;
+        v += c[1] * delay0;
+        v += c[2] * delay1;
+
+        int sampleY;
+        if (m_targetBitsPerSample == 1) {
+            sampleY = (0 <= v) ? INT_MAX : INT_MIN;
+        } else {
+            if (v > INT_MAX) {
+                v = INT_MAX;
+            }
+            if (v < INT_MIN) {
+                v = INT_MIN;
+            }
+            sampleY = (int)((uint32_t)(int)v & m_mask);
+        }
+
+        delay1 = delay0;
+        delay0 = sampleY - v;
+
+        outPcm_return[i] = (double)(sampleY / 256) * (1.0 / 8388608);
+    }
+
+    m_delay[0] = delay0;
+    m_delay[1] = delay1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+int
+WWAFNoiseShaping4thFilter::Setup(WWAFPcmFormat &fmt_inout)
+{
+    (void)fmt_inout;
+    m_mask = 0xffffff00U << (24 - m_targetBitsPerSample);
+    return 0;
+}
+
+void
+WWAFNoiseShaping4thFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+    memset(m_s, 0, sizeof m_s);
+}
+
+void
+WWAFNoiseShaping4thFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    static const double C[5] = { 0.791882, 0.304545, 0.069930, 0.009496, 0.000607 };
+    static const double F[2] = { 0.000496, 0.001789 };
+
+    outPcm_return.resize(inPcm.size());
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        double sampleD = 0.0;
+        for (int order=0; order<5; ++order) {
+            sampleD += C[order] * m_s[order];
+        }
+
+        double out;
+        if (1 == m_targetBitsPerSample) {
+            out = (0.0 <= sampleD) ? (8388607.0 / 8388608.0) : -1.0;
+        } else {
+            int sampleI;
+            if (1.0 <= sampleD) {
+                sampleI = INT_MAX;
+            } else if (sampleD < -1.0) {
+                sampleI = INT_MIN;
+            } else {
+                sampleI = (int)(sampleD * -1.0 * (double)INT_MIN);
+            }
+            sampleI = (int)((uint32_t)sampleI & m_mask);
+            out = sampleI * (-1.0 / (double)INT_MIN);
+        }
+        outPcm_return[i] = out;
+
+        m_s[4] += m_s[3];
+        m_s[3] += m_s[2] - F[1] * m_s[4];
+        m_s[2] += m_s[1];
+        m_s[1] += m_s[0] - F[0] * m_s[2];
+        m_s[0] += (inPcm[i] - out);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+WWAFMashFilter::SigmaDelta1bit::Reset(void)
+{
+    delayX = INT_MAX;
+    delayY = INT_MAX;
+    quantizationError = 0;
+}
+
+int
+WWAFMashFilter::SigmaDelta1bit::Filter24(double sampleFrom)
+{
+    sampleFrom *= 256;
+
+    const double x = sampleFrom + delayX - delayY;
+    delayX = x;
+
+    const int sampleY = (0 <= x) ? INT_MAX : INT_MIN;
+    delayY = sampleY;
+
+    quantizationError = (sampleY - x) / 256;
+    return sampleY / 256;
+}
+
+void
+WWAFMashFilter::FilterStart(void)
+{
+    WWAFFilterBase::FilterStart();
+
+    m_sd[0].Reset();
+    m_sd[1].Reset();
+    m_finalQ.Reset();
+    m_delayY2 = INT_MAX / 256;
+}
+
+void
+WWAFMashFilter::FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return)
+{
+    outPcm_return.resize(inPcm.size());
+    for (size_t i=0; i<inPcm.size(); ++i) {
+        const int sampleFrom = DoubleToInt24(inPcm[i]);
+
+        const double y1 = m_sd[0].Filter24(sampleFrom);
+        const double y2 = m_sd[1].Filter24(m_sd[0].quantizationError);
+        const double rT = y1 + y2 - m_delayY2;
+        m_delayY2 = y2;
+        const int r = m_finalQ.Filter24(rT / 4);
+
+        outPcm_return[i] = (double)r * (1.0 / 8388608);
+    }
+}
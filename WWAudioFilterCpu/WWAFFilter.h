@@ -0,0 +1,260 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// the same order as FilterType of WWAudioFilter/FilterBase.cs
+enum WWAFFilterType {
+    WWAFFT_Gain,
+    WWAFFT_ZohUpsampler,
+    WWAFFT_LowPassFilter,
+    WWAFFT_FftUpsampler,
+    WWAFFT_Mash2,
+
+    WWAFFT_NoiseShaping,
+    WWAFFT_NoiseShaping4th,
+    WWAFFT_TagEdit,
+    WWAFFT_Downsampler,
+    WWAFFT_CicFilter,
+
+    WWAFFT_InsertZeroesUpsampler,
+    WWAFFT_HalfbandFilter,
+    WWAFFT_Crossfeed,
+
+    WWAFFT_NUM
+};
+
+/// Kaiser window of WWWindowFunc.KaiserWindow() of WWAudioFilter. I0 is the same 15 term series,
+/// so that the filter coefficients are the same as the C# filters.
+/// @param length odd
+void WWAFKaiserWindow(int length, double alpha, std::vector<double> &w_return);
+
+struct WWAFPcmFormat {
+    int numChannels;
+    int channelId;
+    int sampleRate;
+    int64_t numSamples;
+
+    WWAFPcmFormat(void) : numChannels(0), channelId(0), sampleRate(0), numSamples(0) { }
+};
+
+/// Native counterpart of FilterBase of WWAudioFilter.
+///
+///   A filter processes one channel. WWAFEngine gives FilterDo() exactly NumOfSamplesNeeded() samples
+///   and the output is of any length, the same as the C# filter graph, so the output samples are the same
+///   up to the floating point round-off.
+class WWAFFilterBase {
+public:
+    WWAFFilterBase(WWAFFilterType type) : m_type(type) { }
+    virtual ~WWAFFilterBase(void) { }
+
+    WWAFFilterType Type(void) const { return m_type; }
+
+    virtual WWAFFilterBase *CreateCopy(void) const = 0;
+
+    /// @return true: FilterDo() is called after SetChannelPcm() of all channels
+    virtual bool WaitUntilAllChannelDataAvailable(void) const { return false; }
+    virtual void SetChannelPcm(int ch, const std::vector<double> &inPcm) { (void)ch; (void)inPcm; }
+
+    /// @param fmt_inout input format. output format is returned
+    /// @return 0: success. negative: the filter can not process the input format
+    virtual int Setup(WWAFPcmFormat &fmt_inout) { (void)fmt_inout; return 0; }
+
+    /// clears the state before the first FilterDo() of the file
+    virtual void FilterStart(void) { }
+    virtual void FilterEnd(void) { }
+
+    virtual int64_t NumOfSamplesNeeded(void) { return 4096; }
+
+    /// @param inPcm NumOfSamplesNeeded() samples
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return) = 0;
+
+    /// for WWAFEngine to split a long signal into segments processed in parallel.
+    /// @return 0: the output depends on the whole history of the input (feedback, whole file).
+    ///         positive: the filter has finite memory. a copy started by FilterStart() at an input position of
+    ///         a multiple of this value gives the same output samples as the filter run from the start of the file,
+    ///         except the first SegmentWrongOutput() samples
+    virtual int64_t SegmentAlignment(void) const { return 0; }
+
+    /// @param wrongIn the first wrongIn input samples of the segment may differ from the input of the serial run
+    /// @return number of the first output samples of the segment which may differ from the serial run
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const { return wrongIn; }
+
+    /// @param inPos input position of a multiple of SegmentAlignment()
+    /// @return position of the output sample of the input sample inPos
+    virtual int64_t OutputPosition(int64_t inPos) const { return inPos; }
+
+protected:
+    static bool IsPowerOfTwo(int64_t v) { return 0 < v && (v & (v - 1)) == 0; }
+
+private:
+    WWAFFilterType m_type;
+};
+
+class WWAFGainFilter : public WWAFFilterBase {
+public:
+    WWAFGainFilter(double amplitude) : WWAFFilterBase(WWAFFT_Gain), m_amplitude(amplitude) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFGainFilter(m_amplitude); }
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+    virtual int64_t SegmentAlignment(void) const { return 1; }
+
+private:
+    double m_amplitude;
+};
+
+class WWAFZohUpsampler : public WWAFFilterBase {
+public:
+    WWAFZohUpsampler(int factor) : WWAFFilterBase(WWAFFT_ZohUpsampler), m_factor(factor) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFZohUpsampler(m_factor); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual int64_t NumOfSamplesNeeded(void) { return 8192; }
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+    virtual int64_t SegmentAlignment(void) const { return 1; }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const { return wrongIn * m_factor; }
+    virtual int64_t OutputPosition(int64_t inPos) const { return inPos * m_factor; }
+
+private:
+    int m_factor;
+};
+
+class WWAFInsertZeroesUpsampler : public WWAFFilterBase {
+public:
+    WWAFInsertZeroesUpsampler(int factor) : WWAFFilterBase(WWAFFT_InsertZeroesUpsampler), m_factor(factor) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFInsertZeroesUpsampler(m_factor); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+    virtual int64_t SegmentAlignment(void) const { return 1; }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const { return wrongIn * m_factor; }
+    virtual int64_t OutputPosition(int64_t inPos) const { return inPos * m_factor; }
+
+private:
+    int m_factor;
+};
+
+class WWAFDownsampler : public WWAFFilterBase {
+public:
+    WWAFDownsampler(int factor, int pickSampleIndex)
+        : WWAFFilterBase(WWAFFT_Downsampler), m_factor(factor), m_pickSampleIndex(pickSampleIndex) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFDownsampler(m_factor, m_pickSampleIndex); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual int64_t NumOfSamplesNeeded(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+    virtual int64_t SegmentAlignment(void) const { return m_factor; }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const { return (wrongIn + m_factor - 1) / m_factor; }
+    virtual int64_t OutputPosition(int64_t inPos) const { return inPos / m_factor; }
+
+private:
+    int m_factor;
+    int m_pickSampleIndex;
+};
+
+/// single stage CIC: comb of delay samples and integrator.
+/// not segmentable: the round-off of the floating point integrator is carried from the start of the file
+class WWAFCicFilter : public WWAFFilterBase {
+public:
+    WWAFCicFilter(int delay) : WWAFFilterBase(WWAFFT_CicFilter), m_delay(delay), m_integratorZ(0) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFCicFilter(m_delay); }
+    virtual void FilterStart(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+private:
+    int m_delay;
+
+    /// ring buffer of the last delay input samples
+    std::vector<double> m_comb;
+    int64_t m_combCount;
+    double m_integratorZ;
+};
+
+/// half-band lowpass of Kaiser windowed sinc. the taps of even distance from the center are 0 and skipped
+class WWAFHalfbandFilter : public WWAFFilterBase {
+public:
+    WWAFHalfbandFilter(int filterLength) : WWAFFilterBase(WWAFFT_HalfbandFilter), m_filterLength(filterLength) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFHalfbandFilter(m_filterLength); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual void FilterStart(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+    /// output sample n is of the input samples n-center .. n+center. the history before the start is 0
+    virtual int64_t SegmentAlignment(void) const { return 1; }
+    virtual int64_t SegmentWrongOutput(int64_t wrongIn) const { return wrongIn + (m_filterLength + 1) / 2 - 1; }
+
+private:
+    int m_filterLength;
+    std::vector<double> m_coeffs;
+
+    /// last m_filterLength-1 or fewer input samples
+    std::vector<double> m_history;
+
+    /// history followed by the input
+    std::vector<double> m_work;
+};
+
+/// 2nd order error feedback requantizer to targetBitsPerSample of the 24bit sample
+class WWAFNoiseShapingFilter : public WWAFFilterBase {
+public:
+    WWAFNoiseShapingFilter(int targetBitsPerSample)
+        : WWAFFilterBase(WWAFFT_NoiseShaping), m_targetBitsPerSample(targetBitsPerSample), m_mask(0) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFNoiseShapingFilter(m_targetBitsPerSample); }
+    virtual void FilterStart(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+private:
+    int m_targetBitsPerSample;
+    uint32_t m_mask;
+    double m_delay[2];
+};
+
+/// 4th order sigma-delta of D. Reefman and E. Janssen, "One-Bit Audio: An Overview"
+class WWAFNoiseShaping4thFilter : public WWAFFilterBase {
+public:
+    WWAFNoiseShaping4thFilter(int targetBitsPerSample)
+        : WWAFFilterBase(WWAFFT_NoiseShaping4th), m_targetBitsPerSample(targetBitsPerSample), m_mask(0) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFNoiseShaping4thFilter(m_targetBitsPerSample); }
+    virtual int Setup(WWAFPcmFormat &fmt_inout);
+    virtual void FilterStart(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+private:
+    int m_targetBitsPerSample;
+    uint32_t m_mask;
+    double m_s[5];
+};
+
+/// MASH 1bit noise shaper (under construction in WWAudioFilter too)
+class WWAFMashFilter : public WWAFFilterBase {
+public:
+    WWAFMashFilter(void) : WWAFFilterBase(WWAFFT_Mash2) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFMashFilter(); }
+    virtual void FilterStart(void);
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return);
+
+private:
+    struct SigmaDelta1bit {
+        double delayX;
+        double delayY;
+        double quantizationError;
+
+        void Reset(void);
+        int Filter24(double sampleFrom);
+    };
+
+    SigmaDelta1bit m_sd[2];
+    SigmaDelta1bit m_finalQ;
+    double m_delayY2;
+};
+
+/// edits the tag of the output file. the samples pass through
+class WWAFTagEditFilter : public WWAFFilterBase {
+public:
+    WWAFTagEditFilter(const std::string &tagType, const std::string &text)
+        : WWAFFilterBase(WWAFFT_TagEdit), m_tagType(tagType), m_text(text) { }
+    virtual WWAFFilterBase *CreateCopy(void) const { return new WWAFTagEditFilter(m_tagType, m_text); }
+    virtual void FilterDo(const std::vector<double> &inPcm, std::vector<double> &outPcm_return) { outPcm_return = inPcm; }
+    virtual int64_t SegmentAlignment(void) const { return 1; }
+
+private:
+    std::string m_tagType;
+    std::string m_text;
+};
@@ -0,0 +1,334 @@
+#include "WWAFFilterFactory.h"
+#include "WWAFFftFilter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+enum SplitState {
+    SS_Start,
+    SS_InToken,
+    SS_InEscapedToken,
+    SS_SkipWhiteSpace,
+};
+
+/// splits by space. "quoted token" may contain spaces and \ escapes the next character.
+/// the same state machine as FilterFactory.Split() of WWAudioFilter
+static void
+Split(const std::string &s, std::vector<std::string> &tokens_return)
+{
+    tokens_return.clear();
+
+    std::string token;
+    SplitState state = SS_Start;
+
+    for (size_t i=0; i<s.size(); ++i) {
+        switch (state) {
+        case SS_Start:
+            if (s[i] == '\"') {
+                state = SS_InEscapedToken;
+            } else {
+                state = SS_InToken;
+                token += s[i];
+            }
+            break;
+        case SS_InToken:
+            if (s[i] == ' ') {
+                if (!token.empty()) {
+                    tokens_return.push_back(token);
+                    token.clear();
+                }
+                state = SS_SkipWhiteSpace;
+            } else {
+                token += s[i];
+            }
+            break;
+        case SS_InEscapedToken:
+            if (s[i] == '\\') {
+                ++i;
+                if (i < s.size()) {
+                    token += s[i];
+                }
+            } else if (s[i] == '\"') {
+                if (!token.empty()) {
+                    tokens_return.push_back(token);
+                    token.clear();
+                }
+                state = SS_SkipWhiteSpace;
+            } else {
+                token += s[i];
+            }
+            break;
+        case SS_SkipWhiteSpace:
+            if (s[i] == '\"') {
+                state = SS_InEscapedToken;
+            } else if (s[i] != ' ') {
+                state = SS_InToken;
+                token += s[i];
+            }
+            break;
+        }
+    }
+
+    if (state == SS_InToken && !token.empty()) {
+        tokens_return.push_back(token);
+    }
+}
+
+static bool
+ParseInt(const std::string &s, int &v_return)
+{
+    if (s.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    const long v = strtol(s.c_str(), &end, 10);
+    if (*end != '\0' || errno != 0 || v < INT32_MIN || INT32_MAX < v) {
+        return false;
+    }
+    v_return = (int)v;
+    return true;
+}
+
+static bool
+ParseDouble(const std::string &s, double &v_return)
+{
+    if (s.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    v_return = strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+static bool
+IsPowerOfTwo(int v)
+{
+    return 0 < v && (v & (v - 1)) == 0;
+}
+
+/// FftUpsampler.DEFAULT_FFT_LENGTH
+#define FFT_UPSAMPLER_DEFAULT_FFT_LENGTH (262144)
+
+WWAFFilterBase *
+WWAFCreateFilter(const std::string &line)
+{
+    std::vector<std::string> t;
+    Split(line, t);
+    if (t.empty()) {
+        return nullptr;
+    }
+    const size_t n = t.size();
+    const std::string &type = t[0];
+
+    if (type == "Gain") {
+        double amplitude;
+        // 4.94e-324 is Double.Epsilon of C#
+        if (n != 2 || !ParseDouble(t[1], amplitude) || amplitude <= 4.94065645841247e-324) {
+            return nullptr;
+        }
+        return new WWAFGainFilter(amplitude);
+    }
+    if (type == "ZohUpsampler" || type == "InsertZeroesUpsampler") {
+        int factor;
+        if (n != 2 || !ParseInt(t[1], factor) || factor <= 1 || !IsPowerOfTwo(factor)) {
+            return nullptr;
+        }
+        if (type == "ZohUpsampler") {
+            return new WWAFZohUpsampler(factor);
+        }
+        return new WWAFInsertZeroesUpsampler(factor);
+    }
+    if (type == "LowPassFilter") {
+        double cutoffFrequency;
+        int filterLength;
+        int filterSlope;
+        if (n != 4
+                || !ParseDouble(t[1], cutoffFrequency) || cutoffFrequency <= 0
+                || !ParseInt(t[2], filterLength) || filterLength <= 0 || !IsPowerOfTwo(filterLength + 1)
+                || !ParseInt(t[3], filterSlope) || filterSlope <= 0) {
+            return nullptr;
+        }
+        return new WWAFLowpassFilter(cutoffFrequency, filterLength, filterSlope);
+    }
+    if (type == "FftUpsampler") {
+        int factor;
+        int fftLength = FFT_UPSAMPLER_DEFAULT_FFT_LENGTH;
+        if ((n != 2 && n != 3) || !ParseInt(t[1], factor) || factor <= 1 || !IsPowerOfTwo(factor)) {
+            return nullptr;
+        }
+        if (n == 3 && (!ParseInt(t[2], fftLength) || fftLength < 1024 || !IsPowerOfTwo(fftLength))) {
+            return nullptr;
+        }
+        return new WWAFFftUpsampler(factor, fftLength);
+    }
+    if (type == "Mash2") {
+        int tbps;
+        if (n != 2 || !ParseInt(t[1], tbps) || tbps != 1) {
+            return nullptr;
+        }
+        return new WWAFMashFilter();
+    }
+    if (type == "NoiseShaping") {
+        int tbps;
+        int order;
+        if (n != 3 || !ParseInt(t[1], tbps) || tbps < 1 || 23 < tbps || !ParseInt(t[2], order) || order != 2) {
+            return nullptr;
+        }
+        return new WWAFNoiseShapingFilter(tbps);
+    }
+    if (type == "NoiseShaping4th") {
+        int tbps;
+        if (n != 2 || !ParseInt(t[1], tbps) || tbps < 1 || 23 < tbps) {
+            return nullptr;
+        }
+        return new WWAFNoiseShaping4thFilter(tbps);
+    }
+    if (type == "TagEdit") {
+        if (n != 3 || (t[1] != "Title" && t[1] != "Artist" && t[1] != "Album" && t[1] != "AlbumArtist" && t[1] != "Genre")) {
+            return nullptr;
+        }
+        return new WWAFTagEditFilter(t[1], t[2]);
+    }
+    if (type == "Downsampler") {
+        int factor;
+        int pickSampleIndex;
+        if (n != 3 || !ParseInt(t[1], factor) || factor <= 1 || !IsPowerOfTwo(factor)
+                || !ParseInt(t[2], pickSampleIndex) || pickSampleIndex < 0 || factor <= pickSampleIndex) {
+            return nullptr;
+        }
+        return new WWAFDownsampler(factor, pickSampleIndex);
+    }
+    if (type == "CicFilter") {
+        // CicType has only one member (Single). CicFilter.Restore() of WWAudioFilter rejects any type
+        // because of the reversed comparison. here type 0 is accepted
+        int cicType;
+        int delay;
+        if (n != 3 || !ParseInt(t[1], cicType) || cicType != 0 || !ParseInt(t[2], delay) || delay < 1) {
+            return nullptr;
+        }
+        return new WWAFCicFilter(delay);
+    }
+    if (type == "HalfbandFilter") {
+        int filterLength;
+        if (n != 2 || !ParseInt(t[1], filterLength) || filterLength <= 0 || 3 != (filterLength & 3)) {
+            return nullptr;
+        }
+        return new WWAFHalfbandFilter(filterLength);
+    }
+    if (type == "Crossfeed") {
+        if (n != 2) {
+            return nullptr;
+        }
+        return WWAFCrossfeedFilter::Create(t[1]);
+    }
+
+    return nullptr;
+}
+
+static bool
+ReadLine(FILE *fp, std::string &line_return)
+{
+    line_return.clear();
+
+    int c;
+    while (EOF != (c = fgetc(fp))) {
+        if (c == '\n') {
+            break;
+        }
+        line_return += (char)c;
+    }
+    return c != EOF || !line_return.empty();
+}
+
+static std::string
+Trim(const std::string &s)
+{
+    static const char *WHITESPACES = " \t\r\n\v\f";
+    const size_t from = s.find_first_not_of(WHITESPACES);
+    if (from == std::string::npos) {
+        return std::string();
+    }
+    const size_t to = s.find_last_not_of(WHITESPACES);
+    return s.substr(from, to - from + 1);
+}
+
+int
+WWAFLoadFiltersFromFile(const char *path, std::vector<WWAFFilterBase *> &filters_return)
+{
+    filters_return.clear();
+
+    FILE *fp = nullptr;
+#ifdef _MSC_VER
+    if (0 != fopen_s(&fp, path, "rb")) {
+        fp = nullptr;
+    }
+#else
+    fp = fopen(path, "rb");
+#endif
+    if (nullptr == fp) {
+        printf("Error: Read failed: %s\n", path);
+        return -1;
+    }
+
+    int result = -1;
+    std::string line;
+    int version = 0;
+    int filterNum = 0;
+
+    // header: version number and number of filters
+    if (!ReadLine(fp, line)) {
+        printf("Error: Read failed: %s\n", path);
+        goto end;
+    }
+    line = Trim(line);
+    // the file saved by WWAudioFilter starts with UTF-8 BOM
+    if (0 == line.compare(0, 3, "\xef\xbb\xbf")) {
+        line = line.substr(3);
+    }
+    if (2 != sscanf(line.c_str(), "%d %d", &version, &filterNum)) {
+        printf("Error: Read failed: %s\n", path);
+        goto end;
+    }
+    if (version != WWAF_FILTER_FILE_VERSION) {
+        printf("Error: filter file version mismatch. expected=%d, actual=%d\n", WWAF_FILTER_FILE_VERSION, version);
+        goto end;
+    }
+    if (filterNum < 0) {
+        printf("Error: Read failed. bad filter count %d\n", filterNum);
+        goto end;
+    }
+
+    for (int i=0; i<filterNum; ++i) {
+        if (!ReadLine(fp, line)) {
+            printf("Error: Read failed. line=%d\n", i + 2);
+            goto end;
+        }
+        line = Trim(line);
+
+        WWAFFilterBase *f = WWAFCreateFilter(line);
+        if (nullptr == f) {
+            printf("Error: Read failed. line=%d, %s\n", i + 2, line.c_str());
+            goto end;
+        }
+        filters_return.push_back(f);
+    }
+
+    result = 0;
+
+end:
+    fclose(fp);
+    if (result < 0) {
+        WWAFDeleteFilters(filters_return);
+    }
+    return result;
+}
+
+void
+WWAFDeleteFilters(std::vector<WWAFFilterBase *> &filters)
+{
+    for (size_t i=0; i<filters.size(); ++i) {
+        delete filters[i];
+    }
+    filters.clear();
+}
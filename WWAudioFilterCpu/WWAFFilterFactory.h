@@ -0,0 +1,20 @@
+#pragma once
+
+#include "WWAFFilter.h"
+#include <string>
+#include <vector>
+
+/// version number on the header line of the filter file
+#define WWAF_FILTER_FILE_VERSION (1)
+
+/// creates the filter of a line of the filter file of WWAudioFilter, such as "FftUpsampler 8 262144".
+/// the parameters are checked as FilterFactory.Create() of WWAudioFilter
+/// @return nullptr: unknown filter or bad parameter
+WWAFFilterBase *WWAFCreateFilter(const std::string &line);
+
+/// reads the filter file saved by WWAudioFilter
+/// @param filters_return the filters are allocated by new. delete them by WWAFDeleteFilters()
+/// @return 0: success. negative: read error or bad filter
+int WWAFLoadFiltersFromFile(const char *path, std::vector<WWAFFilterBase *> &filters_return);
+
+void WWAFDeleteFilters(std::vector<WWAFFilterBase *> &filters);
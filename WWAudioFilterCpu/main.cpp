@@ -0,0 +1,336 @@
+// Native batch engine of the WWAudioFilter filter graph. Portable C++: builds on Windows and Linux.
+
+#include "WWAFEngine.h"
+#include "WWAFFilterFactory.h"
+#include "WWLoudness.h"
+#include "WWWavFile.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+/// output is 24bit. the same as the FLAC output of WWAudioFilter
+#define OUTPUT_BITS_PER_SAMPLE (24)
+
+/// reads the whole data chunk into the channels
+static bool
+ReadWavPcm(FILE *fp, const WWWavFormat &f, std::vector<std::vector<float> > &pcm_return)
+{
+    pcm_return.resize(f.numChannels);
+    for (int ch=0; ch<f.numChannels; ++ch) {
+        pcm_return[ch].resize((size_t)f.numFrames);
+    }
+
+    const int CHUNK_FRAMES = 65536;
+    std::vector<uint8_t> buff((size_t)CHUNK_FRAMES * f.BytesPerFrame());
+    std::vector<float> samples((size_t)CHUNK_FRAMES * f.numChannels);
+    for (int64_t pos=0; pos<f.numFrames; pos += CHUNK_FRAMES) {
+        const int frames = (int)std::min((int64_t)CHUNK_FRAMES, f.numFrames - pos);
+        if (fread(&buff[0], f.BytesPerFrame(), frames, fp) != (size_t)frames) {
+            return false;
+        }
+
+        WWWavDecodeSamples(&buff[0], f, (size_t)frames * f.numChannels, &samples[0]);
+        for (int i=0; i<frames; ++i) {
+            for (int ch=0; ch<f.numChannels; ++ch) {
+                pcm_return[ch][(size_t)(pos + i)] = samples[(size_t)i * f.numChannels + ch];
+            }
+        }
+    }
+    return true;
+}
+
+static bool
+WriteWavPcm24(FILE *fp, const std::vector<std::vector<int32_t> > &pcm, int64_t numFrames)
+{
+    const int numChannels = (int)pcm.size();
+    const int CHUNK_FRAMES = 65536;
+    std::vector<uint8_t> buff((size_t)CHUNK_FRAMES * numChannels * 3);
+    for (int64_t pos=0; pos<numFrames; pos += CHUNK_FRAMES) {
+        const int frames = (int)std::min((int64_t)CHUNK_FRAMES, numFrames - pos);
+        uint8_t *p = &buff[0];
+        for (int i=0; i<frames; ++i) {
+            for (int ch=0; ch<numChannels; ++ch) {
+                const int32_t v = pcm[ch][(size_t)(pos + i)];
+                p[0] = (uint8_t)(v & 0xff);
+                p[1] = (uint8_t)((v >> 8) & 0xff);
+                p[2] = (uint8_t)((v >> 16) & 0xff);
+                p += 3;
+            }
+        }
+        if (fwrite(&buff[0], 3 * numChannels, frames, fp) != (size_t)frames) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// runs the filters on the channels and prints the speed
+/// @return 0: success
+static int
+RunEngine(const std::vector<WWAFFilterBase *> &filters, const WWWavFormat &f,
+        const std::vector<std::vector<float> > &in, int numThreads, WWAFEngine &engine,
+        std::vector<std::vector<int32_t> > &out_return)
+{
+    if (engine.Init(filters, f.numChannels, f.sampleRate, f.numFrames, numThreads) < 0) {
+        printf("Error: filter setup failed\n");
+        return 1;
+    }
+
+    const WWAFPcmFormat &outFmt = engine.OutputFormat();
+    std::vector<const float *> inPtr(f.numChannels);
+    std::vector<int32_t *> outPtr(f.numChannels);
+    out_return.resize(f.numChannels);
+    for (int ch=0; ch<f.numChannels; ++ch) {
+        out_return[ch].resize((size_t)outFmt.numSamples);
+        inPtr[ch]  = in[ch].data();
+        outPtr[ch] = out_return[ch].data();
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    engine.Run(&inPtr[0], &outPtr[0]);
+    auto t1 = std::chrono::steady_clock::now();
+
+    const double elapsed = std::chrono::duration<double>(t1 - t0).count();
+    const double seconds = (double)f.numFrames / f.sampleRate;
+    printf("%d ch %dHz %.1fs -> %dHz. processed in %.3fs, RTF=%.1f. %d of %d filters segmented\n",
+            f.numChannels, f.sampleRate, seconds, outFmt.sampleRate, elapsed, seconds / elapsed,
+            engine.NumSegmentedFilters(), (int)filters.size());
+
+    if (engine.Overflow()) {
+        printf("Warning: the output is clipped. max magnitude=%f\n", engine.MaxMagnitude());
+    }
+    return 0;
+}
+
+static int
+Run(const char *filterPath, const char *fromPath, const char *toPath, int numThreads)
+{
+    int result = 1;
+    std::vector<WWAFFilterBase *> filters;
+    std::vector<std::vector<float> > in;
+    std::vector<std::vector<int32_t> > out;
+    WWAFEngine engine;
+    WWWavFormat f;
+    FILE *fpIn = nullptr;
+    FILE *fpOut = nullptr;
+
+    if (WWAFLoadFiltersFromFile(filterPath, filters) < 0) {
+        goto end;
+    }
+
+    fpIn = fopen(fromPath, "rb");
+    if (nullptr == fpIn || WWWavReadHeader(fpIn, f) < 0 || !ReadWavPcm(fpIn, f, in)) {
+        printf("Error: Read failed %s\n", fromPath);
+        goto end;
+    }
+
+    if (0 != RunEngine(filters, f, in, numThreads, engine, out)) {
+        goto end;
+    }
+
+    fpOut = fopen(toPath, "wb");
+    if (nullptr == fpOut
+            || WWWavWriteHeader(fpOut, f.numChannels, engine.OutputFormat().sampleRate, OUTPUT_BITS_PER_SAMPLE, false,
+                    engine.OutputFormat().numSamples) < 0
+            || !WriteWavPcm24(fpOut, out, engine.OutputFormat().numSamples)
+            || WWWavWritePad(fpOut, engine.OutputFormat().numSamples * f.numChannels * 3) < 0) {
+        printf("Error: Write failed %s\n", toPath);
+        goto end;
+    }
+
+    printf("Succeeded to write %s\n", toPath);
+    result = 0;
+
+end:
+    if (fpOut) {
+        fclose(fpOut);
+        fpOut = nullptr;
+    }
+    if (fpIn) {
+        fclose(fpIn);
+        fpIn = nullptr;
+    }
+    WWAFDeleteFilters(filters);
+    return result;
+}
+
+/// processes a stereo 1kHz sine with white noise of the length and prints the real-time factor
+static int
+Benchmark(const char *filterPath, int sampleRate, int seconds, int numThreads)
+{
+    std::vector<WWAFFilterBase *> filters;
+    if (WWAFLoadFiltersFromFile(filterPath, filters) < 0) {
+        return 1;
+    }
+
+    WWWavFormat f;
+    f.numChannels = 2;
+    f.sampleRate = sampleRate;
+    f.bitsPerSample = 24;
+    f.numFrames = (int64_t)sampleRate * seconds;
+
+    std::vector<std::vector<float> > in(f.numChannels);
+    uint32_t rnd = 1;
+    for (int ch=0; ch<f.numChannels; ++ch) {
+        in[ch].resize((size_t)f.numFrames);
+        for (int64_t i=0; i<f.numFrames; ++i) {
+            rnd = rnd * 1664525 + 1013904223;
+            in[ch][(size_t)i] = (float)(0.5 * sin(2.0 * M_PI * 1000.0 * i / sampleRate)
+                    + (int32_t)rnd * (0.01 / 2147483648.0));
+        }
+    }
+
+    WWAFEngine engine;
+    std::vector<std::vector<int32_t> > out;
+    const int result = RunEngine(filters, f, in, numThreads, engine, out);
+
+    WWAFDeleteFilters(filters);
+    return result;
+}
+
+/// WAV file of the loudness batch. opened when the measurement of the file starts, and closed at the end
+struct LoudnessSource {
+    const char *path;
+    WWWavFormat f;
+    FILE *fp;
+    bool failed;
+    std::vector<uint8_t> buff;
+
+    void Read(int64_t fromFrame, int frames, float *out_return) {
+        memset(out_return, 0, sizeof(float) * frames * f.numChannels);
+
+        if (0 == fromFrame) {
+            fp = fopen(path, "rb");
+            if (nullptr == fp || WWFileSeek(fp, f.dataOffset, SEEK_SET) != 0) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            return;
+        }
+
+        buff.resize((size_t)frames * f.BytesPerFrame());
+        if (fread(&buff[0], f.BytesPerFrame(), frames, fp) != (size_t)frames) {
+            failed = true;
+        } else {
+            WWWavDecodeSamples(&buff[0], f, (size_t)frames * f.numChannels, out_return);
+        }
+
+        if (f.numFrames <= fromFrame + frames || failed) {
+            fclose(fp);
+            fp = nullptr;
+            buff.clear();
+        }
+    }
+};
+
+static void
+PrintLoudness(const WWLoudnessResult &r, const char *name)
+{
+    printf("%8.2f %6.2f %7.2f %7.2f  %s\n", r.integrated, r.range, 20.0 * log10(r.truePeak), r.replayGainDb, name);
+}
+
+/// measures the loudness of the WAV files in parallel and prints the result of each file and of all the files as an album
+static int
+Loudness(int numFiles, char **paths, int numThreads)
+{
+    std::vector<LoudnessSource> sources(numFiles);
+    std::vector<WWLoudnessTrack> tracks(numFiles);
+
+    for (int i=0; i<numFiles; ++i) {
+        LoudnessSource &s = sources[i];
+        s.path = paths[i];
+        s.fp = nullptr;
+        s.failed = false;
+
+        FILE *fp = fopen(s.path, "rb");
+        if (nullptr == fp) {
+            printf("Error: could not open %s\n", s.path);
+            return 1;
+        }
+        const bool ok = 0 <= WWWavReadHeader(fp, s.f);
+        fclose(fp);
+        if (!ok) {
+            printf("Error: unsupported WAV file %s\n", s.path);
+            return 1;
+        }
+
+        WWLoudnessTrack &t = tracks[i];
+        t.sampleRate  = s.f.sampleRate;
+        t.numChannels = s.f.numChannels;
+        t.numFrames   = s.f.numFrames;
+        t.read = [&s](int64_t fromFrame, int frames, float *out_return) {
+            s.Read(fromFrame, frames, out_return);
+        };
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    std::vector<WWLoudnessResult> results;
+    WWLoudnessResult album;
+    if (WWLoudnessAnalyze(tracks, numThreads, results, album) < 0) {
+        printf("Error: loudness measurement failed\n");
+        return 1;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    int result = 0;
+    printf("    LUFS     LU    dBTP  RG(dB)\n");
+    for (int i=0; i<numFiles; ++i) {
+        if (sources[i].failed) {
+            printf("Error: read failed %s\n", sources[i].path);
+            result = 1;
+            continue;
+        }
+        PrintLoudness(results[i], sources[i].path);
+    }
+    PrintLoudness(album, "(album)");
+    printf("measured %d files in %.3fs\n", numFiles, elapsed);
+    return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *programName = argv[0];
+
+    // 0: the number of the hardware threads
+    int numThreads = 0;
+    if (3 <= argc && 0 == strcmp(argv[1], "-threads")) {
+        numThreads = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (3 <= argc && argc <= 5 && 0 == strcmp(argv[1], "-benchmark")) {
+        return Benchmark(argv[2], (4 <= argc) ? atoi(argv[3]) : 44100, (5 <= argc) ? atoi(argv[4]) : 60, numThreads);
+    }
+
+    if (3 <= argc && 0 == strcmp(argv[1], "-loudness")) {
+        return Loudness(argc - 2, &argv[2], numThreads);
+    }
+
+    if (argc != 4 || numThreads < 0) {
+        printf("Usage:\n"
+            " %s [-threads n] filterFile inputWavFile outputWavFile : applies the filters saved by WWAudioFilter. output is 24bit WAV\n"
+            " %s [-threads n] -benchmark filterFile [sampleRate] [seconds] : prints the real-time factor of the filters on stereo noise\n"
+            " %s [-threads n] -loudness wavFile... : prints the integrated loudness, loudness range, true peak and ReplayGain 2.0 gain\n"
+            "     of each file and of all the files as an album. the files are measured in parallel\n"
+            " -threads n : 1 processes each channel serially. default is the number of the hardware threads\n",
+            programName, programName, programName);
+        return 1;
+    }
+
+    return Run(argv[1], argv[2], argv[3], numThreads);
+}
@@ -0,0 +1,927 @@
+// CPU crossfeed of the CFD2 coefficient file. Portable C++: builds on Windows and Linux.
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#endif
+
+#include "WWCrossfeed.h"
+#include "WWWavFile.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// frames processed at once
+#define PROCESS_FRAMES       (4096)
+
+/// convolver partition size of the file conversion
+#define DEFAULT_BLOCK_FRAMES (4096)
+
+/// output is 24bit. the same as WWCudaCrossfeed
+#define OUTPUT_BITS_PER_SAMPLE (24)
+#define OUTPUT_MAX_VALUE     (8388607.0f / 8388608.0f)
+
+/// reads frames and converts to float. frames after the end of the data are 0
+static void
+ReadFloatFrames(FILE *fp, const WWWavFormat &f, int64_t framePos, int frames, std::vector<uint8_t> &buff, float *to)
+{
+    const int64_t remain = f.numFrames - framePos;
+    const int readFrames = (remain < frames) ? (0 < remain ? (int)remain : 0) : frames;
+    const int numSamples = frames * f.numChannels;
+
+    buff.resize((size_t)frames * f.BytesPerFrame());
+    const size_t readBytes = fread(&buff[0], 1, (size_t)readFrames * f.BytesPerFrame(), fp);
+    const int readSamples = (int)(readBytes / (f.bitsPerSample / 8));
+
+    WWWavDecodeSamples(&buff[0], f, readSamples, to);
+    for (int i=readSamples; i<numSamples; ++i) {
+        to[i] = 0.0f;
+    }
+}
+
+/// measures the peak of the output frames of a chunk and writes them as 24bit. the convolver latency is trimmed.
+/// @param outPos output frame position of the first frame of out. negative while the latency
+/// @param fpOut nullptr: only measures the peak
+static bool
+EncodeFrames(const float *out, int frames, int64_t outPos, const WWWavFormat &f, float scale,
+        FILE *fpOut, std::vector<uint8_t> &outBuff, float *peak_inout)
+{
+    int from = 0;
+    int to = frames;
+    if (outPos < 0) {
+        from = (int)((-outPos < frames) ? -outPos : frames);
+    }
+    if (f.numFrames - outPos < to) {
+        to = (int)(f.numFrames - outPos);
+    }
+
+    float peak = *peak_inout;
+    for (int i=from*2; i<to*2; ++i) {
+        const float v = fabsf(out[i]);
+        if (peak < v) {
+            peak = v;
+        }
+    }
+    *peak_inout = peak;
+
+    if (fpOut && from < to) {
+        outBuff.resize((size_t)frames * 2 * 3);
+        for (int i=from*2; i<to*2; ++i) {
+            int v = (int)(out[i] * scale * 8388608.0f);
+            if (8388607 < v) {
+                v = 8388607;
+            }
+            if (v < -8388608) {
+                v = -8388608;
+            }
+            outBuff[(i - from * 2) * 3 + 0] = (uint8_t)(v & 0xff);
+            outBuff[(i - from * 2) * 3 + 1] = (uint8_t)((v >> 8) & 0xff);
+            outBuff[(i - from * 2) * 3 + 2] = (uint8_t)((v >> 16) & 0xff);
+        }
+        const size_t bytes = (size_t)(to - from) * 2 * 3;
+        if (fwrite(&outBuff[0], 1, bytes, fpOut) != bytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @return number of PROCESS_FRAMES chunks to output the whole file: the input and the convolver latency
+static int64_t
+NumChunks(const WWWavFormat &f, int latency)
+{
+    return (f.numFrames + latency + PROCESS_FRAMES - 1) / PROCESS_FRAMES;
+}
+
+/// Runs the crossfeed over the whole file. the output is aligned with the input: the convolver latency is removed.
+/// @param fpOut nullptr: only measures the peak
+static bool
+CrossfeedFile(FILE *fpIn, const WWWavFormat &f, WWCrossfeed &cf, float scale, FILE *fpOut, float *peak_return)
+{
+    const int latency = cf.LatencyFrames();
+    const int64_t numChunks = NumChunks(f, latency);
+    std::vector<uint8_t> inBuff;
+    std::vector<float> in(PROCESS_FRAMES * 2);
+    std::vector<float> out(PROCESS_FRAMES * 2);
+    std::vector<uint8_t> outBuff;
+    float peak = 0.0f;
+
+    cf.Reset();
+    WWFileSeek(fpIn, f.dataOffset, SEEK_SET);
+
+    // skips the first latency frames of the output and feeds zeros after the end of the input
+    for (int64_t c=0; c<numChunks; ++c) {
+        ReadFloatFrames(fpIn, f, c * PROCESS_FRAMES, PROCESS_FRAMES, inBuff, &in[0]);
+        cf.Process(&in[0], PROCESS_FRAMES, &out[0]);
+        if (!EncodeFrames(&out[0], PROCESS_FRAMES, c * PROCESS_FRAMES - latency, f, scale, fpOut, outBuff, &peak)) {
+            return false;
+        }
+    }
+
+    *peak_return = peak;
+    return true;
+}
+
+static int
+ReadCoeffs(const char *path, WWCrossfeedCoeffs &c_return)
+{
+    FILE *fp = fopen(path, "rb");
+    if (nullptr == fp) {
+        printf("Error: could not open %s\n", path);
+        return 1;
+    }
+    int rv = WWCrossfeedReadCfd2(fp, c_return);
+    fclose(fp);
+    if (rv < 0) {
+        printf("Error: could not read crossfeed param file %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+Run(const char *coeffPath, const char *fromPath, const char *toPath)
+{
+    int result = 1;
+    WWCrossfeed cf;
+    WWWavFormat f;
+    FILE *fpIn = nullptr;
+    FILE *fpOut = nullptr;
+    float peak = 0.0f;
+    float scale = 1.0f;
+
+    // the partition spectra are mapped from the cache file when it is available
+    if (cf.InitFromFile(coeffPath, DEFAULT_BLOCK_FRAMES) < 0) {
+        printf("Error: could not read crossfeed param file %s\n", coeffPath);
+        goto end;
+    }
+
+    fpIn = fopen(fromPath, "rb");
+    if (nullptr == fpIn || WWWavReadHeader(fpIn, f) < 0) {
+        printf("Error: Read failed %s\n", fromPath);
+        goto end;
+    }
+    if (2 != f.numChannels) {
+        printf("Error: channel count mismatch. WAV ch=%d, crossfeed ch=2\n", f.numChannels);
+        goto end;
+    }
+    if (f.sampleRate != cf.SampleRate()) {
+        printf("Error: samplerate mismatch. WAV=%d, crossfeed=%d\n", f.sampleRate, cf.SampleRate());
+        goto end;
+    }
+
+    // first pass measures the peak. the output is scaled down when it clips, as WWCudaCrossfeed does
+    if (!CrossfeedFile(fpIn, f, cf, 1.0f, nullptr, &peak)) {
+        goto end;
+    }
+    if (OUTPUT_MAX_VALUE < peak) {
+        scale = OUTPUT_MAX_VALUE / peak;
+    }
+
+    fpOut = fopen(toPath, "wb");
+    if (nullptr == fpOut || WWWavWriteHeader(fpOut, 2, f.sampleRate, OUTPUT_BITS_PER_SAMPLE, false, f.numFrames) < 0) {
+        printf("Error: Write failed %s\n", toPath);
+        goto end;
+    }
+    if (!CrossfeedFile(fpIn, f, cf, scale, fpOut, &peak)) {
+        printf("Error: Write failed %s\n", toPath);
+        goto end;
+    }
+
+    printf("Succeeded to write %s. gain=%f\n", toPath, scale);
+    result = 0;
+
+end:
+    if (fpOut) {
+        fclose(fpOut);
+        fpOut = nullptr;
+    }
+    if (fpIn) {
+        fclose(fpIn);
+        fpIn = nullptr;
+    }
+    return result;
+}
+
+/// processes white noise of several lengths and prints the real-time factor: seconds of audio per second of processing.
+static int
+Benchmark(const char *coeffPath)
+{
+    static const int blockFramesList[] = { 256, 1024, 4096 };
+    static const int secondsList[] = { 10, 60, 600 };
+
+    WWCrossfeedCoeffs coeffs;
+    if (0 != ReadCoeffs(coeffPath, coeffs)) {
+        return 1;
+    }
+
+    printf("CFD2 %d taps, %dHz\n", coeffs.numTaps, coeffs.sampleRate);
+    printf("block  length(s) time(s)   RTF      memory(KB)\n");
+
+    std::vector<float> in(PROCESS_FRAMES * 2);
+    std::vector<float> out(PROCESS_FRAMES * 2);
+    uint32_t rnd = 1;
+    for (size_t i=0; i<in.size(); ++i) {
+        rnd = rnd * 1664525 + 1013904223;
+        in[i] = (float)(int32_t)rnd * (0.5f / 2147483648.0f);
+    }
+
+    for (int b=0; b<(int)(sizeof blockFramesList / sizeof blockFramesList[0]); ++b) {
+        WWCrossfeed cf;
+        if (cf.Init(coeffs, blockFramesList[b]) < 0) {
+            printf("Error: crossfeed init failed\n");
+            return 1;
+        }
+
+        for (int s=0; s<(int)(sizeof secondsList / sizeof secondsList[0]); ++s) {
+            const int64_t totalFrames = (int64_t)secondsList[s] * coeffs.sampleRate;
+            cf.Reset();
+            auto t0 = std::chrono::steady_clock::now();
+            for (int64_t pos=0; pos<totalFrames; pos += PROCESS_FRAMES) {
+                cf.Process(&in[0], PROCESS_FRAMES, &out[0]);
+            }
+            auto t1 = std::chrono::steady_clock::now();
+
+            const double elapsed = std::chrono::duration<double>(t1 - t0).count();
+            printf("%5d  %9d %8.3f %8.1f %10d\n", blockFramesList[b], secondsList[s], elapsed,
+                    secondsList[s] / elapsed, (int)(cf.AllocatedBytes() / 1024));
+        }
+    }
+
+    return 0;
+}
+
+/// stretches the impulse responses to the sample rate. the processing cost depends only on the number of taps
+static void
+StretchCoeffs(const WWCrossfeedCoeffs &from, int sampleRate, WWCrossfeedCoeffs &to_return)
+{
+    const double ratio = (double)from.sampleRate / sampleRate;
+
+    to_return.sampleRate = sampleRate;
+    to_return.numTaps = (int)((int64_t)from.numTaps * sampleRate / from.sampleRate);
+    for (int i=0; i<WW_CROSSFEED_COEFF_NUM; ++i) {
+        to_return.coeffs[i].resize(to_return.numTaps);
+        for (int t=0; t<to_return.numTaps; ++t) {
+            const double pos = t * ratio;
+            const int t0 = (int)pos;
+            const int t1 = std::min(t0 + 1, from.numTaps - 1);
+            const float a = (float)(pos - t0);
+            to_return.coeffs[i][t] = (float)ratio * ((1.0f - a) * from.coeffs[i][t0] + a * from.coeffs[i][t1]);
+        }
+    }
+}
+
+/// simulates the render thread of WasapiIODLL on a null sink: calls the crossfeed of
+/// WW_CROSSFEED_REALTIME_BLOCK_FRAMES once every 1ms period and measures the time of each call.
+/// the same input is processed several times and the fastest time of each call is taken,
+/// so that preemption of the measuring thread by the OS is not counted as the cost of the crossfeed.
+/// @return 0: the worst call fits in the period. 1: it does not
+static int
+CallbackTest(const char *coeffPath, int sampleRate)
+{
+    static const int SECONDS = 10;
+    static const int RUNS = 5;
+
+    WWCrossfeedCoeffs fileCoeffs;
+    WWCrossfeedCoeffs coeffs;
+    if (0 != ReadCoeffs(coeffPath, fileCoeffs)) {
+        return 1;
+    }
+    if (sampleRate <= 0) {
+        sampleRate = fileCoeffs.sampleRate;
+    }
+    StretchCoeffs(fileCoeffs, sampleRate, coeffs);
+
+    WWCrossfeed cf;
+    if (cf.Init(coeffs, WW_CROSSFEED_REALTIME_BLOCK_FRAMES) < 0) {
+        printf("Error: crossfeed init failed\n");
+        return 1;
+    }
+
+    // 1ms exclusive mode period
+    const int periodFrames = sampleRate / 1000;
+    const double periodSec = (double)periodFrames / sampleRate;
+    const int numCallbacks = SECONDS * sampleRate / periodFrames;
+
+    std::vector<float> in(periodFrames * 2);
+    std::vector<float> out(periodFrames * 2);
+    std::vector<double> elapsed(numCallbacks, 1.0e10);
+    double rawWorst = 0;
+
+    for (int r=0; r<RUNS; ++r) {
+        uint32_t rnd = 1;
+        cf.Reset();
+
+        for (int c=0; c<numCallbacks; ++c) {
+            for (size_t i=0; i<in.size(); ++i) {
+                rnd = rnd * 1664525 + 1013904223;
+                in[i] = (float)(int32_t)rnd * (0.5f / 2147483648.0f);
+            }
+
+            auto t0 = std::chrono::steady_clock::now();
+            cf.Process(&in[0], periodFrames, &out[0]);
+            auto t1 = std::chrono::steady_clock::now();
+
+            const double t = std::chrono::duration<double>(t1 - t0).count();
+            elapsed[c] = std::min(elapsed[c], t);
+            rawWorst = std::max(rawWorst, t);
+        }
+    }
+
+    double total = 0;
+    for (int c=0; c<numCallbacks; ++c) {
+        total += elapsed[c];
+    }
+    std::sort(elapsed.begin(), elapsed.end());
+    const double worst = elapsed[numCallbacks - 1];
+
+    printf("CFD2 %d taps at %dHz, %d taps (crossover included) at %dHz\n",
+            fileCoeffs.numTaps, fileCoeffs.sampleRate, cf.NumTaps(), sampleRate);
+    printf("period %d frames (%.3fms), block %d frames, %d callbacks x %d runs\n",
+            periodFrames, periodSec * 1000.0, WW_CROSSFEED_REALTIME_BLOCK_FRAMES, numCallbacks, RUNS);
+    printf("average %.4fms, 99.9%% %.4fms, worst %.4fms (%.1f%% of the period). worst including preemption %.4fms\n",
+            total / numCallbacks * 1000.0,
+            elapsed[(size_t)(numCallbacks * 0.999)] * 1000.0,
+            worst * 1000.0, worst / periodSec * 100.0, rawWorst * 1000.0);
+
+    if (periodSec < worst) {
+        printf("Error: the worst callback time exceeds the period\n");
+        return 1;
+    }
+    printf("Succeeded: the worst callback time fits in the period\n");
+    return 0;
+}
+
+/// @return CPU time of all threads of the process in seconds
+static double
+ProcessCpuSeconds(void)
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+    const uint64_t t100ns = ((uint64_t)kernelTime.dwHighDateTime << 32) + kernelTime.dwLowDateTime
+                          + ((uint64_t)userTime.dwHighDateTime << 32) + userTime.dwLowDateTime;
+    return t100ns * 1.0e-7;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/// one convolver configuration of ConvolverBenchmark()
+struct ConvolverBenchmarkResult {
+    double elapsedSec;
+    double cpuSec;
+    int latencyFrames;
+    size_t allocatedBytes;
+};
+
+template <typename T>
+static void
+ConvolverBenchmarkRun(T &conv, const std::vector<float> &in, int callFrames,
+        std::vector<float> &out_return, ConvolverBenchmarkResult &r_return)
+{
+    const int frames = (int)in.size();
+    out_return.resize(frames);
+
+    const double cpu0 = ProcessCpuSeconds();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int pos=0; pos<frames; pos += callFrames) {
+        conv.Process(&in[pos], std::min(callFrames, frames - pos), &out_return[pos]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    r_return.elapsedSec = std::chrono::duration<double>(t1 - t0).count();
+    r_return.cpuSec = ProcessCpuSeconds() - cpu0;
+    r_return.latencyFrames = conv.LatencyFrames();
+    r_return.allocatedBytes = conv.AllocatedBytes();
+}
+
+/// convolves white noise with decaying noise impulse responses of 1s, 4s and 10s (as the room reflection FIR of WWCrossFeed)
+/// by the uniformly partitioned convolver of small blocks, of a single large block
+/// and by the non-uniformly partitioned convolver, and prints the latency and the speed of them.
+/// RTF is seconds of audio per second of processing. the CPU RTF counts the time of the background threads too.
+static int
+ConvolverBenchmark(int sampleRate)
+{
+    static const int irSecondsList[] = { 1, 4, 10 };
+    static const int BLOCK_FRAMES = WW_CROSSFEED_REALTIME_BLOCK_FRAMES;
+    static const char *names[] = { "uniform small", "uniform large", "non-uniform" };
+
+    printf("%dHz, processed %d frames per call\n", sampleRate, BLOCK_FRAMES);
+    printf("IR(s) convolver       latency(ms) RTF(wall) RTF(CPU) memory(KB) error(dB)\n");
+
+    uint32_t rnd = 1;
+    for (int k=0; k<(int)(sizeof irSecondsList / sizeof irSecondsList[0]); ++k) {
+        const int taps = irSecondsList[k] * sampleRate;
+
+        // -60dB at the end
+        std::vector<float> h(taps);
+        for (int t=0; t<taps; ++t) {
+            rnd = rnd * 1664525 + 1013904223;
+            h[t] = (float)(int32_t)rnd * (1.0f / 2147483648.0f) * (float)pow(10.0, -3.0 * t / taps) * 0.01f;
+        }
+
+        int largeBlock = BLOCK_FRAMES;
+        while (largeBlock < taps) {
+            largeBlock *= 2;
+        }
+
+        // the single large block convolver outputs a block every largeBlock frames
+        std::vector<float> in((size_t)largeBlock * 4);
+        for (size_t i=0; i<in.size(); ++i) {
+            rnd = rnd * 1664525 + 1013904223;
+            in[i] = (float)(int32_t)rnd * (0.5f / 2147483648.0f);
+        }
+        const double signalSec = (double)in.size() / sampleRate;
+
+        std::vector<float> ref;
+        std::vector<float> out;
+        ConvolverBenchmarkResult r[3];
+
+        {
+            WWPartitionedConvolver conv;
+            if (conv.Init(1, 1, BLOCK_FRAMES, taps) < 0) {
+                printf("Error: convolver init failed\n");
+                return 1;
+            }
+            conv.SetFilter(0, 0, &h[0], taps);
+            ConvolverBenchmarkRun(conv, in, BLOCK_FRAMES, ref, r[0]);
+        }
+        {
+            WWPartitionedConvolver conv;
+            if (conv.Init(1, 1, largeBlock, taps) < 0) {
+                printf("Error: convolver init failed\n");
+                return 1;
+            }
+            conv.SetFilter(0, 0, &h[0], taps);
+            ConvolverBenchmarkRun(conv, in, BLOCK_FRAMES, out, r[1]);
+        }
+        {
+            WWNonUniformConvolver conv;
+            if (conv.Init(1, 1, BLOCK_FRAMES, WW_CROSSFEED_MAX_BLOCK_FRAMES, taps) < 0) {
+                printf("Error: convolver init failed\n");
+                return 1;
+            }
+            conv.SetFilter(0, 0, &h[0], taps);
+            ConvolverBenchmarkRun(conv, in, BLOCK_FRAMES, out, r[2]);
+        }
+
+        // the non-uniform convolver has the same latency as the uniform convolver of small blocks
+        float peak = 0;
+        float maxDiff = 0;
+        for (size_t i=0; i<ref.size(); ++i) {
+            peak = std::max(peak, fabsf(ref[i]));
+            maxDiff = std::max(maxDiff, fabsf(ref[i] - out[i]));
+        }
+
+        for (int c=0; c<3; ++c) {
+            printf("%5d %-15s %11.1f %9.1f %8.1f %10d",
+                    irSecondsList[k], names[c], r[c].latencyFrames * 1000.0 / sampleRate,
+                    signalSec / r[c].elapsedSec, signalSec / r[c].cpuSec, (int)(r[c].allocatedBytes / 1024));
+            if (c == 2) {
+                printf(" %9.1f", 20.0 * log10(maxDiff / peak + 1e-30));
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
+
+/// prints the time to start the crossfeed: parsing the CFD2 text and transforming the coefficients,
+/// the same and writing the compiled spectrum cache, and mapping the cache
+static int
+StartupBenchmark(const char *coeffPath)
+{
+    static const int blockFramesList[] = { WW_CROSSFEED_REALTIME_BLOCK_FRAMES, DEFAULT_BLOCK_FRAMES };
+    static const int RUNS = 5;
+
+    printf("block  parse+FFT(ms) write cache(ms) map cache(ms) cache(KB)\n");
+
+    for (int b=0; b<(int)(sizeof blockFramesList / sizeof blockFramesList[0]); ++b) {
+        const int blockFrames = blockFramesList[b];
+        const std::string cachePath = WWCrossfeedCachePath(coeffPath, blockFrames);
+        double parseSec = 1.0e10;
+        double writeSec = 1.0e10;
+        double mapSec = 1.0e10;
+
+        for (int r=0; r<RUNS; ++r) {
+            {
+                WWCrossfeedCoeffs coeffs;
+                WWCrossfeed cf;
+                auto t0 = std::chrono::steady_clock::now();
+                if (0 != ReadCoeffs(coeffPath, coeffs) || cf.Init(coeffs, blockFrames) < 0) {
+                    printf("Error: crossfeed init failed\n");
+                    return 1;
+                }
+                auto t1 = std::chrono::steady_clock::now();
+                parseSec = std::min(parseSec, std::chrono::duration<double>(t1 - t0).count());
+            }
+            {
+                remove(cachePath.c_str());
+
+                WWCrossfeed cf;
+                auto t0 = std::chrono::steady_clock::now();
+                if (0 != cf.InitFromFile(coeffPath, blockFrames)) {
+                    printf("Error: crossfeed init failed\n");
+                    return 1;
+                }
+                auto t1 = std::chrono::steady_clock::now();
+                writeSec = std::min(writeSec, std::chrono::duration<double>(t1 - t0).count());
+            }
+            {
+                WWCrossfeed cf;
+                auto t0 = std::chrono::steady_clock::now();
+                if (1 != cf.InitFromFile(coeffPath, blockFrames)) {
+                    printf("Error: could not map the cache file %s\n", cachePath.c_str());
+                    return 1;
+                }
+                auto t1 = std::chrono::steady_clock::now();
+                mapSec = std::min(mapSec, std::chrono::duration<double>(t1 - t0).count());
+            }
+        }
+
+        long cacheBytes = 0;
+        FILE *fp = fopen(cachePath.c_str(), "rb");
+        if (fp) {
+            fseek(fp, 0, SEEK_END);
+            cacheBytes = ftell(fp);
+            fclose(fp);
+        }
+
+        printf("%5d %14.3f %15.3f %13.3f %9ld\n", blockFrames,
+                parseSec * 1000.0, writeSec * 1000.0, mapSec * 1000.0, cacheBytes / 1024);
+    }
+
+    return 0;
+}
+
+/// chunks in flight per file of the batch. bounds the memory regardless of the file size
+#define BATCH_CHUNKS_PER_FILE (4)
+
+struct BatchChunk {
+    std::vector<float> in;
+    std::vector<float> out;
+};
+
+/// one file of the batch. the pipeline of it is decode -> convolve -> encode, each stage runs on a thread of the pool
+/// and at most one task of a stage of a file runs at a time. the chunks are passed in order through the queues.
+/// the crossfeed is run twice as Run(): pass 0 measures the peak and pass 1 writes the output
+struct BatchFile {
+    std::string fromPath;
+    std::string toPath;
+    WWWavFormat f;
+    FILE *fpIn;
+    FILE *fpOut;
+    WWCrossfeed cf;
+    std::vector<uint8_t> inBuff;
+    std::vector<uint8_t> outBuff;
+
+    int pass;
+    float peak;
+    float scale;
+    int64_t numChunks;
+
+    /// chunks of the pass handed to each stage so far
+    int64_t decoded;
+    int64_t convolved;
+    int64_t encoded;
+
+    BatchChunk chunks[BATCH_CHUNKS_PER_FILE];
+    std::deque<BatchChunk *> freeQ;
+    std::deque<BatchChunk *> decodedQ;
+    std::deque<BatchChunk *> convolvedQ;
+
+    bool decodeBusy;
+    bool convolveBusy;
+    bool encodeBusy;
+    bool failed;
+
+    BatchFile(void) : fpIn(nullptr), fpOut(nullptr), pass(0), peak(0.0f), scale(1.0f), numChunks(0),
+            decoded(0), convolved(0), encoded(0), decodeBusy(false), convolveBusy(false), encodeBusy(false), failed(false) {
+        for (int i=0; i<BATCH_CHUNKS_PER_FILE; ++i) {
+            chunks[i].in.resize(PROCESS_FRAMES * 2);
+            chunks[i].out.resize(PROCESS_FRAMES * 2);
+            freeQ.push_back(&chunks[i]);
+        }
+    }
+
+    ~BatchFile(void) {
+        if (fpOut) {
+            fclose(fpOut);
+            fpOut = nullptr;
+        }
+        if (fpIn) {
+            fclose(fpIn);
+            fpIn = nullptr;
+        }
+    }
+
+    bool Busy(void) const { return decodeBusy || convolveBusy || encodeBusy; }
+    bool Finished(void) const { return 1 == pass && encoded == numChunks; }
+};
+
+enum BatchTaskType {
+    BTT_None,
+    BTT_Open,
+    BTT_Decode,
+    BTT_Convolve,
+    BTT_Encode,
+};
+
+class Batch {
+public:
+    Batch(const WWCrossfeed &master, const std::vector<std::string> &fromPaths, const std::string &toDir, int numThreads)
+            : mMaster(master), mFromPaths(fromPaths), mToDir(toDir), mNumThreads(numThreads),
+              mNextFile(0), mNumOpening(0), mNumSucceeded(0), mNumFailed(0), mTotalFrames(0), mRoundRobin(0) { }
+
+    /// processes all files. returns when all files are done
+    void Run(void) {
+        std::vector<std::thread> threads;
+        for (int i=0; i<mNumThreads; ++i) {
+            threads.push_back(std::thread(&Batch::WorkerThread, this));
+        }
+        for (size_t i=0; i<threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+
+    int NumSucceeded(void) const { return mNumSucceeded; }
+    int NumFailed(void) const { return mNumFailed; }
+    int64_t TotalFrames(void) const { return mTotalFrames; }
+
+private:
+    const WWCrossfeed &mMaster;
+    const std::vector<std::string> &mFromPaths;
+    std::string mToDir;
+    int mNumThreads;
+
+    /// guards all members below and the queues, flags and counters of the files
+    std::mutex mMutex;
+    std::condition_variable mCv;
+
+    size_t mNextFile;
+    int mNumOpening;
+    std::vector<BatchFile *> mActive;
+    int mNumSucceeded;
+    int mNumFailed;
+    int64_t mTotalFrames;
+    size_t mRoundRobin;
+
+    std::string ToPath(const std::string &fromPath) const {
+        size_t pos = fromPath.find_last_of("/\\");
+        const std::string name = (pos == std::string::npos) ? fromPath : fromPath.substr(pos + 1);
+        return mToDir + "/" + name;
+    }
+
+    /// picks a task. the later stages first, so that the chunks are drained and reused.
+    /// the number of files in progress is the number of threads
+    BatchTaskType PickTask(BatchFile **file_return, BatchChunk **chunk_return) {
+        for (size_t k=0; k<mActive.size(); ++k) {
+            BatchFile *p = mActive[(mRoundRobin + k) % mActive.size()];
+            if (p->failed) {
+                continue;
+            }
+            *file_return = p;
+            if (!p->encodeBusy && !p->convolvedQ.empty()) {
+                p->encodeBusy = true;
+                *chunk_return = p->convolvedQ.front();
+                p->convolvedQ.pop_front();
+                return BTT_Encode;
+            }
+            if (!p->convolveBusy && !p->decodedQ.empty()) {
+                p->convolveBusy = true;
+                *chunk_return = p->decodedQ.front();
+                p->decodedQ.pop_front();
+                return BTT_Convolve;
+            }
+            if (!p->decodeBusy && !p->freeQ.empty() && p->decoded < p->numChunks) {
+                p->decodeBusy = true;
+                *chunk_return = p->freeQ.front();
+                p->freeQ.pop_front();
+                return BTT_Decode;
+            }
+        }
+
+        if (mNextFile < mFromPaths.size() && (int)mActive.size() + mNumOpening < mNumThreads) {
+            BatchFile *p = new BatchFile();
+            p->fromPath = mFromPaths[mNextFile++];
+            p->toPath = ToPath(p->fromPath);
+            ++mNumOpening;
+            *file_return = p;
+            *chunk_return = nullptr;
+            return BTT_Open;
+        }
+        return BTT_None;
+    }
+
+    /// removes the file which is finished or failed and is not running any stage
+    void RetireFiles(void) {
+        for (size_t i=0; i<mActive.size(); ) {
+            BatchFile *p = mActive[i];
+            if ((p->failed || p->Finished()) && !p->Busy()) {
+                if (p->failed) {
+                    printf("Error: %s failed\n", p->fromPath.c_str());
+                    ++mNumFailed;
+                } else {
+                    printf("%s -> %s gain=%f\n", p->fromPath.c_str(), p->toPath.c_str(), p->scale);
+                    ++mNumSucceeded;
+                    mTotalFrames += p->f.numFrames;
+                }
+                delete p;
+                mActive.erase(mActive.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    bool Open(BatchFile *p) {
+        p->fpIn = fopen(p->fromPath.c_str(), "rb");
+        if (nullptr == p->fpIn || WWWavReadHeader(p->fpIn, p->f) < 0) {
+            printf("Error: Read failed %s\n", p->fromPath.c_str());
+            return false;
+        }
+        if (2 != p->f.numChannels || p->f.sampleRate != mMaster.SampleRate()) {
+            printf("Error: format mismatch %s. ch=%d samplerate=%d\n", p->fromPath.c_str(), p->f.numChannels, p->f.sampleRate);
+            return false;
+        }
+        if (p->cf.InitShared(mMaster) < 0) {
+            return false;
+        }
+        p->numChunks = NumChunks(p->f, p->cf.LatencyFrames());
+        WWFileSeek(p->fpIn, p->f.dataOffset, SEEK_SET);
+        return true;
+    }
+
+    /// end of pass 0: only the encode stage of the file is running and the others are waiting for the next pass
+    bool StartWritePass(BatchFile *p) {
+        if (OUTPUT_MAX_VALUE < p->peak) {
+            p->scale = OUTPUT_MAX_VALUE / p->peak;
+        }
+        p->cf.Reset();
+        WWFileSeek(p->fpIn, p->f.dataOffset, SEEK_SET);
+
+        p->fpOut = fopen(p->toPath.c_str(), "wb");
+        if (nullptr == p->fpOut || WWWavWriteHeader(p->fpOut, 2, p->f.sampleRate, OUTPUT_BITS_PER_SAMPLE, false, p->f.numFrames) < 0) {
+            printf("Error: Write failed %s\n", p->toPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void WorkerThread(void) {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        for (;;) {
+            BatchFile *p = nullptr;
+            BatchChunk *c = nullptr;
+            const BatchTaskType t = PickTask(&p, &c);
+            if (BTT_None == t) {
+                if (mActive.empty() && 0 == mNumOpening && mFromPaths.size() <= mNextFile) {
+                    break;
+                }
+                mCv.wait(lock);
+                continue;
+            }
+            ++mRoundRobin;
+
+            lock.unlock();
+
+            bool ok = true;
+            int64_t chunkIdx = 0;
+            switch (t) {
+            case BTT_Open:
+                ok = Open(p);
+                break;
+            case BTT_Decode:
+                chunkIdx = p->decoded;
+                ReadFloatFrames(p->fpIn, p->f, chunkIdx * PROCESS_FRAMES, PROCESS_FRAMES, p->inBuff, &c->in[0]);
+                break;
+            case BTT_Convolve:
+                p->cf.Process(&c->in[0], PROCESS_FRAMES, &c->out[0]);
+                break;
+            case BTT_Encode:
+                chunkIdx = p->encoded;
+                ok = EncodeFrames(&c->out[0], PROCESS_FRAMES, chunkIdx * PROCESS_FRAMES - p->cf.LatencyFrames(),
+                        p->f, p->scale, p->fpOut, p->outBuff, &p->peak);
+                if (ok && 0 == p->pass && chunkIdx + 1 == p->numChunks) {
+                    ok = StartWritePass(p);
+                }
+                break;
+            default:
+                assert(0);
+                break;
+            }
+
+            lock.lock();
+
+            switch (t) {
+            case BTT_Open:
+                --mNumOpening;
+                p->failed = !ok;
+                mActive.push_back(p);
+                break;
+            case BTT_Decode:
+                ++p->decoded;
+                p->decodedQ.push_back(c);
+                p->decodeBusy = false;
+                break;
+            case BTT_Convolve:
+                ++p->convolved;
+                p->convolvedQ.push_back(c);
+                p->convolveBusy = false;
+                break;
+            case BTT_Encode:
+                ++p->encoded;
+                p->freeQ.push_back(c);
+                p->encodeBusy = false;
+                p->failed = p->failed || !ok;
+                if (ok && 0 == p->pass && p->encoded == p->numChunks) {
+                    p->pass = 1;
+                    p->decoded = p->convolved = p->encoded = 0;
+                }
+                break;
+            default:
+                break;
+            }
+
+            RetireFiles();
+            mCv.notify_all();
+        }
+    }
+};
+
+/// crossfeeds many files on a thread pool. the coefficients are read once and the spectra are shared by all files
+static int
+RunBatch(const char *coeffPath, const char *toDir, const std::vector<std::string> &fromPaths)
+{
+    WWCrossfeed master;
+    if (master.InitFromFile(coeffPath, DEFAULT_BLOCK_FRAMES) < 0) {
+        printf("Error: could not read crossfeed param file %s\n", coeffPath);
+        return 1;
+    }
+
+    int numThreads = (int)std::thread::hardware_concurrency();
+    if (numThreads < 2) {
+        numThreads = 2;
+    }
+
+    Batch batch(master, fromPaths, toDir, numThreads);
+
+    auto t0 = std::chrono::steady_clock::now();
+    batch.Run();
+    auto t1 = std::chrono::steady_clock::now();
+
+    const double elapsed = std::chrono::duration<double>(t1 - t0).count();
+    const double audioSec = (double)batch.TotalFrames() / master.SampleRate();
+    printf("%d files succeeded, %d failed. %d threads, %.1f s of audio in %.3f s: %.1fx real-time\n",
+            batch.NumSucceeded(), batch.NumFailed(), numThreads, audioSec, elapsed, audioSec / elapsed);
+    return (0 == batch.NumFailed()) ? 0 : 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc == 3 && 0 == strcmp(argv[1], "-benchmark")) {
+        return Benchmark(argv[2]);
+    }
+    if (5 <= argc && 0 == strcmp(argv[1], "-batch")) {
+        return RunBatch(argv[2], argv[3], std::vector<std::string>(&argv[4], &argv[argc]));
+    }
+    if (argc == 3 && 0 == strcmp(argv[1], "-startupBenchmark")) {
+        return StartupBenchmark(argv[2]);
+    }
+    if ((argc == 2 || argc == 3) && 0 == strcmp(argv[1], "-convolverBenchmark")) {
+        return ConvolverBenchmark((argc == 3) ? atoi(argv[2]) : 48000);
+    }
+    if ((argc == 3 || argc == 4) && 0 == strcmp(argv[1], "-callback")) {
+        return CallbackTest(argv[2], (argc == 4) ? atoi(argv[3]) : 0);
+    }
+
+    if (argc != 4) {
+        printf("Usage:\n"
+            " %s coeffFile inputWavFile outputWavFile : applies the CFD2 crossfeed. output is 24bit WAV\n"
+            " %s -batch coeffFile outputDir inputWavFile ... : applies the crossfeed to the files on a thread pool\n"
+            " %s -benchmark coeffFile                 : prints the real-time factor of the crossfeed\n"
+            " %s -callback coeffFile [sampleRate]     : measures the worst time of the 1ms render callback\n"
+            " %s -convolverBenchmark [sampleRate]     : compares the convolvers on 1s, 4s and 10s impulse responses\n"
+            " %s -startupBenchmark coeffFile          : prints the start up time with and without the spectrum cache\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    return Run(argv[1], argv[2], argv[3]);
+}
@@ -0,0 +1,280 @@
+// 日本語 UTF-8
+
+#include "stdafx.h"
+#include "WWDsfRW.h"
+#include "WWDsfWriter.h"
+#include <Windows.h>
+#include <map>
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _DEBUG
+#  define dprintf(x, ...) printf(x, __VA_ARGS__)
+#else
+#  define dprintf(x, ...)
+#endif
+
+struct DsfEncodeInfo {
+    int           id;
+    WWDsfMetadata meta;
+    WWDsfWriter   writer;
+
+    std::vector<uint8_t> pictureData;
+
+    DsfEncodeInfo(void) {
+        id = -1;
+        memset(&meta, 0, sizeof meta);
+    }
+
+    static int nextId;
+};
+
+int DsfEncodeInfo::nextId = 0x50000000;
+
+/// 物置の実体。グローバル変数。
+static std::map<int, DsfEncodeInfo*> g_dsfEncodeInfoMap;
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static DsfEncodeInfo *
+DsfEncodeInfoNew(void)
+{
+    DsfEncodeInfo *dei = new DsfEncodeInfo();
+    if (nullptr == dei) {
+        return nullptr;
+    }
+
+    dei->id = DsfEncodeInfo::nextId;
+    g_dsfEncodeInfoMap[DsfEncodeInfo::nextId] = dei;
+    ++DsfEncodeInfo::nextId;
+
+    return dei;
+}
+
+static void
+DsfEncodeInfoDelete(DsfEncodeInfo *dei)
+{
+    if (nullptr == dei) {
+        return;
+    }
+
+    g_dsfEncodeInfoMap.erase(dei->id);
+    delete dei;
+}
+
+static DsfEncodeInfo *
+DsfEncodeInfoFindById(int id)
+{
+    std::map<int, DsfEncodeInfo*>::iterator ite = g_dsfEncodeInfoMap.find(id);
+    if (ite == g_dsfEncodeInfoMap.end()) {
+        return nullptr;
+    }
+    return ite->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// ID3v2.3チャンク。数字はビッグエンディアン。
+
+static void
+WriteBE2(uint16_t v, std::vector<uint8_t> &to)
+{
+    to.push_back((uint8_t)(v >> 8));
+    to.push_back((uint8_t)(v & 0xff));
+}
+
+static void
+WriteBE4(uint32_t v, std::vector<uint8_t> &to)
+{
+    to.push_back((uint8_t)((v >> 24) & 0xff));
+    to.push_back((uint8_t)((v >> 16) & 0xff));
+    to.push_back((uint8_t)((v >> 8) & 0xff));
+    to.push_back((uint8_t)(v & 0xff));
+}
+
+/// テキストフレーム。UTF-16 BOM付き。
+static void
+WriteNameFrame(uint32_t frameId, const wchar_t *s, std::vector<uint8_t> &to)
+{
+    const size_t len = wcsnlen(s, WWDSF_TEXT_STRSZ);
+
+    WriteBE4(frameId, to);
+    WriteBE4((uint32_t)(1 + 2 + len * 2 + 2), to);
+    WriteBE2(0, to); //< flags
+
+    to.push_back(1); //< encoding: UTF-16
+    to.push_back(0xff);
+    to.push_back(0xfe);
+    for (size_t i=0; i<len; ++i) {
+        to.push_back((uint8_t)(s[i] & 0xff));
+        to.push_back((uint8_t)((s[i] >> 8) & 0xff));
+    }
+    to.push_back(0);
+    to.push_back(0);
+}
+
+/// 画像フレーム。JPEG、表紙。
+static void
+WritePictureFrame(uint32_t frameId, const std::vector<uint8_t> &picture, std::vector<uint8_t> &to)
+{
+    static const char mimeType[] = "image/jpeg";
+    const uint32_t mimeBytes = (uint32_t)(sizeof mimeType - 1);
+
+    WriteBE4(frameId, to);
+    WriteBE4(1 + mimeBytes + 1 + 1 + 1 + (uint32_t)picture.size(), to);
+    WriteBE2(0, to); //< flags
+
+    to.push_back(0); //< encoding
+    to.insert(to.end(), mimeType, mimeType + mimeBytes);
+    to.push_back(0);
+    to.push_back(3); //< picture type: cover (front)
+    to.push_back(0); //< description
+    to.insert(to.end(), picture.begin(), picture.end());
+}
+
+/// タイトルが無いときはID3チャンクを作らない。
+static void
+CreateID3v23Chunk(const DsfEncodeInfo &dei, std::vector<uint8_t> &to)
+{
+    to.clear();
+    if (0 == dei.meta.titleStr[0]) {
+        return;
+    }
+
+    // ID3タグヘッダー10バイト。
+    to.push_back('I');
+    to.push_back('D');
+    to.push_back('3');
+    WriteBE2(0x0300, to);
+    to.push_back(0); //< flags
+    WriteBE4(0, to); //< タグサイズ。後で書く。
+
+    // "TIT2" title
+    WriteNameFrame(0x54495432, dei.meta.titleStr, to);
+
+    if (0 != dei.meta.albumStr[0]) {
+        // "TALB" album
+        WriteNameFrame(0x54414c42, dei.meta.albumStr, to);
+    } else if (0 != dei.meta.albumArtistStr[0]) {
+        WriteNameFrame(0x54414c42, dei.meta.albumArtistStr, to);
+    }
+
+    if (0 != dei.meta.artistStr[0]) {
+        // "TPE1" artist
+        WriteNameFrame(0x54504531, dei.meta.artistStr, to);
+    }
+
+    if (!dei.pictureData.empty()) {
+        // "APIC" picture
+        WritePictureFrame(0x41504943, dei.pictureData, to);
+    }
+
+    // タグサイズ(ヘッダーの10バイトを含まない)。7ビットずつ。
+    const uint32_t size = (uint32_t)(to.size() - 10);
+    to[6] = (uint8_t)((size >> 21) & 0x7f);
+    to[7] = (uint8_t)((size >> 14) & 0x7f);
+    to[8] = (uint8_t)((size >> 7) & 0x7f);
+    to[9] = (uint8_t)(size & 0x7f);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" __declspec(dllexport)
+int __stdcall
+WWDsfRW_EncodeInit(const WWDsfMetadata &meta, const wchar_t *path)
+{
+    if (nullptr == path) {
+        return DRT_BadParams;
+    }
+
+    DsfEncodeInfo *dei = DsfEncodeInfoNew();
+    if (nullptr == dei) {
+        return DRT_MemoryExhausted;
+    }
+
+    dei->meta = meta;
+
+    int rv = dei->writer.Init(path, meta.sampleRate, meta.channels, meta.pcmSampleRate, meta.modulatorOrder);
+    if (rv < 0) {
+        dprintf("%s WWDsfWriter::Init failed %d\n", __FUNCTION__, rv);
+        DsfEncodeInfoDelete(dei);
+        return rv;
+    }
+
+    return dei->id;
+}
+
+extern "C" __declspec(dllexport)
+int __stdcall
+WWDsfRW_EncodeSetPicture(int id, const uint8_t * pictureData, int pictureBytes)
+{
+    if (nullptr == pictureData || pictureBytes <= 0) {
+        dprintf("%s parameter pictureData or pictureBytes error\n", __FUNCTION__);
+        return DRT_BadParams;
+    }
+
+    DsfEncodeInfo *dei = DsfEncodeInfoFindById(id);
+    if (nullptr == dei) {
+        return DRT_IdNotFound;
+    }
+
+    dei->pictureData.assign(pictureData, pictureData + pictureBytes);
+    return DRT_Success;
+}
+
+extern "C" __declspec(dllexport)
+int __stdcall
+WWDsfRW_EncodeAddDsd(int id, const uint8_t * dsd, int64_t dsdBytesPerChannel)
+{
+    if (nullptr == dsd || dsdBytesPerChannel <= 0) {
+        dprintf("%s parameter dsd or dsdBytesPerChannel error\n", __FUNCTION__);
+        return DRT_BadParams;
+    }
+
+    DsfEncodeInfo *dei = DsfEncodeInfoFindById(id);
+    if (nullptr == dei) {
+        return DRT_IdNotFound;
+    }
+
+    return dei->writer.AddDsd(dsd, dsdBytesPerChannel);
+}
+
+extern "C" __declspec(dllexport)
+int __stdcall
+WWDsfRW_EncodeAddPcm(int id, const float * pcm, int64_t frames)
+{
+    if (nullptr == pcm || frames <= 0) {
+        dprintf("%s parameter pcm or frames error\n", __FUNCTION__);
+        return DRT_BadParams;
+    }
+
+    DsfEncodeInfo *dei = DsfEncodeInfoFindById(id);
+    if (nullptr == dei) {
+        return DRT_IdNotFound;
+    }
+
+    return dei->writer.AddPcm(pcm, frames);
+}
+
+extern "C" __declspec(dllexport)
+int __stdcall
+WWDsfRW_EncodeEnd(int id)
+{
+    DsfEncodeInfo *dei = DsfEncodeInfoFindById(id);
+    if (nullptr == dei) {
+        return DRT_IdNotFound;
+    }
+
+    std::vector<uint8_t> id3;
+    CreateID3v23Chunk(*dei, id3);
+
+    int rv = dei->writer.Finish(id3.empty() ? nullptr : &id3[0], (int)id3.size());
+    dei->writer.Term();
+
+    DsfEncodeInfoDelete(dei);
+    dei = nullptr;
+
+    return rv;
+}
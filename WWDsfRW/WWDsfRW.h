@@ -0,0 +1,92 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include <stdint.h>
+
+#ifdef WWDSFRW_EXPORTS
+#define WWDSFRW_API __declspec(dllexport)
+#else
+#define WWDSFRW_API __declspec(dllimport)
+#endif
+
+enum DsfRWResultType {
+    /// 成功。
+    DRT_Success = 0,
+
+    DRT_FileOpenError           = -1,
+    DRT_WriteError              = -2,
+    DRT_MemoryExhausted         = -3,
+    DRT_InvalidNumberOfChannels = -4,
+    DRT_InvalidSampleRate       = -5,
+    DRT_BadParams               = -6,
+    DRT_IdNotFound              = -7,
+    DRT_OtherError              = -8,
+};
+
+#define WWDSF_TEXT_STRSZ   (256)
+
+/// DSFの1チャンネル1ブロックのバイト数。
+#define WWDSF_BLOCK_BYTES  (4096)
+
+#pragma pack(push, 4)
+struct WWDsfMetadata {
+    /// DSDのサンプリング周波数。2822400 (DSD64)、5644800 (DSD128)、11289600 (DSD256)
+    int          sampleRate;
+
+    /// 1～6
+    int          channels;
+
+    /// 0: WWDsfRW_EncodeAddDsd()で1ビットデータを渡す。
+    /// 44100, 88200, 176400, 352800: WWDsfRW_EncodeAddPcm()でこのサンプリング周波数のPCMを渡す。
+    int          pcmSampleRate;
+
+    /// PCMを変調するΔΣ変調器の次数。5～7
+    int          modulatorOrder;
+
+    wchar_t titleStr[WWDSF_TEXT_STRSZ];
+    wchar_t artistStr[WWDSF_TEXT_STRSZ];
+    wchar_t albumStr[WWDSF_TEXT_STRSZ];
+    wchar_t albumArtistStr[WWDSF_TEXT_STRSZ];
+};
+#pragma pack(pop)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// dsf encode
+// EncodeInit()でファイルを作り、EncodeAddDsd()かEncodeAddPcm()を何回か呼んでデータを少しずつ書き、
+// EncodeEnd()でID3チャンクを書いてヘッダーのサイズを更新してファイルを閉じる。
+
+/// @param path パス名(UTF-16)
+/// @return 0以上: エンコーダーId。負: エラー。DsfRWResultType参照。
+extern "C" WWDSFRW_API
+int __stdcall
+WWDsfRW_EncodeInit(const WWDsfMetadata &meta, const wchar_t *path);
+
+/// カバーアート(JPEG)をID3チャンクに入れる。EncodeEnd()の前に呼ぶ。
+/// @return 0以上: 成功。負: エラー。DsfRWResultType参照。
+extern "C" WWDSFRW_API
+int __stdcall
+WWDsfRW_EncodeSetPicture(int id, const uint8_t * pictureData, int pictureBytes);
+
+/// 1ビットデータを追加する。
+/// @param dsd DSDIFFのバイト順: チャンネルごとに1バイトずつインターリーブ、MSBが時間的に古いビット。
+///            dsdBytesPerChannel * channelsバイト。
+/// @return 0以上: 成功。負: エラー。DsfRWResultType参照。
+extern "C" WWDSFRW_API
+int __stdcall
+WWDsfRW_EncodeAddDsd(int id, const uint8_t * dsd, int64_t dsdBytesPerChannel);
+
+/// PCMを追加する。チャンネルごとのワーカースレッドでΔΣ変調する。
+/// @param pcm チャンネルインターリーブのfloat。frames * channels個。
+///            1.0fがDSDの50%変調(SACDの0dB)になる。
+///            補間フィルターの遅延はDSDの先頭から取り除くので、DSDは元のPCMと時刻がそろう(1/2 PCMフレーム未満の差が残る)。
+/// @return 0以上: 成功。負: エラー。DsfRWResultType参照。
+extern "C" WWDSFRW_API
+int __stdcall
+WWDsfRW_EncodeAddPcm(int id, const float * pcm, int64_t frames);
+
+/// ファイルを完成させて閉じ、idを開放する。
+/// @return 0以上: 成功。負: エラー。DsfRWResultType参照。
+extern "C" WWDSFRW_API
+int __stdcall
+WWDsfRW_EncodeEnd(int id);
@@ -0,0 +1,555 @@
+// 日本語 UTF-8
+
+#include "stdafx.h"
+#include "WWDsfWriter.h"
+#include "WWDsfRW.h"
+#include "WWDsdModulator.h"
+#include <assert.h>
+#include <string.h>
+
+#ifdef _DEBUG
+#  define dprintf(x, ...) printf(x, __VA_ARGS__)
+#else
+#  define dprintf(x, ...)
+#endif
+
+/// DSDチャンク(28バイト) + fmtチャンク(52バイト) + dataチャンクヘッダー(12バイト)
+#define DSF_HEADER_BYTES     (28 + 52 + 12)
+
+/// 1つのバッファーのブロック数。
+#define BUFFER_BLOCKS        (16)
+#define BUFFER_BYTES_PER_CHANNEL (BUFFER_BLOCKS * WWDSF_BLOCK_BYTES)
+
+/// ワーカーが1回に変調するPCMフレーム数の上限。
+#define MODULATE_FRAMES_MAX  (4096)
+
+/// DSD無音パターン(DSDIFFのビット順)
+#define DSD_SILENCE_BYTE     (0x69)
+
+#define DSF_CHANNEL_MAX      (6)
+
+/// ビット順を逆にする表。DSDIFFはMSBが古いビット、DSFはLSBが古いビット。
+static const uint8_t gBitReverse[256] = {
+#   define R2(n)    n,     n + 2*64,     n + 1*64,     n + 3*64
+#   define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#   define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
+    R6(0), R6(2), R6(1), R6(3)
+};
+#undef R6
+#undef R4
+#undef R2
+
+struct WWDsfWriter::Worker {
+    WWDsfWriter    *self;
+    int            ch;
+    HANDLE         thread;
+    HANDLE         startEvent;
+    HANDLE         doneEvent;
+    WWDsdModulator *modulator;
+
+    std::vector<float>   pcm;
+    std::vector<uint8_t> dsd;
+
+    Worker(void) : self(nullptr), ch(0), thread(nullptr), startEvent(nullptr), doneEvent(nullptr), modulator(nullptr) { }
+};
+
+static void
+WriteLE4(uint8_t *p, uint32_t v)
+{
+    for (int i=0; i<4; ++i) {
+        p[i] = (uint8_t)(v >> (i * 8));
+    }
+}
+
+static void
+WriteLE8(uint8_t *p, uint64_t v)
+{
+    for (int i=0; i<8; ++i) {
+        p[i] = (uint8_t)(v >> (i * 8));
+    }
+}
+
+WWDsfWriter::WWDsfWriter(void)
+{
+    m_fp                  = nullptr;
+    m_dsdSampleRate       = 0;
+    m_numChannels         = 0;
+    m_pcmSampleRate       = 0;
+    m_dsdBytesPerChannel  = 0;
+    m_writtenBlocks       = 0;
+    m_buffer[0]           = nullptr;
+    m_buffer[1]           = nullptr;
+    m_fillIdx             = 0;
+    m_fillBytesPerChannel = 0;
+    m_skipBytesPerChannel = 0;
+    m_jobPcm              = nullptr;
+    m_jobFrames           = 0;
+    m_jobSkipBytes        = 0;
+    m_writerThread        = nullptr;
+    m_writeRequestEvent   = nullptr;
+    m_writeDoneEvent      = nullptr;
+    m_shutdownEvent       = nullptr;
+    m_writeData           = nullptr;
+    m_writeBytes          = 0;
+    m_writeBusy           = false;
+    m_writeResult         = DRT_Success;
+}
+
+WWDsfWriter::~WWDsfWriter(void)
+{
+    Term();
+}
+
+int
+WWDsfWriter::Init(const wchar_t *path, int dsdSampleRate, int numChannels, int pcmSampleRate, int modulatorOrder)
+{
+    assert(nullptr == m_fp);
+
+    if (numChannels < 1 || DSF_CHANNEL_MAX < numChannels) {
+        return DRT_InvalidNumberOfChannels;
+    }
+    switch (dsdSampleRate) {
+    case 2822400:
+    case 5644800:
+    case 11289600:
+    case 22579200:
+        break;
+    default:
+        return DRT_InvalidSampleRate;
+    }
+
+    m_dsdSampleRate       = dsdSampleRate;
+    m_numChannels         = numChannels;
+    m_pcmSampleRate       = pcmSampleRate;
+    m_dsdBytesPerChannel  = 0;
+    m_writtenBlocks       = 0;
+    m_fillIdx             = 0;
+    m_fillBytesPerChannel = 0;
+    m_skipBytesPerChannel = 0;
+    m_writeBusy           = false;
+    m_writeResult         = DRT_Success;
+
+    if (0 != pcmSampleRate) {
+        for (int ch=0; ch<numChannels; ++ch) {
+            Worker *w = new Worker();
+            m_workers.push_back(w);
+            w->self = this;
+            w->ch   = ch;
+            w->modulator = new WWDsdModulator();
+            if (w->modulator->Init(modulatorOrder, pcmSampleRate, dsdSampleRate, 1) < 0) {
+                dprintf("%s unsupported modulator order=%d pcm=%d dsd=%d\n", __FUNCTION__, modulatorOrder, pcmSampleRate, dsdSampleRate);
+                Term();
+                return DRT_InvalidSampleRate;
+            }
+            w->pcm.resize(MODULATE_FRAMES_MAX);
+            w->dsd.resize(MODULATE_FRAMES_MAX * w->modulator->Upsample() / 8);
+        }
+
+        // 補間フィルターの遅延分の出力を捨てて、DSDの先頭をPCMの先頭にそろえる。
+        // 遅延はPCMフレーム単位なのでバイト境界になる。
+        m_skipBytesPerChannel = m_workers[0]->modulator->DelayFrames() * m_workers[0]->modulator->Upsample() / 8;
+    }
+
+    for (int i=0; i<2; ++i) {
+        m_buffer[i] = new BYTE[(size_t)BUFFER_BYTES_PER_CHANNEL * numChannels];
+        if (nullptr == m_buffer[i]) {
+            Term();
+            return DRT_MemoryExhausted;
+        }
+    }
+
+    if (0 != _wfopen_s(&m_fp, path, L"wb") || nullptr == m_fp) {
+        m_fp = nullptr;
+        Term();
+        return DRT_FileOpenError;
+    }
+
+    // サイズは後でFinish()が書き直す。
+    if (WriteHeader(0, 0) < 0) {
+        Term();
+        return DRT_WriteError;
+    }
+
+    m_shutdownEvent     = CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    m_writeRequestEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    m_writeDoneEvent    = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+    if (nullptr == m_shutdownEvent || nullptr == m_writeRequestEvent || nullptr == m_writeDoneEvent) {
+        Term();
+        return DRT_OtherError;
+    }
+
+    m_writerThread = CreateThread(nullptr, 0, WriterEntry, this, 0, nullptr);
+    if (nullptr == m_writerThread) {
+        Term();
+        return DRT_OtherError;
+    }
+
+    for (size_t i=0; i<m_workers.size(); ++i) {
+        Worker *w = m_workers[i];
+        w->startEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+        w->doneEvent  = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+        if (nullptr == w->startEvent || nullptr == w->doneEvent) {
+            Term();
+            return DRT_OtherError;
+        }
+        w->thread = CreateThread(nullptr, 0, WorkerEntry, w, 0, nullptr);
+        if (nullptr == w->thread) {
+            Term();
+            return DRT_OtherError;
+        }
+    }
+
+    return DRT_Success;
+}
+
+void
+WWDsfWriter::Term(void)
+{
+    WaitWriteDone();
+
+    if (m_shutdownEvent) {
+        SetEvent(m_shutdownEvent);
+    }
+
+    if (m_writerThread) {
+        WaitForSingleObject(m_writerThread, INFINITE);
+        CloseHandle(m_writerThread);
+        m_writerThread = nullptr;
+    }
+
+    for (size_t i=0; i<m_workers.size(); ++i) {
+        Worker *w = m_workers[i];
+        if (w->thread) {
+            WaitForSingleObject(w->thread, INFINITE);
+            CloseHandle(w->thread);
+            w->thread = nullptr;
+        }
+        if (w->startEvent) {
+            CloseHandle(w->startEvent);
+            w->startEvent = nullptr;
+        }
+        if (w->doneEvent) {
+            CloseHandle(w->doneEvent);
+            w->doneEvent = nullptr;
+        }
+        delete w->modulator;
+        w->modulator = nullptr;
+        delete w;
+    }
+    m_workers.clear();
+
+    if (m_writeRequestEvent) {
+        CloseHandle(m_writeRequestEvent);
+        m_writeRequestEvent = nullptr;
+    }
+    if (m_writeDoneEvent) {
+        CloseHandle(m_writeDoneEvent);
+        m_writeDoneEvent = nullptr;
+    }
+    if (m_shutdownEvent) {
+        CloseHandle(m_shutdownEvent);
+        m_shutdownEvent = nullptr;
+    }
+
+    for (int i=0; i<2; ++i) {
+        delete [] m_buffer[i];
+        m_buffer[i] = nullptr;
+    }
+
+    if (m_fp) {
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+}
+
+int
+WWDsfWriter::WriteHeader(uint64_t totalFileBytes, uint64_t metadataOffset)
+{
+    // channelType 1:mono 2:stereo 3:3ch 4:quad 6:5ch 7:5.1ch
+    static const uint32_t channelTypeOfNum[] = { 0, 1, 2, 3, 4, 6, 7 };
+    const uint64_t dataBytes = (uint64_t)m_writtenBlocks * WWDSF_BLOCK_BYTES * m_numChannels;
+    uint8_t h[DSF_HEADER_BYTES];
+    memset(h, 0, sizeof h);
+
+    // DSD chunk
+    memcpy(&h[0], "DSD ", 4);
+    WriteLE8(&h[4],  28);
+    WriteLE8(&h[12], totalFileBytes);
+    WriteLE8(&h[20], metadataOffset);
+
+    // fmt chunk
+    memcpy(&h[28], "fmt ", 4);
+    WriteLE8(&h[32], 52);
+    WriteLE4(&h[40], 1); //< format version
+    WriteLE4(&h[44], 0); //< format id: DSD raw
+    WriteLE4(&h[48], channelTypeOfNum[m_numChannels]);
+    WriteLE4(&h[52], m_numChannels);
+    WriteLE4(&h[56], m_dsdSampleRate);
+    WriteLE4(&h[60], 1); //< bits per sample: LSB first
+    WriteLE8(&h[64], (uint64_t)m_dsdBytesPerChannel * 8);
+    WriteLE4(&h[72], WWDSF_BLOCK_BYTES);
+    WriteLE4(&h[76], 0);
+
+    // data chunk header. chunk size includes the header
+    memcpy(&h[80], "data", 4);
+    WriteLE8(&h[84], 12 + dataBytes);
+
+    if (fwrite(h, 1, sizeof h, m_fp) != sizeof h) {
+        return DRT_WriteError;
+    }
+    return DRT_Success;
+}
+
+void
+WWDsfWriter::StoreBytes(int ch, const uint8_t *dsd, int stride, int bytes)
+{
+    BYTE *buff = m_buffer[m_fillIdx];
+
+    for (int i=0; i<bytes; ++i) {
+        const int k = m_fillBytesPerChannel + i;
+        const int block = k / WWDSF_BLOCK_BYTES;
+        const int offs  = k % WWDSF_BLOCK_BYTES;
+        buff[(block * m_numChannels + ch) * WWDSF_BLOCK_BYTES + offs] = gBitReverse[dsd[i * stride]];
+    }
+}
+
+int
+WWDsfWriter::AddDsd(const uint8_t *dsd, int64_t dsdBytesPerChannel)
+{
+    int64_t pos = 0;
+
+    while (pos < dsdBytesPerChannel) {
+        int n = BUFFER_BYTES_PER_CHANNEL - m_fillBytesPerChannel;
+        if (dsdBytesPerChannel - pos < n) {
+            n = (int)(dsdBytesPerChannel - pos);
+        }
+
+        for (int ch=0; ch<m_numChannels; ++ch) {
+            StoreBytes(ch, &dsd[pos * m_numChannels + ch], m_numChannels, n);
+        }
+
+        m_fillBytesPerChannel += n;
+        m_dsdBytesPerChannel  += n;
+        pos += n;
+
+        if (m_fillBytesPerChannel == BUFFER_BYTES_PER_CHANNEL) {
+            int rv = Flush(false);
+            if (rv < 0) {
+                return rv;
+            }
+        }
+    }
+
+    return DRT_Success;
+}
+
+int
+WWDsfWriter::AddPcm(const float *pcm, int64_t frames)
+{
+    if (m_workers.empty()) {
+        dprintf("%s PCM sample rate is not specified\n", __FUNCTION__);
+        return DRT_BadParams;
+    }
+
+    const int bytesPerFrame = m_dsdSampleRate / m_pcmSampleRate / 8;
+    HANDLE doneEvents[DSF_CHANNEL_MAX];
+    for (int ch=0; ch<m_numChannels; ++ch) {
+        doneEvents[ch] = m_workers[ch]->doneEvent;
+    }
+
+    int64_t pos = 0;
+    while (pos < frames) {
+        int n = (BUFFER_BYTES_PER_CHANNEL - m_fillBytesPerChannel) / bytesPerFrame;
+        if (MODULATE_FRAMES_MAX < n) {
+            n = MODULATE_FRAMES_MAX;
+        }
+        if (frames - pos < n) {
+            n = (int)(frames - pos);
+        }
+
+        // 書き込みスレッドがもう片方のバッファーを書いている間に変調する。
+        m_jobPcm       = &pcm[pos * m_numChannels];
+        m_jobFrames    = n;
+        m_jobSkipBytes = (m_skipBytesPerChannel < n * bytesPerFrame) ? m_skipBytesPerChannel : n * bytesPerFrame;
+        for (int ch=0; ch<m_numChannels; ++ch) {
+            SetEvent(m_workers[ch]->startEvent);
+        }
+        WaitForMultipleObjects(m_numChannels, doneEvents, TRUE, INFINITE);
+
+        m_fillBytesPerChannel += n * bytesPerFrame - m_jobSkipBytes;
+        m_dsdBytesPerChannel  += n * bytesPerFrame - m_jobSkipBytes;
+        m_skipBytesPerChannel -= m_jobSkipBytes;
+        pos += n;
+
+        if (m_fillBytesPerChannel == BUFFER_BYTES_PER_CHANNEL) {
+            int rv = Flush(false);
+            if (rv < 0) {
+                return rv;
+            }
+        }
+    }
+
+    return DRT_Success;
+}
+
+int
+WWDsfWriter::WaitWriteDone(void)
+{
+    if (!m_writeBusy) {
+        return m_writeResult;
+    }
+
+    WaitForSingleObject(m_writeDoneEvent, INFINITE);
+    m_writeBusy = false;
+    return m_writeResult;
+}
+
+int
+WWDsfWriter::Flush(bool final)
+{
+    if (final) {
+        // 最後のブロックの残りを無音で埋める。
+        const int padBytes = (WWDSF_BLOCK_BYTES - m_fillBytesPerChannel % WWDSF_BLOCK_BYTES) % WWDSF_BLOCK_BYTES;
+        if (0 < padBytes) {
+            std::vector<uint8_t> silence(padBytes, DSD_SILENCE_BYTE);
+            for (int ch=0; ch<m_numChannels; ++ch) {
+                StoreBytes(ch, &silence[0], 1, padBytes);
+            }
+            m_fillBytesPerChannel += padBytes;
+        }
+    }
+
+    assert((m_fillBytesPerChannel % WWDSF_BLOCK_BYTES) == 0);
+    const int blocks = m_fillBytesPerChannel / WWDSF_BLOCK_BYTES;
+    if (0 == blocks) {
+        return DRT_Success;
+    }
+
+    int rv = WaitWriteDone();
+    if (rv < 0) {
+        return rv;
+    }
+
+    m_writeData  = m_buffer[m_fillIdx];
+    m_writeBytes = (size_t)blocks * WWDSF_BLOCK_BYTES * m_numChannels;
+    m_writeBusy  = true;
+    SetEvent(m_writeRequestEvent);
+
+    m_writtenBlocks      += blocks;
+    m_fillIdx             = 1 - m_fillIdx;
+    m_fillBytesPerChannel = 0;
+    return DRT_Success;
+}
+
+int
+WWDsfWriter::Finish(const uint8_t *id3Chunk, int id3Bytes)
+{
+    int rv = DRT_Success;
+
+    if (!m_workers.empty()) {
+        // 補間フィルターの遅延分の無音を入れて、PCMの最後まで変調器から出す。
+        // 先頭で同じ長さを捨てているので、DSDの長さはPCMと同じになる。
+        const int delayFrames = m_workers[0]->modulator->DelayFrames();
+        if (0 < delayFrames) {
+            std::vector<float> silence((size_t)delayFrames * m_numChannels, 0.0f);
+            rv = AddPcm(&silence[0], delayFrames);
+            if (rv < 0) {
+                return rv;
+            }
+        }
+    }
+
+    rv = Flush(true);
+    if (rv < 0) {
+        return rv;
+    }
+    rv = WaitWriteDone();
+    if (rv < 0) {
+        return rv;
+    }
+
+    const uint64_t dataBytes = (uint64_t)m_writtenBlocks * WWDSF_BLOCK_BYTES * m_numChannels;
+    uint64_t metadataOffset = 0;
+    if (0 < id3Bytes) {
+        metadataOffset = DSF_HEADER_BYTES + dataBytes;
+        if (fwrite(id3Chunk, 1, id3Bytes, m_fp) != (size_t)id3Bytes) {
+            return DRT_WriteError;
+        }
+    }
+
+    // ヘッダーのサイズを書き直す。
+    if (0 != fseek(m_fp, 0, SEEK_SET)) {
+        return DRT_WriteError;
+    }
+    rv = WriteHeader(DSF_HEADER_BYTES + dataBytes + id3Bytes, metadataOffset);
+    if (rv < 0) {
+        return rv;
+    }
+
+    if (0 != fclose(m_fp)) {
+        m_fp = nullptr;
+        return DRT_WriteError;
+    }
+    m_fp = nullptr;
+    return DRT_Success;
+}
+
+DWORD WINAPI
+WWDsfWriter::WriterEntry(LPVOID lpThreadParameter)
+{
+    WWDsfWriter *self = (WWDsfWriter*)lpThreadParameter;
+    return self->WriterMain();
+}
+
+DWORD
+WWDsfWriter::WriterMain(void)
+{
+    HANDLE waitAry[2] = { m_shutdownEvent, m_writeRequestEvent };
+
+    for (;;) {
+        DWORD waitRv = WaitForMultipleObjects(2, waitAry, FALSE, INFINITE);
+        if (waitRv != WAIT_OBJECT_0 + 1) {
+            break;
+        }
+
+        if (fwrite(m_writeData, 1, m_writeBytes, m_fp) != m_writeBytes) {
+            dprintf("%s fwrite failed\n", __FUNCTION__);
+            m_writeResult = DRT_WriteError;
+        }
+        SetEvent(m_writeDoneEvent);
+    }
+
+    return 0;
+}
+
+DWORD WINAPI
+WWDsfWriter::WorkerEntry(LPVOID lpThreadParameter)
+{
+    Worker *w = (Worker*)lpThreadParameter;
+    return w->self->WorkerMain(w);
+}
+
+DWORD
+WWDsfWriter::WorkerMain(Worker *w)
+{
+    HANDLE waitAry[2] = { m_shutdownEvent, w->startEvent };
+
+    for (;;) {
+        DWORD waitRv = WaitForMultipleObjects(2, waitAry, FALSE, INFINITE);
+        if (waitRv != WAIT_OBJECT_0 + 1) {
+            break;
+        }
+
+        const int n = m_jobFrames;
+        for (int i=0; i<n; ++i) {
+            w->pcm[i] = m_jobPcm[i * m_numChannels + w->ch];
+        }
+
+        const int bytes = w->modulator->Process(&w->pcm[0], n, &w->dsd[0]);
+        StoreBytes(w->ch, &w->dsd[0] + m_jobSkipBytes, 1, bytes - m_jobSkipBytes);
+
+        SetEvent(w->doneEvent);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include <Windows.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+class WWDsdModulator;
+
+/// DSFファイルを少しずつ書く。
+/// データは4096バイト×チャンネル数のブロック単位でバッファーにため、
+/// 書き込みスレッドが片方のバッファーをファイルに書いている間にもう片方のバッファーを埋める(ダブルバッファー)。
+/// PCMはチャンネルごとのワーカースレッドでΔΣ変調する。
+/// ヘッダーのサイズ情報は最後にFinish()で書き直す。
+class WWDsfWriter {
+public:
+    WWDsfWriter(void);
+    ~WWDsfWriter(void);
+
+    /// ファイルを作り、仮のヘッダーを書く。
+    /// @param pcmSampleRate 0: AddDsd()だけ使う。それ以外: AddPcm()で渡すPCMのサンプリング周波数
+    /// @return 0以上: 成功。負: エラー。DsfRWResultType参照。
+    int Init(const wchar_t *path, int dsdSampleRate, int numChannels, int pcmSampleRate, int modulatorOrder);
+
+    /// @param dsd DSDIFFのバイト順。dsdBytesPerChannel * numChannelsバイト
+    int AddDsd(const uint8_t *dsd, int64_t dsdBytesPerChannel);
+
+    /// @param pcm チャンネルインターリーブのfloat。frames * numChannels個
+    ///            変調器の補間フィルターの遅延分を出力の先頭から捨てるので、DSDの先頭はPCMの先頭にそろう。
+    int AddPcm(const float *pcm, int64_t frames);
+
+    /// 残りのデータと、あればID3チャンクを書き、ヘッダーを更新してファイルを閉じる。
+    int Finish(const uint8_t *id3Chunk, int id3Bytes);
+
+    /// スレッドを止めて全てを開放する。Finish()を呼ばずに呼ぶと書きかけのファイルが残る。
+    void Term(void);
+
+private:
+    struct Worker;
+
+    FILE    *m_fp;
+    int     m_dsdSampleRate;
+    int     m_numChannels;
+    int     m_pcmSampleRate;
+
+    /// 書いたDSDデータのバイト数(1チャンネル分、パディングを含まない)
+    int64_t m_dsdBytesPerChannel;
+
+    /// ファイルに書いたブロック数(1ブロック = 4096バイト×チャンネル数)
+    int64_t m_writtenBlocks;
+
+    /// ダブルバッファー。DSFのデータチャンクと同じ並び。
+    BYTE    *m_buffer[2];
+    int     m_fillIdx;
+
+    /// 埋めているバッファーのチャンネルあたりのバイト数。
+    int     m_fillBytesPerChannel;
+
+    std::vector<Worker*> m_workers;
+
+    /// 変調器の出力の先頭から捨てる残りのバイト数(1チャンネル分)。補間フィルターの遅延。
+    int     m_skipBytesPerChannel;
+
+    /// ワーカーに渡すPCMと、変調したDSDの先頭から捨てるバイト数
+    const float *m_jobPcm;
+    int          m_jobFrames;
+    int          m_jobSkipBytes;
+
+    HANDLE  m_writerThread;
+    HANDLE  m_writeRequestEvent;
+    HANDLE  m_writeDoneEvent;
+    HANDLE  m_shutdownEvent;
+
+    /// 書き込みスレッドに渡したバッファー
+    const BYTE *m_writeData;
+    size_t      m_writeBytes;
+    bool        m_writeBusy;
+    int         m_writeResult;
+
+    int  WriteHeader(uint64_t totalFileBytes, uint64_t metadataOffset);
+
+    /// 埋めたバッファーを書き込みスレッドに渡す。
+    /// @param final trueのとき、最後のブロックの残りを無音で埋める。
+    int  Flush(bool final);
+
+    /// 書き込みスレッドの書き込み完了を待つ。
+    int  WaitWriteDone(void);
+
+    /// チャンネルchのDSDバイト列(DSDIFFのビット順)をバッファーのDSFの位置に置く。
+    void StoreBytes(int ch, const uint8_t *dsd, int stride, int bytes);
+
+    static DWORD WINAPI WriterEntry(LPVOID lpThreadParameter);
+    DWORD WriterMain(void);
+
+    static DWORD WINAPI WorkerEntry(LPVOID lpThreadParameter);
+    DWORD WorkerMain(Worker *w);
+};
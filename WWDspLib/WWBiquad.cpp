@@ -0,0 +1,413 @@
+#include "WWBiquad.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_BIQUAD_USE_SSE
+#endif
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+/// frames processed at once. the work area is this number of frames
+#define WORK_FRAMES (256)
+
+/// SIMD width in doubles
+#define CH_ALIGN (2)
+
+/// MXCSR flush to zero and denormals are zero
+#define MXCSR_FTZ_DAZ (0x8040)
+
+int
+WWBiquadDesign(WWBiquadType type, double sampleRate, double freq, double gainDb, double q,
+        WWBiquadCoeffs &c_return)
+{
+    if (freq <= 0 || sampleRate / 2 <= freq || q <= 0) {
+        return -1;
+    }
+
+    const double A     = pow(10.0, gainDb / 40.0);
+    const double w0    = 2.0 * M_PI * freq / sampleRate;
+    const double cosw0 = cos(w0);
+    const double alpha = sin(w0) / (2.0 * q);
+    const double sqA2a = 2.0 * sqrt(A) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (type) {
+    case WWBT_Peaking:
+        b0 = 1.0 + alpha * A;
+        b1 = -2.0 * cosw0;
+        b2 = 1.0 - alpha * A;
+        a0 = 1.0 + alpha / A;
+        a1 = -2.0 * cosw0;
+        a2 = 1.0 - alpha / A;
+        break;
+    case WWBT_LowShelf:
+        b0 =        A * ((A + 1) - (A - 1) * cosw0 + sqA2a);
+        b1 =  2.0 * A * ((A - 1) - (A + 1) * cosw0);
+        b2 =        A * ((A + 1) - (A - 1) * cosw0 - sqA2a);
+        a0 =             (A + 1) + (A - 1) * cosw0 + sqA2a;
+        a1 = -2.0 *     ((A - 1) + (A + 1) * cosw0);
+        a2 =             (A + 1) + (A - 1) * cosw0 - sqA2a;
+        break;
+    case WWBT_HighShelf:
+        b0 =        A * ((A + 1) + (A - 1) * cosw0 + sqA2a);
+        b1 = -2.0 * A * ((A - 1) + (A + 1) * cosw0);
+        b2 =        A * ((A + 1) + (A - 1) * cosw0 - sqA2a);
+        a0 =             (A + 1) - (A - 1) * cosw0 + sqA2a;
+        a1 =  2.0 *     ((A - 1) - (A + 1) * cosw0);
+        a2 =             (A + 1) - (A - 1) * cosw0 - sqA2a;
+        break;
+    case WWBT_LowPass:
+        b0 = (1.0 - cosw0) / 2;
+        b1 =  1.0 - cosw0;
+        b2 = (1.0 - cosw0) / 2;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosw0;
+        a2 = 1.0 - alpha;
+        break;
+    case WWBT_HighPass:
+        b0 =  (1.0 + cosw0) / 2;
+        b1 = -(1.0 + cosw0);
+        b2 =  (1.0 + cosw0) / 2;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosw0;
+        a2 = 1.0 - alpha;
+        break;
+    default:
+        return -1;
+    }
+
+    c_return.b0 = b0 / a0;
+    c_return.b1 = b1 / a0;
+    c_return.b2 = b2 / a0;
+    c_return.a1 = a1 / a0;
+    c_return.a2 = a2 / a0;
+    return 0;
+}
+
+/// runs the stages of the bank on the work area in place.
+/// the recursion of a biquad is bound by the latency of the arithmetic, so 2 channel pairs are computed
+/// in the same loop to have independent dependency chains
+static void
+RunStages(const double *coeffs, double *state, int numStages, int chStride, double *work, int frames)
+{
+    for (int s=0; s<numStages; ++s) {
+        const double *c = &coeffs[(size_t)s * 5 * chStride];
+        double       *z = &state[(size_t)s * 2 * chStride];
+
+        int ch = 0;
+#ifdef WW_BIQUAD_USE_SSE
+        for (; ch + 2 * CH_ALIGN <= chStride; ch += 2 * CH_ALIGN) {
+            const int d = ch + CH_ALIGN;
+            const __m128d b0 = _mm_loadu_pd(&c[0 * chStride + ch]), b0d = _mm_loadu_pd(&c[0 * chStride + d]);
+            const __m128d b1 = _mm_loadu_pd(&c[1 * chStride + ch]), b1d = _mm_loadu_pd(&c[1 * chStride + d]);
+            const __m128d b2 = _mm_loadu_pd(&c[2 * chStride + ch]), b2d = _mm_loadu_pd(&c[2 * chStride + d]);
+            const __m128d a1 = _mm_loadu_pd(&c[3 * chStride + ch]), a1d = _mm_loadu_pd(&c[3 * chStride + d]);
+            const __m128d a2 = _mm_loadu_pd(&c[4 * chStride + ch]), a2d = _mm_loadu_pd(&c[4 * chStride + d]);
+            __m128d z1 = _mm_loadu_pd(&z[0 * chStride + ch]), z1d = _mm_loadu_pd(&z[0 * chStride + d]);
+            __m128d z2 = _mm_loadu_pd(&z[1 * chStride + ch]), z2d = _mm_loadu_pd(&z[1 * chStride + d]);
+
+            for (int i=0; i<frames; ++i) {
+                double *p = &work[(size_t)i * chStride + ch];
+                const __m128d x  = _mm_loadu_pd(p);
+                const __m128d xd = _mm_loadu_pd(p + CH_ALIGN);
+                const __m128d y  = _mm_add_pd(_mm_mul_pd(b0,  x),  z1);
+                const __m128d yd = _mm_add_pd(_mm_mul_pd(b0d, xd), z1d);
+                z1  = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1,  x),  _mm_mul_pd(a1,  y)),  z2);
+                z1d = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1d, xd), _mm_mul_pd(a1d, yd)), z2d);
+                z2  = _mm_sub_pd(_mm_mul_pd(b2,  x),  _mm_mul_pd(a2,  y));
+                z2d = _mm_sub_pd(_mm_mul_pd(b2d, xd), _mm_mul_pd(a2d, yd));
+                _mm_storeu_pd(p, y);
+                _mm_storeu_pd(p + CH_ALIGN, yd);
+            }
+
+            _mm_storeu_pd(&z[0 * chStride + ch], z1);
+            _mm_storeu_pd(&z[1 * chStride + ch], z2);
+            _mm_storeu_pd(&z[0 * chStride + d], z1d);
+            _mm_storeu_pd(&z[1 * chStride + d], z2d);
+        }
+        for (; ch<chStride; ch += CH_ALIGN) {
+            const __m128d b0 = _mm_loadu_pd(&c[0 * chStride + ch]);
+            const __m128d b1 = _mm_loadu_pd(&c[1 * chStride + ch]);
+            const __m128d b2 = _mm_loadu_pd(&c[2 * chStride + ch]);
+            const __m128d a1 = _mm_loadu_pd(&c[3 * chStride + ch]);
+            const __m128d a2 = _mm_loadu_pd(&c[4 * chStride + ch]);
+            __m128d z1 = _mm_loadu_pd(&z[0 * chStride + ch]);
+            __m128d z2 = _mm_loadu_pd(&z[1 * chStride + ch]);
+
+            for (int i=0; i<frames; ++i) {
+                double *p = &work[(size_t)i * chStride + ch];
+                const __m128d x = _mm_loadu_pd(p);
+                const __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), z1);
+                z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), z2);
+                z2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+                _mm_storeu_pd(p, y);
+            }
+
+            _mm_storeu_pd(&z[0 * chStride + ch], z1);
+            _mm_storeu_pd(&z[1 * chStride + ch], z2);
+        }
+#else
+        for (; ch<chStride; ++ch) {
+            const double b0 = c[0 * chStride + ch];
+            const double b1 = c[1 * chStride + ch];
+            const double b2 = c[2 * chStride + ch];
+            const double a1 = c[3 * chStride + ch];
+            const double a2 = c[4 * chStride + ch];
+            double z1 = z[0 * chStride + ch];
+            double z2 = z[1 * chStride + ch];
+
+            for (int i=0; i<frames; ++i) {
+                double *p = &work[(size_t)i * chStride + ch];
+                const double x = *p;
+                const double y = b0 * x + z1;
+                z1 = b1 * x - a1 * y + z2;
+                z2 = b2 * x - a2 * y;
+                *p = y;
+            }
+
+            z[0 * chStride + ch] = z1;
+            z[1 * chStride + ch] = z2;
+        }
+#endif
+    }
+}
+
+WWBiquadCascade::WWBiquadCascade(void)
+    : m_numChannels(0), m_chStride(0), m_maxStages(0), m_cur(0),
+      m_hasPending(false), m_pendingRampFrames(0), m_started(false),
+      m_ramping(false), m_rampFrames(0), m_rampPos(0)
+{
+}
+
+WWBiquadCascade::~WWBiquadCascade(void)
+{
+    Term();
+}
+
+void
+WWBiquadCascade::InitBank(Bank &b)
+{
+    b.numStages = 0;
+    b.coeffs.assign((size_t)m_maxStages * 5 * m_chStride, 0.0);
+    b.state.assign((size_t)m_maxStages * 2 * m_chStride, 0.0);
+
+    // b0 = 1: pass through
+    for (int s=0; s<m_maxStages; ++s) {
+        std::fill(&b.coeffs[(size_t)s * 5 * m_chStride], &b.coeffs[(size_t)s * 5 * m_chStride + m_chStride], 1.0);
+    }
+}
+
+int
+WWBiquadCascade::Init(int numChannels, int maxStages)
+{
+    Term();
+
+    if (numChannels < 1 || maxStages < 1 || WW_BIQUAD_MAX_STAGES < maxStages) {
+        return -1;
+    }
+
+    m_numChannels = numChannels;
+    m_chStride    = (numChannels + CH_ALIGN - 1) / CH_ALIGN * CH_ALIGN;
+    m_maxStages   = maxStages;
+
+    InitBank(m_bank[0]);
+    InitBank(m_bank[1]);
+    InitBank(m_edit);
+    InitBank(m_pending);
+    m_cur = 0;
+
+    m_work[0].assign((size_t)WORK_FRAMES * m_chStride, 0.0);
+    m_work[1].assign((size_t)WORK_FRAMES * m_chStride, 0.0);
+
+    Reset();
+    return 0;
+}
+
+void
+WWBiquadCascade::Term(void)
+{
+    for (int i=0; i<2; ++i) {
+        m_bank[i].coeffs.clear();
+        m_bank[i].state.clear();
+        m_bank[i].numStages = 0;
+        m_work[i].clear();
+    }
+    m_edit.coeffs.clear();
+    m_edit.state.clear();
+    m_pending.coeffs.clear();
+    m_pending.state.clear();
+
+    m_numChannels = 0;
+    m_chStride    = 0;
+    m_maxStages   = 0;
+    m_cur         = 0;
+    m_hasPending  = false;
+    m_ramping     = false;
+}
+
+void
+WWBiquadCascade::Reset(void)
+{
+    if (m_ramping) {
+        // the crossfade target becomes active at once
+        m_cur = 1 - m_cur;
+        m_ramping = false;
+    }
+    std::fill(m_bank[0].state.begin(), m_bank[0].state.end(), 0.0);
+    std::fill(m_bank[1].state.begin(), m_bank[1].state.end(), 0.0);
+    m_started = false;
+
+    if (m_hasPending) {
+        StartPending();
+    }
+}
+
+void
+WWBiquadCascade::ClearCoeffs(void)
+{
+    InitBank(m_edit);
+}
+
+void
+WWBiquadCascade::SetCoeffs(int stage, int ch, const WWBiquadCoeffs &c)
+{
+    assert(0 <= stage && stage < m_maxStages);
+    assert(0 <= ch && ch < m_numChannels);
+
+    double *p = &m_edit.coeffs[(size_t)stage * 5 * m_chStride + ch];
+    p[0 * m_chStride] = c.b0;
+    p[1 * m_chStride] = c.b1;
+    p[2 * m_chStride] = c.b2;
+    p[3 * m_chStride] = c.a1;
+    p[4 * m_chStride] = c.a2;
+
+    m_edit.numStages = std::max(m_edit.numStages, stage + 1);
+}
+
+void
+WWBiquadCascade::Commit(int rampFrames)
+{
+    // the vectors are of the same size: no allocation
+    std::copy(m_edit.coeffs.begin(), m_edit.coeffs.end(), m_pending.coeffs.begin());
+    m_pending.numStages = m_edit.numStages;
+    m_pendingRampFrames = rampFrames;
+    m_hasPending = true;
+
+    if (!m_started && !m_ramping) {
+        StartPending();
+    }
+}
+
+/// the pending coefficients go to the crossfade target, or to the active bank when not started
+void
+WWBiquadCascade::StartPending(void)
+{
+    assert(m_hasPending && !m_ramping);
+
+    m_hasPending = false;
+
+    if (!m_started || m_pendingRampFrames <= 0) {
+        Bank &b = m_bank[m_cur];
+        std::copy(m_pending.coeffs.begin(), m_pending.coeffs.end(), b.coeffs.begin());
+        b.numStages = m_pending.numStages;
+        return;
+    }
+
+    // the new cascade starts from the state of the current cascade. the stages added are cleared
+    const Bank &from = m_bank[m_cur];
+    Bank &to = m_bank[1 - m_cur];
+    std::copy(m_pending.coeffs.begin(), m_pending.coeffs.end(), to.coeffs.begin());
+    to.numStages = m_pending.numStages;
+    std::copy(from.state.begin(), from.state.end(), to.state.begin());
+    std::fill(to.state.begin() + (size_t)from.numStages * 2 * m_chStride, to.state.end(), 0.0);
+
+    m_ramping    = true;
+    m_rampFrames = m_pendingRampFrames;
+    m_rampPos    = 0;
+}
+
+void
+WWBiquadCascade::Process(float *io, int frames)
+{
+    if (0 == m_numChannels) {
+        return;
+    }
+
+#ifdef WW_BIQUAD_USE_SSE
+    const unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | MXCSR_FTZ_DAZ);
+#endif
+
+    m_started = true;
+
+    const int C = m_numChannels;
+    const int S = m_chStride;
+
+    int pos = 0;
+    while (pos < frames) {
+        if (!m_ramping && m_hasPending) {
+            StartPending();
+        }
+
+        int n = std::min(frames - pos, WORK_FRAMES);
+        if (m_ramping) {
+            // the crossfade ends on the chunk boundary
+            n = std::min(n, m_rampFrames - m_rampPos);
+        }
+
+        float  *x = &io[(size_t)pos * C];
+        double *w = &m_work[0][0];
+        for (int i=0; i<n; ++i) {
+            for (int ch=0; ch<C; ++ch) {
+                w[(size_t)i * S + ch] = x[(size_t)i * C + ch];
+            }
+        }
+
+        Bank &cur = m_bank[m_cur];
+
+        if (!m_ramping) {
+            RunStages(&cur.coeffs[0], &cur.state[0], cur.numStages, S, w, n);
+
+            for (int i=0; i<n; ++i) {
+                for (int ch=0; ch<C; ++ch) {
+                    x[(size_t)i * C + ch] = (float)w[(size_t)i * S + ch];
+                }
+            }
+        } else {
+            Bank &next = m_bank[1 - m_cur];
+            double *w1 = &m_work[1][0];
+            std::copy(w, w + (size_t)n * S, w1);
+
+            RunStages(&cur.coeffs[0],  &cur.state[0],  cur.numStages,  S, w,  n);
+            RunStages(&next.coeffs[0], &next.state[0], next.numStages, S, w1, n);
+
+            const double step = 1.0 / m_rampFrames;
+            for (int i=0; i<n; ++i) {
+                const double g = (m_rampPos + i + 1) * step;
+                for (int ch=0; ch<C; ++ch) {
+                    const double y0 = w[(size_t)i * S + ch];
+                    const double y1 = w1[(size_t)i * S + ch];
+                    x[(size_t)i * C + ch] = (float)(y0 + g * (y1 - y0));
+                }
+            }
+
+            m_rampPos += n;
+            if (m_rampFrames <= m_rampPos) {
+                m_cur = 1 - m_cur;
+                m_ramping = false;
+            }
+        }
+
+        pos += n;
+    }
+
+#ifdef WW_BIQUAD_USE_SSE
+    _mm_setcsr(csr);
+#endif
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+/// the largest number of biquads per channel of WWBiquadCascade
+#define WW_BIQUAD_MAX_STAGES (32)
+
+enum WWBiquadType {
+    WWBT_Peaking,
+    WWBT_LowShelf,
+    WWBT_HighShelf,
+    WWBT_LowPass,
+    WWBT_HighPass,
+
+    WWBT_NUM
+};
+
+/// H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)
+struct WWBiquadCoeffs {
+    double b0;
+    double b1;
+    double b2;
+    double a1;
+    double a2;
+
+    WWBiquadCoeffs(void) : b0(1.0), b1(0.0), b2(0.0), a1(0.0), a2(0.0) { }
+};
+
+/// designs the biquad of the Audio EQ Cookbook (R. Bristow-Johnson).
+/// @param gainDb used by the peaking and the shelving filters
+/// @param q      Q of the filter. for the shelving filters, the shelf slope is given by Q too
+/// @return 0: success. negative: freq is not in (0, sampleRate/2) or q is not positive
+int WWBiquadDesign(WWBiquadType type, double sampleRate, double freq, double gainDb, double q,
+        WWBiquadCoeffs &c_return);
+
+/// Multichannel cascade of biquads for the real-time playback.
+///
+///   Computed in double precision on the transposed direct form II.
+///   The state and the coefficients are stored channel by channel (structure of arrays),
+///   so a biquad is computed on 2 channels at once by SSE2. Denormals are flushed to zero during Process().
+///
+///   The coefficients are edited by SetCoeffs() and take effect by Commit(). While playing,
+///   the new cascade starts from the state of the old cascade and the outputs of the two are crossfaded,
+///   so the coefficients can be changed without a click.
+///
+/// Not thread safe: call SetCoeffs() and Commit() on the thread of Process() or under the same lock.
+class WWBiquadCascade {
+public:
+    WWBiquadCascade(void);
+    ~WWBiquadCascade(void);
+
+    /// all stages are pass through.
+    /// @return 0: success. negative: bad parameter
+    int Init(int numChannels, int maxStages);
+    void Term(void);
+
+    /// clears the signal history. the next Commit() takes effect immediately
+    void Reset(void);
+
+    int NumChannels(void) const { return m_numChannels; }
+
+    /// @return number of stages of the active cascade
+    int NumStages(void) const { return m_bank[m_cur].numStages; }
+
+    /// sets all stages of the edited coefficients to pass through. 0 stages
+    void ClearCoeffs(void);
+
+    /// sets the biquad of the stage of the channel of the edited coefficients.
+    /// the number of stages becomes stage+1 or more. the other channels of the stage are pass through unless set
+    void SetCoeffs(int stage, int ch, const WWBiquadCoeffs &c);
+
+    /// the edited coefficients take effect.
+    /// before the first Process() after Init() or Reset(), it takes effect immediately.
+    /// otherwise the output is crossfaded from the current coefficients to the new ones over rampFrames frames
+    /// from the next Process(). when a crossfade is in progress, the new one starts after it finishes.
+    void Commit(int rampFrames);
+
+    /// @param io channel interleaved. frames * NumChannels() floats. processed in place
+    void Process(float *io, int frames);
+
+private:
+    struct Bank {
+        int numStages;
+
+        /// [stage][b0 b1 b2 a1 a2][channel]
+        std::vector<double> coeffs;
+
+        /// [stage][z1 z2][channel]
+        std::vector<double> state;
+    };
+
+    int m_numChannels;
+
+    /// channels are padded to a multiple of the SIMD width
+    int m_chStride;
+    int m_maxStages;
+
+    /// m_bank[m_cur] is active. the other is the crossfade target
+    Bank m_bank[2];
+    int m_cur;
+
+    /// coefficients edited by SetCoeffs()
+    Bank m_edit;
+
+    /// committed and waiting for the crossfade
+    Bank m_pending;
+    bool m_hasPending;
+    int m_pendingRampFrames;
+
+    /// Process() is called after Init() or Reset()
+    bool m_started;
+
+    bool m_ramping;
+    int m_rampFrames;
+    int m_rampPos;
+
+    /// [frame][channel]
+    std::vector<double> m_work[2];
+
+    void InitBank(Bank &b);
+    void StartPending(void);
+};
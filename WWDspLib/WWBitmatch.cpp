@@ -0,0 +1,430 @@
+#include "WWBitmatch.h"
+#include "WWFft.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_BITMATCH_USE_SSE
+#endif
+
+/// the decimated reference and captured data fit in this FFT size
+#define MAX_FFT_LOG2 (20)
+
+/// frames of the reference window of the full rate lag refinement
+#define REFINE_FRAMES (32768)
+
+/// the highest peaks of the decimated cross-correlation refined at the full rate.
+/// a periodic waveform has several peaks of similar height
+#define REFINE_PEAKS (4)
+
+/// frames decoded and compared at once
+#define BLOCK_FRAMES (4096)
+
+static bool
+IsValidPcm(const WWBitmatchPcm &p)
+{
+    return nullptr != p.data && 0 < p.numFrames && 0 < p.numChannels
+        && (16 == p.bitsPerSample || 24 == p.bitsPerSample || 32 == p.bitsPerSample)
+        && 0 < p.validBitsPerSample && p.validBitsPerSample <= p.bitsPerSample;
+}
+
+static int
+FrameBytes(const WWBitmatchPcm &p)
+{
+    return p.numChannels * p.bitsPerSample / 8;
+}
+
+/// decodes frames from fromFrame to 32bit left aligned samples with the bits below the valid bits cleared
+static void
+Decode(const WWBitmatchPcm &pcm, int64_t fromFrame, int frames, int32_t *s_return)
+{
+    const unsigned char *p = &pcm.data[fromFrame * FrameBytes(pcm)];
+    const int n = frames * pcm.numChannels;
+    int i = 0;
+
+    switch (pcm.bitsPerSample) {
+    case 16:
+#ifdef WW_BITMATCH_USE_SSE
+        for (; i + 8 <= n; i += 8) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)&p[2 * i]);
+            _mm_storeu_si128((__m128i *)&s_return[i],     _mm_unpacklo_epi16(_mm_setzero_si128(), v));
+            _mm_storeu_si128((__m128i *)&s_return[i + 4], _mm_unpackhi_epi16(_mm_setzero_si128(), v));
+        }
+#endif
+        for (; i<n; ++i) {
+            s_return[i] = (int32_t)(((uint32_t)p[2 * i] << 16) | ((uint32_t)p[2 * i + 1] << 24));
+        }
+        break;
+    case 24:
+        for (; i<n; ++i) {
+            s_return[i] = (int32_t)(((uint32_t)p[3 * i] << 8) | ((uint32_t)p[3 * i + 1] << 16)
+                    | ((uint32_t)p[3 * i + 2] << 24));
+        }
+        break;
+    case 32:
+        memcpy(s_return, p, sizeof(int32_t) * n);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+
+    if (pcm.validBitsPerSample < 32) {
+        const int32_t mask = (int32_t)(0xffffffffU << (32 - pcm.validBitsPerSample));
+        for (i=0; i<n; ++i) {
+            s_return[i] &= mask;
+        }
+    }
+}
+
+/// full scale is 1.0
+static void
+DecodeFloat(const WWBitmatchPcm &pcm, int64_t fromFrame, int64_t frames, float *out_return)
+{
+    std::vector<int32_t> s((size_t)BLOCK_FRAMES * pcm.numChannels);
+
+    for (int64_t pos=0; pos<frames; pos += BLOCK_FRAMES) {
+        const int n = (int)std::min((int64_t)BLOCK_FRAMES, frames - pos);
+        Decode(pcm, fromFrame + pos, n, &s[0]);
+
+        float *out = &out_return[pos * pcm.numChannels];
+        for (int i=0; i<n * pcm.numChannels; ++i) {
+            out[i] = s[i] * (1.0f / 2147483648.0f);
+        }
+    }
+}
+
+/// sum of n samples. exact while n is smaller than 2^22
+static double
+Sum(const int32_t *s, int n)
+{
+    int i = 0;
+    double r = 0;
+
+#ifdef WW_BITMATCH_USE_SSE
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+        acc0 = _mm_add_pd(acc0, _mm_cvtepi32_pd(v));
+        acc1 = _mm_add_pd(acc1, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    double t[2];
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    r = t[0] + t[1];
+#endif
+
+    for (; i<n; ++i) {
+        r += s[i];
+    }
+    return r;
+}
+
+/// channel sum of every decimation frames
+static void
+Decimate(const WWBitmatchPcm &pcm, int decimation, float *out_return)
+{
+    const int numCh = pcm.numChannels;
+    std::vector<int32_t> s((size_t)BLOCK_FRAMES * numCh);
+
+    int64_t k = 0;
+    int phase = 0;
+    double acc = 0;
+
+    for (int64_t pos=0; pos<pcm.numFrames; pos += BLOCK_FRAMES) {
+        const int n = (int)std::min((int64_t)BLOCK_FRAMES, pcm.numFrames - pos);
+        Decode(pcm, pos, n, &s[0]);
+
+        // a box may span blocks
+        int i = 0;
+        while (i < n) {
+            const int m = std::min(n - i, decimation - phase);
+            acc += Sum(&s[i * numCh], m * numCh);
+            i += m;
+            phase += m;
+
+            if (phase == decimation) {
+                out_return[k++] = (float)(acc * (1.0 / 2147483648.0));
+                acc = 0;
+                phase = 0;
+            }
+        }
+    }
+    if (0 < phase) {
+        out_return[k] = (float)(acc * (1.0 / 2147483648.0));
+    }
+}
+
+static double
+Dot(const float *a, const float *b, int n)
+{
+    int i = 0;
+    double r = 0;
+
+#ifdef WW_BITMATCH_USE_SSE
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        const __m128 x = _mm_loadu_ps(&a[i]);
+        const __m128 y = _mm_loadu_ps(&b[i]);
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtps_pd(x), _mm_cvtps_pd(y)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), _mm_cvtps_pd(_mm_movehl_ps(y, y))));
+    }
+    double t[2];
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    r = t[0] + t[1];
+#endif
+
+    for (; i<n; ++i) {
+        r += (double)a[i] * b[i];
+    }
+    return r;
+}
+
+/// finds the lag of the highest normalized cross-correlation within 2 decimation periods of the coarse lag.
+/// the window of the reference overlaps the captured data at every candidate lag
+static int
+Refine(const WWBitmatchPcm &ref, const WWBitmatchPcm &cap, int64_t coarse, int decimation,
+        int64_t &lag_return, double &correlation_return)
+{
+    const int numCh = ref.numChannels;
+
+    const int64_t lagLo = std::max(coarse - 2 * decimation, -(ref.numFrames - 1));
+    const int64_t lagHi = std::min(coarse + 2 * decimation, cap.numFrames - 1);
+    int64_t p0 = std::max((int64_t)0, -lagLo);
+    int64_t p1 = std::min(ref.numFrames, cap.numFrames - lagHi);
+    if (p1 <= p0) {
+        return -1;
+    }
+    if (REFINE_FRAMES < p1 - p0) {
+        p0 = (p0 + p1 - REFINE_FRAMES) / 2;
+        p1 = p0 + REFINE_FRAMES;
+    }
+
+    const int64_t frames = p1 - p0;
+    const int64_t capFrames = frames + lagHi - lagLo;
+
+    std::vector<float> r((size_t)(frames * numCh));
+    std::vector<float> c((size_t)(capFrames * numCh));
+    DecodeFloat(ref, p0, frames, &r[0]);
+    DecodeFloat(cap, p0 + lagLo, capFrames, &c[0]);
+
+    // energy of the captured window of each candidate lag by the prefix sum of the frame energies
+    std::vector<double> prefix((size_t)capFrames + 1, 0.0);
+    for (int64_t i=0; i<capFrames; ++i) {
+        prefix[i + 1] = prefix[i] + Dot(&c[i * numCh], &c[i * numCh], numCh);
+    }
+    const double refEnergy = Dot(&r[0], &r[0], (int)(frames * numCh));
+
+    double best = -HUGE_VAL;
+    for (int64_t lag=lagLo; lag<=lagHi; ++lag) {
+        const int64_t o = lag - lagLo;
+        const double capEnergy = prefix[o + frames] - prefix[o];
+        const double d = Dot(&r[0], &c[o * numCh], (int)(frames * numCh));
+        const double e = refEnergy * capEnergy;
+        const double corr = (0 < e) ? d / sqrt(e) : 0.0;
+
+        if (best < corr) {
+            best = corr;
+            lag_return = lag;
+        }
+    }
+
+    correlation_return = best;
+    return 0;
+}
+
+int
+WWBitmatchFindLag(const WWBitmatchPcm &ref, const WWBitmatchPcm &cap, int64_t &lag_return, double &correlation_return)
+{
+    lag_return = 0;
+    correlation_return = 0;
+
+    if (!IsValidPcm(ref) || !IsValidPcm(cap) || ref.numChannels != cap.numChannels) {
+        return -1;
+    }
+
+    // coarse lag by the FFT cross-correlation of the decimated channel sums
+    const int64_t maxFft = (int64_t)1 << MAX_FFT_LOG2;
+    const int decimation = (int)std::max((int64_t)1, (ref.numFrames + cap.numFrames + maxFft - 3) / (maxFft - 2));
+    const int64_t refD = (ref.numFrames + decimation - 1) / decimation;
+    const int64_t capD = (cap.numFrames + decimation - 1) / decimation;
+
+    int fftSize = 4;
+    while (fftSize < refD + capD) {
+        fftSize *= 2;
+    }
+
+    WWRealFft fft;
+    if (fft.Init(fftSize) < 0) {
+        return -1;
+    }
+    const int bins = fft.NumBins();
+
+    std::vector<float> x(fftSize, 0.0f);
+    std::vector<float> refRe(bins), refIm(bins), capRe(bins), capIm(bins);
+
+    Decimate(ref, decimation, &x[0]);
+    fft.Forward(&x[0], &refRe[0], &refIm[0]);
+
+    std::fill(x.begin(), x.end(), 0.0f);
+    Decimate(cap, decimation, &x[0]);
+    fft.Forward(&x[0], &capRe[0], &capIm[0]);
+
+    // cap * conj(ref): x[k] = sum_i ref[i] cap[i + k]
+    for (int i=0; i<bins; ++i) {
+        const float re = capRe[i] * refRe[i] + capIm[i] * refIm[i];
+        const float im = capIm[i] * refRe[i] - capRe[i] * refIm[i];
+        capRe[i] = re;
+        capIm[i] = im;
+    }
+    fft.Inverse(&capRe[0], &capIm[0], &x[0]);
+
+    // the highest local maxima. negative lags wrap around
+    std::vector<std::pair<float, int64_t> > maxima;
+    for (int k=0; k<fftSize; ++k) {
+        const int64_t lagD = (k < capD) ? k : (int64_t)k - fftSize;
+        if (lagD <= -refD) {
+            continue;
+        }
+        if (x[(k + fftSize - 1) % fftSize] <= x[k] && x[(k + 1) % fftSize] < x[k]) {
+            maxima.push_back(std::make_pair(x[k], lagD));
+        }
+    }
+    const size_t numPeaks = std::min(maxima.size(), (size_t)REFINE_PEAKS);
+    std::partial_sort(maxima.begin(), maxima.begin() + numPeaks, maxima.end(),
+            [](const std::pair<float, int64_t> &a, const std::pair<float, int64_t> &b) { return b.first < a.first; });
+
+    std::vector<int64_t> peaks;
+    for (size_t i=0; i<numPeaks; ++i) {
+        peaks.push_back(maxima[i].second);
+    }
+
+    int found = -1;
+    int64_t lag = 0;
+    double corr = 0;
+    for (size_t i=0; i<peaks.size(); ++i) {
+        if (Refine(ref, cap, peaks[i] * decimation, decimation, lag, corr) < 0) {
+            continue;
+        }
+        if (found < 0 || correlation_return < corr) {
+            lag_return = lag;
+            correlation_return = corr;
+            found = 0;
+        }
+    }
+    return found;
+}
+
+/// @return true: n samples are the same
+static bool
+IsEqual(const int32_t *a, const int32_t *b, int n)
+{
+    int i = 0;
+
+#ifdef WW_BITMATCH_USE_SSE
+    __m128i diff = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)&a[i]),
+                _mm_loadu_si128((const __m128i *)&b[i])));
+    }
+    if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128()))) {
+        return false;
+    }
+#endif
+
+    for (; i<n; ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+EndRange(const WWBitmatchRange &range, int maxRanges, WWBitmatchResult &r)
+{
+    ++r.numRanges;
+    if ((int64_t)r.ranges.size() < maxRanges) {
+        r.ranges.push_back(range);
+    }
+}
+
+int
+WWBitmatchCompare(const WWBitmatchPcm &ref, const WWBitmatchPcm &cap, int64_t lag, int maxRanges,
+        WWBitmatchResult &r_return)
+{
+    r_return = WWBitmatchResult();
+
+    if (!IsValidPcm(ref) || !IsValidPcm(cap) || ref.numChannels != cap.numChannels || maxRanges < 0) {
+        return -1;
+    }
+    const int numCh = ref.numChannels;
+
+    const int64_t from = std::max((int64_t)0, -lag);
+    const int64_t to   = std::max(from, std::min(ref.numFrames, cap.numFrames - lag));
+
+    r_return.lag = lag;
+    r_return.comparedFromFrame = from;
+    r_return.comparedToFrame   = to;
+
+    // equal bytes are equal samples
+    const bool sameFormat = (ref.bitsPerSample == cap.bitsPerSample && ref.validBitsPerSample == cap.validBitsPerSample);
+
+    std::vector<int32_t> a((size_t)BLOCK_FRAMES * numCh);
+    std::vector<int32_t> b((size_t)BLOCK_FRAMES * numCh);
+
+    WWBitmatchRange range;
+    bool inRange = false;
+
+    for (int64_t pos=from; pos<to; pos += BLOCK_FRAMES) {
+        const int n = (int)std::min((int64_t)BLOCK_FRAMES, to - pos);
+
+        if (sameFormat && 0 == memcmp(&ref.data[pos * FrameBytes(ref)], &cap.data[(pos + lag) * FrameBytes(cap)],
+                (size_t)n * FrameBytes(ref))) {
+            continue;
+        }
+
+        Decode(ref, pos, n, &a[0]);
+        Decode(cap, pos + lag, n, &b[0]);
+        if (!sameFormat && IsEqual(&a[0], &b[0], n * numCh)) {
+            continue;
+        }
+
+        for (int i=0; i<n; ++i) {
+            int mismatched = 0;
+            for (int ch=0; ch<numCh; ++ch) {
+                mismatched += (a[i * numCh + ch] != b[i * numCh + ch]);
+            }
+            if (0 == mismatched) {
+                continue;
+            }
+
+            const int64_t frame = pos + i;
+            ++r_return.mismatchedFrames;
+            r_return.mismatchedSamples += mismatched;
+
+            if (inRange && range.toFrame == frame) {
+                ++range.toFrame;
+                range.mismatchedSamples += mismatched;
+            } else {
+                if (inRange) {
+                    EndRange(range, maxRanges, r_return);
+                }
+                range.fromFrame = frame;
+                range.toFrame = frame + 1;
+                range.mismatchedSamples = mismatched;
+                inRange = true;
+            }
+        }
+    }
+
+    if (inRange) {
+        EndRange(range, maxRanges, r_return);
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// channel interleaved integer PCM data compared by WWBitmatch
+struct WWBitmatchPcm {
+    const unsigned char *data;
+    int64_t numFrames;
+    int numChannels;
+
+    /// container bits: 16, 24 or 32
+    int bitsPerSample;
+
+    /// bits from the MSB that are compared. 24 for 24bit in a 32bit container: the lowest byte is ignored
+    int validBitsPerSample;
+
+    WWBitmatchPcm(void) : data(nullptr), numFrames(0), numChannels(0), bitsPerSample(0), validBitsPerSample(0) { }
+};
+
+/// consecutive reference frames that have mismatched samples
+struct WWBitmatchRange {
+    int64_t fromFrame;
+    int64_t toFrame;
+    int64_t mismatchedSamples;
+};
+
+struct WWBitmatchResult {
+    /// captured frame lag + i is the reference frame i
+    int64_t lag;
+
+    /// reference frames [comparedFromFrame, comparedToFrame) overlap the captured data and are compared
+    int64_t comparedFromFrame;
+    int64_t comparedToFrame;
+
+    int64_t mismatchedFrames;
+    int64_t mismatchedSamples;
+
+    /// number of the mismatched ranges and the first maxRanges of them in the reference frame
+    int64_t numRanges;
+    std::vector<WWBitmatchRange> ranges;
+
+    WWBitmatchResult(void) : lag(0), comparedFromFrame(0), comparedToFrame(0), mismatchedFrames(0), mismatchedSamples(0),
+            numRanges(0) { }
+};
+
+/// finds the lag of the captured data that matches the reference best.
+///
+///   The channel sums of both are decimated by box averaging so that the two fit in a 2^20 point FFT and
+///   cross-correlated by the FFT. Around the peak the lag is refined at the full rate by the normalized
+///   cross-correlation of a window of the reference, 4 samples at once by SSE.
+///   The lag is from -(ref.numFrames - 1) to cap.numFrames - 1.
+/// @param correlation_return normalized cross-correlation of the refined window at the lag. 1.0: the same waveform
+/// @return 0: success. negative: bad parameter or the overlap is too short to refine
+int WWBitmatchFindLag(const WWBitmatchPcm &ref, const WWBitmatchPcm &cap, int64_t &lag_return, double &correlation_return);
+
+/// compares the samples of the reference with the captured samples at the lag.
+///
+///   The samples are compared as 32bit left aligned values with the bits below the valid bits cleared,
+///   so 16bit data captured as 24bit matches when the low byte is 0. A block of the same format is
+///   compared by memcmp() first and the other blocks 4 samples at once by SSE2. Only the blocks that
+///   differ are scanned sample by sample for the mismatched ranges.
+/// @return 0: success. negative: bad parameter
+int WWBitmatchCompare(const WWBitmatchPcm &ref, const WWBitmatchPcm &cap, int64_t lag, int maxRanges,
+        WWBitmatchResult &r_return);
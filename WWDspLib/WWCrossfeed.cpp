@@ -0,0 +1,517 @@
+#include "WWCrossfeed.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+/// compiled spectrum cache file
+#define CACHE_MAGIC      "WWCS"
+#define CACHE_VERSION    (1)
+#define CACHE_MAX_STAGES (32)
+
+/// data of each stage starts at a multiple of this
+#define CACHE_ALIGN      (64)
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t cfd2Hash;
+    int32_t sampleRate;
+    int32_t numTaps;
+    int32_t firstBlockFrames;
+    int32_t maxBlockFrames;
+    int32_t numStages;
+    int32_t reserved;
+};
+
+/// followed by CacheHeader::numStages entries
+struct CacheStage {
+    /// file offset and number of the floats of the partition spectra of the stage
+    uint64_t offset;
+    uint64_t floats;
+};
+
+#define CROSSOVER_COEFF_LENGTH (49)
+
+/// 1kHz lowpass of the crossover (designed for 44.1kHz). the same coefficients as WWCudaCrossfeed
+static const float gCrossoverLpf[CROSSOVER_COEFF_LENGTH] = {
+        0.005228327f, 0.003249754f, 0.004192373f, 0.005265026f,
+        0.006468574f, 0.007797099f, 0.009237486f, 0.010779043f,
+        0.012417001f, 0.014132141f, 0.01589555f,  0.017701121f,
+        0.019508703f, 0.021304869f, 0.023059883f, 0.024747905f,
+        0.02634363f,  0.027823228f, 0.029158971f, 0.030331066f,
+        0.031319484f, 0.032104039f, 0.032676435f, 0.033022636f,
+        0.033138738f, 0.033022636f, 0.032676435f, 0.032104039f,
+        0.031319484f, 0.030331066f, 0.029158971f, 0.027823228f,
+        0.02634363f,  0.024747905f, 0.023059883f, 0.021304869f,
+        0.019508703f, 0.017701121f, 0.01589555f,  0.014132141f,
+        0.012417001f, 0.010779043f, 0.009237486f, 0.007797099f,
+        0.006468574f, 0.005265026f, 0.004192373f, 0.003249754f,
+        0.005228327f };
+
+/// highpass of the crossover: complementary to the lowpass
+static const float gCrossoverHpf[CROSSOVER_COEFF_LENGTH] = {
+        -0.005228327f,-0.003249754f,-0.004192373f,-0.005265026f,
+        -0.006468574f,-0.007797099f,-0.009237486f,-0.010779043f,
+        -0.012417001f,-0.014132141f,-0.01589555f, -0.017701121f,
+        -0.019508703f,-0.021304869f,-0.023059883f,-0.024747905f,
+        -0.02634363f, -0.027823228f,-0.029158971f,-0.030331066f,
+        -0.031319484f,-0.032104039f,-0.032676435f,-0.033022636f,
+         0.966861262f,-0.033022636f,-0.032676435f,-0.032104039f,
+        -0.031319484f,-0.030331066f,-0.029158971f,-0.027823228f,
+        -0.02634363f, -0.024747905f,-0.023059883f,-0.021304869f,
+        -0.019508703f,-0.017701121f,-0.01589555f, -0.014132141f,
+        -0.012417001f,-0.010779043f,-0.009237486f,-0.007797099f,
+        -0.006468574f,-0.005265026f,-0.004192373f,-0.003249754f,
+        -0.005228327f };
+
+static bool
+ReadOneLine(FILE *fp, char *line_return, size_t lineBytes)
+{
+    if (nullptr == fgets(line_return, (int)lineBytes, fp)) {
+        line_return[0] = 0;
+        return false;
+    }
+
+    // removes CR LF
+    size_t len = strlen(line_return);
+    while (0 < len && (line_return[len-1] == '\n' || line_return[len-1] == '\r')) {
+        line_return[--len] = 0;
+    }
+    return true;
+}
+
+int
+WWCrossfeedReadCfd2(FILE *fp, WWCrossfeedCoeffs &c_return)
+{
+    char buff[512];
+
+    if (!ReadOneLine(fp, buff, sizeof buff) || 0 != strncmp(buff, "CFD2", 4)) {
+        return -1;
+    }
+
+    if (!ReadOneLine(fp, buff, sizeof buff) || (c_return.sampleRate = (int)strtol(buff, nullptr, 10)) <= 0) {
+        return -1;
+    }
+
+    if (!ReadOneLine(fp, buff, sizeof buff) || (c_return.numTaps = (int)strtol(buff, nullptr, 10)) <= 0) {
+        return -1;
+    }
+
+    // comment line
+    if (!ReadOneLine(fp, buff, sizeof buff)) {
+        return -1;
+    }
+
+    for (int i=0; i<WW_CROSSFEED_COEFF_NUM; ++i) {
+        c_return.coeffs[i].resize(c_return.numTaps);
+    }
+
+    for (int t=0; t<c_return.numTaps; ++t) {
+        if (!ReadOneLine(fp, buff, sizeof buff)) {
+            return -1;
+        }
+
+        // 8 comma separated values
+        const char *p = buff;
+        for (int i=0; i<WW_CROSSFEED_COEFF_NUM; ++i) {
+            char *end = nullptr;
+            const double v = strtod(p, &end);
+            if (end == p) {
+                return -1;
+            }
+            c_return.coeffs[i][t] = (float)v;
+
+            p = end;
+            while (*p == ' ' || *p == ',') {
+                ++p;
+            }
+        }
+    }
+
+    return 0;
+}
+
+uint64_t
+WWCrossfeedHash(FILE *fp)
+{
+    static const uint64_t FNV_BASIS = 14695981039346656037ULL;
+    static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    // FNV-1a on 8 byte words in 4 independent lanes, to hash large CFD2 files fast
+    uint64_t lane[4] = { FNV_BASIS, FNV_BASIS + 1, FNV_BASIS + 2, FNV_BASIS + 3 };
+    uint64_t totalBytes = 0;
+    unsigned char buff[65536];
+
+    size_t n;
+    while (0 < (n = fread(buff, 1, sizeof buff, fp))) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            for (int j=0; j<4; ++j) {
+                uint64_t w;
+                memcpy(&w, &buff[i + j * 8], 8);
+                lane[j] = (lane[j] ^ w) * FNV_PRIME;
+                lane[j] ^= lane[j] >> 32;
+            }
+        }
+        for (; i < n; ++i) {
+            lane[0] = (lane[0] ^ buff[i]) * FNV_PRIME;
+        }
+        totalBytes += n;
+    }
+
+    uint64_t h = FNV_BASIS;
+    for (int j=0; j<4; ++j) {
+        h = (h ^ lane[j]) * FNV_PRIME;
+    }
+    return (h ^ totalBytes) * FNV_PRIME;
+}
+
+WWCrossfeed::WWCrossfeed(void)
+    : m_sampleRate(0), m_numTaps(0)
+{
+}
+
+WWCrossfeed::~WWCrossfeed(void)
+{
+    Term();
+}
+
+/// h = lpf * lo + hpf * hi
+static void
+FoldCrossover(const std::vector<float> &lo, const std::vector<float> &hi, std::vector<float> &h_return)
+{
+    const int n = (int)lo.size();
+    h_return.assign(n + CROSSOVER_COEFF_LENGTH - 1, 0.0f);
+
+    for (int i=0; i<n; ++i) {
+        if (0.0f == lo[i] && 0.0f == hi[i]) {
+            continue;
+        }
+        for (int j=0; j<CROSSOVER_COEFF_LENGTH; ++j) {
+            h_return[i + j] += gCrossoverLpf[j] * lo[i] + gCrossoverHpf[j] * hi[i];
+        }
+    }
+}
+
+int
+WWCrossfeed::Init(const WWCrossfeedCoeffs &c, int blockFrames)
+{
+    Term();
+
+    if (c.numTaps <= 0) {
+        return -1;
+    }
+
+    m_sampleRate = c.sampleRate;
+    m_numTaps = c.numTaps + CROSSOVER_COEFF_LENGTH - 1;
+
+    if (m_convolver.Init(2, 2, blockFrames, std::max(blockFrames, WW_CROSSFEED_MAX_BLOCK_FRAMES), m_numTaps) < 0) {
+        return -1;
+    }
+
+    // speaker (input) to ear (output), as CrossfeedFilter of WWAudioFilter.
+    // coeffs[speaker * 2 + ear] is the low part and coeffs[4 + speaker * 2 + ear] is the high part.
+    std::vector<float> h;
+    for (int speaker=0; speaker<2; ++speaker) {
+        for (int ear=0; ear<2; ++ear) {
+            FoldCrossover(c.coeffs[speaker * 2 + ear], c.coeffs[4 + speaker * 2 + ear], h);
+            m_convolver.SetFilter(speaker, ear, &h[0], (int)h.size());
+        }
+    }
+
+    return 0;
+}
+
+void
+WWCrossfeed::Term(void)
+{
+    // the convolver refers to the cache
+    m_convolver.Term();
+    m_cache.Close();
+    m_sampleRate = 0;
+    m_numTaps = 0;
+}
+
+int
+WWCrossfeed::WriteCache(FILE *fp, uint64_t cfd2Hash) const
+{
+    const int numStages = m_convolver.NumStages();
+
+    CacheHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, CACHE_MAGIC, 4);
+    h.version          = CACHE_VERSION;
+    h.cfd2Hash         = cfd2Hash;
+    h.sampleRate       = m_sampleRate;
+    h.numTaps          = m_numTaps;
+    h.firstBlockFrames = m_convolver.StageBlockFrames(0);
+    h.maxBlockFrames   = std::max(h.firstBlockFrames, WW_CROSSFEED_MAX_BLOCK_FRAMES);
+    h.numStages        = numStages;
+
+    std::vector<CacheStage> stages(numStages);
+    uint64_t offset = sizeof h + sizeof(CacheStage) * numStages;
+    for (int i=0; i<numStages; ++i) {
+        offset = (offset + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+        stages[i].offset = offset;
+        stages[i].floats = m_convolver.StageFilterSpectraFloats(i);
+        offset += sizeof(float) * stages[i].floats;
+    }
+
+    if (1 != fwrite(&h, sizeof h, 1, fp)
+            || (size_t)numStages != fwrite(&stages[0], sizeof(CacheStage), numStages, fp)) {
+        return -1;
+    }
+
+    uint64_t pos = sizeof h + sizeof(CacheStage) * numStages;
+    for (int i=0; i<numStages; ++i) {
+        static const char zeroes[CACHE_ALIGN] = {};
+        const size_t pad = (size_t)(stages[i].offset - pos);
+        if (pad != fwrite(zeroes, 1, pad, fp)) {
+            return -1;
+        }
+        if ((size_t)stages[i].floats != fwrite(m_convolver.StageFilterSpectra(i), sizeof(float), (size_t)stages[i].floats, fp)) {
+            return -1;
+        }
+        pos = stages[i].offset + sizeof(float) * stages[i].floats;
+    }
+    return 0;
+}
+
+/// m_cache is open
+int
+WWCrossfeed::InitFromCache(uint64_t cfd2Hash, int blockFrames)
+{
+    const unsigned char *p = m_cache.Data();
+    const size_t bytes = m_cache.Bytes();
+
+    CacheHeader h;
+    if (bytes < sizeof h) {
+        return -1;
+    }
+    memcpy(&h, p, sizeof h);
+
+    if (0 != memcmp(h.magic, CACHE_MAGIC, 4) || CACHE_VERSION != h.version || cfd2Hash != h.cfd2Hash
+            || blockFrames != h.firstBlockFrames || std::max(blockFrames, WW_CROSSFEED_MAX_BLOCK_FRAMES) != h.maxBlockFrames
+            || h.numStages < 1 || CACHE_MAX_STAGES < h.numStages || h.numTaps <= 0
+            || bytes < sizeof h + sizeof(CacheStage) * h.numStages) {
+        return -1;
+    }
+
+    std::vector<CacheStage> stages(h.numStages);
+    memcpy(&stages[0], p + sizeof h, sizeof(CacheStage) * h.numStages);
+
+    // unused entries are nullptr, in case the stages do not match
+    const float *spectra[CACHE_MAX_STAGES] = {};
+    for (int i=0; i<h.numStages; ++i) {
+        if (bytes < stages[i].offset || (bytes - stages[i].offset) / sizeof(float) < stages[i].floats
+                || 0 != stages[i].offset % sizeof(float)) {
+            return -1;
+        }
+        spectra[i] = (const float *)(p + stages[i].offset);
+    }
+
+    if (m_convolver.Init(2, 2, h.firstBlockFrames, h.maxBlockFrames, h.numTaps, spectra) < 0) {
+        return -1;
+    }
+
+    bool match = (m_convolver.NumStages() == h.numStages);
+    for (int i=0; match && i<h.numStages; ++i) {
+        match = (m_convolver.StageFilterSpectraFloats(i) == stages[i].floats);
+    }
+    if (!match) {
+        m_convolver.Term();
+        return -1;
+    }
+
+    m_sampleRate = h.sampleRate;
+    m_numTaps = h.numTaps;
+    return 0;
+}
+
+int
+WWCrossfeed::InitShared(const WWCrossfeed &master)
+{
+    Term();
+
+    const int numStages = master.m_convolver.NumStages();
+    if (master.m_numTaps <= 0 || CACHE_MAX_STAGES < numStages) {
+        return -1;
+    }
+
+    const float *spectra[CACHE_MAX_STAGES] = {};
+    for (int i=0; i<numStages; ++i) {
+        spectra[i] = master.m_convolver.StageFilterSpectra(i);
+    }
+
+    const int blockFrames = master.m_convolver.StageBlockFrames(0);
+    if (m_convolver.Init(2, 2, blockFrames, std::max(blockFrames, WW_CROSSFEED_MAX_BLOCK_FRAMES), master.m_numTaps, spectra) < 0) {
+        return -1;
+    }
+
+    m_sampleRate = master.m_sampleRate;
+    m_numTaps = master.m_numTaps;
+    return 0;
+}
+
+static FILE *
+OpenFile(const char *path, bool write)
+{
+    FILE *fp = nullptr;
+#ifdef _MSC_VER
+    if (0 != fopen_s(&fp, path, write ? "wb" : "rb")) {
+        fp = nullptr;
+    }
+#else
+    fp = fopen(path, write ? "wb" : "rb");
+#endif
+    return fp;
+}
+
+std::string
+WWCrossfeedCachePath(const char *cfd2Path, int blockFrames)
+{
+    return std::string(cfd2Path) + ".b" + std::to_string(blockFrames) + ".wwcs";
+}
+
+static int
+ProcessId(void)
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return (int)getpid();
+#endif
+}
+
+/// the cache is written to this file of the process and renamed to the cache path
+static std::string
+CacheTempPath(const std::string &cachePath)
+{
+    return cachePath + "." + std::to_string(ProcessId()) + ".tmp";
+}
+
+/// replaces to with from. another process that has mapped the old file keeps it
+/// @return 0: success. negative: failed and from is left
+static int
+RenameOver(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+#ifdef _WIN32
+static FILE *
+OpenFile(const wchar_t *path, bool write)
+{
+    FILE *fp = nullptr;
+    if (0 != _wfopen_s(&fp, path, write ? L"wb" : L"rb")) {
+        fp = nullptr;
+    }
+    return fp;
+}
+
+std::wstring
+WWCrossfeedCachePath(const wchar_t *cfd2Path, int blockFrames)
+{
+    return std::wstring(cfd2Path) + L".b" + std::to_wstring(blockFrames) + L".wwcs";
+}
+
+static std::wstring
+CacheTempPath(const std::wstring &cachePath)
+{
+    return cachePath + L"." + std::to_wstring(ProcessId()) + L".tmp";
+}
+
+static int
+RenameOver(const wchar_t *from, const wchar_t *to)
+{
+    return MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+static int
+RemoveFile(const wchar_t *path)
+{
+    return _wremove(path);
+}
+#endif
+
+static int
+RemoveFile(const char *path)
+{
+    return remove(path);
+}
+
+template <typename CHAR>
+int
+WWCrossfeed::InitFromFileT(const CHAR *cfd2Path, int blockFrames)
+{
+    Term();
+
+    FILE *fp = OpenFile(cfd2Path, false);
+    if (nullptr == fp) {
+        return -1;
+    }
+
+    const uint64_t hash = WWCrossfeedHash(fp);
+    const auto cachePath = WWCrossfeedCachePath(cfd2Path, blockFrames);
+
+    if (0 == m_cache.Open(cachePath.c_str())) {
+        if (0 == InitFromCache(hash, blockFrames)) {
+            fclose(fp);
+            return 1;
+        }
+        m_cache.Close();
+    }
+
+    // cache is not available: reads the CFD2 text
+    WWCrossfeedCoeffs c;
+    rewind(fp);
+    int rv = WWCrossfeedReadCfd2(fp, c);
+    fclose(fp);
+    fp = nullptr;
+    if (rv < 0 || Init(c, blockFrames) < 0) {
+        return -1;
+    }
+
+    // failure to write the cache is not an error. it is read from the CFD2 file next time.
+    // the stale cache may be mapped by another instance and truncating it there is SIGBUS:
+    // the new cache is written to a temporary file and renamed over the stale one
+    const auto tempPath = CacheTempPath(cachePath);
+    FILE *cacheFp = OpenFile(tempPath.c_str(), true);
+    if (cacheFp) {
+        rv = WriteCache(cacheFp, hash);
+        if (0 != fclose(cacheFp)) {
+            rv = -1;
+        }
+        if (rv < 0 || RenameOver(tempPath.c_str(), cachePath.c_str()) < 0) {
+            RemoveFile(tempPath.c_str());
+        }
+    }
+    return 0;
+}
+
+int
+WWCrossfeed::InitFromFile(const char *cfd2Path, int blockFrames)
+{
+    return InitFromFileT(cfd2Path, blockFrames);
+}
+
+#ifdef _WIN32
+int
+WWCrossfeed::InitFromFile(const wchar_t *cfd2Path, int blockFrames)
+{
+    return InitFromFileT(cfd2Path, blockFrames);
+}
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "WWNonUniformConvolver.h"
+#include "WWMappedFile.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/// number of impulse responses in the CFD2 crossfeed coefficient file
+#define WW_CROSSFEED_COEFF_NUM (8)
+
+/// convolver partition size for the real-time playback. latency is this number of frames
+#define WW_CROSSFEED_REALTIME_BLOCK_FRAMES (256)
+
+/// long impulse responses are convolved with blocks up to this size on background threads
+#define WW_CROSSFEED_MAX_BLOCK_FRAMES (16384)
+
+/// impulse responses read from the CFD2 file (written by WWCrossFeed).
+/// coeffs[0..3]: left-to-left, left-to-right, right-to-left, right-to-right of the low frequency part
+/// coeffs[4..7]: the same of the high frequency part
+struct WWCrossfeedCoeffs {
+    int sampleRate;
+    int numTaps;
+    std::vector<float> coeffs[WW_CROSSFEED_COEFF_NUM];
+
+    WWCrossfeedCoeffs(void) : sampleRate(0), numTaps(0) { }
+};
+
+/// reads CFD2 text file.
+/// @return 0: success. negative: not a CFD2 file or broken file
+int WWCrossfeedReadCfd2(FILE *fp, WWCrossfeedCoeffs &c_return);
+
+/// @return 64bit hash of the rest of the file. used as the key of the compiled spectrum cache
+uint64_t WWCrossfeedHash(FILE *fp);
+
+/// @return path of the compiled spectrum cache file of the CFD2 file for the block size
+std::string WWCrossfeedCachePath(const char *cfd2Path, int blockFrames);
+#ifdef _WIN32
+std::wstring WWCrossfeedCachePath(const wchar_t *cfd2Path, int blockFrames);
+#endif
+
+/// Stereo crossfeed of the CFD2 coefficients on the CPU.
+///
+///   Each input channel is split by the 1kHz crossover (the same 49-tap filter pair as WWCudaCrossfeed)
+///   and the low and high parts are convolved with the CFD2 impulse responses.
+///   The crossover is folded into the impulse responses beforehand, so the processing is a 2x2 filter matrix
+///   run by WWNonUniformConvolver: per channel memory is constant regardless of the length of the signal.
+class WWCrossfeed {
+public:
+    WWCrossfeed(void);
+    ~WWCrossfeed(void);
+
+    /// @param blockFrames first partition size of the convolver. power of 2. smaller is lower latency but slower
+    /// @return 0: success. negative: bad parameter
+    int Init(const WWCrossfeedCoeffs &c, int blockFrames);
+
+    /// reads the CFD2 file with the compiled spectrum cache.
+    /// the cache file cfd2Path.b<blockFrames>.wwcs holds the partition spectra and the hash of the CFD2 file.
+    /// when the hash matches, the spectra are memory mapped from the cache instead of parsing the CFD2 text
+    /// and transforming the coefficients. otherwise the CFD2 file is read and the cache file is (re)written.
+    /// @return 1: success. mapped from the cache. 0: success. read from the CFD2 file. negative: error
+    int InitFromFile(const char *cfd2Path, int blockFrames);
+#ifdef _WIN32
+    int InitFromFile(const wchar_t *cfd2Path, int blockFrames);
+#endif
+
+    /// uses the filter spectra of master in place. the signal history is of this instance.
+    /// for processing many files concurrently without transforming the coefficients for each.
+    /// master should be kept until Term()
+    /// @return 0: success. negative: master is not initialized
+    int InitShared(const WWCrossfeed &master);
+
+    void Term(void);
+
+    void Reset(void) { m_convolver.Reset(); }
+
+    int SampleRate(void) const { return m_sampleRate; }
+    int NumTaps(void) const { return m_numTaps; }
+    int LatencyFrames(void) const { return m_convolver.LatencyFrames(); }
+    size_t AllocatedBytes(void) const { return m_convolver.AllocatedBytes(); }
+
+    /// @param in  stereo interleaved. frames * 2 floats
+    /// @param out_return stereo interleaved. frames * 2 floats. in and out_return may not overlap
+    void Process(const float *in, int frames, float *out_return) { m_convolver.Process(in, frames, out_return); }
+
+    /// writes the compiled spectrum cache of the current filters.
+    /// @param cfd2Hash WWCrossfeedHash() of the CFD2 file
+    /// @return 0: success. negative: write error
+    int WriteCache(FILE *fp, uint64_t cfd2Hash) const;
+
+private:
+    int m_sampleRate;
+    int m_numTaps;
+    WWNonUniformConvolver m_convolver;
+
+    /// cache file of the filter spectra used by m_convolver
+    WWMappedFile m_cache;
+
+    int InitFromCache(uint64_t cfd2Hash, int blockFrames);
+
+    template <typename CHAR>
+    int InitFromFileT(const CHAR *cfd2Path, int blockFrames);
+};
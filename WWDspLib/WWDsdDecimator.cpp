@@ -0,0 +1,367 @@
+#include "WWDsdDecimator.h"
+#include "WWFirDesign.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_DSD_DECIMATOR_USE_SSE
+#endif
+
+/// passband edge relative to the PCM sample rate
+#define PASSBAND_RATIO     (0.45)
+
+/// stopband attenuation in dB
+#define STOPBAND_ATTENUATION_DB (120.0)
+
+/// DSD idle pattern. 4 ones and 4 zeros: 0 in PCM
+#define DSD_SILENCE_BYTE   (0x69)
+
+/// Process() splits channels to threads when the input is larger than this
+#define THREAD_MIN_BYTES_PER_CHANNEL (4096)
+
+#define DECIMATION_STAGE1  (8)
+#define DECIMATION_MAX     (256)
+
+struct HalfbandState {
+    /// even phase input. 2M-1 history samples followed by new samples
+    std::vector<float> even;
+    /// odd phase input. M history samples followed by new samples
+    std::vector<float> odd;
+
+    bool  hasPending;
+    float pending;
+};
+
+struct WWDsdDecimator::Channel {
+    /// m_lutBytes-1 history bytes followed by new bytes
+    std::vector<unsigned char> dsd;
+
+    std::vector<HalfbandState> halfband;
+
+    std::vector<float> work[2];
+};
+
+///////////////////////////////////////////////////////////////////////
+// half-band decimation by 2
+
+/// y[p] = sum_{j=0}^{2M-1} g[j] * even[p+j] + 0.5 * odd[p]
+/// @return output samples
+static int
+HalfbandProcess(const std::vector<float> &g, HalfbandState &s, const float *in, int n, float *out)
+{
+    const int M     = (int)g.size();
+    const int histE = 2 * M - 1;
+    const int histO = M;
+
+    const int total = n + (s.hasPending ? 1 : 0);
+    const int P     = total / 2;
+
+    s.even.resize(histE + P);
+    s.odd.resize(histO + P);
+    float *E = &s.even[0];
+    float *O = &s.odd[0];
+
+    int i = 0;
+    for (int p=0; p<P; ++p) {
+        if (p == 0 && s.hasPending) {
+            E[histE] = s.pending;
+        } else {
+            E[histE + p] = in[i++];
+        }
+        O[histO + p] = in[i++];
+    }
+    if (i < n) {
+        s.hasPending = true;
+        s.pending    = in[i];
+    } else if (0 < P) {
+        s.hasPending = false;
+    }
+
+    int p = 0;
+#ifdef WW_DSD_DECIMATOR_USE_SSE
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; p + 4 <= P; p += 4) {
+        __m128 acc = _mm_mul_ps(half, _mm_loadu_ps(&O[p]));
+        for (int j=0; j<M; ++j) {
+            __m128 a = _mm_loadu_ps(&E[p + j]);
+            __m128 b = _mm_loadu_ps(&E[p + 2 * M - 1 - j]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(g[j]), _mm_add_ps(a, b)));
+        }
+        _mm_storeu_ps(&out[p], acc);
+    }
+#endif /* WW_DSD_DECIMATOR_USE_SSE */
+    for (; p < P; ++p) {
+        float acc = 0.5f * O[p];
+        for (int j=0; j<M; ++j) {
+            acc += g[j] * (E[p + j] + E[p + 2 * M - 1 - j]);
+        }
+        out[p] = acc;
+    }
+
+    // keep history
+    memmove(E, &E[P], histE * sizeof(float));
+    memmove(O, &O[P], histO * sizeof(float));
+    s.even.resize(histE);
+    s.odd.resize(histO);
+
+    return P;
+}
+
+///////////////////////////////////////////////////////////////////////
+// WWDsdDecimator
+
+WWDsdDecimator::WWDsdDecimator(void)
+    : m_decimation(0), m_delayFrames(0), m_lutBytes(0)
+{
+}
+
+WWDsdDecimator::~WWDsdDecimator(void)
+{
+    Term();
+}
+
+int
+WWDsdDecimator::Init(int decimation, int numChannels)
+{
+    int halfbandStages = 0;
+
+    assert(m_channels.empty());
+
+    if (numChannels <= 0) {
+        return -1;
+    }
+
+    switch (decimation) {
+    case 8:   halfbandStages = 0; break;
+    case 16:  halfbandStages = 1; break;
+    case 32:  halfbandStages = 2; break;
+    case 64:  halfbandStages = 3; break;
+    case 128: halfbandStages = 4; break;
+    case 256: halfbandStages = 5; break;
+    default:
+        return -1;
+    }
+
+    m_decimation = decimation;
+
+    // frequencies below are normalized to the PCM sample rate
+
+    // stage 1: passband edge of the output. the band which folds onto the passband must be attenuated
+    {
+        const double fs      = decimation;
+        const double fp      = PASSBAND_RATIO;
+        const double fstop   = decimation / DECIMATION_STAGE1 - PASSBAND_RATIO;
+        const int    n       = WWKaiserLength(STOPBAND_ATTENUATION_DB, (fstop - fp) / fs);
+
+        m_lutBytes = (n + 7) / 8;
+
+        std::vector<double> h;
+        WWDesignLowpass(m_lutBytes * 8, (fp + fstop) * 0.5 / fs, WWKaiserBeta(STOPBAND_ATTENUATION_DB), h);
+
+        // h[age]: age 0 is the newest bit. LSB of the DSD byte is the newest bit
+        m_lut.resize(m_lutBytes * 256);
+        for (int k=0; k<m_lutBytes; ++k) {
+            for (int b=0; b<256; ++b) {
+                double v = 0;
+                for (int q=0; q<8; ++q) {
+                    v += ((b >> q) & 1) ? h[8 * k + q] : -h[8 * k + q];
+                }
+                m_lut[k * 256 + b] = (float)v;
+            }
+        }
+    }
+
+    // half-band stages
+    m_halfbandCoeffs.resize(halfbandStages);
+    for (int s=0; s<halfbandStages; ++s) {
+        // input sample rate of the stage
+        const double fin = (double)(decimation / DECIMATION_STAGE1) / (1 << s);
+        std::vector<double> g;
+        WWDesignHalfband(STOPBAND_ATTENUATION_DB, (fin * 0.5 - 2.0 * PASSBAND_RATIO) / fin, g);
+
+        m_halfbandCoeffs[s].resize(g.size());
+        for (size_t j=0; j<g.size(); ++j) {
+            m_halfbandCoeffs[s][j] = (float)g[j];
+        }
+    }
+
+    // group delay in DSD samples
+    {
+        double delay = (m_lutBytes * 8 - 1) * 0.5;
+        for (int s=0; s<halfbandStages; ++s) {
+            const int M = (int)m_halfbandCoeffs[s].size();
+            delay += (2 * M - 1) * (double)(DECIMATION_STAGE1 << s);
+        }
+        m_delayFrames = (int)(delay / decimation + 0.5);
+    }
+
+    m_channels.resize(numChannels);
+    for (int ch=0; ch<numChannels; ++ch) {
+        m_channels[ch] = new Channel();
+        m_channels[ch]->halfband.resize(halfbandStages);
+    }
+
+    Reset();
+    return 0;
+}
+
+void
+WWDsdDecimator::Term(void)
+{
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        delete m_channels[ch];
+        m_channels[ch] = nullptr;
+    }
+    m_channels.clear();
+
+    m_halfbandCoeffs.clear();
+    m_lut.clear();
+    m_lutBytes    = 0;
+    m_decimation  = 0;
+    m_delayFrames = 0;
+}
+
+void
+WWDsdDecimator::Reset(void)
+{
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        Channel *c = m_channels[ch];
+
+        c->dsd.assign(m_lutBytes - 1, DSD_SILENCE_BYTE);
+
+        for (size_t s=0; s<c->halfband.size(); ++s) {
+            const int M = (int)m_halfbandCoeffs[s].size();
+            HalfbandState &hs = c->halfband[s];
+            hs.even.assign(2 * M - 1, 0.0f);
+            hs.odd.assign(M, 0.0f);
+            hs.hasPending = false;
+            hs.pending    = 0.0f;
+        }
+    }
+}
+
+int
+WWDsdDecimator::MaxOutputFrames(int dsdBytesPerChannel) const
+{
+    const int stages = (int)m_halfbandCoeffs.size();
+
+    // each half-band stage may hold one pending sample
+    return (dsdBytesPerChannel >> stages) + 1;
+}
+
+void
+WWDsdDecimator::ProcessChannel(int ch, const unsigned char *dsd, int dsdBytesPerChannel, float *pcm, int *outFrames_return)
+{
+    Channel *c = m_channels[ch];
+    const int numChannels = (int)m_channels.size();
+    const int hist = m_lutBytes - 1;
+
+    c->dsd.resize(hist + dsdBytesPerChannel);
+    unsigned char *bytes = &c->dsd[0];
+    for (int i=0; i<dsdBytesPerChannel; ++i) {
+        bytes[hist + i] = dsd[i * numChannels + ch];
+    }
+
+    c->work[0].resize(dsdBytesPerChannel + 1);
+    c->work[1].resize(dsdBytesPerChannel / 2 + 1);
+
+    // stage 1: one output for each DSD byte
+    {
+        const float *lut = &m_lut[0];
+        float *out = &c->work[0][0];
+        int m = 0;
+
+        // 4 outputs at once to hide the latency of the additions
+        for (; m + 4 <= dsdBytesPerChannel; m += 4) {
+            const unsigned char *p = &bytes[hist + m];
+            float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for (int k=0; k<m_lutBytes; ++k) {
+                const float *t = &lut[k * 256];
+                acc0 += t[p[0 - k]];
+                acc1 += t[p[1 - k]];
+                acc2 += t[p[2 - k]];
+                acc3 += t[p[3 - k]];
+            }
+            out[m + 0] = acc0;
+            out[m + 1] = acc1;
+            out[m + 2] = acc2;
+            out[m + 3] = acc3;
+        }
+        for (; m<dsdBytesPerChannel; ++m) {
+            const unsigned char *p = &bytes[hist + m];
+            float acc = 0;
+            for (int k=0; k<m_lutBytes; ++k) {
+                acc += lut[k * 256 + p[-k]];
+            }
+            out[m] = acc;
+        }
+
+        memmove(bytes, &bytes[dsdBytesPerChannel], hist);
+        c->dsd.resize(hist);
+    }
+
+    // half-band stages
+    int n = dsdBytesPerChannel;
+    int from = 0;
+    for (size_t s=0; s<c->halfband.size(); ++s) {
+        n = HalfbandProcess(m_halfbandCoeffs[s], c->halfband[s], &c->work[from][0], n, &c->work[1 - from][0]);
+        from = 1 - from;
+    }
+
+    const float *result = &c->work[from][0];
+    for (int i=0; i<n; ++i) {
+        pcm[i * numChannels + ch] = result[i];
+    }
+
+    *outFrames_return = n;
+}
+
+int
+WWDsdDecimator::Process(const unsigned char *dsd, int dsdBytesPerChannel, float *pcm)
+{
+    const int numChannels = (int)m_channels.size();
+    assert(0 < numChannels);
+
+    std::vector<int> outFrames(numChannels, 0);
+
+    if (numChannels == 1 || dsdBytesPerChannel < THREAD_MIN_BYTES_PER_CHANNEL) {
+        for (int ch=0; ch<numChannels; ++ch) {
+            ProcessChannel(ch, dsd, dsdBytesPerChannel, pcm, &outFrames[ch]);
+        }
+    } else {
+        // channel 0 runs on the calling thread
+        std::vector<std::thread> threads;
+        for (int ch=1; ch<numChannels; ++ch) {
+            threads.push_back(std::thread(&WWDsdDecimator::ProcessChannel, this,
+                    ch, dsd, dsdBytesPerChannel, pcm, &outFrames[ch]));
+        }
+        ProcessChannel(0, dsd, dsdBytesPerChannel, pcm, &outFrames[0]);
+        for (size_t i=0; i<threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+
+    for (int ch=1; ch<numChannels; ++ch) {
+        assert(outFrames[ch] == outFrames[0]);
+    }
+    return outFrames[0];
+}
+
+int
+WWDsdDecimationRatio(int dsdSampleRate, int pcmSampleRate)
+{
+    if (pcmSampleRate <= 0 || dsdSampleRate % pcmSampleRate != 0) {
+        return 0;
+    }
+
+    int decimation = dsdSampleRate / pcmSampleRate;
+    for (int d=DECIMATION_STAGE1; d<=DECIMATION_MAX; d *= 2) {
+        if (d == decimation) {
+            return decimation;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// Multi-stage DSD to PCM decimator.
+///
+///   stage 1  : FIR lowpass and decimation by 8. evaluated with a lookup table for each DSD byte of the filter window
+///   stage 2..: half-band FIR lowpass and decimation by 2 (SSE)
+///
+/// Filters are Kaiser windowed sinc designed on Init() for the decimation ratio.
+/// Passband is 0.45 * pcmSampleRate (90% of Nyquist frequency), stopband attenuation is 120dB.
+/// Each channel runs on its own thread when Process() is called with enough data.
+class WWDsdDecimator {
+public:
+    WWDsdDecimator(void);
+    ~WWDsdDecimator(void);
+
+    /// @param decimation dsdSampleRate / pcmSampleRate. 8, 16, 32, 64, 128 or 256
+    /// @return 0: success. negative: unsupported parameter
+    int Init(int decimation, int numChannels);
+    void Term(void);
+
+    /// clears filter history. next Process() starts from silence.
+    void Reset(void);
+
+    int Decimation(void) const { return m_decimation; }
+    int NumChannels(void) const { return (int)m_channels.size(); }
+
+    /// @return group delay of the filter cascade in PCM frames (rounded)
+    int DelayFrames(void) const { return m_delayFrames; }
+
+    /// @return upper bound of the frames returned by Process(dsd, dsdBytesPerChannel, pcm)
+    int MaxOutputFrames(int dsdBytesPerChannel) const;
+
+    /// @param dsd DSDIFF byte order: bytes are channel interleaved, most significant bit is the oldest bit in time.
+    ///            dsdBytesPerChannel * numChannels bytes
+    /// @param pcm channel interleaved float. DSD +1 / -1 corresponds to +1.0f / -1.0f.
+    ///            MaxOutputFrames(dsdBytesPerChannel) * numChannels floats
+    /// @return PCM frames written
+    int Process(const unsigned char *dsd, int dsdBytesPerChannel, float *pcm);
+
+private:
+    struct Channel;
+
+    int m_decimation;
+    int m_delayFrames;
+
+    /// stage 1 lookup table: m_lut[k*256 + b] is the partial sum of the filter output of DSD byte b located k bytes before the newest byte
+    std::vector<float> m_lut;
+    int m_lutBytes;
+
+    /// half-band stages. nonzero half of the even phase coefficients
+    std::vector<std::vector<float> > m_halfbandCoeffs;
+
+    std::vector<Channel*> m_channels;
+
+    void ProcessChannel(int ch, const unsigned char *dsd, int dsdBytesPerChannel, float *pcm, int *outFrames_return);
+};
+
+/// @return dsdSampleRate / pcmSampleRate if WWDsdDecimator supports the combination. 0 otherwise
+int WWDsdDecimationRatio(int dsdSampleRate, int pcmSampleRate);
@@ -0,0 +1,629 @@
+#include "WWDsdModulator.h"
+#include "WWFirDesign.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <complex>
+#include <algorithm>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_DSD_MODULATOR_USE_SSE
+#endif
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+/// upper edge of the band where the noise is pushed out of
+#define NOISE_BAND_HZ      (20000.0)
+
+/// maximum gain of the noise transfer function. larger value lowers in-band noise but the loop becomes less stable
+#define NTF_MAX_GAIN       (1.4)
+
+/// quantizer input larger than this means the loop is unstable
+#define UNSTABLE_THRESHOLD (8.0)
+
+/// interpolation filter: passband edge relative to the PCM sample rate and stopband attenuation
+#define PASSBAND_RATIO     (0.45)
+#define STOPBAND_ATTENUATION_DB (120.0)
+
+/// sample rate after the half-band stages
+#define INTERPOLATED_SAMPLE_RATE (352800)
+
+/// Process() splits channel pairs to threads when the input is larger than this
+#define THREAD_MIN_PCM_FRAMES (1024)
+
+#define ORDER_MIN          (5)
+#define ORDER_MAX          (7)
+#define SECTIONS_MAX       ((ORDER_MAX + 1) / 2)
+
+typedef std::complex<double> WWComplex;
+
+/// zeros of the Legendre polynomials. noise transfer function zeros normalized to the band edge
+/// which minimize the in-band noise power
+static const double gOptimalZeros5[] = { 0.0, 0.5384693101056831, 0.9061798459386640 };
+static const double gOptimalZeros6[] = { 0.2386191860831969, 0.6612093864662645, 0.9324695142031521 };
+static const double gOptimalZeros7[] = { 0.0, 0.4058451513773972, 0.7415311855993945, 0.9491079123427585 };
+
+struct HalfbandUpState {
+    /// 2M-1 history samples followed by new samples
+    std::vector<float> x;
+};
+
+struct WWDsdModulator::Channel {
+    std::vector<HalfbandUpState> halfband;
+
+    /// interpolation work area
+    std::vector<float> work[2];
+
+    /// output of the half-band stages
+    const float *interpolated;
+    int interpolatedCount;
+
+    /// last sample of the half-band stage output. start point of the linear interpolation
+    double last;
+
+    /// loop filter state
+    double s1[SECTIONS_MAX];
+    double s2[SECTIONS_MAX];
+
+    /// loop filter output for the next bit. kept so that the result does not depend on how the input is split
+    double r;
+
+    int64_t unstableCount;
+};
+
+///////////////////////////////////////////////////////////////////////
+// half-band interpolation by 2
+
+/// y[2t]   = 2 * sum_{j=0}^{M-1} g[j] * (x[t-j] + x[t-2M+1+j])
+/// y[2t+1] = x[t-M+1]
+static void
+HalfbandUpProcess(const std::vector<float> &g, HalfbandUpState &s, const float *in, int n, float *out)
+{
+    const int M    = (int)g.size();
+    const int hist = 2 * M - 1;
+
+    s.x.resize(hist + n);
+    float *X = &s.x[hist];
+    memcpy(X, in, n * sizeof(float));
+
+    for (int t=0; t<n; ++t) {
+        float acc = 0;
+        for (int j=0; j<M; ++j) {
+            acc += g[j] * (X[t - j] + X[t - hist + j]);
+        }
+        out[2 * t + 0] = 2.0f * acc;
+        out[2 * t + 1] = X[t - M + 1];
+    }
+
+    memmove(&s.x[0], &s.x[n], hist * sizeof(float));
+    s.x.resize(hist);
+}
+
+///////////////////////////////////////////////////////////////////////
+// loop filter
+
+/// NTF(z) = prod_k (1 + b1_k z^-1 + b2_k z^-2) / (1 + a1_k z^-1 + a2_k z^-2)
+/// Each section is transposed direct form II. Quantizer input is x + (NTF(z) - 1) e
+/// and the output of the first order term of every section sums up to (NTF(z) - 1) e.
+/// The part of the next state which does not depend on e is computed before e is known:
+///   s1_k' = (b1_k - a1_k) e + d1_k
+///   s2_k' = (b2_k - a2_k) e + d2_k
+/// where P_k = sum_{i<k} s1_i, d1_k = b1_k P_k - a1_k (P_k + s1_k) + s2_k, d2_k = b2_k P_k - a2_k (P_k + s1_k)
+
+void
+WWDsdModulator::DesignNtf(int dsdSampleRate)
+{
+    const double *optZeros = nullptr;
+    int nOptZeros = 0;
+    switch (m_order) {
+    case 5: optZeros = gOptimalZeros5; nOptZeros = (int)(sizeof gOptimalZeros5 / sizeof gOptimalZeros5[0]); break;
+    case 6: optZeros = gOptimalZeros6; nOptZeros = (int)(sizeof gOptimalZeros6 / sizeof gOptimalZeros6[0]); break;
+    case 7: optZeros = gOptimalZeros7; nOptZeros = (int)(sizeof gOptimalZeros7 / sizeof gOptimalZeros7[0]); break;
+    default: assert(0); return;
+    }
+
+    const double bandEdge = 2.0 * M_PI * NOISE_BAND_HZ / dsdSampleRate;
+
+    // zero angles. 0 is a real zero at z=1, others are complex conjugate pairs
+    std::vector<double> zeroAngles;
+    for (int i=0; i<nOptZeros; ++i) {
+        zeroAngles.push_back(optZeros[i] * bandEdge);
+    }
+
+    // poles: Butterworth lowpass of the cutoff wc, bilinear transformed.
+    // wc is searched so that the NTF gain at the Nyquist frequency is NTF_MAX_GAIN
+    std::vector<WWComplex> poles(m_order);
+    double lo = 1e-6;
+    double hi = M_PI - 1e-6;
+    for (int iter=0; iter<100; ++iter) {
+        const double wc = (lo + hi) * 0.5;
+        const double omegaC = 2.0 * tan(wc * 0.5);
+
+        for (int k=0; k<m_order; ++k) {
+            WWComplex s = std::polar(omegaC, M_PI * (2 * k + m_order + 1) / (2.0 * m_order));
+            poles[k] = (2.0 + s) / (2.0 - s);
+        }
+
+        // |NTF(-1)|
+        double gain = 1.0;
+        for (size_t i=0; i<zeroAngles.size(); ++i) {
+            WWComplex z = std::polar(1.0, zeroAngles[i]);
+            gain *= std::abs(-1.0 - z);
+            if (zeroAngles[i] != 0) {
+                gain *= std::abs(-1.0 - std::conj(z));
+            }
+        }
+        for (int k=0; k<m_order; ++k) {
+            gain /= std::abs(-1.0 - poles[k]);
+        }
+
+        if (gain < NTF_MAX_GAIN) {
+            lo = wc;
+        } else {
+            hi = wc;
+        }
+    }
+
+    // pick one pole of each conjugate pair and the real pole
+    std::vector<WWComplex> pairPoles;
+    double realPole = 0;
+    for (int k=0; k<m_order; ++k) {
+        if (1e-12 < poles[k].imag()) {
+            pairPoles.push_back(poles[k]);
+        } else if (fabs(poles[k].imag()) <= 1e-12) {
+            realPole = poles[k].real();
+        }
+    }
+
+    m_sections.clear();
+    int pairIdx = 0;
+    for (size_t i=0; i<zeroAngles.size(); ++i) {
+        Section sec;
+        if (zeroAngles[i] == 0) {
+            // first order section: zero at z=1 and the real pole
+            sec.b1 = -1.0;
+            sec.b2 = 0;
+            sec.a1 = -realPole;
+            sec.a2 = 0;
+        } else {
+            const WWComplex &p = pairPoles[pairIdx++];
+            sec.b1 = -2.0 * cos(zeroAngles[i]);
+            sec.b2 = 1.0;
+            sec.a1 = -2.0 * p.real();
+            sec.a2 = std::norm(p);
+        }
+        m_sections.push_back(sec);
+    }
+    assert(pairIdx == (int)pairPoles.size());
+}
+
+///////////////////////////////////////////////////////////////////////
+// WWDsdModulator
+
+WWDsdModulator::WWDsdModulator(void)
+    : m_order(0), m_numChannels(0), m_upsample(0), m_linearUpsample(0), m_delayFrames(0), m_inputGain(0.5)
+{
+}
+
+WWDsdModulator::~WWDsdModulator(void)
+{
+    Term();
+}
+
+int
+WWDsdModulator::Init(int order, int pcmSampleRate, int dsdSampleRate, int numChannels)
+{
+    int halfbandStages = 0;
+
+    assert(m_channels.empty());
+
+    if (order < ORDER_MIN || ORDER_MAX < order || numChannels <= 0) {
+        return -1;
+    }
+
+    switch (pcmSampleRate) {
+    case 44100:  halfbandStages = 3; break;
+    case 88200:  halfbandStages = 2; break;
+    case 176400: halfbandStages = 1; break;
+    case 352800: halfbandStages = 0; break;
+    default:
+        return -1;
+    }
+
+    switch (dsdSampleRate) {
+    case 2822400:
+    case 5644800:
+    case 11289600:
+        break;
+    default:
+        return -1;
+    }
+
+    m_order          = order;
+    m_numChannels    = numChannels;
+    m_upsample       = dsdSampleRate / pcmSampleRate;
+    m_linearUpsample = dsdSampleRate / INTERPOLATED_SAMPLE_RATE;
+
+    DesignNtf(dsdSampleRate);
+
+    // half-band stages. frequencies are normalized to the PCM sample rate
+    m_halfbandCoeffs.resize(halfbandStages);
+    for (int s=0; s<halfbandStages; ++s) {
+        // output sample rate of the stage
+        const double fout = (double)(2 << s);
+        std::vector<double> g;
+        WWDesignHalfband(STOPBAND_ATTENUATION_DB, (fout * 0.5 - 2.0 * PASSBAND_RATIO) / fout, g);
+        m_halfbandCoeffs[s].resize(g.size());
+        for (size_t j=0; j<g.size(); ++j) {
+            m_halfbandCoeffs[s][j] = (float)g[j];
+        }
+    }
+
+    // delay in PCM frames: (2M-1)/2 input samples of each half-band stage and 1 sample of the linear interpolation
+    {
+        double delay = 0;
+        for (int s=0; s<halfbandStages; ++s) {
+            const int M = (int)m_halfbandCoeffs[s].size();
+            delay += (2 * M - 1) * 0.5 / (1 << s);
+        }
+        delay += 1.0 / (1 << halfbandStages);
+        m_delayFrames = (int)(delay + 0.5);
+    }
+
+    m_channels.resize(numChannels);
+    for (int ch=0; ch<numChannels; ++ch) {
+        m_channels[ch] = new Channel();
+        m_channels[ch]->halfband.resize(halfbandStages);
+    }
+
+    Reset();
+    return 0;
+}
+
+void
+WWDsdModulator::Term(void)
+{
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        delete m_channels[ch];
+        m_channels[ch] = nullptr;
+    }
+    m_channels.clear();
+
+    m_sections.clear();
+    m_halfbandCoeffs.clear();
+    m_order          = 0;
+    m_numChannels    = 0;
+    m_upsample       = 0;
+    m_linearUpsample = 0;
+    m_delayFrames    = 0;
+}
+
+void
+WWDsdModulator::Reset(void)
+{
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        Channel *c = m_channels[ch];
+
+        for (size_t s=0; s<c->halfband.size(); ++s) {
+            const int M = (int)m_halfbandCoeffs[s].size();
+            c->halfband[s].x.assign(2 * M - 1, 0.0f);
+        }
+
+        c->interpolated      = nullptr;
+        c->interpolatedCount = 0;
+        c->last              = 0;
+        c->r                 = 0;
+        for (int k=0; k<SECTIONS_MAX; ++k) {
+            c->s1[k] = 0;
+            c->s2[k] = 0;
+        }
+        c->unstableCount = 0;
+    }
+}
+
+int64_t
+WWDsdModulator::UnstableCount(void) const
+{
+    int64_t count = 0;
+    for (size_t ch=0; ch<m_channels.size(); ++ch) {
+        count += m_channels[ch]->unstableCount;
+    }
+    return count;
+}
+
+void
+WWDsdModulator::Interpolate(int ch, const float *pcm, int pcmFrames)
+{
+    Channel *c = m_channels[ch];
+    const int stages = (int)c->halfband.size();
+
+    c->work[0].resize(pcmFrames << stages);
+    c->work[1].resize(pcmFrames << stages);
+
+    float *in = &c->work[0][0];
+    for (int i=0; i<pcmFrames; ++i) {
+        in[i] = (float)(pcm[i * m_numChannels + ch] * m_inputGain);
+    }
+
+    int n = pcmFrames;
+    int from = 0;
+    for (int s=0; s<stages; ++s) {
+        HalfbandUpProcess(m_halfbandCoeffs[s], c->halfband[s], &c->work[from][0], n, &c->work[1 - from][0]);
+        n *= 2;
+        from = 1 - from;
+    }
+
+    c->interpolated      = &c->work[from][0];
+    c->interpolatedCount = n;
+}
+
+void
+WWDsdModulator::ModulateScalar(int ch, unsigned char *dsd_return)
+{
+    Channel *c = m_channels[ch];
+    const int ns = (int)m_sections.size();
+    const int bytesPerSample = m_linearUpsample / 8;
+    const double stepScale = 1.0 / m_linearUpsample;
+
+    double c1[SECTIONS_MAX];
+    double c2[SECTIONS_MAX];
+    double c1Sum = 0;
+    for (int k=0; k<ns; ++k) {
+        c1[k] = m_sections[k].b1 - m_sections[k].a1;
+        c2[k] = m_sections[k].b2 - m_sections[k].a2;
+        c1Sum += c1[k];
+    }
+
+    double *s1 = c->s1;
+    double *s2 = c->s2;
+    double r = c->r;
+
+    int pos = 0;
+    for (int i=0; i<c->interpolatedCount; ++i) {
+        const double target = c->interpolated[i];
+        const double step   = (target - c->last) * stepScale;
+        double x = c->last;
+
+        for (int b=0; b<bytesPerSample; ++b) {
+            int byte = 0;
+            double maxU = 0;
+
+            for (int q=0; q<8; ++q) {
+                const double u = x + r;
+                const double v = (0 <= u) ? 1.0 : -1.0;
+                const double e = v - u;
+                byte = (byte << 1) | (0 <= u);
+                maxU = std::max(maxU, fabs(u));
+
+                double P = 0;
+                double dSum = 0;
+                for (int k=0; k<ns; ++k) {
+                    const Section &sec = m_sections[k];
+                    const double d1 = sec.b1 * P - sec.a1 * (P + s1[k]) + s2[k];
+                    const double d2 = sec.b2 * P - sec.a2 * (P + s1[k]);
+                    P += s1[k];
+                    s1[k] = c1[k] * e + d1;
+                    s2[k] = c2[k] * e + d2;
+                    dSum += d1;
+                }
+                r = c1Sum * e + dSum;
+                x += step;
+            }
+
+            dsd_return[(pos++) * m_numChannels + ch] = (unsigned char)byte;
+
+            if (UNSTABLE_THRESHOLD < maxU) {
+                for (int k=0; k<ns; ++k) {
+                    s1[k] = 0;
+                    s2[k] = 0;
+                }
+                r = 0;
+                ++c->unstableCount;
+            }
+        }
+
+        c->last = target;
+    }
+
+    c->r = r;
+}
+
+#ifdef WW_DSD_MODULATOR_USE_SSE
+
+/// modulates 2 channels. lane 0 is channel ch and lane 1 is ch+1
+template <int NS>
+static void
+ModulatePairSse(const double *b1, const double *b2, const double *a1, const double *a2,
+        const float *in0, const float *in1, int n, int linearUpsample,
+        double *last, double *rState, double *s1_0, double *s2_0, double *s1_1, double *s2_1, int64_t *unstableCount,
+        unsigned char *out, int stride)
+{
+    const __m128d signMask  = _mm_set1_pd(-0.0);
+    const __m128d one       = _mm_set1_pd(1.0);
+    const __m128d threshold = _mm_set1_pd(UNSTABLE_THRESHOLD);
+    const __m128d stepScale = _mm_set1_pd(1.0 / linearUpsample);
+    const int bytesPerSample = linearUpsample / 8;
+
+    __m128d B1[NS], B2[NS], A1[NS], A2[NS], C1[NS], C2[NS];
+    __m128d S1[NS], S2[NS];
+    __m128d C1Sum = _mm_setzero_pd();
+    __m128d r     = _mm_loadu_pd(rState);
+    for (int k=0; k<NS; ++k) {
+        B1[k] = _mm_set1_pd(b1[k]);
+        B2[k] = _mm_set1_pd(b2[k]);
+        A1[k] = _mm_set1_pd(a1[k]);
+        A2[k] = _mm_set1_pd(a2[k]);
+        C1[k] = _mm_sub_pd(B1[k], A1[k]);
+        C2[k] = _mm_sub_pd(B2[k], A2[k]);
+        C1Sum = _mm_add_pd(C1Sum, C1[k]);
+
+        S1[k] = _mm_set_pd(s1_1[k], s1_0[k]);
+        S2[k] = _mm_set_pd(s2_1[k], s2_0[k]);
+    }
+
+    __m128d prev = _mm_loadu_pd(last);
+    int pos = 0;
+
+    for (int i=0; i<n; ++i) {
+        const __m128d target = _mm_set_pd(in1[i], in0[i]);
+        const __m128d step   = _mm_mul_pd(_mm_sub_pd(target, prev), stepScale);
+        __m128d x = prev;
+
+        for (int b=0; b<bytesPerSample; ++b) {
+            int byte0 = 0;
+            int byte1 = 0;
+            __m128d maxU = _mm_setzero_pd();
+
+            for (int q=0; q<8; ++q) {
+                const __m128d u = _mm_add_pd(x, r);
+
+                // v = copysign(1, u)
+                const __m128d v = _mm_or_pd(_mm_and_pd(u, signMask), one);
+                const __m128d e = _mm_sub_pd(v, u);
+
+                const int negative = _mm_movemask_pd(u);
+                byte0 = (byte0 << 1) | (~negative & 1);
+                byte1 = (byte1 << 1) | ((~negative >> 1) & 1);
+                maxU = _mm_max_pd(maxU, _mm_andnot_pd(signMask, u));
+
+                __m128d P    = _mm_setzero_pd();
+                __m128d dSum = _mm_setzero_pd();
+                for (int k=0; k<NS; ++k) {
+                    const __m128d PS1 = _mm_add_pd(P, S1[k]);
+                    const __m128d d1  = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(B1[k], P), _mm_mul_pd(A1[k], PS1)), S2[k]);
+                    const __m128d d2  = _mm_sub_pd(_mm_mul_pd(B2[k], P), _mm_mul_pd(A2[k], PS1));
+                    P = PS1;
+                    S1[k] = _mm_add_pd(_mm_mul_pd(C1[k], e), d1);
+                    S2[k] = _mm_add_pd(_mm_mul_pd(C2[k], e), d2);
+                    dSum = _mm_add_pd(dSum, d1);
+                }
+                r = _mm_add_pd(_mm_mul_pd(C1Sum, e), dSum);
+                x = _mm_add_pd(x, step);
+            }
+
+            out[pos * stride + 0] = (unsigned char)byte0;
+            out[pos * stride + 1] = (unsigned char)byte1;
+            ++pos;
+
+            const __m128d unstable = _mm_cmpgt_pd(maxU, threshold);
+            const int unstableMask = _mm_movemask_pd(unstable);
+            if (unstableMask) {
+                // clears the state of the unstable lane
+                for (int k=0; k<NS; ++k) {
+                    S1[k] = _mm_andnot_pd(unstable, S1[k]);
+                    S2[k] = _mm_andnot_pd(unstable, S2[k]);
+                }
+                r = _mm_andnot_pd(unstable, r);
+                unstableCount[0] += unstableMask & 1;
+                unstableCount[1] += (unstableMask >> 1) & 1;
+            }
+        }
+
+        prev = target;
+    }
+
+    _mm_storeu_pd(last, prev);
+    _mm_storeu_pd(rState, r);
+    for (int k=0; k<NS; ++k) {
+        double t[2];
+        _mm_storeu_pd(t, S1[k]);
+        s1_0[k] = t[0];
+        s1_1[k] = t[1];
+        _mm_storeu_pd(t, S2[k]);
+        s2_0[k] = t[0];
+        s2_1[k] = t[1];
+    }
+}
+
+#endif /* WW_DSD_MODULATOR_USE_SSE */
+
+void
+WWDsdModulator::ModulatePair(int ch, unsigned char *dsd_return)
+{
+#ifdef WW_DSD_MODULATOR_USE_SSE
+    Channel *c0 = m_channels[ch];
+    Channel *c1 = m_channels[ch + 1];
+    const int ns = (int)m_sections.size();
+    assert(c0->interpolatedCount == c1->interpolatedCount);
+
+    double b1[SECTIONS_MAX], b2[SECTIONS_MAX], a1[SECTIONS_MAX], a2[SECTIONS_MAX];
+    for (int k=0; k<ns; ++k) {
+        b1[k] = m_sections[k].b1;
+        b2[k] = m_sections[k].b2;
+        a1[k] = m_sections[k].a1;
+        a2[k] = m_sections[k].a2;
+    }
+
+    double last[2] = { c0->last, c1->last };
+    double r[2]    = { c0->r, c1->r };
+    int64_t unstableCount[2] = { 0, 0 };
+
+    switch (ns) {
+    case 3:
+        ModulatePairSse<3>(b1, b2, a1, a2, c0->interpolated, c1->interpolated, c0->interpolatedCount, m_linearUpsample,
+                last, r, c0->s1, c0->s2, c1->s1, c1->s2, unstableCount, &dsd_return[ch], m_numChannels);
+        break;
+    case 4:
+        ModulatePairSse<4>(b1, b2, a1, a2, c0->interpolated, c1->interpolated, c0->interpolatedCount, m_linearUpsample,
+                last, r, c0->s1, c0->s2, c1->s1, c1->s2, unstableCount, &dsd_return[ch], m_numChannels);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+
+    c0->last = last[0];
+    c1->last = last[1];
+    c0->r    = r[0];
+    c1->r    = r[1];
+    c0->unstableCount += unstableCount[0];
+    c1->unstableCount += unstableCount[1];
+#else
+    ModulateScalar(ch,     dsd_return);
+    ModulateScalar(ch + 1, dsd_return);
+#endif /* WW_DSD_MODULATOR_USE_SSE */
+}
+
+void
+WWDsdModulator::ProcessPair(int ch, const float *pcm, int pcmFrames, unsigned char *dsd_return)
+{
+    Interpolate(ch, pcm, pcmFrames);
+
+    if (ch + 1 < m_numChannels) {
+        Interpolate(ch + 1, pcm, pcmFrames);
+        ModulatePair(ch, dsd_return);
+    } else {
+        ModulateScalar(ch, dsd_return);
+    }
+}
+
+int
+WWDsdModulator::Process(const float *pcm, int pcmFrames, unsigned char *dsd_return)
+{
+    assert(0 < m_numChannels);
+
+    const int numPairs = (m_numChannels + 1) / 2;
+
+    if (numPairs == 1 || pcmFrames < THREAD_MIN_PCM_FRAMES) {
+        for (int ch=0; ch<m_numChannels; ch += 2) {
+            ProcessPair(ch, pcm, pcmFrames, dsd_return);
+        }
+    } else {
+        // channel 0 and 1 run on the calling thread
+        std::vector<std::thread> threads;
+        for (int ch=2; ch<m_numChannels; ch += 2) {
+            threads.push_back(std::thread(&WWDsdModulator::ProcessPair, this,
+                    ch, pcm, pcmFrames, dsd_return));
+        }
+        ProcessPair(0, pcm, pcmFrames, dsd_return);
+        for (size_t i=0; i<threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+
+    return pcmFrames * m_upsample / 8;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// PCM to 1-bit DSD converter.
+///
+///   PCM is upsampled by half-band FIR stages to 352.8kHz, then linearly interpolated to the DSD sample rate
+///   and fed to a 5th to 7th order sigma-delta modulator.
+///
+/// Noise transfer function has optimized zeros spread over 0 to 20kHz (scaled with DSD64 as a reference)
+/// and Butterworth poles which limit the out-of-band gain to 1.4.
+/// The loop filter is a cascade of biquads. Two channels are modulated at once with SSE2 double precision
+/// and channel pairs run on separate threads.
+/// When the loop becomes unstable, the filter state of the channel is reset (counted by UnstableCount()).
+class WWDsdModulator {
+public:
+    WWDsdModulator(void);
+    ~WWDsdModulator(void);
+
+    /// @param order         5, 6 or 7
+    /// @param pcmSampleRate 44100, 88200, 176400 or 352800
+    /// @param dsdSampleRate 2822400 (DSD64), 5644800 (DSD128) or 11289600 (DSD256)
+    /// @return 0: success. negative: unsupported parameter
+    int Init(int order, int pcmSampleRate, int dsdSampleRate, int numChannels);
+    void Term(void);
+
+    /// clears filter history
+    void Reset(void);
+
+    /// PCM full scale 1.0f is multiplied by this value and fed to the modulator.
+    /// default is 0.5: PCM full scale becomes 50% modulation (SACD 0dB)
+    void SetInputGain(double gain) { m_inputGain = gain; }
+
+    int NumChannels(void) const { return m_numChannels; }
+
+    /// @return dsdSampleRate / pcmSampleRate
+    int Upsample(void) const { return m_upsample; }
+
+    /// @return delay of the interpolation filters in PCM frames (rounded)
+    int DelayFrames(void) const { return m_delayFrames; }
+
+    /// @return number of times the modulator state was reset because the loop became unstable
+    int64_t UnstableCount(void) const;
+
+    /// @param pcm channel interleaved float. pcmFrames * numChannels floats
+    /// @param dsd_return DSDIFF byte order: channel interleaved bytes, most significant bit is the oldest bit in time.
+    ///                   pcmFrames * Upsample() / 8 * numChannels bytes
+    /// @return DSD bytes per channel written
+    int Process(const float *pcm, int pcmFrames, unsigned char *dsd_return);
+
+private:
+    struct Section {
+        // b0 = a0 = 1
+        double b1, b2;
+        double a1, a2;
+    };
+
+    struct Channel;
+
+    int m_order;
+    int m_numChannels;
+    int m_upsample;
+
+    /// linear interpolation factor after the half-band stages. multiple of 8
+    int m_linearUpsample;
+    int m_delayFrames;
+    double m_inputGain;
+
+    std::vector<Section> m_sections;
+    /// half-band stages. nonzero half of the odd phase coefficients
+    std::vector<std::vector<float> > m_halfbandCoeffs;
+    std::vector<Channel*> m_channels;
+
+    void DesignNtf(int dsdSampleRate);
+    void Interpolate(int ch, const float *pcm, int pcmFrames);
+    void ModulateScalar(int ch, unsigned char *dsd_return);
+    void ModulatePair(int ch, unsigned char *dsd_return);
+    void ProcessPair(int ch, const float *pcm, int pcmFrames, unsigned char *dsd_return);
+};
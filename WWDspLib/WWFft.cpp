@@ -0,0 +1,518 @@
+#include "WWFft.h"
+#include <assert.h>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_FFT_USE_SSE
+#endif
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+WWRealFft::WWRealFft(void)
+    : m_n(0)
+{
+}
+
+WWRealFft::~WWRealFft(void)
+{
+    Term();
+}
+
+int
+WWRealFft::Init(int n)
+{
+    if (n < 4 || (n & (n - 1)) != 0) {
+        return -1;
+    }
+
+    m_n = n;
+    const int K = n / 2;
+
+    int log2K = 0;
+    while ((1 << log2K) < K) {
+        ++log2K;
+    }
+
+    m_bitReverse.resize(K);
+    for (int i=0; i<K; ++i) {
+        int r = 0;
+        for (int b=0; b<log2K; ++b) {
+            r |= ((i >> b) & 1) << (log2K - 1 - b);
+        }
+        m_bitReverse[i] = r;
+    }
+
+    // twiddle factors are computed in double precision to keep the round-off error of long FFTs small
+    m_twiddleRe.resize(K);
+    m_twiddleIm.resize(K);
+    for (int half=1; half<K; half *= 2) {
+        for (int j=0; j<half; ++j) {
+            const double theta = -M_PI * j / half;
+            m_twiddleRe[half + j] = (float)cos(theta);
+            m_twiddleIm[half + j] = (float)sin(theta);
+        }
+    }
+
+    m_splitTwiddle.resize((K + 1) * 2);
+    for (int k=0; k<=K; ++k) {
+        const double theta = -2.0 * M_PI * k / n;
+        m_splitTwiddle[k*2+0] = (float)cos(theta);
+        m_splitTwiddle[k*2+1] = (float)sin(theta);
+    }
+
+    m_workRe.resize(K);
+    m_workIm.resize(K);
+    return 0;
+}
+
+void
+WWRealFft::Term(void)
+{
+    m_bitReverse.clear();
+    m_twiddleRe.clear();
+    m_twiddleIm.clear();
+    m_splitTwiddle.clear();
+    m_workRe.clear();
+    m_workIm.clear();
+    m_n = 0;
+}
+
+void
+WWRealFft::ComplexFft(float *re, float *im, bool inverse)
+{
+    const int K = m_n / 2;
+
+    // the first two butterfly stages have the trivial twiddle factors 1 and -i (i for the inverse)
+    for (int s=0; s+1<K; s += 2) {
+        const float ar = re[s], ai = im[s], br = re[s+1], bi = im[s+1];
+        re[s] = ar + br; im[s] = ai + bi;
+        re[s+1] = ar - br; im[s+1] = ai - bi;
+    }
+    for (int s=0; s+3<K; s += 4) {
+        float tr = re[s+2], ti = im[s+2];
+        re[s+2] = re[s] - tr; im[s+2] = im[s] - ti;
+        re[s]  += tr;         im[s]  += ti;
+
+        if (inverse) {
+            tr = -im[s+3]; ti =  re[s+3];
+        } else {
+            tr =  im[s+3]; ti = -re[s+3];
+        }
+        re[s+3] = re[s+1] - tr; im[s+3] = im[s+1] - ti;
+        re[s+1] += tr;          im[s+1] += ti;
+    }
+
+    const float sign = inverse ? -1.0f : 1.0f;
+
+    for (int half=4; half<K; half *= 2) {
+        const float *wRe = &m_twiddleRe[half];
+        const float *wIm = &m_twiddleIm[half];
+
+        for (int start=0; start<K; start += half * 2) {
+            float *aRe = &re[start];
+            float *aIm = &im[start];
+            float *bRe = &re[start + half];
+            float *bIm = &im[start + half];
+
+#ifdef WW_FFT_USE_SSE
+            const __m128 sign4 = _mm_set1_ps(sign);
+            for (int j=0; j<half; j += 4) {
+                const __m128 wr = _mm_loadu_ps(&wRe[j]);
+                const __m128 wi = _mm_mul_ps(_mm_loadu_ps(&wIm[j]), sign4);
+                const __m128 br = _mm_loadu_ps(&bRe[j]);
+                const __m128 bi = _mm_loadu_ps(&bIm[j]);
+                const __m128 ar = _mm_loadu_ps(&aRe[j]);
+                const __m128 ai = _mm_loadu_ps(&aIm[j]);
+
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+
+                _mm_storeu_ps(&bRe[j], _mm_sub_ps(ar, tr));
+                _mm_storeu_ps(&bIm[j], _mm_sub_ps(ai, ti));
+                _mm_storeu_ps(&aRe[j], _mm_add_ps(ar, tr));
+                _mm_storeu_ps(&aIm[j], _mm_add_ps(ai, ti));
+            }
+#else
+            for (int j=0; j<half; ++j) {
+                const float wr = wRe[j];
+                const float wi = wIm[j] * sign;
+
+                const float tr = bRe[j] * wr - bIm[j] * wi;
+                const float ti = bRe[j] * wi + bIm[j] * wr;
+                bRe[j] = aRe[j] - tr;
+                bIm[j] = aIm[j] - ti;
+                aRe[j] += tr;
+                aIm[j] += ti;
+            }
+#endif
+        }
+    }
+}
+
+/// z[n] = x[2n] + i x[2n+1], Z = FFT(z) of N/2 points
+/// X[k] = E[k] + W^k O[k], E[k] = (Z[k] + conj(Z[N/2-k])) / 2, O[k] = (Z[k] - conj(Z[N/2-k])) / 2i
+void
+WWRealFft::Forward(const float *in, float *re_return, float *im_return)
+{
+    const int K = m_n / 2;
+    float *zRe = &m_workRe[0];
+    float *zIm = &m_workIm[0];
+
+    for (int i=0; i<K; ++i) {
+        const int r = m_bitReverse[i];
+        zRe[r] = in[i*2+0];
+        zIm[r] = in[i*2+1];
+    }
+    ComplexFft(zRe, zIm, false);
+
+    for (int k=0; k<=K; ++k) {
+        const int k0 = (k == K) ? 0 : k;
+        const int k1 = (k == 0) ? 0 : K - k;
+
+        const float ar =  zRe[k0];
+        const float ai =  zIm[k0];
+        const float br =  zRe[k1];
+        const float bi = -zIm[k1];
+
+        const float er = 0.5f * (ar + br);
+        const float ei = 0.5f * (ai + bi);
+
+        // (a - b) / 2i
+        const float or_ =  0.5f * (ai - bi);
+        const float oi  = -0.5f * (ar - br);
+
+        const float wr = m_splitTwiddle[k*2+0];
+        const float wi = m_splitTwiddle[k*2+1];
+
+        re_return[k] = er + or_ * wr - oi * wi;
+        im_return[k] = ei + or_ * wi + oi * wr;
+    }
+}
+
+/// Z[k] = (X[k] + conj(X[N/2-k])) + i W^-k (X[k] - conj(X[N/2-k])), z = IFFT(Z) gives N x
+void
+WWRealFft::Inverse(const float *re, const float *im, float *out_return)
+{
+    const int K = m_n / 2;
+    float *zRe = &m_workRe[0];
+    float *zIm = &m_workIm[0];
+
+    for (int k=0; k<K; ++k) {
+        const int k1 = K - k;
+
+        const float ar = re[k];
+        const float ai = (k == 0) ? 0.0f : im[k];
+        const float br = re[k1];
+        const float bi = (k == 0) ? 0.0f : -im[k1];
+
+        const float er = ar + br;
+        const float ei = ai + bi;
+
+        // (a - b) * conj(W^k)
+        const float dr = ar - br;
+        const float di = ai - bi;
+        const float wr =  m_splitTwiddle[k*2+0];
+        const float wi = -m_splitTwiddle[k*2+1];
+        const float or_ = dr * wr - di * wi;
+        const float oi  = dr * wi + di * wr;
+
+        // E + i O
+        const int r = m_bitReverse[k];
+        zRe[r] = er - oi;
+        zIm[r] = ei + or_;
+    }
+
+    ComplexFft(zRe, zIm, true);
+
+    for (int i=0; i<K; ++i) {
+        out_return[i*2+0] = zRe[i];
+        out_return[i*2+1] = zIm[i];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// WWRealFftD
+
+/// complex elements of the block of ComplexFft(). 2 * 16 bytes * FFTD_BLOCK fits in L2 cache
+#define FFTD_BLOCK (4096)
+
+/// the bit reversal permutation is done by tiles of 2^FFTD_TILE_BITS x 2^FFTD_TILE_BITS elements
+#define FFTD_TILE_BITS (4)
+
+WWRealFftD::WWRealFftD(void)
+    : m_n(0), m_log2K(0)
+{
+}
+
+WWRealFftD::~WWRealFftD(void)
+{
+    Term();
+}
+
+int
+WWRealFftD::Init(int n)
+{
+    if (n < 4 || (n & (n - 1)) != 0) {
+        return -1;
+    }
+
+    m_n = n;
+    const int K = n / 2;
+
+    int log2K = 0;
+    while ((1 << log2K) < K) {
+        ++log2K;
+    }
+
+    m_log2K = log2K;
+    m_bitReverse.resize(K);
+    for (int i=0; i<K; ++i) {
+        int r = 0;
+        for (int b=0; b<log2K; ++b) {
+            r |= ((i >> b) & 1) << (log2K - 1 - b);
+        }
+        m_bitReverse[i] = r;
+    }
+
+    m_twiddleRe.resize(K);
+    m_twiddleIm.resize(K);
+    for (int half=1; half<K; half *= 2) {
+        for (int j=0; j<half; ++j) {
+            const double theta = -M_PI * j / half;
+            m_twiddleRe[half + j] = cos(theta);
+            m_twiddleIm[half + j] = sin(theta);
+        }
+    }
+
+    m_splitTwiddle.resize((K + 1) * 2);
+    for (int k=0; k<=K; ++k) {
+        const double theta = -2.0 * M_PI * k / n;
+        m_splitTwiddle[k*2+0] = cos(theta);
+        m_splitTwiddle[k*2+1] = sin(theta);
+    }
+
+    m_workRe.resize(K);
+    m_workIm.resize(K);
+    m_tmpRe.resize(K);
+    m_tmpIm.resize(K);
+    return 0;
+}
+
+void
+WWRealFftD::Term(void)
+{
+    m_bitReverse.clear();
+    m_twiddleRe.clear();
+    m_twiddleIm.clear();
+    m_splitTwiddle.clear();
+    m_workRe.clear();
+    m_workIm.clear();
+    m_tmpRe.clear();
+    m_tmpIm.clear();
+    m_n = 0;
+    m_log2K = 0;
+}
+
+/// dst[bitreverse(i)] = src[i * srcStride].
+/// the index is split into the high, middle and low bits. the high and the low bits of a tile are swapped through
+/// the tile buffer, so both of src and dst are accessed by runs of 2^FFTD_TILE_BITS elements instead of the scatter
+void
+WWRealFftD::BitReverse(const double *srcRe, const double *srcIm, int srcStride, double *dstRe, double *dstIm)
+{
+    const int K = m_n / 2;
+    const int T = 1 << FFTD_TILE_BITS;
+
+    if (m_log2K < FFTD_TILE_BITS * 2) {
+        for (int i=0; i<K; ++i) {
+            const int r = m_bitReverse[i];
+            dstRe[r] = srcRe[i * srcStride];
+            dstIm[r] = srcIm[i * srcStride];
+        }
+        return;
+    }
+
+    const int hiShift = m_log2K - FFTD_TILE_BITS;
+    const int numMid = 1 << (m_log2K - FFTD_TILE_BITS * 2);
+    double tileRe[T * T];
+    double tileIm[T * T];
+
+    for (int mid=0; mid<numMid; ++mid) {
+        for (int hi=0; hi<T; ++hi) {
+            const int from = (hi << hiShift) | (mid << FFTD_TILE_BITS);
+            for (int lo=0; lo<T; ++lo) {
+                tileRe[lo * T + hi] = srcRe[(size_t)(from | lo) * srcStride];
+                tileIm[lo * T + hi] = srcIm[(size_t)(from | lo) * srcStride];
+            }
+        }
+
+        const int rMid = m_bitReverse[mid << FFTD_TILE_BITS];
+        for (int lo=0; lo<T; ++lo) {
+            const int to = m_bitReverse[lo] | rMid;
+            for (int hi=0; hi<T; ++hi) {
+                const int r = to | m_bitReverse[hi << hiShift];
+                dstRe[r] = tileRe[lo * T + hi];
+                dstIm[r] = tileIm[lo * T + hi];
+            }
+        }
+    }
+}
+
+/// butterflies of the stages of the span 2*half, halfBegin <= half < halfEnd, on the elements [begin, end)
+void
+WWRealFftD::Stages(double *re, double *im, int begin, int end, int halfBegin, int halfEnd, bool inverse)
+{
+    if (halfBegin == 1) {
+        for (int s=begin; s+1<end; s += 2) {
+            const double ar = re[s], ai = im[s], br = re[s+1], bi = im[s+1];
+            re[s] = ar + br; im[s] = ai + bi;
+            re[s+1] = ar - br; im[s+1] = ai - bi;
+        }
+        for (int s=begin; s+3<end; s += 4) {
+            double tr = re[s+2], ti = im[s+2];
+            re[s+2] = re[s] - tr; im[s+2] = im[s] - ti;
+            re[s]  += tr;         im[s]  += ti;
+
+            if (inverse) {
+                tr = -im[s+3]; ti =  re[s+3];
+            } else {
+                tr =  im[s+3]; ti = -re[s+3];
+            }
+            re[s+3] = re[s+1] - tr; im[s+3] = im[s+1] - ti;
+            re[s+1] += tr;          im[s+1] += ti;
+        }
+        halfBegin = 4;
+    }
+
+    const double sign = inverse ? -1.0 : 1.0;
+
+    for (int half=halfBegin; half<halfEnd; half *= 2) {
+        const double *wRe = &m_twiddleRe[half];
+        const double *wIm = &m_twiddleIm[half];
+
+        for (int start=begin; start<end; start += half * 2) {
+            double *aRe = &re[start];
+            double *aIm = &im[start];
+            double *bRe = &re[start + half];
+            double *bIm = &im[start + half];
+
+#ifdef WW_FFT_USE_SSE
+            const __m128d sign2 = _mm_set1_pd(sign);
+            for (int j=0; j<half; j += 2) {
+                const __m128d wr = _mm_loadu_pd(&wRe[j]);
+                const __m128d wi = _mm_mul_pd(_mm_loadu_pd(&wIm[j]), sign2);
+                const __m128d br = _mm_loadu_pd(&bRe[j]);
+                const __m128d bi = _mm_loadu_pd(&bIm[j]);
+                const __m128d ar = _mm_loadu_pd(&aRe[j]);
+                const __m128d ai = _mm_loadu_pd(&aIm[j]);
+
+                const __m128d tr = _mm_sub_pd(_mm_mul_pd(br, wr), _mm_mul_pd(bi, wi));
+                const __m128d ti = _mm_add_pd(_mm_mul_pd(br, wi), _mm_mul_pd(bi, wr));
+
+                _mm_storeu_pd(&bRe[j], _mm_sub_pd(ar, tr));
+                _mm_storeu_pd(&bIm[j], _mm_sub_pd(ai, ti));
+                _mm_storeu_pd(&aRe[j], _mm_add_pd(ar, tr));
+                _mm_storeu_pd(&aIm[j], _mm_add_pd(ai, ti));
+            }
+#else
+            for (int j=0; j<half; ++j) {
+                const double wr = wRe[j];
+                const double wi = wIm[j] * sign;
+
+                const double tr = bRe[j] * wr - bIm[j] * wi;
+                const double ti = bRe[j] * wi + bIm[j] * wr;
+                bRe[j] = aRe[j] - tr;
+                bIm[j] = aIm[j] - ti;
+                aRe[j] += tr;
+                aIm[j] += ti;
+            }
+#endif
+        }
+    }
+}
+
+void
+WWRealFftD::ComplexFft(double *re, double *im, bool inverse)
+{
+    const int K = m_n / 2;
+
+    // the stages of the span up to FFTD_BLOCK are done block by block while the block is in the cache.
+    // the large FFT of the FftUpsampler of WWAudioFilterCpu is 3x faster than stage by stage
+    const int block = (K < FFTD_BLOCK) ? K : FFTD_BLOCK;
+    for (int begin=0; begin<K; begin += block) {
+        Stages(re, im, begin, begin + block, 1, block, inverse);
+    }
+    Stages(re, im, 0, K, block, K, inverse);
+}
+
+void
+WWRealFftD::Forward(const double *in, double *re_return, double *im_return)
+{
+    const int K = m_n / 2;
+    double *zRe = &m_workRe[0];
+    double *zIm = &m_workIm[0];
+
+    BitReverse(&in[0], &in[1], 2, zRe, zIm);
+    ComplexFft(zRe, zIm, false);
+
+    for (int k=0; k<=K; ++k) {
+        const int k0 = (k == K) ? 0 : k;
+        const int k1 = (k == 0) ? 0 : K - k;
+
+        const double ar =  zRe[k0];
+        const double ai =  zIm[k0];
+        const double br =  zRe[k1];
+        const double bi = -zIm[k1];
+
+        const double er = 0.5 * (ar + br);
+        const double ei = 0.5 * (ai + bi);
+        const double or_ =  0.5 * (ai - bi);
+        const double oi  = -0.5 * (ar - br);
+
+        const double wr = m_splitTwiddle[k*2+0];
+        const double wi = m_splitTwiddle[k*2+1];
+
+        re_return[k] = er + or_ * wr - oi * wi;
+        im_return[k] = ei + or_ * wi + oi * wr;
+    }
+}
+
+void
+WWRealFftD::Inverse(const double *re, const double *im, double *out_return)
+{
+    const int K = m_n / 2;
+    double *zRe = &m_workRe[0];
+    double *zIm = &m_workIm[0];
+
+    for (int k=0; k<K; ++k) {
+        const int k1 = K - k;
+
+        const double ar = re[k];
+        const double ai = (k == 0) ? 0.0 : im[k];
+        const double br = re[k1];
+        const double bi = (k == 0) ? 0.0 : -im[k1];
+
+        const double er = ar + br;
+        const double ei = ai + bi;
+
+        const double dr = ar - br;
+        const double di = ai - bi;
+        const double wr =  m_splitTwiddle[k*2+0];
+        const double wi = -m_splitTwiddle[k*2+1];
+        const double or_ = dr * wr - di * wi;
+        const double oi  = dr * wi + di * wr;
+
+        m_tmpRe[k] = er - oi;
+        m_tmpIm[k] = ei + or_;
+    }
+
+    BitReverse(&m_tmpRe[0], &m_tmpIm[0], 1, zRe, zIm);
+    ComplexFft(zRe, zIm, true);
+
+    for (int i=0; i<K; ++i) {
+        out_return[i*2+0] = zRe[i];
+        out_return[i*2+1] = zIm[i];
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+/// FFT of real float data. size is a power of 2.
+///
+/// Spectrum is stored in split form: real parts and imaginary parts in separate arrays
+/// of NumBins() = N/2+1 elements each, so that the element-wise complex multiply can be vectorized.
+/// Inverse() is not normalized: Inverse(Forward(x)) = N * x
+class WWRealFft {
+public:
+    WWRealFft(void);
+    ~WWRealFft(void);
+
+    /// @param n FFT size. power of 2, 4 or larger
+    /// @return 0: success. negative: unsupported size
+    int Init(int n);
+    void Term(void);
+
+    int Size(void) const { return m_n; }
+    int NumBins(void) const { return m_n / 2 + 1; }
+
+    /// @param in N real samples
+    /// @param re_return, im_return NumBins() elements each
+    void Forward(const float *in, float *re_return, float *im_return);
+
+    /// @param re, im NumBins() elements each. imaginary parts of the DC and Nyquist bins are ignored
+    /// @param out_return N real samples
+    void Inverse(const float *re, const float *im, float *out_return);
+
+private:
+    int m_n;
+
+    /// complex FFT of N/2 points on split (re, im) data
+    std::vector<int>   m_bitReverse;
+
+    /// exp(-2 pi i j / 2h), j = 0 .. h-1 of the butterfly stage of half size h is stored from the index h
+    std::vector<float> m_twiddleRe;
+    std::vector<float> m_twiddleIm;
+
+    /// exp(-2 pi i k / N), k = 0 .. N/2. used to split the half size complex FFT to the real FFT
+    std::vector<float> m_splitTwiddle;
+
+    std::vector<float> m_workRe;
+    std::vector<float> m_workIm;
+
+    /// @param re, im bit reversed order input. output is in natural order
+    void ComplexFft(float *re, float *im, bool inverse);
+};
+
+/// double precision version of WWRealFft for the offline processing where the round-off error of
+/// long FFTs should stay far below the 24bit quantization step. the same interface and the same scaling
+class WWRealFftD {
+public:
+    WWRealFftD(void);
+    ~WWRealFftD(void);
+
+    /// @param n FFT size. power of 2, 4 or larger
+    /// @return 0: success. negative: unsupported size
+    int Init(int n);
+    void Term(void);
+
+    int Size(void) const { return m_n; }
+    int NumBins(void) const { return m_n / 2 + 1; }
+
+    void Forward(const double *in, double *re_return, double *im_return);
+    void Inverse(const double *re, const double *im, double *out_return);
+
+private:
+    int m_n;
+    int m_log2K;
+    std::vector<int>    m_bitReverse;
+    std::vector<double> m_twiddleRe;
+    std::vector<double> m_twiddleIm;
+    std::vector<double> m_splitTwiddle;
+    std::vector<double> m_workRe;
+    std::vector<double> m_workIm;
+    std::vector<double> m_tmpRe;
+    std::vector<double> m_tmpIm;
+
+    void BitReverse(const double *srcRe, const double *srcIm, int srcStride, double *dstRe, double *dstIm);
+    void ComplexFft(double *re, double *im, bool inverse);
+    void Stages(double *re, double *im, int begin, int end, int halfBegin, int halfEnd, bool inverse);
+};
@@ -0,0 +1,88 @@
+#include "WWFirDesign.h"
+#include <math.h>
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+double
+WWBesselI0(double x)
+{
+    double sum  = 1.0;
+    double term = 1.0;
+    for (int k=1; k<64; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum  += term;
+        if (term < sum * 1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+double
+WWKaiserBeta(double attenuationDb)
+{
+    if (50.0 < attenuationDb) {
+        return 0.1102 * (attenuationDb - 8.7);
+    }
+    if (21.0 < attenuationDb) {
+        return 0.5842 * pow(attenuationDb - 21.0, 0.4) + 0.07886 * (attenuationDb - 21.0);
+    }
+    return 0;
+}
+
+int
+WWKaiserLength(double attenuationDb, double transitionWidth)
+{
+    return (int)ceil((attenuationDb - 7.95) / (14.36 * transitionWidth)) + 1;
+}
+
+void
+WWDesignLowpass(int taps, double cutoff, double beta, std::vector<double> &h)
+{
+    const double center = (taps - 1) * 0.5;
+    const double i0Beta = WWBesselI0(beta);
+    double sum = 0;
+
+    h.resize(taps);
+    for (int i=0; i<taps; ++i) {
+        double x = i - center;
+        double sinc = (x == 0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        double w = 1.0;
+        if (0 < center) {
+            double r = x / center;
+            w = WWBesselI0(beta * sqrt(1.0 - r * r)) / i0Beta;
+        }
+        h[i] = sinc * w;
+        sum += h[i];
+    }
+
+    for (int i=0; i<taps; ++i) {
+        h[i] /= sum;
+    }
+}
+
+void
+WWDesignHalfband(double attenuationDb, double transitionWidth, std::vector<double> &g_return)
+{
+    int n = WWKaiserLength(attenuationDb, transitionWidth);
+    int M = (n + 1 + 3) / 4;
+    if (M < 1) {
+        M = 1;
+    }
+
+    std::vector<double> h;
+    WWDesignLowpass(4 * M - 1, 0.25, WWKaiserBeta(attenuationDb), h);
+
+    // scale the nonzero taps except the center to keep DC gain 1
+    double sum = 0;
+    for (int j=0; j<2 * M; ++j) {
+        sum += h[2 * j];
+    }
+
+    g_return.resize(M);
+    for (int j=0; j<M; ++j) {
+        g_return[j] = h[2 * j] * 0.5 / sum;
+    }
+}
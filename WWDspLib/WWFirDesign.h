@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+/// modified Bessel function of the first kind, order 0
+double WWBesselI0(double x);
+
+/// @return Kaiser window beta for the stopband attenuation in dB
+double WWKaiserBeta(double attenuationDb);
+
+/// @param transitionWidth normalized to the sample rate
+/// @return number of taps of the Kaiser windowed FIR filter
+int WWKaiserLength(double attenuationDb, double transitionWidth);
+
+/// Kaiser windowed sinc lowpass. DC gain is 1.
+/// @param cutoff normalized to the sample rate
+void WWDesignLowpass(int taps, double cutoff, double beta, std::vector<double> &h_return);
+
+/// designs half-band lowpass filter of 4M-1 taps. DC gain is 1.
+/// center tap is 0.5 and taps of even distance from the center are 0.
+/// @param transitionWidth normalized to the sample rate
+/// @param g_return the first M coefficients of the nonzero taps except the center.
+///                 the nonzero taps are symmetric: there are 2M of them
+void WWDesignHalfband(double attenuationDb, double transitionWidth, std::vector<double> &g_return);
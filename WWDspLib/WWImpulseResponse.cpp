@@ -0,0 +1,259 @@
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#  include "../WWFlacRW/WWFlacRW.h"
+#endif
+
+#include "WWImpulseResponse.h"
+#include "WWWavFile.h"
+#include <stdint.h>
+#include <string.h>
+
+int
+WWImpulseResponseReadWav(FILE *fp, WWImpulseResponse &ir_return)
+{
+    ir_return.sampleRate = 0;
+    ir_return.channels.clear();
+
+    // the data chunk is of its chunk size: the chunks after it, such as LIST, are not taps
+    WWWavFormat f;
+    if (WWWavReadHeader(fp, f) < 0 || f.numFrames < 1 || WW_IMPULSE_RESPONSE_MAX_TAPS < f.numFrames) {
+        return -1;
+    }
+
+    const int numTaps = (int)f.numFrames;
+    std::vector<std::vector<float> > &ch = ir_return.channels;
+    ch.resize(f.numChannels);
+    for (int c=0; c<f.numChannels; ++c) {
+        ch[c].resize(numTaps);
+    }
+
+    const int CHUNK_FRAMES = 4096;
+    std::vector<uint8_t> buff((size_t)CHUNK_FRAMES * f.BytesPerFrame());
+    std::vector<float> samples((size_t)CHUNK_FRAMES * f.numChannels);
+    for (int pos=0; pos<numTaps; pos += CHUNK_FRAMES) {
+        const int frames = (numTaps - pos < CHUNK_FRAMES) ? numTaps - pos : CHUNK_FRAMES;
+        if (fread(&buff[0], f.BytesPerFrame(), frames, fp) != (size_t)frames) {
+            ch.clear();
+            return -1;
+        }
+
+        WWWavDecodeSamples(&buff[0], f, (size_t)frames * f.numChannels, &samples[0]);
+        for (int i=0; i<frames; ++i) {
+            for (int c=0; c<f.numChannels; ++c) {
+                ch[c][pos + i] = samples[(size_t)i * f.numChannels + c];
+            }
+        }
+    }
+
+    ir_return.sampleRate = f.sampleRate;
+    return 0;
+}
+
+#ifdef _WIN32
+
+static uint32_t
+ReadLE4(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+ReadLE2(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/// integer sample of bytesPerSample bytes, little endian, to [-1, 1)
+static float
+IntSampleToFloat(const uint8_t *p, int bytesPerSample)
+{
+    switch (bytesPerSample) {
+    case 1:
+        return (float)(int8_t)p[0] * (1.0f / 128.0f);
+    case 2:
+        return (float)(int16_t)ReadLE2(p) * (1.0f / 32768.0f);
+    case 3:
+        return (float)(int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) * (1.0f / 2147483648.0f);
+    case 4:
+        return (float)(int32_t)ReadLE4(p) * (1.0f / 2147483648.0f);
+    default:
+        return 0.0f;
+    }
+}
+
+typedef int     (__stdcall *WWFlacRW_DecodeAllFunc)(const wchar_t *path);
+typedef int     (__stdcall *WWFlacRW_GetDecodedMetadataFunc)(int id, WWFlacMetadata &metaReturn);
+typedef int64_t (__stdcall *WWFlacRW_GetDecodedPcmBytesFunc)(int id, int channel, int64_t startBytes, uint8_t *pcmReturn, int64_t pcmBytes);
+typedef int     (__stdcall *WWFlacRW_DecodeEndFunc)(int id);
+
+/// decodes the FLAC file by WWFlacRW.dll. the DLL is kept loaded once it is loaded
+static int
+ReadFlac(const wchar_t *path, WWImpulseResponse &ir_return)
+{
+    static HMODULE hModule = nullptr;
+    if (nullptr == hModule) {
+        hModule = LoadLibraryW(L"WWFlacRW.dll");
+        if (nullptr == hModule) {
+            printf("WWImpulseResponse: LoadLibrary WWFlacRW.dll failed\n");
+            return -1;
+        }
+    }
+
+    WWFlacRW_DecodeAllFunc decodeAll
+        = (WWFlacRW_DecodeAllFunc)GetProcAddress(hModule, "WWFlacRW_DecodeAll");
+    WWFlacRW_GetDecodedMetadataFunc getDecodedMetadata
+        = (WWFlacRW_GetDecodedMetadataFunc)GetProcAddress(hModule, "WWFlacRW_GetDecodedMetadata");
+    WWFlacRW_GetDecodedPcmBytesFunc getDecodedPcmBytes
+        = (WWFlacRW_GetDecodedPcmBytesFunc)GetProcAddress(hModule, "WWFlacRW_GetDecodedPcmBytes");
+    WWFlacRW_DecodeEndFunc decodeEnd
+        = (WWFlacRW_DecodeEndFunc)GetProcAddress(hModule, "WWFlacRW_DecodeEnd");
+    if (nullptr == decodeAll || nullptr == getDecodedMetadata || nullptr == getDecodedPcmBytes || nullptr == decodeEnd) {
+        printf("WWImpulseResponse: GetProcAddress failed\n");
+        return -1;
+    }
+
+    int result = -1;
+    WWFlacMetadata *meta = new WWFlacMetadata();
+    std::vector<uint8_t> pcm;
+    int bytesPerSample = 0;
+    int64_t numTaps = 0;
+
+    const int id = decodeAll(path);
+    if (id < 0) {
+        printf("WWImpulseResponse: FLAC decode failed %d\n", id);
+        goto end;
+    }
+    if (getDecodedMetadata(id, *meta) < 0) {
+        goto end;
+    }
+
+    numTaps = (int64_t)meta->totalSamples;
+    bytesPerSample = meta->bitsPerSample / 8;
+    if (numTaps < 1 || WW_IMPULSE_RESPONSE_MAX_TAPS < numTaps || bytesPerSample < 1 || 4 < bytesPerSample) {
+        goto end;
+    }
+
+    // WWFlacRW gives the samples of each channel: little endian integers of bitsPerSample
+    ir_return.sampleRate = meta->sampleRate;
+    ir_return.channels.resize(meta->channels);
+    pcm.resize((size_t)numTaps * bytesPerSample);
+    for (int c=0; c<meta->channels; ++c) {
+        if (getDecodedPcmBytes(id, c, 0, &pcm[0], (int64_t)pcm.size()) != (int64_t)pcm.size()) {
+            ir_return.channels.clear();
+            goto end;
+        }
+        std::vector<float> &h = ir_return.channels[c];
+        h.resize((size_t)numTaps);
+        for (int64_t t=0; t<numTaps; ++t) {
+            h[(size_t)t] = IntSampleToFloat(&pcm[(size_t)t * bytesPerSample], bytesPerSample);
+        }
+    }
+    result = 0;
+
+end:
+    if (0 <= id) {
+        decodeEnd(id);
+    }
+    delete meta;
+    return result;
+}
+
+#endif // _WIN32
+
+static FILE *
+OpenFile(const char *path)
+{
+    FILE *fp = nullptr;
+#ifdef _MSC_VER
+    if (0 != fopen_s(&fp, path, "rb")) {
+        fp = nullptr;
+    }
+#else
+    fp = fopen(path, "rb");
+#endif
+    return fp;
+}
+
+#ifdef _WIN32
+static FILE *
+OpenFile(const wchar_t *path)
+{
+    FILE *fp = nullptr;
+    if (0 != _wfopen_s(&fp, path, L"rb")) {
+        fp = nullptr;
+    }
+    return fp;
+}
+#endif
+
+/// @return true: the path ends with .flac, case insensitive
+template <typename CHAR>
+static bool
+IsFlacPath(const CHAR *path)
+{
+    static const char ext[] = ".flac";
+    const size_t extLen = sizeof ext - 1;
+
+    size_t len = 0;
+    while (path[len] != 0) {
+        ++len;
+    }
+    if (len < extLen) {
+        return false;
+    }
+
+    for (size_t i=0; i<extLen; ++i) {
+        CHAR c = path[len - extLen + i];
+        if ('A' <= c && c <= 'Z') {
+            c = (CHAR)(c - 'A' + 'a');
+        }
+        if (c != (CHAR)ext[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+WWImpulseResponseRead(const char *path, WWImpulseResponse &ir_return)
+{
+    if (IsFlacPath(path)) {
+#ifdef _WIN32
+        wchar_t wpath[MAX_PATH];
+        if (0 == MultiByteToWideChar(CP_ACP, 0, path, -1, wpath, MAX_PATH)) {
+            return -1;
+        }
+        return ReadFlac(wpath, ir_return);
+#else
+        printf("WWImpulseResponse: FLAC is supported on Windows only\n");
+        return -1;
+#endif
+    }
+
+    FILE *fp = OpenFile(path);
+    if (nullptr == fp) {
+        return -1;
+    }
+    const int rv = WWImpulseResponseReadWav(fp, ir_return);
+    fclose(fp);
+    return rv;
+}
+
+#ifdef _WIN32
+int
+WWImpulseResponseRead(const wchar_t *path, WWImpulseResponse &ir_return)
+{
+    if (IsFlacPath(path)) {
+        return ReadFlac(path, ir_return);
+    }
+
+    FILE *fp = OpenFile(path);
+    if (nullptr == fp) {
+        return -1;
+    }
+    const int rv = WWImpulseResponseReadWav(fp, ir_return);
+    fclose(fp);
+    return rv;
+}
+#endif
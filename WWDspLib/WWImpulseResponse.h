@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+/// longest impulse response accepted by the readers. 60 seconds of 192kHz
+#define WW_IMPULSE_RESPONSE_MAX_TAPS (192000 * 60)
+
+/// impulse responses of the channels, read from a WAV or FLAC file
+struct WWImpulseResponse {
+    int sampleRate;
+
+    /// [ch][tap]. all channels have the same number of taps
+    std::vector<std::vector<float> > channels;
+
+    WWImpulseResponse(void) : sampleRate(0) { }
+
+    int NumChannels(void) const { return (int)channels.size(); }
+    int NumTaps(void) const { return channels.empty() ? 0 : (int)channels[0].size(); }
+};
+
+/// reads the WAV or RF64 file by WWWavReadHeader(). 8, 16, 24, 32bit integer and 32, 64bit float
+/// @return 0: success. negative: not a WAV file, unsupported format or too long
+int WWImpulseResponseReadWav(FILE *fp, WWImpulseResponse &ir_return);
+
+/// reads the WAV file, or the FLAC file when the extension is .flac.
+/// FLAC is decoded by WWFlacRW.dll, loaded on the first use. Windows only
+/// @return 0: success. negative: error
+int WWImpulseResponseRead(const char *path, WWImpulseResponse &ir_return);
+#ifdef _WIN32
+int WWImpulseResponseRead(const wchar_t *path, WWImpulseResponse &ir_return);
+#endif
@@ -0,0 +1,611 @@
+#include "WWLoudness.h"
+#include "WWFirDesign.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_LOUDNESS_USE_SSE
+#endif
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+/// frames processed at once
+#define WORK_FRAMES (1024)
+
+/// 400ms gating block and 3s short-term block in 100ms sub-blocks
+#define GATING_BLOCK_SUBBLOCKS     (4)
+#define SHORT_TERM_BLOCK_SUBBLOCKS (30)
+
+#define RELATIVE_GATE_LU       (-10.0)
+#define RANGE_RELATIVE_GATE_LU (-20.0)
+#define RANGE_LOW_PERCENTILE   (0.10)
+#define RANGE_HIGH_PERCENTILE  (0.95)
+
+/// taps of each phase of the true peak interpolation filter
+#define TRUE_PEAK_TAPS (12)
+#define TRUE_PEAK_PHASES (4)
+
+/// surround channel weight of BS.1770 (+1.5dB)
+#define SURROUND_WEIGHT (1.41)
+
+/// dwChannelMask bits of WAVEFORMATEXTENSIBLE
+#define SPEAKER_LFE        (0x8)
+#define SPEAKER_BACK_LEFT  (0x10)
+#define SPEAKER_BACK_RIGHT (0x20)
+#define SPEAKER_SIDE_LEFT  (0x200)
+#define SPEAKER_SIDE_RIGHT (0x400)
+
+void
+WWLoudnessChannelWeights(int numChannels, uint32_t channelMask, std::vector<double> &w_return)
+{
+    w_return.assign(numChannels, 1.0);
+
+    if (0 == channelMask) {
+        // 5.1 and 7.1 of the default order: FL FR FC LFE BL BR (SL SR)
+        if (6 == numChannels || 8 == numChannels) {
+            channelMask = 0x3f | (8 == numChannels ? (SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT) : 0);
+        } else {
+            return;
+        }
+    }
+
+    int ch = 0;
+    for (int bit=0; bit<32 && ch<numChannels; ++bit) {
+        const uint32_t speaker = 1U << bit;
+        if (0 == (channelMask & speaker)) {
+            continue;
+        }
+
+        switch (speaker) {
+        case SPEAKER_LFE:
+            w_return[ch] = 0.0;
+            break;
+        case SPEAKER_BACK_LEFT:
+        case SPEAKER_BACK_RIGHT:
+        case SPEAKER_SIDE_LEFT:
+        case SPEAKER_SIDE_RIGHT:
+            w_return[ch] = SURROUND_WEIGHT;
+            break;
+        default:
+            break;
+        }
+        ++ch;
+    }
+}
+
+/// K-weighting filter of BS.1770 for the sample rate: the high shelf of the head and the RLB highpass.
+/// the analog prototypes of the 48kHz coefficients in the recommendation are transformed to the sample rate
+static void
+DesignKWeighting(double sampleRate, WWBiquadCoeffs &shelf_return, WWBiquadCoeffs &highpass_return)
+{
+    {
+        const double f0 = 1681.974450955533;
+        const double G  = 3.999843853973347;
+        const double Q  = 0.7071752369554196;
+
+        const double K  = tan(M_PI * f0 / sampleRate);
+        const double Vh = pow(10.0, G / 20.0);
+        const double Vb = pow(Vh, 0.4996667741545416);
+        const double a0 = 1.0 + K / Q + K * K;
+
+        shelf_return.b0 = (Vh + Vb * K / Q + K * K) / a0;
+        shelf_return.b1 = 2.0 * (K * K - Vh) / a0;
+        shelf_return.b2 = (Vh - Vb * K / Q + K * K) / a0;
+        shelf_return.a1 = 2.0 * (K * K - 1.0) / a0;
+        shelf_return.a2 = (1.0 - K / Q + K * K) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double Q  = 0.5003270373238773;
+
+        const double K  = tan(M_PI * f0 / sampleRate);
+        const double a0 = 1.0 + K / Q + K * K;
+
+        highpass_return.b0 = 1.0;
+        highpass_return.b1 = -2.0;
+        highpass_return.b2 = 1.0;
+        highpass_return.a1 = 2.0 * (K * K - 1.0) / a0;
+        highpass_return.a2 = (1.0 - K / Q + K * K) / a0;
+    }
+}
+
+static double
+EnergyToLoudness(double z)
+{
+    if (z <= 0) {
+        return -HUGE_VAL;
+    }
+    return -0.691 + 10.0 * log10(z);
+}
+
+static double
+LoudnessToEnergy(double l)
+{
+    return pow(10.0, (l + 0.691) / 10.0);
+}
+
+/// mean energies of the blocks of n sub-blocks, stepped by 1 sub-block
+static void
+MakeBlocks(const std::vector<const std::vector<double> *> &subBlockLists, int n, std::vector<double> &blocks_return)
+{
+    blocks_return.clear();
+
+    for (size_t t=0; t<subBlockLists.size(); ++t) {
+        const std::vector<double> &s = *subBlockLists[t];
+        if (s.size() < (size_t)n) {
+            continue;
+        }
+
+        double sum = 0;
+        for (int i=0; i<n; ++i) {
+            sum += s[i];
+        }
+        blocks_return.push_back(sum / n);
+
+        for (size_t i=n; i<s.size(); ++i) {
+            // summed again now and then, so that the rounding error of the sliding sum does not pile up
+            if (0 == i % 1024) {
+                sum = 0;
+                for (size_t j=i+1-n; j<=i; ++j) {
+                    sum += s[j];
+                }
+            } else {
+                sum += s[i] - s[i - n];
+            }
+            blocks_return.push_back(sum / n);
+        }
+    }
+}
+
+/// integrated loudness of the gating blocks
+static double
+Integrated(const std::vector<double> &blocks)
+{
+    const double absGate = LoudnessToEnergy(WW_LOUDNESS_ABSOLUTE_GATE);
+
+    double sum = 0;
+    int64_t count = 0;
+    for (size_t i=0; i<blocks.size(); ++i) {
+        if (absGate < blocks[i]) {
+            sum += blocks[i];
+            ++count;
+        }
+    }
+    if (0 == count) {
+        return -HUGE_VAL;
+    }
+
+    const double relGate = std::max(absGate, LoudnessToEnergy(EnergyToLoudness(sum / count) + RELATIVE_GATE_LU));
+
+    sum = 0;
+    count = 0;
+    for (size_t i=0; i<blocks.size(); ++i) {
+        if (relGate < blocks[i]) {
+            sum += blocks[i];
+            ++count;
+        }
+    }
+    if (0 == count) {
+        return -HUGE_VAL;
+    }
+    return EnergyToLoudness(sum / count);
+}
+
+/// loudness range of the short-term blocks
+static double
+Range(const std::vector<double> &blocks)
+{
+    const double absGate = LoudnessToEnergy(WW_LOUDNESS_ABSOLUTE_GATE);
+
+    double sum = 0;
+    int64_t count = 0;
+    for (size_t i=0; i<blocks.size(); ++i) {
+        if (absGate < blocks[i]) {
+            sum += blocks[i];
+            ++count;
+        }
+    }
+    if (0 == count) {
+        return 0;
+    }
+
+    const double relGate = std::max(absGate, LoudnessToEnergy(EnergyToLoudness(sum / count) + RANGE_RELATIVE_GATE_LU));
+
+    std::vector<double> gated;
+    for (size_t i=0; i<blocks.size(); ++i) {
+        if (relGate < blocks[i]) {
+            gated.push_back(blocks[i]);
+        }
+    }
+    if (gated.empty()) {
+        return 0;
+    }
+
+    const size_t n = gated.size();
+    const size_t lo = (size_t)((n - 1) * RANGE_LOW_PERCENTILE + 0.5);
+    const size_t hi = (size_t)((n - 1) * RANGE_HIGH_PERCENTILE + 0.5);
+    std::nth_element(gated.begin(), gated.begin() + lo, gated.end());
+    const double eLo = gated[lo];
+    std::nth_element(gated.begin(), gated.begin() + hi, gated.end());
+    const double eHi = gated[hi];
+
+    return EnergyToLoudness(eHi) - EnergyToLoudness(eLo);
+}
+
+static void
+ComputeResult(const std::vector<const std::vector<double> *> &subBlockLists, double truePeak, double samplePeak,
+        WWLoudnessResult &r_return)
+{
+    std::vector<double> blocks;
+
+    MakeBlocks(subBlockLists, GATING_BLOCK_SUBBLOCKS, blocks);
+    r_return.integrated = Integrated(blocks);
+
+    MakeBlocks(subBlockLists, SHORT_TERM_BLOCK_SUBBLOCKS, blocks);
+    r_return.range = Range(blocks);
+
+    r_return.truePeak   = std::max(truePeak, samplePeak);
+    r_return.samplePeak = samplePeak;
+
+    r_return.replayGainDb = 0;
+    if (-HUGE_VAL < r_return.integrated) {
+        r_return.replayGainDb = WW_LOUDNESS_REPLAYGAIN_REFERENCE - r_return.integrated;
+    }
+}
+
+WWLoudnessMeter::WWLoudnessMeter(void)
+    : m_sampleRate(0), m_numChannels(0), m_subBlockFrames(0), m_subBlockPos(0),
+      m_oversample(1), m_tpPos(0), m_truePeak(0), m_samplePeak(0)
+{
+}
+
+WWLoudnessMeter::~WWLoudnessMeter(void)
+{
+    Term();
+}
+
+int
+WWLoudnessMeter::Init(int sampleRate, int numChannels, const double *channelWeights)
+{
+    Term();
+
+    // the highpass of the K-weighting is at 38Hz
+    if (sampleRate < 100 || numChannels < 1) {
+        return -1;
+    }
+
+    m_sampleRate  = sampleRate;
+    m_numChannels = numChannels;
+
+    if (channelWeights) {
+        m_weights.assign(channelWeights, channelWeights + numChannels);
+    } else {
+        WWLoudnessChannelWeights(numChannels, 0, m_weights);
+    }
+
+    WWBiquadCoeffs shelf, highpass;
+    DesignKWeighting(sampleRate, shelf, highpass);
+    if (m_kWeighting.Init(numChannels, 2) < 0) {
+        Term();
+        return -1;
+    }
+    for (int ch=0; ch<numChannels; ++ch) {
+        m_kWeighting.SetCoeffs(0, ch, shelf);
+        m_kWeighting.SetCoeffs(1, ch, highpass);
+    }
+    m_kWeighting.Commit(0);
+
+    m_subBlockFrames = (sampleRate + 5) / 10;
+    m_sumSq.assign(numChannels, 0.0);
+
+    // BS.1770-4 Annex 2: 4x at 48kHz. the higher sample rates need less oversampling
+    m_oversample = (sampleRate < 96000) ? 4 : (sampleRate < 192000) ? 2 : 1;
+
+    m_tpCoeffs.assign(TRUE_PEAK_TAPS * TRUE_PEAK_PHASES, 0.0f);
+    if (1 < m_oversample) {
+        const int F = m_oversample;
+        std::vector<double> h;
+        WWDesignLowpass(TRUE_PEAK_TAPS * F, 0.5 / F, WWKaiserBeta(60.0), h);
+
+        // y[n + p/F] = sum_k x[n-k] * F * h[F*k + p]. stored in the order of the history, the oldest first
+        for (int k=0; k<TRUE_PEAK_TAPS; ++k) {
+            for (int p=0; p<F; ++p) {
+                m_tpCoeffs[(TRUE_PEAK_TAPS - 1 - k) * TRUE_PEAK_PHASES + p] = (float)(F * h[F * k + p]);
+            }
+        }
+    }
+    m_tpHistory.assign((size_t)numChannels * 2 * TRUE_PEAK_TAPS, 0.0f);
+
+    m_work.assign((size_t)WORK_FRAMES * numChannels, 0.0f);
+
+    Reset();
+    return 0;
+}
+
+void
+WWLoudnessMeter::Term(void)
+{
+    m_kWeighting.Term();
+    m_weights.clear();
+    m_sumSq.clear();
+    m_subBlocks.clear();
+    m_tpCoeffs.clear();
+    m_tpHistory.clear();
+    m_work.clear();
+
+    m_sampleRate  = 0;
+    m_numChannels = 0;
+}
+
+void
+WWLoudnessMeter::Reset(void)
+{
+    m_kWeighting.Reset();
+
+    std::fill(m_sumSq.begin(), m_sumSq.end(), 0.0);
+    m_subBlockPos = 0;
+    m_subBlocks.clear();
+
+    std::fill(m_tpHistory.begin(), m_tpHistory.end(), 0.0f);
+    m_tpPos = 0;
+
+    m_truePeak   = 0;
+    m_samplePeak = 0;
+}
+
+void
+WWLoudnessMeter::ProcessPeak(const float *in, int frames)
+{
+    const int C = m_numChannels;
+    const size_t n = (size_t)frames * C;
+
+    // sample peak
+    size_t i = 0;
+    float peak = m_samplePeak;
+#ifdef WW_LOUDNESS_USE_SSE
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 m = _mm_set1_ps(peak);
+        for (; i + 4 <= n; i += 4) {
+            m = _mm_max_ps(m, _mm_and_ps(absMask, _mm_loadu_ps(&in[i])));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, m);
+        peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+#endif
+    for (; i<n; ++i) {
+        peak = std::max(peak, fabsf(in[i]));
+    }
+    m_samplePeak = peak;
+
+    if (1 == m_oversample) {
+        m_truePeak = m_samplePeak;
+        return;
+    }
+
+    // true peak. the phases of the interpolation are computed at once
+    const int T = TRUE_PEAK_TAPS;
+    const float *c = &m_tpCoeffs[0];
+    float tp = m_truePeak;
+    int pos = m_tpPos;
+    for (int ch=0; ch<C; ++ch) {
+        float *h = &m_tpHistory[(size_t)ch * 2 * T];
+        pos = m_tpPos;
+
+#ifdef WW_LOUDNESS_USE_SSE
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 m = _mm_set1_ps(tp);
+        for (int f=0; f<frames; ++f) {
+            const float x = in[(size_t)f * C + ch];
+            h[pos] = x;
+            h[pos + T] = x;
+
+            // the last T samples, the oldest first
+            const float *w = &h[pos + 1];
+            __m128 y = _mm_setzero_ps();
+            for (int k=0; k<T; ++k) {
+                y = _mm_add_ps(y, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(&c[k * TRUE_PEAK_PHASES])));
+            }
+            m = _mm_max_ps(m, _mm_and_ps(absMask, y));
+
+            pos = (pos + 1 == T) ? 0 : pos + 1;
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, m);
+        tp = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#else
+        for (int f=0; f<frames; ++f) {
+            const float x = in[(size_t)f * C + ch];
+            h[pos] = x;
+            h[pos + T] = x;
+
+            const float *w = &h[pos + 1];
+            for (int p=0; p<m_oversample; ++p) {
+                float y = 0;
+                for (int k=0; k<T; ++k) {
+                    y += w[k] * c[k * TRUE_PEAK_PHASES + p];
+                }
+                tp = std::max(tp, fabsf(y));
+            }
+
+            pos = (pos + 1 == T) ? 0 : pos + 1;
+        }
+#endif
+    }
+    m_tpPos = pos;
+    m_truePeak = tp;
+}
+
+void
+WWLoudnessMeter::ProcessEnergy(const float *in, int frames)
+{
+    const int C = m_numChannels;
+
+    int f = 0;
+    while (f < frames) {
+        const int n = std::min(frames - f, m_subBlockFrames - m_subBlockPos);
+        const float *x = &in[(size_t)f * C];
+
+        int ch = 0;
+#ifdef WW_LOUDNESS_USE_SSE
+        for (; ch + 2 <= C; ch += 2) {
+            __m128d acc = _mm_setzero_pd();
+            for (int i=0; i<n; ++i) {
+                const __m128d v = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)&x[(size_t)i * C + ch])));
+                acc = _mm_add_pd(acc, _mm_mul_pd(v, v));
+            }
+            double s[2];
+            _mm_storeu_pd(s, acc);
+            m_sumSq[ch]     += s[0];
+            m_sumSq[ch + 1] += s[1];
+        }
+#endif
+        for (; ch<C; ++ch) {
+            double acc = 0;
+            for (int i=0; i<n; ++i) {
+                const double v = x[(size_t)i * C + ch];
+                acc += v * v;
+            }
+            m_sumSq[ch] += acc;
+        }
+
+        m_subBlockPos += n;
+        f += n;
+
+        if (m_subBlockPos == m_subBlockFrames) {
+            double z = 0;
+            for (int c=0; c<C; ++c) {
+                z += m_weights[c] * m_sumSq[c];
+            }
+            m_subBlocks.push_back(z / m_subBlockFrames);
+
+            std::fill(m_sumSq.begin(), m_sumSq.end(), 0.0);
+            m_subBlockPos = 0;
+        }
+    }
+}
+
+void
+WWLoudnessMeter::Process(const float *in, int frames)
+{
+    if (0 == m_numChannels) {
+        return;
+    }
+
+    const int C = m_numChannels;
+
+    int pos = 0;
+    while (pos < frames) {
+        const int n = std::min(frames - pos, WORK_FRAMES);
+        const float *x = &in[(size_t)pos * C];
+
+        ProcessPeak(x, n);
+
+        memcpy(&m_work[0], x, sizeof(float) * n * C);
+        m_kWeighting.Process(&m_work[0], n);
+        ProcessEnergy(&m_work[0], n);
+
+        pos += n;
+    }
+}
+
+void
+WWLoudnessMeter::Result(WWLoudnessResult &r_return) const
+{
+    std::vector<const std::vector<double> *> lists(1, &m_subBlocks);
+    ComputeResult(lists, m_truePeak, m_samplePeak, r_return);
+}
+
+void
+WWLoudnessMeter::AlbumResult(const std::vector<const WWLoudnessMeter *> &meters, WWLoudnessResult &r_return)
+{
+    std::vector<const std::vector<double> *> lists;
+    double truePeak = 0;
+    double samplePeak = 0;
+
+    for (size_t i=0; i<meters.size(); ++i) {
+        lists.push_back(&meters[i]->m_subBlocks);
+        truePeak   = std::max(truePeak,   (double)meters[i]->m_truePeak);
+        samplePeak = std::max(samplePeak, (double)meters[i]->m_samplePeak);
+    }
+
+    ComputeResult(lists, truePeak, samplePeak, r_return);
+}
+
+int
+WWLoudnessAnalyze(const std::vector<WWLoudnessTrack> &tracks, int numThreads,
+        std::vector<WWLoudnessResult> &trackResults_return, WWLoudnessResult &album_return)
+{
+    trackResults_return.clear();
+    album_return = WWLoudnessResult();
+
+    const int numTracks = (int)tracks.size();
+    for (int t=0; t<numTracks; ++t) {
+        const WWLoudnessTrack &tr = tracks[t];
+        if (tr.sampleRate <= 0 || tr.numChannels <= 0 || tr.numFrames < 0 || !tr.read) {
+            return -1;
+        }
+    }
+
+    std::vector<WWLoudnessMeter> meters(numTracks);
+    for (int t=0; t<numTracks; ++t) {
+        std::vector<double> w;
+        WWLoudnessChannelWeights(tracks[t].numChannels, tracks[t].channelMask, w);
+        if (meters[t].Init(tracks[t].sampleRate, tracks[t].numChannels, &w[0]) < 0) {
+            return -1;
+        }
+    }
+
+    if (numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+    }
+    numThreads = std::max(1, std::min(numThreads, numTracks));
+
+    // each worker takes the next track until all are done. a track is measured from the start to the end by one worker
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        std::vector<float> buff;
+        for (;;) {
+            const int t = next++;
+            if (numTracks <= t) {
+                break;
+            }
+
+            const WWLoudnessTrack &tr = tracks[t];
+            buff.resize((size_t)WORK_FRAMES * tr.numChannels);
+
+            for (int64_t pos=0; pos<tr.numFrames; pos += WORK_FRAMES) {
+                const int n = (int)std::min((int64_t)WORK_FRAMES, tr.numFrames - pos);
+                tr.read(pos, n, &buff[0]);
+                meters[t].Process(&buff[0], n);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i=1; i<numThreads; ++i) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (size_t i=0; i<threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    std::vector<const WWLoudnessMeter *> p;
+    trackResults_return.resize(numTracks);
+    for (int t=0; t<numTracks; ++t) {
+        meters[t].Result(trackResults_return[t]);
+        p.push_back(&meters[t]);
+    }
+    WWLoudnessMeter::AlbumResult(p, album_return);
+
+    return 0;
+}
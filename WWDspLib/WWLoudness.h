@@ -0,0 +1,127 @@
+#pragma once
+
+#include "WWBiquad.h"
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+/// gating blocks quieter than this are ignored. LUFS
+#define WW_LOUDNESS_ABSOLUTE_GATE (-70.0)
+
+/// target loudness of ReplayGain 2.0. LUFS
+#define WW_LOUDNESS_REPLAYGAIN_REFERENCE (-18.0)
+
+struct WWLoudnessResult {
+    /// gated integrated loudness of ITU-R BS.1770-4. LUFS.
+    /// -HUGE_VAL when no gating block is louder than WW_LOUDNESS_ABSOLUTE_GATE
+    double integrated;
+
+    /// loudness range of EBU Tech 3342. LU
+    double range;
+
+    /// true peak and sample peak. linear, full scale is 1.0
+    double truePeak;
+    double samplePeak;
+
+    /// ReplayGain 2.0 gain in dB: WW_LOUDNESS_REPLAYGAIN_REFERENCE - integrated. 0 when silent
+    double replayGainDb;
+
+    WWLoudnessResult(void) : integrated(0), range(0), truePeak(0), samplePeak(0), replayGainDb(0) { }
+};
+
+/// channel weights of BS.1770: 0 for the LFE, 1.41 for the surround channels, 1.0 for the others.
+/// @param channelMask dwChannelMask of WAVEFORMATEXTENSIBLE. 0: the default channel order of numChannels
+void WWLoudnessChannelWeights(int numChannels, uint32_t channelMask, std::vector<double> &w_return);
+
+/// Loudness meter of a track.
+///
+///   The input is K-weighted by WWBiquadCascade (2 channels at once by SSE2) and the mean square is taken for
+///   each 100ms sub-block. The 400ms gating blocks (75% overlap) and the 3s short-term blocks (100ms step) of
+///   the integrated loudness and the loudness range are made from the sub-blocks on Result().
+///   The true peak is the peak of the input oversampled 4x by a 48 tap polyphase FIR
+///   (2x at 96kHz or higher, not oversampled at 192kHz or higher), 4 phases at once by SSE.
+class WWLoudnessMeter {
+public:
+    WWLoudnessMeter(void);
+    ~WWLoudnessMeter(void);
+
+    /// @param channelWeights numChannels weights. nullptr: WWLoudnessChannelWeights(numChannels, 0)
+    /// @return 0: success. negative: bad parameter
+    int Init(int sampleRate, int numChannels, const double *channelWeights = nullptr);
+    void Term(void);
+
+    /// forgets the frames given so far
+    void Reset(void);
+
+    int SampleRate(void) const { return m_sampleRate; }
+    int NumChannels(void) const { return m_numChannels; }
+
+    /// any number of frames can be processed at once.
+    /// @param in channel interleaved. frames * NumChannels() floats. full scale is 1.0
+    void Process(const float *in, int frames);
+
+    /// result of the frames given so far
+    void Result(WWLoudnessResult &r_return) const;
+
+    /// weighted mean square of each complete 100ms sub-block
+    const std::vector<double> &SubBlockEnergies(void) const { return m_subBlocks; }
+
+    /// result of the tracks played one after another, as the album gain of ReplayGain 2.0.
+    /// gating blocks do not cross the track boundary. the peaks are the largest of the tracks
+    static void AlbumResult(const std::vector<const WWLoudnessMeter *> &meters, WWLoudnessResult &r_return);
+
+private:
+    int m_sampleRate;
+    int m_numChannels;
+    std::vector<double> m_weights;
+
+    WWBiquadCascade m_kWeighting;
+
+    int m_subBlockFrames;
+    int m_subBlockPos;
+
+    /// sum of squares of the current sub-block. per channel
+    std::vector<double> m_sumSq;
+    std::vector<double> m_subBlocks;
+
+    /// oversampling ratio of the true peak. 1, 2 or 4
+    int m_oversample;
+
+    /// [tap][phase of 4] interpolation filter
+    std::vector<float> m_tpCoeffs;
+
+    /// [channel][2 * taps] input history. each sample is written twice so that the last taps samples are contiguous
+    std::vector<float> m_tpHistory;
+    int m_tpPos;
+
+    float m_truePeak;
+    float m_samplePeak;
+
+    /// K-weighted chunk
+    std::vector<float> m_work;
+
+    void ProcessPeak(const float *in, int frames);
+    void ProcessEnergy(const float *in, int frames);
+};
+
+/// source of the samples of a track for WWLoudnessAnalyze()
+struct WWLoudnessTrack {
+    int sampleRate;
+    int numChannels;
+
+    /// see WWLoudnessChannelWeights()
+    uint32_t channelMask;
+    int64_t numFrames;
+
+    /// reads frames frames from fromFrame as channel interleaved float. called on a worker thread
+    std::function<void (int64_t fromFrame, int frames, float *out_return)> read;
+
+    WWLoudnessTrack(void) : sampleRate(0), numChannels(0), channelMask(0), numFrames(0) { }
+};
+
+/// measures the tracks in parallel: each track is measured on one of numThreads threads.
+/// @param numThreads 0: number of the CPU cores
+/// @param album_return WWLoudnessMeter::AlbumResult() of all the tracks
+/// @return 0: success. negative: bad track parameter
+int WWLoudnessAnalyze(const std::vector<WWLoudnessTrack> &tracks, int numThreads,
+        std::vector<WWLoudnessResult> &trackResults_return, WWLoudnessResult &album_return);
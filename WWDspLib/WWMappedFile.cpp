@@ -0,0 +1,128 @@
+#include "WWMappedFile.h"
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+WWMappedFile::WWMappedFile(void)
+    : m_data(nullptr), m_bytes(0)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+{
+}
+
+WWMappedFile::~WWMappedFile(void)
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+int
+WWMappedFile::Open(const char *path)
+{
+    Close();
+
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return Map();
+}
+
+int
+WWMappedFile::Open(const wchar_t *path)
+{
+    Close();
+
+    m_file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return Map();
+}
+
+int
+WWMappedFile::Map(void)
+{
+    LARGE_INTEGER size;
+
+    if (INVALID_HANDLE_VALUE == m_file || !GetFileSizeEx(m_file, &size) || 0 == size.QuadPart) {
+        Close();
+        return -1;
+    }
+
+    m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == m_mapping) {
+        Close();
+        return -1;
+    }
+
+    m_data = (const unsigned char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (nullptr == m_data) {
+        Close();
+        return -1;
+    }
+    m_bytes = (size_t)size.QuadPart;
+    return 0;
+}
+
+void
+WWMappedFile::Close(void)
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != m_file) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_bytes = 0;
+}
+
+#else
+
+int
+WWMappedFile::Open(const char *path)
+{
+    Close();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd, &st) || 0 == st.st_size) {
+        close(fd);
+        return -1;
+    }
+
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == p) {
+        return -1;
+    }
+
+    m_data = (const unsigned char *)p;
+    m_bytes = (size_t)st.st_size;
+    return 0;
+}
+
+void
+WWMappedFile::Close(void)
+{
+    if (m_data) {
+        munmap((void *)m_data, m_bytes);
+        m_data = nullptr;
+    }
+    m_bytes = 0;
+}
+
+#endif
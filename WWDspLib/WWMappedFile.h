@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+
+/// read only memory mapped file. Windows and POSIX
+class WWMappedFile {
+public:
+    WWMappedFile(void);
+    ~WWMappedFile(void);
+
+    /// @return 0: success. negative: could not open or map the file
+    int Open(const char *path);
+#ifdef _WIN32
+    int Open(const wchar_t *path);
+#endif
+    void Close(void);
+
+    bool IsOpen(void) const { return m_data != nullptr; }
+    const unsigned char *Data(void) const { return m_data; }
+    size_t Bytes(void) const { return m_bytes; }
+
+private:
+    const unsigned char *m_data;
+    size_t m_bytes;
+
+#ifdef _WIN32
+    /// HANDLE of the file and the file mapping object
+    void *m_file;
+    void *m_mapping;
+
+    int Map(void);
+#endif
+};
@@ -0,0 +1,501 @@
+#include "WWNoise.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_NOISE_USE_SSE
+#endif
+
+/// samples are generated by blocks of this size. 4 Gaussian pairs
+#define BLOCK_SAMPLES (8)
+
+/// random numbers are generated for this number of samples at once. a multiple of BLOCK_SAMPLES
+#define CHUNK_SAMPLES (2048)
+
+/// frames discarded at Init() so that the pink noise filter starts in the steady state
+#define PINK_WARM_UP_FRAMES (8192)
+
+/// the pink noise filter states per channel
+#define PINK_STATES (7)
+
+/// the states of the impulse response of the pink noise filter below this are 0
+#define PINK_FLUSH_THRESHOLD (1.0e-30f)
+
+/// int24 of the random number * UNIFORM_SCALE is [-1, 1)
+#define UNIFORM_SCALE (1.0f / 8388608.0f)
+
+/// the difference of 2 int24 * TPDF_SCALE is (-1, 1)
+#define TPDF_SCALE    (1.0f / 16777216.0f)
+
+/// uint24 * U24_SCALE is [0, 1)
+#define U24_SCALE     (1.0f / 16777216.0f)
+
+#define SQRTHF (0.707106781186547524f)
+#define HALF_PI (1.57079632679489662f)
+
+// logf() of Cephes Math Library by Stephen L. Moshier
+#define LOG_P0 ( 7.0376836292E-2f)
+#define LOG_P1 (-1.1514610310E-1f)
+#define LOG_P2 ( 1.1676998740E-1f)
+#define LOG_P3 (-1.2420140846E-1f)
+#define LOG_P4 ( 1.4249322787E-1f)
+#define LOG_P5 (-1.6668057665E-1f)
+#define LOG_P6 ( 2.0000714765E-1f)
+#define LOG_P7 (-2.4999993993E-1f)
+#define LOG_P8 ( 3.3333331174E-1f)
+#define LOG_Q1 (-2.12194440E-4f)
+#define LOG_Q2 ( 0.693359375f)
+
+// Taylor series of sin and cos on [0, pi/2). the error is below 1e-7
+#define SIN_C3  (-1.0f / 6.0f)
+#define SIN_C5  ( 1.0f / 120.0f)
+#define SIN_C7  (-1.0f / 5040.0f)
+#define SIN_C9  ( 1.0f / 362880.0f)
+#define SIN_C11 (-1.0f / 39916800.0f)
+#define COS_C2  (-1.0f / 2.0f)
+#define COS_C4  ( 1.0f / 24.0f)
+#define COS_C6  (-1.0f / 720.0f)
+#define COS_C8  ( 1.0f / 40320.0f)
+#define COS_C10 (-1.0f / 3628800.0f)
+#define COS_C12 ( 1.0f / 479001600.0f)
+
+/// Paul Kellet's refined pink noise filter: pole, gain of the 6 first order sections, then the direct gain
+static const float gPinkPole[6] = { 0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f };
+static const float gPinkGain[6] = { 0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f, 0.5329522f, -0.0168980f };
+#define PINK_DIRECT_GAIN  (0.5362f)
+#define PINK_DELAYED_GAIN (0.115926f)
+
+static float
+BitsToFloat(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof f);
+    return f;
+}
+
+static uint32_t
+FloatToBits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+/// log(x) of x in (0, 1]. the same operations as LogPs()
+static float
+LogF(float x)
+{
+    const uint32_t bits = FloatToBits(x);
+    float e = (float)((int32_t)(bits >> 23) - 126);
+    float m = BitsToFloat((bits & 0x007fffff) | 0x3f000000);
+
+    if (m < SQRTHF) {
+        e = e - 1.0f;
+        m = m + m - 1.0f;
+    } else {
+        m = m - 1.0f;
+    }
+
+    const float z = m * m;
+    float y = LOG_P0;
+    y = y * m + LOG_P1;
+    y = y * m + LOG_P2;
+    y = y * m + LOG_P3;
+    y = y * m + LOG_P4;
+    y = y * m + LOG_P5;
+    y = y * m + LOG_P6;
+    y = y * m + LOG_P7;
+    y = y * m + LOG_P8;
+    y = y * m * z;
+    y = y + e * LOG_Q1;
+    y = y - 0.5f * z;
+    return m + y + e * LOG_Q2;
+}
+
+/// sin and cos of the angle 2 pi (q + f) / 4 of the quadrant q and f in [0, 1). the same operations as SinCosPs()
+static void
+SinCosF(uint32_t q, float f, float &sin_return, float &cos_return)
+{
+    const float x = f * HALF_PI;
+    const float z = x * x;
+
+    float s = SIN_C11;
+    s = s * z + SIN_C9;
+    s = s * z + SIN_C7;
+    s = s * z + SIN_C5;
+    s = s * z + SIN_C3;
+    s = s * z * x + x;
+
+    float c = COS_C12;
+    c = c * z + COS_C10;
+    c = c * z + COS_C8;
+    c = c * z + COS_C6;
+    c = c * z + COS_C4;
+    c = c * z + COS_C2;
+    c = c * z + 1.0f;
+
+    // rotated by q quadrants
+    if (q & 1) {
+        std::swap(s, c);
+    }
+    cos_return = ((q + 1) & 2) ? -c : c;
+    sin_return = (q & 2) ? -s : s;
+}
+
+#ifdef WW_NOISE_USE_SSE
+
+static inline __m128
+LogPs(__m128 x)
+{
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+            _mm_set1_epi32(0x3f000000)));
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lt = _mm_cmplt_ps(m, _mm_set1_ps(SQRTHF));
+    e = _mm_sub_ps(e, _mm_and_ps(lt, one));
+    m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(lt, m)), one);
+
+    const __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set1_ps(LOG_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P5));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P6));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P7));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P8));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(LOG_Q1)));
+    y = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(LOG_Q2)));
+}
+
+static inline void
+SinCosPs(__m128i q, __m128 f, __m128 &sin_return, __m128 &cos_return)
+{
+    const __m128 x = _mm_mul_ps(f, _mm_set1_ps(HALF_PI));
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 s = _mm_set1_ps(SIN_C11);
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_C9));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_C7));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_C5));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_C3));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+    __m128 c = _mm_set1_ps(COS_C12);
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_C10));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_C8));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_C6));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_C4));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_C2));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(1.0f));
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+    const __m128 s2 = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    const __m128 c2 = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+
+    // the sign bits of the quadrants 1, 2 for cos and 2, 3 for sin
+    const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+    const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+    cos_return = _mm_xor_ps(c2, cosSign);
+    sin_return = _mm_xor_ps(s2, sinSign);
+}
+
+#endif
+
+WWNoise::WWNoise(void)
+    : m_type(WWNT_Uniform), m_numChannels(0), m_amplitude(1.0f), m_restPos(BLOCK_SAMPLES), m_ch(0), m_pinkScale(1.0f)
+{
+    memset(m_rest, 0, sizeof m_rest);
+}
+
+int
+WWNoise::Init(WWNoiseType type, int numChannels, float amplitude, uint32_t seed, uint32_t stream)
+{
+    if (type < 0 || WWNT_NUM <= type || numChannels < 1 || !(fabsf(amplitude) < 1.0e30f)) {
+        return -1;
+    }
+
+    m_type        = type;
+    m_numChannels = numChannels;
+    m_amplitude   = amplitude;
+    m_restPos     = BLOCK_SAMPLES;
+    m_ch          = 0;
+
+    if (0 == stream) {
+        m_rand.Init(seed);
+    } else {
+        const uint32_t key[2] = { seed, stream };
+        m_rand.InitByArray(key, 2);
+    }
+
+    m_randBuf.assign((size_t)std::max(2 * CHUNK_SAMPLES, CHUNK_SAMPLES + numChannels), 0);
+    m_floatBuf.assign((size_t)std::max(1, CHUNK_SAMPLES / numChannels) * numChannels, 0.0f);
+
+    m_prev.clear();
+    if (WWNT_TpdfHighPass == type) {
+        m_prev.resize(numChannels);
+        m_rand.Fill(&m_prev[0], numChannels);
+    }
+
+    m_pink.clear();
+    if (WWNT_Pink == type) {
+        // the RMS of the filter is the square root of the energy of the impulse response
+        float st[PINK_STATES] = { 0 };
+        double energy = 0;
+        for (int i=0; i<100000; ++i) {
+            const float white = (0 == i) ? 1.0f : 0.0f;
+            float y = white * PINK_DIRECT_GAIN + st[6];
+            for (int k=0; k<6; ++k) {
+                st[k] = gPinkPole[k] * st[k] + white * gPinkGain[k];
+                y += st[k];
+
+                // the decayed states are flushed: they would stay at the smallest denormal, which is slow
+                if (fabsf(st[k]) < PINK_FLUSH_THRESHOLD) {
+                    st[k] = 0;
+                }
+            }
+            st[6] = white * PINK_DELAYED_GAIN;
+            energy += (double)y * y;
+        }
+        m_pinkScale = (float)(1.0 / sqrt(energy));
+        m_pink.assign((size_t)PINK_STATES * numChannels, 0.0f);
+
+        const int chunkFrames = (int)(m_floatBuf.size() / numChannels);
+        for (int i=0; i<PINK_WARM_UP_FRAMES; i += chunkFrames) {
+            Generate(&m_floatBuf[0], std::min(chunkFrames, PINK_WARM_UP_FRAMES - i));
+        }
+    }
+    return 0;
+}
+
+void
+WWNoise::Generate(float *to_return, int64_t frames)
+{
+    assert(0 < m_numChannels);
+    int64_t n = frames * m_numChannels;
+
+    // the rest of the block of the previous call
+    while (0 < n && m_restPos < BLOCK_SAMPLES) {
+        *to_return++ = m_rest[m_restPos++];
+        --n;
+    }
+
+    while (BLOCK_SAMPLES <= n) {
+        const int count = (int)std::min(n & ~(int64_t)(BLOCK_SAMPLES - 1), (int64_t)CHUNK_SAMPLES);
+        GenerateChunk(to_return, count);
+        to_return += count;
+        n -= count;
+    }
+
+    if (0 < n) {
+        GenerateChunk(m_rest, BLOCK_SAMPLES);
+        m_restPos = 0;
+        while (0 < n) {
+            *to_return++ = m_rest[m_restPos++];
+            --n;
+        }
+    }
+}
+
+int
+WWNoise::GenerateInt(int32_t *to_return, int64_t frames, int bits)
+{
+    if (bits < 8 || (24 < bits && bits != 32)) {
+        return -1;
+    }
+
+    const float scale = (float)(1LL << (bits - 1));
+    const float lo = -scale;
+
+    // the largest float below 2^31 for 32bit
+    const float hi = (32 == bits) ? 2147483520.0f : scale - 1.0f;
+
+    const int chunkFrames = (int)(m_floatBuf.size() / m_numChannels);
+    while (0 < frames) {
+        const int nFrames = (int)std::min(frames, (int64_t)chunkFrames);
+        const int n = nFrames * m_numChannels;
+        const float *from = &m_floatBuf[0];
+        Generate(&m_floatBuf[0], nFrames);
+
+        int i = 0;
+#ifdef WW_NOISE_USE_SSE
+        {
+            const __m128 vScale = _mm_set1_ps(scale);
+            const __m128 vLo = _mm_set1_ps(lo);
+            const __m128 vHi = _mm_set1_ps(hi);
+            for (; i + 4 <= n; i += 4) {
+                const __m128 x = _mm_mul_ps(_mm_loadu_ps(&from[i]), vScale);
+
+                // rounded to the nearest by the default rounding mode
+                _mm_storeu_si128((__m128i *)&to_return[i], _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, vLo), vHi)));
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            to_return[i] = (int32_t)lrintf(std::min(std::max(from[i] * scale, lo), hi));
+        }
+
+        to_return += n;
+        frames -= nFrames;
+    }
+    return 0;
+}
+
+void
+WWNoise::GenerateChunk(float *to_return, int n)
+{
+    assert(0 == n % BLOCK_SAMPLES && n <= CHUNK_SAMPLES);
+    const int nCh = m_numChannels;
+    const WWNoiseType white = (WWNT_Pink == m_type) ? WWNT_Gaussian : m_type;
+    const float amp = (WWNT_Pink == m_type) ? 1.0f : m_amplitude;
+    uint32_t *r = &m_randBuf[0];
+    int i = 0;
+
+    switch (white) {
+    case WWNT_Uniform:
+        m_rand.Fill(r, n);
+#ifdef WW_NOISE_USE_SSE
+        {
+            const __m128 s = _mm_set1_ps(amp * UNIFORM_SCALE);
+            for (; i < n; i += 4) {
+                const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&r[i]), 8);
+                _mm_storeu_ps(&to_return[i], _mm_mul_ps(_mm_cvtepi32_ps(a), s));
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            to_return[i] = (float)((int32_t)r[i] >> 8) * (amp * UNIFORM_SCALE);
+        }
+        break;
+
+    case WWNT_Tpdf:
+        // the samples 4g+k of the group of 4 are of the random numbers 8g+k and 8g+4+k
+        m_rand.Fill(r, 2 * n);
+#ifdef WW_NOISE_USE_SSE
+        {
+            const __m128 s = _mm_set1_ps(amp * TPDF_SCALE);
+            for (; i < n; i += 4) {
+                const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&r[2 * i]), 8);
+                const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&r[2 * i + 4]), 8);
+                _mm_storeu_ps(&to_return[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(a, b)), s));
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            const int g = i & ~3;
+            const int k = i & 3;
+            to_return[i] = (float)(((int32_t)r[2 * g + k] >> 8) - ((int32_t)r[2 * g + 4 + k] >> 8)) * (amp * TPDF_SCALE);
+        }
+        break;
+
+    case WWNT_TpdfHighPass:
+        // r[nCh + i] is the random number of the sample i and r[i] is the previous one of the channel
+        memcpy(r, &m_prev[0], sizeof(uint32_t) * nCh);
+        m_rand.Fill(&r[nCh], n);
+#ifdef WW_NOISE_USE_SSE
+        {
+            const __m128 s = _mm_set1_ps(amp * TPDF_SCALE);
+            for (; i < n; i += 4) {
+                const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&r[nCh + i]), 8);
+                const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&r[i]), 8);
+                _mm_storeu_ps(&to_return[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(a, b)), s));
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            to_return[i] = (float)(((int32_t)r[nCh + i] >> 8) - ((int32_t)r[i] >> 8)) * (amp * TPDF_SCALE);
+        }
+        memcpy(&m_prev[0], &r[n], sizeof(uint32_t) * nCh);
+        break;
+
+    case WWNT_Gaussian:
+        // the group of 8 samples: u1 of the random numbers 8g..8g+3 and the angle of 8g+4..8g+7.
+        // the samples 8g+k are r cos and 8g+4+k are r sin. the top 2 bits of the angle are the quadrant
+        m_rand.Fill(r, n);
+#ifdef WW_NOISE_USE_SSE
+        {
+            const __m128 vAmp = _mm_set1_ps(amp);
+            const __m128 vU24 = _mm_set1_ps(U24_SCALE);
+            const __m128 vMinus2 = _mm_set1_ps(-2.0f);
+            const __m128i one = _mm_set1_epi32(1);
+            const __m128i mask24 = _mm_set1_epi32(0x00ffffff);
+            for (; i < n; i += 8) {
+                const __m128i a = _mm_loadu_si128((const __m128i *)&r[i]);
+                const __m128i b = _mm_loadu_si128((const __m128i *)&r[i + 4]);
+
+                // (0, 1]
+                const __m128 u1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_srli_epi32(a, 8), one)), vU24);
+                const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(b, 6), mask24)), vU24);
+                const __m128i q = _mm_srli_epi32(b, 30);
+
+                const __m128 radius = _mm_mul_ps(_mm_sqrt_ps(_mm_mul_ps(vMinus2, LogPs(u1))), vAmp);
+                __m128 sn;
+                __m128 cs;
+                SinCosPs(q, f, sn, cs);
+                _mm_storeu_ps(&to_return[i], _mm_mul_ps(radius, cs));
+                _mm_storeu_ps(&to_return[i + 4], _mm_mul_ps(radius, sn));
+            }
+        }
+#endif
+        for (; i < n; i += 8) {
+            for (int k=0; k<4; ++k) {
+                const uint32_t a = r[i + k];
+                const uint32_t b = r[i + 4 + k];
+                const float u1 = (float)((a >> 8) + 1) * U24_SCALE;
+                const float f = (float)((b >> 6) & 0x00ffffff) * U24_SCALE;
+
+                const float radius = sqrtf(-2.0f * LogF(u1)) * amp;
+                float sn;
+                float cs;
+                SinCosF(b >> 30, f, sn, cs);
+                to_return[i + k] = radius * cs;
+                to_return[i + 4 + k] = radius * sn;
+            }
+        }
+        break;
+
+    default:
+        assert(0);
+        break;
+    }
+
+    if (WWNT_Pink == m_type) {
+        FilterPink(to_return, n);
+    }
+
+    m_ch = (m_ch + n) % nCh;
+}
+
+void
+WWNoise::FilterPink(float *io, int n)
+{
+    const float scale = m_amplitude * m_pinkScale;
+    int ch = m_ch;
+
+    for (int i=0; i<n; ++i) {
+        float *st = &m_pink[(size_t)ch * PINK_STATES];
+        const float white = io[i];
+
+        float y = white * PINK_DIRECT_GAIN + st[6];
+        for (int k=0; k<6; ++k) {
+            st[k] = gPinkPole[k] * st[k] + white * gPinkGain[k];
+            y += st[k];
+        }
+        st[6] = white * PINK_DELAYED_GAIN;
+        io[i] = y * scale;
+
+        if (m_numChannels <= ++ch) {
+            ch = 0;
+        }
+    }
+}
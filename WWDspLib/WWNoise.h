@@ -0,0 +1,87 @@
+#pragma once
+
+#include "WWSfmt.h"
+#include <stdint.h>
+#include <vector>
+
+enum WWNoiseType {
+    /// uniform of [-1, 1)
+    WWNT_Uniform,
+
+    /// triangular of (-1, 1): the sum of 2 uniform random numbers. the dither of 2 LSB peak to peak
+    WWNT_Tpdf,
+
+    /// triangular of (-1, 1) of the difference of the successive uniform random numbers of a channel.
+    /// the spectrum rises 6dB/oct: less noise in the audio band for the same peak. 1 random number per sample
+    WWNT_TpdfHighPass,
+
+    /// normal distribution of the standard deviation 1. Box-Muller transform
+    WWNT_Gaussian,
+
+    /// Gaussian noise of -3dB/oct by the filter of Paul Kellet, RMS 1. for 44.1kHz to 96kHz
+    WWNT_Pink,
+
+    WWNT_NUM
+};
+
+/// Noise generator of the SFMT random number stream, channel interleaved.
+///
+///   The random numbers are generated in chunks by WWSfmt and converted 4 samples at once by SSE2,
+///   the logarithm and the sine of the Gaussian noise by polynomials. The pink noise filter is a recursion
+///   per channel and computed sample by sample.
+///   An instance has its own stream: the threads use an instance each with the same seed and a different stream.
+///   The output depends only on the type, the channels, the amplitude, the seed and the stream,
+///   not on the number of the samples of the calls.
+class WWNoise {
+public:
+    WWNoise(void);
+
+    /// @param amplitude multiplies the noise. 1.0: the peak or the standard deviation of the type is full scale
+    /// @param stream another stream of the same seed. 0 is the same SFMT sequence as WWSfmt::Init(seed)
+    /// @return 0: success. negative: bad parameter
+    int Init(WWNoiseType type, int numChannels, float amplitude, uint32_t seed = 5489, uint32_t stream = 0);
+
+    WWNoiseType Type(void) const { return m_type; }
+    int NumChannels(void) const { return m_numChannels; }
+
+    /// @param to_return frames * NumChannels() floats
+    void Generate(float *to_return, int64_t frames);
+
+    /// the noise quantized to integers: the full scale is 2^(bits-1). rounded to the nearest and clipped
+    /// @param bits 8 to 24, or 32. the noise has 24bit of precision
+    /// @param to_return frames * NumChannels() integers of [-2^(bits-1), 2^(bits-1)-1]
+    /// @return 0: success. negative: bad bits
+    int GenerateInt(int32_t *to_return, int64_t frames, int bits);
+
+private:
+    WWNoiseType m_type;
+    int m_numChannels;
+    float m_amplitude;
+
+    WWSfmt m_rand;
+
+    /// random numbers of a chunk
+    std::vector<uint32_t> m_randBuf;
+
+    /// samples of a chunk of GenerateInt()
+    std::vector<float> m_floatBuf;
+
+    /// the samples of the last block not returned yet. the blocks keep the output independent of the call sizes
+    float m_rest[8];
+    int m_restPos;
+
+    /// the channel of the next sample generated
+    int m_ch;
+
+    /// WWNT_TpdfHighPass: the last NumChannels() random numbers
+    std::vector<uint32_t> m_prev;
+
+    /// WWNT_Pink: 7 filter states of the channels
+    std::vector<float> m_pink;
+
+    /// WWNT_Pink: 1 / RMS of the filter of Gaussian noise
+    float m_pinkScale;
+
+    void GenerateChunk(float *to_return, int n);
+    void FilterPink(float *io, int n);
+};
@@ -0,0 +1,323 @@
+#include "WWNonUniformConvolver.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// block size grows by this factor per stage
+#define STAGE_GROWTH (4)
+
+struct WWNonUniformConvolver::Stage {
+    /// first tap and number of taps of the filter segment of this stage
+    int offset;
+    int taps;
+    int blockFrames;
+
+    WWPartitionedConvolver conv;
+
+    /// input frames of the current block given to Process() so far. channel interleaved
+    std::vector<float> inAccum;
+    int fill;
+
+    /// block handed to the stage thread and its output
+    std::vector<float> jobIn;
+    std::vector<float> jobOut;
+
+    /// output of the stage thread, read by Process(). channel interleaved ring buffer of ringFrames frames
+    std::vector<float> ring;
+    int ringFrames;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    /// number of blocks submitted to / completed by the stage thread. guarded by mutex
+    int64_t submitted;
+    int64_t completed;
+    bool quit;
+
+    std::thread thread;
+
+    Stage(void) : offset(0), taps(0), blockFrames(0), fill(0), ringFrames(0), submitted(0), completed(0), quit(false) { }
+};
+
+static bool
+IsPowerOf2(int v)
+{
+    return 0 < v && (v & (v - 1)) == 0;
+}
+
+WWNonUniformConvolver::WWNonUniformConvolver(void)
+    : m_headTaps(0), m_frameCount(0)
+{
+}
+
+WWNonUniformConvolver::~WWNonUniformConvolver(void)
+{
+    Term();
+}
+
+int
+WWNonUniformConvolver::Init(int numInputs, int numOutputs, int firstBlockFrames, int maxBlockFrames, int maxTaps,
+        const float * const *stageSpectra, bool diagonal)
+{
+    Term();
+
+    if (numInputs < 1 || numOutputs < 1 || maxTaps < 1
+            || !IsPowerOf2(firstBlockFrames) || !IsPowerOf2(maxBlockFrames) || maxBlockFrames < firstBlockFrames) {
+        return -1;
+    }
+
+    // stage of block size B covers taps [2B, 2B'), where B' is the block size of the next stage.
+    // the first stage covers taps from 0. the stage of maxBlockFrames covers the rest of the filter
+    int offset = 0;
+    int B = firstBlockFrames;
+    for (int stage=0; ; ++stage) {
+        const int nextB = std::min(B * STAGE_GROWTH, maxBlockFrames);
+        const int nextOffset = 2 * nextB;
+        const bool last = (B == maxBlockFrames || maxTaps <= nextOffset);
+        const int taps = last ? (maxTaps - offset) : (nextOffset - offset);
+
+        const float *spectra = stageSpectra ? stageSpectra[stage] : nullptr;
+
+        if (0 == offset) {
+            if (m_head.Init(numInputs, numOutputs, B, taps, spectra, diagonal) < 0) {
+                Term();
+                return -1;
+            }
+            m_headTaps = taps;
+        } else {
+            Stage *s = new Stage();
+            s->offset      = offset;
+            s->taps        = taps;
+            s->blockFrames = B;
+            if (s->conv.Init(numInputs, numOutputs, B, taps, spectra, diagonal) < 0) {
+                delete s;
+                Term();
+                return -1;
+            }
+
+            // Process() reads the output of a block from offset + firstBlockFrames frames after the block start.
+            // the ring holds the unread part and the block being written by the stage thread
+            s->ringFrames = (offset + firstBlockFrames + 2 * B + B - 1) / B * B;
+
+            s->inAccum.assign((size_t)B * numInputs, 0.0f);
+            s->jobIn.assign((size_t)B * numInputs, 0.0f);
+            s->jobOut.assign((size_t)B * numOutputs, 0.0f);
+            s->ring.assign((size_t)s->ringFrames * numOutputs, 0.0f);
+
+            m_stages.push_back(s);
+        }
+
+        if (last) {
+            break;
+        }
+        offset = nextOffset;
+        B = nextB;
+    }
+
+    for (size_t i=0; i<m_stages.size(); ++i) {
+        Stage *s = m_stages[i];
+        s->thread = std::thread(&WWNonUniformConvolver::StageThread, this, s);
+    }
+
+    m_frameCount = 0;
+    return 0;
+}
+
+void
+WWNonUniformConvolver::Term(void)
+{
+    for (size_t i=0; i<m_stages.size(); ++i) {
+        Stage *s = m_stages[i];
+        if (s->thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(s->mutex);
+                s->quit = true;
+            }
+            s->cv.notify_all();
+            s->thread.join();
+        }
+        delete s;
+    }
+    m_stages.clear();
+
+    m_head.Term();
+    m_headTaps = 0;
+    m_frameCount = 0;
+}
+
+int
+WWNonUniformConvolver::StageBlockFrames(int stage) const
+{
+    assert(0 <= stage && stage < NumStages());
+
+    if (0 == stage) {
+        return m_head.BlockFrames();
+    }
+    return m_stages[stage - 1]->blockFrames;
+}
+
+const WWPartitionedConvolver &
+WWNonUniformConvolver::StageConvolver(int stage) const
+{
+    assert(0 <= stage && stage < NumStages());
+
+    if (0 == stage) {
+        return m_head;
+    }
+    return m_stages[stage - 1]->conv;
+}
+
+void
+WWNonUniformConvolver::SetFilter(int in, int out, const float *h, int taps)
+{
+    m_head.SetFilter(in, out, h, std::min(taps, m_headTaps));
+
+    for (size_t i=0; i<m_stages.size(); ++i) {
+        Stage *s = m_stages[i];
+        const int n = std::min(taps - s->offset, s->taps);
+        if (n <= 0) {
+            s->conv.SetFilter(in, out, h, 0);
+        } else {
+            s->conv.SetFilter(in, out, &h[s->offset], n);
+        }
+    }
+}
+
+void
+WWNonUniformConvolver::Reset(void)
+{
+    for (size_t i=0; i<m_stages.size(); ++i) {
+        Stage *s = m_stages[i];
+
+        std::unique_lock<std::mutex> lock(s->mutex);
+        s->cv.wait(lock, [s] { return s->completed == s->submitted; });
+
+        s->conv.Reset();
+        std::fill(s->inAccum.begin(), s->inAccum.end(), 0.0f);
+        std::fill(s->ring.begin(), s->ring.end(), 0.0f);
+        s->fill = 0;
+        s->submitted = 0;
+        s->completed = 0;
+    }
+
+    m_head.Reset();
+    m_frameCount = 0;
+}
+
+size_t
+WWNonUniformConvolver::AllocatedBytes(void) const
+{
+    size_t bytes = m_head.AllocatedBytes();
+    for (size_t i=0; i<m_stages.size(); ++i) {
+        const Stage *s = m_stages[i];
+        bytes += s->conv.AllocatedBytes()
+            + sizeof(float) * (s->inAccum.size() + s->jobIn.size() + s->jobOut.size() + s->ring.size());
+    }
+    return bytes;
+}
+
+void
+WWNonUniformConvolver::StageThread(Stage *s)
+{
+    const int B = s->blockFrames;
+    const int numOutputs = NumOutputs();
+
+    std::unique_lock<std::mutex> lock(s->mutex);
+    for (;;) {
+        s->cv.wait(lock, [s] { return s->quit || s->completed < s->submitted; });
+        if (s->quit) {
+            break;
+        }
+        const int64_t job = s->completed;
+        lock.unlock();
+
+        s->conv.ProcessAlignedBlock(&s->jobIn[0], &s->jobOut[0]);
+
+        const size_t pos = (size_t)((job * B) % s->ringFrames) * numOutputs;
+        memcpy(&s->ring[pos], &s->jobOut[0], sizeof(float) * B * numOutputs);
+
+        lock.lock();
+        ++s->completed;
+        s->cv.notify_all();
+    }
+}
+
+/// hands the filled input block to the stage thread
+void
+WWNonUniformConvolver::SubmitStage(Stage *s)
+{
+    {
+        std::unique_lock<std::mutex> lock(s->mutex);
+
+        // the previous block has the whole block time to finish. usually it is already done
+        s->cv.wait(lock, [s] { return s->completed == s->submitted; });
+
+        s->jobIn.swap(s->inAccum);
+        ++s->submitted;
+    }
+    s->cv.notify_all();
+    s->fill = 0;
+}
+
+/// waits until the block job of the stage is completed
+void
+WWNonUniformConvolver::WaitStage(Stage *s, int64_t job)
+{
+    std::unique_lock<std::mutex> lock(s->mutex);
+    assert(job < s->submitted);
+    s->cv.wait(lock, [s, job] { return job < s->completed; });
+}
+
+void
+WWNonUniformConvolver::Process(const float *in, int frames, float *out_return)
+{
+    const int B0 = m_head.BlockFrames();
+    const int numInputs = NumInputs();
+    const int numOutputs = NumOutputs();
+
+    int pos = 0;
+    while (pos < frames) {
+        // a chunk does not cross the block boundary of the first stage, hence of any stage
+        const int n = std::min(frames - pos, B0 - (int)(m_frameCount % B0));
+        const float *x = &in[(size_t)pos * numInputs];
+        float *y = &out_return[(size_t)pos * numOutputs];
+
+        m_head.Process(x, n, y);
+
+        for (size_t i=0; i<m_stages.size(); ++i) {
+            Stage *s = m_stages[i];
+            memcpy(&s->inAccum[(size_t)s->fill * numInputs], x, sizeof(float) * n * numInputs);
+            s->fill += n;
+            if (s->fill == s->blockFrames) {
+                SubmitStage(s);
+            }
+        }
+
+        for (size_t i=0; i<m_stages.size(); ++i) {
+            Stage *s = m_stages[i];
+
+            // stage output frame m is the output frame m + offset + B0
+            const int64_t mBegin = m_frameCount - s->offset - B0;
+            const int64_t mEnd   = mBegin + n;
+            if (mEnd <= 0) {
+                continue;
+            }
+
+            WaitStage(s, (mEnd - 1) / s->blockFrames);
+
+            for (int64_t m=std::max(mBegin, (int64_t)0); m<mEnd; ++m) {
+                const float *r = &s->ring[(size_t)(m % s->ringFrames) * numOutputs];
+                float *o = &y[(size_t)(m - mBegin) * numOutputs];
+                for (int ch=0; ch<numOutputs; ++ch) {
+                    o[ch] += r[ch];
+                }
+            }
+        }
+
+        m_frameCount += n;
+        pos += n;
+    }
+}
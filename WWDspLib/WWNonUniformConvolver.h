@@ -0,0 +1,85 @@
+#pragma once
+
+#include "WWPartitionedConvolver.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Multichannel FIR convolver for long filters. non-uniformly partitioned.
+///
+///   The head of the filter is convolved by a WWPartitionedConvolver of firstBlockFrames on the caller thread,
+///   so the latency is firstBlockFrames frames as WWPartitionedConvolver.
+///   The rest of the filter is split into stages of geometrically growing block size (4x per stage,
+///   up to maxBlockFrames). A stage of block size B starts at tap 2B: each input block of the stage is
+///   convolved on the background thread of the stage and has B frames of time until its output is needed.
+///   The CPU cost per frame is close to a single large FFT, while the latency is that of the small first block.
+///
+/// If the filter fits in the first stage, no thread is created and it is the same as WWPartitionedConvolver.
+/// Process() waits for a background stage when the stage has not finished in time.
+class WWNonUniformConvolver {
+public:
+    WWNonUniformConvolver(void);
+    ~WWNonUniformConvolver(void);
+
+    /// @param firstBlockFrames block size of the first stage. power of 2. this is the latency
+    /// @param maxBlockFrames   largest block size of the stages. power of 2, firstBlockFrames or larger
+    /// @param maxTaps          longest filter which will be given to SetFilter()
+    /// @param stageSpectra     nullptr: filters are set by SetFilter().
+    ///        otherwise StageFilterSpectra() of each stage saved beforehand. used in place as WWPartitionedConvolver::Init()
+    /// @param diagonal true: input ch is filtered to output ch only. see WWPartitionedConvolver::Init()
+    /// @return 0: success. negative: bad parameter
+    int Init(int numInputs, int numOutputs, int firstBlockFrames, int maxBlockFrames, int maxTaps,
+            const float * const *stageSpectra = nullptr, bool diagonal = false);
+    void Term(void);
+
+    /// sets filter from input in to output out. unset filters are zero.
+    /// call this before Process() or after Reset().
+    /// @param taps maxTaps or shorter
+    void SetFilter(int in, int out, const float *h, int taps);
+
+    /// clears the signal history. filters are kept
+    void Reset(void);
+
+    int NumInputs(void) const { return m_head.NumInputs(); }
+    int NumOutputs(void) const { return m_head.NumOutputs(); }
+
+    /// @return number of stages including the first stage
+    int NumStages(void) const { return 1 + (int)m_stages.size(); }
+
+    /// @return block size of the stage
+    int StageBlockFrames(int stage) const;
+
+    /// @return partition spectra of the stage, to be saved and given to Init() later
+    const float *StageFilterSpectra(int stage) const { return StageConvolver(stage).FilterSpectra(); }
+    size_t StageFilterSpectraFloats(int stage) const { return StageConvolver(stage).FilterSpectraFloats(); }
+
+    /// @return output is delayed by this number of frames
+    int LatencyFrames(void) const { return m_head.LatencyFrames(); }
+
+    /// @return bytes allocated for the filter spectra, delay lines and work area of all stages
+    size_t AllocatedBytes(void) const;
+
+    /// any number of frames can be processed at once.
+    /// @param in  channel interleaved. frames * NumInputs() floats
+    /// @param out_return channel interleaved. frames * NumOutputs() floats
+    void Process(const float *in, int frames, float *out_return);
+
+private:
+    struct Stage;
+
+    /// first stage. taps [0, length of the first stage)
+    WWPartitionedConvolver m_head;
+    int m_headTaps;
+
+    /// background stages
+    std::vector<Stage *> m_stages;
+
+    /// frames given to Process() after Reset()
+    int64_t m_frameCount;
+
+    const WWPartitionedConvolver &StageConvolver(int stage) const;
+
+    void StageThread(Stage *s);
+    void SubmitStage(Stage *s);
+    void WaitStage(Stage *s, int64_t job);
+};
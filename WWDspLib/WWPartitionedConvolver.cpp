@@ -0,0 +1,251 @@
+#include "WWPartitionedConvolver.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <xmmintrin.h>
+#  define WW_PARTITIONED_CONVOLVER_USE_SSE
+#endif
+
+/// acc += a * b on split complex arrays of n elements. n is a multiple of 4
+static void
+ComplexMulAdd(const float *aRe, const float *aIm, const float *bRe, const float *bIm,
+        float *accRe, float *accIm, int n)
+{
+#ifdef WW_PARTITIONED_CONVOLVER_USE_SSE
+    for (int i=0; i<n; i += 4) {
+        const __m128 ar = _mm_loadu_ps(&aRe[i]);
+        const __m128 ai = _mm_loadu_ps(&aIm[i]);
+        const __m128 br = _mm_loadu_ps(&bRe[i]);
+        const __m128 bi = _mm_loadu_ps(&bIm[i]);
+
+        const __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+        const __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+
+        _mm_storeu_ps(&accRe[i], _mm_add_ps(_mm_loadu_ps(&accRe[i]), re));
+        _mm_storeu_ps(&accIm[i], _mm_add_ps(_mm_loadu_ps(&accIm[i]), im));
+    }
+#else
+    for (int i=0; i<n; ++i) {
+        accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+#endif
+}
+
+WWPartitionedConvolver::WWPartitionedConvolver(void)
+    : m_numInputs(0), m_numOutputs(0), m_blockFrames(0), m_numPartitions(0), m_diagonal(false), m_binStride(0),
+      m_filterSpectraRef(nullptr), m_fdlHead(0), m_fill(0)
+{
+}
+
+WWPartitionedConvolver::~WWPartitionedConvolver(void)
+{
+    Term();
+}
+
+int
+WWPartitionedConvolver::Init(int numInputs, int numOutputs, int blockFrames, int maxTaps, const float *filterSpectra,
+        bool diagonal)
+{
+    if (numInputs < 1 || numOutputs < 1 || maxTaps < 1 || (diagonal && numInputs != numOutputs)) {
+        return -1;
+    }
+    if (m_fft.Init(blockFrames * 2) < 0) {
+        return -1;
+    }
+
+    m_numInputs     = numInputs;
+    m_numOutputs    = numOutputs;
+    m_blockFrames   = blockFrames;
+    m_numPartitions = (maxTaps + blockFrames - 1) / blockFrames;
+    m_diagonal      = diagonal;
+    m_binStride     = (m_fft.NumBins() + 3) & ~3;
+
+    const size_t spectrumFloats = (size_t)m_binStride * 2;
+
+    if (filterSpectra) {
+        std::vector<float>().swap(m_filterSpectra);
+        m_filterSpectraRef = filterSpectra;
+    } else {
+        m_filterSpectra.assign(spectrumFloats * NumFilters() * m_numPartitions, 0.0f);
+        m_filterSpectraRef = &m_filterSpectra[0];
+    }
+    m_fdl.assign(spectrumFloats * numInputs * m_numPartitions, 0.0f);
+    m_inTime.assign((size_t)blockFrames * 2 * numInputs, 0.0f);
+    m_outTime.assign((size_t)blockFrames * numOutputs, 0.0f);
+    m_accum.assign(spectrumFloats, 0.0f);
+    m_work.assign((size_t)blockFrames * 2, 0.0f);
+
+    m_fdlHead = 0;
+    m_fill    = 0;
+    return 0;
+}
+
+void
+WWPartitionedConvolver::Term(void)
+{
+    m_fft.Term();
+    m_filterSpectra.clear();
+    m_filterSpectraRef = nullptr;
+    m_fdl.clear();
+    m_inTime.clear();
+    m_outTime.clear();
+    m_accum.clear();
+    m_work.clear();
+
+    m_numInputs     = 0;
+    m_numOutputs    = 0;
+    m_blockFrames   = 0;
+    m_numPartitions = 0;
+    m_diagonal      = false;
+    m_binStride     = 0;
+}
+
+void
+WWPartitionedConvolver::SetFilter(int in, int out, const float *h, int taps)
+{
+    assert(0 <= in && in < m_numInputs);
+    assert(0 <= out && out < m_numOutputs);
+    assert(!m_diagonal || in == out);
+    assert(taps <= m_numPartitions * m_blockFrames);
+    assert(!m_filterSpectra.empty());
+
+    const int B = m_blockFrames;
+
+    // the inverse FFT is not normalized. the scale is folded into the filter spectra
+    const float scale = 1.0f / (float)(2 * B);
+
+    for (int p=0; p<m_numPartitions; ++p) {
+        std::fill(m_work.begin(), m_work.end(), 0.0f);
+        for (int i=0; i<B; ++i) {
+            const int t = p * B + i;
+            if (t < taps) {
+                m_work[i] = h[t] * scale;
+            }
+        }
+
+        float *s = &m_filterSpectra[FilterSpectrumIndex(in, out, p)];
+        memset(s, 0, sizeof(float) * m_binStride * 2);
+        m_fft.Forward(&m_work[0], &s[0], &s[m_binStride]);
+    }
+}
+
+void
+WWPartitionedConvolver::Reset(void)
+{
+    std::fill(m_fdl.begin(), m_fdl.end(), 0.0f);
+    std::fill(m_inTime.begin(), m_inTime.end(), 0.0f);
+    std::fill(m_outTime.begin(), m_outTime.end(), 0.0f);
+    m_fdlHead = 0;
+    m_fill    = 0;
+}
+
+size_t
+WWPartitionedConvolver::FilterSpectraFloats(void) const
+{
+    return (size_t)m_binStride * 2 * NumFilters() * m_numPartitions;
+}
+
+size_t
+WWPartitionedConvolver::AllocatedBytes(void) const
+{
+    return sizeof(float) * (m_filterSpectra.size() + m_fdl.size() + m_inTime.size()
+            + m_outTime.size() + m_accum.size() + m_work.size());
+}
+
+void
+WWPartitionedConvolver::ProcessBlock(void)
+{
+    const int B = m_blockFrames;
+    const int P = m_numPartitions;
+    const int S = m_binStride;
+
+    // newest input block spectrum goes to the head of the delay line
+    m_fdlHead = (m_fdlHead + P - 1) % P;
+    for (int in=0; in<m_numInputs; ++in) {
+        float *x = &m_inTime[(size_t)in * B * 2];
+        float *s = FdlSpectrum(in, m_fdlHead);
+        m_fft.Forward(x, &s[0], &s[S]);
+
+        // current block becomes the previous block of the next time
+        memcpy(&x[0], &x[B], sizeof(float) * B);
+    }
+
+    for (int out=0; out<m_numOutputs; ++out) {
+        std::fill(m_accum.begin(), m_accum.end(), 0.0f);
+        float *accRe = &m_accum[0];
+        float *accIm = &m_accum[S];
+
+        const int inBegin = m_diagonal ? out : 0;
+        const int inEnd   = m_diagonal ? out + 1 : m_numInputs;
+        for (int in=inBegin; in<inEnd; ++in) {
+            for (int p=0; p<P; ++p) {
+                const float *x = FdlSpectrum(in, (m_fdlHead + p) % P);
+                const float *h = &m_filterSpectraRef[FilterSpectrumIndex(in, out, p)];
+                ComplexMulAdd(&x[0], &x[S], &h[0], &h[S], accRe, accIm, S);
+            }
+        }
+
+        // overlap-save: the first half is circular convolution garbage, the second half is the output
+        m_fft.Inverse(accRe, accIm, &m_work[0]);
+        memcpy(&m_outTime[(size_t)out * B], &m_work[B], sizeof(float) * B);
+    }
+}
+
+void
+WWPartitionedConvolver::Process(const float *in, int frames, float *out_return)
+{
+    const int B = m_blockFrames;
+
+    int pos = 0;
+    while (pos < frames) {
+        const int n = std::min(frames - pos, B - m_fill);
+
+        for (int ch=0; ch<m_numInputs; ++ch) {
+            float *x = &m_inTime[(size_t)ch * B * 2 + B + m_fill];
+            for (int i=0; i<n; ++i) {
+                x[i] = in[(pos + i) * m_numInputs + ch];
+            }
+        }
+        for (int ch=0; ch<m_numOutputs; ++ch) {
+            const float *y = &m_outTime[(size_t)ch * B + m_fill];
+            for (int i=0; i<n; ++i) {
+                out_return[(pos + i) * m_numOutputs + ch] = y[i];
+            }
+        }
+
+        m_fill += n;
+        pos    += n;
+
+        if (m_fill == B) {
+            ProcessBlock();
+            m_fill = 0;
+        }
+    }
+}
+
+void
+WWPartitionedConvolver::ProcessAlignedBlock(const float *in, float *out_return)
+{
+    assert(0 == m_fill);
+
+    const int B = m_blockFrames;
+
+    for (int ch=0; ch<m_numInputs; ++ch) {
+        float *x = &m_inTime[(size_t)ch * B * 2 + B];
+        for (int i=0; i<B; ++i) {
+            x[i] = in[i * m_numInputs + ch];
+        }
+    }
+
+    ProcessBlock();
+
+    for (int ch=0; ch<m_numOutputs; ++ch) {
+        const float *y = &m_outTime[(size_t)ch * B];
+        for (int i=0; i<B; ++i) {
+            out_return[i * m_numOutputs + ch] = y[i];
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "WWFft.h"
+#include <stddef.h>
+#include <vector>
+
+/// Multichannel FIR convolver. uniformly partitioned overlap-save.
+///
+///   Each output is the sum of the inputs convolved with their filters (a numInputs x numOutputs filter matrix).
+///   The filters are split into partitions of blockFrames taps and transformed once by SetFilter().
+///   Every blockFrames input frames, each input block is transformed once and pushed to the frequency-domain
+///   delay line of the input, the delay line is multiplied element-wise with the partition spectra (SSE when available)
+///   and accumulated, and each output is transformed back once.
+///
+/// Memory is proportional to the filter length and does not depend on the length of the signal.
+/// Latency is blockFrames frames.
+class WWPartitionedConvolver {
+public:
+    WWPartitionedConvolver(void);
+    ~WWPartitionedConvolver(void);
+
+    /// @param blockFrames partition size. power of 2
+    /// @param maxTaps     longest filter which will be given to SetFilter()
+    /// @param filterSpectra nullptr: filters are set by SetFilter().
+    ///        otherwise FilterSpectraFloats() floats of FilterSpectra() saved beforehand (e.g. memory mapped cache file).
+    ///        it is used in place, not copied: it should be kept until Term(). SetFilter() can not be used
+    /// @param diagonal true: input ch is filtered to output ch only (numInputs == numOutputs).
+    ///        the filter spectra and the cost are of numInputs filters instead of numInputs x numOutputs
+    /// @return 0: success. negative: bad parameter
+    int Init(int numInputs, int numOutputs, int blockFrames, int maxTaps, const float *filterSpectra = nullptr,
+            bool diagonal = false);
+    void Term(void);
+
+    /// sets filter from input in to output out. unset filters are zero.
+    /// when diagonal, in and out should be the same.
+    /// @param taps maxTaps or shorter
+    void SetFilter(int in, int out, const float *h, int taps);
+
+    /// clears the signal history. filters are kept
+    void Reset(void);
+
+    int NumInputs(void) const { return m_numInputs; }
+    int NumOutputs(void) const { return m_numOutputs; }
+    int BlockFrames(void) const { return m_blockFrames; }
+    int NumPartitions(void) const { return m_numPartitions; }
+    bool IsDiagonal(void) const { return m_diagonal; }
+
+    /// @return output is delayed by this number of frames
+    int LatencyFrames(void) const { return m_blockFrames; }
+
+    /// @return bytes allocated for the filter spectra, delay lines and work area
+    size_t AllocatedBytes(void) const;
+
+    /// @return partition spectra of all filters, to be saved and given to Init() later
+    const float *FilterSpectra(void) const { return m_filterSpectraRef; }
+    size_t FilterSpectraFloats(void) const;
+
+    /// any number of frames can be processed at once.
+    /// @param in  channel interleaved. frames * NumInputs() floats
+    /// @param out_return channel interleaved. frames * NumOutputs() floats
+    void Process(const float *in, int frames, float *out_return);
+
+    /// processes exactly BlockFrames() frames. the output is the convolution for the same frames as the input,
+    /// without the block latency of Process(). used by the stages of WWNonUniformConvolver.
+    /// do not mix with Process() unless Reset() is called in between.
+    /// @param in  channel interleaved. BlockFrames() * NumInputs() floats
+    /// @param out_return channel interleaved. BlockFrames() * NumOutputs() floats
+    void ProcessAlignedBlock(const float *in, float *out_return);
+
+private:
+    int m_numInputs;
+    int m_numOutputs;
+    int m_blockFrames;
+    int m_numPartitions;
+    bool m_diagonal;
+
+    /// bins per spectrum, rounded up to a multiple of 4
+    int m_binStride;
+
+    WWRealFft m_fft;
+
+    /// [(in * numOutputs + out) * numPartitions + p] spectra, [in * numPartitions + p] when diagonal.
+    /// real parts followed by imaginary parts
+    std::vector<float> m_filterSpectra;
+
+    /// m_filterSpectra or the spectra given to Init()
+    const float *m_filterSpectraRef;
+
+    /// [in * numPartitions + slot] spectra. ring buffer of the input block spectra
+    std::vector<float> m_fdl;
+    int m_fdlHead;
+
+    /// [in] previous block and current block: 2 * blockFrames samples
+    std::vector<float> m_inTime;
+
+    /// [out] last output block
+    std::vector<float> m_outTime;
+
+    /// frames of the current block given to Process() so far
+    int m_fill;
+
+    std::vector<float> m_accum;
+    std::vector<float> m_work;
+
+    int NumFilters(void) const { return m_diagonal ? m_numInputs : m_numInputs * m_numOutputs; }
+
+    size_t FilterSpectrumIndex(int in, int out, int p) const {
+        const int filter = m_diagonal ? in : (in * m_numOutputs + out);
+        return (size_t)(filter * m_numPartitions + p) * m_binStride * 2;
+    }
+    float *FdlSpectrum(int in, int slot) {
+        return &m_fdl[(size_t)(in * m_numPartitions + slot) * m_binStride * 2];
+    }
+
+    void ProcessBlock(void);
+};
@@ -0,0 +1,191 @@
+#include "WWQuantizer.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_QUANTIZER_USE_SSE
+#endif
+
+/// the dither is generated for this number of frames at once
+#define CHUNK_FRAMES (256)
+
+WWQuantizer::WWQuantizer(void)
+    : m_type(WWQT_None), m_numChannels(0), m_bits(16), m_order(0), m_chStride(0)
+{
+    for (int i=0; i<4; ++i) {
+        m_h[i] = 0.0;
+    }
+}
+
+int
+WWQuantizer::Init(WWQuantizerType type, int numChannels, int bits, uint32_t seed)
+{
+    if (type < 0 || WWQT_NUM <= type || numChannels < 1 || (bits != 16 && bits != 24)) {
+        return -1;
+    }
+
+    m_type        = type;
+    m_numChannels = numChannels;
+    m_bits        = bits;
+    m_chStride    = (numChannels + 1) & ~1;
+
+    for (int i=0; i<4; ++i) {
+        m_h[i] = 0.0;
+    }
+    switch (type) {
+    case WWQT_NoiseShaping2:
+        // 1 - H(z) = (1-z^-1)^2
+        m_order = 2;
+        m_h[0] =  2.0;
+        m_h[1] = -1.0;
+        break;
+    case WWQT_NoiseShaping4:
+        // 1 - H(z) = (1-z^-1)^4
+        m_order = 4;
+        m_h[0] =  4.0;
+        m_h[1] = -6.0;
+        m_h[2] =  4.0;
+        m_h[3] = -1.0;
+        break;
+    default:
+        m_order = 0;
+        break;
+    }
+
+    m_err.assign((size_t)4 * m_chStride, 0.0);
+    // triangular distribution of 2 LSB peak to peak
+    m_ditherBuf.assign((size_t)CHUNK_FRAMES * numChannels, 0.0f);
+    m_dither.Init(WWNT_Tpdf, numChannels, 1.0f, seed);
+    return 0;
+}
+
+void
+WWQuantizer::Reset(void)
+{
+    std::fill(m_err.begin(), m_err.end(), 0.0);
+}
+
+void
+WWQuantizer::Process(const float *in, int frames, int32_t *out_return)
+{
+    assert(0 < m_numChannels);
+
+    int pos = 0;
+    while (pos < frames) {
+        const int n = std::min(frames - pos, CHUNK_FRAMES);
+        ProcessChunk(&in[(size_t)pos * m_numChannels], n, &out_return[(size_t)pos * m_numChannels]);
+        pos += n;
+    }
+}
+
+void
+WWQuantizer::ProcessChunk(const float *in, int frames, int32_t *out_return)
+{
+    const int    nCh   = m_numChannels;
+    const int    S     = m_chStride;
+    const double scale = (double)(1 << (m_bits - 1));
+    const double lo    = -scale;
+    const double hi    = scale - 1.0;
+    const bool   dither = (m_type != WWQT_None);
+    const int    order  = m_order;
+
+    // d[frame][channel]
+    const float *d = &m_ditherBuf[0];
+    if (dither) {
+        m_dither.Generate(&m_ditherBuf[0], frames);
+    }
+
+    double *e1 = &m_err[0];
+    double *e2 = &m_err[S];
+    double *e3 = &m_err[2 * S];
+    double *e4 = &m_err[3 * S];
+
+    int ch = 0;
+
+#ifdef WW_QUANTIZER_USE_SSE
+    {
+        const __m128d vScale = _mm_set1_pd(scale);
+        const __m128d vLo    = _mm_set1_pd(lo);
+        const __m128d vHi    = _mm_set1_pd(hi);
+        const __m128d h0 = _mm_set1_pd(m_h[0]);
+        const __m128d h1 = _mm_set1_pd(m_h[1]);
+        const __m128d h2 = _mm_set1_pd(m_h[2]);
+        const __m128d h3 = _mm_set1_pd(m_h[3]);
+
+        for (; ch + 1 < nCh; ch += 2) {
+            __m128d z1 = _mm_loadu_pd(&e1[ch]);
+            __m128d z2 = _mm_loadu_pd(&e2[ch]);
+            __m128d z3 = _mm_loadu_pd(&e3[ch]);
+            __m128d z4 = _mm_loadu_pd(&e4[ch]);
+
+            for (int i=0; i<frames; ++i) {
+                const size_t idx = (size_t)i * nCh + ch;
+
+                __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)&in[idx])));
+                __m128d u = _mm_mul_pd(x, vScale);
+                if (order) {
+                    __m128d fb = _mm_add_pd(_mm_mul_pd(h0, z1), _mm_mul_pd(h1, z2));
+                    if (4 == order) {
+                        fb = _mm_add_pd(fb, _mm_add_pd(_mm_mul_pd(h2, z3), _mm_mul_pd(h3, z4)));
+                    }
+                    u = _mm_sub_pd(u, fb);
+                }
+
+                __m128d v = u;
+                if (dither) {
+                    v = _mm_add_pd(v, _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)&d[idx]))));
+                }
+
+                // rounded to the nearest by the default rounding mode
+                const __m128d q = _mm_cvtepi32_pd(_mm_cvtpd_epi32(v));
+
+                z4 = z3;
+                z3 = z2;
+                z2 = z1;
+                z1 = _mm_sub_pd(q, u);
+
+                const __m128d qc = _mm_min_pd(_mm_max_pd(q, vLo), vHi);
+                _mm_storel_epi64((__m128i *)&out_return[idx], _mm_cvtpd_epi32(qc));
+            }
+
+            _mm_storeu_pd(&e1[ch], z1);
+            _mm_storeu_pd(&e2[ch], z2);
+            _mm_storeu_pd(&e3[ch], z3);
+            _mm_storeu_pd(&e4[ch], z4);
+        }
+    }
+#endif
+
+    for (; ch < nCh; ++ch) {
+        double z1 = e1[ch];
+        double z2 = e2[ch];
+        double z3 = e3[ch];
+        double z4 = e4[ch];
+
+        for (int i=0; i<frames; ++i) {
+            const size_t idx = (size_t)i * nCh + ch;
+
+            const double u = in[idx] * scale - (m_h[0] * z1 + m_h[1] * z2 + m_h[2] * z3 + m_h[3] * z4);
+            double v = u;
+            if (dither) {
+                v += d[idx];
+            }
+
+            const double q = (double)lrint(v);
+
+            z4 = z3;
+            z3 = z2;
+            z2 = z1;
+            z1 = q - u;
+
+            out_return[idx] = (int32_t)std::min(std::max(q, lo), hi);
+        }
+
+        e1[ch] = z1;
+        e2[ch] = z2;
+        e3[ch] = z3;
+        e4[ch] = z4;
+    }
+}
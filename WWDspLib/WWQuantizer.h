@@ -0,0 +1,70 @@
+#pragma once
+
+#include "WWNoise.h"
+#include <stdint.h>
+#include <vector>
+
+enum WWQuantizerType {
+    /// rounded to the nearest. no dither
+    WWQT_None,
+
+    /// TPDF dither of 2 LSB peak to peak
+    WWQT_Tpdf,
+
+    /// TPDF dither and the error feedback of the noise transfer function (1-z^-1)^2.
+    /// +12dB at the Nyquist frequency. for 44.1kHz and 48kHz
+    WWQT_NoiseShaping2,
+
+    /// TPDF dither and the error feedback of (1-z^-1)^4.
+    /// +24dB at the Nyquist frequency: the noise is pushed far above the audio band of 88.2kHz or higher
+    WWQT_NoiseShaping4,
+
+    WWQT_NUM
+};
+
+/// Quantizes float samples to 16bit or 24bit integers with dither and noise shaping.
+///
+///   u = x - sum(h[k] * e[n-k]), q = round(u + d), e[n] = q - u
+///   where d is the TPDF dither of WWNoise.
+///   The error is taken before the clipping of q, so the feedback stays bounded on the clipped input.
+///   Computed in double precision, 2 channels at once by SSE2.
+class WWQuantizer {
+public:
+    WWQuantizer(void);
+
+    /// @param bits 16 or 24
+    /// @param seed seed of the dither. each instance has its own random number stream
+    /// @return 0: success. negative: bad parameter
+    int Init(WWQuantizerType type, int numChannels, int bits, uint32_t seed = 5489);
+
+    /// clears the error history
+    void Reset(void);
+
+    WWQuantizerType Type(void) const { return m_type; }
+    int NumChannels(void) const { return m_numChannels; }
+    int Bits(void) const { return m_bits; }
+
+    /// @param in channel interleaved. full scale is [-1, 1). frames * NumChannels() floats
+    /// @param out_return channel interleaved. frames * NumChannels() integers of [-2^(bits-1), 2^(bits-1)-1]
+    void Process(const float *in, int frames, int32_t *out_return);
+
+private:
+    WWQuantizerType m_type;
+    int m_numChannels;
+    int m_bits;
+
+    /// number of error feedback taps. 0, 2 or 4
+    int m_order;
+    double m_h[4];
+
+    /// [e1 e2 e3 e4][channel]. channels are padded to a multiple of 2
+    int m_chStride;
+    std::vector<double> m_err;
+
+    WWNoise m_dither;
+
+    /// the dither of a chunk in LSB
+    std::vector<float> m_ditherBuf;
+
+    void ProcessChunk(const float *in, int frames, int32_t *out_return);
+};
@@ -0,0 +1,238 @@
+// SFMT-19937 is by Mutsuo Saito and Makoto Matsumoto (Hiroshima University), the new BSD License.
+// see 00Experiments/RandLargeFileCreate/SFMT.c
+
+#include "WWSfmt.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_SFMT_USE_SSE
+#endif
+
+/// 128bit words of the state
+#define N    (WW_SFMT_N32 / 4)
+
+#define POS1 (122)
+#define SL1  (18)
+#define SL2  (1)
+#define SR1  (11)
+#define SR2  (1)
+#define MSK1 (0xdfffffefU)
+#define MSK2 (0xddfecb7fU)
+#define MSK3 (0xbffaffffU)
+#define MSK4 (0xbffffff6U)
+
+static const uint32_t gParity[4] = { 0x00000001U, 0x00000000U, 0x00000000U, 0x13c9e684U };
+
+WWSfmt::WWSfmt(void)
+{
+    Init(5489);
+}
+
+void
+WWSfmt::Init(uint32_t seed)
+{
+    m_state[0] = seed;
+    for (int i=1; i<WW_SFMT_N32; ++i) {
+        m_state[i] = 1812433253UL * (m_state[i - 1] ^ (m_state[i - 1] >> 30)) + i;
+    }
+    m_idx = WW_SFMT_N32;
+    PeriodCertification();
+}
+
+static uint32_t
+InitFunc1(uint32_t x)
+{
+    return (x ^ (x >> 27)) * 1664525UL;
+}
+
+static uint32_t
+InitFunc2(uint32_t x)
+{
+    return (x ^ (x >> 27)) * 1566083941UL;
+}
+
+void
+WWSfmt::InitByArray(const uint32_t *key, int keyLength)
+{
+    const int lag = 11;
+    const int mid = (WW_SFMT_N32 - lag) / 2;
+    uint32_t *s = m_state;
+
+    memset(m_state, 0x8b, sizeof m_state);
+    int count = (WW_SFMT_N32 < keyLength + 1) ? (keyLength + 1) : WW_SFMT_N32;
+
+    uint32_t r = InitFunc1(s[0] ^ s[mid] ^ s[WW_SFMT_N32 - 1]);
+    s[mid] += r;
+    r += keyLength;
+    s[mid + lag] += r;
+    s[0] = r;
+
+    --count;
+    int i = 1;
+    int j = 0;
+    for (; j < count && j < keyLength; ++j) {
+        r = InitFunc1(s[i] ^ s[(i + mid) % WW_SFMT_N32] ^ s[(i + WW_SFMT_N32 - 1) % WW_SFMT_N32]);
+        s[(i + mid) % WW_SFMT_N32] += r;
+        r += key[j] + i;
+        s[(i + mid + lag) % WW_SFMT_N32] += r;
+        s[i] = r;
+        i = (i + 1) % WW_SFMT_N32;
+    }
+    for (; j < count; ++j) {
+        r = InitFunc1(s[i] ^ s[(i + mid) % WW_SFMT_N32] ^ s[(i + WW_SFMT_N32 - 1) % WW_SFMT_N32]);
+        s[(i + mid) % WW_SFMT_N32] += r;
+        r += i;
+        s[(i + mid + lag) % WW_SFMT_N32] += r;
+        s[i] = r;
+        i = (i + 1) % WW_SFMT_N32;
+    }
+    for (j = 0; j < WW_SFMT_N32; ++j) {
+        r = InitFunc2(s[i] + s[(i + mid) % WW_SFMT_N32] + s[(i + WW_SFMT_N32 - 1) % WW_SFMT_N32]);
+        s[(i + mid) % WW_SFMT_N32] ^= r;
+        r -= i;
+        s[(i + mid + lag) % WW_SFMT_N32] ^= r;
+        s[i] = r;
+        i = (i + 1) % WW_SFMT_N32;
+    }
+
+    m_idx = WW_SFMT_N32;
+    PeriodCertification();
+}
+
+/// makes the period 2^19937-1
+void
+WWSfmt::PeriodCertification(void)
+{
+    uint32_t inner = 0;
+    for (int i=0; i<4; ++i) {
+        inner ^= m_state[i] & gParity[i];
+    }
+    for (int i=16; i>0; i >>= 1) {
+        inner ^= inner >> i;
+    }
+    if (inner & 1) {
+        return;
+    }
+
+    for (int i=0; i<4; ++i) {
+        uint32_t work = 1;
+        for (int j=0; j<32; ++j) {
+            if (work & gParity[i]) {
+                m_state[i] ^= work;
+                return;
+            }
+            work <<= 1;
+        }
+    }
+}
+
+#ifdef WW_SFMT_USE_SSE
+
+static inline __m128i
+Recursion(__m128i a, __m128i b, __m128i c, __m128i d, __m128i mask)
+{
+    __m128i x = a;
+    __m128i y = _mm_srli_epi32(b, SR1);
+    __m128i z = _mm_srli_si128(c, SR2);
+    __m128i v = _mm_slli_epi32(d, SL1);
+    z = _mm_xor_si128(z, x);
+    z = _mm_xor_si128(z, v);
+    x = _mm_slli_si128(x, SL2);
+    y = _mm_and_si128(y, mask);
+    z = _mm_xor_si128(z, x);
+    z = _mm_xor_si128(z, y);
+    return z;
+}
+
+void
+WWSfmt::GenerateAll(void)
+{
+    __m128i *s = (__m128i *)m_state;
+    const __m128i mask = _mm_set_epi32(MSK4, MSK3, MSK2, MSK1);
+
+    __m128i r1 = _mm_loadu_si128(&s[N - 2]);
+    __m128i r2 = _mm_loadu_si128(&s[N - 1]);
+    for (int i=0; i<N; ++i) {
+        const int b = (i < N - POS1) ? (i + POS1) : (i + POS1 - N);
+        const __m128i r = Recursion(_mm_loadu_si128(&s[i]), _mm_loadu_si128(&s[b]), r1, r2, mask);
+        _mm_storeu_si128(&s[i], r);
+        r1 = r2;
+        r2 = r;
+    }
+}
+
+#else
+
+/// 128bit shift of the little endian word by bytes bytes
+static void
+RShift128(uint32_t *out, const uint32_t *in, int bytes)
+{
+    const uint64_t th = ((uint64_t)in[3] << 32) | in[2];
+    const uint64_t tl = ((uint64_t)in[1] << 32) | in[0];
+    const uint64_t oh = th >> (bytes * 8);
+    const uint64_t ol = (tl >> (bytes * 8)) | (th << (64 - bytes * 8));
+    out[0] = (uint32_t)ol;
+    out[1] = (uint32_t)(ol >> 32);
+    out[2] = (uint32_t)oh;
+    out[3] = (uint32_t)(oh >> 32);
+}
+
+static void
+LShift128(uint32_t *out, const uint32_t *in, int bytes)
+{
+    const uint64_t th = ((uint64_t)in[3] << 32) | in[2];
+    const uint64_t tl = ((uint64_t)in[1] << 32) | in[0];
+    const uint64_t oh = (th << (bytes * 8)) | (tl >> (64 - bytes * 8));
+    const uint64_t ol = tl << (bytes * 8);
+    out[0] = (uint32_t)ol;
+    out[1] = (uint32_t)(ol >> 32);
+    out[2] = (uint32_t)oh;
+    out[3] = (uint32_t)(oh >> 32);
+}
+
+void
+WWSfmt::GenerateAll(void)
+{
+    static const uint32_t msk[4] = { MSK1, MSK2, MSK3, MSK4 };
+
+    uint32_t *r1 = &m_state[(N - 2) * 4];
+    uint32_t *r2 = &m_state[(N - 1) * 4];
+    for (int i=0; i<N; ++i) {
+        const int b = (i < N - POS1) ? (i + POS1) : (i + POS1 - N);
+        uint32_t *a = &m_state[i * 4];
+        const uint32_t *bp = &m_state[b * 4];
+
+        uint32_t x[4];
+        uint32_t y[4];
+        LShift128(x, a, SL2);
+        RShift128(y, r1, SR2);
+        for (int k=0; k<4; ++k) {
+            a[k] = a[k] ^ x[k] ^ ((bp[k] >> SR1) & msk[k]) ^ y[k] ^ (r2[k] << SL1);
+        }
+        r1 = r2;
+        r2 = a;
+    }
+}
+
+#endif
+
+void
+WWSfmt::Fill(uint32_t *to, size_t n)
+{
+    while (0 < n) {
+        if (WW_SFMT_N32 <= m_idx) {
+            GenerateAll();
+            m_idx = 0;
+        }
+
+        size_t count = WW_SFMT_N32 - m_idx;
+        if (n < count) {
+            count = n;
+        }
+        memcpy(to, &m_state[m_idx], sizeof(uint32_t) * count);
+        m_idx += (int)count;
+        to    += count;
+        n     -= count;
+    }
+}
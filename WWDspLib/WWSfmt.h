@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// state size of SFMT-19937 in 32bit words
+#define WW_SFMT_N32 (624)
+
+/// SIMD oriented Fast Mersenne Twister SFMT-19937 (M. Saito and M. Matsumoto), as 00Experiments/RandLargeFileCreate.
+///
+///   The state is of the instance instead of the global variables of SFMT.c, so that each thread or each filter
+///   has its own stream. The recursion runs on SSE2 when available. The output sequence is the same as
+///   init_gen_rand() and gen_rand32() of SFMT.c for the same seed.
+class WWSfmt {
+public:
+    WWSfmt(void);
+
+    void Init(uint32_t seed);
+
+    /// the same as init_by_array() of SFMT.c. the keys such as {seed, stream} give the independent streams
+    void InitByArray(const uint32_t *key, int keyLength);
+
+    uint32_t Next(void) {
+        if (WW_SFMT_N32 <= m_idx) {
+            GenerateAll();
+            m_idx = 0;
+        }
+        return m_state[m_idx++];
+    }
+
+    /// the same as calling Next() n times
+    void Fill(uint32_t *to, size_t n);
+
+private:
+    uint32_t m_state[WW_SFMT_N32];
+    int m_idx;
+
+    void GenerateAll(void);
+    void PeriodCertification(void);
+};
@@ -0,0 +1,278 @@
+#include "WWWavFile.h"
+#include <string.h>
+#include <algorithm>
+
+#define WAVE_FORMAT_PCM        (1)
+#define WAVE_FORMAT_IEEE_FLOAT (3)
+#define WAVE_FORMAT_EXTENSIBLE (0xfffe)
+
+static uint32_t
+ReadLE4(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+ReadLE2(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint64_t
+ReadLE8(const uint8_t *p)
+{
+    return ReadLE4(p) | ((uint64_t)ReadLE4(p + 4) << 32);
+}
+
+static void
+AppendLE(std::vector<uint8_t> &v, uint64_t x, int bytes)
+{
+    for (int i=0; i<bytes; ++i) {
+        v.push_back((uint8_t)(x >> (i * 8)));
+    }
+}
+
+static void
+AppendStr(std::vector<uint8_t> &v, const char *s)
+{
+    v.insert(v.end(), s, s + strlen(s));
+}
+
+/// the same as GetChannelMask() of WasapiIOIF
+static uint32_t
+ChannelMask(int numChannels)
+{
+    switch (numChannels) {
+    case 1:  return 0;
+    case 2:  return 3;
+    case 4:  return 0x33;
+    case 6:  return 0x3f;
+    case 8:  return 0x63f;
+    default: return (uint32_t)((1LL << numChannels) - 1);
+    }
+}
+
+int
+WWFileSeek(FILE *fp, int64_t offset, int origin)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, offset, origin);
+#else
+    return fseeko(fp, (off_t)offset, origin);
+#endif
+}
+
+int64_t
+WWFileTell(FILE *fp)
+{
+#ifdef _WIN32
+    return _ftelli64(fp);
+#else
+    return (int64_t)ftello(fp);
+#endif
+}
+
+int
+WWWavReadHeader(FILE *fp, WWWavFormat &f_return)
+{
+    f_return = WWWavFormat();
+
+    uint8_t h[12];
+    if (fread(h, 1, 12, fp) != 12 || (0 != memcmp(h, "RIFF", 4) && 0 != memcmp(h, "RF64", 4))
+            || 0 != memcmp(&h[8], "WAVE", 4)) {
+        return -1;
+    }
+    const bool rf64 = 0 == memcmp(h, "RF64", 4);
+
+    uint64_t ds64DataBytes = 0;
+    bool fmtFound = false;
+    for (;;) {
+        uint8_t ck[8];
+        if (fread(ck, 1, 8, fp) != 8) {
+            return -1;
+        }
+        const uint32_t ckSize = ReadLE4(&ck[4]);
+
+        if (0 == memcmp(ck, "ds64", 4)) {
+            // riff size, data size and sample count
+            uint8_t ds64[24];
+            if (ckSize < sizeof ds64 || fread(ds64, 1, sizeof ds64, fp) != sizeof ds64) {
+                return -1;
+            }
+            ds64DataBytes = ReadLE8(&ds64[8]);
+            if (0 != WWFileSeek(fp, (int64_t)ckSize - (int64_t)sizeof ds64 + (ckSize & 1), SEEK_CUR)) {
+                return -1;
+            }
+        } else if (0 == memcmp(ck, "fmt ", 4)) {
+            uint8_t fmt[40];
+            memset(fmt, 0, sizeof fmt);
+            const uint32_t readBytes = (sizeof fmt < ckSize) ? (uint32_t)sizeof fmt : ckSize;
+            if (ckSize < 16 || fread(fmt, 1, readBytes, fp) != readBytes) {
+                return -1;
+            }
+            int formatTag = ReadLE2(&fmt[0]);
+            if (WAVE_FORMAT_EXTENSIBLE == formatTag && 26 <= ckSize) {
+                // the first 2 bytes of SubFormat GUID
+                formatTag = ReadLE2(&fmt[24]);
+            }
+            f_return.numChannels   = ReadLE2(&fmt[2]);
+            f_return.sampleRate    = (int)ReadLE4(&fmt[4]);
+            f_return.bitsPerSample = ReadLE2(&fmt[14]);
+            f_return.isFloat       = (WAVE_FORMAT_IEEE_FLOAT == formatTag);
+
+            const int bits = f_return.bitsPerSample;
+            if ((WAVE_FORMAT_PCM != formatTag && WAVE_FORMAT_IEEE_FLOAT != formatTag)
+                    || f_return.numChannels < 1 || f_return.sampleRate <= 0
+                    || (f_return.isFloat && 32 != bits && 64 != bits)
+                    || (!f_return.isFloat && 8 != bits && 16 != bits && 24 != bits && 32 != bits)) {
+                return -1;
+            }
+            fmtFound = true;
+            if (0 != WWFileSeek(fp, (int64_t)(ckSize - readBytes) + (ckSize & 1), SEEK_CUR)) {
+                return -1;
+            }
+        } else if (0 == memcmp(ck, "data", 4)) {
+            if (!fmtFound) {
+                return -1;
+            }
+            f_return.dataOffset = WWFileTell(fp);
+
+            // the data is not longer than the file
+            if (0 != WWFileSeek(fp, 0, SEEK_END)) {
+                return -1;
+            }
+            const int64_t fileBytes = WWFileTell(fp);
+            if (f_return.dataOffset < 0 || fileBytes < f_return.dataOffset
+                    || 0 != WWFileSeek(fp, f_return.dataOffset, SEEK_SET)) {
+                return -1;
+            }
+
+            int64_t dataBytes = ckSize;
+            if (rf64 && 0xffffffffU == ckSize && 0 != ds64DataBytes) {
+                dataBytes = (int64_t)ds64DataBytes;
+            } else if (0 == ckSize || 0xffffffffU == ckSize) {
+                dataBytes = fileBytes - f_return.dataOffset;
+            }
+            f_return.dataBytes = std::min(dataBytes, fileBytes - f_return.dataOffset);
+            f_return.numFrames = f_return.dataBytes / f_return.BytesPerFrame();
+            return 0;
+        } else {
+            if (0 != WWFileSeek(fp, (int64_t)ckSize + (ckSize & 1), SEEK_CUR)) {
+                return -1;
+            }
+        }
+    }
+}
+
+void
+WWWavDecodeSamples(const uint8_t *from, const WWWavFormat &f, size_t numSamples, float *to)
+{
+    const int bytesPerSample = f.bitsPerSample / 8;
+
+    for (size_t i=0; i<numSamples; ++i) {
+        const uint8_t *p = &from[i * bytesPerSample];
+        float v = 0.0f;
+        switch (f.bitsPerSample) {
+        case 8:
+            // unsigned
+            v = (float)((int)p[0] - 128) * (1.0f / 128.0f);
+            break;
+        case 16:
+            v = (float)(int16_t)ReadLE2(p) * (1.0f / 32768.0f);
+            break;
+        case 24:
+            v = (float)(int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) * (1.0f / 2147483648.0f);
+            break;
+        case 32:
+            if (f.isFloat) {
+                const uint32_t u = ReadLE4(p);
+                memcpy(&v, &u, 4);
+            } else {
+                v = (float)(int32_t)ReadLE4(p) * (1.0f / 2147483648.0f);
+            }
+            break;
+        case 64:
+            {
+                const uint64_t u = ReadLE8(p);
+                double d;
+                memcpy(&d, &u, 8);
+                v = (float)d;
+            }
+            break;
+        default:
+            break;
+        }
+        to[i] = v;
+    }
+}
+
+void
+WWWavMakeHeader(int numChannels, int sampleRate, int bitsPerSample, bool isFloat, int64_t numFrames,
+        std::vector<uint8_t> &h)
+{
+    const int bytesPerFrame = numChannels * bitsPerSample / 8;
+    const uint64_t dataBytes = (uint64_t)numFrames * bytesPerFrame;
+    const bool extensible = 2 < numChannels || 16 < bitsPerSample;
+    const int fmtBytes = extensible ? 40 : 16;
+
+    // RIFF form type, fmt, data header and the pad byte of the data of the odd size
+    uint64_t riffBytes = 4 + (8 + fmtBytes) + 8 + dataBytes + (dataBytes & 1);
+    const bool rf64 = 0xffffffffULL < riffBytes;
+    if (rf64) {
+        riffBytes += 8 + 28;
+    }
+
+    h.clear();
+    AppendStr(h, rf64 ? "RF64" : "RIFF");
+    AppendLE(h, rf64 ? 0xffffffffULL : riffBytes, 4);
+    AppendStr(h, "WAVE");
+
+    if (rf64) {
+        AppendStr(h, "ds64");
+        AppendLE(h, 28, 4);
+        AppendLE(h, riffBytes, 8);
+        AppendLE(h, dataBytes, 8);
+        AppendLE(h, (uint64_t)numFrames, 8);
+        AppendLE(h, 0, 4);
+    }
+
+    AppendStr(h, "fmt ");
+    AppendLE(h, fmtBytes, 4);
+    AppendLE(h, extensible ? WAVE_FORMAT_EXTENSIBLE : (isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM), 2);
+    AppendLE(h, numChannels, 2);
+    AppendLE(h, sampleRate, 4);
+    AppendLE(h, (uint64_t)sampleRate * bytesPerFrame, 4);
+    AppendLE(h, bytesPerFrame, 2);
+    AppendLE(h, bitsPerSample, 2);
+    if (extensible) {
+        // cbSize, valid bits, channel mask and the sub format GUID
+        static const uint8_t guidTail[14] = {
+            0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+        AppendLE(h, 22, 2);
+        AppendLE(h, bitsPerSample, 2);
+        AppendLE(h, ChannelMask(numChannels), 4);
+        AppendLE(h, isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM, 2);
+        h.insert(h.end(), guidTail, guidTail + sizeof guidTail);
+    }
+
+    AppendStr(h, "data");
+    AppendLE(h, rf64 ? 0xffffffffULL : dataBytes, 4);
+}
+
+int
+WWWavWriteHeader(FILE *fp, int numChannels, int sampleRate, int bitsPerSample, bool isFloat, int64_t numFrames)
+{
+    std::vector<uint8_t> h;
+    WWWavMakeHeader(numChannels, sampleRate, bitsPerSample, isFloat, numFrames, h);
+    return (fwrite(&h[0], 1, h.size(), fp) == h.size()) ? 0 : -1;
+}
+
+int
+WWWavWritePad(FILE *fp, int64_t dataBytes)
+{
+    if (0 == (dataBytes & 1)) {
+        return 0;
+    }
+    const uint8_t pad = 0;
+    return (fwrite(&pad, 1, 1, fp) == 1) ? 0 : -1;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+/// the format and the place of the data chunk of a RIFF WAVE or RF64 file
+struct WWWavFormat {
+    int numChannels;
+    int sampleRate;
+    int bitsPerSample;
+    bool isFloat;
+
+    /// file offset and bytes of the data chunk
+    int64_t dataOffset;
+    int64_t dataBytes;
+
+    /// whole frames of the data chunk
+    int64_t numFrames;
+
+    WWWavFormat(void) : numChannels(0), sampleRate(0), bitsPerSample(0), isFloat(false), dataOffset(0),
+            dataBytes(0), numFrames(0) { }
+
+    int BytesPerFrame(void) const { return numChannels * bitsPerSample / 8; }
+};
+
+/// fseek() and ftell() of 64bit offsets. long is 32bit on Windows
+int WWFileSeek(FILE *fp, int64_t offset, int origin);
+int64_t WWFileTell(FILE *fp);
+
+/// reads the header of RIFF WAVE or RF64 and leaves fp at the start of the data.
+/// 8, 16, 24, 32bit integer and 32, 64bit float. WAVE_FORMAT_EXTENSIBLE too.
+///
+///   The data chunk is of its chunk size, or of the ds64 chunk of RF64. The size 0 or 0xffffffff
+///   of a streaming writer is the rest of the file. The chunks after the data chunk are not data.
+/// @return 0: success. negative: not a WAV file or unsupported format
+int WWWavReadHeader(FILE *fp, WWWavFormat &f_return);
+
+/// converts the samples to float of [-1, 1). the values are the same as AudioDataPerChannel.GetPcmInDouble()
+void WWWavDecodeSamples(const uint8_t *from, const WWWavFormat &f, size_t numSamples, float *to);
+
+/// the header of the integer or float PCM. WAVEFORMATEXTENSIBLE for more than 2 channels or more than 16 bits,
+/// RF64 when the file is larger than 4GB. the data of numFrames follows
+void WWWavMakeHeader(int numChannels, int sampleRate, int bitsPerSample, bool isFloat, int64_t numFrames,
+        std::vector<uint8_t> &h_return);
+
+/// writes WWWavMakeHeader()
+/// @return 0: success. negative: write error
+int WWWavWriteHeader(FILE *fp, int numChannels, int sampleRate, int bitsPerSample, bool isFloat, int64_t numFrames);
+
+/// writes the pad byte after the data of the odd bytes
+/// @return 0: success. negative: write error
+int WWWavWritePad(FILE *fp, int64_t dataBytes);
@@ -0,0 +1,776 @@
+#include "WWWavStats.h"
+#include "WWMappedFile.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_WAV_STATS_USE_SSE
+#endif
+
+/// frames decoded at once
+#define BLOCK_FRAMES (1024)
+
+/// a worker segment is at least this large, so that a small file is not split
+#define MIN_SEGMENT_BYTES (4 * 1024 * 1024)
+
+/// total bytes of the per worker histograms. the number of the workers is reduced to fit
+#define HISTOGRAM_MEMORY_LIMIT ((size_t)1024 * 1024 * 1024)
+
+/// a worker adds its 32bit histogram to the result after this many frames, before the counts overflow
+#define HISTOGRAM_FLUSH_FRAMES ((int64_t)1 << 30)
+
+#define WAVE_FORMAT_PCM        (1)
+#define WAVE_FORMAT_IEEE_FLOAT (3)
+#define WAVE_FORMAT_EXTENSIBLE (0xfffe)
+
+static uint16_t
+ReadLE2(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t
+ReadLE4(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t
+ReadLE8(const unsigned char *p)
+{
+    return (uint64_t)ReadLE4(p) | ((uint64_t)ReadLE4(&p[4]) << 32);
+}
+
+static int
+ParseFmt(const unsigned char *p, size_t chunkBytes, WWWavStatsFormat &f)
+{
+    if (chunkBytes < 16) {
+        return -1;
+    }
+
+    int formatTag          = ReadLE2(p);
+    f.numChannels          = ReadLE2(&p[2]);
+    f.sampleRate           = (int)ReadLE4(&p[4]);
+    f.bitsPerSample        = ReadLE2(&p[14]);
+    f.validBitsPerSample   = f.bitsPerSample;
+
+    if (WAVE_FORMAT_EXTENSIBLE == formatTag) {
+        if (chunkBytes < 40 || ReadLE2(&p[16]) < 22) {
+            return -1;
+        }
+        if (0 != ReadLE2(&p[18])) {
+            f.validBitsPerSample = ReadLE2(&p[18]);
+        }
+        // the first 2 bytes of the sub format GUID is the format tag
+        formatTag = ReadLE2(&p[24]);
+    }
+
+    switch (formatTag) {
+    case WAVE_FORMAT_PCM:
+        f.isFloat = false;
+        if (8 != f.bitsPerSample && 16 != f.bitsPerSample && 24 != f.bitsPerSample && 32 != f.bitsPerSample) {
+            return -1;
+        }
+        break;
+    case WAVE_FORMAT_IEEE_FLOAT:
+        f.isFloat = true;
+        if (32 != f.bitsPerSample) {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+
+    if (f.numChannels <= 0 || f.sampleRate <= 0
+            || f.validBitsPerSample <= 0 || f.bitsPerSample < f.validBitsPerSample) {
+        return -1;
+    }
+    return 0;
+}
+
+int
+WWWavStatsParseHeader(const unsigned char *wav, size_t bytes, WWWavStatsFormat &f_return)
+{
+    f_return = WWWavStatsFormat();
+
+    if (bytes < 12 || 0 != memcmp(&wav[8], "WAVE", 4)) {
+        return -1;
+    }
+
+    const bool rf64 = (0 == memcmp(wav, "RF64", 4));
+    if (!rf64 && 0 != memcmp(wav, "RIFF", 4)) {
+        return -1;
+    }
+
+    bool fmtFound = false;
+    uint64_t ds64DataBytes = 0;
+
+    size_t pos = 12;
+    while (pos + 8 <= bytes) {
+        const unsigned char *chunk = &wav[pos];
+        uint64_t chunkBytes = ReadLE4(&chunk[4]);
+        const size_t body = pos + 8;
+
+        if (0 == memcmp(chunk, "ds64", 4)) {
+            if (chunkBytes < 16 || bytes < body + 16) {
+                return -1;
+            }
+            ds64DataBytes = ReadLE8(&wav[body + 8]);
+        } else if (0 == memcmp(chunk, "fmt ", 4)) {
+            if (bytes < body + chunkBytes || ParseFmt(&wav[body], (size_t)chunkBytes, f_return) < 0) {
+                return -1;
+            }
+            fmtFound = true;
+        } else if (0 == memcmp(chunk, "data", 4)) {
+            if (!fmtFound) {
+                return -1;
+            }
+            if (rf64 && 0xffffffff == chunkBytes) {
+                chunkBytes = ds64DataBytes;
+            }
+
+            f_return.dataOffset = body;
+            f_return.dataBytes  = (size_t)std::min(chunkBytes, (uint64_t)(bytes - body));
+
+            // whole frames only
+            f_return.dataBytes -= f_return.dataBytes % f_return.FrameBytes();
+            return 0;
+        }
+
+        // chunks are padded to 2 bytes
+        const uint64_t next = (uint64_t)body + chunkBytes + (chunkBytes & 1);
+        if (bytes < next) {
+            break;
+        }
+        pos = (size_t)next;
+    }
+    return -1;
+}
+
+double
+WWWavStatsHistogramBinValue(const WWWavStatsFormat &f, int histogramBits, int bin)
+{
+    if (f.isFloat) {
+        const double half = (double)(1 << (histogramBits - 1));
+        return (bin - half) / half;
+    }
+
+    // integer samples are binned as 32bit left aligned values
+    return (ldexp((double)bin, 32 - histogramBits) - ldexp(1.0, 31)) / ldexp(1.0, 32 - f.bitsPerSample);
+}
+
+namespace {
+
+/// full scale runs of a channel in a segment.
+/// the run from the segment start (head) and the run to the segment end (run) may continue in the neighbour
+/// segments, so they are joined on merging. other runs are counted in clipRuns and longest
+struct ClipRuns {
+    int64_t run;
+    bool inHead;
+    int64_t head;
+
+    int64_t clipped;
+    int64_t clipRuns;
+    int64_t longest;
+
+    ClipRuns(void) : run(0), inHead(true), head(0), clipped(0), clipRuns(0), longest(0) { }
+
+    void End(int64_t len, int minLen) {
+        longest = std::max(longest, len);
+        if (minLen <= len) {
+            ++clipRuns;
+        }
+    }
+
+    void Clipped(void) {
+        ++run;
+        ++clipped;
+    }
+
+    void NotClipped(int minLen) {
+        if (inHead) {
+            head = run;
+            inHead = false;
+        } else if (0 < run) {
+            End(run, minLen);
+        }
+        run = 0;
+    }
+};
+
+struct Segment {
+    int64_t fromFrame;
+    int64_t numFrames;
+
+    /// accumulators of lanes: sample i of a block goes to lane i % lanes, which is channel i % numChannels.
+    /// integer samples are 32bit left aligned
+    std::vector<int32_t> laneMin;
+    std::vector<int32_t> laneMax;
+    std::vector<float> laneMinF;
+    std::vector<float> laneMaxF;
+    std::vector<uint32_t> laneOr;
+    std::vector<double> laneSum;
+    std::vector<double> laneSq;
+
+    /// per channel
+    std::vector<ClipRuns> runs;
+    std::vector<uint32_t> floatOr;
+    std::vector<int64_t> offGrid;
+
+    Segment(void) : fromFrame(0), numFrames(0) { }
+};
+
+/// analysis of one file shared by the workers
+struct Job {
+    const unsigned char *data;
+    WWWavStatsFormat f;
+    WWWavStatsParams p;
+
+    /// lanes of the accumulators: the least common multiple of 4 and the number of channels
+    int lanes;
+    int bins;
+
+    /// 32bit left aligned positive full scale of the valid bits
+    int32_t posFullScale;
+
+    std::mutex histogramMutex;
+    std::vector<uint64_t> histogram;
+};
+
+} // namespace
+
+#ifdef WW_WAV_STATS_USE_SSE
+
+/// SSE2 does not have the 32bit integer min and max
+static inline __m128i
+Min32(__m128i a, __m128i b)
+{
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline __m128i
+Max32(__m128i a, __m128i b)
+{
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+#endif
+
+/// accumulates n samples, n is a multiple of lanes.
+/// @return true: a full scale sample is found
+static bool
+AccumulateInt(const Job &job, const int32_t *s, int n, Segment &seg)
+{
+    const int lanes = job.lanes;
+    bool clip = false;
+
+#ifdef WW_WAV_STATS_USE_SSE
+    const __m128i posFs = _mm_set1_epi32(job.posFullScale - 1);
+    const __m128i negFs = _mm_set1_epi32(INT32_MIN);
+
+    for (int k=0; k<lanes; k += 4) {
+        __m128i mn = _mm_loadu_si128((const __m128i *)&seg.laneMin[k]);
+        __m128i mx = _mm_loadu_si128((const __m128i *)&seg.laneMax[k]);
+        __m128i bits = _mm_loadu_si128((const __m128i *)&seg.laneOr[k]);
+        __m128d sumLo = _mm_loadu_pd(&seg.laneSum[k]);
+        __m128d sumHi = _mm_loadu_pd(&seg.laneSum[k + 2]);
+        __m128d sqLo  = _mm_loadu_pd(&seg.laneSq[k]);
+        __m128d sqHi  = _mm_loadu_pd(&seg.laneSq[k + 2]);
+        __m128i fs = _mm_setzero_si128();
+
+        for (int i=k; i<n; i += lanes) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+            mn   = Min32(mn, v);
+            mx   = Max32(mx, v);
+            bits = _mm_or_si128(bits, v);
+            fs   = _mm_or_si128(fs, _mm_or_si128(_mm_cmpgt_epi32(v, posFs), _mm_cmpeq_epi32(v, negFs)));
+
+            const __m128d lo = _mm_cvtepi32_pd(v);
+            const __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+            sumLo = _mm_add_pd(sumLo, lo);
+            sumHi = _mm_add_pd(sumHi, hi);
+            sqLo  = _mm_add_pd(sqLo, _mm_mul_pd(lo, lo));
+            sqHi  = _mm_add_pd(sqHi, _mm_mul_pd(hi, hi));
+        }
+
+        _mm_storeu_si128((__m128i *)&seg.laneMin[k], mn);
+        _mm_storeu_si128((__m128i *)&seg.laneMax[k], mx);
+        _mm_storeu_si128((__m128i *)&seg.laneOr[k], bits);
+        _mm_storeu_pd(&seg.laneSum[k], sumLo);
+        _mm_storeu_pd(&seg.laneSum[k + 2], sumHi);
+        _mm_storeu_pd(&seg.laneSq[k], sqLo);
+        _mm_storeu_pd(&seg.laneSq[k + 2], sqHi);
+        clip |= (0 != _mm_movemask_epi8(fs));
+    }
+#else
+    for (int i=0; i<n; ++i) {
+        const int l = i % lanes;
+        const int32_t v = s[i];
+        seg.laneMin[l] = std::min(seg.laneMin[l], v);
+        seg.laneMax[l] = std::max(seg.laneMax[l], v);
+        seg.laneOr[l] |= (uint32_t)v;
+        seg.laneSum[l] += v;
+        seg.laneSq[l]  += (double)v * v;
+        clip |= (job.posFullScale <= v || INT32_MIN == v);
+    }
+#endif
+    return clip;
+}
+
+static bool
+AccumulateFloat(const Job &job, const float *s, int n, Segment &seg)
+{
+    const int lanes = job.lanes;
+    bool clip = false;
+
+#ifdef WW_WAV_STATS_USE_SSE
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (int k=0; k<lanes; k += 4) {
+        __m128 mn = _mm_loadu_ps(&seg.laneMinF[k]);
+        __m128 mx = _mm_loadu_ps(&seg.laneMaxF[k]);
+        __m128d sumLo = _mm_loadu_pd(&seg.laneSum[k]);
+        __m128d sumHi = _mm_loadu_pd(&seg.laneSum[k + 2]);
+        __m128d sqLo  = _mm_loadu_pd(&seg.laneSq[k]);
+        __m128d sqHi  = _mm_loadu_pd(&seg.laneSq[k + 2]);
+        __m128 fs = _mm_setzero_ps();
+
+        for (int i=k; i<n; i += lanes) {
+            const __m128 v = _mm_loadu_ps(&s[i]);
+            mn = _mm_min_ps(mn, v);
+            mx = _mm_max_ps(mx, v);
+            fs = _mm_or_ps(fs, _mm_cmpge_ps(_mm_and_ps(v, absMask), one));
+
+            const __m128d lo = _mm_cvtps_pd(v);
+            const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+            sumLo = _mm_add_pd(sumLo, lo);
+            sumHi = _mm_add_pd(sumHi, hi);
+            sqLo  = _mm_add_pd(sqLo, _mm_mul_pd(lo, lo));
+            sqHi  = _mm_add_pd(sqHi, _mm_mul_pd(hi, hi));
+        }
+
+        _mm_storeu_ps(&seg.laneMinF[k], mn);
+        _mm_storeu_ps(&seg.laneMaxF[k], mx);
+        _mm_storeu_pd(&seg.laneSum[k], sumLo);
+        _mm_storeu_pd(&seg.laneSum[k + 2], sumHi);
+        _mm_storeu_pd(&seg.laneSq[k], sqLo);
+        _mm_storeu_pd(&seg.laneSq[k + 2], sqHi);
+        clip |= (0 != _mm_movemask_ps(fs));
+    }
+#else
+    for (int i=0; i<n; ++i) {
+        const int l = i % lanes;
+        const float v = s[i];
+        seg.laneMinF[l] = std::min(seg.laneMinF[l], v);
+        seg.laneMaxF[l] = std::max(seg.laneMaxF[l], v);
+        seg.laneSum[l] += v;
+        seg.laneSq[l]  += (double)v * v;
+        clip |= (1.0f <= fabsf(v));
+    }
+#endif
+    return clip;
+}
+
+/// samples of the block after the last multiple of lanes. from is the sample index in the block
+static bool
+AccumulateIntTail(const Job &job, const int32_t *s, int from, int n, Segment &seg)
+{
+    bool clip = false;
+    for (int i=from; i<n; ++i) {
+        const int l = i % job.lanes;
+        const int32_t v = s[i];
+        seg.laneMin[l] = std::min(seg.laneMin[l], v);
+        seg.laneMax[l] = std::max(seg.laneMax[l], v);
+        seg.laneOr[l] |= (uint32_t)v;
+        seg.laneSum[l] += v;
+        seg.laneSq[l]  += (double)v * v;
+        clip |= (job.posFullScale <= v || INT32_MIN == v);
+    }
+    return clip;
+}
+
+static bool
+AccumulateFloatTail(const Job &job, const float *s, int from, int n, Segment &seg)
+{
+    bool clip = false;
+    for (int i=from; i<n; ++i) {
+        const int l = i % job.lanes;
+        const float v = s[i];
+        seg.laneMinF[l] = std::min(seg.laneMinF[l], v);
+        seg.laneMaxF[l] = std::max(seg.laneMaxF[l], v);
+        seg.laneSum[l] += v;
+        seg.laneSq[l]  += (double)v * v;
+        clip |= (1.0f <= fabsf(v));
+    }
+    return clip;
+}
+
+/// converts integer samples to 32bit left aligned
+static void
+DecodeInt(const unsigned char *p, int bitsPerSample, int n, int32_t *s_return)
+{
+    int i = 0;
+
+    switch (bitsPerSample) {
+    case 8:
+        // unsigned
+        for (; i<n; ++i) {
+            s_return[i] = (int32_t)((uint32_t)(p[i] ^ 0x80) << 24);
+        }
+        break;
+    case 16:
+#ifdef WW_WAV_STATS_USE_SSE
+        // interleaving zeros below the 16bit samples makes them 32bit left aligned
+        for (; i + 8 <= n; i += 8) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)&p[2 * i]);
+            _mm_storeu_si128((__m128i *)&s_return[i],     _mm_unpacklo_epi16(_mm_setzero_si128(), v));
+            _mm_storeu_si128((__m128i *)&s_return[i + 4], _mm_unpackhi_epi16(_mm_setzero_si128(), v));
+        }
+#endif
+        for (; i<n; ++i) {
+            s_return[i] = (int32_t)(((uint32_t)p[2 * i] << 16) | ((uint32_t)p[2 * i + 1] << 24));
+        }
+        break;
+    case 24:
+        for (; i<n; ++i) {
+            s_return[i] = (int32_t)(((uint32_t)p[3 * i] << 8) | ((uint32_t)p[3 * i + 1] << 16)
+                    | ((uint32_t)p[3 * i + 2] << 24));
+        }
+        break;
+    case 32:
+        memcpy(s_return, p, sizeof(int32_t) * n);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+static void
+ScanClipRunsInt(const Job &job, const int32_t *s, int frames, Segment &seg)
+{
+    const int numCh = job.f.numChannels;
+    for (int i=0; i<frames; ++i) {
+        for (int ch=0; ch<numCh; ++ch) {
+            const int32_t v = s[i * numCh + ch];
+            if (job.posFullScale <= v || INT32_MIN == v) {
+                seg.runs[ch].Clipped();
+            } else {
+                seg.runs[ch].NotClipped(job.p.clipRunMinLength);
+            }
+        }
+    }
+}
+
+static void
+ScanClipRunsFloat(const Job &job, const float *s, int frames, Segment &seg)
+{
+    const int numCh = job.f.numChannels;
+    for (int i=0; i<frames; ++i) {
+        for (int ch=0; ch<numCh; ++ch) {
+            if (1.0f <= fabsf(s[i * numCh + ch])) {
+                seg.runs[ch].Clipped();
+            } else {
+                seg.runs[ch].NotClipped(job.p.clipRunMinLength);
+            }
+        }
+    }
+}
+
+/// the block has no full scale sample: the runs of all channels end at the first frame
+static void
+EndClipRuns(const Job &job, Segment &seg)
+{
+    for (int ch=0; ch<job.f.numChannels; ++ch) {
+        ClipRuns &r = seg.runs[ch];
+        if (r.inHead || 0 < r.run) {
+            r.NotClipped(job.p.clipRunMinLength);
+        }
+    }
+}
+
+static void
+FlushHistogram(Job &job, std::vector<uint32_t> &h)
+{
+    std::lock_guard<std::mutex> lock(job.histogramMutex);
+    for (size_t i=0; i<h.size(); ++i) {
+        job.histogram[i] += h[i];
+    }
+    std::fill(h.begin(), h.end(), 0);
+}
+
+static void
+ProcessSegment(Job &job, Segment &seg)
+{
+    const WWWavStatsFormat &f = job.f;
+    const int numCh = f.numChannels;
+    const int frameBytes = f.FrameBytes();
+    const int bins = job.bins;
+    const int hb = job.p.histogramBits;
+
+    std::vector<int32_t> si;
+    std::vector<float> sf;
+    if (f.isFloat) {
+        sf.resize((size_t)BLOCK_FRAMES * numCh);
+    } else {
+        si.resize((size_t)BLOCK_FRAMES * numCh);
+    }
+
+    std::vector<uint32_t> h((size_t)bins * numCh, 0);
+    int64_t unflushedFrames = 0;
+
+    for (int64_t pos=0; pos<seg.numFrames; pos += BLOCK_FRAMES) {
+        const int frames = (int)std::min((int64_t)BLOCK_FRAMES, seg.numFrames - pos);
+        const int n = frames * numCh;
+        const int nVec = n / job.lanes * job.lanes;
+        const unsigned char *p = &job.data[f.dataOffset + (size_t)(seg.fromFrame + pos) * frameBytes];
+
+        bool clip;
+        if (f.isFloat) {
+            memcpy(&sf[0], p, sizeof(float) * n);
+            clip = AccumulateFloat(job, &sf[0], nVec, seg);
+            clip = AccumulateFloatTail(job, &sf[0], nVec, n, seg) || clip;
+
+            // histogram and the 24bit grid
+            const float half = (float)(bins / 2);
+            for (int i=0; i<frames; ++i) {
+                for (int ch=0; ch<numCh; ++ch) {
+                    const float v = sf[i * numCh + ch];
+
+                    if (0 < hb) {
+                        const float x = (v + 1.0f) * half;
+                        int b = 0;
+                        if (!(0.0f <= x)) {
+                            b = 0;
+                        } else if ((float)bins <= x) {
+                            b = bins - 1;
+                        } else {
+                            b = (int)x;
+                        }
+                        ++h[(size_t)ch * bins + b];
+                    }
+
+                    const float g = v * 8388608.0f;
+                    if (-8388608.0f <= g && g <= 8388608.0f && (float)(int32_t)g == g) {
+                        seg.floatOr[ch] |= (uint32_t)(int32_t)g << 8;
+                    } else {
+                        ++seg.offGrid[ch];
+                    }
+                }
+            }
+        } else {
+            DecodeInt(p, f.bitsPerSample, n, &si[0]);
+            clip = AccumulateInt(job, &si[0], nVec, seg);
+            clip = AccumulateIntTail(job, &si[0], nVec, n, seg) || clip;
+
+            if (0 < hb) {
+                const int shift = 32 - hb;
+                for (int i=0; i<frames; ++i) {
+                    uint32_t *hf = &h[0];
+                    for (int ch=0; ch<numCh; ++ch) {
+                        ++hf[((uint32_t)si[i * numCh + ch] ^ 0x80000000U) >> shift];
+                        hf += bins;
+                    }
+                }
+            }
+        }
+
+        if (clip) {
+            if (f.isFloat) {
+                ScanClipRunsFloat(job, &sf[0], frames, seg);
+            } else {
+                ScanClipRunsInt(job, &si[0], frames, seg);
+            }
+        } else {
+            EndClipRuns(job, seg);
+        }
+
+        unflushedFrames += frames;
+        if (0 < hb && HISTOGRAM_FLUSH_FRAMES <= unflushedFrames) {
+            FlushHistogram(job, h);
+            unflushedFrames = 0;
+        }
+    }
+
+    if (0 < hb) {
+        FlushHistogram(job, h);
+    }
+}
+
+static int
+CountTrailingZeros(uint32_t v)
+{
+    assert(v);
+    int n = 0;
+    while (0 == (v & 1)) {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+}
+
+static int
+Gcd(int a, int b)
+{
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int
+WWWavStatsAnalyze(const unsigned char *wav, size_t bytes, const WWWavStatsParams &p, WWWavStats &s_return)
+{
+    s_return = WWWavStats();
+
+    if (p.histogramBits < 0 || 24 < p.histogramBits || p.clipRunMinLength < 1) {
+        return -1;
+    }
+
+    Job job;
+    if (WWWavStatsParseHeader(wav, bytes, job.f) < 0) {
+        return -1;
+    }
+
+    const WWWavStatsFormat &f = job.f;
+    const int numCh = f.numChannels;
+    const int64_t numFrames = f.NumFrames();
+
+    job.data  = wav;
+    job.p     = p;
+
+    // bins finer than the integer samples are always empty
+    if (!f.isFloat) {
+        job.p.histogramBits = std::min(p.histogramBits, f.bitsPerSample);
+    }
+    job.lanes = 4 * numCh / Gcd(4, numCh);
+    job.bins  = (0 < job.p.histogramBits) ? (1 << job.p.histogramBits) : 0;
+    job.posFullScale = (int32_t)((((uint32_t)1 << (f.validBitsPerSample - 1)) - 1) << (32 - f.validBitsPerSample));
+    job.histogram.assign((size_t)job.bins * numCh, 0);
+
+    // one segment per worker
+    int numThreads = p.numThreads;
+    if (numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+    }
+    numThreads = (int)std::min((int64_t)numThreads, (int64_t)(f.dataBytes / MIN_SEGMENT_BYTES));
+    if (0 < job.bins) {
+        const size_t workerBytes = sizeof(uint32_t) * job.bins * numCh;
+        numThreads = (int)std::min((size_t)numThreads, HISTOGRAM_MEMORY_LIMIT / workerBytes);
+    }
+    numThreads = std::max(1, numThreads);
+
+    std::vector<Segment> segs(numThreads);
+    for (int i=0; i<numThreads; ++i) {
+        Segment &seg = segs[i];
+        seg.fromFrame = numFrames * i / numThreads;
+        seg.numFrames = numFrames * (i + 1) / numThreads - seg.fromFrame;
+
+        seg.laneMin.assign(job.lanes, INT32_MAX);
+        seg.laneMax.assign(job.lanes, INT32_MIN);
+        seg.laneMinF.assign(job.lanes, HUGE_VALF);
+        seg.laneMaxF.assign(job.lanes, -HUGE_VALF);
+        seg.laneOr.assign(job.lanes, 0);
+        seg.laneSum.assign(job.lanes, 0.0);
+        seg.laneSq.assign(job.lanes, 0.0);
+        seg.runs.resize(numCh);
+        seg.floatOr.assign(numCh, 0);
+        seg.offGrid.assign(numCh, 0);
+    }
+
+    std::vector<std::thread> threads;
+    for (int i=1; i<numThreads; ++i) {
+        threads.push_back(std::thread(ProcessSegment, std::ref(job), std::ref(segs[i])));
+    }
+    ProcessSegment(job, segs[0]);
+    for (size_t i=0; i<threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    // merge the segments in the file order
+    s_return.format = f;
+    s_return.histogramBits = job.p.histogramBits;
+    s_return.channels.resize(numCh);
+
+    const double scale = f.isFloat ? 1.0 : ldexp(1.0, 32 - f.bitsPerSample);
+
+    for (int ch=0; ch<numCh; ++ch) {
+        WWWavStatsChannel &c = s_return.channels[ch];
+        c.numSamples = numFrames;
+
+        double mn = HUGE_VAL;
+        double mx = -HUGE_VAL;
+        double sum = 0;
+        double sq = 0;
+        uint32_t bits = 0;
+        ClipRuns total;
+        int64_t carry = 0;
+
+        for (int i=0; i<numThreads; ++i) {
+            const Segment &seg = segs[i];
+            for (int l=ch; l<job.lanes; l += numCh) {
+                mn = std::min(mn, f.isFloat ? (double)seg.laneMinF[l] : (double)seg.laneMin[l]);
+                mx = std::max(mx, f.isFloat ? (double)seg.laneMaxF[l] : (double)seg.laneMax[l]);
+                sum += seg.laneSum[l];
+                sq  += seg.laneSq[l];
+                bits |= seg.laneOr[l];
+            }
+            bits |= seg.floatOr[ch];
+            c.offGridSamples += seg.offGrid[ch];
+
+            const ClipRuns &r = seg.runs[ch];
+            total.clipped += r.clipped;
+            if (r.inHead) {
+                // the whole segment is one run
+                carry += r.run;
+            } else {
+                total.End(carry + r.head, p.clipRunMinLength);
+                total.clipRuns += r.clipRuns;
+                total.longest = std::max(total.longest, r.longest);
+                carry = r.run;
+            }
+        }
+        total.End(carry, p.clipRunMinLength);
+
+        if (0 < numFrames) {
+            c.minValue = mn / scale;
+            c.maxValue = mx / scale;
+            c.dcOffset = sum / numFrames / scale;
+            c.rms      = sqrt(sq / numFrames) / scale;
+        }
+        c.clippedSamples = total.clipped;
+        c.clipRuns       = total.clipRuns;
+        c.longestClipRun = total.longest;
+        c.usedBits       = bits ? 32 - CountTrailingZeros(bits) : 0;
+
+        if (0 < job.bins) {
+            c.histogram.assign(job.histogram.begin() + (size_t)ch * job.bins,
+                    job.histogram.begin() + (size_t)(ch + 1) * job.bins);
+        }
+    }
+
+    return 0;
+}
+
+int
+WWWavStatsAnalyzeFile(const char *path, const WWWavStatsParams &p, WWWavStats &s_return)
+{
+    WWMappedFile mf;
+    if (mf.Open(path) < 0) {
+        s_return = WWWavStats();
+        return -1;
+    }
+    return WWWavStatsAnalyze(mf.Data(), mf.Bytes(), p, s_return);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// sample format of the data chunk of a WAV file
+struct WWWavStatsFormat {
+    int numChannels;
+    int sampleRate;
+
+    /// container bits: 8, 16, 24 or 32
+    int bitsPerSample;
+
+    /// wValidBitsPerSample of WAVEFORMATEXTENSIBLE, otherwise bitsPerSample
+    int validBitsPerSample;
+
+    /// true: 32bit float. false: integer
+    bool isFloat;
+
+    /// position and size of the sample data in the file
+    size_t dataOffset;
+    size_t dataBytes;
+
+    WWWavStatsFormat(void) : numChannels(0), sampleRate(0), bitsPerSample(0), validBitsPerSample(0), isFloat(false),
+            dataOffset(0), dataBytes(0) { }
+
+    int FrameBytes(void) const { return numChannels * bitsPerSample / 8; }
+    int64_t NumFrames(void) const { return 0 < FrameBytes() ? (int64_t)(dataBytes / FrameBytes()) : 0; }
+};
+
+struct WWWavStatsParams {
+    /// 0: number of the CPU cores
+    int numThreads;
+
+    /// bins of the histogram are 2^histogramBits. 0: no histogram. 1 to 24.
+    /// integer samples are binned by their top histogramBits bits (at most bitsPerSample), float samples by [-1, 1)
+    /// divided evenly
+    int histogramBits;
+
+    /// consecutive full scale samples of a channel at least this long are counted as a clipping run
+    int clipRunMinLength;
+
+    WWWavStatsParams(void) : numThreads(0), histogramBits(16), clipRunMinLength(3) { }
+};
+
+struct WWWavStatsChannel {
+    int64_t numSamples;
+
+    /// in the sample value: LSB of the container bits for integer samples (-32768 to 32767 for 16bit), as is for float
+    double minValue;
+    double maxValue;
+
+    /// mean and root mean square in the same unit as minValue
+    double dcOffset;
+    double rms;
+
+    /// samples at the positive or negative full scale of validBitsPerSample. |v| >= 1.0 for float
+    int64_t clippedSamples;
+    int64_t clipRuns;
+    int64_t longestClipRun;
+
+    /// significant bits: the number of bits from the MSB to the lowest bit set in any sample. 0 when silent.
+    /// float samples are measured on the 24bit grid
+    int usedBits;
+
+    /// float samples not on the 24bit grid. 0 for integer samples
+    int64_t offGridSamples;
+
+    /// 2^histogramBits counts. bin 0 is the most negative. see WWWavStatsHistogramBinValue()
+    std::vector<uint64_t> histogram;
+
+    WWWavStatsChannel(void) : numSamples(0), minValue(0), maxValue(0), dcOffset(0), rms(0),
+            clippedSamples(0), clipRuns(0), longestClipRun(0), usedBits(0), offGridSamples(0) { }
+};
+
+struct WWWavStats {
+    WWWavStatsFormat format;
+
+    /// histogramBits of WWWavStatsParams used
+    int histogramBits;
+    std::vector<WWWavStatsChannel> channels;
+
+    WWWavStats(void) : histogramBits(0) { }
+};
+
+/// reads the RIFF WAVE header on memory. PCM and IEEE float, WAVEFORMATEX and WAVEFORMATEXTENSIBLE.
+/// a data chunk larger than the rest of the file is truncated
+/// @return 0: success. negative: not a supported WAV file
+int WWWavStatsParseHeader(const unsigned char *wav, size_t bytes, WWWavStatsFormat &f_return);
+
+/// lowest sample value of the histogram bin, in the unit of WWWavStatsChannel::minValue
+double WWWavStatsHistogramBinValue(const WWWavStatsFormat &f, int histogramBits, int bin);
+
+/// measures the samples of the WAV file image.
+///
+///   The data chunk is split into one segment per worker thread. Each worker decodes its segment in blocks,
+///   accumulates min, max, sum, sum of squares and the bit usage 4 samples at once by SSE2 and scans for the
+///   clipping runs only in the blocks that have a full scale sample. The runs that cross a segment boundary
+///   are joined on merging the segment results.
+/// @return 0: success. negative: not a supported WAV file or bad parameter
+int WWWavStatsAnalyze(const unsigned char *wav, size_t bytes, const WWWavStatsParams &p, WWWavStats &s_return);
+
+/// memory maps the file by WWMappedFile and measures it
+/// @return 0: success. negative: could not open the file or not a supported WAV file
+int WWWavStatsAnalyzeFile(const char *path, const WWWavStatsParams &p, WWWavStats &s_return);
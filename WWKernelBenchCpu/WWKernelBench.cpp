@@ -0,0 +1,219 @@
+#include "WWKernelBench.h"
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#else
+#  include <sched.h>
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  define WW_KERNEL_BENCH_SSE2 (true)
+#else
+#  define WW_KERNEL_BENCH_SSE2 (false)
+#endif
+
+/// upper bound of the calls per sample, for a kernel that is optimized away
+#define MAX_CALLS_PER_SAMPLE (1LL << 30)
+
+int
+WWKernelBenchPinCpu(int cpu)
+{
+#ifdef _WIN32
+    if (cpu < 0 || 64 <= cpu) {
+        return -1;
+    }
+    if (0 == SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu)) {
+        return -1;
+    }
+    return 0;
+#else
+    if (cpu < 0 || CPU_SETSIZE <= cpu) {
+        return -1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof set, &set);
+#endif
+}
+
+/// @return seconds of calls calls of fn
+static double
+TimeCalls(const std::function<void(void)> &fn, int64_t calls)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    for (int64_t i=0; i<calls; ++i) {
+        fn();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static double
+Median(std::vector<double> sorted)
+{
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    return (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) * 0.5;
+}
+
+static void
+ComputeStats(WWKernelBenchResult &r)
+{
+    std::vector<double> s(r.ns);
+    std::sort(s.begin(), s.end());
+    const int n = (int)s.size();
+
+    r.minNs = s.front();
+    r.maxNs = s.back();
+    r.medianNs = Median(s);
+
+    double sum = 0;
+    for (int i=0; i<n; ++i) {
+        sum += s[i];
+    }
+    r.meanNs = sum / n;
+
+    double sum2 = 0;
+    for (int i=0; i<n; ++i) {
+        sum2 += (s[i] - r.meanNs) * (s[i] - r.meanNs);
+    }
+    r.stddevNs = (1 < n) ? sqrt(sum2 / (n - 1)) : 0;
+
+    std::vector<double> dev(n);
+    for (int i=0; i<n; ++i) {
+        dev[i] = fabs(s[i] - r.medianNs);
+    }
+    r.madNs = Median(dev);
+
+    // ranks n/2 -+ 1.96 sqrt(n)/2 (1 based) of the binomial distribution of the samples below the median
+    const double half = 0.98 * sqrt((double)n);
+    const int lo = std::max(1, (int)floor(n * 0.5 - half));
+    const int hi = std::min(n, (int)ceil(n * 0.5 + 1 + half));
+    r.medianCiLowNs  = s[lo - 1];
+    r.medianCiHighNs = s[hi - 1];
+
+    r.samplesPerSecond = (0 < r.medianNs) ? r.c->samplesPerCall / r.medianNs * 1.0e9 : 0;
+}
+
+int
+WWKernelBenchMeasure(const WWKernelBenchCase &c, const WWKernelBenchParams &p, WWKernelBenchResult &r_return)
+{
+    assert(0 < p.repeat && 0 <= p.warmUp);
+
+    r_return = WWKernelBenchResult();
+    r_return.c = &c;
+
+    std::function<void(void)> fn = c.Setup();
+    if (!fn) {
+        return -1;
+    }
+
+    // the calibration calls warm up the caches and the branch predictors too
+    int64_t calls = 1;
+    while (calls < MAX_CALLS_PER_SAMPLE && TimeCalls(fn, calls) < p.minSampleSeconds) {
+        calls *= 2;
+    }
+    r_return.callsPerSample = calls;
+
+    for (int i=0; i<p.warmUp; ++i) {
+        TimeCalls(fn, calls);
+    }
+
+    r_return.ns.resize(p.repeat);
+    for (int i=0; i<p.repeat; ++i) {
+        r_return.ns[i] = TimeCalls(fn, calls) * 1.0e9 / calls;
+    }
+
+    ComputeStats(r_return);
+    return 0;
+}
+
+static void
+WriteJsonString(FILE *fp, const std::string &s)
+{
+    fputc('"', fp);
+    for (size_t i=0; i<s.size(); ++i) {
+        const unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static std::string
+CompilerName(void)
+{
+#if defined(_MSC_FULL_VER)
+    return "MSVC " + std::to_string((long long)_MSC_FULL_VER);
+#elif defined(__clang__)
+    return "clang " + std::to_string((long long)__clang_major__) + "." + std::to_string((long long)__clang_minor__);
+#elif defined(__GNUC__)
+    return "gcc " + std::to_string((long long)__GNUC__) + "." + std::to_string((long long)__GNUC_MINOR__);
+#else
+    return "unknown";
+#endif
+}
+
+static std::string
+UtcTime(void)
+{
+    const time_t t = time(nullptr);
+    struct tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    char s[32];
+    strftime(s, sizeof s, "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return s;
+}
+
+void
+WWKernelBenchWriteJson(FILE *fp, const WWKernelBenchReport &report)
+{
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"label\": ");
+    WriteJsonString(fp, report.label);
+    fprintf(fp, ",\n  \"time\": ");
+    WriteJsonString(fp, UtcTime());
+    fprintf(fp, ",\n  \"host\": {\"compiler\": ");
+    WriteJsonString(fp, CompilerName());
+    fprintf(fp, ", \"sse2\": %s, \"hardwareThreads\": %u, \"pinnedCpu\": %d},\n",
+        WW_KERNEL_BENCH_SSE2 ? "true" : "false", std::thread::hardware_concurrency(), report.pinnedCpu);
+    fprintf(fp, "  \"settings\": {\"repeat\": %d, \"warmUp\": %d, \"minSampleSeconds\": %g},\n",
+        report.params.repeat, report.params.warmUp, report.params.minSampleSeconds);
+    fprintf(fp, "  \"results\": [");
+
+    for (size_t i=0; i<report.results.size(); ++i) {
+        const WWKernelBenchResult &r = report.results[i];
+        fprintf(fp, "%s\n    {\"name\": ", (0 == i) ? "" : ",");
+        WriteJsonString(fp, r.c->name);
+        fprintf(fp, ", \"params\": {");
+        for (size_t j=0; j<r.c->params.size(); ++j) {
+            fprintf(fp, "%s", (0 == j) ? "" : ", ");
+            WriteJsonString(fp, r.c->params[j].first);
+            fprintf(fp, ": %lld", (long long)r.c->params[j].second);
+        }
+        fprintf(fp, "},\n     \"samplesPerCall\": %lld, \"callsPerSample\": %lld, \"samplesPerSecond\": %.6g,\n",
+            (long long)r.c->samplesPerCall, (long long)r.callsPerSample, r.samplesPerSecond);
+        fprintf(fp, "     \"nsPerCall\": {\"median\": %.6g, \"medianCiLow\": %.6g, \"medianCiHigh\": %.6g, "
+            "\"mad\": %.6g, \"min\": %.6g, \"max\": %.6g, \"mean\": %.6g, \"stddev\": %.6g}}",
+            r.medianNs, r.medianCiLowNs, r.medianCiHighNs, r.madNs, r.minNs, r.maxNs, r.meanNs, r.stddevNs);
+    }
+
+    fprintf(fp, "\n  ]\n}\n");
+}
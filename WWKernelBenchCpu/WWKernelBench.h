@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct WWKernelBenchParams {
+    /// number of the measured samples of a case
+    int repeat;
+
+    /// samples measured and discarded before the measured samples
+    int warmUp;
+
+    /// the number of the calls of a sample is doubled until a sample takes this long
+    double minSampleSeconds;
+
+    WWKernelBenchParams(void) : repeat(21), warmUp(2), minSampleSeconds(0.01) { }
+};
+
+/// a kernel and its parameters.
+///   Setup() allocates the buffers and the state of the kernel and returns the function measured.
+///   the state is freed after the case is measured, so only one case holds its buffers at a time
+struct WWKernelBenchCase {
+    /// such as "dsd/decimator"
+    std::string name;
+
+    /// such as {"channels", 2}, {"frames", 4096}. written to the JSON as they are
+    std::vector<std::pair<std::string, int64_t> > params;
+
+    /// channels x frames of the input of one call. a DSD bit is a frame
+    int64_t samplesPerCall;
+
+    std::function<std::function<void(void)>(void)> Setup;
+
+    WWKernelBenchCase(void) : samplesPerCall(0) { }
+};
+
+struct WWKernelBenchResult {
+    const WWKernelBenchCase *c;
+
+    /// calls of a sample
+    int64_t callsPerSample;
+
+    /// nanoseconds per call of the measured samples
+    std::vector<double> ns;
+
+    double minNs;
+    double maxNs;
+    double meanNs;
+    double stddevNs;
+    double medianNs;
+
+    /// median absolute deviation from the median
+    double madNs;
+
+    /// distribution free 95% confidence interval of the median by the order statistics of the samples
+    double medianCiLowNs;
+    double medianCiHighNs;
+
+    /// samplesPerCall / medianNs
+    double samplesPerSecond;
+
+    WWKernelBenchResult(void) : c(nullptr), callsPerSample(0), minNs(0), maxNs(0), meanNs(0), stddevNs(0),
+            medianNs(0), madNs(0), medianCiLowNs(0), medianCiHighNs(0), samplesPerSecond(0) { }
+};
+
+/// pins the calling thread to the cpu. the threads created afterwards by the kernels inherit it on Linux
+/// @return 0: success. negative: not supported or bad cpu number
+int WWKernelBenchPinCpu(int cpu);
+
+/// measures the case: calibrates the calls per sample, discards p.warmUp samples and measures p.repeat samples
+/// @return 0: success. negative: Setup() failed (returned an empty function)
+int WWKernelBenchMeasure(const WWKernelBenchCase &c, const WWKernelBenchParams &p, WWKernelBenchResult &r_return);
+
+struct WWKernelBenchReport {
+    /// such as the commit id. given by the command line
+    std::string label;
+    int pinnedCpu;
+    WWKernelBenchParams params;
+    std::vector<WWKernelBenchResult> results;
+
+    WWKernelBenchReport(void) : pinnedCpu(-1) { }
+};
+
+/// writes the report as a JSON object: the host, the settings and a result per case
+void WWKernelBenchWriteJson(FILE *fp, const WWKernelBenchReport &report);
@@ -0,0 +1,71 @@
+// WWAudioTap includes the WWPcmData.h of WasapiIODLL, which is not the one of PlayPcm that main.cpp includes.
+// this file is separate from main.cpp for it.
+
+#include "WWKernelBenchTap.h"
+
+#ifdef _WIN32
+
+#include "../WasapiIODLL/WWAudioTap.h"
+#include <string.h>
+#include <algorithm>
+#include <memory>
+
+void
+WWKernelBenchAddTapCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const int sampleRate = 48000;
+    static const int channelsList[] = { 2, 8 };
+
+    // 10ms period of the shared mode, and larger periods of the exclusive mode
+    static const int framesList[] = { 480, 1024, 4096 };
+
+    for (int ch : channelsList) {
+        for (int frames : framesList) {
+            const int bytes = ch * frames * 4;
+
+            WWKernelBenchCase c;
+            c.params = {{"channels", ch}, {"frames", frames}, {"sampleRate", sampleRate}};
+            c.samplesPerCall = (int64_t)ch * frames;
+
+            c.name = "tap/write";
+            c.Setup = [ch, frames, bytes]() {
+                auto tap = std::make_shared<WWAudioTap>();
+                auto buf = std::make_shared<std::vector<unsigned char> >((size_t)bytes, 0x3f);
+                tap->UpdateFormat(sampleRate, WWPcmDataSampleFormatSfloat, WWStreamPcm, ch);
+                tap->SetEnabled(true);
+
+                // the analysis thread reads the ring only every 30ms and the calls of the benchmark are
+                // far faster than the real time. the ring is emptied before it is full, so that every call
+                // copies the period as on the render thread. the ring is at least 0.5 seconds
+                const int callsPerDiscard = std::max(1, sampleRate / 2 / frames);
+                auto calls = std::make_shared<int>(0);
+                return std::function<void(void)>([tap, buf, bytes, calls, callsPerDiscard]() {
+                    tap->Write(buf->data(), bytes);
+                    if (callsPerDiscard <= ++*calls) {
+                        *calls = 0;
+                        tap->DiscardUnread();
+                    }
+                });
+            };
+            cases.push_back(c);
+
+            c.name = "tap/memcpy";
+            c.Setup = [bytes]() {
+                auto from = std::make_shared<std::vector<unsigned char> >((size_t)bytes, 0x3f);
+                auto to = std::make_shared<std::vector<unsigned char> >((size_t)bytes);
+                return std::function<void(void)>([from, to, bytes]() { memcpy(to->data(), from->data(), bytes); });
+            };
+            cases.push_back(c);
+        }
+    }
+}
+
+#else
+
+void
+WWKernelBenchAddTapCases(std::vector<WWKernelBenchCase> &cases)
+{
+    (void)cases;
+}
+
+#endif
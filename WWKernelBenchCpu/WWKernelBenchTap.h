@@ -0,0 +1,7 @@
+#pragma once
+
+#include "WWKernelBench.h"
+
+/// tap/write: WWAudioTap::Write() of a period on the render thread, and tap/memcpy: memcpy of the same bytes.
+/// the tap is of WasapiIODLL and the cases are added on Windows only
+void WWKernelBenchAddTapCases(std::vector<WWKernelBenchCase> &cases);
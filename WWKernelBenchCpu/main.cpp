@@ -0,0 +1,624 @@
+// Microbenchmark of the sample processing kernels. Portable C++: builds on Windows and Linux.
+// Prints the results as JSON so that the runs of the commits can be compared.
+
+#include "WWKernelBench.h"
+#include "WWKernelBenchTap.h"
+#include "WWFft.h"
+#include "WWQuantizer.h"
+#include "WWNoise.h"
+#include "WWSfmt.h"
+#include "WWBiquad.h"
+#include "WWDsdDecimator.h"
+#include "WWDsdModulator.h"
+#include "WWPartitionedConvolver.h"
+#include "WWNonUniformConvolver.h"
+#include "WWCrossfeed.h"
+#include "WWDsdToDop.h"
+#include "WWAFFilterFactory.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, int64_t> > Params;
+
+/// uniform white noise of [-0.5, 0.5) by a 32bit LCG, the same sequence on every run
+static void
+Noise(size_t n, std::vector<float> &v_return)
+{
+    v_return.resize(n);
+    uint32_t x = 1;
+    for (size_t i=0; i<n; ++i) {
+        x = x * 1664525u + 1013904223u;
+        v_return[i] = (float)((int32_t)x * (1.0 / 4294967296.0));
+    }
+}
+
+static void
+NoiseBytes(size_t n, std::vector<unsigned char> &v_return)
+{
+    std::vector<float> f;
+    Noise(n, f);
+    v_return.resize(n);
+    for (size_t i=0; i<n; ++i) {
+        v_return[i] = (unsigned char)(int)((f[i] + 0.5f) * 256.0f);
+    }
+}
+
+/// decaying noise as a long impulse response
+static void
+ImpulseResponse(int taps, std::vector<float> &h_return)
+{
+    Noise(taps, h_return);
+    for (int i=0; i<taps; ++i) {
+        h_return[i] *= (float)exp(-6.0 * i / taps);
+    }
+}
+
+static void
+Add(std::vector<WWKernelBenchCase> &cases, const char *name, const Params &params, int64_t samplesPerCall,
+        const std::function<std::function<void(void)>(void)> &setup)
+{
+    WWKernelBenchCase c;
+    c.name = name;
+    c.params = params;
+    c.samplesPerCall = samplesPerCall;
+    c.Setup = setup;
+    cases.push_back(c);
+}
+
+static void
+AddFftCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const int sizes[] = { 256, 1024, 4096, 16384, 65536 };
+
+    for (int n : sizes) {
+        Add(cases, "fft/realForward", {{"n", n}}, n, [n]() {
+            auto fft = std::make_shared<WWRealFft>();
+            auto in = std::make_shared<std::vector<float> >();
+            auto out = std::make_shared<std::vector<float> >(n + 2);
+            fft->Init(n);
+            Noise(n, *in);
+            return [fft, in, out, n]() { fft->Forward(in->data(), out->data(), out->data() + n / 2 + 1); };
+        });
+        Add(cases, "fft/realForwardDouble", {{"n", n}}, n, [n]() {
+            auto fft = std::make_shared<WWRealFftD>();
+            auto in = std::make_shared<std::vector<double> >(n);
+            auto out = std::make_shared<std::vector<double> >(n + 2);
+            fft->Init(n);
+            std::vector<float> f;
+            Noise(n, f);
+            std::copy(f.begin(), f.end(), in->begin());
+            return [fft, in, out, n]() { fft->Forward(in->data(), out->data(), out->data() + n / 2 + 1); };
+        });
+    }
+}
+
+/// float to integer conversion of the last stage of the render path
+static void
+AddQuantizerCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const struct {
+        WWQuantizerType type;
+        const char *name;
+    } types[] = {
+        { WWQT_None,           "quantizer/none" },
+        { WWQT_Tpdf,           "quantizer/tpdf" },
+        { WWQT_NoiseShaping2,  "quantizer/noiseShaping2" },
+        { WWQT_NoiseShaping4,  "quantizer/noiseShaping4" },
+    };
+    static const int channels[] = { 2, 8 };
+    static const int frames[] = { 256, 1024, 4096 };
+    static const int bitsList[] = { 24, 16 };
+
+    for (int bits : bitsList) {
+        for (const auto &t : types) {
+            for (int ch : channels) {
+                for (int n : frames) {
+                    const WWQuantizerType type = t.type;
+                    Add(cases, t.name, {{"channels", ch}, {"frames", n}, {"bits", bits}}, (int64_t)ch * n,
+                            [type, ch, n, bits]() {
+                        auto q = std::make_shared<WWQuantizer>();
+                        auto in = std::make_shared<std::vector<float> >();
+                        auto out = std::make_shared<std::vector<int32_t> >((size_t)ch * n);
+                        q->Init(type, ch, bits);
+                        Noise((size_t)ch * n, *in);
+                        return [q, in, out, n]() { q->Process(in->data(), n, out->data()); };
+                    });
+                }
+            }
+        }
+    }
+
+    // the random numbers of the dither. a sample is a uint32
+    static const int sfmtSizes[] = { 4096, 1024 * 1024 };
+    for (int n : sfmtSizes) {
+        Add(cases, "sfmt/fill", {{"n", n}}, n, [n]() {
+            auto sfmt = std::make_shared<WWSfmt>();
+            auto out = std::make_shared<std::vector<uint32_t> >((size_t)n);
+            sfmt->Init(1);
+            return [sfmt, out]() { sfmt->Fill(out->data(), out->size()); };
+        });
+    }
+}
+
+/// dither and test signal noise
+static void
+AddNoiseCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const struct {
+        WWNoiseType type;
+        const char *name;
+        const char *intName;
+    } types[] = {
+        { WWNT_Uniform,       "noise/uniform",      "noise/uniformInt" },
+        { WWNT_Tpdf,          "noise/tpdf",         "noise/tpdfInt" },
+        { WWNT_TpdfHighPass,  "noise/tpdfHighPass", "noise/tpdfHighPassInt" },
+        { WWNT_Gaussian,      "noise/gaussian",     "noise/gaussianInt" },
+        { WWNT_Pink,          "noise/pink",         "noise/pinkInt" },
+    };
+    const int ch = 2;
+    const int n = 4096;
+
+    for (const auto &t : types) {
+        const WWNoiseType type = t.type;
+        Add(cases, t.name, {{"channels", ch}, {"frames", n}}, (int64_t)ch * n, [type, ch, n]() {
+            auto noise = std::make_shared<WWNoise>();
+            auto out = std::make_shared<std::vector<float> >((size_t)ch * n);
+            noise->Init(type, ch, 0.5f);
+            return [noise, out, n]() { noise->Generate(out->data(), n); };
+        });
+
+        Add(cases, t.intName, {{"channels", ch}, {"frames", n}, {"bits", 24}}, (int64_t)ch * n,
+                [type, ch, n]() {
+            auto noise = std::make_shared<WWNoise>();
+            auto out = std::make_shared<std::vector<int32_t> >((size_t)ch * n);
+            noise->Init(type, ch, 0.5f);
+            return [noise, out, n]() { noise->GenerateInt(out->data(), n, 24); };
+        });
+    }
+}
+
+/// peaking filters from 30Hz to 18kHz. set 1 is of the other gain, frequency and Q, the target of the crossfade
+static void
+EqStages(int stages, int set, std::vector<WWBiquadCoeffs> &c_return)
+{
+    c_return.resize(stages);
+    for (int s=0; s<stages; ++s) {
+        const double freq = 30.0 * pow(600.0, (double)s / stages);
+        if (0 == set) {
+            WWBiquadDesign(WWBT_Peaking, 44100, freq, (s & 1) ? -4.0 : 3.0, 1.4, c_return[s]);
+        } else {
+            WWBiquadDesign(WWBT_Peaking, 44100, freq * 1.1, (s & 1) ? 2.0 : -3.0, 0.7, c_return[s]);
+        }
+    }
+}
+
+static void
+SetEqStages(WWBiquadCascade &eq, int ch, const std::vector<WWBiquadCoeffs> &c)
+{
+    for (int s=0; s<(int)c.size(); ++s) {
+        for (int i=0; i<ch; ++i) {
+            eq.SetCoeffs(s, i, c[s]);
+        }
+    }
+}
+
+/// parametric EQ of the render path. eq/biquadCascadeCrossfade switches the coefficients on every call
+/// and crossfades them over the call, as WasapiIO_UpdateAudioFilter() during playback
+static void
+AddBiquadCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const int channels[] = { 2, 8 };
+    static const int frames[] = { 256, 1024, 4096 };
+    static const int stagesList[] = { 4, 10, 16 };
+
+    for (int stages : stagesList) {
+        for (int ch : channels) {
+            for (int n : frames) {
+                const Params params = {{"channels", ch}, {"frames", n}, {"stages", stages}};
+
+                Add(cases, "eq/biquadCascade", params, (int64_t)ch * n, [ch, n, stages]() {
+                    auto eq = std::make_shared<WWBiquadCascade>();
+                    auto in = std::make_shared<std::vector<float> >();
+                    auto io = std::make_shared<std::vector<float> >((size_t)ch * n);
+                    std::vector<WWBiquadCoeffs> c;
+                    eq->Init(ch, stages);
+                    EqStages(stages, 0, c);
+                    SetEqStages(*eq, ch, c);
+                    eq->Commit(0);
+                    Noise((size_t)ch * n, *in);
+
+                    // processed in place: the input is restored on each call
+                    return [eq, in, io, n]() {
+                        std::copy(in->begin(), in->end(), io->begin());
+                        eq->Process(io->data(), n);
+                    };
+                });
+
+                Add(cases, "eq/biquadCascadeCrossfade", params, (int64_t)ch * n, [ch, n, stages]() {
+                    auto eq = std::make_shared<WWBiquadCascade>();
+                    auto in = std::make_shared<std::vector<float> >();
+                    auto io = std::make_shared<std::vector<float> >((size_t)ch * n);
+                    auto c = std::make_shared<std::vector<std::vector<WWBiquadCoeffs> > >(2);
+                    auto calls = std::make_shared<int>(0);
+                    eq->Init(ch, stages);
+                    EqStages(stages, 0, (*c)[0]);
+                    EqStages(stages, 1, (*c)[1]);
+                    SetEqStages(*eq, ch, (*c)[0]);
+                    eq->Commit(0);
+                    Noise((size_t)ch * n, *in);
+
+                    return [eq, in, io, c, calls, ch, n]() {
+                        SetEqStages(*eq, ch, (*c)[++*calls & 1]);
+                        eq->Commit(n);
+                        std::copy(in->begin(), in->end(), io->begin());
+                        eq->Process(io->data(), n);
+                    };
+                });
+            }
+        }
+    }
+}
+
+static void
+AddDsdCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const int channels[] = { 2, 6 };
+    const int dsfBlockBytes = 4096;
+
+    for (int ch : channels) {
+        // a DSF block of 4096 bytes per channel is 2048 DoP frames
+        for (int t=0; t<2; ++t) {
+            const WWBitsPerSampleType bps = (0 == t) ? WWBps24 : WWBps32v24;
+            Add(cases, "dop/dsfBlockToDop", {{"channels", ch}, {"frames", dsfBlockBytes / 2},
+                        {"bytesPerSample", WWDopBytesPerSample(bps)}},
+                    (int64_t)ch * dsfBlockBytes * 8, [ch, bps, dsfBlockBytes]() {
+                auto block = std::make_shared<std::vector<unsigned char> >();
+                auto out = std::make_shared<std::vector<unsigned char> >(
+                        (size_t)dsfBlockBytes / 2 * ch * WWDopBytesPerSample(bps));
+                NoiseBytes((size_t)dsfBlockBytes * ch, *block);
+                return [block, out, ch, bps, dsfBlockBytes]() {
+                    WWDsfBlockToDop(block->data(), dsfBlockBytes, ch, 0, dsfBlockBytes / 2, bps, out->data());
+                };
+            });
+        }
+
+        Add(cases, "dsd/dsfBlockToNative", {{"channels", ch}, {"frames", dsfBlockBytes / 2}},
+                (int64_t)ch * dsfBlockBytes * 8, [ch, dsfBlockBytes]() {
+            auto block = std::make_shared<std::vector<unsigned char> >();
+            auto out = std::make_shared<std::vector<unsigned char> >((size_t)dsfBlockBytes * ch);
+            NoiseBytes((size_t)dsfBlockBytes * ch, *block);
+            return [block, out, ch, dsfBlockBytes]() {
+                WWDsfBlockToNative(block->data(), dsfBlockBytes, ch, 0, dsfBlockBytes / 2, out->data());
+            };
+        });
+
+        Add(cases, "dop/dsdiffToDop", {{"channels", ch}, {"frames", dsfBlockBytes / 2}},
+                (int64_t)ch * dsfBlockBytes * 8, [ch, dsfBlockBytes]() {
+            auto in = std::make_shared<std::vector<unsigned char> >();
+            auto out = std::make_shared<std::vector<unsigned char> >((size_t)dsfBlockBytes / 2 * ch * 3);
+            NoiseBytes((size_t)dsfBlockBytes * ch, *in);
+            return [in, out, ch, dsfBlockBytes]() {
+                WWDsdiffToDop(in->data(), ch, 0, dsfBlockBytes / 2, WWBps24, out->data());
+            };
+        });
+    }
+
+    // DSD to PCM. 8 (DSD64 to 352.8kHz), 32 (DSD64 to 88.2kHz) and 64 (DSD64 to 44.1kHz)
+    static const int decimations[] = { 8, 32, 64 };
+    static const int dsdBytes[] = { 512, 4096 };
+    for (int d : decimations) {
+        for (int bytes : dsdBytes) {
+            const int ch = 2;
+            Add(cases, "dsd/decimator", {{"channels", ch}, {"frames", bytes * 8}, {"decimation", d}},
+                    (int64_t)ch * bytes * 8, [ch, bytes, d]() {
+                auto dec = std::make_shared<WWDsdDecimator>();
+                auto in = std::make_shared<std::vector<unsigned char> >();
+                auto out = std::make_shared<std::vector<float> >();
+                if (dec->Init(d, ch) < 0) {
+                    return std::function<void(void)>();
+                }
+                out->resize((size_t)dec->MaxOutputFrames(bytes) * ch);
+                NoiseBytes((size_t)bytes * ch, *in);
+                return std::function<void(void)>([dec, in, out, bytes]() { dec->Process(in->data(), bytes, out->data()); });
+            });
+        }
+    }
+
+    // PCM to DSD64
+    static const int orders[] = { 5, 7 };
+    static const int pcmFrames[] = { 256, 1024 };
+    for (int order : orders) {
+        for (int n : pcmFrames) {
+            const int ch = 2;
+            Add(cases, "dsd/modulator", {{"channels", ch}, {"frames", n}, {"order", order}, {"sampleRate", 44100}},
+                    (int64_t)ch * n, [ch, n, order]() {
+                auto mod = std::make_shared<WWDsdModulator>();
+                auto in = std::make_shared<std::vector<float> >();
+                auto out = std::make_shared<std::vector<unsigned char> >();
+                if (mod->Init(order, 44100, 2822400, ch) < 0) {
+                    return std::function<void(void)>();
+                }
+                out->resize((size_t)n * mod->Upsample() / 8 * ch);
+                Noise((size_t)ch * n, *in);
+                return std::function<void(void)>([mod, in, out, n]() { mod->Process(in->data(), n, out->data()); });
+            });
+        }
+    }
+}
+
+static void
+AddConvolutionCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const int blocks[] = { 256, 1024, 4096 };
+    const int ch = 2;
+
+    for (int block : blocks) {
+        const int taps = 4096;
+        Add(cases, "conv/partitioned", {{"channels", ch}, {"frames", block}, {"taps", taps}}, (int64_t)ch * block,
+                [ch, block, taps]() {
+            auto conv = std::make_shared<WWPartitionedConvolver>();
+            auto in = std::make_shared<std::vector<float> >();
+            auto out = std::make_shared<std::vector<float> >((size_t)ch * block);
+            if (conv->Init(ch, ch, block, taps, nullptr, true) < 0) {
+                return std::function<void(void)>();
+            }
+            std::vector<float> h;
+            ImpulseResponse(taps, h);
+            for (int i=0; i<ch; ++i) {
+                conv->SetFilter(i, i, h.data(), taps);
+            }
+            Noise((size_t)ch * block, *in);
+            return std::function<void(void)>([conv, in, out, block]() { conv->Process(in->data(), block, out->data()); });
+        });
+    }
+
+    // room impulse responses of 1.5s and 6s at 44.1kHz
+    static const int longTaps[] = { 65536, 262144 };
+    static const int firstBlocks[] = { 256, 1024 };
+    for (int taps : longTaps) {
+        for (int block : firstBlocks) {
+            Add(cases, "conv/nonUniform", {{"channels", ch}, {"frames", block}, {"taps", taps}}, (int64_t)ch * block,
+                    [ch, block, taps]() {
+                auto conv = std::make_shared<WWNonUniformConvolver>();
+                auto in = std::make_shared<std::vector<float> >();
+                auto out = std::make_shared<std::vector<float> >((size_t)ch * block);
+                if (conv->Init(ch, ch, block, WW_CROSSFEED_MAX_BLOCK_FRAMES, taps, nullptr, true) < 0) {
+                    return std::function<void(void)>();
+                }
+                std::vector<float> h;
+                ImpulseResponse(taps, h);
+                for (int i=0; i<ch; ++i) {
+                    conv->SetFilter(i, i, h.data(), taps);
+                }
+                Noise((size_t)ch * block, *in);
+                return std::function<void(void)>([conv, in, out, block]() { conv->Process(in->data(), block, out->data()); });
+            });
+        }
+    }
+
+    // 2x2 crossfeed of the real-time and the batch block sizes
+    static const int crossfeedBlocks[] = { WW_CROSSFEED_REALTIME_BLOCK_FRAMES, 4096 };
+    for (int block : crossfeedBlocks) {
+        const int taps = 8192;
+        Add(cases, "conv/crossfeed", {{"channels", 2}, {"frames", block}, {"taps", taps}}, 2LL * block, [block, taps]() {
+            auto cf = std::make_shared<WWCrossfeed>();
+            auto in = std::make_shared<std::vector<float> >();
+            auto out = std::make_shared<std::vector<float> >((size_t)2 * block);
+            WWCrossfeedCoeffs c;
+            c.sampleRate = 44100;
+            c.numTaps = taps;
+            for (int i=0; i<WW_CROSSFEED_COEFF_NUM; ++i) {
+                ImpulseResponse(taps, c.coeffs[i]);
+            }
+            if (cf->Init(c, block) < 0) {
+                return std::function<void(void)>();
+            }
+            Noise((size_t)2 * block, *in);
+            return std::function<void(void)>([cf, in, out, block]() { cf->Process(in->data(), block, out->data()); });
+        });
+    }
+}
+
+/// filters of WWAudioFilter, including the resamplers. one channel of NumOfSamplesNeeded() samples per call
+static void
+AddAudioFilterCases(std::vector<WWKernelBenchCase> &cases)
+{
+    static const char *lines[] = {
+        "Gain 0.5",
+        "ZohUpsampler 2",
+        "InsertZeroesUpsampler 2",
+        "FftUpsampler 2 65536",
+        "FftUpsampler 8 262144",
+        "Downsampler 2 0",
+        "HalfbandFilter 127",
+        "LowPassFilter 20000 255 20",
+        "CicFilter 0 8",
+        "NoiseShaping 16 2",
+        "NoiseShaping4th 16",
+        "Mash2 1",
+    };
+
+    for (const char *line : lines) {
+        // the block size is known after Setup(). the name and the params are fixed here
+        std::string name("audioFilter/");
+        name += std::string(line, strcspn(line, " "));
+        std::unique_ptr<WWAFFilterBase> probe(WWAFCreateFilter(line));
+        if (!probe) {
+            continue;
+        }
+        WWAFPcmFormat fmt;
+        fmt.numChannels = 1;
+        fmt.sampleRate = 44100;
+        fmt.numSamples = 1LL << 32;
+        if (probe->Setup(fmt) < 0) {
+            continue;
+        }
+        probe->FilterStart();
+        {
+            std::vector<double> in((size_t)probe->NumOfSamplesNeeded()), out;
+            probe->FilterDo(in, out);
+        }
+        const int64_t n = probe->NumOfSamplesNeeded();
+        probe.reset();
+
+        std::string arg(line);
+        Add(cases, name.c_str(), {{"channels", 1}, {"frames", n}}, n, [arg, n]() {
+            std::shared_ptr<WWAFFilterBase> f(WWAFCreateFilter(arg));
+            auto in = std::make_shared<std::vector<double> >((size_t)n);
+            auto out = std::make_shared<std::vector<double> >();
+            WWAFPcmFormat fmt;
+            fmt.numChannels = 1;
+            fmt.sampleRate = 44100;
+            fmt.numSamples = 1LL << 32;
+            if (!f || f->Setup(fmt) < 0) {
+                return std::function<void(void)>();
+            }
+            f->FilterStart();
+
+            // the first block of some filters is of a different size
+            std::vector<double> first((size_t)f->NumOfSamplesNeeded());
+            f->FilterDo(first, *out);
+
+            std::vector<float> noise;
+            Noise((size_t)n, noise);
+            std::copy(noise.begin(), noise.end(), in->begin());
+            return std::function<void(void)>([f, in, out]() { f->FilterDo(*in, *out); });
+        });
+    }
+}
+
+static void
+PrintUsage(const char *programName)
+{
+    printf("Usage:\n"
+        " %s [-cpu n] [-repeat n] [-warmup n] [-minsample seconds] [-label text] [-match text]... [-list] [-o file.json]\n"
+        "     measures the sample processing kernels at several block sizes and channel counts and writes JSON\n"
+        " -cpu n : pins the benchmark to the cpu n\n"
+        " -repeat n : measured samples of each case. default is 21\n"
+        " -warmup n : samples discarded before the measured samples. default is 2\n"
+        " -minsample seconds : a sample takes at least this long. default is 0.01\n"
+        " -label text : written to the JSON, such as the commit id\n"
+        " -match text : runs the cases whose name contains the text. can be given more than once\n"
+        " -list : prints the names and the params of the cases\n"
+        " -o file.json : writes the JSON to the file instead of stdout\n",
+        programName);
+}
+
+static bool
+IsMatched(const std::string &name, const std::vector<std::string> &patterns)
+{
+    if (patterns.empty()) {
+        return true;
+    }
+    for (size_t i=0; i<patterns.size(); ++i) {
+        if (std::string::npos != name.find(patterns[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+    WWKernelBenchReport report;
+    std::vector<std::string> patterns;
+    const char *outPath = nullptr;
+    bool list = false;
+
+    for (int i=1; i<argc; ++i) {
+        const bool hasArg = i + 1 < argc;
+        if (0 == strcmp(argv[i], "-list")) {
+            list = true;
+        } else if (hasArg && 0 == strcmp(argv[i], "-cpu")) {
+            report.pinnedCpu = atoi(argv[++i]);
+        } else if (hasArg && 0 == strcmp(argv[i], "-repeat")) {
+            report.params.repeat = atoi(argv[++i]);
+        } else if (hasArg && 0 == strcmp(argv[i], "-warmup")) {
+            report.params.warmUp = atoi(argv[++i]);
+        } else if (hasArg && 0 == strcmp(argv[i], "-minsample")) {
+            report.params.minSampleSeconds = atof(argv[++i]);
+        } else if (hasArg && 0 == strcmp(argv[i], "-label")) {
+            report.label = argv[++i];
+        } else if (hasArg && 0 == strcmp(argv[i], "-match")) {
+            patterns.push_back(argv[++i]);
+        } else if (hasArg && 0 == strcmp(argv[i], "-o")) {
+            outPath = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (report.params.repeat < 1 || report.params.warmUp < 0 || report.params.minSampleSeconds <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<WWKernelBenchCase> cases;
+    AddFftCases(cases);
+    AddQuantizerCases(cases);
+    AddNoiseCases(cases);
+    AddBiquadCases(cases);
+    AddDsdCases(cases);
+    AddConvolutionCases(cases);
+    AddAudioFilterCases(cases);
+    WWKernelBenchAddTapCases(cases);
+
+    if (list) {
+        for (size_t i=0; i<cases.size(); ++i) {
+            printf("%s", cases[i].name.c_str());
+            for (size_t j=0; j<cases[i].params.size(); ++j) {
+                printf(" %s=%lld", cases[i].params[j].first.c_str(), (long long)cases[i].params[j].second);
+            }
+            printf("\n");
+        }
+        return 0;
+    }
+
+    if (0 <= report.pinnedCpu && WWKernelBenchPinCpu(report.pinnedCpu) < 0) {
+        fprintf(stderr, "Error: could not pin to cpu %d\n", report.pinnedCpu);
+        return 1;
+    }
+
+    int result = 0;
+    for (size_t i=0; i<cases.size(); ++i) {
+        if (!IsMatched(cases[i].name, patterns)) {
+            continue;
+        }
+
+        WWKernelBenchResult r;
+        if (WWKernelBenchMeasure(cases[i], report.params, r) < 0) {
+            fprintf(stderr, "Error: could not set up %s\n", cases[i].name.c_str());
+            result = 1;
+            continue;
+        }
+        std::string params;
+        for (size_t j=0; j<cases[i].params.size(); ++j) {
+            params += " " + cases[i].params[j].first + "=" + std::to_string((long long)cases[i].params[j].second);
+        }
+        fprintf(stderr, "%s%s: %.1f ns/call (MAD %.1f%%) %.2f Msamples/s\n", cases[i].name.c_str(), params.c_str(),
+            r.medianNs, 100.0 * r.madNs / r.medianNs, r.samplesPerSecond * 1.0e-6);
+        report.results.push_back(r);
+    }
+
+    FILE *fp = stdout;
+    if (outPath) {
+        fp = fopen(outPath, "wb");
+        if (nullptr == fp) {
+            fprintf(stderr, "Error: could not open %s\n", outPath);
+            return 1;
+        }
+    }
+    WWKernelBenchWriteJson(fp, report);
+    if (outPath) {
+        fclose(fp);
+    }
+
+    return result;
+}
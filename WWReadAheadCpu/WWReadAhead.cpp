@@ -0,0 +1,670 @@
+#include "WWReadAhead.h"
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#  if defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#      include <linux/io_uring.h>
+#    endif
+#  endif
+// IORING_OP_READ is of Linux 5.6, the same as IORING_FEAT_CUR_PERSONALITY
+#  if defined(IORING_FEAT_CUR_PERSONALITY) && defined(__NR_io_uring_setup)
+#    define WW_READ_AHEAD_USE_IO_URING
+#  endif
+#endif
+
+/// the ioprio of Linux of the idle class. the same as IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+#define WW_IOPRIO_IDLE (3 << 13)
+#define WW_IOPRIO_WHO_PROCESS (1)
+
+/// the file is mapped by this size to check the residency, so the 32bit process can check a large file
+#define RESIDENCY_WINDOW_BYTES (256 * 1024 * 1024)
+
+namespace {
+
+/// a file of the worker and OnOpen(). Windows and POSIX
+class RaFile {
+public:
+    RaFile(void) : m_bytes(0)
+#ifdef _WIN32
+            , m_h(INVALID_HANDLE_VALUE)
+#else
+            , m_fd(-1)
+#endif
+    { }
+
+    ~RaFile(void) { Close(); }
+
+    /// @return 0: success. negative: could not open the file
+    int Open(const std::string &path);
+    void Close(void);
+
+    int64_t Bytes(void) const { return m_bytes; }
+
+#ifndef _WIN32
+    int Fd(void) const { return m_fd; }
+#endif
+
+    /// the chunks of [0, bytes) that are in the page cache entirely
+    /// @return false: the residency is not known. the chunks are not resident
+    bool Residency(int64_t bytes, int chunkBytes, std::vector<char> &resident_return, int64_t &residentBytes_return);
+
+    /// @return true: the kernel is asked to read the range
+    bool Advise(int64_t offset, int64_t bytes, WWReadAheadMethod method);
+
+    /// @return the bytes read. negative: error
+    int64_t Read(int64_t offset, void *buf, int bytes);
+
+private:
+    int64_t m_bytes;
+
+#ifdef _WIN32
+    HANDLE m_h;
+#else
+    int m_fd;
+#endif
+};
+
+#ifdef _WIN32
+
+int
+RaFile::Open(const std::string &path)
+{
+    Close();
+
+    const int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (n <= 0) {
+        return -1;
+    }
+    std::vector<wchar_t> wpath(n);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], n);
+
+    m_h = CreateFileW(&wpath[0], GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (INVALID_HANDLE_VALUE == m_h || !GetFileSizeEx(m_h, &size)) {
+        Close();
+        return -1;
+    }
+    m_bytes = size.QuadPart;
+    return 0;
+}
+
+void
+RaFile::Close(void)
+{
+    if (INVALID_HANDLE_VALUE != m_h) {
+        CloseHandle(m_h);
+        m_h = INVALID_HANDLE_VALUE;
+    }
+    m_bytes = 0;
+}
+
+int64_t
+RaFile::Read(int64_t offset, void *buf, int bytes)
+{
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof ov);
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD readBytes = 0;
+    if (!ReadFile(m_h, buf, (DWORD)bytes, &readBytes, &ov)) {
+        return -1;
+    }
+    return readBytes;
+}
+
+#else
+
+int
+RaFile::Open(const std::string &path)
+{
+    Close();
+
+    m_fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (m_fd < 0 || 0 != fstat(m_fd, &st) || !S_ISREG(st.st_mode)) {
+        Close();
+        return -1;
+    }
+    m_bytes = st.st_size;
+    return 0;
+}
+
+void
+RaFile::Close(void)
+{
+    if (0 <= m_fd) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_bytes = 0;
+}
+
+int64_t
+RaFile::Read(int64_t offset, void *buf, int bytes)
+{
+    return pread(m_fd, buf, (size_t)bytes, (off_t)offset);
+}
+
+#endif
+
+bool
+RaFile::Residency(int64_t bytes, int chunkBytes, std::vector<char> &resident_return, int64_t &residentBytes_return)
+{
+    const size_t numChunks = (size_t)((bytes + chunkBytes - 1) / chunkBytes);
+    resident_return.assign(numChunks, 0);
+    residentBytes_return = 0;
+
+#ifdef __linux__
+    const int64_t page = sysconf(_SC_PAGESIZE);
+    resident_return.assign(numChunks, 1);
+
+    std::vector<unsigned char> pages;
+    for (int64_t from = 0; from < bytes; from += RESIDENCY_WINDOW_BYTES) {
+        const size_t n = (size_t)std::min<int64_t>(RESIDENCY_WINDOW_BYTES, bytes - from);
+        void *p = mmap(nullptr, n, PROT_READ, MAP_SHARED, m_fd, (off_t)from);
+        int rv = -1;
+        if (MAP_FAILED != p) {
+            pages.resize((n + page - 1) / page);
+            rv = mincore(p, n, &pages[0]);
+            munmap(p, n);
+        }
+        if (0 != rv) {
+            resident_return.assign(numChunks, 0);
+            residentBytes_return = 0;
+            return false;
+        }
+
+        // a chunk is resident when all of the pages of it are
+        for (size_t i=0; i<pages.size(); ++i) {
+            const int64_t pos = from + (int64_t)i * page;
+            const int64_t pageBytes = std::min(page, bytes - pos);
+            if (pages[i] & 1) {
+                residentBytes_return += pageBytes;
+                continue;
+            }
+            for (int64_t c = pos / chunkBytes; c <= (pos + pageBytes - 1) / chunkBytes; ++c) {
+                resident_return[(size_t)c] = 0;
+            }
+        }
+    }
+    return true;
+#else
+    (void)chunkBytes;
+    return false;
+#endif
+}
+
+bool
+RaFile::Advise(int64_t offset, int64_t bytes, WWReadAheadMethod method)
+{
+#ifdef __linux__
+    if (WWRAM_Readahead == method) {
+        return 0 == readahead(m_fd, (off64_t)offset, (size_t)bytes);
+    }
+#endif
+#ifdef POSIX_FADV_WILLNEED
+    (void)method;
+    return 0 == posix_fadvise(m_fd, (off_t)offset, (off_t)bytes, POSIX_FADV_WILLNEED);
+#else
+    (void)offset;
+    (void)bytes;
+    (void)method;
+    return false;
+#endif
+}
+
+void
+SetLowIoPriority(void)
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__) && defined(SYS_ioprio_set)
+    // who 0 is the calling thread
+    syscall(SYS_ioprio_set, WW_IOPRIO_WHO_PROCESS, 0, WW_IOPRIO_IDLE);
+#endif
+}
+
+} // namespace
+
+/// io_uring of the system calls, as liburing is not always installed
+struct WWReadAhead::Uring {
+#ifdef WW_READ_AHEAD_USE_IO_URING
+    int fd;
+
+    void *sqRing;
+    size_t sqRingBytes;
+    void *cqRing;
+    size_t cqRingBytes;
+    struct io_uring_sqe *sqes;
+    size_t sqesBytes;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    /// the sqes queued and not submitted yet
+    unsigned toSubmit;
+
+    Uring(void) : fd(-1), sqRing(MAP_FAILED), sqRingBytes(0), cqRing(MAP_FAILED), cqRingBytes(0),
+            sqes((struct io_uring_sqe *)MAP_FAILED), sqesBytes(0), toSubmit(0) { }
+
+    ~Uring(void) {
+        if (MAP_FAILED != (void *)sqes) {
+            munmap(sqes, sqesBytes);
+        }
+        if (MAP_FAILED != cqRing && cqRing != sqRing) {
+            munmap(cqRing, cqRingBytes);
+        }
+        if (MAP_FAILED != sqRing) {
+            munmap(sqRing, sqRingBytes);
+        }
+        if (0 <= fd) {
+            close(fd);
+        }
+    }
+
+    /// @return 0: success. negative: io_uring or IORING_OP_READ is not available
+    int Init(unsigned entries) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof p);
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0 || 0 == (p.features & IORING_FEAT_CUR_PERSONALITY)) {
+            return -1;
+        }
+
+        sqRingBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingBytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+        }
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (MAP_FAILED == sqRing) {
+            return -1;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_CQ_RING);
+            if (MAP_FAILED == cqRing) {
+                return -1;
+            }
+        }
+        sqesBytes = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (struct io_uring_sqe *)mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, IORING_OFF_SQES);
+        if (MAP_FAILED == (void *)sqes) {
+            return -1;
+        }
+
+        unsigned char *sq = (unsigned char *)sqRing;
+        unsigned char *cq = (unsigned char *)cqRing;
+        sqHead = (unsigned *)(sq + p.sq_off.head);
+        sqTail = (unsigned *)(sq + p.sq_off.tail);
+        sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+        sqArray = (unsigned *)(sq + p.sq_off.array);
+        cqHead = (unsigned *)(cq + p.cq_off.head);
+        cqTail = (unsigned *)(cq + p.cq_off.tail);
+        cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+        return 0;
+    }
+
+    /// queues a read. the number of the reads in flight is not more than the entries
+    void PrepRead(int fileFd, void *buf, unsigned bytes, int64_t offset, uint64_t userData, bool lowPriority) {
+        const unsigned tail = *sqTail;
+        const unsigned idx = tail & *sqMask;
+        struct io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof *sqe);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fileFd;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = bytes;
+        sqe->off = (uint64_t)offset;
+        sqe->user_data = userData;
+        sqe->ioprio = lowPriority ? WW_IOPRIO_IDLE : 0;
+        sqArray[idx] = idx;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++toSubmit;
+    }
+
+    /// submits the queued reads and waits for a completion
+    /// @return 0: success. negative: error
+    int SubmitAndWait(void) {
+        for (;;) {
+            const int rv = (int)syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (0 <= rv) {
+                toSubmit -= (unsigned)rv;
+                return 0;
+            }
+            if (EINTR != errno) {
+                return -1;
+            }
+        }
+    }
+
+    /// @return false: no completion
+    bool Reap(uint64_t &userData_return, int &res_return) {
+        const unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const struct io_uring_cqe &cqe = cqes[head & *cqMask];
+        userData_return = cqe.user_data;
+        res_return = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+#else
+    int Init(unsigned entries) { (void)entries; return -1; }
+#endif
+};
+
+WWReadAhead::WWReadAhead(void)
+    : m_quit(true), m_busy(false), m_next(0), m_budgetLeft(0), m_generation(0), m_uring(nullptr)
+{
+}
+
+WWReadAhead::~WWReadAhead(void)
+{
+    Stop();
+}
+
+int
+WWReadAhead::Start(const WWReadAheadParams &p)
+{
+    if (m_thread.joinable() || p.method < 0 || WWRAM_NUM <= p.method || p.budgetBytes < 0
+            || p.chunkBytes < 4096 || 0 != p.chunkBytes % 4096 || p.queueDepth < 1 || 256 < p.queueDepth) {
+        return -1;
+    }
+
+    m_params = p;
+    m_stats = WWReadAheadStats();
+
+#ifdef _WIN32
+    if (WWRAM_Readahead == m_params.method || WWRAM_Advise == m_params.method) {
+        m_params.method = WWRAM_Read;
+    }
+#elif !defined(__linux__)
+    if (WWRAM_Readahead == m_params.method) {
+        m_params.method = WWRAM_Advise;
+    }
+#endif
+#ifndef POSIX_FADV_WILLNEED
+    if (WWRAM_Advise == m_params.method) {
+        m_params.method = WWRAM_Read;
+    }
+#endif
+
+    if (WWRAM_Uring == m_params.method) {
+        m_uring = new Uring();
+        if (m_uring->Init((unsigned)m_params.queueDepth) < 0) {
+            delete m_uring;
+            m_uring = nullptr;
+            m_params.method = WWRAM_Read;
+            m_stats.uringFallback = true;
+        }
+    }
+
+    switch (m_params.method) {
+    case WWRAM_Read:
+        m_buffer.resize(m_params.chunkBytes);
+        break;
+    case WWRAM_Uring:
+        m_buffer.resize((size_t)m_params.chunkBytes * m_params.queueDepth);
+        break;
+    default:
+        break;
+    }
+
+    m_playlist.clear();
+    m_next = 0;
+    m_budgetLeft = 0;
+    m_quit = false;
+    m_busy = false;
+    m_thread = std::thread(&WWReadAhead::ThreadMain, this);
+    return 0;
+}
+
+void
+WWReadAhead::Stop(void)
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        ++m_generation;
+    }
+    m_cv.notify_all();
+    m_idleCv.notify_all();
+    m_thread.join();
+
+    delete m_uring;
+    m_uring = nullptr;
+    m_buffer.clear();
+}
+
+void
+WWReadAhead::SetPlaylist(const std::vector<std::string> &paths)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_playlist = paths;
+        m_next = 0;
+        m_budgetLeft = m_params.budgetBytes;
+        ++m_generation;
+    }
+    m_cv.notify_all();
+}
+
+void
+WWReadAhead::OnOpen(const std::string &path)
+{
+    RaFile f;
+    if (f.Open(path) < 0) {
+        return;
+    }
+
+    std::vector<char> resident;
+    int64_t residentBytes = 0;
+    const bool known = f.Residency(f.Bytes(), m_params.chunkBytes, resident, residentBytes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.opens;
+    if (known) {
+        m_stats.openBytes += f.Bytes();
+        m_stats.openHitBytes += residentBytes;
+        if (residentBytes == f.Bytes()) {
+            ++m_stats.openHits;
+        }
+    }
+}
+
+void
+WWReadAhead::WaitIdle(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCv.wait(lock, [this] {
+        return m_quit || (!m_busy && (m_playlist.size() <= m_next || m_budgetLeft <= 0)); });
+}
+
+WWReadAheadStats
+WWReadAhead::Stats(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+WWReadAheadMethod
+WWReadAhead::Method(void) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_params.method;
+}
+
+void
+WWReadAhead::ThreadMain(void)
+{
+    if (m_params.lowPriority) {
+        SetLowIoPriority();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_quit || (m_next < m_playlist.size() && 0 < m_budgetLeft); });
+        if (m_quit) {
+            break;
+        }
+
+        const std::string path = m_playlist[m_next++];
+        const int64_t generation = m_generation;
+        m_busy = true;
+        lock.unlock();
+
+        WarmFile(path, generation);
+
+        lock.lock();
+        m_busy = false;
+        m_idleCv.notify_all();
+    }
+}
+
+void
+WWReadAhead::WarmFile(const std::string &path, int64_t generation)
+{
+    RaFile f;
+    const int rv = f.Open(path);
+
+    int64_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (generation != m_generation) {
+            return;
+        }
+        if (rv < 0) {
+            ++m_stats.errors;
+            return;
+        }
+        bytes = std::min(f.Bytes(), m_budgetLeft);
+        m_budgetLeft -= bytes;
+    }
+
+    const int chunkBytes = m_params.chunkBytes;
+    std::vector<char> resident;
+    int64_t residentBytes = 0;
+    f.Residency(bytes, chunkBytes, resident, residentBytes);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.checkedFiles;
+        m_stats.checkedBytes += bytes;
+        if (residentBytes < bytes) {
+            ++m_stats.coldFiles;
+            m_stats.coldBytes += bytes - residentBytes;
+        }
+    }
+
+#ifdef WW_READ_AHEAD_USE_IO_URING
+    if (WWRAM_Uring == m_params.method) {
+        // the buffer of the slot i is m_buffer[i * chunkBytes]. the reads of the older playlist are drained
+        std::vector<int> freeSlots;
+        for (int i=m_params.queueDepth - 1; 0 <= i; --i) {
+            freeSlots.push_back(i);
+        }
+        size_t c = 0;
+        for (;;) {
+            while (!freeSlots.empty() && c < resident.size() && generation == m_generation) {
+                if (resident[c]) {
+                    ++c;
+                    continue;
+                }
+                const int64_t offset = (int64_t)c * chunkBytes;
+                const int slot = freeSlots.back();
+                freeSlots.pop_back();
+                m_uring->PrepRead(f.Fd(), &m_buffer[(size_t)slot * chunkBytes],
+                        (unsigned)std::min<int64_t>(chunkBytes, bytes - offset), offset, (uint64_t)slot,
+                        m_params.lowPriority);
+                ++c;
+            }
+            if ((int)freeSlots.size() == m_params.queueDepth) {
+                break;
+            }
+
+            if (m_uring->SubmitAndWait() < 0) {
+                // the next files are read by WWRAM_Read, of the slot 0
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_params.method = WWRAM_Read;
+                m_stats.uringFallback = true;
+                return;
+            }
+
+            uint64_t slot = 0;
+            int res = 0;
+            int64_t warmed = 0;
+            while (m_uring->Reap(slot, res)) {
+                freeSlots.push_back((int)slot);
+                if (0 < res) {
+                    warmed += res;
+                }
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.warmedBytes += warmed;
+        }
+        return;
+    }
+#endif
+
+    for (size_t c=0; c<resident.size() && generation == m_generation; ++c) {
+        if (resident[c]) {
+            continue;
+        }
+        const int64_t offset = (int64_t)c * chunkBytes;
+        const int n = (int)std::min<int64_t>(chunkBytes, bytes - offset);
+
+        int64_t warmed = 0;
+        if (WWRAM_Read == m_params.method) {
+            warmed = f.Read(offset, &m_buffer[0], n);
+        } else if (f.Advise(offset, n, m_params.method)) {
+            warmed = n;
+        }
+        if (0 < warmed) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.warmedBytes += warmed;
+        }
+    }
+}
+
+const char *
+WWReadAheadMethodToStr(WWReadAheadMethod t)
+{
+    switch (t) {
+    case WWRAM_Advise: return "advise";
+    case WWRAM_Readahead: return "readahead";
+    case WWRAM_Read: return "read";
+    case WWRAM_Uring: return "uring";
+    default: return "unknown";
+    }
+}
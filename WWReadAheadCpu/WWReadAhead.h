@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// how the chunks of the files are brought to the page cache
+enum WWReadAheadMethod {
+    /// POSIX: posix_fadvise(POSIX_FADV_WILLNEED), the kernel reads in the background. Windows: WWRAM_Read
+    WWRAM_Advise,
+
+    /// Linux: readahead(), the worker waits until the reads are queued to the device. other: WWRAM_Advise
+    WWRAM_Readahead,
+
+    /// reads the chunks to a buffer. Windows: ReadFile() of FILE_FLAG_SEQUENTIAL_SCAN
+    WWRAM_Read,
+
+    /// Linux: queueDepth reads of the chunks are in flight on io_uring. WWRAM_Read when io_uring is not available
+    WWRAM_Uring,
+
+    WWRAM_NUM
+};
+
+struct WWReadAheadParams {
+    WWReadAheadMethod method;
+
+    /// the bytes of the files from the head of the playlist that are kept in the page cache.
+    /// the last file within the budget is warmed partly, from its start
+    int64_t budgetBytes;
+
+    /// the unit of the residency check and the reads
+    int chunkBytes;
+
+    /// WWRAM_Uring: the reads in flight
+    int queueDepth;
+
+    /// the worker thread is of the idle I/O priority, so it does not delay the reads of the decoder.
+    /// Linux: IOPRIO_CLASS_IDLE. Windows: THREAD_MODE_BACKGROUND_BEGIN
+    bool lowPriority;
+
+    WWReadAheadParams(void) : method(WWRAM_Uring), budgetBytes(1024LL * 1024 * 1024), chunkBytes(1024 * 1024),
+            queueDepth(8), lowPriority(true) { }
+};
+
+struct WWReadAheadStats {
+    /// the files and the bytes within the budget the worker checked. a file is checked again
+    /// when it is in the next playlist
+    int64_t checkedFiles;
+    int64_t checkedBytes;
+
+    /// the files and the bytes of them that were not in the page cache when they were checked.
+    /// Windows: the residency is not known and all of them are cold
+    int64_t coldFiles;
+    int64_t coldBytes;
+
+    /// the bytes advised or read by the worker
+    int64_t warmedBytes;
+
+    /// the files that could not be opened
+    int64_t errors;
+
+    /// OnOpen() calls and the files of them that were in the page cache entirely
+    int64_t opens;
+    int64_t openHits;
+
+    /// the bytes of the files of OnOpen() and the bytes of them that were in the page cache
+    int64_t openBytes;
+    int64_t openHitBytes;
+
+    /// WWRAM_Uring is requested and io_uring is not available
+    bool uringFallback;
+
+    WWReadAheadStats(void) : checkedFiles(0), checkedBytes(0), coldFiles(0), coldBytes(0), warmedBytes(0),
+            errors(0), opens(0), openHits(0), openBytes(0), openHitBytes(0), uringFallback(false) { }
+
+    /// openHitBytes / openBytes. -1: unknown
+    double HitRate(void) const { return (0 < openBytes) ? (double)openHitBytes / openBytes : -1.0; }
+};
+
+/// warms the page cache with the upcoming files of the playlist, in the playback order, on a worker thread.
+///
+///   The worker checks the residency of the chunks of a file (Linux: mincore()) and warms the chunks
+///   that are not in the page cache, so a file that is already there costs no I/O. The files are taken
+///   from the head of the playlist until the budget is used up. SetPlaylist() replaces the playlist and
+///   the worker moves to the new one at the next chunk, so the track change of the player does not wait.
+class WWReadAhead {
+public:
+    WWReadAhead(void);
+    ~WWReadAhead(void);
+
+    /// starts the worker thread
+    /// @return 0: success. negative: bad parameter
+    int Start(const WWReadAheadParams &p);
+
+    /// stops the worker. the reads in flight are waited
+    void Stop(void);
+
+    /// replaces the playlist. paths[0] is the file played next. returns immediately
+    void SetPlaylist(const std::vector<std::string> &paths);
+
+    /// the decoder opened the file. counts the bytes of the file in the page cache to the hit rate.
+    /// opens the file to check the residency and does not read it
+    void OnOpen(const std::string &path);
+
+    /// waits until the worker is done with the playlist
+    void WaitIdle(void);
+
+    WWReadAheadStats Stats(void) const;
+
+    /// the method in use. it is of the fallback when the requested one is not available
+    WWReadAheadMethod Method(void) const;
+
+private:
+    struct Uring;
+
+    WWReadAheadParams m_params;
+    std::thread m_thread;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_idleCv;
+    bool m_quit;
+    bool m_busy;
+
+    std::vector<std::string> m_playlist;
+
+    /// the index of m_playlist the worker takes next
+    size_t m_next;
+
+    int64_t m_budgetLeft;
+
+    /// incremented by SetPlaylist(). the worker stops the file of an older playlist
+    std::atomic<int64_t> m_generation;
+
+    WWReadAheadStats m_stats;
+
+    std::vector<unsigned char> m_buffer;
+    Uring *m_uring;
+
+    void ThreadMain(void);
+    void WarmFile(const std::string &path, int64_t generation);
+};
+
+const char *WWReadAheadMethodToStr(WWReadAheadMethod t);
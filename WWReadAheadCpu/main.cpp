@@ -0,0 +1,232 @@
+// Warms the page cache with the files of the playlist in the playback order by WWReadAhead.
+// Native version of 00Experiments/JustReadAllFiles: the files are read within a byte budget and the hit rate is reported.
+// Portable C++: builds on Windows and Linux.
+
+#include "WWReadAhead.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+static void
+PrintUsage(const char *name)
+{
+    printf("usage: %s [options] playlist.m3u8 | file...\n"
+        "  -method m    advise, readahead, read or uring. default: uring\n"
+        "  -budget MB   the bytes warmed from the head of the playlist. default: 1024\n"
+        "  -chunk KB    default: 1024\n"
+        "  -depth n     uring: the reads in flight. default: 8\n"
+        "  -normal      the normal I/O priority. default: idle\n"
+        "  -drop        POSIX: drops the files from the page cache first, to measure from cold\n"
+        "  -play        reads the files after the warm-up as the decoder and reports the hit rate\n",
+        name);
+}
+
+static bool
+IsPlaylist(const std::string &path)
+{
+    std::string s(path);
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return (5 < s.size() && 0 == s.compare(s.size() - 5, 5, ".m3u8"))
+        || (4 < s.size() && 0 == s.compare(s.size() - 4, 4, ".m3u"));
+}
+
+/// the files of the m3u playlist. the relative paths are of the directory of the playlist
+static bool
+ReadPlaylist(const std::string &path, std::vector<std::string> &paths_inout)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (nullptr == fp) {
+        return false;
+    }
+
+    const size_t slash = path.find_last_of("/\\");
+    const std::string dir = (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+
+    char buf[4096];
+    while (fgets(buf, sizeof buf, fp)) {
+        std::string line(buf);
+        if (0 == line.compare(0, 3, "\xef\xbb\xbf")) {
+            line.erase(0, 3);
+        }
+        while (!line.empty() && ('\n' == line.back() || '\r' == line.back())) {
+            line.pop_back();
+        }
+        if (line.empty() || '#' == line[0]) {
+            continue;
+        }
+        const bool isAbsolute = '/' == line[0] || '\\' == line[0] || (2 <= line.size() && ':' == line[1]);
+        paths_inout.push_back(isAbsolute ? line : dir + line);
+    }
+    fclose(fp);
+    return true;
+}
+
+static void
+DropFromPageCache(const std::string &path)
+{
+#if defined(POSIX_FADV_DONTNEED)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+/// reads the file to the end as the decoder
+/// @return the bytes read. negative: could not open the file
+static int64_t
+ReadToEnd(const std::string &path, std::vector<unsigned char> &buf)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (nullptr == fp) {
+        return -1;
+    }
+    int64_t total = 0;
+    size_t n = 0;
+    while (0 < (n = fread(&buf[0], 1, buf.size(), fp))) {
+        total += n;
+    }
+    fclose(fp);
+    return total;
+}
+
+static double
+Elapsed(std::chrono::steady_clock::time_point from)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char * const methodNames[] = { "advise", "readahead", "read", "uring" };
+
+    WWReadAheadParams p;
+    bool drop = false;
+    bool play = false;
+    std::vector<std::string> paths;
+
+    for (int i=1; i<argc; ++i) {
+        const bool hasArg = i + 1 < argc;
+        bool ok = true;
+        if (0 == strcmp("-method", argv[i]) && hasArg) {
+            ++i;
+            ok = false;
+            for (int m=0; m<WWRAM_NUM; ++m) {
+                if (0 == strcmp(argv[i], methodNames[m])) {
+                    p.method = (WWReadAheadMethod)m;
+                    ok = true;
+                }
+            }
+        } else if (0 == strcmp("-budget", argv[i]) && hasArg) {
+            p.budgetBytes = (int64_t)(atof(argv[++i]) * 1024 * 1024);
+        } else if (0 == strcmp("-chunk", argv[i]) && hasArg) {
+            p.chunkBytes = atoi(argv[++i]) * 1024;
+        } else if (0 == strcmp("-depth", argv[i]) && hasArg) {
+            p.queueDepth = atoi(argv[++i]);
+        } else if (0 == strcmp("-normal", argv[i])) {
+            p.lowPriority = false;
+        } else if (0 == strcmp("-drop", argv[i])) {
+            drop = true;
+        } else if (0 == strcmp("-play", argv[i])) {
+            play = true;
+        } else if ('-' != argv[i][0]) {
+            const std::string path(argv[i]);
+            if (IsPlaylist(path)) {
+                if (!ReadPlaylist(path, paths)) {
+                    printf("Error: could not read %s\n", argv[i]);
+                    return 1;
+                }
+            } else {
+                paths.push_back(path);
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (paths.empty()) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (drop) {
+        for (size_t i=0; i<paths.size(); ++i) {
+            DropFromPageCache(paths[i]);
+        }
+    }
+
+    WWReadAhead ra;
+    if (ra.Start(p) < 0) {
+        printf("Error: bad parameters. the chunk is a multiple of 4KB and the depth is 1 to 256\n");
+        return 1;
+    }
+
+    printf("%d files, method %s%s, budget %.1f MB, chunk %d KB\n", (int)paths.size(),
+        WWReadAheadMethodToStr(ra.Method()), ra.Stats().uringFallback ? " (io_uring is not available)" : "",
+        p.budgetBytes / 1048576.0, p.chunkBytes / 1024);
+    fflush(stdout);
+
+    auto start = std::chrono::steady_clock::now();
+    ra.SetPlaylist(paths);
+    ra.WaitIdle();
+    const double warmSeconds = Elapsed(start);
+
+    WWReadAheadStats s = ra.Stats();
+    printf("warm-up: %.3f seconds. checked %lld files %.1f MB, cold %lld files %.1f MB, warmed %.1f MB",
+        warmSeconds, (long long)s.checkedFiles, s.checkedBytes / 1048576.0, (long long)s.coldFiles,
+        s.coldBytes / 1048576.0, s.warmedBytes / 1048576.0);
+    if (0 < s.errors) {
+        printf(", %lld files could not be opened", (long long)s.errors);
+    }
+    printf("\n");
+
+    if (play) {
+        std::vector<unsigned char> buf(256 * 1024);
+        int64_t totalBytes = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i=0; i<paths.size(); ++i) {
+            const auto fileStart = std::chrono::steady_clock::now();
+            ra.OnOpen(paths[i]);
+            const int64_t bytes = ReadToEnd(paths[i], buf);
+            const double seconds = Elapsed(fileStart);
+            if (bytes < 0) {
+                printf("  %s: could not be opened\n", paths[i].c_str());
+                continue;
+            }
+            totalBytes += bytes;
+            printf("  %8.3f ms %8.1f MB/s  %s\n", seconds * 1000.0, (0 < seconds) ? bytes / seconds / 1.0e6 : 0.0,
+                paths[i].c_str());
+        }
+        const double playSeconds = Elapsed(start);
+
+        s = ra.Stats();
+        printf("play: %.1f MB in %.3f seconds, %.1f MB/s. %lld of %lld files were in the page cache",
+            totalBytes / 1048576.0, playSeconds, (0 < playSeconds) ? totalBytes / playSeconds / 1.0e6 : 0.0,
+            (long long)s.openHits, (long long)s.opens);
+        if (0 <= s.HitRate()) {
+            printf(", hit rate %.1f%%", 100.0 * s.HitRate());
+        }
+        printf("\n");
+    }
+
+    ra.Stop();
+    return 0;
+}
@@ -0,0 +1,489 @@
+#include "WWRenderJitter.h"
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <Windows.h>
+#  include "WWThreadCharacteristics.h"
+#  include "WWTimerResolution.h"
+#else
+#  include <errno.h>
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/prctl.h>
+#  include <sys/timerfd.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+#include "WWBiquad.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+/// the same as WasapiUser
+#define PERIODS_PER_BUFFER_ON_TIMER_DRIVEN_MODE (4)
+
+#define NANOSEC_PER_SEC      (1000000000LL)
+#define NANOSEC_PER_MILLISEC (1000000LL)
+
+/// SCHED_FIFO priority of the render thread on Linux. below the kernel threads of the interrupts
+#define RENDER_THREAD_FIFO_PRIORITY (80)
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#  define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION (0x00000002)
+#endif
+
+const char *
+WWRenderJitterFeedModeToStr(WWRenderJitterFeedMode t)
+{
+    switch (t) {
+    case WWRJFM_EventDriven: return "event";
+    case WWRJFM_TimerDriven: return "timer";
+    default: assert(0); return "";
+    }
+}
+
+const char *
+WWRenderJitterWaitTypeToStr(WWRenderJitterWaitType t)
+{
+    switch (t) {
+    case WWRJWT_Sleep: return "sleep";
+    case WWRJWT_Timer: return "timer";
+    default: assert(0); return "";
+    }
+}
+
+/// monotonic clock of nanoseconds. the clock of the waits
+static int64_t
+NowNanosec(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER c;
+    LARGE_INTEGER f;
+    QueryPerformanceCounter(&c);
+    QueryPerformanceFrequency(&f);
+    return c.QuadPart / f.QuadPart * NANOSEC_PER_SEC + c.QuadPart % f.QuadPart * NANOSEC_PER_SEC / f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NANOSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+/// waits until the time of NowNanosec(). returns at once when the time has passed,
+/// as WaitForMultipleObjects() of the timeout 0 on the timer driven mode of latency 1ms
+class WWRenderJitterWaiter {
+public:
+    WWRenderJitterWaiter(void) : m_type(WWRJWT_Sleep),
+#ifdef _WIN32
+            m_handle(nullptr)
+#else
+            m_fd(-1)
+#endif
+            { }
+
+    ~WWRenderJitterWaiter(void) { Term(); }
+
+    int Init(WWRenderJitterWaitType t);
+    void Term(void);
+    void WaitUntil(int64_t t);
+
+private:
+    WWRenderJitterWaitType m_type;
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    int m_fd;
+#endif
+};
+
+int
+WWRenderJitterWaiter::Init(WWRenderJitterWaitType t)
+{
+    m_type = t;
+#ifdef _WIN32
+    if (WWRJWT_Sleep == t) {
+        // never signaled: only the timeout of the wait ends it, as the shutdown event of RenderMain()
+        m_handle = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    } else {
+        m_handle = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (nullptr == m_handle) {
+            // before Windows 10 1803
+            m_handle = CreateWaitableTimer(nullptr, FALSE, nullptr);
+        }
+    }
+    return (nullptr == m_handle) ? -1 : 0;
+#else
+    if (WWRJWT_Timer == t) {
+        m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (m_fd < 0) {
+            return -1;
+        }
+    }
+    return 0;
+#endif
+}
+
+void
+WWRenderJitterWaiter::Term(void)
+{
+#ifdef _WIN32
+    if (nullptr != m_handle) {
+        CloseHandle(m_handle);
+        m_handle = nullptr;
+    }
+#else
+    if (0 <= m_fd) {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+void
+WWRenderJitterWaiter::WaitUntil(int64_t t)
+{
+    const int64_t remain = t - NowNanosec();
+    if (remain <= 0) {
+        return;
+    }
+
+#ifdef _WIN32
+    if (WWRJWT_Sleep == m_type) {
+        // rounded up to the milliseconds of the timeout
+        WaitForSingleObject(m_handle, (DWORD)((remain + NANOSEC_PER_MILLISEC - 1) / NANOSEC_PER_MILLISEC));
+    } else {
+        LARGE_INTEGER due;
+        due.QuadPart = -std::max((int64_t)1, remain / 100);
+        SetWaitableTimer(m_handle, &due, 0, nullptr, nullptr, FALSE);
+        WaitForSingleObject(m_handle, INFINITE);
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(t / NANOSEC_PER_SEC);
+    ts.tv_nsec = (long)(t % NANOSEC_PER_SEC);
+
+    if (WWRJWT_Sleep == m_type) {
+        while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) {
+        }
+    } else {
+        struct itimerspec its;
+        memset(&its, 0, sizeof its);
+        its.it_value = ts;
+        timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+
+        uint64_t expirations = 0;
+        while (read(m_fd, &expirations, sizeof expirations) < 0 && EINTR == errno) {
+        }
+    }
+#endif
+}
+
+/// the scheduling and the timer setting of the render thread, as RenderMain()
+class WWRenderJitterThreadEnv {
+public:
+    void Setup(const WWRenderJitterConfig &c, WWRenderJitterResult &r);
+    void Unsetup(void);
+
+private:
+#ifdef _WIN32
+    WWThreadCharacteristics m_threadCharacteristics;
+    WWTimerResolution m_timerResolution;
+#endif
+};
+
+void
+WWRenderJitterThreadEnv::Setup(const WWRenderJitterConfig &c, WWRenderJitterResult &r)
+{
+#ifdef _WIN32
+    if (c.realtime) {
+        m_threadCharacteristics.Set(WWMMCSSEnable, WWTPHigh, WWSTTProAudio);
+    } else {
+        m_threadCharacteristics.Set(WWMMCSSDoNotCall, WWTPNone, WWSTTNone);
+    }
+    m_timerResolution.SetTimePeriodHundredNanosec(c.timePeriodHandledNanosec);
+
+    m_timerResolution.Setup();
+    m_threadCharacteristics.Setup();
+
+    WWThreadCharacteristicsSetupResult tcr;
+    m_threadCharacteristics.GetThreadCharacteristicsSetupResult(tcr);
+    r.realtimeApplied = c.realtime && tcr.avSetMmThreadCharacteristicsResult && tcr.avSetMmThreadPriorityResult;
+    r.timerNanosec = (int64_t)m_timerResolution.GetTimePeriodHundredNanosec() * 100;
+#else
+    if (c.realtime) {
+        struct sched_param sp;
+        memset(&sp, 0, sizeof sp);
+        sp.sched_priority = std::min(RENDER_THREAD_FIFO_PRIORITY, sched_get_priority_max(SCHED_FIFO));
+
+        // EPERM without CAP_SYS_NICE or RLIMIT_RTPRIO
+        r.realtimeApplied = 0 == pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    }
+
+    // the timer slack of the thread. the kernel ignores it for the realtime threads
+    if (0 < c.timePeriodHandledNanosec) {
+        prctl(PR_SET_TIMERSLACK, (unsigned long)c.timePeriodHandledNanosec * 100, 0, 0, 0);
+    }
+    const int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    r.timerNanosec = (r.realtimeApplied || slack < 0) ? 0 : slack;
+#endif
+}
+
+void
+WWRenderJitterThreadEnv::Unsetup(void)
+{
+#ifdef _WIN32
+    m_threadCharacteristics.Unsetup();
+    m_timerResolution.Unsetup();
+#else
+    // the settings are of the thread and end with it
+#endif
+}
+
+/// the PCM data and the device buffer of the render thread
+class WWRenderJitterRenderer {
+public:
+    int Init(const WWRenderJitterConfig &c, int64_t bufferFrames);
+
+    /// writes frames to the device buffer
+    void Render(int64_t frames);
+
+private:
+    int m_numChannels;
+    int64_t m_pcmFrames;
+    int64_t m_pcmPos;
+    std::vector<float> m_pcm;
+    std::vector<float> m_deviceBuffer;
+    bool m_useEq;
+    WWBiquadCascade m_eq;
+    std::function<void(float *frames, int64_t numFrames)> m_process;
+};
+
+int
+WWRenderJitterRenderer::Init(const WWRenderJitterConfig &c, int64_t bufferFrames)
+{
+    m_numChannels = c.numChannels;
+    m_pcmFrames = c.sampleRate;
+    m_pcmPos = 0;
+
+    // 1 second of the white noise of -12dB by a 32bit LCG
+    m_pcm.resize((size_t)(m_pcmFrames * m_numChannels));
+    uint32_t x = 1;
+    for (size_t i=0; i<m_pcm.size(); ++i) {
+        x = x * 1664525u + 1013904223u;
+        m_pcm[i] = (float)((int32_t)x * (0.25 / 2147483648.0));
+    }
+
+    m_deviceBuffer.resize((size_t)(bufferFrames * m_numChannels));
+
+    m_process = c.process;
+
+    m_useEq = 0 < c.eqStages;
+    if (m_useEq) {
+        if (m_eq.Init(m_numChannels, c.eqStages) < 0) {
+            return -1;
+        }
+        for (int s=0; s<c.eqStages; ++s) {
+            WWBiquadCoeffs coeffs;
+            if (WWBiquadDesign(WWBT_Peaking, c.sampleRate, 31.25 * (2 << (s % 9)), (s & 1) ? 3.0 : -3.0, 1.0,
+                    coeffs) < 0) {
+                return -1;
+            }
+            for (int ch=0; ch<m_numChannels; ++ch) {
+                m_eq.SetCoeffs(s, ch, coeffs);
+            }
+        }
+        m_eq.Commit(0);
+    }
+    return 0;
+}
+
+void
+WWRenderJitterRenderer::Render(int64_t frames)
+{
+    assert(frames * m_numChannels <= (int64_t)m_deviceBuffer.size());
+    float *to = &m_deviceBuffer[0];
+
+    // wraps around the end of the PCM data as CreateWritableFrames() crosses to the next WWPcmData
+    int64_t copied = 0;
+    while (copied < frames) {
+        const int64_t n = std::min(frames - copied, m_pcmFrames - m_pcmPos);
+        memcpy(&to[copied * m_numChannels], &m_pcm[(size_t)(m_pcmPos * m_numChannels)],
+                (size_t)(n * m_numChannels) * sizeof(float));
+        copied += n;
+        m_pcmPos += n;
+        if (m_pcmPos == m_pcmFrames) {
+            m_pcmPos = 0;
+        }
+    }
+
+    if (m_useEq) {
+        m_eq.Process(to, (int)frames);
+    }
+    if (m_process) {
+        m_process(to, frames);
+    }
+}
+
+static void
+ComputeStats(std::vector<int64_t> &v, WWRenderJitterStats &s_return)
+{
+    s_return = WWRenderJitterStats();
+    if (v.empty()) {
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+
+    s_return.count = (int64_t)n;
+    s_return.min   = v.front();
+    s_return.p1    = v[(n - 1) * 10 / 1000];
+    s_return.p50   = v[(n - 1) * 500 / 1000];
+    s_return.p99   = v[(n - 1) * 990 / 1000];
+    s_return.p999  = v[(n - 1) * 999 / 1000];
+    s_return.max   = v.back();
+}
+
+static int64_t
+FramesToNanosec(int64_t frames, int sampleRate)
+{
+    return frames * NANOSEC_PER_SEC / sampleRate;
+}
+
+static int64_t
+NanosecToFrames(int64_t ns, int sampleRate)
+{
+    return ns * sampleRate / NANOSEC_PER_SEC;
+}
+
+static int
+RenderMain(const WWRenderJitterConfig &c, WWRenderJitterResult &r)
+{
+    const bool eventDriven = WWRJFM_EventDriven == c.feedMode;
+    const int64_t periodFrames = (int64_t)c.sampleRate * c.latencyMillisec / 1000;
+    const int64_t bufferFrames = periodFrames * (eventDriven ? 1 : PERIODS_PER_BUFFER_ON_TIMER_DRIVEN_MODE);
+    const int64_t periodNs = (int64_t)c.latencyMillisec * NANOSEC_PER_MILLISEC;
+    const int64_t timeoutNs = (int64_t)(c.latencyMillisec / 2) * NANOSEC_PER_MILLISEC;
+
+    WWRenderJitterRenderer renderer;
+    if (renderer.Init(c, bufferFrames) < 0) {
+        return -1;
+    }
+
+    WWRenderJitterWaiter waiter;
+    if (waiter.Init(c.waitType) < 0) {
+        return -1;
+    }
+
+    WWRenderJitterThreadEnv env;
+    env.Setup(c, r);
+
+    const size_t expectedWakeups = (size_t)(c.seconds * NANOSEC_PER_SEC / std::max(timeoutNs, (int64_t)NANOSEC_PER_MILLISEC));
+    std::vector<int64_t> lateness;
+    std::vector<int64_t> slack;
+    std::vector<int64_t> process;
+    lateness.reserve(expectedWakeups);
+    slack.reserve(expectedWakeups);
+    process.reserve(expectedWakeups);
+
+    // the buffer is filled before the device starts, as Start() does
+    renderer.Render(bufferFrames);
+    int64_t written = bufferFrames;
+    const int64_t t0 = NowNanosec();
+    const int64_t tEnd = t0 + (int64_t)(c.seconds * NANOSEC_PER_SEC);
+
+    if (eventDriven) {
+        // the device signals at the start of every period for the frames of the next period
+        int64_t k = 0;
+        for (;;) {
+            const int64_t target = t0 + k * periodNs;
+            if (tEnd <= target) {
+                break;
+            }
+            waiter.WaitUntil(target);
+            const int64_t wake = NowNanosec();
+
+            // the auto reset event signaled during the previous wakeup wakes the thread once
+            const int64_t missed = (wake - target) / periodNs;
+
+            const int64_t deadline = t0 + FramesToNanosec(written, c.sampleRate);
+            renderer.Render(periodFrames);
+            const int64_t finish = NowNanosec();
+
+            lateness.push_back(wake - target);
+            slack.push_back(deadline - finish);
+            process.push_back(finish - wake);
+
+            // the device played the periods missed on, the frames written are of the periods after them
+            r.missedEvents += missed;
+            written += (1 + missed) * periodFrames;
+            k += 1 + missed;
+        }
+    } else {
+        // waits latencyMillisec/2 milliseconds after the frames are written, as RenderMain() of the timer driven mode
+        int64_t sleepStart = t0;
+        while (sleepStart < tEnd) {
+            const int64_t target = sleepStart + timeoutNs;
+            waiter.WaitUntil(target);
+            const int64_t wake = NowNanosec();
+
+            const int64_t played = NanosecToFrames(wake - t0, c.sampleRate);
+            const int64_t deadline = t0 + FramesToNanosec(written, c.sampleRate);
+            if (written < played) {
+                // the device played out the buffer and restarts from the wakeup
+                written = played;
+            }
+            const int64_t writable = bufferFrames - (written - played);
+            if (0 < writable) {
+                renderer.Render(writable);
+            }
+            const int64_t finish = NowNanosec();
+
+            lateness.push_back(wake - target);
+            slack.push_back(deadline - finish);
+            process.push_back(finish - wake);
+
+            written += writable;
+            sleepStart = finish;
+        }
+    }
+
+    env.Unsetup();
+
+    r.wakeups = (int64_t)slack.size();
+    for (size_t i=0; i<slack.size(); ++i) {
+        if (slack[i] < 0) {
+            ++r.underruns;
+        }
+    }
+
+    ComputeStats(lateness, r.lateness);
+    ComputeStats(slack, r.slack);
+    ComputeStats(process, r.process);
+    return 0;
+}
+
+int
+WWRenderJitterRun(const WWRenderJitterConfig &c, WWRenderJitterResult &r_return)
+{
+    r_return = WWRenderJitterResult();
+
+    if (c.feedMode < 0 || WWRJFM_NUM <= c.feedMode
+            || c.waitType < 0 || WWRJWT_NUM <= c.waitType
+            || c.latencyMillisec <= 0 || c.sampleRate <= 0 || c.numChannels <= 0
+            || c.timePeriodHandledNanosec < 0 || c.eqStages < 0 || c.seconds <= 0) {
+        return -1;
+    }
+    if ((int64_t)c.sampleRate * c.latencyMillisec / 1000 <= 0) {
+        return -1;
+    }
+
+    // on a thread of its own so that the scheduling and the timer slack of the run end with it
+    int rv = -1;
+    std::thread th([&c, &r_return, &rv]() {
+        rv = RenderMain(c, r_return);
+    });
+    th.join();
+    return rv;
+}
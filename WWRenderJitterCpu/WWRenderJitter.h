@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+/// the same as WWDataFeedMode of WasapiUser
+enum WWRenderJitterFeedMode {
+    WWRJFM_EventDriven,
+    WWRJFM_TimerDriven,
+
+    WWRJFM_NUM
+};
+
+/// how the render thread waits
+enum WWRenderJitterWaitType {
+    /// Linux: clock_nanosleep(). Windows: WaitForSingleObject() timeout of milliseconds, as RenderMain()
+    WWRJWT_Sleep,
+
+    /// Linux: timerfd. Windows: high resolution waitable timer
+    WWRJWT_Timer,
+
+    WWRJWT_NUM
+};
+
+struct WWRenderJitterConfig {
+    WWRenderJitterFeedMode feedMode;
+    WWRenderJitterWaitType waitType;
+
+    /// the device period. the buffer is 1 period on the event driven mode and
+    /// PERIODS_PER_BUFFER_ON_TIMER_DRIVEN_MODE periods on the timer driven mode, as WasapiUser
+    int latencyMillisec;
+
+    int sampleRate;
+    int numChannels;
+
+    /// 100 nanosec unit, as WasapiIoSetupArgs. 0: unchanged.
+    /// Windows: WWTimerResolution. Linux: the timer slack of the render thread (PR_SET_TIMERSLACK)
+    int timePeriodHandledNanosec;
+
+    /// Windows: MMCSS "Pro Audio" task of high priority. Linux: SCHED_FIFO. false: the default scheduling
+    bool realtime;
+
+    /// peaking EQ stages applied to the rendered frames in place of the audio filter sequencer. 0: copy only
+    int eqStages;
+
+    /// called on the render thread with the frames written to the device buffer, after the EQ.
+    /// numFrames interleaved float frames of numChannels. empty: none
+    std::function<void(float *frames, int64_t numFrames)> process;
+
+    double seconds;
+
+    WWRenderJitterConfig(void) : feedMode(WWRJFM_EventDriven), waitType(WWRJWT_Sleep), latencyMillisec(10),
+            sampleRate(48000), numChannels(2), timePeriodHandledNanosec(0), realtime(false), eqStages(0),
+            seconds(2.0) { }
+};
+
+/// distribution of the nanosecond values of a run
+struct WWRenderJitterStats {
+    int64_t count;
+    int64_t min;
+    int64_t p1;
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+    int64_t max;
+
+    WWRenderJitterStats(void) : count(0), min(0), p1(0), p50(0), p99(0), p999(0), max(0) { }
+};
+
+struct WWRenderJitterResult {
+    /// the realtime scheduling was requested and granted
+    bool realtimeApplied;
+
+    /// the timer setting applied. Windows: the timer resolution, 0: unchanged or failed.
+    /// Linux: the timer slack, 0 for the realtime thread that has none
+    int64_t timerNanosec;
+
+    int64_t wakeups;
+
+    /// event driven mode: device events that passed without a wakeup of their own
+    int64_t missedEvents;
+
+    /// frames were written after the device played out the buffer
+    int64_t underruns;
+
+    /// wakeup time - the time the wait was meant to end
+    WWRenderJitterStats lateness;
+
+    /// the time the buffer plays out - the time the frames of the wakeup are written. negative: underrun
+    WWRenderJitterStats slack;
+
+    /// the time from the wakeup to the end of the writing
+    WWRenderJitterStats process;
+
+    WWRenderJitterResult(void) : realtimeApplied(false), timerNanosec(0), wakeups(0), missedEvents(0), underruns(0) { }
+};
+
+/// runs the render loop of WasapiUser on a thread for c.seconds against a simulated device
+/// that consumes the buffer by the clock at c.sampleRate.
+///
+///   Event driven mode: the device signals at every period and the frames of the next period are due one period
+///   later. Timer driven mode: the thread waits latencyMillisec/2 milliseconds, writes the writable frames,
+///   the buffer size minus the padding, and the buffer plays out after the padding.
+///   The frames are copied from a PCM buffer as CreateWritableFrames() and processed by the EQ and c.process.
+/// @return 0: success. negative: bad config or the wait is not available
+int WWRenderJitterRun(const WWRenderJitterConfig &c, WWRenderJitterResult &r_return);
+
+const char *WWRenderJitterFeedModeToStr(WWRenderJitterFeedMode t);
+const char *WWRenderJitterWaitTypeToStr(WWRenderJitterWaitType t);
@@ -0,0 +1,405 @@
+// Measures the wakeup lateness and the processing slack of the render loop of WasapiUser
+// against a simulated device, for the latency settings, the feed modes, the scheduling and the timer settings.
+// Portable C++: builds on Windows and Linux. -swap, the filter chain swap stress of WWAudioFilterSequencer, is Windows only.
+
+#include "WWRenderJitter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#  include "WWAudioFilterSequencer.h"
+#  include "WWAudioFilterMonauralMix.h"
+#  include "WWAudioFilterParametricEq.h"
+#  include "WWAudioFilterPolarityInvert.h"
+#  include <atomic>
+#  include <chrono>
+#  include <thread>
+#endif
+
+static void
+PrintUsage(const char *name)
+{
+    printf("usage: %s [options]\n"
+        "  -mode m[,m...]       feed modes: event, timer. default: event,timer\n"
+        "  -latency ms[,ms...]  device periods in milliseconds. default: 1,2,5,10\n"
+        "  -sched s[,s...]      scheduling: other, rt (Windows: MMCSS Pro Audio, Linux: SCHED_FIFO). default: other,rt\n"
+        "  -wait w[,w...]       waits: sleep, timer (Windows: waitable timer, Linux: timerfd). default: sleep\n"
+        "  -timer hns[,hns...]  timePeriodHandledNanosec in 100ns unit. Windows: timer resolution,\n"
+        "                       Linux: timer slack. 0: unchanged. default: 0\n"
+        "  -rate n              sample rate. default: 48000\n"
+        "  -ch n                channels. default: 2\n"
+        "  -eq n                peaking EQ stages applied to the rendered frames. default: 10\n"
+        "  -seconds s           duration of a configuration. default: 2\n"
+        "  -swap n              Windows: the frames are filtered by WWAudioFilterSequencer and its filter chain is\n"
+        "                       swapped n times per second during the run, as PlayPcmWin edits the filters while playing.\n"
+        "                       the exit code is 1 when a run of the swaps has an underrun. default: 0\n"
+        "  -csv path            writes the rows of the table as CSV\n",
+        name);
+}
+
+static bool
+SplitInts(const char *s, std::vector<int> &v_return)
+{
+    v_return.clear();
+    std::string str(s);
+    size_t from = 0;
+    for (;;) {
+        const size_t comma = str.find(',', from);
+        const std::string token = str.substr(from, (comma == std::string::npos) ? std::string::npos : comma - from);
+        char *end = nullptr;
+        const long n = strtol(token.c_str(), &end, 10);
+        if (token.empty() || *end != '\0' || n < 0) {
+            return false;
+        }
+        v_return.push_back((int)n);
+        if (comma == std::string::npos) {
+            return true;
+        }
+        from = comma + 1;
+    }
+}
+
+/// splits s by comma to the indices of the names
+static bool
+SplitNames(const char *s, const char * const *names, int numNames, std::vector<int> &v_return)
+{
+    v_return.clear();
+    std::string str(s);
+    size_t from = 0;
+    for (;;) {
+        const size_t comma = str.find(',', from);
+        const std::string token = str.substr(from, (comma == std::string::npos) ? std::string::npos : comma - from);
+        int i = 0;
+        while (i < numNames && token != names[i]) {
+            ++i;
+        }
+        if (numNames <= i) {
+            return false;
+        }
+        v_return.push_back(i);
+        if (comma == std::string::npos) {
+            return true;
+        }
+        from = comma + 1;
+    }
+}
+
+#ifdef _WIN32
+
+/// filters the frames of the render thread by WWAudioFilterSequencer and swaps its filter chain on a control thread.
+/// the edits are of WasapiIO_AppendAudioFilter(), WasapiIO_ClearAudioFilter() and the batch of
+/// WasapiIO_BeginAudioFilterChain() and WasapiIO_CommitAudioFilterChain() with the crossfade
+class ChainSwapper {
+public:
+    ChainSwapper(void) : m_quit(false), m_swaps(0) { }
+
+    void Start(WWRenderJitterConfig &c_inout, int swapsPerSecond) {
+        m_seq.Init();
+        m_seq.UpdateSampleFormat(c_inout.sampleRate, WWPcmDataSampleFormatSfloat, WWStreamPcm, c_inout.numChannels);
+
+        const int numChannels = c_inout.numChannels;
+        c_inout.process = [this, numChannels](float *frames, int64_t numFrames) {
+            if (m_seq.IsAvailable()) {
+                m_seq.ProcessSamples((unsigned char *)frames, (int)(numFrames * numChannels * sizeof(float)));
+            }
+
+            // as WasapiUser::AudioSamplesSendProc()
+            m_seq.ReclaimRetired();
+        };
+
+        m_quit = false;
+        m_swaps = 0;
+        m_thread = std::thread(&ChainSwapper::ControlThread, this, swapsPerSecond);
+    }
+
+    /// call after the run. the render thread is not running
+    void Stop(void) {
+        m_quit = true;
+        m_thread.join();
+        m_seq.Term();
+    }
+
+    int64_t Swaps(void) const { return m_swaps; }
+
+private:
+    WWAudioFilterSequencer m_seq;
+    std::thread m_thread;
+    std::atomic<bool> m_quit;
+    int64_t m_swaps;
+
+    void ControlThread(int swapsPerSecond) {
+        const auto interval = std::chrono::microseconds(1000000 / swapsPerSecond);
+        auto next = std::chrono::steady_clock::now();
+
+        for (int64_t i=0; !m_quit; ++i) {
+            switch (i % 4) {
+            case 0:
+                // appended to the chain playing: the filters are shared and it is not crossfaded
+                m_seq.Append(new WWAudioFilterPolarityInvert());
+                break;
+            case 1:
+                m_seq.UnregisterAll();
+                break;
+            case 2:
+                // a new chain of its own: crossfaded from the empty chain
+                m_seq.BeginEdit();
+                m_seq.UnregisterAll();
+                m_seq.Append(new WWAudioFilterParametricEq(L"LS:100:3:0.7 PK:3000:-2.5:1.4 HS:8000:2:0.7"));
+                m_seq.Append(new WWAudioFilterMonauralMix());
+                m_seq.CommitEdit(20);
+                break;
+            case 3:
+                // replaces the chain: crossfaded from the EQ
+                m_seq.BeginEdit();
+                m_seq.UnregisterAll();
+                m_seq.Append(new WWAudioFilterPolarityInvert());
+                m_seq.CommitEdit(20);
+                break;
+            }
+            ++m_swaps;
+
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    }
+};
+
+#endif // _WIN32
+
+struct Row {
+    WWRenderJitterConfig c;
+    WWRenderJitterResult r;
+};
+
+static double
+Us(int64_t ns)
+{
+    return ns * 0.001;
+}
+
+static std::string
+SchedStr(const Row &row)
+{
+    if (!row.c.realtime) {
+        return "other";
+    }
+    return row.r.realtimeApplied ? "rt" : "rt-denied";
+}
+
+static void
+PrintHeader(void)
+{
+    printf("%-5s %-5s %4s %-9s %7s %7s | %8s %8s %8s %8s | %9s %9s | %7s %7s | %6s %6s\n",
+        "mode", "wait", "ms", "sched", "timerUs", "wakeups",
+        "lateP50", "lateP99", "lateP999", "lateMax",
+        "slackMin", "slackP1", "procP50", "procMax", "missed", "under");
+    printf("%-5s %-5s %4s %-9s %7s %7s | %8s %8s %8s %8s | %9s %9s | %7s %7s | %6s %6s\n",
+        "", "", "", "", "", "", "us", "us", "us", "us", "us", "us", "us", "us", "", "");
+}
+
+static void
+PrintRow(const Row &row)
+{
+    const WWRenderJitterConfig &c = row.c;
+    const WWRenderJitterResult &r = row.r;
+    printf("%-5s %-5s %4d %-9s %7.1f %7lld | %8.1f %8.1f %8.1f %8.1f | %9.1f %9.1f | %7.1f %7.1f | %6lld %6lld\n",
+        WWRenderJitterFeedModeToStr(c.feedMode), WWRenderJitterWaitTypeToStr(c.waitType), c.latencyMillisec,
+        SchedStr(row).c_str(), Us(r.timerNanosec), (long long)r.wakeups,
+        Us(r.lateness.p50), Us(r.lateness.p99), Us(r.lateness.p999), Us(r.lateness.max),
+        Us(r.slack.min), Us(r.slack.p1), Us(r.process.p50), Us(r.process.max),
+        (long long)r.missedEvents, (long long)r.underruns);
+    fflush(stdout);
+}
+
+static void
+WriteCsv(FILE *fp, const std::vector<Row> &rows)
+{
+    fprintf(fp, "mode,wait,latencyMillisec,sched,timerNanosec,sampleRate,numChannels,eqStages,seconds,wakeups,"
+        "latenessMinNs,latenessP50Ns,latenessP99Ns,latenessP999Ns,latenessMaxNs,"
+        "slackMinNs,slackP1Ns,slackP50Ns,processP50Ns,processP99Ns,processMaxNs,missedEvents,underruns\n");
+    for (size_t i=0; i<rows.size(); ++i) {
+        const WWRenderJitterConfig &c = rows[i].c;
+        const WWRenderJitterResult &r = rows[i].r;
+        fprintf(fp, "%s,%s,%d,%s,%lld,%d,%d,%d,%g,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n",
+            WWRenderJitterFeedModeToStr(c.feedMode), WWRenderJitterWaitTypeToStr(c.waitType), c.latencyMillisec,
+            SchedStr(rows[i]).c_str(), (long long)r.timerNanosec, c.sampleRate, c.numChannels, c.eqStages, c.seconds,
+            (long long)r.wakeups,
+            (long long)r.lateness.min, (long long)r.lateness.p50, (long long)r.lateness.p99,
+            (long long)r.lateness.p999, (long long)r.lateness.max,
+            (long long)r.slack.min, (long long)r.slack.p1, (long long)r.slack.p50,
+            (long long)r.process.p50, (long long)r.process.p99, (long long)r.process.max,
+            (long long)r.missedEvents, (long long)r.underruns);
+    }
+}
+
+/// the shortest latency of each of the other settings that ran without an underrun
+static void
+PrintRecommendation(const std::vector<Row> &rows)
+{
+    printf("\nshortest latency without underruns:\n");
+    std::vector<bool> done(rows.size(), false);
+    for (size_t i=0; i<rows.size(); ++i) {
+        if (done[i]) {
+            continue;
+        }
+        int best = -1;
+        for (size_t j=i; j<rows.size(); ++j) {
+            const WWRenderJitterConfig &a = rows[i].c;
+            const WWRenderJitterConfig &b = rows[j].c;
+            if (a.feedMode != b.feedMode || a.waitType != b.waitType || a.realtime != b.realtime
+                    || a.timePeriodHandledNanosec != b.timePeriodHandledNanosec) {
+                continue;
+            }
+            done[j] = true;
+            if (0 == rows[j].r.underruns && (best < 0 || b.latencyMillisec < best)) {
+                best = b.latencyMillisec;
+            }
+        }
+        printf("  %-5s %-5s %-9s timer=%-6d: ", WWRenderJitterFeedModeToStr(rows[i].c.feedMode),
+            WWRenderJitterWaitTypeToStr(rows[i].c.waitType), SchedStr(rows[i]).c_str(),
+            rows[i].c.timePeriodHandledNanosec);
+        if (best < 0) {
+            printf("none\n");
+        } else {
+            printf("%d ms\n", best);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char * const modeNames[] = { "event", "timer" };
+    static const char * const waitNames[] = { "sleep", "timer" };
+    static const char * const schedNames[] = { "other", "rt" };
+
+    std::vector<int> modes;
+    std::vector<int> latencies;
+    std::vector<int> scheds;
+    std::vector<int> waits;
+    std::vector<int> timers;
+    SplitNames("event,timer", modeNames, 2, modes);
+    SplitInts("1,2,5,10", latencies);
+    SplitNames("other,rt", schedNames, 2, scheds);
+    SplitNames("sleep", waitNames, 2, waits);
+    SplitInts("0", timers);
+
+    WWRenderJitterConfig base;
+    base.eqStages = 10;
+    const char *csvPath = nullptr;
+    int swapsPerSecond = 0;
+
+    for (int i=1; i<argc; ++i) {
+        const bool hasArg = i + 1 < argc;
+        bool ok = hasArg;
+        if (0 == strcmp("-mode", argv[i]) && hasArg) {
+            ok = SplitNames(argv[++i], modeNames, 2, modes);
+        } else if (0 == strcmp("-latency", argv[i]) && hasArg) {
+            ok = SplitInts(argv[++i], latencies);
+        } else if (0 == strcmp("-sched", argv[i]) && hasArg) {
+            ok = SplitNames(argv[++i], schedNames, 2, scheds);
+        } else if (0 == strcmp("-wait", argv[i]) && hasArg) {
+            ok = SplitNames(argv[++i], waitNames, 2, waits);
+        } else if (0 == strcmp("-timer", argv[i]) && hasArg) {
+            ok = SplitInts(argv[++i], timers);
+        } else if (0 == strcmp("-rate", argv[i]) && hasArg) {
+            base.sampleRate = atoi(argv[++i]);
+        } else if (0 == strcmp("-ch", argv[i]) && hasArg) {
+            base.numChannels = atoi(argv[++i]);
+        } else if (0 == strcmp("-eq", argv[i]) && hasArg) {
+            base.eqStages = atoi(argv[++i]);
+        } else if (0 == strcmp("-seconds", argv[i]) && hasArg) {
+            base.seconds = atof(argv[++i]);
+        } else if (0 == strcmp("-swap", argv[i]) && hasArg) {
+            swapsPerSecond = atoi(argv[++i]);
+            ok = 0 <= swapsPerSecond && swapsPerSecond <= 100000;
+        } else if (0 == strcmp("-csv", argv[i]) && hasArg) {
+            csvPath = argv[++i];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifndef _WIN32
+    if (0 < swapsPerSecond) {
+        fprintf(stderr, "Error: -swap is supported on Windows only\n");
+        return 1;
+    }
+#endif
+
+    printf("%d Hz %d ch, EQ %d stages, %g seconds per configuration",
+        base.sampleRate, base.numChannels, base.eqStages, base.seconds);
+    if (0 < swapsPerSecond) {
+        printf(", filter chain swapped %d times per second", swapsPerSecond);
+    }
+    printf("\n\n");
+    PrintHeader();
+
+    std::vector<Row> rows;
+    int64_t totalSwaps = 0;
+    int64_t swapUnderruns = 0;
+    for (int mode : modes) {
+        for (int wait : waits) {
+            for (int sched : scheds) {
+                for (int timer : timers) {
+                    for (int latency : latencies) {
+                        Row row;
+                        row.c = base;
+                        row.c.feedMode = (WWRenderJitterFeedMode)mode;
+                        row.c.waitType = (WWRenderJitterWaitType)wait;
+                        row.c.realtime = 1 == sched;
+                        row.c.timePeriodHandledNanosec = timer;
+                        row.c.latencyMillisec = latency;
+
+                        int rv = 0;
+                        if (0 < swapsPerSecond) {
+#ifdef _WIN32
+                            ChainSwapper swapper;
+                            swapper.Start(row.c, swapsPerSecond);
+                            rv = WWRenderJitterRun(row.c, row.r);
+                            swapper.Stop();
+                            row.c.process = nullptr;
+                            totalSwaps += swapper.Swaps();
+                            swapUnderruns += row.r.underruns;
+#endif
+                        } else {
+                            rv = WWRenderJitterRun(row.c, row.r);
+                        }
+                        if (rv < 0) {
+                            fprintf(stderr, "Error: failed to run %s %s %d ms\n", modeNames[mode], waitNames[wait],
+                                latency);
+                            return 1;
+                        }
+                        PrintRow(row);
+                        rows.push_back(row);
+                    }
+                }
+            }
+        }
+    }
+
+    PrintRecommendation(rows);
+
+    if (csvPath) {
+        FILE *fp = fopen(csvPath, "wb");
+        if (nullptr == fp) {
+            fprintf(stderr, "Error: failed to open %s\n", csvPath);
+            return 1;
+        }
+        WriteCsv(fp, rows);
+        fclose(fp);
+    }
+
+    if (0 < swapsPerSecond) {
+        printf("\nfilter chain swapped %lld times, %lld underruns\n", (long long)totalSwaps, (long long)swapUnderruns);
+        return (0 == swapUnderruns) ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,545 @@
+#include "WWFlacFrameEncoder.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#define FIXED_ORDER_MAX     (4)
+
+/// the partitions of the residual are up to 2^PARTITION_ORDER_MAX
+#define PARTITION_ORDER_MAX (8)
+
+/// the Rice parameter of the 4 bit field. 15 is the escape code
+#define RICE_PARAM_MAX4     (14)
+
+/// the Rice parameter of the 5 bit field. 31 is the escape code
+#define RICE_PARAM_MAX5     (30)
+
+#define SAMPLE_RATE_MAX     (655350)
+
+enum SubframeType {
+    ST_Constant,
+    ST_Verbatim,
+    ST_Fixed,
+};
+
+struct SubframePlan {
+    SubframeType type;
+    int order;
+    int partitionOrder;
+
+    /// 4 or 5
+    int riceParamBits;
+    int riceParams[1 << PARTITION_ORDER_MAX];
+
+    /// the size of the subframe
+    int64_t bits;
+};
+
+/// CRC-8 of the polynomial x^8 + x^2 + x + 1 and CRC-16 of x^16 + x^15 + x^2 + 1 of the frame
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables(void) {
+        for (int i=0; i<256; ++i) {
+            uint32_t c8 = i;
+            uint32_t c16 = i << 8;
+            for (int b=0; b<8; ++b) {
+                c8 = (c8 & 0x80) ? ((c8 << 1) ^ 0x07) : (c8 << 1);
+                c16 = (c16 & 0x8000) ? ((c16 << 1) ^ 0x8005) : (c16 << 1);
+            }
+            crc8[i] = (uint8_t)c8;
+            crc16[i] = (uint16_t)c16;
+        }
+    }
+};
+
+static const CrcTables &
+Crc(void)
+{
+    static const CrcTables tables;
+    return tables;
+}
+
+/// MSB first bit writer that appends to a byte vector
+class BitWriter {
+public:
+    BitWriter(std::vector<uint8_t> &v) : m_v(v), m_acc(0), m_bits(0) { }
+
+    /// @param bits 0 to 32
+    void Put(uint32_t v, int bits) {
+        assert(0 <= bits && bits <= 32);
+        if (0 == bits) {
+            return;
+        }
+        m_acc = (m_acc << bits) | (v & (0xffffffffU >> (32 - bits)));
+        m_bits += bits;
+        while (8 <= m_bits) {
+            m_bits -= 8;
+            m_v.push_back((uint8_t)(m_acc >> m_bits));
+        }
+    }
+
+    void PutSigned(int32_t v, int bits) {
+        Put((uint32_t)v, bits);
+    }
+
+    /// q zeros and a 1, then the k low bits of u. k is up to 30
+    void PutRice(uint32_t u, int k) {
+        uint32_t q = u >> k;
+        while (32 <= q) {
+            Put(0, 32);
+            q -= 32;
+        }
+        const uint32_t low = (0 == k) ? 0 : (u & (0xffffffffU >> (32 - k)));
+        if ((int)q + 1 + k <= 32) {
+            Put((1U << k) | low, (int)q + 1 + k);
+        } else {
+            Put(1, (int)q + 1);
+            Put(low, k);
+        }
+    }
+
+    /// zeros to the byte boundary
+    void Align(void) {
+        if (0 < m_bits) {
+            Put(0, 8 - m_bits);
+        }
+    }
+
+private:
+    std::vector<uint8_t> &m_v;
+    uint64_t m_acc;
+    int m_bits;
+};
+
+static uint32_t
+ZigZag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/// the Rice parameter of the smallest estimated size of n residuals of the sum of the zigzag values
+static int
+BestRiceParam(uint64_t sum, int n, int64_t &bits_return)
+{
+    int best = 0;
+    int64_t bestBits = (int64_t)n + (int64_t)sum;
+    for (int k=1; k<=RICE_PARAM_MAX5; ++k) {
+        const int64_t bits = (int64_t)n * (k + 1) + (int64_t)(sum >> k);
+        if (bestBits < bits) {
+            break;
+        }
+        best = k;
+        bestBits = bits;
+    }
+    bits_return = bestBits;
+    return best;
+}
+
+/// the residual of the fixed predictor of order
+static void
+FixedResidual(const int32_t *x, int n, int order, uint32_t *u_return)
+{
+    for (int i=order; i<n; ++i) {
+        int32_t e = 0;
+        switch (order) {
+        case 0: e = x[i]; break;
+        case 1: e = x[i] - x[i-1]; break;
+        case 2: e = x[i] - 2 * x[i-1] + x[i-2]; break;
+        case 3: e = x[i] - 3 * x[i-1] + 3 * x[i-2] - x[i-3]; break;
+        case 4: e = x[i] - 4 * x[i-1] + 6 * x[i-2] - 4 * x[i-3] + x[i-4]; break;
+        default: assert(0); break;
+        }
+        u_return[i - order] = ZigZag(e);
+    }
+}
+
+/// decides the subframe of the samples x of bps bits and its size. u: scratch of n values
+static void
+PlanSubframe(const int32_t *x, int n, int bps, std::vector<uint32_t> &u, SubframePlan &p)
+{
+    // subframe header of 8 bits
+    p.order = 0;
+    p.partitionOrder = 0;
+    p.riceParamBits = 4;
+
+    bool constant = true;
+    for (int i=1; i<n; ++i) {
+        if (x[i] != x[0]) {
+            constant = false;
+            break;
+        }
+    }
+    if (constant) {
+        p.type = ST_Constant;
+        p.bits = 8 + bps;
+        return;
+    }
+
+    p.type = ST_Verbatim;
+    p.bits = 8 + (int64_t)n * bps;
+    if (n <= FIXED_ORDER_MAX) {
+        return;
+    }
+
+    // the fixed predictor order of the smallest sum of the absolute residual, as libFLAC
+    uint64_t err[FIXED_ORDER_MAX + 1] = { 0 };
+    for (int i=FIXED_ORDER_MAX; i<n; ++i) {
+        const int32_t e0 = x[i];
+        const int32_t e1 = e0 - x[i-1];
+        const int32_t e2 = e1 - (x[i-1] - x[i-2]);
+        const int32_t e3 = e2 - (x[i-1] - 2 * x[i-2] + x[i-3]);
+        const int32_t e4 = e3 - (x[i-1] - 3 * x[i-2] + 3 * x[i-3] - x[i-4]);
+        err[0] += (uint64_t)(e0 < 0 ? -(int64_t)e0 : e0);
+        err[1] += (uint64_t)(e1 < 0 ? -(int64_t)e1 : e1);
+        err[2] += (uint64_t)(e2 < 0 ? -(int64_t)e2 : e2);
+        err[3] += (uint64_t)(e3 < 0 ? -(int64_t)e3 : e3);
+        err[4] += (uint64_t)(e4 < 0 ? -(int64_t)e4 : e4);
+    }
+    int order = 0;
+    for (int k=1; k<=FIXED_ORDER_MAX; ++k) {
+        if (err[k] < err[order]) {
+            order = k;
+        }
+    }
+
+    u.resize(n);
+    FixedResidual(x, n, order, &u[0]);
+
+    // the sums of the partitions of the largest partition order, merged to the smaller orders
+    int maxPartitionOrder = 0;
+    while (maxPartitionOrder < PARTITION_ORDER_MAX && 0 == (n & ((2 << maxPartitionOrder) - 1))
+            && order < (n >> (maxPartitionOrder + 1))) {
+        ++maxPartitionOrder;
+    }
+
+    std::vector<uint64_t> sums((size_t)1 << maxPartitionOrder, 0);
+    {
+        const int partSize = n >> maxPartitionOrder;
+        int pos = 0;
+        for (int j=0; j<(int)sums.size(); ++j) {
+            const int end = (j + 1) * partSize - order;
+            uint64_t s = 0;
+            for (; pos < end; ++pos) {
+                s += u[pos];
+            }
+            sums[j] = s;
+        }
+    }
+
+    int64_t bestBits = -1;
+    for (int po=maxPartitionOrder; 0 <= po; --po) {
+        const int parts = 1 << po;
+        const int partSize = n >> po;
+        int64_t bits = 0;
+        bool wide = false;
+        int params[1 << PARTITION_ORDER_MAX];
+        for (int j=0; j<parts; ++j) {
+            const int count = partSize - ((0 == j) ? order : 0);
+            int64_t b = 0;
+            params[j] = BestRiceParam(sums[j], count, b);
+            bits += b;
+            wide = wide || RICE_PARAM_MAX4 < params[j];
+        }
+        bits += (int64_t)parts * (wide ? 5 : 4);
+
+        if (bestBits < 0 || bits < bestBits) {
+            bestBits = bits;
+            p.partitionOrder = po;
+            p.riceParamBits = wide ? 5 : 4;
+            memcpy(p.riceParams, params, sizeof(int) * parts);
+        }
+
+        // the sums of the next smaller order
+        for (int j=0; j<parts / 2; ++j) {
+            sums[j] = sums[2 * j] + sums[2 * j + 1];
+        }
+    }
+
+    // header, warm-up samples, coding method, partition order, partitions
+    const int64_t fixedBits = 8 + (int64_t)order * bps + 2 + 4 + bestBits;
+    if (fixedBits < p.bits) {
+        p.type = ST_Fixed;
+        p.order = order;
+        p.bits = fixedBits;
+    }
+}
+
+static void
+WriteSubframe(const int32_t *x, int n, int bps, const SubframePlan &p, std::vector<uint32_t> &u, BitWriter &bw)
+{
+    switch (p.type) {
+    case ST_Constant:
+        bw.Put(0x00, 8);
+        bw.PutSigned(x[0], bps);
+        break;
+    case ST_Verbatim:
+        bw.Put(0x02, 8);
+        for (int i=0; i<n; ++i) {
+            bw.PutSigned(x[i], bps);
+        }
+        break;
+    case ST_Fixed:
+        {
+            bw.Put((0x08 | p.order) << 1, 8);
+            for (int i=0; i<p.order; ++i) {
+                bw.PutSigned(x[i], bps);
+            }
+
+            u.resize(n);
+            FixedResidual(x, n, p.order, &u[0]);
+
+            bw.Put((5 == p.riceParamBits) ? 1 : 0, 2);
+            bw.Put(p.partitionOrder, 4);
+            const int parts = 1 << p.partitionOrder;
+            const int partSize = n >> p.partitionOrder;
+            int pos = 0;
+            for (int j=0; j<parts; ++j) {
+                const int k = p.riceParams[j];
+                const int end = (j + 1) * partSize - p.order;
+                bw.Put(k, p.riceParamBits);
+                for (; pos < end; ++pos) {
+                    bw.PutRice(u[pos], k);
+                }
+            }
+        }
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+static int
+BlockSizeCode(int frames)
+{
+    switch (frames) {
+    case 192:   return 1;
+    case 576:   return 2;
+    case 1152:  return 3;
+    case 2304:  return 4;
+    case 4608:  return 5;
+    case 256:   return 8;
+    case 512:   return 9;
+    case 1024:  return 10;
+    case 2048:  return 11;
+    case 4096:  return 12;
+    case 8192:  return 13;
+    case 16384: return 14;
+    case 32768: return 15;
+    default:
+        // 8 or 16 bit of frames - 1 follows
+        return (frames <= 256) ? 6 : 7;
+    }
+}
+
+static int
+SampleRateCode(int sampleRate)
+{
+    switch (sampleRate) {
+    case 88200:  return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000:   return 4;
+    case 16000:  return 5;
+    case 22050:  return 6;
+    case 24000:  return 7;
+    case 32000:  return 8;
+    case 44100:  return 9;
+    case 48000:  return 10;
+    case 96000:  return 11;
+    default:
+        // of STREAMINFO
+        return 0;
+    }
+}
+
+static int
+SampleSizeCode(int bitsPerSample)
+{
+    switch (bitsPerSample) {
+    case 8:  return 1;
+    case 12: return 2;
+    case 16: return 4;
+    case 20: return 5;
+    case 24: return 6;
+    default:
+        // of STREAMINFO
+        return 0;
+    }
+}
+
+WWFlacFrameEncoder::WWFlacFrameEncoder(void)
+    : m_sampleRate(0), m_numChannels(0), m_bitsPerSample(0)
+{
+}
+
+int
+WWFlacFrameEncoder::Init(int sampleRate, int numChannels, int bitsPerSample)
+{
+    if (sampleRate <= 0 || SAMPLE_RATE_MAX < sampleRate || numChannels < 1 || 8 < numChannels
+            || bitsPerSample < 8 || 24 < bitsPerSample) {
+        return -1;
+    }
+    m_sampleRate    = sampleRate;
+    m_numChannels   = numChannels;
+    m_bitsPerSample = bitsPerSample;
+
+    // the tables are created before the threads use them
+    Crc();
+    return 0;
+}
+
+void
+WWFlacFrameEncoder::StreamHeader(int64_t totalFrames, int minFrameBytes, int maxFrameBytes,
+        std::vector<uint8_t> &to_return) const
+{
+    to_return.clear();
+    to_return.reserve(StreamHeaderBytes());
+    BitWriter bw(to_return);
+
+    bw.Put('f', 8);
+    bw.Put('L', 8);
+    bw.Put('a', 8);
+    bw.Put('C', 8);
+
+    // the last metadata block, STREAMINFO of 34 bytes
+    bw.Put(1, 1);
+    bw.Put(0, 7);
+    bw.Put(34, 24);
+
+    bw.Put(WW_FLAC_BLOCK_FRAMES, 16);
+    bw.Put(WW_FLAC_BLOCK_FRAMES, 16);
+    bw.Put(minFrameBytes, 24);
+    bw.Put(maxFrameBytes, 24);
+    bw.Put(m_sampleRate, 20);
+    bw.Put(m_numChannels - 1, 3);
+    bw.Put(m_bitsPerSample - 1, 5);
+    bw.Put((uint32_t)((uint64_t)totalFrames >> 32) & 0xf, 4);
+    bw.Put((uint32_t)totalFrames, 32);
+
+    // MD5 of the PCM: not computed
+    for (int i=0; i<4; ++i) {
+        bw.Put(0, 32);
+    }
+    assert((int)to_return.size() == StreamHeaderBytes());
+}
+
+void
+WWFlacFrameEncoder::EncodeFrame(int64_t frameNumber, const int32_t *pcm, int frames,
+        std::vector<uint8_t> &to_append) const
+{
+    assert(0 < frames && frames <= 65536);
+    const int nch = m_numChannels;
+    const int bps = m_bitsPerSample;
+    const CrcTables &crc = Crc();
+    const size_t frameStart = to_append.size();
+
+    // the channels and mid, side of the stereo
+    std::vector<int32_t> x((size_t)frames * (nch + 2));
+    for (int ch=0; ch<nch; ++ch) {
+        int32_t *to = &x[(size_t)ch * frames];
+        for (int i=0; i<frames; ++i) {
+            to[i] = pcm[(size_t)i * nch + ch];
+        }
+    }
+
+    std::vector<uint32_t> u;
+    std::vector<SubframePlan> plans(nch + 2);
+    for (int ch=0; ch<nch; ++ch) {
+        PlanSubframe(&x[(size_t)ch * frames], frames, bps, u, plans[ch]);
+    }
+
+    // channel assignment 0 to 7: independent channels, 8: left/side, 9: right/side, 10: mid/side
+    int assignment = nch - 1;
+    int subframeCh[2] = { 0, 1 };
+    if (2 == nch) {
+        int32_t *mid  = &x[(size_t)2 * frames];
+        int32_t *side = &x[(size_t)3 * frames];
+        for (int i=0; i<frames; ++i) {
+            const int32_t l = x[i];
+            const int32_t r = x[(size_t)frames + i];
+            mid[i]  = (l + r) >> 1;
+            side[i] = l - r;
+        }
+        PlanSubframe(mid, frames, bps, u, plans[2]);
+        PlanSubframe(side, frames, bps + 1, u, plans[3]);
+
+        const int64_t lr = plans[0].bits + plans[1].bits;
+        const int64_t ls = plans[0].bits + plans[3].bits;
+        const int64_t rs = plans[1].bits + plans[3].bits;
+        const int64_t ms = plans[2].bits + plans[3].bits;
+        const int64_t best = std::min(std::min(lr, ls), std::min(rs, ms));
+        if (best == lr) {
+            assignment = 1;
+        } else if (best == ls) {
+            assignment = 8;
+            subframeCh[1] = 3;
+        } else if (best == rs) {
+            assignment = 9;
+            subframeCh[0] = 3;
+        } else {
+            assignment = 10;
+            subframeCh[0] = 2;
+            subframeCh[1] = 3;
+        }
+    }
+
+    BitWriter bw(to_append);
+
+    // frame header: sync code and the fixed block size
+    const int blockSizeCode = BlockSizeCode(frames);
+    bw.Put(0xfff8, 16);
+    bw.Put(blockSizeCode, 4);
+    bw.Put(SampleRateCode(m_sampleRate), 4);
+    bw.Put(assignment, 4);
+    bw.Put(SampleSizeCode(bps), 3);
+    bw.Put(0, 1);
+
+    // the frame number coded as UTF-8, extended to 36 bits
+    {
+        const uint64_t v = (uint64_t)frameNumber;
+        if (v < 0x80) {
+            bw.Put((uint32_t)v, 8);
+        } else {
+            int bytes = 2;
+            while (bytes < 7 && ((uint64_t)1 << (5 * bytes + 1)) <= v) {
+                ++bytes;
+            }
+            const uint32_t lead = (0xff00U >> bytes) & 0xff;
+            bw.Put(lead | (uint32_t)(v >> (6 * (bytes - 1))), 8);
+            for (int i=bytes-2; 0 <= i; --i) {
+                bw.Put(0x80 | (uint32_t)((v >> (6 * i)) & 0x3f), 8);
+            }
+        }
+    }
+    if (6 == blockSizeCode) {
+        bw.Put(frames - 1, 8);
+    } else if (7 == blockSizeCode) {
+        bw.Put(frames - 1, 16);
+    }
+
+    {
+        uint8_t c8 = 0;
+        for (size_t i=frameStart; i<to_append.size(); ++i) {
+            c8 = crc.crc8[c8 ^ to_append[i]];
+        }
+        bw.Put(c8, 8);
+    }
+
+    for (int ch=0; ch<nch; ++ch) {
+        const int src = (2 == nch) ? subframeCh[ch] : ch;
+
+        // the side channel has 1 more bit
+        const int bits = (2 == nch && 3 == src) ? bps + 1 : bps;
+        WriteSubframe(&x[(size_t)src * frames], frames, bits, plans[src], u, bw);
+    }
+    bw.Align();
+
+    uint16_t c16 = 0;
+    for (size_t i=frameStart; i<to_append.size(); ++i) {
+        c16 = (uint16_t)((c16 << 8) ^ crc.crc16[(c16 >> 8) ^ to_append[i]]);
+    }
+    bw.Put(c16, 16);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// FLAC frames of the fixed block size are encoded as this number of frames
+#define WW_FLAC_BLOCK_FRAMES (4096)
+
+/// FLAC stream encoder of the frames encoded independently.
+///
+///   WWFlacRW encodes the PCM data on memory with libFLAC. This encoder writes a frame of the fixed block size
+///   from the PCM of the frame only, so the frames are encoded by the threads in parallel and written
+///   to the file in order.
+///   The subframes are CONSTANT, VERBATIM or FIXED of the predictor order 0 to 4 with the partitioned Rice coding.
+///   The stereo is coded as left/right, left/side, right/side or mid/side of the smallest.
+///   No LPC: the files are larger than those of libFLAC.
+class WWFlacFrameEncoder {
+public:
+    WWFlacFrameEncoder(void);
+
+    /// @param bitsPerSample 8 to 24
+    /// @return 0: success. negative: bad parameter
+    int Init(int sampleRate, int numChannels, int bitsPerSample);
+
+    /// "fLaC" and the STREAMINFO of the frames of WW_FLAC_BLOCK_FRAMES frames. MD5 is 0: not computed.
+    /// @param minFrameBytes, maxFrameBytes 0: unknown
+    void StreamHeader(int64_t totalFrames, int minFrameBytes, int maxFrameBytes, std::vector<uint8_t> &to_return) const;
+
+    /// bytes of StreamHeader()
+    static int StreamHeaderBytes(void) { return 4 + 4 + 34; }
+
+    /// appends a FLAC frame. thread safe
+    /// @param frameNumber the index of the frame of the stream
+    /// @param pcm frames * numChannels integers of the bits per sample, channel interleaved
+    /// @param frames WW_FLAC_BLOCK_FRAMES. the last frame of the stream can be smaller
+    void EncodeFrame(int64_t frameNumber, const int32_t *pcm, int frames, std::vector<uint8_t> &to_append) const;
+
+private:
+    int m_sampleRate;
+    int m_numChannels;
+    int m_bitsPerSample;
+};
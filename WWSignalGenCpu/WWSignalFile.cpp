@@ -0,0 +1,575 @@
+#include "WWSignalFile.h"
+#include "WWFlacFrameEncoder.h"
+#include "WWDsdModulator.h"
+#include "WWWavFile.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// frames of the generator per block. a multiple of WW_FLAC_BLOCK_FRAMES and of DSF_BLOCK_BYTES
+#define BLOCK_FRAMES (65536)
+
+/// blocks generated and not written yet, per thread
+#define BLOCKS_PER_THREAD (2)
+
+/// DSF: bytes of a channel interleaved
+#define DSF_BLOCK_BYTES (4096)
+#define DSF_CHANNEL_MAX (6)
+
+/// DSD silence pattern of DSDIFF bit order
+#define DSD_SILENCE_BYTE (0x69)
+
+/// reverses the bit order. DSDIFF: the MSB is the oldest bit, DSF: the LSB is the oldest bit
+static const uint8_t gBitReverse[256] = {
+#   define R2(n)    n,     n + 2*64,     n + 1*64,     n + 3*64
+#   define R4(n) R2(n), R2(n + 2*16), R2(n + 1*16), R2(n + 3*16)
+#   define R6(n) R4(n), R4(n + 2*4 ), R4(n + 1*4 ), R4(n + 3*4 )
+    R6(0), R6(2), R6(1), R6(3)
+};
+#undef R6
+#undef R4
+#undef R2
+
+static void
+AppendLE(std::vector<uint8_t> &v, uint64_t x, int bytes)
+{
+    for (int i=0; i<bytes; ++i) {
+        v.push_back((uint8_t)(x >> (i * 8)));
+    }
+}
+
+static void
+AppendBE(std::vector<uint8_t> &v, uint64_t x, int bytes)
+{
+    for (int i=bytes-1; 0<=i; --i) {
+        v.push_back((uint8_t)(x >> (i * 8)));
+    }
+}
+
+static void
+AppendStr(std::vector<uint8_t> &v, const char *s)
+{
+    v.insert(v.end(), s, s + strlen(s));
+}
+
+/// DSF header of the DSD chunk, the fmt chunk and the data chunk header, as WWDsfWriter
+static void
+DsfHeader(int numChannels, int dsdSampleRate, int64_t dsdSamplesPerChannel, std::vector<uint8_t> &h)
+{
+    // channelType 1:mono 2:stereo 3:3ch 4:quad 6:5ch 7:5.1ch
+    static const uint32_t channelTypeOfNum[] = { 0, 1, 2, 3, 4, 6, 7 };
+    const int64_t bytesPerChannel = (dsdSamplesPerChannel + 7) / 8;
+    const int64_t blocks = (bytesPerChannel + DSF_BLOCK_BYTES - 1) / DSF_BLOCK_BYTES;
+    const uint64_t dataBytes = (uint64_t)blocks * DSF_BLOCK_BYTES * numChannels;
+
+    h.clear();
+    AppendStr(h, "DSD ");
+    AppendLE(h, 28, 8);
+    AppendLE(h, 28 + 52 + 12 + dataBytes, 8);
+    AppendLE(h, 0, 8);
+
+    AppendStr(h, "fmt ");
+    AppendLE(h, 52, 8);
+    AppendLE(h, 1, 4);
+    AppendLE(h, 0, 4);
+    AppendLE(h, channelTypeOfNum[numChannels], 4);
+    AppendLE(h, numChannels, 4);
+    AppendLE(h, dsdSampleRate, 4);
+    AppendLE(h, 1, 4);
+    AppendLE(h, (uint64_t)dsdSamplesPerChannel, 8);
+    AppendLE(h, DSF_BLOCK_BYTES, 4);
+    AppendLE(h, 0, 4);
+
+    AppendStr(h, "data");
+    AppendLE(h, 12 + dataBytes, 8);
+}
+
+/// DSDIFF header of the FRM8, FVER, PROP chunks and the DSD chunk header, as GenerateDffTestSignal
+static void
+DffHeader(int numChannels, int dsdSampleRate, int64_t dsdSamplesPerChannel, std::vector<uint8_t> &h)
+{
+    const uint64_t dataBytes = (uint64_t)((dsdSamplesPerChannel + 7) / 8) * numChannels;
+    const uint64_t fsBytes   = 4;
+    const uint64_t chnlBytes = 2 + 4 * (uint64_t)numChannels;
+    const uint64_t cmprBytes = 4 + 1 + 14 + 1;
+    const uint64_t propBytes = 4 + (12 + fsBytes) + (12 + chnlBytes) + (12 + cmprBytes);
+    const uint64_t frm8Bytes = 4 + (12 + 4) + (12 + propBytes) + (12 + dataBytes + (dataBytes & 1));
+
+    h.clear();
+    AppendStr(h, "FRM8");
+    AppendBE(h, frm8Bytes, 8);
+    AppendStr(h, "DSD ");
+
+    AppendStr(h, "FVER");
+    AppendBE(h, 4, 8);
+    AppendBE(h, 0x01050000, 4);
+
+    AppendStr(h, "PROP");
+    AppendBE(h, propBytes, 8);
+    AppendStr(h, "SND ");
+
+    AppendStr(h, "FS  ");
+    AppendBE(h, fsBytes, 8);
+    AppendBE(h, dsdSampleRate, 4);
+
+    AppendStr(h, "CHNL");
+    AppendBE(h, chnlBytes, 8);
+    AppendBE(h, numChannels, 2);
+    for (int ch=0; ch<numChannels; ++ch) {
+        if (2 == numChannels) {
+            AppendStr(h, (0 == ch) ? "SLFT" : "SRGT");
+        } else {
+            // C000 to C999
+            const std::string n = std::to_string(1000 + ch);
+            AppendStr(h, ("C" + n.substr(1)).c_str());
+        }
+    }
+
+    AppendStr(h, "CMPR");
+    AppendBE(h, cmprBytes, 8);
+    AppendStr(h, "DSD ");
+    h.push_back(14);
+    AppendStr(h, "not compressed");
+    h.push_back(0);
+
+    AppendStr(h, "DSD ");
+    AppendBE(h, dataBytes, 8);
+}
+
+class SignalFileWriter {
+public:
+    SignalFileWriter(const WWSignalGen &gen, const WWSignalFileParams &p)
+            : m_gen(gen), m_p(p), m_isDsd(WWSFF_Dsf == p.format || WWSFF_Dff == p.format), m_upsample(0),
+              m_totalBytesPerChannel(0), m_numBlocks(0), m_numSlots(0), m_nextBlock(0), m_takenBlocks(0),
+              m_modulatedBlocks(0), m_abort(false) { }
+
+    int Run(const char *path, std::function<void(int64_t, int64_t)> progress, WWSignalFileResult &r);
+
+private:
+    struct Worker {
+        std::vector<float> pcm;
+        std::vector<int32_t> ipcm;
+        std::vector<uint8_t> dsd;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Slot {
+        int64_t block;
+        std::vector<uint8_t> bytes;
+
+        /// FLAC: the smallest and the largest frame of the block
+        int minFrameBytes;
+        int maxFrameBytes;
+
+        Slot(void) : block(-1), minFrameBytes(0), maxFrameBytes(0) { }
+    };
+
+    const WWSignalGen &m_gen;
+    const WWSignalFileParams &m_p;
+    const bool m_isDsd;
+    WWFlacFrameEncoder m_flac;
+
+    /// DSD: the state of the modulator continues from a block to the next, so the blocks are modulated in order
+    WWDsdModulator m_modulator;
+
+    /// DSD: dsdSampleRate / WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE
+    int m_upsample;
+    int64_t m_totalBytesPerChannel;
+
+    int64_t m_numBlocks;
+    int m_numSlots;
+
+    /// guards the members below
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Slot> m_slots;
+    int64_t m_nextBlock;
+
+    /// blocks taken from the slots by the writer
+    int64_t m_takenBlocks;
+
+    /// DSD: signaled when m_modulatedBlocks is incremented
+    std::condition_variable m_modulateCv;
+    int64_t m_modulatedBlocks;
+
+    bool m_abort;
+
+    void WorkerThread(void);
+    int Setup(void);
+    bool EncodeBlock(Worker &w, int64_t block, Slot &s);
+    bool EncodeDsdBlock(Worker &w, int64_t block);
+};
+
+int
+SignalFileWriter::Setup(void)
+{
+    const WWSignalGenParams &g = m_gen.Params();
+
+    if (m_p.numFrames < 0 || m_p.numThreads < 1) {
+        return -1;
+    }
+
+    switch (m_p.format) {
+    case WWSFF_Wav:
+        if (m_p.isFloat ? 32 != m_p.bitsPerSample
+                : (8 != m_p.bitsPerSample && 16 != m_p.bitsPerSample && 24 != m_p.bitsPerSample
+                        && 32 != m_p.bitsPerSample)) {
+            return -1;
+        }
+        break;
+    case WWSFF_Flac:
+        if (m_p.isFloat || m_flac.Init(g.sampleRate, g.numChannels, m_p.bitsPerSample) < 0) {
+            return -1;
+        }
+        break;
+    case WWSFF_Dsf:
+    case WWSFF_Dff:
+        if (g.sampleRate != WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE
+                || (WWSFF_Dsf == m_p.format && DSF_CHANNEL_MAX < g.numChannels)) {
+            return -1;
+        }
+        if (2822400 != m_p.dsdSampleRate && 5644800 != m_p.dsdSampleRate && 11289600 != m_p.dsdSampleRate) {
+            return -1;
+        }
+        if (m_modulator.Init(m_p.modulatorOrder, g.sampleRate, m_p.dsdSampleRate, g.numChannels) < 0) {
+            return -1;
+        }
+        m_upsample = m_p.dsdSampleRate / WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE;
+        m_totalBytesPerChannel = (m_p.numFrames + 7) / 8;
+        break;
+    default:
+        return -1;
+    }
+
+    if (m_isDsd) {
+        const int64_t blockBytes = (int64_t)BLOCK_FRAMES * m_upsample / 8;
+        m_numBlocks = (m_totalBytesPerChannel + blockBytes - 1) / blockBytes;
+    } else {
+        m_numBlocks = (m_p.numFrames + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+    }
+    m_numSlots = m_p.numThreads * BLOCKS_PER_THREAD;
+    m_slots.resize(m_numSlots);
+    return 0;
+}
+
+bool
+SignalFileWriter::EncodeDsdBlock(Worker &w, int64_t block)
+{
+    const int nch = m_gen.Params().numChannels;
+    const int bytesPerFrame = m_upsample / 8;
+    const int64_t blockBytes = (int64_t)BLOCK_FRAMES * bytesPerFrame;
+    const int n = (int)std::min(blockBytes, m_totalBytesPerChannel - block * blockBytes);
+    const int frames = (n + bytesPerFrame - 1) / bytesPerFrame;
+
+    w.pcm.resize((size_t)frames * nch);
+    w.dsd.resize((size_t)frames * bytesPerFrame * nch);
+    m_gen.Generate(block * BLOCK_FRAMES, frames, &w.pcm[0]);
+
+    // the modulation of the block follows that of the previous block. the modulator runs the channel pairs
+    // on the threads of its own. the generation and the byte order of the other blocks run meanwhile
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_modulateCv.wait(lock, [this, block] { return m_abort || m_modulatedBlocks == block; });
+        if (m_abort) {
+            return false;
+        }
+    }
+    m_modulator.Process(&w.pcm[0], frames, &w.dsd[0]);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_modulatedBlocks;
+        m_modulateCv.notify_all();
+    }
+
+    // channel interleaved bytes of DSDIFF bit order
+    const uint8_t *dsd = &w.dsd[0];
+
+    if (WWSFF_Dff == m_p.format) {
+        w.bytes.assign(dsd, dsd + (size_t)n * nch);
+        if (block + 1 == m_numBlocks && (m_totalBytesPerChannel * nch) & 1) {
+            // the pad byte of the chunk
+            w.bytes.push_back(0);
+        }
+        return true;
+    }
+
+    // DSF: DSF_BLOCK_BYTES of each channel in turn, LSB first. the last block is padded with silence
+    const int dsfBlocks = (n + DSF_BLOCK_BYTES - 1) / DSF_BLOCK_BYTES;
+    w.bytes.resize((size_t)dsfBlocks * DSF_BLOCK_BYTES * nch);
+    uint8_t *to = &w.bytes[0];
+    for (int b=0; b<dsfBlocks; ++b) {
+        for (int ch=0; ch<nch; ++ch) {
+            for (int i=0; i<DSF_BLOCK_BYTES; ++i) {
+                const int pos = b * DSF_BLOCK_BYTES + i;
+                *to++ = gBitReverse[(pos < n) ? dsd[(size_t)pos * nch + ch] : DSD_SILENCE_BYTE];
+            }
+        }
+    }
+    return true;
+}
+
+bool
+SignalFileWriter::EncodeBlock(Worker &w, int64_t block, Slot &s)
+{
+    if (m_isDsd) {
+        return EncodeDsdBlock(w, block);
+    }
+
+    const int nch = m_gen.Params().numChannels;
+    const int64_t start = block * BLOCK_FRAMES;
+    const int frames = (int)std::min((int64_t)BLOCK_FRAMES, m_p.numFrames - start);
+    const int n = frames * nch;
+
+    if (WWSFF_Flac == m_p.format) {
+        w.ipcm.resize(n);
+        m_gen.GenerateInt(start, frames, m_p.bitsPerSample, &w.ipcm[0]);
+
+        w.bytes.clear();
+        s.minFrameBytes = 0;
+        s.maxFrameBytes = 0;
+        for (int i=0; i<frames; i += WW_FLAC_BLOCK_FRAMES) {
+            const size_t from = w.bytes.size();
+            const int count = std::min(WW_FLAC_BLOCK_FRAMES, frames - i);
+            m_flac.EncodeFrame((start + i) / WW_FLAC_BLOCK_FRAMES, &w.ipcm[(size_t)i * nch], count, w.bytes);
+
+            const int bytes = (int)(w.bytes.size() - from);
+            s.minFrameBytes = (0 == i) ? bytes : std::min(s.minFrameBytes, bytes);
+            s.maxFrameBytes = std::max(s.maxFrameBytes, bytes);
+        }
+        return true;
+    }
+
+    // WAV
+    const int bytesPerSample = m_p.bitsPerSample / 8;
+    w.bytes.resize((size_t)n * bytesPerSample);
+    uint8_t *to = w.bytes.empty() ? nullptr : &w.bytes[0];
+
+    if (m_p.isFloat) {
+        w.pcm.resize(n);
+        m_gen.Generate(start, frames, &w.pcm[0]);
+        for (int i=0; i<n; ++i) {
+            uint32_t u;
+            memcpy(&u, &w.pcm[i], 4);
+            to[i * 4 + 0] = (uint8_t)u;
+            to[i * 4 + 1] = (uint8_t)(u >> 8);
+            to[i * 4 + 2] = (uint8_t)(u >> 16);
+            to[i * 4 + 3] = (uint8_t)(u >> 24);
+        }
+    } else {
+        w.ipcm.resize(n);
+        m_gen.GenerateInt(start, frames, m_p.bitsPerSample, &w.ipcm[0]);
+        switch (bytesPerSample) {
+        case 1:
+            // 8bit WAV is unsigned
+            for (int i=0; i<n; ++i) {
+                to[i] = (uint8_t)(w.ipcm[i] + 128);
+            }
+            break;
+        case 2:
+            for (int i=0; i<n; ++i) {
+                to[i * 2 + 0] = (uint8_t)w.ipcm[i];
+                to[i * 2 + 1] = (uint8_t)(w.ipcm[i] >> 8);
+            }
+            break;
+        case 3:
+            for (int i=0; i<n; ++i) {
+                to[i * 3 + 0] = (uint8_t)w.ipcm[i];
+                to[i * 3 + 1] = (uint8_t)(w.ipcm[i] >> 8);
+                to[i * 3 + 2] = (uint8_t)(w.ipcm[i] >> 16);
+            }
+            break;
+        case 4:
+            for (int i=0; i<n; ++i) {
+                to[i * 4 + 0] = (uint8_t)w.ipcm[i];
+                to[i * 4 + 1] = (uint8_t)(w.ipcm[i] >> 8);
+                to[i * 4 + 2] = (uint8_t)(w.ipcm[i] >> 16);
+                to[i * 4 + 3] = (uint8_t)(w.ipcm[i] >> 24);
+            }
+            break;
+        default:
+            assert(0);
+            break;
+        }
+    }
+
+    if (start + frames == m_p.numFrames && (w.bytes.size() & 1)) {
+        // the pad byte of the data chunk
+        w.bytes.push_back(0);
+    }
+    return true;
+}
+
+void
+SignalFileWriter::WorkerThread(void)
+{
+    Worker w;
+    Slot s;
+
+    for (;;) {
+        int64_t block = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] {
+                return m_abort || m_numBlocks <= m_nextBlock || m_nextBlock < m_takenBlocks + m_numSlots;
+            });
+            if (m_abort || m_numBlocks <= m_nextBlock) {
+                return;
+            }
+            block = m_nextBlock++;
+        }
+
+        if (!EncodeBlock(w, block, s)) {
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Slot &to = m_slots[(size_t)(block % m_numSlots)];
+            assert(to.block < 0);
+            to.bytes.swap(w.bytes);
+            to.block = block;
+            to.minFrameBytes = s.minFrameBytes;
+            to.maxFrameBytes = s.maxFrameBytes;
+            m_cv.notify_all();
+        }
+    }
+}
+
+int
+SignalFileWriter::Run(const char *path, std::function<void(int64_t, int64_t)> progress, WWSignalFileResult &r)
+{
+    const WWSignalGenParams &g = m_gen.Params();
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> bytes;
+    std::vector<std::thread> threads;
+    int minFrameBytes = 0;
+    int maxFrameBytes = 0;
+    int rv = -1;
+
+    r = WWSignalFileResult();
+    if (Setup() < 0) {
+        return -1;
+    }
+
+    switch (m_p.format) {
+    case WWSFF_Wav:
+        WWWavMakeHeader(g.numChannels, g.sampleRate, m_p.bitsPerSample, m_p.isFloat, m_p.numFrames, header);
+        break;
+    case WWSFF_Flac:
+        m_flac.StreamHeader(m_p.numFrames, 0, 0, header);
+        break;
+    case WWSFF_Dsf:
+        DsfHeader(g.numChannels, m_p.dsdSampleRate, m_p.numFrames, header);
+        break;
+    case WWSFF_Dff:
+        DffHeader(g.numChannels, m_p.dsdSampleRate, m_p.numFrames, header);
+        break;
+    default:
+        assert(0);
+        break;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (nullptr == fp) {
+        return -1;
+    }
+    if (fwrite(&header[0], 1, header.size(), fp) != header.size()) {
+        goto end;
+    }
+    r.fileBytes = (int64_t)header.size();
+
+    for (int i=0; i<m_p.numThreads; ++i) {
+        threads.push_back(std::thread(&SignalFileWriter::WorkerThread, this));
+    }
+
+    for (int64_t b=0; b<m_numBlocks; ++b) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Slot &s = m_slots[(size_t)(b % m_numSlots)];
+            m_cv.wait(lock, [this, &s, b] { return m_abort || s.block == b; });
+            if (m_abort) {
+                break;
+            }
+            bytes.swap(s.bytes);
+            s.block = -1;
+            if (0 == b || s.minFrameBytes < minFrameBytes) {
+                minFrameBytes = s.minFrameBytes;
+            }
+            maxFrameBytes = std::max(maxFrameBytes, s.maxFrameBytes);
+            ++m_takenBlocks;
+            m_cv.notify_all();
+        }
+
+        if (!bytes.empty() && fwrite(&bytes[0], 1, bytes.size(), fp) != bytes.size()) {
+            break;
+        }
+        r.fileBytes += (int64_t)bytes.size();
+
+        if (progress) {
+            if (m_isDsd) {
+                progress(std::min(m_p.numFrames, (b + 1) * BLOCK_FRAMES * m_upsample), m_p.numFrames);
+            } else {
+                progress(std::min(m_p.numFrames, (b + 1) * BLOCK_FRAMES), m_p.numFrames);
+            }
+        }
+        if (b + 1 == m_numBlocks) {
+            rv = 0;
+        }
+    }
+    if (0 == m_numBlocks) {
+        rv = 0;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_abort = true;
+        m_cv.notify_all();
+        m_modulateCv.notify_all();
+    }
+    for (size_t i=0; i<threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (m_isDsd) {
+        r.unstableCount = m_modulator.UnstableCount();
+    }
+
+    if (0 == rv && WWSFF_Flac == m_p.format) {
+        // the frame sizes are known now
+        m_flac.StreamHeader(m_p.numFrames, minFrameBytes, maxFrameBytes, header);
+        if (0 != fseek(fp, 0, SEEK_SET) || fwrite(&header[0], 1, header.size(), fp) != header.size()) {
+            rv = -1;
+        }
+    }
+
+end:
+    if (0 != fclose(fp)) {
+        rv = -1;
+    }
+    return rv;
+}
+
+int
+WWSignalFileWrite(const char *path, const WWSignalGen &gen, const WWSignalFileParams &p,
+        std::function<void(int64_t, int64_t)> progress, WWSignalFileResult &r_return)
+{
+    SignalFileWriter w(gen, p);
+    return w.Run(path, progress, r_return);
+}
+
+const char *
+WWSignalFileFormatToStr(WWSignalFileFormat t)
+{
+    switch (t) {
+    case WWSFF_Wav:  return "WAV";
+    case WWSFF_Flac: return "FLAC";
+    case WWSFF_Dsf:  return "DSF";
+    case WWSFF_Dff:  return "DFF";
+    default:         return "unknown";
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "WWSignalGen.h"
+#include <stdint.h>
+#include <functional>
+
+enum WWSignalFileFormat {
+    /// RIFF WAVE. RF64 when the file is larger than 4GB
+    WWSFF_Wav,
+
+    /// FLAC of WWFlacFrameEncoder
+    WWSFF_Flac,
+
+    /// DSD stream file of the DSD sample rate
+    WWSFF_Dsf,
+
+    /// DSDIFF of the DSD sample rate
+    WWSFF_Dff,
+
+    WWSFF_NUM
+};
+
+/// the PCM sample rate of the generator of the DSD files
+#define WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE (352800)
+
+struct WWSignalFileParams {
+    WWSignalFileFormat format;
+
+    /// WAV: 8, 16, 24 or 32. FLAC: 8 to 24. not used for DSD
+    int bitsPerSample;
+
+    /// WAV: 32bit float
+    bool isFloat;
+
+    /// DSF, DFF: 2822400, 5644800 or 11289600. the generator is of WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE
+    int dsdSampleRate;
+
+    /// DSF, DFF: the order of WWDsdModulator
+    int modulatorOrder;
+
+    /// PCM: frames of the sample rate of the generator. DSD: samples per channel of the DSD sample rate
+    int64_t numFrames;
+
+    int numThreads;
+
+    WWSignalFileParams(void) : format(WWSFF_Wav), bitsPerSample(16), isFloat(false), dsdSampleRate(2822400),
+            modulatorOrder(7), numFrames(0), numThreads(1) { }
+};
+
+struct WWSignalFileResult {
+    int64_t fileBytes;
+
+    /// DSF, DFF: WWDsdModulator::UnstableCount()
+    int64_t unstableCount;
+
+    WWSignalFileResult(void) : fileBytes(0), unstableCount(0) { }
+};
+
+/// generates the signal and writes the file.
+///
+///   The file is made of the blocks of BLOCK_FRAMES frames of the generator. The threads generate and encode
+///   the blocks in parallel and the calling thread writes them in order, so the memory use is a few blocks
+///   per thread for the files of any length. The header is written first, as the size is known.
+///   DSD: the PCM of the blocks is generated in parallel and modulated in order by a modulator
+///   that runs the channel pairs in parallel, as the state of the modulator continues over the blocks.
+///   The DSD data is the same as the whole signal modulated at once.
+/// @param progress called on the calling thread with the frames written and the total frames. can be empty
+/// @return 0: success. negative: bad parameter or file error
+int WWSignalFileWrite(const char *path, const WWSignalGen &gen, const WWSignalFileParams &p,
+        std::function<void(int64_t, int64_t)> progress, WWSignalFileResult &r_return);
+
+const char *WWSignalFileFormatToStr(WWSignalFileFormat t);
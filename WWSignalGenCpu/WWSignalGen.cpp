@@ -0,0 +1,402 @@
+#include "WWSignalGen.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#  include <emmintrin.h>
+#  define WW_SIGNAL_GEN_USE_SSE
+#endif
+
+/// the phase of the sines is recomputed from the frame index every this number of frames
+#define SUBBLOCK_FRAMES (64)
+
+/// the noise is a stream of WWNoise per this number of frames
+#define NOISE_BLOCK_FRAMES (65536)
+
+/// the ladder of the float output is of this bit depth
+#define LADDER_FLOAT_BITS (24)
+
+#define TWO_PI (6.283185307179586476925)
+
+WWSignalGen::WWSignalGen(void)
+    : m_toneAmplitude(0), m_logRatio(0), m_sweepFrames(0)
+{
+}
+
+int
+WWSignalGen::Init(const WWSignalGenParams &p)
+{
+    if (p.type < 0 || WWST_NUM <= p.type || p.sampleRate <= 0 || p.numChannels <= 0
+            || !(fabs(p.amplitude) < 1.0e6)) {
+        return -1;
+    }
+
+    const double nyquist = p.sampleRate * 0.5;
+    size_t numFreqs = 0;
+    switch (p.type) {
+    case WWST_Sine:
+        numFreqs = 1;
+        break;
+    case WWST_Multitone:
+        numFreqs = p.freqs.size();
+        break;
+    case WWST_LinearSweep:
+    case WWST_LogSweep:
+        numFreqs = 2;
+        if (!(0 < p.sweepSeconds) || p.sampleRate * p.sweepSeconds < 1.0) {
+            return -1;
+        }
+        break;
+    case WWST_Noise:
+        if (p.noiseType < 0 || WWNT_NUM <= p.noiseType) {
+            return -1;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (p.freqs.size() < numFreqs || (WWST_Multitone == p.type && 0 == numFreqs)) {
+        return -1;
+    }
+    for (size_t i=0; i<numFreqs; ++i) {
+        if (!(0 <= p.freqs[i] && p.freqs[i] <= nyquist)) {
+            return -1;
+        }
+    }
+    if (WWST_LogSweep == p.type && (p.freqs[0] <= 0 || p.freqs[1] <= 0)) {
+        return -1;
+    }
+
+    m_p = p;
+    m_p.freqs.resize(numFreqs);
+
+    // Newman phases: (k^2 / 2N) cycles
+    m_phase0.assign(numFreqs, 0.0);
+    if (WWST_Multitone == p.type) {
+        for (size_t k=0; k<numFreqs; ++k) {
+            const double c = (double)k * k / (2.0 * numFreqs);
+            m_phase0[k] = c - floor(c);
+        }
+    }
+    m_toneAmplitude = (0 < numFreqs) ? p.amplitude / numFreqs : 0;
+    if (WWST_LinearSweep == p.type || WWST_LogSweep == p.type) {
+        m_toneAmplitude = p.amplitude;
+    }
+
+    m_logRatio = 0;
+    m_sweepFrames = 0;
+    if (WWST_LinearSweep == p.type || WWST_LogSweep == p.type) {
+        m_sweepFrames = (int64_t)(p.sweepSeconds * p.sampleRate + 0.5);
+        if (WWST_LogSweep == p.type) {
+            m_logRatio = log(p.freqs[1] / p.freqs[0]);
+        }
+    }
+    return 0;
+}
+
+double
+WWSignalGen::Phase(int tone, int64_t frame) const
+{
+    const double rate = m_p.sampleRate;
+    double c = 0;
+
+    switch (m_p.type) {
+    case WWST_Sine:
+    case WWST_Multitone:
+        {
+            // frame = q * rate + r. f * q is exact enough for the fractional part of days of frames
+            const double f = m_p.freqs[tone];
+            const int64_t q = frame / m_p.sampleRate;
+            const int64_t r = frame % m_p.sampleRate;
+            const double fq = f * (double)q;
+            c = (fq - floor(fq)) + f * (double)r / rate + m_phase0[tone];
+        }
+        break;
+    case WWST_LinearSweep:
+        {
+            const double T = m_p.sweepSeconds;
+            const double t = (double)(frame % m_sweepFrames) / rate;
+            c = m_p.freqs[0] * t + (m_p.freqs[1] - m_p.freqs[0]) * t * t / (2.0 * T);
+        }
+        break;
+    case WWST_LogSweep:
+        {
+            const double T = m_p.sweepSeconds;
+            const double t = (double)(frame % m_sweepFrames) / rate;
+            if (0 == m_logRatio) {
+                c = m_p.freqs[0] * t;
+            } else {
+                c = m_p.freqs[0] * T / m_logRatio * expm1(m_logRatio * t / T);
+            }
+        }
+        break;
+    default:
+        assert(0);
+        break;
+    }
+    return c - floor(c);
+}
+
+void
+WWSignalGen::GenerateMono(int64_t frame, int frames, float *to_return) const
+{
+    const double rate = m_p.sampleRate;
+
+    switch (m_p.type) {
+    case WWST_Ladder:
+        {
+            const int shift = 32 - LADDER_FLOAT_BITS;
+            const float scale = 1.0f / (float)(1 << (LADDER_FLOAT_BITS - 1));
+            for (int i=0; i<frames; ++i) {
+                const int32_t v = (int32_t)((uint32_t)(frame + i) << shift) >> shift;
+                to_return[i] = v * scale;
+            }
+        }
+        return;
+    case WWST_Silence:
+        memset(to_return, 0, sizeof(float) * frames);
+        return;
+    default:
+        break;
+    }
+
+    std::vector<double> acc(frames, 0.0);
+    const bool isSweep = WWST_LinearSweep == m_p.type || WWST_LogSweep == m_p.type;
+
+    // the sweep is a tone from freqs[0] to freqs[1]
+    const int numTones = isSweep ? 1 : (int)m_p.freqs.size();
+    for (int tone=0; tone<numTones; ++tone) {
+        int i = 0;
+        while (i < frames) {
+            const int64_t f = frame + i;
+            int n = std::min(SUBBLOCK_FRAMES, frames - i);
+
+            // the phase of the subblock is the polynomial c0 + c1 k + c2 k^2 + c3 k^3 of the frame k.
+            // c1, c2, c3 are of the frequency and its derivatives in Hz, Hz/s and Hz/s^2
+            double freq = m_p.freqs[tone];
+            double d1 = 0;
+            double d2 = 0;
+            if (isSweep) {
+                const int64_t pos = f % m_sweepFrames;
+                const double T = m_p.sweepSeconds;
+                const double t = pos / rate;
+                n = (int)std::min((int64_t)n, m_sweepFrames - pos);
+                if (WWST_LinearSweep == m_p.type) {
+                    freq = m_p.freqs[0] + (m_p.freqs[1] - m_p.freqs[0]) * t / T;
+                    d1 = (m_p.freqs[1] - m_p.freqs[0]) / T;
+                } else {
+                    const double a = m_logRatio / T;
+                    freq = m_p.freqs[0] * exp(a * t);
+                    d1 = freq * a;
+                    d2 = freq * a * a;
+                }
+            }
+            const double c1 = freq / rate;
+            const double c2 = d1 / (2.0 * rate * rate);
+            const double c3 = d2 / (6.0 * rate * rate * rate);
+
+            // z: e^{2 pi i phase(k)}, r: the rotation to the next frame, q: the rotation of r, w: the rotation of q
+            const double p0 = TWO_PI * Phase(tone, f);
+            double zr = cos(p0);
+            double zi = sin(p0);
+            const double a = m_toneAmplitude;
+            double *out = &acc[i];
+            if (!isSweep) {
+                const double rr = cos(TWO_PI * c1);
+                const double ri = sin(TWO_PI * c1);
+                for (int k=0; k<n; ++k) {
+                    out[k] += a * zi;
+                    const double t = zr * rr - zi * ri;
+                    zi = zr * ri + zi * rr;
+                    zr = t;
+                }
+            } else {
+                const double pr = TWO_PI * (c1 + c2 + c3);
+                const double pq = TWO_PI * (2.0 * c2 + 6.0 * c3);
+                const double pw = TWO_PI * (6.0 * c3);
+                double rr = cos(pr);
+                double ri = sin(pr);
+                double qr = cos(pq);
+                double qi = sin(pq);
+                const double wr = cos(pw);
+                const double wi = sin(pw);
+                for (int k=0; k<n; ++k) {
+                    out[k] += a * zi;
+                    double t = zr * rr - zi * ri;
+                    zi = zr * ri + zi * rr;
+                    zr = t;
+                    t = rr * qr - ri * qi;
+                    ri = rr * qi + ri * qr;
+                    rr = t;
+                    t = qr * wr - qi * wi;
+                    qi = qr * wi + qi * wr;
+                    qr = t;
+                }
+            }
+            i += n;
+        }
+    }
+
+    for (int i=0; i<frames; ++i) {
+        to_return[i] = (float)acc[i];
+    }
+}
+
+void
+WWSignalGen::GenerateNoise(int64_t frame, int frames, float *to_return) const
+{
+    const int nch = m_p.numChannels;
+    std::vector<float> skip;
+    WWNoise noise;
+
+    while (0 < frames) {
+        const int64_t block = frame / NOISE_BLOCK_FRAMES;
+        const int offset = (int)(frame % NOISE_BLOCK_FRAMES);
+        const int n = std::min(frames, NOISE_BLOCK_FRAMES - offset);
+
+        noise.Init(m_p.noiseType, nch, (float)m_p.amplitude, m_p.seed, (uint32_t)(block + 1));
+        if (0 < offset) {
+            // the frames of the block before the range
+            skip.resize((size_t)offset * nch);
+            noise.Generate(&skip[0], offset);
+        }
+        noise.Generate(to_return, n);
+
+        to_return += (size_t)n * nch;
+        frame += n;
+        frames -= n;
+    }
+}
+
+void
+WWSignalGen::Generate(int64_t frame, int frames, float *to_return) const
+{
+    const int nch = m_p.numChannels;
+
+    if (frame < 0) {
+        const int n = (int)std::min((int64_t)frames, -frame);
+        memset(to_return, 0, sizeof(float) * n * nch);
+        to_return += (size_t)n * nch;
+        frame += n;
+        frames -= n;
+    }
+    if (frames <= 0) {
+        return;
+    }
+
+    if (WWST_Noise == m_p.type) {
+        GenerateNoise(frame, frames, to_return);
+        return;
+    }
+
+    if (1 == nch) {
+        GenerateMono(frame, frames, to_return);
+        return;
+    }
+
+    std::vector<float> mono(frames);
+    GenerateMono(frame, frames, &mono[0]);
+    for (int i=0; i<frames; ++i) {
+        for (int ch=0; ch<nch; ++ch) {
+            to_return[(size_t)i * nch + ch] = mono[i];
+        }
+    }
+}
+
+/// rounded to the nearest and clipped to [-2^(bits-1), 2^(bits-1)-1]
+static void
+Quantize(const float *from, int n, int bits, int32_t *to)
+{
+    int i = 0;
+    if (bits <= 24) {
+        const float scale = (float)(1 << (bits - 1));
+        const float lo = -scale;
+        const float hi = scale - 1.0f;
+#ifdef WW_SIGNAL_GEN_USE_SSE
+        const __m128 vScale = _mm_set1_ps(scale);
+        const __m128 vLo = _mm_set1_ps(lo);
+        const __m128 vHi = _mm_set1_ps(hi);
+        for (; i + 4 <= n; i += 4) {
+            const __m128 x = _mm_mul_ps(_mm_loadu_ps(&from[i]), vScale);
+            _mm_storeu_si128((__m128i *)&to[i], _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, vLo), vHi)));
+        }
+#endif
+        for (; i < n; ++i) {
+            to[i] = (int32_t)lrintf(std::min(std::max(from[i] * scale, lo), hi));
+        }
+        return;
+    }
+
+    const double scale = (double)(1LL << (bits - 1));
+    for (; i < n; ++i) {
+        to[i] = (int32_t)llrint(std::min(std::max(from[i] * scale, -scale), scale - 1.0));
+    }
+}
+
+void
+WWSignalGen::GenerateInt(int64_t frame, int frames, int bits, int32_t *to_return) const
+{
+    assert(8 <= bits && bits <= 32);
+    const int nch = m_p.numChannels;
+
+    if (WWST_Ladder == m_p.type) {
+        const int shift = 32 - bits;
+        for (int i=0; i<frames; ++i) {
+            // frames of negative indices are silence
+            const int32_t v = (frame + i < 0) ? 0 : (int32_t)((uint32_t)(frame + i) << shift) >> shift;
+            for (int ch=0; ch<nch; ++ch) {
+                to_return[(size_t)i * nch + ch] = v;
+            }
+        }
+        return;
+    }
+
+    if (WWST_Noise == m_p.type || 1 == nch || frame < 0) {
+        std::vector<float> f((size_t)frames * nch);
+        Generate(frame, frames, &f[0]);
+        Quantize(&f[0], frames * nch, bits, to_return);
+        return;
+    }
+
+    // the channels are the same: quantized once
+    std::vector<float> mono(frames);
+    std::vector<int32_t> q(frames);
+    GenerateMono(frame, frames, &mono[0]);
+    Quantize(&mono[0], frames, bits, &q[0]);
+    for (int i=0; i<frames; ++i) {
+        for (int ch=0; ch<nch; ++ch) {
+            to_return[(size_t)i * nch + ch] = q[i];
+        }
+    }
+}
+
+const char *
+WWSignalTypeToStr(WWSignalType t)
+{
+    switch (t) {
+    case WWST_Sine:        return "sine";
+    case WWST_Multitone:   return "multitone";
+    case WWST_LinearSweep: return "sweep";
+    case WWST_LogSweep:    return "logsweep";
+    case WWST_Ladder:      return "ladder";
+    case WWST_Silence:     return "silence";
+    case WWST_Noise:       return "noise";
+    default:               return "unknown";
+    }
+}
+
+const char *
+WWNoiseTypeToStr(WWNoiseType t)
+{
+    switch (t) {
+    case WWNT_Uniform:      return "uniform";
+    case WWNT_Tpdf:         return "tpdf";
+    case WWNT_TpdfHighPass: return "tpdfhp";
+    case WWNT_Gaussian:     return "gaussian";
+    case WWNT_Pink:         return "pink";
+    default:                return "unknown";
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "WWNoise.h"
+#include <stdint.h>
+#include <vector>
+
+enum WWSignalType {
+    /// sine of freqs[0]
+    WWST_Sine,
+
+    /// sum of the sines of freqs of the equal amplitudes. Newman phases keep the crest factor low
+    WWST_Multitone,
+
+    /// sine sweep from freqs[0] to freqs[1] in sweepSeconds, repeated. the frequency changes linearly
+    WWST_LinearSweep,
+
+    /// sine sweep from freqs[0] to freqs[1] in sweepSeconds, repeated. the frequency changes exponentially
+    WWST_LogSweep,
+
+    /// the sample value is the frame index wrapped to the bit depth, as CreateLadderWav
+    WWST_Ladder,
+
+    WWST_Silence,
+
+    /// WWNoise of noiseType. the channels are independent
+    WWST_Noise,
+
+    WWST_NUM
+};
+
+struct WWSignalGenParams {
+    WWSignalType type;
+
+    /// Hz
+    std::vector<double> freqs;
+
+    /// the period of the sweep. 0: the sweep is not repeated
+    double sweepSeconds;
+
+    /// full scale is 1.0. the peak of the sines, the amplitude of WWNoise for the noise
+    double amplitude;
+
+    WWNoiseType noiseType;
+    uint32_t seed;
+
+    int sampleRate;
+    int numChannels;
+
+    WWSignalGenParams(void) : type(WWST_Sine), sweepSeconds(0), amplitude(0.5), noiseType(WWNT_Gaussian), seed(5489),
+            sampleRate(44100), numChannels(2) { }
+};
+
+/// Test signal generator.
+///
+///   The samples are a function of the frame index: any range of frames is generated independently of the others,
+///   so the blocks of a file are generated by the threads in parallel and are the same as generated in order.
+///   The sines are computed by complex rotation in double precision, and the phase is recomputed
+///   from the frame index every SUBBLOCK_FRAMES frames.
+///   The noise is generated in blocks of NOISE_BLOCK_FRAMES frames and each block is a stream of WWNoise.
+///   All channels have the same sample values except the noise.
+class WWSignalGen {
+public:
+    WWSignalGen(void);
+
+    /// @return 0: success. negative: bad parameter
+    int Init(const WWSignalGenParams &p);
+
+    const WWSignalGenParams &Params(void) const { return m_p; }
+
+    /// the samples of the frames [frame, frame + frames). thread safe.
+    /// the frames of negative indices are silence
+    /// @param to_return frames * numChannels floats, channel interleaved
+    void Generate(int64_t frame, int frames, float *to_return) const;
+
+    /// the samples quantized to the integers of bits: the full scale is 2^(bits-1). rounded to the nearest and clipped.
+    /// the ladder is the integer steps of bits. thread safe
+    /// @param bits 8 to 32. the precision of the signals other than the ladder is 24bit
+    /// @param to_return frames * numChannels integers, channel interleaved
+    void GenerateInt(int64_t frame, int frames, int bits, int32_t *to_return) const;
+
+private:
+    WWSignalGenParams m_p;
+
+    /// phase of the sines at the frame 0 in cycles
+    std::vector<double> m_phase0;
+
+    /// the peak of each sine
+    double m_toneAmplitude;
+
+    /// WWST_LogSweep: ln(freqs[1] / freqs[0])
+    double m_logRatio;
+
+    /// sweep period in frames
+    int64_t m_sweepFrames;
+
+    /// the phase of the tone of frame in cycles, the integer part removed
+    double Phase(int tone, int64_t frame) const;
+
+    void GenerateMono(int64_t frame, int frames, float *to_return) const;
+    void GenerateNoise(int64_t frame, int frames, float *to_return) const;
+};
+
+const char *WWSignalTypeToStr(WWSignalType t);
+const char *WWNoiseTypeToStr(WWNoiseType t);
@@ -0,0 +1,220 @@
+// Generates test signals of PCM and DSD to WAV, FLAC, DSF and DFF files.
+// The blocks of the file are generated by the threads in parallel and streamed to the file.
+// Portable C++: builds on Windows and Linux.
+
+#include "WWSignalGen.h"
+#include "WWSignalFile.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void
+PrintUsage(const char *name)
+{
+    printf("usage: %s [options] output\n"
+        "  output is .wav, .flac, .dsf or .dff\n"
+        "  -signal s         sine, multitone, sweep, logsweep, ladder, silence or noise. default: sine\n"
+        "  -freq f[,f...]    Hz. sine: the frequency, default: 1000. multitone: the frequencies.\n"
+        "                    sweep, logsweep: the start and the end, default: 20,20000\n"
+        "  -sweep s          the period of the sweep in seconds. default: the duration\n"
+        "  -noise n          uniform, tpdf, tpdfhp, gaussian or pink. default: gaussian\n"
+        "  -level dB         the peak of the sines, the amplitude of the noise. 0 is full scale. default: -6.02\n"
+        "                    DSD: 0dB is 50%% modulation\n"
+        "  -rate n           sample rate. default: 44100. DSD: 2822400, 5644800 or 11289600, default: 2822400\n"
+        "  -bits n           WAV: 8, 16, 24 or 32. FLAC: 8 to 24. default: 16\n"
+        "  -float            WAV: 32bit float\n"
+        "  -ch n             channels. default: 2\n"
+        "  -seconds s        duration. default: 60\n"
+        "  -order n          DSD modulator order 5, 6 or 7. default: 7\n"
+        "  -seed n           seed of the noise. default: 5489\n"
+        "  -threads n        default: the number of the logical processors\n",
+        name);
+}
+
+static bool
+SplitDoubles(const char *s, std::vector<double> &v_return)
+{
+    v_return.clear();
+    std::string str(s);
+    size_t from = 0;
+    for (;;) {
+        const size_t comma = str.find(',', from);
+        const std::string token = str.substr(from, (comma == std::string::npos) ? std::string::npos : comma - from);
+        char *end = nullptr;
+        const double v = strtod(token.c_str(), &end);
+        if (token.empty() || *end != '\0') {
+            return false;
+        }
+        v_return.push_back(v);
+        if (comma == std::string::npos) {
+            return true;
+        }
+        from = comma + 1;
+    }
+}
+
+static int
+NameToIndex(const char *s, const char * const *names, int numNames)
+{
+    for (int i=0; i<numNames; ++i) {
+        if (0 == strcmp(s, names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// the format of the file extension
+static bool
+PathToFormat(const char *path, WWSignalFileFormat &f_return)
+{
+    static const char * const exts[] = { ".wav", ".flac", ".dsf", ".dff" };
+    std::string s(path);
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    for (int i=0; i<WWSFF_NUM; ++i) {
+        const size_t n = strlen(exts[i]);
+        if (n < s.size() && 0 == s.compare(s.size() - n, n, exts[i])) {
+            f_return = (WWSignalFileFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char * const signalNames[] = {
+        "sine", "multitone", "sweep", "logsweep", "ladder", "silence", "noise" };
+    static const char * const noiseNames[] = { "uniform", "tpdf", "tpdfhp", "gaussian", "pink" };
+
+    WWSignalGenParams g;
+    WWSignalFileParams f;
+    double levelDb = -6.02;
+    double seconds = 60.0;
+    int rate = 0;
+    const char *path = nullptr;
+
+    f.numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for (int i=1; i<argc; ++i) {
+        const bool hasArg = i + 1 < argc;
+        bool ok = true;
+        if (0 == strcmp("-signal", argv[i]) && hasArg) {
+            const int t = NameToIndex(argv[++i], signalNames, WWST_NUM);
+            g.type = (WWSignalType)t;
+            ok = 0 <= t;
+        } else if (0 == strcmp("-freq", argv[i]) && hasArg) {
+            ok = SplitDoubles(argv[++i], g.freqs);
+        } else if (0 == strcmp("-sweep", argv[i]) && hasArg) {
+            g.sweepSeconds = atof(argv[++i]);
+        } else if (0 == strcmp("-noise", argv[i]) && hasArg) {
+            const int t = NameToIndex(argv[++i], noiseNames, WWNT_NUM);
+            g.noiseType = (WWNoiseType)t;
+            ok = 0 <= t;
+        } else if (0 == strcmp("-level", argv[i]) && hasArg) {
+            levelDb = atof(argv[++i]);
+        } else if (0 == strcmp("-rate", argv[i]) && hasArg) {
+            rate = atoi(argv[++i]);
+        } else if (0 == strcmp("-bits", argv[i]) && hasArg) {
+            f.bitsPerSample = atoi(argv[++i]);
+        } else if (0 == strcmp("-float", argv[i])) {
+            f.isFloat = true;
+            f.bitsPerSample = 32;
+        } else if (0 == strcmp("-ch", argv[i]) && hasArg) {
+            g.numChannels = atoi(argv[++i]);
+        } else if (0 == strcmp("-seconds", argv[i]) && hasArg) {
+            seconds = atof(argv[++i]);
+        } else if (0 == strcmp("-order", argv[i]) && hasArg) {
+            f.modulatorOrder = atoi(argv[++i]);
+        } else if (0 == strcmp("-seed", argv[i]) && hasArg) {
+            g.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (0 == strcmp("-threads", argv[i]) && hasArg) {
+            f.numThreads = atoi(argv[++i]);
+        } else if ('-' != argv[i][0] && nullptr == path) {
+            path = argv[i];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (nullptr == path || !PathToFormat(path, f.format) || !(0 <= seconds)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const bool isDsd = WWSFF_Dsf == f.format || WWSFF_Dff == f.format;
+    if (isDsd) {
+        f.dsdSampleRate = (0 == rate) ? 2822400 : rate;
+        g.sampleRate = WW_SIGNAL_FILE_DSD_PCM_SAMPLE_RATE;
+        f.numFrames = (int64_t)(seconds * f.dsdSampleRate + 0.5);
+    } else {
+        g.sampleRate = (0 == rate) ? 44100 : rate;
+        f.numFrames = (int64_t)(seconds * g.sampleRate + 0.5);
+    }
+
+    if (g.freqs.empty()) {
+        if (WWST_Sine == g.type) {
+            g.freqs.push_back(1000.0);
+        } else if (WWST_LinearSweep == g.type || WWST_LogSweep == g.type) {
+            g.freqs.push_back(20.0);
+            g.freqs.push_back(20000.0);
+        }
+    }
+    if (0 == g.sweepSeconds) {
+        g.sweepSeconds = seconds;
+    }
+    g.amplitude = pow(10.0, levelDb / 20.0);
+
+    WWSignalGen gen;
+    if (gen.Init(g) < 0) {
+        printf("Error: bad signal parameters. the frequencies are 0 to the Nyquist frequency\n");
+        return 1;
+    }
+
+    if (isDsd) {
+        printf("%s %s, %d Hz %d ch, %g seconds, %d threads\n", WWSignalFileFormatToStr(f.format),
+            WWSignalTypeToStr(g.type), f.dsdSampleRate, g.numChannels, seconds, f.numThreads);
+    } else {
+        printf("%s %s, %d Hz %d ch %d bit%s, %g seconds, %d threads\n", WWSignalFileFormatToStr(f.format),
+            WWSignalTypeToStr(g.type), g.sampleRate, g.numChannels, f.bitsPerSample, f.isFloat ? " float" : "",
+            seconds, f.numThreads);
+    }
+    fflush(stdout);
+
+    const auto start = std::chrono::steady_clock::now();
+    auto lastPrint = start;
+    WWSignalFileResult r;
+    int rv = WWSignalFileWrite(path, gen, f, [&lastPrint](int64_t done, int64_t total) {
+        const auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - lastPrint).count() < 1.0 && done < total) {
+            return;
+        }
+        lastPrint = now;
+        fprintf(stderr, "\r%5.1f%%", (0 < total) ? 100.0 * done / total : 100.0);
+        fflush(stderr);
+    }, r);
+    fprintf(stderr, "\n");
+    if (rv < 0) {
+        printf("Error: failed to write %s. check the format parameters and the disk space\n", path);
+        return 1;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %lld bytes in %.2f seconds, %.1f MB/s, %.1f x realtime\n", path, (long long)r.fileBytes, elapsed,
+        r.fileBytes / elapsed * 1.0e-6, seconds / elapsed);
+    if (0 < r.unstableCount) {
+        printf("modulator unstable count: %lld. lower the level\n", (long long)r.unstableCount);
+    }
+    return 0;
+}
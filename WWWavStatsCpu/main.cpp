@@ -0,0 +1,122 @@
+// Sample value statistics and histogram of WAV files. Portable C++: builds on Windows and Linux.
+// Production version of 00Experiments/wavhistogram: the file is memory mapped and measured by worker threads.
+
+#include "WWWavStats.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+/// default histogram resolution. 24 is the full resolution of 24bit files and takes 64MB per channel and per worker
+#define DEFAULT_HISTOGRAM_BITS (16)
+
+static void
+PrintStats(const WWWavStats &s, const char *path, double elapsed)
+{
+    const WWWavStatsFormat &f = s.format;
+
+    printf("%s\n", path);
+    printf("  %dHz %dch %dbit %s", f.sampleRate, f.numChannels, f.bitsPerSample, f.isFloat ? "float" : "int");
+    if (f.validBitsPerSample != f.bitsPerSample) {
+        printf(" (valid %dbit)", f.validBitsPerSample);
+    }
+    printf(", %lld frames, %.3fs (%.1f MB/s)\n",
+        (long long)f.NumFrames(), elapsed, (0 < elapsed) ? f.dataBytes / elapsed / 1000000.0 : 0.0);
+
+    printf("   ch            min            max      dcOffset           rms  bits    clipped   clipRuns    longest");
+    if (f.isFloat) {
+        printf("    offGrid");
+    }
+    printf("\n");
+
+    for (size_t ch=0; ch<s.channels.size(); ++ch) {
+        const WWWavStatsChannel &c = s.channels[ch];
+        printf("  %3d %14.6g %14.6g %13.6g %13.6g %5d %10lld %10lld %10lld",
+            (int)ch, c.minValue, c.maxValue, c.dcOffset, c.rms, c.usedBits,
+            (long long)c.clippedSamples, (long long)c.clipRuns, (long long)c.longestClipRun);
+        if (f.isFloat) {
+            printf(" %10lld", (long long)c.offGridSamples);
+        }
+        printf("\n");
+    }
+}
+
+/// prints value, count and ratio of each bin. a run of bins of the same count is printed as its first and last bins
+static void
+PrintHistogram(const WWWavStats &s)
+{
+    const int bins = 1 << s.histogramBits;
+
+    for (size_t ch=0; ch<s.channels.size(); ++ch) {
+        const WWWavStatsChannel &c = s.channels[ch];
+        const double total = (double)std::max(c.numSamples, (int64_t)1);
+
+        printf("histogram ch%d\n", (int)ch);
+        for (int i=0; i<bins; ++i) {
+            const uint64_t n = c.histogram[i];
+            if (0 < i && n == c.histogram[i - 1] && i != bins - 1 && n == c.histogram[i + 1]) {
+                continue;
+            }
+            printf("%14.8g %12llu %f\n",
+                WWWavStatsHistogramBinValue(s.format, s.histogramBits, i), (unsigned long long)n, n / total);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *programName = argv[0];
+
+    WWWavStatsParams p;
+    p.histogramBits = DEFAULT_HISTOGRAM_BITS;
+
+    int i = 1;
+    for (; i + 1 < argc && '-' == argv[i][0]; i += 2) {
+        if (0 == strcmp(argv[i], "-threads")) {
+            p.numThreads = atoi(argv[i + 1]);
+        } else if (0 == strcmp(argv[i], "-histbits")) {
+            p.histogramBits = atoi(argv[i + 1]);
+        } else if (0 == strcmp(argv[i], "-cliprun")) {
+            p.clipRunMinLength = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+
+    if (argc <= i || p.numThreads < 0 || p.histogramBits < 0 || 24 < p.histogramBits || p.clipRunMinLength < 1) {
+        printf("Usage:\n"
+            " %s [-threads n] [-histbits n] [-cliprun n] wavFile...\n"
+            "     prints min, max, DC offset, RMS, significant bits and clipping of each channel and the histogram\n"
+            "     of the sample values. 8, 16, 24 and 32bit integer and 32bit float WAV and RF64\n"
+            " -threads n : worker threads of each file. default is the number of the hardware threads\n"
+            " -histbits n : the histogram has 2^n bins. 0 prints no histogram. default is %d\n"
+            " -cliprun n : n or more consecutive full scale samples are counted as a clipping run. default is 3\n",
+            programName, DEFAULT_HISTOGRAM_BITS);
+        return 1;
+    }
+
+    int result = 0;
+    for (; i<argc; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+
+        WWWavStats s;
+        if (WWWavStatsAnalyzeFile(argv[i], p, s) < 0) {
+            printf("Error: could not read %s\n", argv[i]);
+            result = 1;
+            continue;
+        }
+
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        PrintStats(s, argv[i], elapsed);
+        if (0 < s.histogramBits) {
+            PrintHistogram(s);
+        }
+    }
+
+    return result;
+}
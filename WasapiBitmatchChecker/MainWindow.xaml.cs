@@ -37,6 +37,7 @@ namespace WasapiBitmatchChecker {
         private static int NUM_PROLOGUE_FRAMES = 262144;
         private int mNumTestFrames = 1024 * 1024;
         private static int NUM_CHANNELS = 2;
+        private static int MAX_MISMATCHED_RANGES = 16;
         private int mSampleRate;
         private WasapiCS.SampleFormatType mPlaySampleFormat;
         private WasapiCS.SampleFormatType mRecSampleFormat;
@@ -690,34 +691,45 @@ namespace WasapiBitmatchChecker {
                 System.Diagnostics.Debug.Assert(false);
                 break;
             }
-            if (compareStartFrame < 0) {
+            // 開始合図が無いときは送信データと受信データのずれを相互相関で探す
+            bool findLag = compareStartFrame < 0;
+            if (!findLag) {
+                compareStartFrame += (int)mPcmReady.NumFrames;
+            }
+
+            // 送信データmPcmTestと受信データmCapturedPcmDataを比較
+            var r = WasapiCS.BitmatchCompare(mPcmTest.GetSampleArray(), mPlaySampleFormat,
+                    mCapturedPcmData, mCapturedPcmData.Length, mRecSampleFormat, NUM_CHANNELS,
+                    findLag, compareStartFrame, MAX_MISMATCHED_RANGES);
+            if (r == null) {
                 textBoxLog.Text += Properties.Resources.msgCompareStartNotFound;
                 textBoxLog.ScrollToEnd();
                 return;
             }
+            if (findLag) {
+                textBoxLog.Text += string.Format(Properties.Resources.msgCompareAlignedByCorrelation, r.Lag, r.Correlation);
+            }
 
-            compareStartFrame += (int)mPcmReady.NumFrames;
-
-            if (mPcmRecorded.NumFrames - compareStartFrame < mNumTestFrames) {
+            if (r.ComparedFromFrame != 0 || r.ComparedToFrame < mNumTestFrames) {
                 textBoxLog.Text += Properties.Resources.msgCompareCaptureTooSmall;
                 textBoxLog.ScrollToEnd();
                 return;
             }
 
-            // 送信データmPcmTestと受信データmPcmRecordedを比較
             int numTestBytes = mNumTestFrames * NUM_CHANNELS
                 * (WasapiCS.SampleFormatTypeToValidBitsPerSample(mRecSampleFormat) / 8);
 
-            for (int pos=0; pos < mNumTestFrames; ++pos) {
-                for (int ch=0; ch<NUM_CHANNELS; ++ch) {
-                    if (mPcmTest.GetSampleValueInInt32(ch, pos)
-                            != mPcmRecorded.GetSampleValueInInt32(ch, pos + compareStartFrame)) {
-                        textBoxLog.Text += string.Format(Properties.Resources.msgCompareDifferent,
-                                numTestBytes / 1024 / 1024, numTestBytes * 8L / 1000 / 1000, mNumTestFrames / mSampleRate);
-                        textBoxLog.ScrollToEnd();
-                        return;
-                    }
+            if (0 < r.MismatchedSamples) {
+                textBoxLog.Text += string.Format(Properties.Resources.msgCompareDifferent,
+                        numTestBytes / 1024 / 1024, numTestBytes * 8L / 1000 / 1000, mNumTestFrames / mSampleRate);
+                textBoxLog.Text += string.Format(Properties.Resources.msgCompareMismatchSummary,
+                        r.MismatchedSamples, r.MismatchedFrames, r.NumRanges);
+                foreach (var range in r.Ranges) {
+                    textBoxLog.Text += string.Format(Properties.Resources.msgCompareMismatchedRange,
+                            range.FromFrame, range.ToFrame - 1, range.MismatchedSamples);
                 }
+                textBoxLog.ScrollToEnd();
+                return;
             }
 
             textBoxLog.Text += string.Format(Properties.Resources.msgCompareIdentical,
@@ -186,6 +186,16 @@ namespace WasapiBitmatchChecker.Properties {
             }
         }
         
+        /// <summary>
+        ///   Test start marker was not found. Captured PCM was aligned by cross-correlation: lag = {0} frames, correlation = {1:F4}
+        /// に類似しているローカライズされた文字列を検索します。
+        /// </summary>
+        internal static string msgCompareAlignedByCorrelation {
+            get {
+                return ResourceManager.GetString("msgCompareAlignedByCorrelation", resourceCulture);
+            }
+        }
+        
         /// <summary>
         ///   Error. Captured data size was not sufficient to analyze.
         /// に類似しているローカライズされた文字列を検索します。
@@ -218,6 +228,26 @@ namespace WasapiBitmatchChecker.Properties {
             }
         }
         
+        /// <summary>
+        ///       frame {0} to {1}: {2} samples
+        /// に類似しているローカライズされた文字列を検索します。
+        /// </summary>
+        internal static string msgCompareMismatchedRange {
+            get {
+                return ResourceManager.GetString("msgCompareMismatchedRange", resourceCulture);
+            }
+        }
+        
+        /// <summary>
+        ///     {0} samples in {1} frames were different, in {2} ranges
+        /// に類似しているローカライズされた文字列を検索します。
+        /// </summary>
+        internal static string msgCompareMismatchSummary {
+            get {
+                return ResourceManager.GetString("msgCompareMismatchSummary", resourceCulture);
+            }
+        }
+        
         /// <summary>
         ///   PCM data received. Now comparing recorded PCM with sent PCM...
         /// に類似しているローカライズされた文字列を検索します。
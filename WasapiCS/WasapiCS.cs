@@ -99,6 +99,73 @@ namespace Wasapi {
         private extern static void
         WasapiIO_ScalePcmAmplitude(int instanceId, double scale);
 
+        public const int AUDIO_TAP_MAX_CHANNELS = 8;
+        public const int AUDIO_TAP_SPECTRUM_BINS = 1025;
+
+        [StructLayout(LayoutKind.Sequential, Pack = 8)]
+        internal struct WasapiIoAudioTapSnapshot {
+            public long serial;
+            public long totalFrames;
+            public long droppedFrames;
+            public int sampleRate;
+            public int numChannels;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = AUDIO_TAP_MAX_CHANNELS)]
+            public float[] rms;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = AUDIO_TAP_MAX_CHANNELS)]
+            public float[] peak;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = AUDIO_TAP_SPECTRUM_BINS)]
+            public float[] spectrumDb;
+        };
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static void
+        WasapiIO_SetAudioTapEnabled(int instanceId, bool enabled);
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static bool
+        WasapiIO_GetAudioTapSnapshot(int instanceId, out WasapiIoAudioTapSnapshot snapshot);
+
+        [StructLayout(LayoutKind.Sequential, Pack = 8)]
+        internal struct WasapiIoLoudness {
+            public int pcmDataId;
+            public int valid;
+            public double integratedLufs;
+            public double rangeLu;
+            public double truePeak;
+            public double samplePeak;
+            public double replayGainDb;
+        };
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static int
+        WasapiIO_ScanPcmLoudness(int instanceId, int numThreads, [In, Out] WasapiIoLoudness[] tracks, int tracksCount,
+            out WasapiIoLoudness album);
+
+        [StructLayout(LayoutKind.Sequential, Pack = 8)]
+        internal struct WasapiIoBitmatchRange {
+            public long fromFrame;
+            public long toFrame;
+            public long mismatchedSamples;
+        };
+
+        [StructLayout(LayoutKind.Sequential, Pack = 8)]
+        internal struct WasapiIoBitmatchResult {
+            public long lag;
+            public double correlation;
+            public long comparedFromFrame;
+            public long comparedToFrame;
+            public long mismatchedFrames;
+            public long mismatchedSamples;
+            public long numRanges;
+        };
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static int
+        WasapiIO_BitmatchCompare(byte[] refData, long refBytes, int refSampleFormat,
+            byte[] capData, long capBytes, int capSampleFormat, int numChannels,
+            bool findLag, long lag, [In, Out] WasapiIoBitmatchRange[] ranges, int rangesCount,
+            out WasapiIoBitmatchResult result);
+
         [DllImport("WasapiIODLL.dll")]
         private extern static void
         WasapiIO_ClearPlayList(int instanceId);
@@ -210,10 +277,26 @@ namespace Wasapi {
         private extern static void
         WasapiIO_AppendAudioFilter(int instanceId, int audioFilterType, string args);
 
+        [DllImport("WasapiIODLL.dll", CharSet = CharSet.Unicode)]
+        private extern static bool
+        WasapiIO_UpdateAudioFilter(int instanceId, int idx, string args);
+
         [DllImport("WasapiIODLL.dll")]
         private extern static void
         WasapiIO_ClearAudioFilter(int instanceId);
 
+        [DllImport("WasapiIODLL.dll")]
+        private extern static void
+        WasapiIO_BeginAudioFilterChain(int instanceId);
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static void
+        WasapiIO_CommitAudioFilterChain(int instanceId, int crossfadeMs);
+
+        [DllImport("WasapiIODLL.dll")]
+        private extern static void
+        WasapiIO_SetAudioFilterQuantizer(int instanceId, int quantizerType);
+
         public enum MMCSSCallType {
             Disable,
             Enable,
@@ -280,6 +363,20 @@ namespace Wasapi {
         public enum WWAudioFilterType {
             PolarityInvert,
             Monaural,
+            ChannelRouting,
+            Crossfeed,
+            ParametricEq,
+            Convolution,
+        };
+
+        /// <summary>
+        /// WWQuantizer.hのWWQuantizerTypeと同じ順番で並べる
+        /// </summary>
+        public enum WWQuantizerType {
+            None,
+            Tpdf,
+            NoiseShaping2,
+            NoiseShaping4,
         };
 
         /// <summary>
@@ -527,6 +624,205 @@ namespace Wasapi {
             WasapiIO_ScalePcmAmplitude(mId, scale);
         }
 
+        public class AudioTapSnapshot {
+            /// <summary>
+            /// 解析の通し番号。前回と同じときは新しい解析結果が無い。
+            /// </summary>
+            public long Serial { get; set; }
+            public long TotalFrames { get; set; }
+
+            /// <summary>
+            /// 解析スレッドが間に合わずに解析しなかったフレーム数。
+            /// </summary>
+            public long DroppedFrames { get; set; }
+            public int SampleRate { get; set; }
+
+            /// <summary>
+            /// 前回の解析以降のチャンネル毎のRMSとピーク。フルスケールが1.0。
+            /// </summary>
+            public float[] Rms { get; set; }
+            public float[] Peak { get; set; }
+
+            /// <summary>
+            /// 全チャンネルの平均のスペクトル (dB)。フルスケールの正弦波が0dB。
+            /// i番目のビンの周波数は i * SampleRate / ((SpectrumDb.Length - 1) * 2)。
+            /// </summary>
+            public float[] SpectrumDb { get; set; }
+
+            internal AudioTapSnapshot(WasapiIoAudioTapSnapshot a) {
+                Serial = a.serial;
+                TotalFrames = a.totalFrames;
+                DroppedFrames = a.droppedFrames;
+                SampleRate = a.sampleRate;
+                Rms = new float[a.numChannels];
+                Peak = new float[a.numChannels];
+                Array.Copy(a.rms, Rms, a.numChannels);
+                Array.Copy(a.peak, Peak, a.numChannels);
+                SpectrumDb = a.spectrumDb;
+            }
+        };
+
+        /// <summary>
+        /// デバイスに送るサンプル (フィルター後) のレベルとスペクトルの解析を開始、停止する。
+        /// 再生スレッドはサンプルをリングバッファーにコピーするだけで、優先度の低いスレッドが解析する。
+        /// </summary>
+        public void SetAudioTapEnabled(bool enabled) {
+            WasapiIO_SetAudioTapEnabled(mId, enabled);
+        }
+
+        /// <summary>
+        /// 最新の解析結果を戻す。再生スレッドを止めない。
+        /// </summary>
+        /// <returns>null: まだ解析結果が無い。</returns>
+        public AudioTapSnapshot GetAudioTapSnapshot() {
+            WasapiIoAudioTapSnapshot a;
+            if (!WasapiIO_GetAudioTapSnapshot(mId, out a)) {
+                return null;
+            }
+            return new AudioTapSnapshot(a);
+        }
+
+        public class PcmLoudness {
+            public int PcmDataId { get; set; }
+
+            /// <summary>
+            /// false: 測定していない (DoPのデータ)。
+            /// </summary>
+            public bool Valid { get; set; }
+
+            /// <summary>
+            /// ITU-R BS.1770-4のゲート付き統合ラウドネス (LUFS)。無音のときは負の無限大。
+            /// </summary>
+            public double IntegratedLufs { get; set; }
+
+            /// <summary>
+            /// EBU Tech 3342のラウドネスレンジ (LU)。
+            /// </summary>
+            public double RangeLu { get; set; }
+
+            /// <summary>
+            /// 4倍オーバーサンプリングのトゥルーピークとサンプルピーク。フルスケールが1.0。
+            /// </summary>
+            public double TruePeak { get; set; }
+            public double SamplePeak { get; set; }
+
+            /// <summary>
+            /// ReplayGain 2.0のゲイン (dB)。-18 LUFSに合わせる。
+            /// </summary>
+            public double ReplayGainDb { get; set; }
+
+            internal PcmLoudness(WasapiIoLoudness a) {
+                PcmDataId = a.pcmDataId;
+                Valid = a.valid != 0;
+                IntegratedLufs = a.integratedLufs;
+                RangeLu = a.rangeLu;
+                TruePeak = a.truePeak;
+                SamplePeak = a.samplePeak;
+                ReplayGainDb = a.replayGainDb;
+            }
+        };
+
+        /// <summary>
+        /// 読み込んだPCMデータのラウドネスを測る。PCMデータを並列に測定する。blocking call.
+        /// </summary>
+        /// <param name="numThreads">0: CPUコア数。</param>
+        /// <param name="album">全てのPCMデータを1枚のアルバムとして測った結果。</param>
+        /// <returns>PCMデータ毎の結果。読み込み順。</returns>
+        public PcmLoudness[] ScanPcmLoudness(int numThreads, out PcmLoudness album) {
+            WasapiIoLoudness a;
+            int count = WasapiIO_ScanPcmLoudness(mId, numThreads, null, 0, out a);
+
+            var tracks = new WasapiIoLoudness[count];
+            count = WasapiIO_ScanPcmLoudness(mId, numThreads, tracks, tracks.Length, out a);
+            System.Diagnostics.Debug.Assert(count == tracks.Length);
+
+            album = new PcmLoudness(a);
+
+            var result = new PcmLoudness[tracks.Length];
+            for (int i = 0; i < tracks.Length; ++i) {
+                result[i] = new PcmLoudness(tracks[i]);
+            }
+            return result;
+        }
+
+        public class BitmatchRange {
+            /// <summary>
+            /// 参照データのフレーム番号。FromFrame以上ToFrame未満。
+            /// </summary>
+            public long FromFrame { get; set; }
+            public long ToFrame { get; set; }
+            public long MismatchedSamples { get; set; }
+
+            internal BitmatchRange(WasapiIoBitmatchRange a) {
+                FromFrame = a.fromFrame;
+                ToFrame = a.toFrame;
+                MismatchedSamples = a.mismatchedSamples;
+            }
+        };
+
+        public class BitmatchResult {
+            /// <summary>
+            /// 録音データのフレーム Lag + i が参照データのフレーム i に対応する。
+            /// </summary>
+            public long Lag { get; set; }
+
+            /// <summary>
+            /// Lagでの正規化相互相関。1.0: 同じ波形。Lagを指定したときは1.0。
+            /// </summary>
+            public double Correlation { get; set; }
+
+            /// <summary>
+            /// 比較した参照データのフレーム。ComparedFromFrame以上ComparedToFrame未満。
+            /// </summary>
+            public long ComparedFromFrame { get; set; }
+            public long ComparedToFrame { get; set; }
+
+            public long MismatchedFrames { get; set; }
+            public long MismatchedSamples { get; set; }
+
+            /// <summary>
+            /// 不一致区間の総数。Rangesは先頭のmaxRanges個まで。
+            /// </summary>
+            public long NumRanges { get; set; }
+            public BitmatchRange[] Ranges { get; set; }
+
+            internal BitmatchResult(WasapiIoBitmatchResult a, WasapiIoBitmatchRange[] ranges) {
+                Lag = a.lag;
+                Correlation = a.correlation;
+                ComparedFromFrame = a.comparedFromFrame;
+                ComparedToFrame = a.comparedToFrame;
+                MismatchedFrames = a.mismatchedFrames;
+                MismatchedSamples = a.mismatchedSamples;
+                NumRanges = a.numRanges;
+
+                Ranges = new BitmatchRange[Math.Min(a.numRanges, ranges.Length)];
+                for (int i = 0; i < Ranges.Length; ++i) {
+                    Ranges[i] = new BitmatchRange(ranges[i]);
+                }
+            }
+        };
+
+        /// <summary>
+        /// 参照PCMデータと録音PCMデータをサンプル毎に比較する。整数フォーマットのみ。blocking call.
+        /// 16bitと24bitのように量子化ビット数が異なるときは有効ビットの上位で比較する。
+        /// </summary>
+        /// <param name="findLag">true: 録音データのずれをFFTの相互相関で探す。false: lagを使う。</param>
+        /// <param name="maxRanges">返す不一致区間の最大数。</param>
+        /// <returns>null: パラメータが不正か、ずれが見つからなかった。</returns>
+        public static BitmatchResult BitmatchCompare(byte[] reference, SampleFormatType referenceFormat,
+                byte[] captured, int capturedBytes, SampleFormatType capturedFormat, int numChannels,
+                bool findLag, long lag, int maxRanges) {
+            var ranges = new WasapiIoBitmatchRange[maxRanges];
+            WasapiIoBitmatchResult a;
+            int hr = WasapiIO_BitmatchCompare(reference, reference.Length, (int)referenceFormat,
+                    captured, capturedBytes, (int)capturedFormat, numChannels,
+                    findLag, lag, ranges, ranges.Length, out a);
+            if (hr < 0) {
+                return null;
+            }
+            return new BitmatchResult(a, ranges);
+        }
+
         public bool AddPlayPcmDataEnd() {
             return WasapiIO_AddPlayPcmDataEnd(mId);
         }
@@ -677,5 +973,38 @@ namespace Wasapi {
 
             WasapiIO_AppendAudioFilter(mId, (int)aft, args);
         }
+
+        /// <summary>
+        /// フィルター列の編集を開始する。CommitAudioFilterChain()までのClearAudioFilter()とAppendAudioFilter()は再生に反映されない。
+        /// </summary>
+        public void BeginAudioFilterChain() {
+            WasapiIO_BeginAudioFilterChain(mId);
+        }
+
+        /// <summary>
+        /// 編集したフィルター列を再生スレッドに渡す。再生を止めずに切り替わる。
+        /// </summary>
+        /// <param name="crossfadeMs">フィルター列を作り直したとき、古いフィルター列と新しいフィルター列の出力をこの時間でクロスフェードする。</param>
+        public void CommitAudioFilterChain(int crossfadeMs) {
+            WasapiIO_CommitAudioFilterChain(mId, crossfadeMs);
+        }
+
+        /// <summary>
+        /// 再生中にidx番目のフィルターのパラメーターを変更する。
+        /// </summary>
+        /// <returns>false: idxのフィルターが無いか、パラメーターの変更に対応していない。</returns>
+        public bool UpdateAudioFilter(int idx, string args) {
+            return WasapiIO_UpdateAudioFilter(mId, idx, args);
+        }
+
+        /// <summary>
+        /// 16bit、24bit整数のデバイスに出力するときの、フィルターの最終段の量子化方式を設定する。
+        /// None以外のとき、フィルターはfloatで処理され、ディザーとノイズシェーピングを掛けて整数に戻される。
+        /// 再生中に呼んでもよい。Noneとそれ以外を切り替えるときは、フィルターの状態がリセットされ、
+        /// フィルターによっては作り直しで再生が途切れることがある。
+        /// </summary>
+        public void SetAudioFilterQuantizer(WWQuantizerType qt) {
+            WasapiIO_SetAudioFilterQuantizer(mId, (int)qt);
+        }
     }
 }
@@ -7,14 +7,14 @@
 class WWAudioFilter {
 public:
     virtual ~WWAudioFilter(void) {}
-    virtual void UpdateSampleFormat(WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels) = 0;
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels) = 0;
     virtual void Filter(unsigned char *buff, int bytes) = 0;
 
-    WWAudioFilter *Next(void) { return m_next; }
+    /// 再生中にパラメーターを変更する。対応していないフィルターはfalseを戻す。
+    /// @param args AppendAudioFilterの引数と同じ書式。
+    virtual bool UpdateParams(PCWSTR args) { (void)args; return false; }
 
-    void SetNext(WWAudioFilter *af) { m_next = af; }
-
-private:
-    WWAudioFilter *m_next;
+    /// @return フィルターの遅延フレーム数。
+    virtual int LatencyFrames(void) const { return 0; }
 };
 
@@ -140,9 +140,10 @@ WWAudioFilterChannelRouting::WWAudioFilterChannelRouting(PCWSTR args)
 
 void
 WWAudioFilterChannelRouting::UpdateSampleFormat(
-        WWPcmDataSampleFormatType format,
+        int sampleRate, WWPcmDataSampleFormatType format,
         WWStreamType streamType, int numChannels)
 {
+    (void)sampleRate;
     mManip.UpdateFormat(format, streamType, numChannels);
 }
 
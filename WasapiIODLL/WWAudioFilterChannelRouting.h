@@ -11,7 +11,7 @@ class WWAudioFilterChannelRouting : public WWAudioFilter {
 public:
     WWAudioFilterChannelRouting(PCWSTR args);
     virtual ~WWAudioFilterChannelRouting() {}
-    virtual void UpdateSampleFormat(WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
     virtual void Filter(unsigned char *buff, int bytes);
 
 private:
@@ -0,0 +1,82 @@
+// 日本語 UTF-8
+
+#include "WWAudioFilterConvolution.h"
+#include <assert.h>
+#include <stdio.h>
+
+WWAudioFilterConvolution::WWAudioFilterConvolution(PCWSTR args)
+    : mEnabled(false)
+{
+    // 再生スレッドを止めないように、ミューテックスを取る前にファイルを読む。
+    if (WWImpulseResponseRead(args, mIr) < 0) {
+        printf("WWAudioFilterConvolution: could not read impulse response %S\n", args);
+    }
+}
+
+WWAudioFilterConvolution::~WWAudioFilterConvolution(void)
+{
+    mConvolver.Term();
+}
+
+void
+WWAudioFilterConvolution::UpdateSampleFormat(
+        int sampleRate, WWPcmDataSampleFormatType format,
+        WWStreamType streamType, int numChannels)
+{
+    mManip.UpdateFormat(format, streamType, numChannels);
+
+    mEnabled = false;
+    mConvolver.Term();
+    if (WWStreamPcm != streamType || 0 == mIr.NumChannels()) {
+        return;
+    }
+    if (sampleRate != mIr.sampleRate) {
+        printf("WWAudioFilterConvolution: sample rate mismatch. stream=%d impulse response=%d\n", sampleRate, mIr.sampleRate);
+        return;
+    }
+
+    // 再生開始前に呼ばれる。インパルス応答のスペクトルを作り、履歴を消す。
+    // チャンネルnの入力をチャンネルnに出力するだけなので、対角のフィルター行列にする。
+    if (mConvolver.Init(numChannels, numChannels, WW_CONVOLUTION_FIRST_BLOCK_FRAMES,
+            WW_CONVOLUTION_MAX_BLOCK_FRAMES, mIr.NumTaps(), nullptr, true) < 0) {
+        printf("WWAudioFilterConvolution: convolver init failed\n");
+        return;
+    }
+
+    for (int ch=0; ch<numChannels; ++ch) {
+        if (1 == mIr.NumChannels()) {
+            mConvolver.SetFilter(ch, ch, &mIr.channels[0][0], mIr.NumTaps());
+        } else if (ch < mIr.NumChannels()) {
+            mConvolver.SetFilter(ch, ch, &mIr.channels[ch][0], mIr.NumTaps());
+        } else {
+            // 他のチャンネルと時間を揃えるため、遅延だけする。
+            const float unit = 1.0f;
+            mConvolver.SetFilter(ch, ch, &unit, 1);
+        }
+    }
+
+    mIn.resize(WW_PCM_PROCESS_FRAMES * numChannels);
+    mOut.resize(WW_PCM_PROCESS_FRAMES * numChannels);
+    mEnabled = true;
+}
+
+int
+WWAudioFilterConvolution::LatencyFrames(void) const
+{
+    if (!mEnabled) {
+        return 0;
+    }
+    return mConvolver.LatencyFrames();
+}
+
+void
+WWAudioFilterConvolution::Filter(unsigned char *buff, int bytes)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    mManip.ProcessFloat(buff, bytes, &mIn[0], &mOut[0], [this](float *in, int n, float *out) {
+        mConvolver.Process(in, n, out);
+    });
+}
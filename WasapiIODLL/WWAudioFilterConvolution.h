@@ -0,0 +1,43 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include "WWAudioFilter.h"
+#include "WWPcmSampleManipulator.h"
+#include "WWNonUniformConvolver.h"
+#include "WWImpulseResponse.h"
+#include <vector>
+
+/// 最初のブロックの大きさ。遅延はこのフレーム数。
+#define WW_CONVOLUTION_FIRST_BLOCK_FRAMES (256)
+
+/// 長いインパルス応答の後ろの部分は、この大きさまでのブロックでバックグラウンドスレッドで畳み込む。
+#define WW_CONVOLUTION_MAX_BLOCK_FRAMES (16384)
+
+/// WAVまたはFLACファイルのインパルス応答をチャンネルごとに畳み込むFIRフィルター (ルームコレクション用)。PCMのみ。
+/// インパルス応答のチャンネルnを再生のチャンネルnに掛ける。インパルス応答が1チャンネルのときは全チャンネルに掛け、
+/// インパルス応答の無いチャンネルは遅延だけする。
+/// WWNonUniformConvolverで畳み込むので、デバイスの周期が短くても長いインパルス応答を掛けられる。
+/// インパルス応答のサンプリング周波数と再生のサンプリング周波数が異なるときは何もしない。
+/// WW_CONVOLUTION_FIRST_BLOCK_FRAMESフレーム遅延する。LatencyFrames()で再生位置を補正する。
+class WWAudioFilterConvolution : public WWAudioFilter {
+public:
+    /// @param args インパルス応答のWAVまたはFLACファイルのパス。ファイルはここで読む。
+    WWAudioFilterConvolution(PCWSTR args);
+    virtual ~WWAudioFilterConvolution(void);
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    virtual void Filter(unsigned char *buff, int bytes);
+    virtual int LatencyFrames(void) const;
+
+private:
+    WWPcmSampleManipulator mManip;
+    WWImpulseResponse mIr;
+
+    WWNonUniformConvolver mConvolver;
+
+    /// 再生フォーマットがインパルス応答と合っていて畳み込みをする。
+    bool mEnabled;
+
+    std::vector<float> mIn;
+    std::vector<float> mOut;
+};
@@ -0,0 +1,56 @@
+// 日本語 UTF-8
+
+#include "WWAudioFilterCrossfeed.h"
+#include <assert.h>
+#include <stdio.h>
+
+WWAudioFilterCrossfeed::WWAudioFilterCrossfeed(PCWSTR args)
+    : mPath(args), mEnabled(false)
+{
+    mIn.resize(WW_PCM_PROCESS_FRAMES * 2);
+    mOut.resize(WW_PCM_PROCESS_FRAMES * 2);
+
+    // 再生スレッドを止めないように、ミューテックスを取る前に1回だけ読む。
+    // 係数のスペクトルを作るかキャッシュからマップする。
+    if (mCrossfeed.InitFromFile(mPath.c_str(), WW_CROSSFEED_REALTIME_BLOCK_FRAMES) < 0) {
+        printf("WWAudioFilterCrossfeed: could not read CFD2 file %S\n", mPath.c_str());
+    }
+}
+
+WWAudioFilterCrossfeed::~WWAudioFilterCrossfeed(void)
+{
+    mCrossfeed.Term();
+}
+
+void
+WWAudioFilterCrossfeed::UpdateSampleFormat(
+        int sampleRate, WWPcmDataSampleFormatType format,
+        WWStreamType streamType, int numChannels)
+{
+    mManip.UpdateFormat(format, streamType, numChannels);
+
+    mEnabled = false;
+    if (WWStreamPcm != streamType || 2 != numChannels || 0 == mCrossfeed.SampleRate()) {
+        return;
+    }
+    if (sampleRate != mCrossfeed.SampleRate()) {
+        printf("WWAudioFilterCrossfeed: sample rate mismatch. stream=%d coeffs=%d\n", sampleRate, mCrossfeed.SampleRate());
+        return;
+    }
+
+    // 再生開始前に呼ばれる。履歴を消す。
+    mCrossfeed.Reset();
+    mEnabled = true;
+}
+
+void
+WWAudioFilterCrossfeed::Filter(unsigned char *buff, int bytes)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    mManip.ProcessFloat(buff, bytes, &mIn[0], &mOut[0], [this](float *in, int n, float *out) {
+        mCrossfeed.Process(in, n, out);
+    });
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include "WWAudioFilter.h"
+#include "WWPcmSampleManipulator.h"
+#include "WWCrossfeed.h"
+#include <string>
+#include <vector>
+
+/// CFD2係数ファイルのクロスフィード。2チャンネルのPCMのみ。
+/// 係数のサンプリング周波数と再生のサンプリング周波数が異なるときは何もしない。
+/// WW_CROSSFEED_REALTIME_BLOCK_FRAMESフレーム遅延する。
+/// 係数のスペクトルはキャッシュファイル (CFD2ファイル名.b256.wwcs) に保存し、次回からはそれをマップする。
+class WWAudioFilterCrossfeed : public WWAudioFilter {
+public:
+    /// @param args CFD2係数ファイルのパス
+    WWAudioFilterCrossfeed(PCWSTR args);
+    virtual ~WWAudioFilterCrossfeed(void);
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    virtual void Filter(unsigned char *buff, int bytes);
+    virtual int LatencyFrames(void) const { return mEnabled ? mCrossfeed.LatencyFrames() : 0; }
+
+private:
+    WWPcmSampleManipulator mManip;
+    std::wstring mPath;
+
+    WWCrossfeed mCrossfeed;
+
+    /// 再生フォーマットが係数と合っていてクロスフィードを掛ける。
+    bool mEnabled;
+
+    std::vector<float> mIn;
+    std::vector<float> mOut;
+};
@@ -8,7 +8,7 @@
 class WWAudioFilterMonauralMix : public WWAudioFilter {
 public:
     virtual ~WWAudioFilterMonauralMix(void) {}
-    virtual void UpdateSampleFormat(WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
     virtual void Filter(unsigned char *buff, int bytes);
 
 private:
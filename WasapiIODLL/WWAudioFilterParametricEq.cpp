@@ -0,0 +1,180 @@
+// 日本語 UTF-8
+
+#include "WWAudioFilterParametricEq.h"
+#include "WWTypes.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+/// 再生中にパラメーターを変更したときのクロスフェードの長さ (ミリ秒)。
+#define UPDATE_RAMP_MS (20)
+
+static const struct {
+    const wchar_t *name;
+    WWBiquadType type;
+} gTypeNames[] = {
+    { L"PK", WWBT_Peaking },
+    { L"LS", WWBT_LowShelf },
+    { L"HS", WWBT_HighShelf },
+    { L"LP", WWBT_LowPass },
+    { L"HP", WWBT_HighPass },
+};
+
+WWAudioFilterParametricEq::WWAudioFilterParametricEq(PCWSTR args)
+    : mSampleRate(44100), mEnabled(false)
+{
+    if (!Parse(args, mBands)) {
+        printf("WWAudioFilterParametricEq: could not parse %S\n", args);
+        mBands.clear();
+    }
+}
+
+WWAudioFilterParametricEq::~WWAudioFilterParametricEq(void)
+{
+    mCascade.Term();
+}
+
+bool
+WWAudioFilterParametricEq::Parse(PCWSTR args, std::vector<Band> &bands_return)
+{
+    bands_return.clear();
+
+    std::wstring s(args);
+    wchar_t *ctx = nullptr;
+
+    for (wchar_t *tok = wcstok_s(&s[0], L" ", &ctx); tok != nullptr; tok = wcstok_s(nullptr, L" ", &ctx)) {
+        // 種類:周波数:ゲイン:Q[:チャンネル]
+        wchar_t *field[5] = {};
+        int nField = 0;
+        wchar_t *fctx = nullptr;
+        for (wchar_t *f = wcstok_s(tok, L":", &fctx); f != nullptr; f = wcstok_s(nullptr, L":", &fctx)) {
+            if (5 <= nField) {
+                return false;
+            }
+            field[nField++] = f;
+        }
+        if (nField < 4) {
+            return false;
+        }
+
+        Band b;
+        b.type = WWBT_NUM;
+        for (int i=0; i<(int)(sizeof gTypeNames / sizeof gTypeNames[0]); ++i) {
+            if (0 == wcscmp(field[0], gTypeNames[i].name)) {
+                b.type = gTypeNames[i].type;
+            }
+        }
+        if (WWBT_NUM == b.type) {
+            return false;
+        }
+
+        b.ch = -1;
+        if (1 != swscanf_s(field[1], L"%lf", &b.freq)
+                || 1 != swscanf_s(field[2], L"%lf", &b.gainDb)
+                || 1 != swscanf_s(field[3], L"%lf", &b.q)
+                || (5 == nField && 1 != swscanf_s(field[4], L"%d", &b.ch))) {
+            return false;
+        }
+        if (b.freq <= 0 || b.q <= 0 || (5 == nField && (b.ch < 0 || WW_CHANNEL_NUM <= b.ch))) {
+            return false;
+        }
+
+        bands_return.push_back(b);
+    }
+
+    return true;
+}
+
+void
+WWAudioFilterParametricEq::Design(int rampFrames)
+{
+    const int numChannels = mCascade.NumChannels();
+    int stageOfCh[WW_CHANNEL_NUM] = {};
+
+    mCascade.ClearCoeffs();
+
+    for (size_t i=0; i<mBands.size(); ++i) {
+        const Band &b = mBands[i];
+
+        WWBiquadCoeffs c;
+        if (WWBiquadDesign(b.type, mSampleRate, b.freq, b.gainDb, b.q, c) < 0) {
+            // ナイキスト周波数以上のバンドは掛けない。
+            printf("WWAudioFilterParametricEq: band %dHz is skipped at %dHz\n", (int)b.freq, mSampleRate);
+            continue;
+        }
+
+        for (int ch=0; ch<numChannels; ++ch) {
+            if (0 <= b.ch && b.ch != ch) {
+                continue;
+            }
+            if (WW_BIQUAD_MAX_STAGES <= stageOfCh[ch]) {
+                printf("WWAudioFilterParametricEq: too many bands on ch%d\n", ch);
+                continue;
+            }
+            mCascade.SetCoeffs(stageOfCh[ch]++, ch, c);
+        }
+    }
+
+    mCascade.Commit(rampFrames);
+}
+
+void
+WWAudioFilterParametricEq::UpdateSampleFormat(
+        int sampleRate, WWPcmDataSampleFormatType format,
+        WWStreamType streamType, int numChannels)
+{
+    mManip.UpdateFormat(format, streamType, numChannels);
+    mSampleRate = sampleRate;
+
+    mEnabled = false;
+    if (WWStreamPcm != streamType) {
+        mCascade.Term();
+        return;
+    }
+
+    // Design()はチャンネルごとの段数をWW_CHANNEL_NUMの配列で数える。それより多いチャンネルには掛けない。
+    if (numChannels < 1 || WW_CHANNEL_NUM < numChannels) {
+        printf("WWAudioFilterParametricEq: %d channels is not supported\n", numChannels);
+        mCascade.Term();
+        return;
+    }
+
+    // 再生開始前に呼ばれる。履歴を消して係数を作り直す。
+    if (mCascade.Init(numChannels, WW_BIQUAD_MAX_STAGES) < 0) {
+        return;
+    }
+    Design(0);
+
+    mBuf.resize(WW_PCM_PROCESS_FRAMES * numChannels);
+    mEnabled = true;
+}
+
+bool
+WWAudioFilterParametricEq::UpdateParams(PCWSTR args)
+{
+    std::vector<Band> bands;
+    if (!Parse(args, bands)) {
+        printf("WWAudioFilterParametricEq: could not parse %S\n", args);
+        return false;
+    }
+    mBands = bands;
+
+    if (mEnabled) {
+        Design(mSampleRate * UPDATE_RAMP_MS / 1000);
+    }
+    return true;
+}
+
+void
+WWAudioFilterParametricEq::Filter(unsigned char *buff, int bytes)
+{
+    if (!mEnabled) {
+        return;
+    }
+
+    // その場で処理する。
+    mManip.ProcessFloat(buff, bytes, &mBuf[0], &mBuf[0], [this](float *io, int n, float *) {
+        mCascade.Process(io, n);
+    });
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include "WWAudioFilter.h"
+#include "WWPcmSampleManipulator.h"
+#include "WWBiquad.h"
+#include <vector>
+
+/// バイクアッドを縦続接続したパラメトリックイコライザー。PCMのみ。
+/// 引数は空白区切りのバンドの並び。バンドは 種類:周波数Hz:ゲインdB:Q[:チャンネル番号]
+/// 種類は PK (ピーキング)、LS (ローシェルフ)、HS (ハイシェルフ)、LP (ローパス)、HP (ハイパス)。
+/// チャンネル番号を省略すると全チャンネルに掛かる。例: "LS:100:3:0.7 PK:3000:-2.5:1.4 HP:20:0:0.7:0"
+/// 再生中のUpdateParams()による変更はWWBiquadCascadeのクロスフェードで切り替わるので、ノイズが出ない。
+class WWAudioFilterParametricEq : public WWAudioFilter {
+public:
+    WWAudioFilterParametricEq(PCWSTR args);
+    virtual ~WWAudioFilterParametricEq(void);
+    virtual void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    virtual void Filter(unsigned char *buff, int bytes);
+    virtual bool UpdateParams(PCWSTR args);
+
+private:
+    struct Band {
+        WWBiquadType type;
+        double freq;
+        double gainDb;
+        double q;
+
+        /// -1: 全チャンネル
+        int ch;
+    };
+
+    WWPcmSampleManipulator mManip;
+    int mSampleRate;
+    std::vector<Band> mBands;
+
+    WWBiquadCascade mCascade;
+    bool mEnabled;
+
+    std::vector<float> mBuf;
+
+    static bool Parse(PCWSTR args, std::vector<Band> &bands_return);
+
+    /// mBandsの係数をmCascadeに設定する。
+    void Design(int rampFrames);
+};
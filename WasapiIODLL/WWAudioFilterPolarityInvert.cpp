@@ -5,9 +5,10 @@
 
 void
 WWAudioFilterPolarityInvert::UpdateSampleFormat(
-        WWPcmDataSampleFormatType format,
+        int sampleRate, WWPcmDataSampleFormatType format,
         WWStreamType streamType, int numChannels)
 {
+    (void)sampleRate;
     mManip.UpdateFormat(format, streamType, numChannels);
 }
 
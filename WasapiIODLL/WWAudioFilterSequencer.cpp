@@ -3,102 +3,373 @@
 #include "WWAudioFilterSequencer.h"
 #include "WWAudioFilter.h"
 #include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+/// 量子化するとき、この数のフレームずつフィルターを掛ける。
+#define QUANTIZE_FRAMES (1024)
+
+struct WWAudioFilterSequencer::Chain {
+    std::vector<std::shared_ptr<WWAudioFilter> > filters;
+
+    /// このフィルター列に切り替えるときのクロスフェードのフレーム数。
+    int crossfadeFrames;
+
+    Chain(void) : crossfadeFrames(0) { }
+};
 
 WWAudioFilterSequencer::WWAudioFilterSequencer(void)
-      : m_format(WWPcmDataSampleFormatSint16),
+      : m_sampleRate(44100),
+        m_format(WWPcmDataSampleFormatSint16),
         m_streamType(WWStreamPcm),
         m_numChannels(2),
-        m_audioFilter(nullptr)
+        m_latencyFrames(0),
+        m_chain(nullptr),
+        m_edit(nullptr),
+        m_renderEpoch(0),
+        m_renderChain(nullptr),
+        m_renderFadeFrom(nullptr),
+        m_fading(false),
+        m_fadePos(0),
+        m_fadeFrames(0),
+        m_quantizerType(WWQT_None),
+        m_filterFormat(WWPcmDataSampleFormatSint16)
 {
 }
-
 WWAudioFilterSequencer::~WWAudioFilterSequencer(void)
 {
-    assert(m_audioFilter == nullptr);
+    assert(m_chain.load() == nullptr);
+    assert(m_retired.empty());
 }
 
 void
 WWAudioFilterSequencer::Init(void)
 {
-    assert(m_audioFilter == nullptr);
+    assert(m_chain.load() == nullptr);
 }
 
 void
 WWAudioFilterSequencer::Term(void)
 {
-    UnregisterAll();
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    delete m_edit;
+    m_edit = nullptr;
+
+    Publish(nullptr);
+
+    // 再生スレッドは止まっている。
+    m_renderChain = nullptr;
+    m_renderFadeFrom = nullptr;
+    m_fading = false;
+    Reclaim(true);
 }
 
-WWAudioFilter *
-WWAudioFilterSequencer::Last(void)
+bool
+WWAudioFilterSequencer::IsEmpty(const Chain *c)
 {
-    if (m_audioFilter == nullptr) {
-        return nullptr;
-    }
+    return c == nullptr || c->filters.empty();
+}
 
-    WWAudioFilter *p = m_audioFilter;
+bool
+WWAudioFilterSequencer::ShareFilter(const Chain *a, const Chain *b)
+{
+    if (IsEmpty(a) || IsEmpty(b)) {
+        return false;
+    }
 
-    while (p->Next() != nullptr) {
-        p = p->Next();
+    for (size_t i=0; i<a->filters.size(); ++i) {
+        for (size_t j=0; j<b->filters.size(); ++j) {
+            if (a->filters[i] == b->filters[j]) {
+                return true;
+            }
+        }
     }
-    return p;
-};
+    return false;
+}
 
 void
-WWAudioFilterSequencer::Append(WWAudioFilter *af)
+WWAudioFilterSequencer::RunChain(const Chain *c, unsigned char *buff, int bytes)
 {
-    af->UpdateSampleFormat(m_format, m_streamType, m_numChannels);
-    af->SetNext(nullptr);
+    if (c == nullptr) {
+        return;
+    }
 
-    if (m_audioFilter == nullptr) {
-        m_audioFilter = af;
-    } else {
-        WWAudioFilter *p = Last();
-        p->SetNext(af);
+    for (size_t i=0; i<c->filters.size(); ++i) {
+        c->filters[i]->Filter(buff, bytes);
     }
 }
 
 void
 WWAudioFilterSequencer::Loop(std::function<void(WWAudioFilter*)> f)
 {
-    WWAudioFilter *p = m_audioFilter;
-    while (p != nullptr) {
-        WWAudioFilter *next = p->Next();
+    const Chain *c = m_chain.load();
+    if (c) {
+        for (size_t i=0; i<c->filters.size(); ++i) {
+            f(c->filters[i].get());
+        }
+    }
+
+    if (m_edit) {
+        for (size_t i=0; i<m_edit->filters.size(); ++i) {
+            if (c && std::find(c->filters.begin(), c->filters.end(), m_edit->filters[i]) != c->filters.end()) {
+                continue;
+            }
+            f(m_edit->filters[i].get());
+        }
+    }
+}
+
+/// 新しいフィルター列を再生スレッドに渡す。m_editMutexを取って呼ぶ。
+void
+WWAudioFilterSequencer::Publish(Chain *c)
+{
+    Chain *prev = m_chain.exchange(c);
+    if (prev != nullptr) {
+        // 入れ替えた後のエポック。偶数なら再生スレッドは新しいフィルター列しか読まない。
+        Retired r = { prev, m_renderEpoch.load() };
+        m_retired.push_back(r);
+    }
+
+    UpdateLatency();
+    Reclaim(false);
+}
+
+/// 再生スレッドが使っていない古いフィルター列を削除する。フィルターは最後のフィルター列と一緒に削除される。
+/// m_editMutexを取って呼ぶ。
+/// @param renderStopped true: 再生スレッドはProcessSamples()を呼んでいない。
+void
+WWAudioFilterSequencer::Reclaim(bool renderStopped)
+{
+    // m_renderChainとm_renderFadeFromは、再生スレッドがProcessSamples()を抜ける前に書く。
+    // エポックを先に読むので、エポックが進んでいれば、その間に再生スレッドが使い始めたフィルター列はここで見える。
+    const int64_t epoch = m_renderEpoch.load();
+    const Chain *renderChain = m_renderChain.load();
+    const Chain *fadeFrom = m_renderFadeFrom.load();
+
+    for (size_t i=0; i<m_retired.size(); ) {
+        const Retired &r = m_retired[i];
+        const bool quiescent = renderStopped || 0 == (r.epoch & 1) || r.epoch != epoch;
+        if (quiescent && r.chain != renderChain && r.chain != fadeFrom) {
+            delete r.chain;
+            m_retired.erase(m_retired.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void
+WWAudioFilterSequencer::Append(WWAudioFilter *af)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    // 再生スレッドの外で初期化する。
+    af->UpdateSampleFormat(m_sampleRate, m_filterFormat, m_streamType, m_numChannels);
 
-        f(p);
+    if (m_edit) {
+        m_edit->filters.push_back(std::shared_ptr<WWAudioFilter>(af));
+        return;
+    }
 
-        p = next;
+    // 再生中のフィルター列の後ろに追加したフィルター列。フィルターは共有するので、すぐに切り替わる。
+    Chain *c = new Chain();
+    const Chain *cur = m_chain.load();
+    if (cur) {
+        c->filters = cur->filters;
     }
+    c->filters.push_back(std::shared_ptr<WWAudioFilter>(af));
+    Publish(c);
 }
 
 void
 WWAudioFilterSequencer::UnregisterAll(void)
 {
-    Loop([](WWAudioFilter *p) {
-        delete p;
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    if (m_edit) {
+        m_edit->filters.clear();
+        return;
+    }
+
+    Publish(nullptr);
+}
+
+void
+WWAudioFilterSequencer::BeginEdit(void)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    delete m_edit;
+    m_edit = new Chain();
+
+    const Chain *cur = m_chain.load();
+    if (cur) {
+        m_edit->filters = cur->filters;
+    }
+}
+
+void
+WWAudioFilterSequencer::CommitEdit(int crossfadeMs)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    if (m_edit == nullptr) {
+        return;
+    }
+
+    if (0 < crossfadeMs && m_streamType == WWStreamPcm) {
+        m_edit->crossfadeFrames = (int)((int64_t)crossfadeMs * m_sampleRate / 1000);
+    }
+
+    Chain *c = m_edit;
+    m_edit = nullptr;
+    Publish(c);
+}
+
+void
+WWAudioFilterSequencer::UpdateLatency(void)
+{
+    int latency = 0;
+
+    const Chain *c = m_chain.load();
+    if (c) {
+        for (size_t i=0; i<c->filters.size(); ++i) {
+            latency += c->filters[i]->LatencyFrames();
+        }
+    }
+
+    m_latencyFrames = latency;
+}
+
+bool
+WWAudioFilterSequencer::UpdateParams(int idx, PCWSTR args)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    const Chain *c = m_chain.load();
+    if (idx < 0 || c == nullptr || (int)c->filters.size() <= idx) {
+        return false;
+    }
+
+    const bool result = c->filters[idx]->UpdateParams(args);
+    UpdateLatency();
+    return result;
+}
+
+bool
+WWAudioFilterSequencer::IsAvailable(void) const
+{
+    // 空のフィルター列に切り替えるときも、切り替えとクロスフェードのためにProcessSamples()を呼ぶ。
+    return !IsEmpty(m_chain.load()) || !IsEmpty(m_renderChain.load()) || m_fading;
+}
+
+void
+WWAudioFilterSequencer::SetQuantizer(WWQuantizerType type)
+{
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    const WWPcmDataSampleFormatType prevFilterFormat = m_filterFormat;
+    m_quantizerType = type;
+    UpdateQuantizer();
+
+    // 量子化方式を変えるだけのときは、フィルターはそのまま。再生中に呼ばれるので、フィルターを作り直さない。
+    if (m_filterFormat == prevFilterFormat) {
+        return;
+    }
+
+    // フィルターに渡すフォーマットが変わった (整数とfloatの切り替え)。
+    const int sampleRate = m_sampleRate;
+    const WWPcmDataSampleFormatType filterFormat = m_filterFormat;
+    const WWStreamType streamType = m_streamType;
+    const int numChannels = m_numChannels;
+    Loop([sampleRate, filterFormat, streamType, numChannels](WWAudioFilter*p) {
+        p->UpdateSampleFormat(sampleRate, filterFormat, streamType, numChannels);
     });
 
-    m_audioFilter = nullptr;
+    UpdateLatency();
+    ResetRenderChain();
+}
+
+/// m_quantizerTypeとフォーマットから、量子化するかどうかとフィルターに渡すフォーマットを決める。m_editMutexを取って呼ぶ。
+void
+WWAudioFilterSequencer::UpdateQuantizer(void)
+{
+    // 16bitと24bitの整数PCMのときだけ量子化する。
+    int bits = 0;
+    if (m_quantizerType != WWQT_None && m_streamType == WWStreamPcm) {
+        switch (m_format) {
+        case WWPcmDataSampleFormatSint16:
+            bits = 16;
+            break;
+        case WWPcmDataSampleFormatSint24:
+        case WWPcmDataSampleFormatSint32V24:
+            bits = 24;
+            break;
+        default:
+            break;
+        }
+    }
+
+    m_filterFormat = m_format;
+    if (0 < bits && 0 < m_numChannels && 0 == m_quantizer.Init(m_quantizerType, m_numChannels, bits)) {
+        m_filterFormat = WWPcmDataSampleFormatSfloat;
+        m_floatBuff.resize((size_t)QUANTIZE_FRAMES * m_numChannels);
+        m_intBuff.resize((size_t)QUANTIZE_FRAMES * m_numChannels);
+    }
+}
+
+/// フィルターのフォーマットを変えた後に呼ぶ。m_editMutexを取り、再生スレッドがProcessSamples()の中にいないときに呼ぶ。
+void
+WWAudioFilterSequencer::ResetRenderChain(void)
+{
+    // 古いフィルター列のフィルターはリセットされていない。再生スレッドはProcessSamples()の中にいないので、
+    // 再生中のフィルター列にすぐに切り替えて、古いフィルター列を全て削除する。
+    m_renderChain = m_chain.load();
+    m_renderFadeFrom = nullptr;
+    m_fading = false;
+    Reclaim(true);
+}
+
+void
+WWAudioFilterSequencer::ReclaimRetired(void)
+{
+    // 編集する側がm_editMutexを取っているときは、そちらが削除するので待たない。
+    std::unique_lock<std::mutex> lock(m_editMutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_retired.empty()) {
+        return;
+    }
+    Reclaim(false);
 }
 
 void
 WWAudioFilterSequencer::UpdateSampleFormat(
-        WWPcmDataSampleFormatType format,
+        int sampleRate, WWPcmDataSampleFormatType format,
         WWStreamType streamType, int numChannels)
 {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    m_sampleRate = sampleRate;
     m_format = format;
     m_streamType = streamType;
     m_numChannels = numChannels;
 
-    Loop([format, streamType, numChannels](WWAudioFilter*p) {
-        p->UpdateSampleFormat(format, streamType, numChannels);
+    UpdateQuantizer();
+
+    const WWPcmDataSampleFormatType filterFormat = m_filterFormat;
+    Loop([sampleRate, filterFormat, streamType, numChannels](WWAudioFilter*p) {
+        p->UpdateSampleFormat(sampleRate, filterFormat, streamType, numChannels);
     });
+
+    UpdateLatency();
+    ResetRenderChain();
 }
 
 void
-WWAudioFilterSequencer::SaturateSamples(unsigned char *buff, int bytes)
+WWAudioFilterSequencer::SaturateSamples(WWPcmDataSampleFormatType format, unsigned char *buff, int bytes)
 {
-    switch (m_format) {
+    switch (format) {
     case WWPcmDataSampleFormatSfloat:
         {
             // [-1.0, 1.0)の範囲でSaturateする。
@@ -124,13 +395,212 @@ WWAudioFilterSequencer::SaturateSamples(unsigned char *buff, int bytes)
     }
 }
 
+/// 再生スレッドに渡されたフィルター列に切り替える。
+void
+WWAudioFilterSequencer::SwitchChain(void)
+{
+    // クロスフェード中は、終わってから次のフィルター列に切り替える。
+    if (m_fading) {
+        return;
+    }
+
+    Chain *next = m_chain.load();
+    Chain *cur = m_renderChain.load();
+    if (next == cur) {
+        return;
+    }
+
+    // フィルターを共有しているときは、1個のフィルターを2回掛けることになるのでクロスフェードできない。
+    if (next != nullptr && 0 < next->crossfadeFrames && !ShareFilter(cur, next)) {
+        // m_renderFadeFromをm_renderChainより先に書く。Reclaim()参照。
+        m_renderFadeFrom = cur;
+        m_fading = true;
+        m_fadePos = 0;
+        m_fadeFrames = next->crossfadeFrames;
+    }
+
+    m_renderChain = next;
+}
+
+static double
+GetSample(WWPcmDataSampleFormatType format, const unsigned char *p, int idx)
+{
+    switch (format) {
+    case WWPcmDataSampleFormatSint16:
+        return ((const short *)p)[idx];
+    case WWPcmDataSampleFormatSint24:
+        return (int)(((unsigned int)p[idx*3] << 8) + ((unsigned int)p[idx*3+1] << 16) + ((unsigned int)p[idx*3+2] << 24)) >> 8;
+    case WWPcmDataSampleFormatSint32V24:
+        return ((const int *)p)[idx] >> 8;
+    case WWPcmDataSampleFormatSint32:
+        return ((const int *)p)[idx];
+    case WWPcmDataSampleFormatSfloat:
+        return ((const float *)p)[idx];
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+/// vは同じフォーマットの2個のサンプルの間の値なので、範囲外にはならない。
+static void
+SetSample(WWPcmDataSampleFormatType format, unsigned char *p, int idx, double v)
+{
+    const int vI = (int)floor(v + 0.5);
+
+    switch (format) {
+    case WWPcmDataSampleFormatSint16:
+        ((short *)p)[idx] = (short)vI;
+        break;
+    case WWPcmDataSampleFormatSint24:
+        p[idx*3]   = (unsigned char)(vI);
+        p[idx*3+1] = (unsigned char)(vI >> 8);
+        p[idx*3+2] = (unsigned char)(vI >> 16);
+        break;
+    case WWPcmDataSampleFormatSint32V24:
+        ((int *)p)[idx] = (int)((unsigned int)vI << 8);
+        break;
+    case WWPcmDataSampleFormatSint32:
+        ((int *)p)[idx] = vI;
+        break;
+    case WWPcmDataSampleFormatSfloat:
+        ((float *)p)[idx] = (float)v;
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+/// 古いフィルター列の出力fromから新しいフィルター列の出力toへ直線でクロスフェードする。結果はtoに書く。
+void
+WWAudioFilterSequencer::Crossfade(const unsigned char *from, unsigned char *to, int bytes)
+{
+    const int bytesPerSample = WWPcmDataSampleFormatTypeToBitsPerSample(m_filterFormat) / 8;
+    const int frames = bytes / (bytesPerSample * m_numChannels);
+
+    for (int i=0; i<frames && m_fadePos < m_fadeFrames; ++i) {
+        const double gain = (double)m_fadePos / m_fadeFrames;
+        for (int ch=0; ch<m_numChannels; ++ch) {
+            const int idx = i * m_numChannels + ch;
+            const double a = GetSample(m_filterFormat, from, idx);
+            const double b = GetSample(m_filterFormat, to, idx);
+            SetSample(m_filterFormat, to, idx, a + (b - a) * gain);
+        }
+        ++m_fadePos;
+    }
+}
+
+/// フィルター列を掛ける。クロスフェード中は新旧のフィルター列を掛けて混ぜる。再生スレッドから呼ぶ。
+void
+WWAudioFilterSequencer::FilterChain(unsigned char *buff, int bytes)
+{
+    const Chain *c = m_renderChain.load();
+    if (!m_fading) {
+        RunChain(c, buff, bytes);
+        return;
+    }
+
+    // 足りないときだけ確保する。
+    if (m_fadeBuff.size() < (size_t)bytes) {
+        m_fadeBuff.resize(bytes);
+    }
+    memcpy(&m_fadeBuff[0], buff, bytes);
+
+    RunChain(m_renderFadeFrom.load(), &m_fadeBuff[0], bytes);
+    RunChain(c, buff, bytes);
+    Crossfade(&m_fadeBuff[0], buff, bytes);
+
+    if (m_fadeFrames <= m_fadePos) {
+        m_fading = false;
+        m_renderFadeFrom = nullptr;
+    }
+}
+
 void
 WWAudioFilterSequencer::ProcessSamples(unsigned char *buff, int bytes)
 {
-    Loop([buff,bytes](WWAudioFilter*p) {
-        p->Filter(buff, bytes);
-    });
+    // 奇数の間、フィルター列を使用中。
+    ++m_renderEpoch;
+
+    SwitchChain();
 
-    // 最後にSaturate処理する。
-    SaturateSamples(buff, bytes);
+    if (IsQuantizing()) {
+        ProcessQuantize(buff, bytes);
+    } else {
+        FilterChain(buff, bytes);
+
+        // 最後にSaturate処理する。
+        SaturateSamples(m_format, buff, bytes);
+    }
+
+    ++m_renderEpoch;
+}
+
+/// 整数のサンプルをfloatに変換してフィルターを掛け、量子化して書き戻す。
+void
+WWAudioFilterSequencer::ProcessQuantize(unsigned char *buff, int bytes)
+{
+    const int bytesPerSample = WWPcmDataSampleFormatTypeToBitsPerSample(m_format) / 8;
+    const int frames = bytes / (bytesPerSample * m_numChannels);
+
+    for (int pos=0; pos<frames; pos += QUANTIZE_FRAMES) {
+        const int n = std::min(frames - pos, QUANTIZE_FRAMES);
+        const int count = n * m_numChannels;
+        unsigned char *p = &buff[(size_t)pos * m_numChannels * bytesPerSample];
+        float *f = &m_floatBuff[0];
+        int32_t *q = &m_intBuff[0];
+
+        switch (m_format) {
+        case WWPcmDataSampleFormatSint16:
+            for (int i=0; i<count; ++i) {
+                f[i] = ((short *)p)[i] * (1.0f / 32768.0f);
+            }
+            break;
+        case WWPcmDataSampleFormatSint24:
+            for (int i=0; i<count; ++i) {
+                const int v = (int)(((unsigned int)p[i*3] << 8) + ((unsigned int)p[i*3+1] << 16) + ((unsigned int)p[i*3+2] << 24));
+                f[i] = v * (1.0f / 2147483648.0f);
+            }
+            break;
+        case WWPcmDataSampleFormatSint32V24:
+            for (int i=0; i<count; ++i) {
+                f[i] = ((int *)p)[i] * (1.0f / 2147483648.0f);
+            }
+            break;
+        default:
+            assert(0);
+            return;
+        }
+
+        unsigned char *fb = (unsigned char *)f;
+        const int fBytes = count * (int)sizeof(float);
+        FilterChain(fb, fBytes);
+        SaturateSamples(WWPcmDataSampleFormatSfloat, fb, fBytes);
+
+        m_quantizer.Process(f, n, q);
+
+        switch (m_format) {
+        case WWPcmDataSampleFormatSint16:
+            for (int i=0; i<count; ++i) {
+                ((short *)p)[i] = (short)q[i];
+            }
+            break;
+        case WWPcmDataSampleFormatSint24:
+            for (int i=0; i<count; ++i) {
+                p[i*3]   = (unsigned char)(q[i]);
+                p[i*3+1] = (unsigned char)(q[i] >> 8);
+                p[i*3+2] = (unsigned char)(q[i] >> 16);
+            }
+            break;
+        case WWPcmDataSampleFormatSint32V24:
+            for (int i=0; i<count; ++i) {
+                ((int *)p)[i] = (int)((unsigned int)q[i] << 8);
+            }
+            break;
+        default:
+            assert(0);
+            return;
+        }
+    }
 }
@@ -3,10 +3,25 @@
 // 日本語 UTF-8
 
 #include "WWPcmData.h"
+#include "WWQuantizer.h"
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class WWAudioFilter;
 
+/// 再生スレッドが掛けるフィルター列。
+///
+///   フィルター列は再生スレッドの外で新しく作り、1回のアトミックなポインターの入れ替えで再生スレッドに渡す (RCU)。
+///   再生スレッドはProcessSamples()の最初に新しいフィルター列に切り替える。フィルター列の編集は再生スレッドを止めない。
+///   古いフィルター列は、再生スレッドがそれを使っていないことを確認してから (ProcessSamples()の外にいるか、
+///   その後ProcessSamples()を1回終えた)、編集する側のスレッドか、ProcessSamples()の外でReclaimRetired()を呼んだ
+///   スレッドで削除する。フィルターの削除で再生が途切れることはない。
+///
+///   新旧のフィルター列がフィルターを共有しないとき (BeginEdit()、UnregisterAll()、Append()、CommitEdit()で作り直したとき)、
+///   出力を短くクロスフェードして切り替えることができる。
 class WWAudioFilterSequencer {
 public:
     WWAudioFilterSequencer(void);
@@ -15,24 +30,123 @@ public:
     void Init(void);
     void Term(void);
 
+    /// フィルターを末尾に追加する。編集中でないときはすぐに再生スレッドに渡す。
+    /// afはこのクラスが削除する。
     void Append(WWAudioFilter *af);
 
-    /// 登録されているフィルターを全て登録解除する
+    /// 登録されているフィルターを全て登録解除する。編集中でないときはすぐに再生スレッドに渡す。
     void UnregisterAll(void);
 
-    bool IsAvailable(void) const { return m_audioFilter != nullptr; }
+    /// フィルター列の編集を開始する。CommitEdit()までのAppend()とUnregisterAll()は再生中のフィルター列に反映されない。
+    void BeginEdit(void);
 
-    void UpdateSampleFormat(WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+    /// 編集したフィルター列を再生スレッドに渡す。
+    /// @param crossfadeMs 0より大きいとき、新旧のフィルター列がフィルターを共有しなければ、出力をこの時間でクロスフェードする。
+    ///        DoPのときはクロスフェードしない。
+    void CommitEdit(int crossfadeMs);
+
+    /// idx番目 (0から数える) のフィルターのパラメーターを変更する。
+    /// フィルターをその場で変更するので、再生スレッドがProcessSamples()を呼んでいないときに呼ぶ。
+    /// @return false: idxのフィルターが無いか、パラメーターの変更に対応していない。
+    bool UpdateParams(int idx, PCWSTR args);
+
+    /// 再生スレッドから呼ぶ。
+    /// @return true: ProcessSamples()を呼ぶ必要がある。
+    bool IsAvailable(void) const;
+
+    /// @return 全フィルターの遅延フレーム数の合計。
+    /// フィルターの登録、フォーマットの変更のときに更新する。ミューテックスを取らずに読んでもよい。
+    int LatencyFrames(void) const { return m_latencyFrames; }
+
+    /// デバイスが16bitまたは24bitの整数PCMのとき、最終段の量子化方式を設定する。
+    /// WWQT_None以外のとき、フィルターは32bit floatのサンプルを処理し、結果をディザーとノイズシェーピングを掛けて整数に戻す。
+    /// WWQT_Noneのとき (初期値)、フィルターはデバイスのフォーマットのサンプルを処理する。
+    /// 再生中に呼んでもよい。量子化器だけを作り直す。WWQT_Noneとそれ以外を切り替えてフィルターに渡すフォーマットが
+    /// 変わるときだけ、フィルターのUpdateSampleFormatを呼び出すので、フィルターの状態はリセットされる。
+    /// 再生スレッドがProcessSamples()を呼んでいないとき (再生スレッドのミューテックスを取って) 呼ぶ。
+    void SetQuantizer(WWQuantizerType type);
+
+    WWQuantizerType QuantizerType(void) const { return m_quantizerType; }
+
+    /// 全てのフィルターの状態をリセットする。再生スレッドがProcessSamples()を呼んでいないときに呼ぶ。
+    void UpdateSampleFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+
+    /// 再生スレッドから呼ぶ。
     void ProcessSamples(unsigned char *buff, int bytes);
 
+    /// 削除できるようになった古いフィルター列を削除する。ProcessSamples()の外で定期的に呼ぶ。
+    /// 再生スレッドから呼んでもよい。編集中のときは待たずに何もしない (編集する側が削除する)。
+    void ReclaimRetired(void);
+
 private:
+    struct Chain;
+
+    /// 再生スレッドに渡したが、まだ削除できないフィルター列。
+    struct Retired {
+        Chain *chain;
+
+        /// 再生スレッドに渡すのを止めたときのm_renderEpoch
+        int64_t epoch;
+    };
+
+    int m_sampleRate;
     WWPcmDataSampleFormatType m_format;
     WWStreamType m_streamType;
     int m_numChannels;
-    WWAudioFilter *m_audioFilter;
+    volatile int m_latencyFrames;
+
+    /// 編集する側のスレッドの排他。再生スレッドは取らない。
+    std::mutex m_editMutex;
 
-    WWAudioFilter *Last(void);
+    /// 再生スレッドに渡すフィルター列。nullptr: フィルター無し。
+    std::atomic<Chain *> m_chain;
 
+    /// BeginEdit()からCommitEdit()まで、編集中のフィルター列。
+    Chain *m_edit;
+
+    std::vector<Retired> m_retired;
+
+    /// ProcessSamples()の出入りで1ずつ増える。奇数のとき再生スレッドはProcessSamples()の中にいる。
+    std::atomic<int64_t> m_renderEpoch;
+
+    /// 再生スレッドが掛けているフィルター列と、クロスフェード中の古いフィルター列。再生スレッドが書く。
+    std::atomic<Chain *> m_renderChain;
+    std::atomic<Chain *> m_renderFadeFrom;
+
+    /// 以下は再生スレッドだけが使う。
+    bool m_fading;
+    int m_fadePos;
+    int m_fadeFrames;
+    std::vector<unsigned char> m_fadeBuff;
+
+    WWQuantizerType m_quantizerType;
+    WWQuantizer m_quantizer;
+
+    /// フィルターに渡すサンプルフォーマット。量子化するときはSfloat、それ以外はm_formatと同じ。
+    WWPcmDataSampleFormatType m_filterFormat;
+
+    /// 量子化するときの作業領域。
+    std::vector<float> m_floatBuff;
+    std::vector<int32_t> m_intBuff;
+
+    void UpdateLatency(void);
+    void UpdateQuantizer(void);
+    void ResetRenderChain(void);
+    bool IsQuantizing(void) const { return m_filterFormat != m_format; }
+
+    static bool IsEmpty(const Chain *c);
+    static bool ShareFilter(const Chain *a, const Chain *b);
+    static void RunChain(const Chain *c, unsigned char *buff, int bytes);
+
+    void Publish(Chain *c);
+    void Reclaim(bool renderStopped);
+
+    /// 再生中と編集中のフィルター列の全てのフィルターについて1回ずつfを呼ぶ。
     void Loop(std::function<void(WWAudioFilter*)> f);
-    void SaturateSamples(unsigned char *buff, int bytes);
+
+    void SwitchChain(void);
+    void FilterChain(unsigned char *buff, int bytes);
+    void Crossfade(const unsigned char *from, unsigned char *to, int bytes);
+    void SaturateSamples(WWPcmDataSampleFormatType format, unsigned char *buff, int bytes);
+    void ProcessQuantize(unsigned char *buff, int bytes);
 };
@@ -6,6 +6,9 @@ enum WWAudioFilterType {
     WWAF_PolarityInvert,
     WWAF_Monaural,
     WWAF_ChannelRouting,
+    WWAF_Crossfeed,
+    WWAF_ParametricEq,
+    WWAF_Convolution,
 
     WWAF_NUM
 };
@@ -0,0 +1,269 @@
+// 日本語 UTF-8
+
+#include "WWAudioTap.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#ifndef M_PI
+#  define M_PI (3.14159265358979323846)
+#endif
+
+/// 解析スレッドが起きる間隔 (ミリ秒)。
+#define ANALYSIS_INTERVAL_MS (30)
+
+/// リングバッファーの長さ (秒)。解析スレッドがこの時間より遅れるとサンプルを捨てる。
+#define RING_SECONDS (0.5)
+
+/// スペクトルの下限 (dB)。
+#define SPECTRUM_FLOOR_DB (-200.0f)
+
+WWAudioTap::WWAudioTap(void)
+    : m_enabled(false),
+      m_sampleRate(44100),
+      m_numChannels(0),
+      m_bytesPerFrame(0),
+      m_isPcm(false),
+      m_ringFrames(0),
+      m_writeFrames(0),
+      m_readFrames(0),
+      m_droppedFrames(0),
+      m_published(0),
+      m_quit(false),
+      m_historyPos(0)
+{
+    memset(&m_work, 0, sizeof m_work);
+
+    m_fft.Init(WW_AUDIO_TAP_FFT_LENGTH);
+    m_window.resize(WW_AUDIO_TAP_FFT_LENGTH);
+    for (int i=0; i<WW_AUDIO_TAP_FFT_LENGTH; ++i) {
+        m_window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / WW_AUDIO_TAP_FFT_LENGTH));
+    }
+    m_history.assign(WW_AUDIO_TAP_FFT_LENGTH, 0.0f);
+    m_fftIn.resize(WW_AUDIO_TAP_FFT_LENGTH);
+    m_fftRe.resize(WW_AUDIO_TAP_SPECTRUM_BINS);
+    m_fftIm.resize(WW_AUDIO_TAP_SPECTRUM_BINS);
+}
+
+WWAudioTap::~WWAudioTap(void)
+{
+    SetEnabled(false);
+}
+
+void
+WWAudioTap::SetEnabled(bool b)
+{
+    if (b == m_thread.joinable()) {
+        return;
+    }
+
+    if (b) {
+        m_quit = false;
+        m_thread = std::thread(&WWAudioTap::ThreadMain, this);
+#ifdef _WIN32
+        SetThreadPriority(m_thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+        m_enabled.store(true, std::memory_order_release);
+    } else {
+        m_enabled.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+}
+
+void
+WWAudioTap::UpdateFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_sampleRate    = sampleRate;
+    m_numChannels   = numChannels;
+    m_bytesPerFrame = numChannels * WWPcmDataSampleFormatTypeToBitsPerSample(format) / 8;
+    m_isPcm         = (WWStreamPcm == streamType && 0 < m_bytesPerFrame);
+    m_manip.UpdateFormat(format, streamType, numChannels);
+
+    m_ringFrames = 1;
+    while (m_ringFrames < (int64_t)(sampleRate * RING_SECONDS)) {
+        m_ringFrames *= 2;
+    }
+    m_ring.assign((size_t)(m_ringFrames * m_bytesPerFrame), 0);
+
+    m_writeFrames.store(0, std::memory_order_relaxed);
+    m_readFrames.store(0, std::memory_order_relaxed);
+    m_droppedFrames.store(0, std::memory_order_relaxed);
+
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_historyPos = 0;
+    memset(&m_work, 0, sizeof m_work);
+}
+
+void
+WWAudioTap::Write(const unsigned char *buff, int bytes)
+{
+    if (!m_isPcm || !m_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const int64_t frames = bytes / m_bytesPerFrame;
+    const int64_t w      = m_writeFrames.load(std::memory_order_relaxed);
+    const int64_t r      = m_readFrames.load(std::memory_order_acquire);
+    const int64_t n      = std::min(frames, m_ringFrames - (w - r));
+
+    if (n < frames) {
+        m_droppedFrames.store(m_droppedFrames.load(std::memory_order_relaxed) + frames - n, std::memory_order_relaxed);
+    }
+    if (n <= 0) {
+        return;
+    }
+
+    // リングバッファーの終わりで折り返す。
+    const int64_t pos   = w & (m_ringFrames - 1);
+    const int64_t first = std::min(n, m_ringFrames - pos);
+    memcpy(&m_ring[(size_t)(pos * m_bytesPerFrame)], buff, (size_t)(first * m_bytesPerFrame));
+    if (first < n) {
+        memcpy(&m_ring[0], &buff[first * m_bytesPerFrame], (size_t)((n - first) * m_bytesPerFrame));
+    }
+
+    m_writeFrames.store(w + n, std::memory_order_release);
+}
+
+void
+WWAudioTap::DiscardUnread(void)
+{
+    // m_readFramesは解析スレッドもm_mutexを取って書く。
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_readFrames.store(m_writeFrames.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+bool
+WWAudioTap::GetSnapshot(WWAudioTapSnapshot &s_return) const
+{
+    for (;;) {
+        const uint32_t published = m_published.load(std::memory_order_acquire);
+        if (0 == published) {
+            return false;
+        }
+
+        const Slot &slot = m_slot[published & 1];
+        const uint32_t seq0 = slot.seq.load(std::memory_order_acquire);
+        if (seq0 & 1) {
+            // 解析スレッドが書いている。
+            std::this_thread::yield();
+            continue;
+        }
+
+        memcpy(&s_return, &slot.snapshot, sizeof s_return);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq0 == slot.seq.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void
+WWAudioTap::Publish(const WWAudioTapSnapshot &s)
+{
+    // 読み手が読んでいるかもしれない最新の面ではなく、もう一方の面に書く。
+    const uint32_t published = m_published.load(std::memory_order_relaxed) + 1;
+    Slot &slot = m_slot[published & 1];
+
+    slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&slot.snapshot, &s, sizeof s);
+
+    slot.seq.store(slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    m_published.store(published, std::memory_order_release);
+}
+
+void
+WWAudioTap::Analyze(void)
+{
+    if (!m_isPcm) {
+        return;
+    }
+
+    const int64_t r = m_readFrames.load(std::memory_order_relaxed);
+    const int64_t w = m_writeFrames.load(std::memory_order_acquire);
+    const int64_t n = w - r;
+    if (n <= 0) {
+        return;
+    }
+
+    const int numCh = std::min(m_numChannels, WW_AUDIO_TAP_MAX_CHANNELS);
+    double sumSq[WW_AUDIO_TAP_MAX_CHANNELS];
+    float peak[WW_AUDIO_TAP_MAX_CHANNELS];
+    for (int ch=0; ch<numCh; ++ch) {
+        sumSq[ch] = 0;
+        peak[ch]  = 0;
+    }
+
+    const int64_t ringBytes = (int64_t)m_ring.size();
+    for (int64_t i=0; i<n; ++i) {
+        const int64_t pos = (r + i) & (m_ringFrames - 1);
+
+        float mix = 0;
+        for (int ch=0; ch<m_numChannels; ++ch) {
+            float v = 0;
+            m_manip.GetFloatSample(&m_ring[0], ringBytes, pos, ch, v);
+            mix += v;
+
+            if (ch < numCh) {
+                sumSq[ch] += (double)v * v;
+                peak[ch] = std::max(peak[ch], fabsf(v));
+            }
+        }
+
+        m_history[m_historyPos] = mix / m_numChannels;
+        m_historyPos = (m_historyPos + 1) % WW_AUDIO_TAP_FFT_LENGTH;
+    }
+
+    // 読んだ領域を再生スレッドに返す。
+    m_readFrames.store(w, std::memory_order_release);
+
+    WWAudioTapSnapshot &s = m_work;
+    ++s.serial;
+    s.totalFrames   = w;
+    s.droppedFrames = m_droppedFrames.load(std::memory_order_relaxed);
+    s.sampleRate    = m_sampleRate;
+    s.numChannels   = numCh;
+    for (int ch=0; ch<numCh; ++ch) {
+        s.rms[ch]  = (float)sqrt(sumSq[ch] / n);
+        s.peak[ch] = peak[ch];
+    }
+
+    // 最新のFFT長のフレームを古い順に並べ、窓を掛ける。
+    for (int i=0; i<WW_AUDIO_TAP_FFT_LENGTH; ++i) {
+        m_fftIn[i] = m_history[(m_historyPos + i) % WW_AUDIO_TAP_FFT_LENGTH] * m_window[i];
+    }
+    m_fft.Forward(&m_fftIn[0], &m_fftRe[0], &m_fftIm[0]);
+
+    // ハン窓の係数の和はFFT長の半分。振幅Aの正弦波のビンの大きさはA * FFT長 / 4。
+    const float scale = 4.0f / WW_AUDIO_TAP_FFT_LENGTH;
+    for (int i=0; i<WW_AUDIO_TAP_SPECTRUM_BINS; ++i) {
+        const float mag = scale * sqrtf(m_fftRe[i] * m_fftRe[i] + m_fftIm[i] * m_fftIm[i]);
+        s.spectrumDb[i] = (0 < mag) ? std::max(SPECTRUM_FLOOR_DB, 20.0f * log10f(mag)) : SPECTRUM_FLOOR_DB;
+    }
+
+    Publish(s);
+}
+
+void
+WWAudioTap::ThreadMain(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit) {
+        m_cv.wait_for(lock, std::chrono::milliseconds(ANALYSIS_INTERVAL_MS), [this] { return m_quit; });
+        if (m_quit) {
+            break;
+        }
+        Analyze();
+    }
+}
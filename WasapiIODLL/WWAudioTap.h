@@ -0,0 +1,121 @@
+#pragma once
+
+// 日本語 UTF-8
+
+#include "WWPcmData.h"
+#include "WWPcmSampleManipulator.h"
+#include "WWFft.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// レベルを測る最大のチャンネル数。これより多いチャンネルは測らない。
+#define WW_AUDIO_TAP_MAX_CHANNELS (8)
+
+/// スペクトルのFFTの長さ。
+#define WW_AUDIO_TAP_FFT_LENGTH (2048)
+#define WW_AUDIO_TAP_SPECTRUM_BINS (WW_AUDIO_TAP_FFT_LENGTH / 2 + 1)
+
+/// 解析スレッドが1回に解析した結果。
+struct WWAudioTapSnapshot {
+    /// 発行した解析結果の通し番号。1から。
+    int64_t serial;
+
+    /// タップに書かれたフレーム数と、リングバッファーが一杯で捨てたフレーム数。
+    int64_t totalFrames;
+    int64_t droppedFrames;
+
+    int sampleRate;
+    int numChannels;
+
+    /// 前回の解析結果以降のフレームのRMSとピーク。フルスケールが1.0。
+    float rms[WW_AUDIO_TAP_MAX_CHANNELS];
+    float peak[WW_AUDIO_TAP_MAX_CHANNELS];
+
+    /// 最新のWW_AUDIO_TAP_FFT_LENGTHフレームの全チャンネルの平均のスペクトル。ハン窓。
+    /// フルスケールの正弦波が0dBになる。
+    float spectrumDb[WW_AUDIO_TAP_SPECTRUM_BINS];
+};
+
+/// 再生スレッドからフィルター後のサンプルを受け取り、別スレッドでレベルとスペクトルを測る。
+///
+///   再生スレッドはWrite()でサンプルをロックフリーのリングバッファー (1対1) にコピーするだけで、待つことはない。
+///   リングバッファーが一杯のときはコピーせずに捨てる。
+///   優先度の低い解析スレッドが一定時間ごとにリングバッファーを読み、解析結果を2面のバッファーに書いて
+///   シーケンスロックで発行する。GetSnapshot()はどのスレッドからもロックを取らずに呼べる。
+class WWAudioTap {
+public:
+    WWAudioTap(void);
+    ~WWAudioTap(void);
+
+    /// 解析スレッドを開始、停止する。
+    void SetEnabled(bool b);
+    bool IsEnabled(void) const { return m_enabled.load(std::memory_order_relaxed); }
+
+    /// 再生スレッドが動いていないときに呼ぶ。リングバッファーを空にする。
+    void UpdateFormat(int sampleRate, WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
+
+    /// 再生スレッドから呼ぶ。待たない。DoPのときは何もしない。
+    void Write(const unsigned char *buff, int bytes);
+
+    /// 解析せずにリングバッファーを空にする。Write()の費用を測るベンチマークが、捨てる経路を測らないように呼ぶ。
+    void DiscardUnread(void);
+
+    /// @return false: まだ解析結果が無い。
+    bool GetSnapshot(WWAudioTapSnapshot &s_return) const;
+
+private:
+    /// シーケンスロックで守られた解析結果。奇数のとき書き込み中。
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        WWAudioTapSnapshot snapshot;
+
+        Slot(void) : seq(0) { }
+    };
+
+    std::atomic<bool> m_enabled;
+
+    int m_sampleRate;
+    int m_numChannels;
+    int m_bytesPerFrame;
+    bool m_isPcm;
+    WWPcmSampleManipulator m_manip;
+
+    /// リングバッファー。2のべき乗のフレーム数。
+    std::vector<unsigned char> m_ring;
+    int64_t m_ringFrames;
+
+    /// 書いたフレーム数と読んだフレーム数。前者は再生スレッドだけが、後者は解析スレッドだけが書く。
+    std::atomic<int64_t> m_writeFrames;
+    std::atomic<int64_t> m_readFrames;
+    std::atomic<int64_t> m_droppedFrames;
+
+    /// m_slot[m_published & 1]が最新の解析結果。0: まだ無い。
+    Slot m_slot[2];
+    std::atomic<uint32_t> m_published;
+
+    std::thread m_thread;
+
+    /// 解析スレッドの終了要求と、フォーマット変更との排他。
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_quit;
+
+    /// 以下は解析スレッドだけが使う。
+    WWRealFft m_fft;
+    std::vector<float> m_window;
+    std::vector<float> m_history;
+    int m_historyPos;
+    std::vector<float> m_fftIn;
+    std::vector<float> m_fftRe;
+    std::vector<float> m_fftIm;
+    WWAudioTapSnapshot m_work;
+
+    void ThreadMain(void);
+
+    /// m_mutexを取って呼ぶ。
+    void Analyze(void);
+    void Publish(const WWAudioTapSnapshot &s);
+};
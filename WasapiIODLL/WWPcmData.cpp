@@ -2,6 +2,8 @@
 
 #include "WWPcmData.h"
 #include "WWUtil.h"
+#include "WWDsdDecimator.h"
+#include "WWDsdModulator.h"
 #include <assert.h>
 #include <malloc.h>
 #include <stdint.h>
@@ -611,6 +613,54 @@ WWPcmData::ScaleSampleValue(float scale)
     }
 }
 
+void
+WWPcmData::GetFloatFrames(int64_t fromFrame, int frames, float *out_return) const
+{
+    assert(0 <= fromFrame);
+
+    const int64_t n = (fromFrame < nFrames) ? min((int64_t)frames, nFrames - fromFrame) : 0;
+    const int64_t count = n * nChannels;
+    const BYTE *from = &stream[fromFrame * bytesPerFrame];
+
+    switch (sampleFormat) {
+    case WWPcmDataSampleFormatSint16:
+        {
+            const short *p = (const short *)from;
+            for (int64_t i=0; i<count; ++i) {
+                out_return[i] = p[i] * (1.0f / 32768.0f);
+            }
+        }
+        break;
+    case WWPcmDataSampleFormatSint24:
+        for (int64_t i=0; i<count; ++i) {
+            const BYTE *p = &from[3 * i];
+            const int v = (int)(((unsigned int)p[0] << 8) + ((unsigned int)p[1] << 16) + ((unsigned int)p[2] << 24));
+            out_return[i] = v * (1.0f / 2147483648.0f);
+        }
+        break;
+    case WWPcmDataSampleFormatSint32V24:
+    case WWPcmDataSampleFormatSint32:
+        {
+            // Sint32V24の下位8ビットは0。
+            const int *p = (const int *)from;
+            for (int64_t i=0; i<count; ++i) {
+                out_return[i] = p[i] * (1.0f / 2147483648.0f);
+            }
+        }
+        break;
+    case WWPcmDataSampleFormatSfloat:
+        memcpy(out_return, from, (size_t)(4 * count));
+        break;
+    default:
+        assert(0);
+        break;
+    }
+
+    for (int64_t i=count; i<(int64_t)frames * nChannels; ++i) {
+        out_return[i] = 0.0f;
+    }
+}
+
 void
 WWPcmData::FillDopSilentData(void)
 {
@@ -646,131 +696,100 @@ WWPcmData::FillDopSilentData(void)
     }
 }
 
-static const unsigned char gBitsSetTable256[256] = 
-{
-#   define B2(n) n,     n+1,     n+1,     n+2
-#   define B4(n) B2(n), B2(n+1), B2(n+1), B2(n+2)
-#   define B6(n) B4(n), B4(n+1), B4(n+1), B4(n+2)
-    B6(0), B6(1), B6(1), B6(2)
-};
-#undef B6
-#undef B4
-#undef B2
-
-/// @param availableBits 0以上64以下の整数。
-/// @return -1.0 to 1.0f
-static float
-DsdStreamToAmplitudeFloat(uint64_t v, uint32_t availableBits)
-{
-    v &= 0xFFFFFFFFFFFFFFFFULL >> (64-availableBits);
-
-    const unsigned char * p = (unsigned char *) &v;
-    int bitCount = 
-        gBitsSetTable256[p[0]] +
-        gBitsSetTable256[p[1]] +
-        gBitsSetTable256[p[2]] +
-        gBitsSetTable256[p[3]] +
-        gBitsSetTable256[p[4]] +
-        gBitsSetTable256[p[5]] +
-        gBitsSetTable256[p[6]] +
-        gBitsSetTable256[p[7]];
-
-    return (bitCount-availableBits*0.5f)/(availableBits*0.5f);
-}
+/// DopToPcm()でWWDsdDecimatorに1回に渡すDoPフレーム数。
+#define DOP_TO_PCM_FRAMES (4096)
 
-/// @param availableBits 8以上64以下の8の倍数である必要がある。
-/// @return -128 to +127
-static int8_t
-DsdStreamToAmplitudeInt8(uint64_t v, int availableBits)
+/// DoP DSD→PCM変換。
+/// DSDをWWDsdDecimatorで16分の1に間引くのでPCMのサンプルレートはDoPと同じ。
+/// サンプルフォーマットとフレーム数は変わらない。streamを上書きする。
+/// デシメーターの遅延は補正する。最後のフレームの後ろはDSD無音が続くとして計算する。
+void
+WWPcmData::DopToPcm(void)
 {
-    assert(0 < availableBits && (availableBits&7)==0);
-    int bitCount = 0;
+    int bytesPerSample = 0;
 
-    for (int i=0; i<availableBits/8; ++i) {
-        bitCount += gBitsSetTable256[v&0xff];
-        v >>= 8;
-    }
-    if (availableBits <= bitCount) {
-        bitCount = availableBits-1;
+    switch (sampleFormat) {
+    case WWPcmDataSampleFormatSint32V24:
+        bytesPerSample = 4;
+        break;
+    case WWPcmDataSampleFormatSint24:
+        bytesPerSample = 3;
+        break;
+    default:
+        // DoPに対応していないデバイスでDoP再生しようとするとここに来ることがある。何もしない。
+        return;
     }
 
-    return (int8_t)((bitCount-availableBits/2) * (256/availableBits));
-}
-
-struct SmallDsdStreamInfo {
-    uint64_t dsdStream;
-    uint32_t availableBits;
-
-    SmallDsdStreamInfo(void) {
-        dsdStream = 0;
-        availableBits = 0;
+    WWDsdDecimator decimator;
+    if (decimator.Init(16, nChannels) < 0) {
+        assert(0);
+        return;
     }
-};
 
-/// 非常に音が悪いDop DSD→ PCM変換。
-void
-WWPcmData::DopToPcm(void)
-{
-    SmallDsdStreamInfo *dsdStreams = new SmallDsdStreamInfo[nChannels];
-    if (nullptr == dsdStreams) {
+    // DoP 1フレーム = 1チャンネルあたりDSD 2バイト
+    unsigned char *dsd = new unsigned char[DOP_TO_PCM_FRAMES * 2 * nChannels];
+    float *pcm = new float[decimator.MaxOutputFrames(DOP_TO_PCM_FRAMES * 2) * nChannels];
+    if (nullptr == dsd || nullptr == pcm) {
         assert(0);
+        delete [] pcm;
+        delete [] dsd;
         return;
     }
 
-    int64_t pos = 0;
-    switch (sampleFormat) {
-    case WWPcmDataSampleFormatSint32V24:
-        for (int64_t i=0; i<nFrames; ++i) {
-            for (int ch=0; ch<nChannels; ++ch) {
-                SmallDsdStreamInfo *p = &dsdStreams[ch];
+    // 遅延分の出力を捨てる。
+    // 書き込み位置は読み出し位置より遅れるので上書きしても問題ない。
+    int     skipFrames = decimator.DelayFrames();
+    int64_t readFrame  = 0;
+    int64_t writeFrame = 0;
 
-                p->dsdStream <<= 16;
-                p->dsdStream += (stream[pos+2] << 8) + stream[pos+1];
-                p->availableBits += 16;
-                if (64 < p->availableBits) {
-                    p->availableBits = 64;
-                }
+    while (writeFrame < nFrames) {
+        const int n = DOP_TO_PCM_FRAMES;
 
-                int8_t pcmValue = DsdStreamToAmplitudeInt8(p->dsdStream, p->availableBits);
-
-                stream[pos+0] = 0;
-                stream[pos+1] = 0;
-                stream[pos+2] = 0;
-                stream[pos+3] = (BYTE)pcmValue;
-                pos += 4;
-            }
-        }
-        streamType = WWStreamPcm;
-        break;
-    case WWPcmDataSampleFormatSint24:
-        for (int64_t i=0; i<nFrames; ++i) {
+        // DSDIFFのバイト順に並べる。古いバイトが先。
+        for (int i=0; i<n; ++i) {
             for (int ch=0; ch<nChannels; ++ch) {
-                SmallDsdStreamInfo *p = &dsdStreams[ch];
-
-                p->dsdStream <<= 16;
-                p->dsdStream += (stream[pos+1] << 8) + stream[pos];
-                p->availableBits += 16;
-                if (64 < p->availableBits) {
-                    p->availableBits = 64;
+                unsigned char older = 0x69;
+                unsigned char newer = 0x69;
+                if (readFrame + i < nFrames) {
+                    const BYTE *p = &stream[(readFrame + i) * bytesPerFrame + ch * bytesPerSample];
+                    older = p[bytesPerSample - 2];
+                    newer = p[bytesPerSample - 3];
                 }
+                dsd[(i * 2 + 0) * nChannels + ch] = older;
+                dsd[(i * 2 + 1) * nChannels + ch] = newer;
+            }
+        }
+        readFrame += n;
 
-                int8_t pcmValue = DsdStreamToAmplitudeInt8(p->dsdStream, p->availableBits);
+        const int outFrames = decimator.Process(dsd, n * 2, pcm);
+        for (int i=0; i<outFrames && writeFrame < nFrames; ++i) {
+            if (0 < skipFrames) {
+                --skipFrames;
+                continue;
+            }
 
-                stream[pos+0] = 0;
-                stream[pos+1] = 0;
-                stream[pos+2] = (BYTE)pcmValue;
-                pos += 3;
+            for (int ch=0; ch<nChannels; ++ch) {
+                float v = pcm[i * nChannels + ch];
+                if (v < -1.0f) {
+                    v = -1.0f;
+                }
+                int v24 = (int)(v * 8388608.0f);
+                if (8388607 < v24) {
+                    v24 = 8388607;
+                }
+                SetSampleValueInt(ch, writeFrame, v24);
             }
+            ++writeFrame;
         }
-        streamType = WWStreamPcm;
-        break;
-    default:
-        // DoPに対応していないデバイスでDoP再生しようとするとここに来ることがある。何もしない。
-        break;
     }
 
-    delete [] dsdStreams;
-    dsdStreams = nullptr;
+    delete [] pcm;
+    pcm = nullptr;
+
+    delete [] dsd;
+    dsd = nullptr;
+
+    streamType = WWStreamPcm;
 }
 
 void
@@ -800,96 +819,98 @@ WWPcmData::CheckDopMarker(void)
     }
 }
 
-/// 非常に音が悪いPCM→Dop DSD変換。
+/// PcmToDop()でWWDsdModulatorに1回に渡すPCMフレーム数。
+#define PCM_TO_DOP_FRAMES (4096)
+
+/// PcmToDop()のΔΣ変調器の次数。
+#define PCM_TO_DOP_MODULATOR_ORDER (5)
+
+/// PCM→DoP DSD変換。WWDsdModulatorで16倍にアップサンプルしてΔΣ変調する。
+/// WWPcmDataはサンプルレートを持っていないのでDoP 176.4kHz (DSD64)として変調器を作る。
+/// PCMの値はDopToPcm()の出力と同じくDSDの+1/-1をフルスケールとする。
+/// 補間フィルターの遅延は補正する。最後のフレームの後ろは最後のフレームの値が続くとして計算する。
 void
 WWPcmData::PcmToDop(void)
 {
-    int64_t pos = 0;
-    SmallDsdStreamInfo *dsdStreams = new SmallDsdStreamInfo[nChannels];
-    if (nullptr == dsdStreams) {
-        assert(0);
-        return;
-    }
+    int bytesPerSample = 0;
 
     switch (sampleFormat) {
     case WWPcmDataSampleFormatSint32V24:
-        for (int64_t i=0; i<nFrames; ++i) {
-            for (int ch=0; ch<nChannels; ++ch) {
-                SmallDsdStreamInfo *p = &dsdStreams[ch];
+        bytesPerSample = 4;
+        break;
+    case WWPcmDataSampleFormatSint24:
+        bytesPerSample = 3;
+        break;
+    default:
+        // DoPに対応していないデバイスでDoP再生しようとするとここに来ることがある。何もしない。
+        return;
+    }
 
-                short sv = (stream[pos+3]<<8) + stream[pos+2];
+    WWDsdModulator modulator;
+    if (modulator.Init(PCM_TO_DOP_MODULATOR_ORDER, 176400, 2822400, nChannels) < 0) {
+        assert(0);
+        return;
+    }
+    modulator.SetInputGain(1.0);
 
-                float targetV = sv / 32768.0f;
-                for (int c=0; c<16; ++c) {
-                    uint32_t ampBits = p->availableBits;
-                    if (64 == p->availableBits) {
-                        // 今作っている16ビットのDSDデータをp->dsdStreamに詰めると
-                        // 64ビットのデータのうち古いデータ16ビットが押し出されて消えるのでAmplitudeの計算から除外する。
-                        ampBits = 48+c;
-                    }
+    float *pcm = new float[PCM_TO_DOP_FRAMES * nChannels];
+    // DoP 1フレーム = 1チャンネルあたりDSD 2バイト
+    unsigned char *dsd = new unsigned char[PCM_TO_DOP_FRAMES * 2 * nChannels];
+    if (nullptr == dsd || nullptr == pcm) {
+        assert(0);
+        delete [] dsd;
+        delete [] pcm;
+        return;
+    }
 
-                    float currentV = DsdStreamToAmplitudeFloat(p->dsdStream, ampBits);
-                    p->dsdStream <<= 1;
-                    if (currentV < targetV) {
-                        p->dsdStream += 1;
-                    }
-                    if (p->availableBits < 64) {
-                        ++p->availableBits;
-                    }
-                }
-                unsigned short dsdValue16 = (unsigned short)p->dsdStream;
+    // 遅延分の出力を捨てる。
+    // 書き込み位置は読み出し位置より遅れるので上書きしても問題ない。
+    int     skipFrames = modulator.DelayFrames();
+    int64_t readFrame  = 0;
+    int64_t writeFrame = 0;
 
-                stream[pos+0] = 0;
-                stream[pos+1] = (BYTE)(0xff & dsdValue16);
-                stream[pos+2] = (BYTE)(0xff & (dsdValue16>>8));
-                stream[pos+3] = (i&1) ? 0xfa : 0x05;
-                pos += 4;
+    while (writeFrame < nFrames) {
+        const int n = PCM_TO_DOP_FRAMES;
+
+        for (int i=0; i<n; ++i) {
+            int64_t pos = readFrame + i;
+            if (nFrames <= pos) {
+                pos = nFrames - 1;
             }
-        }
-        streamType = WWStreamDop;
-        break;
-    case WWPcmDataSampleFormatSint24:
-        for (int64_t i=0; i<nFrames; ++i) {
             for (int ch=0; ch<nChannels; ++ch) {
-                SmallDsdStreamInfo *p = &dsdStreams[ch];
-
-                short sv = (stream[pos+2]<<8) + stream[pos+1];
-
-                float targetV = sv / 32768.0f;
-                for (int c=0; c<16; ++c) {
-                    uint32_t ampBits = p->availableBits;
-                    if (64 == p->availableBits) {
-                        // 今作っている16ビットのDSDデータをp->dsdStreamに詰めると
-                        // 64ビットのデータのうち古いデータ16ビットが押し出されて消えるのでAmplitudeの計算から除外する。
-                        ampBits = 48+c;
-                    }
+                pcm[i * nChannels + ch] = GetSampleValueInt(ch, pos) * (1.0f / 8388608.0f);
+            }
+        }
+        readFrame += n;
+
+        // DSDIFFのバイト順で出てくる。古いバイトが先。
+        modulator.Process(pcm, n, dsd);
+        for (int i=0; i<n && writeFrame < nFrames; ++i) {
+            if (0 < skipFrames) {
+                --skipFrames;
+                continue;
+            }
 
-                    float currentV = DsdStreamToAmplitudeFloat(p->dsdStream, ampBits);
-                    p->dsdStream <<= 1;
-                    if (currentV < targetV) {
-                        p->dsdStream += 1;
-                    }
-                    if (p->availableBits < 64) {
-                        ++p->availableBits;
-                    }
+            for (int ch=0; ch<nChannels; ++ch) {
+                BYTE *p = &stream[writeFrame * bytesPerFrame + ch * bytesPerSample];
+                if (4 == bytesPerSample) {
+                    p[0] = 0;
                 }
-                unsigned short dsdValue16 = (unsigned short)p->dsdStream;
-
-                stream[pos+0] = (BYTE)(0xff & dsdValue16);
-                stream[pos+1] = (BYTE)(0xff & (dsdValue16>>8));
-                stream[pos+2] = (i&1) ? 0xfa : 0x05;
-                pos += 3;
+                p[bytesPerSample - 3] = dsd[(i * 2 + 1) * nChannels + ch];
+                p[bytesPerSample - 2] = dsd[(i * 2 + 0) * nChannels + ch];
+                p[bytesPerSample - 1] = (writeFrame & 1) ? 0xfa : 0x05;
             }
+            ++writeFrame;
         }
-        streamType = WWStreamDop;
-        break;
-    default:
-        // DoPに対応していないデバイスでDoP再生しようとするとここに来ることがある。何もしない。
-        break;
     }
 
-    delete [] dsdStreams;
-    dsdStreams = nullptr;
+    delete [] dsd;
+    dsd = nullptr;
+
+    delete [] pcm;
+    pcm = nullptr;
+
+    streamType = WWStreamDop;
 }
 
 static void
@@ -916,6 +937,27 @@ CopyStream(const WWPcmData &from, int64_t fromPosFrame, int64_t numFrames, WWPcm
 
 #define SPLICE_READ_FRAME_NUM (4)
 
+/// DoPのスプライスでDSD→PCM変換するとき、PCM値を求める位置の前後に読むフレーム数。
+/// DopToPcm()のデシメーターのフィルタ長の半分より長くする。
+#define SPLICE_DOP_MARGIN_FRAME_NUM (128)
+
+/// dopのposFrameの位置のPCM値を求めるためにposFrameの前後を読む。
+/// @return pcmの中のposFrameの位置
+static int
+ReadDopAround(const WWPcmData &dop, int64_t posFrame, WWPcmData &pcm)
+{
+    int64_t startFrame = posFrame - SPLICE_DOP_MARGIN_FRAME_NUM;
+    if (startFrame < 0) {
+        startFrame = 0;
+    }
+
+    pcm.FillDopSilentData();
+    CopyStream(dop, startFrame, pcm.nFrames, pcm);
+    pcm.DopToPcm();
+
+    return (int)(posFrame - startFrame);
+}
+
 int
 WWPcmData::UpdateSpliceDataWithStraightLineDop(
         const WWPcmData &fromDop, int64_t fromPosFrame,
@@ -923,20 +965,17 @@ WWPcmData::UpdateSpliceDataWithStraightLineDop(
 {
     WWPcmData fromPcm;
     WWPcmData toPcm;
+    const int readFrames = SPLICE_DOP_MARGIN_FRAME_NUM * 2 + 1;
 
-    fromPcm.Init(-1, sampleFormat, nChannels, SPLICE_READ_FRAME_NUM, bytesPerFrame, contentType, WWStreamPcm);
-    fromPcm.FillDopSilentData();
-    CopyStream(fromDop, fromPosFrame, SPLICE_READ_FRAME_NUM, fromPcm);
-    fromPcm.DopToPcm();
+    fromPcm.Init(-1, sampleFormat, nChannels, readFrames, bytesPerFrame, contentType, WWStreamPcm);
+    int fromPcmPos = ReadDopAround(fromDop, fromPosFrame + SPLICE_READ_FRAME_NUM-1, fromPcm);
 
-    toPcm.Init(  -1, sampleFormat, nChannels, SPLICE_READ_FRAME_NUM, bytesPerFrame, contentType, WWStreamPcm);
-    toPcm.FillDopSilentData();
-    CopyStream(toDop,   toPosFrame,   SPLICE_READ_FRAME_NUM, toPcm);
-    toPcm.DopToPcm();
+    toPcm.Init(  -1, sampleFormat, nChannels, readFrames, bytesPerFrame, contentType, WWStreamPcm);
+    int toPcmPos   = ReadDopAround(toDop,   toPosFrame   + SPLICE_READ_FRAME_NUM-1, toPcm);
 
     int sampleCount = UpdateSpliceDataWithStraightLinePcm(
-            fromPcm, SPLICE_READ_FRAME_NUM-1,
-            toPcm,   SPLICE_READ_FRAME_NUM-1);
+            fromPcm, fromPcmPos,
+            toPcm,   toPcmPos);
 
     PcmToDop();
 
@@ -168,6 +168,10 @@ struct WWPcmData {
     void FindSampleValueMinMax(float *minValue_return, float *maxValue_return);
     void ScaleSampleValue(float scale);
 
+    /// fromFrameからframesフレームを、フルスケール1.0のfloatに変換して取り出す。チャンネルはインターリーブ。
+    /// PCMデータの範囲外は0になる。
+    void GetFloatFrames(int64_t fromFrame, int frames, float *out_return) const;
+
     void SetStreamType(WWStreamType t) {
         streamType = t;
     }
@@ -4,6 +4,10 @@
 
 #include "WWPcmData.h"
 
+/// ProcessFloat()が1回に処理するフレーム数。フィルターはFilter()の中でメモリ確保しないように、
+/// WW_PCM_PROCESS_FRAMES * チャンネル数のfloatのバッファーを用意しておく。
+#define WW_PCM_PROCESS_FRAMES (1024)
+
 class WWPcmSampleManipulator {
 public:
     void UpdateFormat(WWPcmDataSampleFormatType format, WWStreamType streamType, int numChannels);
@@ -15,6 +19,31 @@ public:
     int NumChannels(void) const { return mNumChannels; }
     int BitsPerSample(void) const { return mBitsPerSample; }
 
+    /// buffのサンプルをWW_PCM_PROCESS_FRAMESフレームずつインターリーブのfloatにしてinに読み、
+    /// process(in, フレーム数, out)を呼んでoutをbuffに書き戻す。inとoutは同じバッファーでもよい。
+    template <typename PROCESS>
+    void ProcessFloat(unsigned char *buff, int bytes, float *in, float *out, PROCESS process) {
+        const int nFrames = bytes / (mNumChannels * mBitsPerSample / 8);
+
+        for (int pos=0; pos<nFrames; pos += WW_PCM_PROCESS_FRAMES) {
+            const int n = (nFrames - pos < WW_PCM_PROCESS_FRAMES) ? (nFrames - pos) : WW_PCM_PROCESS_FRAMES;
+
+            for (int i=0; i<n; ++i) {
+                for (int ch=0; ch<mNumChannels; ++ch) {
+                    GetFloatSample(buff, bytes, pos + i, ch, in[i*mNumChannels+ch]);
+                }
+            }
+
+            process(in, n, out);
+
+            for (int i=0; i<n; ++i) {
+                for (int ch=0; ch<mNumChannels; ++ch) {
+                    SetFloatSample(buff, bytes, pos + i, ch, out[i*mNumChannels+ch]);
+                }
+            }
+        }
+    }
+
 private:
     WWPcmDataSampleFormatType mFormat;
     WWStreamType mStreamType;
@@ -8,6 +8,11 @@
 #include "WWAudioFilterPolarityInvert.h"
 #include "WWAudioFilterMonauralMix.h"
 #include "WWAudioFilterChannelRouting.h"
+#include "WWAudioFilterCrossfeed.h"
+#include "WWAudioFilterParametricEq.h"
+#include "WWAudioFilterConvolution.h"
+#include "WWLoudness.h"
+#include "WWBitmatch.h"
 #include <assert.h>
 #include <map>
 
@@ -36,6 +41,7 @@ public:
 
     double ScanPcmMaxAbsAmplitude(void);
     void ScalePcmAmplitude(double scale);
+    int ScanPcmLoudness(int numThreads, WasapiIoLoudness *tracks_return, int tracksCount, WasapiIoLoudness &album_return);
 
     bool ConnectPcmDataNext(int fromIdx, int toIdx);
 
@@ -174,6 +180,72 @@ WasapiIO::ScalePcmAmplitude(double scale)
     }
 }
 
+static void
+SetLoudness(int pcmDataId, const WWLoudnessResult &r, WasapiIoLoudness &to)
+{
+    to.pcmDataId      = pcmDataId;
+    to.valid          = 1;
+    to.integratedLufs = r.integrated;
+    to.rangeLu        = r.range;
+    to.truePeak       = r.truePeak;
+    to.samplePeak     = r.samplePeak;
+    to.replayGainDb   = r.replayGainDb;
+}
+
+int
+WasapiIO::ScanPcmLoudness(int numThreads, WasapiIoLoudness *tracks_return, int tracksCount, WasapiIoLoudness &album_return)
+{
+    const int count = playPcmGroup.Count();
+    memset(&album_return, 0, sizeof album_return);
+    album_return.pcmDataId = -1;
+    if (nullptr == tracks_return || tracksCount < count) {
+        return count;
+    }
+
+    WWPcmFormat pcmFormat;
+    wasapi.GetPcmFormat(pcmFormat);
+
+    // DoP̃f[^͑ȂB
+    std::vector<WWLoudnessTrack> tracks;
+    std::vector<int> trackIdx;
+    for (int i=0; i<count; ++i) {
+        const WWPcmData *pcm = playPcmGroup.NthPcmData(i);
+        assert(pcm);
+
+        memset(&tracks_return[i], 0, sizeof tracks_return[i]);
+        tracks_return[i].pcmDataId = pcm->id;
+        if (pcm->streamType != WWStreamPcm) {
+            continue;
+        }
+
+        WWLoudnessTrack t;
+        t.sampleRate  = pcmFormat.sampleRate;
+        t.numChannels = pcm->nChannels;
+        t.channelMask = pcmFormat.dwChannelMask;
+        t.numFrames   = pcm->nFrames;
+        t.read = [pcm](int64_t fromFrame, int frames, float *out_return) {
+            pcm->GetFloatFrames(fromFrame, frames, out_return);
+        };
+        tracks.push_back(t);
+        trackIdx.push_back(i);
+    }
+
+    std::vector<WWLoudnessResult> results;
+    WWLoudnessResult album;
+    if (WWLoudnessAnalyze(tracks, numThreads, results, album) < 0) {
+        return count;
+    }
+
+    for (size_t i=0; i<results.size(); ++i) {
+        WasapiIoLoudness &to = tracks_return[trackIdx[i]];
+        SetLoudness(to.pcmDataId, results[i], to);
+    }
+    if (!results.empty()) {
+        SetLoudness(-1, album, album_return);
+    }
+    return count;
+}
+
 void
 WasapiIO::AddPcmDataEnd(void)
 {
@@ -598,6 +670,12 @@ WasapiIO_GetPlayCursorPosition(int instanceId, int usageType, WasapiIoCursorLoca
     assert(self);
     pos_return.posFrame      = self->wasapi.PcmStream().PosFrame(     (WWPcmDataUsageType)usageType);
     pos_return.totalFrameNum = self->wasapi.PcmStream().TotalFrameNum((WWPcmDataUsageType)usageType);
+
+    // I[fBItB^[x镪AĂʒu͎OB
+    pos_return.posFrame -= self->wasapi.AudioFilterSequencer().LatencyFrames();
+    if (pos_return.posFrame < 0) {
+        pos_return.posFrame = 0;
+    }
     return true;
 }
 
@@ -663,6 +741,116 @@ WasapiIO_ScalePcmAmplitude(int instanceId, double scale)
     return self->ScalePcmAmplitude(scale);
 }
 
+__declspec(dllexport)
+void __stdcall
+WasapiIO_SetAudioTapEnabled(int instanceId, bool enabled)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    self->wasapi.AudioTap().SetEnabled(enabled);
+}
+
+__declspec(dllexport)
+bool __stdcall
+WasapiIO_GetAudioTapSnapshot(int instanceId, WasapiIoAudioTapSnapshot &snapshot_return)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    static_assert(sizeof(WasapiIoAudioTapSnapshot) == sizeof(WWAudioTapSnapshot), "WasapiIoAudioTapSnapshot size");
+
+    WWAudioTapSnapshot s;
+    if (!self->wasapi.AudioTap().GetSnapshot(s)) {
+        memset(&snapshot_return, 0, sizeof snapshot_return);
+        return false;
+    }
+
+    snapshot_return.serial        = s.serial;
+    snapshot_return.totalFrames   = s.totalFrames;
+    snapshot_return.droppedFrames = s.droppedFrames;
+    snapshot_return.sampleRate    = s.sampleRate;
+    snapshot_return.numChannels   = s.numChannels;
+    memcpy(snapshot_return.rms,        s.rms,        sizeof s.rms);
+    memcpy(snapshot_return.peak,       s.peak,       sizeof s.peak);
+    memcpy(snapshot_return.spectrumDb, s.spectrumDb, sizeof s.spectrumDb);
+    return true;
+}
+
+__declspec(dllexport)
+int __stdcall
+WasapiIO_ScanPcmLoudness(int instanceId, int numThreads, WasapiIoLoudness *tracks_return, int tracksCount,
+        WasapiIoLoudness &album_return)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+    return self->ScanPcmLoudness(numThreads, tracks_return, tracksCount, album_return);
+}
+
+static bool
+SetBitmatchPcm(const unsigned char *data, int64_t bytes, int sampleFormat, int numChannels, WWBitmatchPcm &pcm_return)
+{
+    if (sampleFormat < 0 || WWPcmDataSampleFormatNUM <= sampleFormat
+            || !WWPcmDataSampleFormatTypeIsInt((WWPcmDataSampleFormatType)sampleFormat)
+            || nullptr == data || bytes < 0 || numChannels <= 0) {
+        return false;
+    }
+
+    pcm_return.data               = data;
+    pcm_return.numChannels        = numChannels;
+    pcm_return.bitsPerSample      = WWPcmDataSampleFormatTypeToBitsPerSample((WWPcmDataSampleFormatType)sampleFormat);
+    pcm_return.validBitsPerSample = WWPcmDataSampleFormatTypeToValidBitsPerSample((WWPcmDataSampleFormatType)sampleFormat);
+    pcm_return.numFrames          = bytes / (numChannels * pcm_return.bitsPerSample / 8);
+    return true;
+}
+
+__declspec(dllexport)
+int __stdcall
+WasapiIO_BitmatchCompare(const unsigned char *refData, int64_t refBytes, int refSampleFormat,
+        const unsigned char *capData, int64_t capBytes, int capSampleFormat, int numChannels,
+        bool findLag, int64_t lag, WasapiIoBitmatchRange *ranges_return, int rangesCount,
+        WasapiIoBitmatchResult &result_return)
+{
+    memset(&result_return, 0, sizeof result_return);
+
+    WWBitmatchPcm ref;
+    WWBitmatchPcm cap;
+    if (!SetBitmatchPcm(refData, refBytes, refSampleFormat, numChannels, ref)
+            || !SetBitmatchPcm(capData, capBytes, capSampleFormat, numChannels, cap)
+            || rangesCount < 0 || (0 < rangesCount && nullptr == ranges_return)) {
+        return E_INVALIDARG;
+    }
+
+    double correlation = 1.0;
+    if (findLag) {
+        int hr = WWBitmatchFindLag(ref, cap, lag, correlation);
+        if (hr < 0) {
+            return hr;
+        }
+    }
+
+    WWBitmatchResult r;
+    int hr = WWBitmatchCompare(ref, cap, lag, rangesCount, r);
+    if (hr < 0) {
+        return hr;
+    }
+
+    result_return.lag               = r.lag;
+    result_return.correlation       = correlation;
+    result_return.comparedFromFrame = r.comparedFromFrame;
+    result_return.comparedToFrame   = r.comparedToFrame;
+    result_return.mismatchedFrames  = r.mismatchedFrames;
+    result_return.mismatchedSamples = r.mismatchedSamples;
+    result_return.numRanges         = r.numRanges;
+
+    for (size_t i=0; i<r.ranges.size(); ++i) {
+        ranges_return[i].fromFrame         = r.ranges[i].fromFrame;
+        ranges_return[i].toFrame           = r.ranges[i].toFrame;
+        ranges_return[i].mismatchedSamples = r.ranges[i].mismatchedSamples;
+    }
+    return 0;
+}
+
 __declspec(dllexport)
 void __stdcall
 WasapiIO_RegisterCaptureCallback(int instanceId, WWCaptureCallback callback)
@@ -694,24 +882,52 @@ WasapiIO_AppendAudioFilter(int instanceId, int audioFilterType, PCWSTR args)
     WasapiIO *self = Instance(instanceId);
     assert(self);
 
+    // tB^[̍쐬 (t@C̓ǂݍ݂Ȃ) ͍ĐXbh~߂Ȃ悤Ƀ~[ebNX̊OōsB
+    WWAudioFilter *af = nullptr;
+    switch (audioFilterType) {
+    case WWAF_PolarityInvert:
+        af = new WWAudioFilterPolarityInvert();
+        break;
+    case WWAF_Monaural:
+        af = new WWAudioFilterMonauralMix();
+        break;
+    case WWAF_ChannelRouting:
+        af = new WWAudioFilterChannelRouting(args);
+        break;
+    case WWAF_Crossfeed:
+        af = new WWAudioFilterCrossfeed(args);
+        break;
+    case WWAF_ParametricEq:
+        af = new WWAudioFilterParametricEq(args);
+        break;
+    case WWAF_Convolution:
+        af = new WWAudioFilterConvolution(args);
+        break;
+    default:
+        assert(0);
+        return;
+    }
+
+    // tB^[͍ĐXbh̊OōAĐXbhɓnBĐXbh~߂Ȃ̂ŁA~[ebNX͕svB
+    self->wasapi.AudioFilterSequencer().Append(af);
+}
+
+__declspec(dllexport)
+bool __stdcall
+WasapiIO_UpdateAudioFilter(int instanceId, int idx, PCWSTR args)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    bool result = false;
+
     self->wasapi.MutexWait();
     {
-        switch (audioFilterType) {
-        case WWAF_PolarityInvert:
-            self->wasapi.AudioFilterSequencer().Append(new WWAudioFilterPolarityInvert());
-            break;
-        case WWAF_Monaural:
-            self->wasapi.AudioFilterSequencer().Append(new WWAudioFilterMonauralMix());
-            break;
-        case WWAF_ChannelRouting:
-            self->wasapi.AudioFilterSequencer().Append(new WWAudioFilterChannelRouting(args));
-            break;
-        default:
-            assert(0);
-            return;
-        }
+        result = self->wasapi.AudioFilterSequencer().UpdateParams(idx, args);
     }
     self->wasapi.MutexRelease();
+
+    return result;
 }
 
 __declspec(dllexport)
@@ -721,9 +937,45 @@ WasapiIO_ClearAudioFilter(int instanceId)
     WasapiIO *self = Instance(instanceId);
     assert(self);
 
+    // ÂtB^[͍ĐXbhgȂȂĂ폜B~[ebNX͕svB
+    self->wasapi.AudioFilterSequencer().UnregisterAll();
+}
+
+__declspec(dllexport)
+void __stdcall
+WasapiIO_BeginAudioFilterChain(int instanceId)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    self->wasapi.AudioFilterSequencer().BeginEdit();
+}
+
+__declspec(dllexport)
+void __stdcall
+WasapiIO_CommitAudioFilterChain(int instanceId, int crossfadeMs)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    self->wasapi.AudioFilterSequencer().CommitEdit(crossfadeMs);
+}
+
+__declspec(dllexport)
+void __stdcall
+WasapiIO_SetAudioFilterQuantizer(int instanceId, int quantizerType)
+{
+    WasapiIO *self = Instance(instanceId);
+    assert(self);
+
+    if (quantizerType < 0 || WWQT_NUM <= quantizerType) {
+        assert(0);
+        return;
+    }
+
     self->wasapi.MutexWait();
     {
-        self->wasapi.AudioFilterSequencer().UnregisterAll();
+        self->wasapi.AudioFilterSequencer().SetQuantizer((WWQuantizerType)quantizerType);
     }
     self->wasapi.MutexRelease();
 }
@@ -171,6 +171,7 @@ struct WasapiIoCursorLocation {
 };
 #pragma pack(pop)
 
+/// posFrame is the position being heard: the latency of the audio filters is subtracted
 __declspec(dllexport)
 bool __stdcall
 WasapiIO_GetPlayCursorPosition(int instanceId, int usageType, WasapiIoCursorLocation &pos_return);
@@ -191,6 +192,83 @@ __declspec(dllexport)
 void __stdcall
 WasapiIO_ScalePcmAmplitude(int instanceId, double scale);
 
+#pragma pack(push, 8)
+struct WasapiIoAudioTapSnapshot {
+    int64_t serial;         ///< increases by 1 for each analysis. 0: no analysis yet
+    int64_t totalFrames;
+    int64_t droppedFrames;  ///< frames not analyzed because the analysis thread was late
+    int     sampleRate;
+    int     numChannels;
+    float   rms[WW_AUDIO_TAP_MAX_CHANNELS];   ///< linear. of the frames since the previous analysis
+    float   peak[WW_AUDIO_TAP_MAX_CHANNELS];
+    float   spectrumDb[WW_AUDIO_TAP_SPECTRUM_BINS]; ///< Hann windowed FFT of the channel average. full scale sine is 0dB
+};
+#pragma pack(pop)
+
+/// starts or stops the level and spectrum analysis of the samples sent to the device (after the audio filters).
+/// the render thread only copies the samples to a ring buffer. a low priority thread analyzes them
+__declspec(dllexport)
+void __stdcall
+WasapiIO_SetAudioTapEnabled(int instanceId, bool enabled);
+
+/// gets the latest analysis without blocking the render thread or the analysis thread
+/// @return false: no analysis yet
+__declspec(dllexport)
+bool __stdcall
+WasapiIO_GetAudioTapSnapshot(int instanceId, WasapiIoAudioTapSnapshot &snapshot_return);
+
+#pragma pack(push, 8)
+struct WasapiIoLoudness {
+    int    pcmDataId;
+    int    valid;           ///< 0: not measured (DoP data)
+    double integratedLufs;  ///< ITU-R BS.1770-4 gated integrated loudness. -inf when silent
+    double rangeLu;         ///< EBU Tech 3342 loudness range
+    double truePeak;        ///< linear. full scale is 1.0
+    double samplePeak;      ///< linear. full scale is 1.0
+    double replayGainDb;    ///< ReplayGain 2.0: -18 LUFS - integratedLufs
+};
+#pragma pack(pop)
+
+/// measures the loudness of the loaded PCM data. each PCM data is measured on one of numThreads threads.
+/// @param numThreads 0: number of the CPU cores
+/// @param tracks_return the result of each PCM data, in the order of loading. tracksCount elements
+/// @param album_return the PCM data measured as one album (ReplayGain 2.0 album gain)
+/// @return number of the PCM data. when tracksCount is smaller than it, nothing is measured
+__declspec(dllexport)
+int __stdcall
+WasapiIO_ScanPcmLoudness(int instanceId, int numThreads, WasapiIoLoudness *tracks_return, int tracksCount,
+        WasapiIoLoudness &album_return);
+
+#pragma pack(push, 8)
+struct WasapiIoBitmatchRange {
+    int64_t fromFrame;          ///< frame of the reference data
+    int64_t toFrame;            ///< exclusive
+    int64_t mismatchedSamples;
+};
+
+struct WasapiIoBitmatchResult {
+    int64_t lag;                ///< captured frame lag + i is the reference frame i
+    double  correlation;        ///< normalized cross-correlation at the lag. 1.0 when the lag is given
+    int64_t comparedFromFrame;  ///< reference frames [comparedFromFrame, comparedToFrame) are compared
+    int64_t comparedToFrame;
+    int64_t mismatchedFrames;
+    int64_t mismatchedSamples;
+    int64_t numRanges;          ///< number of the mismatched ranges. the first rangesCount of them are returned
+};
+#pragma pack(pop)
+
+/// compares the reference PCM with the captured PCM sample by sample. integer sample formats only.
+/// does not need an instance.
+/// @param refSampleFormat, capSampleFormat WWPcmDataSampleFormatType
+/// @param findLag true: the lag is found by the FFT cross-correlation. false: lag is used
+/// @return 0: success. negative: bad parameter or the lag was not found
+__declspec(dllexport)
+int __stdcall
+WasapiIO_BitmatchCompare(const unsigned char *refData, int64_t refBytes, int refSampleFormat,
+        const unsigned char *capData, int64_t capBytes, int capSampleFormat, int numChannels,
+        bool findLag, int64_t lag, WasapiIoBitmatchRange *ranges_return, int rangesCount,
+        WasapiIoBitmatchResult &result_return);
+
 __declspec(dllexport)
 void __stdcall
 WasapiIO_RegisterCaptureCallback(int instanceId, WWCaptureCallback callback);
@@ -207,13 +285,46 @@ __declspec(dllexport)
 void __stdcall
 WasapiIO_GetWorkerThreadSetupResult(int instanceId, WasapiIoWorkerThreadSetupResult &result_return);
 
+/// appends the audio filter. takes effect immediately unless the chain is being edited.
+/// the filter chain is built outside of the render thread and handed over by an atomic pointer swap
 /// @param audioFilterType WWAudioFilterType
 __declspec(dllexport)
 void __stdcall
 WasapiIO_AppendAudioFilter(int instanceId, int audioFilterType, PCWSTR args);
 
+/// changes the parameters of the idx-th (0 based) audio filter while playing.
+/// @return false: no filter of idx or the filter does not support it
+__declspec(dllexport)
+bool __stdcall
+WasapiIO_UpdateAudioFilter(int instanceId, int idx, PCWSTR args);
+
+/// removes all audio filters. takes effect immediately unless the chain is being edited.
+/// the filters are deleted after the render thread stops using them
 __declspec(dllexport)
 void __stdcall
 WasapiIO_ClearAudioFilter(int instanceId);
 
+/// starts editing the audio filter chain. WasapiIO_AppendAudioFilter() and WasapiIO_ClearAudioFilter()
+/// do not affect the playback until WasapiIO_CommitAudioFilterChain()
+__declspec(dllexport)
+void __stdcall
+WasapiIO_BeginAudioFilterChain(int instanceId);
+
+/// hands the edited audio filter chain over to the render thread.
+/// @param crossfadeMs positive: the output of the old and the new chain is crossfaded over this duration,
+///        when the chains share no filter (the chain is rebuilt by WasapiIO_ClearAudioFilter()). not for DoP
+__declspec(dllexport)
+void __stdcall
+WasapiIO_CommitAudioFilterChain(int instanceId, int crossfadeMs);
+
+/// sets the quantizer of the last stage of the audio filters for 16bit and 24bit integer devices.
+/// except WWQT_None, the filters process float samples and the result is dithered and noise shaped.
+/// can be called during playback. only the quantizer is rebuilt when the type is changed between the dither types.
+/// switching from or to WWQT_None changes the sample format of the filters: the filters are reset and
+/// the render thread waits for it
+/// @param quantizerType WWQuantizerType
+__declspec(dllexport)
+void __stdcall
+WasapiIO_SetAudioFilterQuantizer(int instanceId, int quantizerType);
+
 }; // extern "C"
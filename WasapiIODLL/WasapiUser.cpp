@@ -130,6 +130,7 @@ WasapiUser::Term(void)
 
     m_captureCallback = nullptr;
 
+    m_audioTap.SetEnabled(false);
     m_audioFilterSequencer.Term();
 
     SafeRelease(&m_deviceToUse);
@@ -419,6 +420,12 @@ WasapiUser::Start(void)
             WWPcmData *pcm = m_pcmStream.GetPcm(WWPDUNowPlaying);
             assert(pcm);
 
+            // 再生スレッドが動く前にタップのリングバッファーを用意する。
+            m_audioTap.UpdateFormat(m_deviceFormat.sampleRate, pcm->sampleFormat, pcm->streamType, pcm->nChannels);
+
+            // フィルターの状態をリセットし、古いフィルター列を全て削除する。再生スレッドが動く前に呼ぶ。
+            m_audioFilterSequencer.UpdateSampleFormat(m_deviceFormat.sampleRate, pcm->sampleFormat, pcm->streamType, pcm->nChannels);
+
             assert(nullptr == m_thread);
             m_thread = CreateThread(nullptr, 0, RenderEntry, this, 0, nullptr);
             assert(m_thread);
@@ -442,8 +449,6 @@ WasapiUser::Start(void)
             }
 
             m_footerCount = 0;
-
-            m_audioFilterSequencer.UpdateSampleFormat(pcm->sampleFormat, pcm->streamType, pcm->nChannels);
         }
         break;
 
@@ -797,6 +802,9 @@ WasapiUser::AudioSamplesSendProc(void)
         m_audioFilterSequencer.ProcessSamples(to, copyFrames*m_deviceFormat.BytesPerFrame());
     }
 
+    // メーター用にフィルター後のサンプルをコピーする。待たない。
+    m_audioTap.Write(to, copyFrames*m_deviceFormat.BytesPerFrame());
+
     if (0 < writableFrames - copyFrames) {
         memset(&to[copyFrames*m_deviceFormat.BytesPerFrame()], 0, (writableFrames - copyFrames)*m_deviceFormat.BytesPerFrame());
         // dprintf("fc=%d bs=%d cb=%d memset %d bytes\n", m_footerCount, m_bufferFrameNum, copyFrames, (m_bufferFrameNum - copyFrames)*m_deviceFormat.BytesPerFrame());
@@ -820,6 +828,9 @@ WasapiUser::AudioSamplesSendProc(void)
 
 end:
     ReleaseMutex(m_mutex);
+
+    // ProcessSamples()の外で、使われなくなった古いフィルター列を削除する。編集中のときは待たない。
+    m_audioFilterSequencer.ReclaimRetired();
     return result;
 }
 
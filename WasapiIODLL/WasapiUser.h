@@ -12,6 +12,7 @@
 #include "WWThreadCharacteristics.h"
 #include "WWTypes.h"
 #include "WWAudioFilterSequencer.h"
+#include "WWAudioTap.h"
 
 /// @param data captured data
 /// @param dataBytes captured data size in bytes
@@ -105,6 +106,7 @@ public:
     WWTimerResolution &TimerResolution(void) { return m_timerResolution; }
     WWThreadCharacteristics &ThreadCharacteristics(void) { return m_threadCharacteristics; }
     WWAudioFilterSequencer &AudioFilterSequencer(void) { return m_audioFilterSequencer; }
+    WWAudioTap &AudioTap(void) { return m_audioTap; }
 
 private:
     HANDLE       m_shutdownEvent;
@@ -142,6 +144,7 @@ private:
     WWTimerResolution m_timerResolution;
     WWThreadCharacteristics m_threadCharacteristics;
     WWAudioFilterSequencer m_audioFilterSequencer;
+    WWAudioTap m_audioTap;
 
     static DWORD WINAPI RenderEntry(LPVOID lpThreadParameter);
     static DWORD WINAPI CaptureEntry(LPVOID lpThreadParameter);